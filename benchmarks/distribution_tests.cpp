@@ -0,0 +1,166 @@
+#include "distribution_tests.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SampleComparison KolmogorovSmirnov(std::vector<double> a,
+                                   std::vector<double> b) {
+  if (a.empty() || b.empty()) {
+    throw std::invalid_argument("Samples to compare may not be empty.");
+  }
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  double n = a.size(), m = b.size();
+  double d = 0;
+  std::size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    // Step past every copy of the next value in either sample
+    double value = std::min(a[i], b[j]);
+    while (i < a.size() && a[i] == value) {
+      i++;
+    }
+    while (j < b.size() && b[j] == value) {
+      j++;
+    }
+    d = std::max(d, std::fabs(i / n - j / m));
+  }
+  // Asymptotic distribution with the small-sample correction of Stephens
+  double en = std::sqrt(n * m / (n + m));
+  double lambda = (en + 0.12 + 0.11 / en) * d;
+  double p = 0;
+  for (int k = 1; k <= 100; k++) {
+    double term = 2 * std::exp(-2 * k * k * lambda * lambda);
+    p += k % 2 == 1 ? term : -term;
+    if (term < 1e-12) {
+      break;
+    }
+  }
+  if (lambda < 0.2) {
+    p = 1;
+  }
+  return SampleComparison{d, std::min(1.0, std::max(0.0, p))};
+}
+
+/**
+ * Coefficients of log(p) as a quadratic in the standardized statistic,
+ * fitted by least squares to the critical values of Scholz and Stephens
+ * for two samples.
+ */
+struct AndersonDarlingFit {
+  double c[3];
+  AndersonDarlingFit() {
+    const double critical[] = {0.325, 1.226, 1.961, 2.718,
+                               3.752, 4.592, 6.546};
+    const double significance[] = {0.25, 0.1, 0.05, 0.025,
+                                   0.01, 0.005, 0.001};
+    // Normal equations, solved by Gaussian elimination
+    double m[3][4] = {};
+    for (int k = 0; k < 7; k++) {
+      double powers[3] = {1, critical[k], critical[k] * critical[k]};
+      for (int r = 0; r < 3; r++) {
+        for (int s = 0; s < 3; s++) {
+          m[r][s] += powers[r] * powers[s];
+        }
+        m[r][3] += powers[r] * std::log(significance[k]);
+      }
+    }
+    for (int r = 0; r < 3; r++) {
+      for (int s = r + 1; s < 3; s++) {
+        double factor = m[s][r] / m[r][r];
+        for (int t = r; t < 4; t++) {
+          m[s][t] -= factor * m[r][t];
+        }
+      }
+    }
+    for (int r = 2; r >= 0; r--) {
+      c[r] = m[r][3];
+      for (int s = r + 1; s < 3; s++) {
+        c[r] -= m[r][s] * c[s];
+      }
+      c[r] /= m[r][r];
+    }
+  }
+};
+
+SampleComparison AndersonDarling(const std::vector<double> &a,
+                                 const std::vector<double> &b) {
+  const std::vector<double> *samples[] = {&a, &b};
+  const int k = 2;
+  if (a.size() < 2 || b.size() < 2) {
+    throw std::invalid_argument("Samples to compare need two values each.");
+  }
+  std::vector<double> pooled(a);
+  pooled.insert(pooled.end(), b.begin(), b.end());
+  std::sort(pooled.begin(), pooled.end());
+  double n = pooled.size();
+  if (pooled.front() == pooled.back()) {
+    // Identical constant samples
+    return SampleComparison{0, 1};
+  }
+  std::vector<double> sorted[2] = {a, b};
+  std::sort(sorted[0].begin(), sorted[0].end());
+  std::sort(sorted[1].begin(), sorted[1].end());
+  // Midrank version (A2akN), with each distinct value counted halfway
+  double a2 = 0;
+  for (int i = 0; i < k; i++) {
+    double size = samples[i]->size();
+    double sum = 0;
+    std::size_t below = 0, position = 0, mine = 0;
+    while (position < pooled.size()) {
+      double value = pooled[position];
+      std::size_t ties = 0;
+      while (position < pooled.size() && pooled[position] == value) {
+        position++;
+        ties++;
+      }
+      std::size_t mine_below = mine;
+      while (mine < sorted[i].size() && sorted[i][mine] == value) {
+        mine++;
+      }
+      double m_a = mine_below + (mine - mine_below) / 2.0;
+      double b_a = below + ties / 2.0;
+      below += ties;
+      double denominator = b_a * (n - b_a) - n * ties / 4.0;
+      if (denominator > 0) {
+        double deviation = n * m_a - size * b_a;
+        sum += ties * deviation * deviation / denominator;
+      }
+    }
+    a2 += sum / size;
+  }
+  a2 *= (n - 1) / (n * n);
+
+  // Mean k - 1 and variance of the statistic under the null hypothesis
+  double h_sum = 0;
+  for (int i = 0; i < k; i++) {
+    h_sum += 1.0 / samples[i]->size();
+  }
+  double h = 0, g = 0, tail = 0;
+  for (int j = 1; j < n; j++) {
+    h += 1.0 / j;
+  }
+  // g sums 1 / ((N - i) j) over 1 <= i < j <= N - 1
+  for (int j = 2; j < n; j++) {
+    tail += 1.0 / (n - (j - 1));
+    g += tail / j;
+  }
+  double ca = (4 * g - 6) * (k - 1) + (10 - 6 * g) * h_sum;
+  double cb = (2 * g - 4) * k * k + 8 * h * k +
+              (2 * g - 14 * h - 4) * h_sum - 8 * h + 4 * g - 6;
+  double cc = (6 * h + 2 * g - 2) * k * k + (4 * h - 4 * g + 6) * k +
+              (2 * h - 6) * h_sum + 4 * h;
+  double cd = (2 * h + 6) * k * k - 4 * h * k;
+  double variance = (ca * n * n * n + cb * n * n + cc * n + cd) /
+                    ((n - 1) * (n - 2) * (n - 3));
+  double statistic = (a2 - (k - 1)) / std::sqrt(variance);
+
+  static const AndersonDarlingFit fit;
+  // The fitted parabola turns up again far beyond the table
+  double t = statistic;
+  if (fit.c[2] > 0) {
+    t = std::min(t, -fit.c[1] / (2 * fit.c[2]));
+  }
+  double p = std::exp(fit.c[0] + fit.c[1] * t + fit.c[2] * t * t);
+  return SampleComparison{statistic, std::min(1.0, p)};
+}
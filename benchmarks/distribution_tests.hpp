@@ -0,0 +1,35 @@
+#ifndef BENCHMARKS_DISTRIBUTION_TESTS_HPP  // header guard
+#define BENCHMARKS_DISTRIBUTION_TESTS_HPP
+
+#include <vector>
+
+/**
+ * Result of a test of whether two samples come from the same distribution.
+ */
+struct SampleComparison {
+  double statistic;
+  /**
+   * Probability of a statistic at least as large if they do.
+   */
+  double p_value;
+};
+
+/**
+ * Two-sample Kolmogorov-Smirnov test, with the asymptotic distribution of
+ * the statistic. The test is conservative for discrete samples such as
+ * copy numbers, i.e. p-values are if anything too large.
+ */
+SampleComparison KolmogorovSmirnov(std::vector<double> a,
+                                   std::vector<double> b);
+
+/**
+ * Two-sample Anderson-Darling test in the version of Scholz and Stephens
+ * (1987) for samples with ties. The statistic is the standardized one,
+ * whose p-value is interpolated in their table of critical values, from
+ * p = 0.25 down to p = 0.001, and extrapolated beyond it down to about
+ * p = 1e-7.
+ */
+SampleComparison AndersonDarling(const std::vector<double> &a,
+                                 const std::vector<double> &b);
+
+#endif  // header guard
@@ -0,0 +1,158 @@
+#include "lib/catch.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "model.hpp"
+#include "model_file.hpp"
+#include "output.hpp"
+#include "polymer.hpp"
+
+/**
+ * Peak resident set size of this process in MB. The peak never decreases,
+ * so run one scenario per process (e.g. pinetree_bench "Macro: phage") to
+ * compare scenarios.
+ */
+static double PeakRssMb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+/**
+ * Simulate a model and report how many events it executed per second of
+ * wall time.
+ */
+static void RunScenario(const std::string &name, Model &model, int time_limit,
+                        int time_step) {
+  auto started = std::chrono::steady_clock::now();
+  model.SimulateToTable(time_limit, time_step, "direct");
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+  const auto &stats = model.stats();
+  long long events =
+      std::accumulate(stats.events.begin(), stats.events.end(), 0LL) +
+      stats.leaps;
+  std::cout << std::left << std::setw(20) << name << std::right
+            << std::setw(12) << events << " events  " << std::fixed
+            << std::setprecision(3) << std::setw(9) << seconds << " s  "
+            << std::setprecision(0) << std::setw(12) << events / seconds
+            << " events/s  " << std::setprecision(1) << std::setw(8)
+            << PeakRssMb() << " MB peak RSS" << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+  REQUIRE(events > 0);
+}
+
+/**
+ * Add a gene with its ribosome binding site 15 bp upstream, as in the
+ * tests/models scenarios.
+ */
+static void AddGene(Genome &genome, const std::string &name, int start,
+                    int stop) {
+  genome.AddGene(name, start, stop, start - 15, start, 1e7);
+}
+
+TEST_CASE("Macro: three_genes", "[macro]")
+{
+    //tests/models/three_genes.yml
+    Model model(8e-16);
+    model.seed(34);
+    model.AddPolymerase("rnapol", 10, 40, 10);
+    model.AddRibosome(10, 30, 100);
+    auto genome = std::make_shared<Genome>("T7", 605);
+    genome->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    AddGene(*genome, "rnapol", 26, 225);
+    AddGene(*genome, "proteinX", 241, 280);
+    AddGene(*genome, "proteinY", 296, 595);
+    genome->AddTerminator("t1", 604, 605, {{"rnapol", 1.0}});
+    model.RegisterGenome(genome);
+    RunScenario("three_genes", model, 60, 1);
+}
+
+TEST_CASE("Macro: readthrough", "[macro]")
+{
+    //tests/models/readthrough.yml
+    Model model(8e-16);
+    model.seed(34);
+    model.AddPolymerase("rnapol", 10, 40, 10);
+    model.AddRibosome(10, 30, 100);
+    auto genome = std::make_shared<Genome>("T7", 615);
+    genome->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    AddGene(*genome, "rnapol", 26, 225);
+    AddGene(*genome, "proteinX", 241, 280);
+    genome->AddTerminator("t2", 289, 290, {{"rnapol", 0.6}});
+    AddGene(*genome, "proteinY", 306, 605);
+    genome->AddTerminator("t1", 614, 615, {{"rnapol", 1.0}});
+    model.RegisterGenome(genome);
+    RunScenario("readthrough", model, 60, 1);
+}
+
+TEST_CASE("Macro: dual_polymerases", "[macro]")
+{
+    //tests/models/dual_polymerases.yml
+    Model model(8e-16);
+    model.seed(34);
+    model.AddPolymerase("rnapol", 10, 40, 0);
+    model.AddPolymerase("ecoli", 10, 40, 10);
+    model.AddRibosome(10, 30, 100);
+    auto genome = std::make_shared<Genome>("T7", 615);
+    genome->AddPromoter("phi1", 1, 10, {{"ecoli", 2e7}});
+    AddGene(*genome, "rnapol", 26, 225);
+    AddGene(*genome, "proteinX", 241, 280);
+    genome->AddPromoter("phi10", 281, 290, {{"rnapol", 2e8}});
+    AddGene(*genome, "proteinY", 306, 605);
+    genome->AddTerminator("t1", 614, 615, {{"rnapol", 1.0}, {"ecoli", 1.0}});
+    model.RegisterGenome(genome);
+    RunScenario("dual_polymerases", model, 60, 1);
+}
+
+TEST_CASE("Macro: lotka_voltera", "[macro]")
+{
+    //tests/models/lotka_voltera.yml, which only has species reactions
+    Model model(1.6605390285703877e-24);
+    model.seed(34);
+    model.AddSpecies("speciesX", 100000);
+    model.AddSpecies("speciesY1", 1000);
+    model.AddSpecies("speciesY2", 1000);
+    model.AddSpecies("speciesZ", 0);
+    model.AddReaction(0.0001, {"speciesX", "speciesY1"},
+                      {"speciesY1", "speciesY1"});
+    model.AddReaction(0.01, {"speciesY1", "speciesY2"},
+                      {"speciesY2", "speciesY2"});
+    model.AddReaction(10, {"speciesY2"}, {"speciesZ"});
+    RunScenario("lotka_voltera", model, 20, 1);
+}
+
+TEST_CASE("Macro: degrade", "[macro]")
+{
+    //tests/models/degrade_test.py, with transcript degradation by RNases
+    Model model(8e-16);
+    model.seed(34);
+    model.AddPolymerase("rnapol", 10, 30, 10);
+    model.AddRibosome(10, 20, 100);
+    auto genome = std::make_shared<Genome>("T7", 305, 1e-2, 20, 9, 1e-2);
+    genome->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    genome->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    genome->AddGene("proteinX", 30, 99, 20, 30, 1e7);
+    genome->AddGene("proteinY", 120, 199, 110, 120, 1e7);
+    genome->AddGene("proteinZ", 220, 300, 210, 220, 1e7);
+    model.RegisterGenome(genome);
+    RunScenario("degrade", model, 500, 1);
+}
+
+TEST_CASE("Macro: phage", "[macro]")
+{
+    //examples/phage_model.yml, the T7 infection model built from the
+    //annotations of examples/T7_genome.gb, for the first 300 s
+    auto file = ModelFile::Load(PINETREE_SOURCE_DIR "/examples/phage_model.yml");
+    RunScenario("phage", *file.model(), 300, 5);
+}
@@ -0,0 +1,145 @@
+#include "lib/catch.hpp"
+
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "annotations.hpp"
+#include "choices.hpp"
+#include "feature.hpp"
+#include "model.hpp"
+#include "model_file.hpp"
+#include "output.hpp"
+#include "polymer.hpp"
+#include "tracker.hpp"
+
+TEST_CASE("Random::WeightedChoiceIndex", "[micro]")
+{
+    Random rng;
+    rng.seed(34);
+    for (int size : {10, 100, 1000}) {
+        std::vector<int> population(size);
+        std::iota(population.begin(), population.end(), 0);
+        std::vector<double> weights(size, 1.0);
+        BENCHMARK("WeightedChoiceIndex of " + std::to_string(size)) {
+            return rng.WeightedChoiceIndex(population, weights);
+        };
+    }
+}
+
+TEST_CASE("MobileElementManager::Insert and Choose", "[micro]")
+{
+    const int elements = 100;
+    auto weights = std::make_shared<const std::vector<double>>(
+        std::vector<double>(elements * 20, 1.0));
+
+    BENCHMARK_ADVANCED("Insert 100 elements")(
+        Catch::Benchmark::Chronometer meter) {
+        std::vector<MobileElementManager> managers(meter.runs(),
+                                                   MobileElementManager(weights));
+        std::vector<std::vector<MobileElement::Ptr>> pols(meter.runs());
+        for (auto &run : pols) {
+            //Insert out of order so that elements must be placed
+            for (int i = 0; i < elements; i++) {
+                auto pol = std::make_shared<Polymerase>("rnapol", 10, 40);
+                int slot = (i * 37) % elements;
+                pol->start(slot * 20 + 1);
+                pol->stop(slot * 20 + 10);
+                run.push_back(pol);
+            }
+        }
+        meter.measure([&](int run) {
+            for (const auto &pol : pols[run]) {
+                managers[run].Insert(pol, Polymer::Ptr());
+            }
+            return managers[run].pol_count();
+        });
+    };
+
+    MobileElementManager manager(weights);
+    for (int i = 0; i < elements; i++) {
+        auto pol = std::make_shared<Polymerase>("rnapol", 10, 40);
+        pol->start(i * 20 + 1);
+        pol->stop(i * 20 + 10);
+        manager.Insert(pol, Polymer::Ptr());
+    }
+    Random rng;
+    rng.seed(34);
+    BENCHMARK("Choose among 100 elements") {
+        return manager.Choose(rng);
+    };
+}
+
+/**
+ * Build a registered genome with a single gene covering most of its length.
+ */
+static Genome::Ptr MakeGenome(Model &model, int length) {
+    auto genome = std::make_shared<Genome>("T7", length);
+    genome->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    genome->AddTerminator("t1", length - 1, length, {{"rnapol", 1.0}});
+    genome->AddGene("proteinX", 41, length - 10, 26, 41, 1e7);
+    model.RegisterGenome(genome);
+    return genome;
+}
+
+TEST_CASE("Polymer::Move", "[micro]")
+{
+    Model model(8e-16);
+    auto genome = MakeGenome(model, 100000);
+    auto bind = [&genome]() {
+        genome->Bind(std::make_shared<Polymerase>("rnapol", 10, 40), "phi1");
+    };
+    bind();
+    BENCHMARK("Move a polymerase") {
+        //Start over once the polymerase runs off the end
+        if (genome->num_attached() == 0) {
+            bind();
+        }
+        genome->Move(0);
+        return genome->num_attached();
+    };
+}
+
+TEST_CASE("Genome::BuildTranscript", "[micro]")
+{
+    Model model(8e-16);
+    auto genome = MakeGenome(model, 10000);
+    BENCHMARK("Build a 10 kb transcript") {
+        return genome->BuildTranscript(11, 10000);
+    };
+}
+
+TEST_CASE("SpeciesTracker::Increment", "[micro]")
+{
+    Model model(8e-16);
+    model.AddSpecies("A", 1000);
+    model.AddSpecies("B", 1000);
+    model.AddReaction(1.0, {"A", "B"}, {"C"});
+    model.AddReaction(1.0, {"A"}, {"B"});
+    model.SimulateToTable(0, 1, "direct");
+    auto tracker = model.tracker();
+    int id = tracker->SpeciesId("A");
+    int sign = 1;
+    BENCHMARK("Increment a species with two reactions") {
+        sign = -sign;
+        tracker->Increment(id, sign);
+        return tracker->species(id);
+    };
+    BENCHMARK("Increment a species by name") {
+        sign = -sign;
+        tracker->Increment("A", sign);
+        return tracker->species(id);
+    };
+}
+
+TEST_CASE("Genome annotations", "[micro]")
+{
+    const std::string path = PINETREE_SOURCE_DIR "/examples/T7_genome.gb";
+    BENCHMARK("Parse T7_genome.gb") {
+        return AnnotationFile::Load(path).features.size();
+    };
+    BENCHMARK("Build the phage model") {
+        return ModelFile::Load(PINETREE_SOURCE_DIR "/examples/phage_model.yml")
+            .runtime();
+    };
+}
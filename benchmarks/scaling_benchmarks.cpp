@@ -0,0 +1,164 @@
+#include "lib/catch.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "model.hpp"
+#include "output.hpp"
+#include "synthetic_model.hpp"
+
+/**
+ * Simulate synthetic models that differ along one axis of their shape, and
+ * report for each the events executed per second of wall time, the
+ * estimated memory of the model at the end (see Model::memory_report) and
+ * the wall time per transcript made.
+ *
+ * @param axis name of the axis
+ * @param values values of the axis
+ * @param apply sets a value of the axis on a shape
+ */
+static void Sweep(const std::string &axis, const std::vector<double> &values,
+                  const std::function<void(SyntheticModel &, double)> &apply,
+                  SyntheticModel shape = SyntheticModel(),
+                  int time_limit = 60) {
+  std::cout << "Scaling with " << axis << std::endl;
+  for (double value : values) {
+    apply(shape, value);
+    auto model = BuildSyntheticModel(shape);
+    auto started = std::chrono::steady_clock::now();
+    model->SimulateToTable(time_limit, time_limit, "direct");
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - started)
+                         .count();
+    const auto &stats = model->stats();
+    long long events =
+        std::accumulate(stats.events.begin(), stats.events.end(), 0LL) +
+        stats.leaps;
+    long long transcripts = model->polymer_stats().transcripts_created;
+    double memory = model->memory_report().total() / (1024.0 * 1024.0);
+    std::cout << std::setw(12) << value << std::setw(12) << events
+              << " events  " << std::fixed << std::setprecision(3)
+              << std::setw(9) << seconds << " s  " << std::setprecision(0)
+              << std::setw(12) << events / seconds << " events/s  "
+              << std::setprecision(2) << std::setw(8) << memory << " MB  "
+              << std::setprecision(1) << std::setw(10)
+              << (transcripts > 0 ? 1e6 * seconds / transcripts : 0.0)
+              << " us/transcript" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(6);
+    REQUIRE(events > 0);
+  }
+}
+
+TEST_CASE("Scaling: genome length", "[scaling]")
+{
+    //One gene per kb, with a promoter and a terminator every 5 genes
+    Sweep("genome length (bp)", {5000, 10000, 20000, 40000, 80000},
+          [](SyntheticModel &shape, double value) {
+              shape.length = value;
+              shape.genes = value / 1000;
+              shape.promoters = shape.genes / 5;
+              shape.terminators = shape.genes / 5;
+          });
+}
+
+TEST_CASE("Scaling: gene count", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 40000;
+    Sweep("genes", {5, 10, 20, 40, 80},
+          [](SyntheticModel &shape, double value) { shape.genes = value; },
+          shape);
+}
+
+TEST_CASE("Scaling: promoter density", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 40000;
+    shape.genes = 40;
+    Sweep("promoters", {1, 5, 10, 20, 40},
+          [](SyntheticModel &shape, double value) {
+              shape.promoters = value;
+          },
+          shape);
+}
+
+TEST_CASE("Scaling: terminator density", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 40000;
+    shape.genes = 40;
+    shape.promoters = 10;
+    Sweep("terminators", {1, 5, 10, 20, 40},
+          [](SyntheticModel &shape, double value) {
+              shape.terminators = value;
+          },
+          shape);
+}
+
+TEST_CASE("Scaling: RNase site density", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 20000;
+    shape.genes = 20;
+    shape.promoters = 5;
+    shape.terminators = 5;
+    Sweep("RNase sites", {0, 1, 5, 10, 20},
+          [](SyntheticModel &shape, double value) {
+              shape.rnase_sites = value;
+          },
+          shape, 300);
+}
+
+TEST_CASE("Scaling: codon weight variance", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 20000;
+    shape.genes = 20;
+    Sweep("log-normal sigma of codon weights", {0, 0.25, 0.5, 1, 2},
+          [](SyntheticModel &shape, double value) {
+              shape.weight_sigma = value;
+          },
+          shape);
+}
+
+TEST_CASE("Scaling: polymerase pool", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 20000;
+    shape.genes = 20;
+    shape.promoters = 5;
+    Sweep("polymerases", {5, 10, 20, 40, 80},
+          [](SyntheticModel &shape, double value) {
+              shape.polymerases = value;
+          },
+          shape);
+}
+
+TEST_CASE("Scaling: ribosome pool", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.length = 20000;
+    shape.genes = 20;
+    shape.promoters = 5;
+    Sweep("ribosomes", {50, 100, 200, 400, 800},
+          [](SyntheticModel &shape, double value) {
+              shape.ribosomes = value;
+          },
+          shape);
+}
+
+TEST_CASE("Scaling: genome copies", "[scaling]")
+{
+    SyntheticModel shape;
+    shape.genes = 10;
+    shape.promoters = 2;
+    Sweep("genome copies", {1, 2, 4, 8, 16},
+          [](SyntheticModel &shape, double value) { shape.copies = value; },
+          shape);
+}
@@ -0,0 +1,73 @@
+#include "synthetic_model.hpp"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "polymer.hpp"
+
+/**
+ * Does region i of count regions get one of n features spread evenly over
+ * them, counting from the first region (or from the last if from_end)?
+ */
+static bool Spread(int i, int count, int n, bool from_end) {
+  if (from_end) {
+    return (long long)(i + 1) * n / count != (long long)i * n / count;
+  }
+  return i == 0 ? n > 0
+                : (long long)i * n / count != (long long)(i - 1) * n / count;
+}
+
+std::shared_ptr<Model> BuildSyntheticModel(const SyntheticModel &shape) {
+  // Promoter, RNase site and RBS before the gene, and a terminator after
+  const int region = shape.genes > 0 ? shape.length / shape.genes : 0;
+  if (region < 60) {
+    throw std::invalid_argument(
+        "Synthetic genes need regions of at least 60 bp.");
+  }
+  auto model = std::make_shared<Model>(8e-16);
+  model->seed(shape.seed);
+  // About the speed of T7 RNA polymerase, so that even long genomes make
+  // many transcripts in a short run
+  model->AddPolymerase("rnapol", 10, 200, shape.polymerases);
+  model->AddRibosome(10, 30, shape.ribosomes);
+  auto genome =
+      shape.rnase_sites > 0
+          ? std::make_shared<Genome>("synthetic", shape.length, 0.0, 20, 10,
+                                     1e-2)
+          : std::make_shared<Genome>("synthetic", shape.length);
+  for (int i = 0; i < shape.genes; i++) {
+    int start = i * region;
+    int stop = start + region;
+    if (Spread(i, shape.genes, shape.promoters, false)) {
+      genome->AddPromoter("p" + std::to_string(i), start + 1, start + 10,
+                          {{"rnapol", 2e8}});
+    }
+    if (Spread(i, shape.genes, shape.rnase_sites, false)) {
+      genome->AddRnaseSite(start + 11, start + 20);
+    }
+    genome->AddGene("gene" + std::to_string(i), start + 36, stop - 10,
+                    start + 21, start + 36, 1e7);
+    if (Spread(i, shape.genes, shape.terminators, true)) {
+      genome->AddTerminator("t" + std::to_string(i), stop - 5, stop - 4,
+                            {{"rnapol", 1.0}});
+    }
+  }
+  if (shape.weight_sigma > 0) {
+    std::mt19937 gen(shape.seed);
+    std::lognormal_distribution<double> dis(
+        -shape.weight_sigma * shape.weight_sigma / 2, shape.weight_sigma);
+    std::vector<double> weights(shape.length);
+    for (int i = 0; i < shape.length; i += 3) {
+      double weight = dis(gen);
+      for (int j = i; j < std::min(i + 3, shape.length); j++) {
+        weights[j] = weight;
+      }
+    }
+    genome->AddWeights(weights);
+  }
+  model->RegisterGenome(genome, shape.copies);
+  return model;
+}
@@ -0,0 +1,49 @@
+#ifndef BENCHMARKS_SYNTHETIC_MODEL_HPP  // header guard
+#define BENCHMARKS_SYNTHETIC_MODEL_HPP
+
+#include <memory>
+
+#include "model.hpp"
+
+/**
+ * Shape of a synthetic model, for measuring how the engine scales with the
+ * size of a genome and the density of its features. Genes are laid out
+ * evenly along the genome, each in a region of length / genes bp holding
+ * (in order) an optional promoter, an optional RNase site, the ribosome
+ * binding site, the gene and an optional terminator. Promoters, RNase sites
+ * and terminators are spread evenly over the regions, with a promoter in
+ * the first region and a terminator in the last.
+ */
+struct SyntheticModel {
+  int length = 10000;
+  int genes = 10;
+  int promoters = 1;
+  int terminators = 1;
+  int rnase_sites = 0;
+  /**
+   * Standard deviation of the logarithm of the translation weight of each
+   * codon, drawn from a log-normal distribution with a mean of 1, or 0 for
+   * uniform weights.
+   */
+  double weight_sigma = 0;
+  int polymerases = 10;
+  int ribosomes = 100;
+  /**
+   * Number of copies of the genome registered with the model.
+   */
+  int copies = 1;
+  /**
+   * Seed of the model and of the codon weights.
+   */
+  int seed = 34;
+};
+
+/**
+ * Build a model with the given shape.
+ *
+ * @throws std::invalid_argument if the regions of the genes are too short
+ *  for their features
+ */
+std::shared_ptr<Model> BuildSyntheticModel(const SyntheticModel &shape);
+
+#endif  // header guard
@@ -0,0 +1,250 @@
+#include "lib/catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "distribution_tests.hpp"
+#include "model.hpp"
+#include "model_file.hpp"
+#include "output.hpp"
+
+/**
+ * A way of simulating a model that should give the same distribution of
+ * trajectories as the direct method. Approximate engines (e.g. tau-leaping)
+ * are reported but not required to agree.
+ */
+struct Engine {
+  std::string name;
+  std::string method;
+  bool run_ahead;
+  bool skip_blocked;
+  bool fast_random;
+  bool exact;
+};
+
+static const std::vector<Engine> ENGINES = {
+    {"direct_linear", "direct_linear", false, false, false, true},
+    {"composition_rejection", "composition_rejection", false, false, false,
+     true},
+    {"next_reaction", "next_reaction", false, false, false, true},
+    {"run_ahead", "direct", true, false, false, true},
+    {"skip_blocked", "direct", false, true, false, true},
+    {"fast_random", "direct", false, false, true, true},
+    {"hybrid", "hybrid", false, false, false, false},
+};
+
+/**
+ * Counts of every species at some time points over many seeds, as
+ * samples[quantity + species][time point][seed].
+ */
+struct Samples {
+  std::map<std::string, std::vector<std::vector<double>>> values;
+  double seconds = 0;
+};
+
+/**
+ * Number of seeds per engine, 50 unless PINETREE_VALIDATION_SEEDS is set.
+ */
+static int SeedCount() {
+  const char *seeds = std::getenv("PINETREE_VALIDATION_SEEDS");
+  return seeds != nullptr ? std::max(4, std::atoi(seeds)) : 50;
+}
+
+/**
+ * Simulate a model file with an engine for seeds first, ..., first + count
+ * - 1, recording protein and transcript counts at four evenly spaced time
+ * points.
+ */
+static Samples Simulate(const std::string &path, const Engine &engine,
+                        int first, int count) {
+  Samples samples;
+  for (int seed = first; seed < first + count; seed++) {
+    auto file = ModelFile::Load(path);
+    auto model = file.model();
+    std::vector<double> times;
+    for (int k = 1; k <= 4; k++) {
+      times.push_back(file.runtime() * k / 4.0);
+    }
+    model->seed(seed);
+    model->run_ahead(engine.run_ahead);
+    model->skip_blocked(engine.skip_blocked);
+    model->fast_random(engine.fast_random);
+    auto started = std::chrono::steady_clock::now();
+    CountsTable table = model->SimulateToTableAt(times, engine.method);
+    samples.seconds += std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - started)
+                           .count();
+    int columns = table.species.size();
+    for (int column = 0; column < columns; column++) {
+      for (const std::string quantity : {"protein ", "transcript "}) {
+        const auto &counts =
+            quantity == "protein " ? table.protein : table.transcript;
+        auto &series = samples.values[quantity + table.species[column]];
+        series.resize(times.size());
+        for (std::size_t row = 0; row < table.time.size(); row++) {
+          series[row].push_back(counts[row * columns + column]);
+        }
+      }
+    }
+  }
+  // Species that did not appear in a run had a count of 0 in it
+  for (auto &series : samples.values) {
+    for (auto &point : series.second) {
+      point.resize(count, 0.0);
+    }
+  }
+  return samples;
+}
+
+/**
+ * Run a model file under every engine, comparing the distribution of each
+ * count at each time point with that of the direct method (on other seeds)
+ * by Kolmogorov-Smirnov and Anderson-Darling tests. An engine agrees if the
+ * smallest p-value, times the number of comparisons (Bonferroni), is at
+ * least 0.001.
+ */
+static void Validate(const std::string &name) {
+  const std::string path =
+      PINETREE_SOURCE_DIR "/tests/models/" + name + ".yml";
+  const int seeds = SeedCount();
+  const Engine direct = {"direct", "direct", false, false, false, true};
+  Samples reference = Simulate(path, direct, 1, seeds);
+  std::cout << name << " (" << seeds << " seeds per engine)" << std::endl;
+  for (const auto &engine : ENGINES) {
+    Samples samples;
+    try {
+      samples = Simulate(path, engine, seeds + 1, seeds);
+    } catch (const std::exception &error) {
+      std::cout << "  " << std::left << std::setw(22) << engine.name
+                << std::right << " failed: " << error.what() << std::endl;
+      if (engine.exact) {
+        FAIL(engine.name + " failed: " + error.what());
+      }
+      continue;
+    }
+    int comparisons = 0;
+    double ks_p = 1, ad_p = 1;
+    for (const auto &series : reference.values) {
+      auto other = samples.values.find(series.first);
+      for (std::size_t point = 0; point < series.second.size(); point++) {
+        std::vector<double> values =
+            other != samples.values.end()
+                ? other->second[point]
+                : std::vector<double>(seeds, 0.0);
+        const auto &expected = series.second[point];
+        if (*std::min_element(expected.begin(), expected.end()) ==
+                *std::max_element(expected.begin(), expected.end()) &&
+            expected == values) {
+          continue;
+        }
+        comparisons++;
+        ks_p = std::min(ks_p, KolmogorovSmirnov(expected, values).p_value);
+        ad_p = std::min(ad_p, AndersonDarling(expected, values).p_value);
+      }
+    }
+    double adjusted = std::min(1.0, std::min(ks_p, ad_p) * comparisons);
+    bool agrees = adjusted >= 0.001;
+    std::cout << "  " << std::left << std::setw(22) << engine.name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(7) << reference.seconds / samples.seconds
+              << "x speedup  " << std::setw(4) << comparisons
+              << " comparisons  min p KS " << std::scientific
+              << std::setprecision(1) << ks_p << "  AD " << ad_p
+              << "  adjusted " << adjusted << "  "
+              << (agrees ? "agrees" : engine.exact ? "DIFFERS"
+                                                   : "differs (approximate)")
+              << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(6);
+    if (engine.exact) {
+      CHECK(agrees);
+    }
+  }
+}
+
+TEST_CASE("Validation: distribution tests", "[validation]")
+{
+    std::mt19937 gen(34);
+    std::poisson_distribution<int> low(20), high(25);
+    std::vector<double> a, b, c;
+    for (int i = 0; i < 200; i++) {
+        a.push_back(low(gen));
+        b.push_back(low(gen));
+        c.push_back(high(gen));
+    }
+    //Same distribution
+    CHECK(KolmogorovSmirnov(a, b).p_value > 0.01);
+    CHECK(AndersonDarling(a, b).p_value > 0.01);
+    //Shifted mean
+    CHECK(KolmogorovSmirnov(a, c).p_value < 1e-4);
+    CHECK(AndersonDarling(a, c).p_value < 1e-4);
+    CHECK(KolmogorovSmirnov(a, a).p_value == 1);
+}
+
+TEST_CASE("Validation: three_genes", "[validation]")
+{
+    Validate("three_genes");
+}
+
+TEST_CASE("Validation: three_genes_recoded", "[validation]")
+{
+    Validate("three_genes_recoded");
+}
+
+TEST_CASE("Validation: three_genes_runoff", "[validation]")
+{
+    Validate("three_genes_runoff");
+}
+
+TEST_CASE("Validation: single_gene", "[validation]")
+{
+    Validate("single_gene");
+}
+
+TEST_CASE("Validation: readthrough", "[validation]")
+{
+    Validate("readthrough");
+}
+
+TEST_CASE("Validation: dual_polymerases", "[validation]")
+{
+    Validate("dual_polymerases");
+}
+
+TEST_CASE("Validation: dual_promoter", "[validation]")
+{
+    Validate("dual_promoter");
+}
+
+TEST_CASE("Validation: consecutive_promoters", "[validation]")
+{
+    Validate("consecutive_promoters");
+}
+
+TEST_CASE("Validation: overlapping_genes", "[validation]")
+{
+    Validate("overlapping_genes");
+}
+
+TEST_CASE("Validation: promoter_gene_overlap", "[validation]")
+{
+    Validate("promoter_gene_overlap");
+}
+
+TEST_CASE("Validation: genome_entry", "[validation]")
+{
+    Validate("genome_entry");
+}
+
+TEST_CASE("Validation: lotka_voltera", "[validation]")
+{
+    Validate("lotka_voltera");
+}
@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "annotations.hpp"
+#include "mapped_file.hpp"
+
+const std::string &Annotation::qualifier(const std::string &key) const {
+  static const std::string empty;
+  for (const auto &entry : qualifiers) {
+    if (entry.first == key) {
+      return entry.second;
+    }
+  }
+  return empty;
+}
+
+bool Annotation::HasQualifier(const std::string &key,
+                              const std::vector<std::string> &values) const {
+  for (const auto &entry : qualifiers) {
+    if (entry.first == key &&
+        std::find(values.begin(), values.end(), entry.second) !=
+            values.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace {
+
+/**
+ * Iterates over the lines of a buffer without copying them.
+ */
+class LineReader {
+ public:
+  LineReader(const char *data, std::size_t size)
+      : pos_(data), end_(data + size) {}
+  bool Next(const char **begin, std::size_t *length) {
+    if (pos_ >= end_) {
+      return false;
+    }
+    const char *newline =
+        static_cast<const char *>(std::memchr(pos_, '\n', end_ - pos_));
+    const char *stop = newline ? newline : end_;
+    *begin = pos_;
+    *length = stop - pos_;
+    if (*length > 0 && (*begin)[*length - 1] == '\r') {
+      (*length)--;
+    }
+    pos_ = newline ? newline + 1 : end_;
+    line_++;
+    return true;
+  }
+  int line() const { return line_; }
+
+ private:
+  const char *pos_;
+  const char *end_;
+  int line_ = 0;
+};
+
+std::string Trim(const std::string &text) {
+  std::size_t start = text.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return text.substr(start, text.find_last_not_of(" \t") - start + 1);
+}
+
+void AppendBases(const char *begin, std::size_t length, std::string *sequence) {
+  for (std::size_t i = 0; i < length; i++) {
+    if (std::isalpha(static_cast<unsigned char>(begin[i]))) {
+      *sequence += std::toupper(static_cast<unsigned char>(begin[i]));
+    }
+  }
+}
+
+/**
+ * Parse a GenBank location such as "12..200", "complement(<5..>90)" or
+ * "join(1..10,20..30)" into the span it covers.
+ */
+void ParseLocation(const std::string &location, int line,
+                   Annotation *feature) {
+  feature->complement = location.find("complement(") != std::string::npos;
+  bool found = false;
+  for (std::size_t i = 0; i < location.size();) {
+    if (!std::isdigit(static_cast<unsigned char>(location[i]))) {
+      i++;
+      continue;
+    }
+    char *end = nullptr;
+    int position = std::strtol(location.c_str() + i, &end, 10);
+    i = end - location.c_str();
+    feature->start = found ? std::min(feature->start, position) : position;
+    feature->stop = found ? std::max(feature->stop, position) : position;
+    found = true;
+  }
+  if (!found) {
+    throw std::runtime_error("line " + std::to_string(line) +
+                             ": could not parse location '" + location +
+                             "'.");
+  }
+}
+
+/**
+ * Decode the %XX escapes of GFF3 attributes.
+ */
+std::string PercentDecode(const std::string &text) {
+  std::string decoded;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '%' && i + 2 < text.size() &&
+        std::isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+        std::isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+      decoded += static_cast<char>(
+          std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+std::vector<std::string> Split(const std::string &text, char separator) {
+  std::vector<std::string> fields;
+  std::size_t start = 0;
+  while (true) {
+    std::size_t stop = text.find(separator, start);
+    fields.push_back(text.substr(start, stop - start));
+    if (stop == std::string::npos) {
+      return fields;
+    }
+    start = stop + 1;
+  }
+}
+
+}  // namespace
+
+AnnotationFile AnnotationFile::Load(const std::string &path) {
+  MappedFile file(path, "annotation file");
+  const char *data = file.data();
+  std::size_t size = file.size();
+  std::size_t start = 0;
+  while (start < size && std::isspace(static_cast<unsigned char>(data[start]))) {
+    start++;
+  }
+  try {
+    if (size - start >= 5 && std::strncmp(data + start, "LOCUS", 5) == 0) {
+      return ParseGenbank(data, size);
+    } else if (size - start >= 5 &&
+               std::strncmp(data + start, "##gff", 5) == 0) {
+      return ParseGff(data, size);
+    } else if (start < size && data[start] == '>') {
+      return ParseFasta(data, size);
+    }
+  } catch (const std::runtime_error &error) {
+    throw std::runtime_error(path + ": " + error.what());
+  }
+  throw std::runtime_error("'" + path +
+                           "' is not a GenBank, GFF3 or FASTA file.");
+}
+
+AnnotationFile AnnotationFile::ParseGenbank(const char *data,
+                                            std::size_t size) {
+  AnnotationFile file;
+  LineReader reader(data, size);
+  const char *begin;
+  std::size_t length;
+  enum { HEADER, FEATURES, ORIGIN } section = HEADER;
+  // Location of the current feature, which may span lines, and the
+  // qualifier being read, whose quoted value may span lines
+  std::string location;
+  int location_line = 0;
+  bool in_value = false;
+  auto finish_location = [&]() {
+    if (!location.empty()) {
+      ParseLocation(location, location_line, &file.features.back());
+      location.clear();
+    }
+  };
+  while (reader.Next(&begin, &length)) {
+    std::string line(begin, length);
+    if (section == ORIGIN) {
+      if (line.compare(0, 2, "//") == 0) {
+        break;
+      }
+      AppendBases(begin, length, &file.sequence);
+      continue;
+    }
+    if (line.compare(0, 2, "//") == 0) {
+      break;
+    }
+    if (!line.empty() && line[0] != ' ') {
+      // Start of a new section
+      finish_location();
+      in_value = false;
+      std::string keyword = line.substr(0, line.find(' '));
+      if (keyword == "LOCUS") {
+        std::vector<std::string> fields;
+        for (const auto &field : Split(line, ' ')) {
+          if (!field.empty()) {
+            fields.push_back(field);
+          }
+        }
+        if (fields.size() > 1) {
+          file.name = fields[1];
+        }
+        if (fields.size() > 2) {
+          file.length = std::atoi(fields[2].c_str());
+        }
+      }
+      section = keyword == "FEATURES" ? FEATURES
+                                      : keyword == "ORIGIN" ? ORIGIN : HEADER;
+      continue;
+    }
+    if (section != FEATURES || line.size() < 6) {
+      continue;
+    }
+    if (line[5] != ' ') {
+      // Feature key in columns 6-20, location from column 22
+      finish_location();
+      in_value = false;
+      file.features.emplace_back();
+      file.features.back().type = Trim(line.substr(5, 16));
+      location = line.size() > 21 ? Trim(line.substr(21)) : "";
+      location_line = reader.line();
+      continue;
+    }
+    if (file.features.empty()) {
+      continue;
+    }
+    std::string text = Trim(line);
+    auto &qualifiers = file.features.back().qualifiers;
+    if (in_value) {
+      // Continuation of a quoted value. Translations are joined without
+      // spaces, as they are wrapped mid-sequence
+      auto &value = qualifiers.back();
+      if (value.first != "translation") {
+        value.second += ' ';
+      }
+      value.second += text;
+    } else if (!text.empty() && text[0] == '/') {
+      finish_location();
+      std::size_t equals = text.find('=');
+      qualifiers.emplace_back(text.substr(1, equals - 1),
+                              equals == std::string::npos
+                                  ? ""
+                                  : text.substr(equals + 1));
+      in_value = equals + 1 < text.size() && text[equals + 1] == '"';
+      if (in_value) {
+        qualifiers.back().second.erase(0, 1);
+      }
+    } else {
+      location += text;
+      continue;
+    }
+    if (in_value) {
+      // A value ends at an odd number of closing quotes ("" escapes a quote)
+      std::string &value = qualifiers.back().second;
+      std::size_t quotes = 0;
+      while (quotes < value.size() && value[value.size() - 1 - quotes] == '"') {
+        quotes++;
+      }
+      if (quotes % 2 == 1) {
+        value.erase(value.size() - 1);
+        in_value = false;
+      }
+      std::size_t escaped;
+      while (!in_value && (escaped = value.find("\"\"")) != std::string::npos) {
+        value.erase(escaped, 1);
+      }
+    }
+  }
+  finish_location();
+  if (file.length == 0) {
+    file.length = file.sequence.size();
+  }
+  return file;
+}
+
+AnnotationFile AnnotationFile::ParseGff(const char *data, std::size_t size) {
+  AnnotationFile file;
+  LineReader reader(data, size);
+  const char *begin;
+  std::size_t length;
+  bool fasta = false;
+  int max_stop = 0;
+  while (reader.Next(&begin, &length)) {
+    std::string line(begin, length);
+    if (fasta) {
+      if (!line.empty() && line[0] == '>') {
+        if (!file.sequence.empty()) {
+          break;
+        }
+        continue;
+      }
+      AppendBases(begin, length, &file.sequence);
+      continue;
+    }
+    if (line.compare(0, 7, "##FASTA") == 0) {
+      fasta = true;
+      continue;
+    }
+    if (line.compare(0, 17, "##sequence-region") == 0) {
+      std::vector<std::string> fields;
+      for (const auto &field : Split(Trim(line.substr(17)), ' ')) {
+        if (!field.empty()) {
+          fields.push_back(field);
+        }
+      }
+      if (file.name.empty() && fields.size() == 3) {
+        file.name = fields[0];
+        file.length = std::atoi(fields[2].c_str());
+      }
+      continue;
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    auto fields = Split(line, '\t');
+    if (fields.size() != 9) {
+      throw std::runtime_error("line " + std::to_string(reader.line()) +
+                               ": expected 9 tab separated columns.");
+    }
+    if (file.name.empty()) {
+      file.name = fields[0];
+    } else if (fields[0] != file.name) {
+      // Only the first sequence is read
+      continue;
+    }
+    Annotation feature;
+    feature.type = fields[2];
+    feature.start = std::atoi(fields[3].c_str());
+    feature.stop = std::atoi(fields[4].c_str());
+    feature.complement = fields[6] == "-";
+    if (feature.start <= 0 || feature.stop < feature.start) {
+      throw std::runtime_error("line " + std::to_string(reader.line()) +
+                               ": invalid feature coordinates.");
+    }
+    if (fields[8] != ".") {
+      for (const auto &attribute : Split(fields[8], ';')) {
+        std::size_t equals = attribute.find('=');
+        if (attribute.empty() || equals == std::string::npos) {
+          continue;
+        }
+        std::string key = PercentDecode(Trim(attribute.substr(0, equals)));
+        for (const auto &value : Split(attribute.substr(equals + 1), ',')) {
+          feature.qualifiers.emplace_back(key, PercentDecode(value));
+        }
+      }
+    }
+    max_stop = std::max(max_stop, feature.stop);
+    file.features.push_back(std::move(feature));
+  }
+  if (file.length == 0) {
+    file.length = file.sequence.empty() ? max_stop : file.sequence.size();
+  }
+  return file;
+}
+
+AnnotationFile AnnotationFile::ParseFasta(const char *data, std::size_t size) {
+  AnnotationFile file;
+  LineReader reader(data, size);
+  const char *begin;
+  std::size_t length;
+  bool header = false;
+  while (reader.Next(&begin, &length)) {
+    if (length > 0 && begin[0] == '>') {
+      if (header) {
+        break;
+      }
+      header = true;
+      std::string text = Trim(std::string(begin + 1, length - 1));
+      file.name = text.substr(0, text.find_first_of(" \t"));
+      continue;
+    }
+    AppendBases(begin, length, &file.sequence);
+  }
+  file.length = file.sequence.size();
+  return file;
+}
+
+bool AnnotationRule::Matches(const Annotation &feature) const {
+  if (!type.empty() && type != feature.type) {
+    return false;
+  }
+  for (const auto &condition : match) {
+    if (!feature.HasQualifier(condition.first, condition.second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int AnnotationRules::Apply(const AnnotationFile &file, Genome &genome) const {
+  int added = 0;
+  // Genes are usually the most numerous features, so define them in one step
+  std::vector<std::string> gene_names;
+  std::vector<int> gene_starts, gene_stops, rbs_starts, rbs_stops;
+  std::vector<double> rbs_strengths;
+  for (const auto &feature : file.features) {
+    if (feature.complement) {
+      continue;
+    }
+    auto rule = std::find_if(
+        rules.begin(), rules.end(),
+        [&feature](const AnnotationRule &rule) { return rule.Matches(feature); });
+    if (rule == rules.end() || rule->action == AnnotationRule::IGNORE) {
+      continue;
+    }
+    std::string name = rule->name;
+    for (auto key = name_qualifiers.begin();
+         name.empty() && key != name_qualifiers.end(); key++) {
+      name = feature.qualifier(*key);
+    }
+    if (name.empty()) {
+      name = feature.type + "_" + std::to_string(feature.start);
+    }
+    int start = feature.start;
+    int stop = feature.stop;
+    switch (rule->action) {
+      case AnnotationRule::PROMOTER:
+        if (stop - start + 1 < rule->min_length) {
+          start = std::max(1, stop - rule->min_length + 1);
+        }
+        genome.AddPromoter(name, start, stop, rule->interactions);
+        break;
+      case AnnotationRule::TERMINATOR:
+        genome.AddTerminator(name, start, stop, rule->interactions);
+        break;
+      case AnnotationRule::GENE:
+        gene_names.push_back(name);
+        gene_starts.push_back(start);
+        gene_stops.push_back(stop);
+        rbs_starts.push_back(start + rule->rbs_offset);
+        rbs_stops.push_back(start);
+        rbs_strengths.push_back(rule->rbs_strength);
+        break;
+      case AnnotationRule::RNASE_SITE:
+        if (rule->rate > 0) {
+          genome.AddRnaseSite(name, start, stop, rule->rate);
+        } else {
+          genome.AddRnaseSite(start, stop);
+        }
+        break;
+      case AnnotationRule::IGNORE:
+        break;
+    }
+    added++;
+  }
+  if (!gene_names.empty()) {
+    genome.AddGenes(gene_names, gene_starts, gene_stops, rbs_starts,
+                    rbs_stops, rbs_strengths);
+  }
+  if (!codon_weights.empty()) {
+    genome.AddWeights(CodonWeights(file));
+  }
+  return added;
+}
+
+std::vector<double> AnnotationRules::CodonWeights(
+    const AnnotationFile &file) const {
+  if (file.sequence.empty()) {
+    throw std::runtime_error("Codon weights need the genome sequence.");
+  }
+  std::vector<double> weights(file.length, 0.0);
+  double total = 0;
+  int coding = 0;
+  for (const auto &feature : file.features) {
+    if (feature.type != coding_type || feature.complement) {
+      continue;
+    }
+    int frame = std::max(1, std::atoi(feature.qualifier("codon_start").c_str()));
+    int stop = std::min<int>(feature.stop, file.sequence.size());
+    for (int pos = feature.start + frame - 1; pos + 2 <= stop; pos += 3) {
+      auto weight = codon_weights.find(file.sequence.substr(pos - 1, 3));
+      double value = weight == codon_weights.end() ? default_codon_weight
+                                                   : weight->second;
+      for (int i = pos; i < pos + 3 && i <= file.length; i++) {
+        if (weights[i - 1] == 0.0) {
+          coding++;
+        }
+        total += value - weights[i - 1];
+        weights[i - 1] = value;
+      }
+    }
+  }
+  // Normalize to a mean of 1 over coding positions; other positions get 1
+  double mean = coding > 0 ? total / coding : 1.0;
+  for (auto &weight : weights) {
+    weight = weight == 0.0 ? 1.0 : weight / mean;
+  }
+  return weights;
+}
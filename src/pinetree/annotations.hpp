@@ -0,0 +1,155 @@
+#ifndef SRC_ANNOTATIONS_HPP  // header guard
+#define SRC_ANNOTATIONS_HPP
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "polymer.hpp"
+
+/**
+ * A feature of an annotated genome, in 1-based inclusive coordinates.
+ */
+struct Annotation {
+  /**
+   * Feature key (GenBank) or type (GFF), e.g. "gene" or "regulatory".
+   */
+  std::string type;
+  int start = 0;
+  int stop = 0;
+  /**
+   * Whether the feature is on the reverse strand.
+   */
+  bool complement = false;
+  /**
+   * Qualifiers (GenBank) or attributes (GFF) in file order. Keys may repeat.
+   */
+  std::vector<std::pair<std::string, std::string>> qualifiers;
+  /**
+   * First value of a qualifier, or an empty string if it is missing.
+   */
+  const std::string &qualifier(const std::string &key) const;
+  /**
+   * Whether any value of a qualifier is one of the given values.
+   */
+  bool HasQualifier(const std::string &key,
+                    const std::vector<std::string> &values) const;
+};
+
+/**
+ * Features and sequence of an annotated genome file, read in one pass over
+ * the memory-mapped file. Load detects the format from the first line:
+ * GenBank flat files (LOCUS), GFF3 with an optional ##FASTA section
+ * (##gff-version), or plain FASTA (>), which has a sequence but no
+ * features. Only the first record of multi-record files is read.
+ */
+struct AnnotationFile {
+  /**
+   * LOCUS name (GenBank), sequence ID (GFF), or first word of the header
+   * (FASTA).
+   */
+  std::string name;
+  /**
+   * Length of the genome in bases.
+   */
+  int length = 0;
+  /**
+   * Upper case sequence, empty if the file has none.
+   */
+  std::string sequence;
+  std::vector<Annotation> features;
+  /**
+   * Read an annotation file, throwing std::runtime_error if it cannot be
+   * opened or parsed.
+   */
+  static AnnotationFile Load(const std::string &path);
+  static AnnotationFile ParseGenbank(const char *data, std::size_t size);
+  static AnnotationFile ParseGff(const char *data, std::size_t size);
+  static AnnotationFile ParseFasta(const char *data, std::size_t size);
+};
+
+/**
+ * Maps annotated features to genome elements. The first rule that matches a
+ * feature decides what it becomes; features that match no rule, and
+ * features on the reverse strand, are skipped.
+ */
+struct AnnotationRule {
+  enum Action { PROMOTER, TERMINATOR, GENE, RNASE_SITE, IGNORE };
+  Action action = IGNORE;
+  /**
+   * Feature type to match, or empty to match any type.
+   */
+  std::string type;
+  /**
+   * Qualifiers that must have one of the listed values for the rule to
+   * match.
+   */
+  std::vector<std::pair<std::string, std::vector<std::string>>> match;
+  /**
+   * Name of the element, or empty to name it after the feature.
+   */
+  std::string name;
+  /**
+   * Binding constants of promoters, or efficiencies of terminators, by
+   * polymerase name.
+   */
+  std::map<std::string, double> interactions;
+  /**
+   * Promoters shorter than this are extended upstream to this length, since
+   * many annotations only mark the transcription start site.
+   */
+  int min_length = 0;
+  /**
+   * Start of a gene's ribosome binding site relative to the gene's start.
+   * The site ends at the gene's start.
+   */
+  int rbs_offset = -30;
+  double rbs_strength = 1e7;
+  /**
+   * Degradation rate constant of an RNase site, or 0 to use the genome's
+   * transcript_degradation_rate.
+   */
+  double rate = 0.0;
+  bool Matches(const Annotation &feature) const;
+};
+
+/**
+ * Rules for building a genome from an AnnotationFile, with optional codon
+ * weights for the translation speed at each position.
+ */
+struct AnnotationRules {
+  std::vector<AnnotationRule> rules;
+  /**
+   * Qualifiers to name elements after, in order of preference.
+   */
+  std::vector<std::string> name_qualifiers = {"gene", "locus_tag", "note"};
+  /**
+   * Relative translation speed of codons, e.g. {"GCT": 2.0}. If set, each
+   * codon of the coding features gets its weight (or default_codon_weight
+   * if it is not listed), and the weights are normalized to a mean of 1
+   * over coding positions; other positions get 1.
+   */
+  std::map<std::string, double> codon_weights;
+  double default_codon_weight = 1.0;
+  /**
+   * Feature type of coding sequences for codon weights.
+   */
+  std::string coding_type = "CDS";
+  /**
+   * Add the elements of matching features, and the codon weights, to a
+   * genome.
+   *
+   * @param file annotations, which must fit in the genome
+   * @param genome genome to add elements to
+   * @return number of elements added
+   */
+  int Apply(const AnnotationFile &file, Genome &genome) const;
+  /**
+   * Per-position weights computed from codon_weights over the coding
+   * features of a file.
+   */
+  std::vector<double> CodonWeights(const AnnotationFile &file) const;
+};
+
+#endif  // header guard
@@ -1,14 +1,22 @@
-import pandas
+"""
+Average the counts of several pinetree runs by floored time.
+
+Kept for existing workflows; Model.simulate_ensemble_stats computes the
+same per time point statistics while the replicates run, without writing or
+loading every trajectory, and pinetree.io.Ensemble.summarize computes them
+from binary counts files one replicate at a time.
+"""
+
+import pandas as pd
 import math
 
 my_df1 = pd.read_csv("run0_counts.tsv", sep="\t", names=['time', 'protein', 'count'])
 my_df2 = pd.read_csv("run1_counts.tsv", sep="\t", names=['time', 'protein', 'count'])
 
-all_df = pd.concat(['my_df1', 'my_df2'])
+all_df = pd.concat([my_df1, my_df2])
 
 all_df['time'] = all_df['time'].apply(math.floor)
 
 all_df = all_df.groupby(['time', 'protein'])
 
 all_df.agg({'count':['mean', 'std']}).reset_index()
-
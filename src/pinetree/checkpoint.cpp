@@ -0,0 +1,22 @@
+#include <fstream>
+#include <sstream>
+
+#include "checkpoint.hpp"
+
+void CheckpointWriter::Save(const std::string &path) const {
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  file.write(buffer_.data(), buffer_.size());
+  if (!file) {
+    throw std::runtime_error("Could not write checkpoint '" + path + "'.");
+  }
+}
+
+std::string CheckpointReader::Load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Could not open checkpoint '" + path + "'.");
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
@@ -0,0 +1,195 @@
+#ifndef SRC_CHECKPOINT_HPP  // header guard
+#define SRC_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Serializes simulation state into a compact binary buffer. Values are
+ * written in host byte order, so checkpoints are meant to be restored on the
+ * same kind of machine that wrote them.
+ */
+class CheckpointWriter {
+ public:
+  /**
+   * Append a trivially copyable value.
+   */
+  template <typename T>
+  void Write(const T &value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer_.append(bytes, sizeof(T));
+  }
+  void Write(bool value) { Write<uint8_t>(value); }
+  void Write(const std::string &value) {
+    Write<uint32_t>(value.size());
+    buffer_ += value;
+  }
+  template <typename T>
+  void Write(const std::vector<T> &values) {
+    Write<uint32_t>(values.size());
+    for (const auto &value : values) {
+      Write(value);
+    }
+  }
+  void Write(const std::vector<bool> &values) {
+    Write<uint32_t>(values.size());
+    for (bool value : values) {
+      Write(value);
+    }
+  }
+  void Write(const std::map<std::string, int> &values) {
+    Write<uint32_t>(values.size());
+    for (const auto &item : values) {
+      Write(item.first);
+      Write<int32_t>(item.second);
+    }
+  }
+  template <typename T>
+  void Write(const std::map<std::string, T> &values) {
+    Write<uint32_t>(values.size());
+    for (const auto &item : values) {
+      Write(item.first);
+      Write(item.second);
+    }
+  }
+  /**
+   * @return serialized state
+   */
+  const std::string &buffer() const { return buffer_; }
+  /**
+   * Write the serialized state to a file.
+   *
+   * @param path path of file, which is overwritten
+   */
+  void Save(const std::string &path) const;
+
+ private:
+  std::string buffer_;
+};
+
+/**
+ * Reads values back in the order they were written by a CheckpointWriter.
+ */
+class CheckpointReader {
+ public:
+  /**
+   * @param buffer serialized state, which must outlive the reader
+   */
+  explicit CheckpointReader(const std::string &buffer)
+      : CheckpointReader(buffer.data(), buffer.size()) {}
+  /**
+   * @param data serialized state, e.g. a memory-mapped file, which must
+   *  outlive the reader
+   * @param size bytes of serialized state
+   */
+  CheckpointReader(const char *data, std::size_t size)
+      : data_(data), size_(size) {}
+  /**
+   * Read a trivially copyable value.
+   */
+  template <typename T>
+  T Read() {
+    T value;
+    Take(&value, sizeof(T));
+    return value;
+  }
+  void Read(bool &value) { value = Read<uint8_t>(); }
+  void Read(std::string &value) {
+    value.resize(ReadSize());
+    if (!value.empty()) {
+      Take(&value[0], value.size());
+    }
+  }
+  template <typename T>
+  void Read(T &value) {
+    value = Read<T>();
+  }
+  template <typename T>
+  void Read(std::vector<T> &values) {
+    values.resize(ReadSize());
+    for (auto &value : values) {
+      Read(value);
+    }
+  }
+  void Read(std::vector<bool> &values) {
+    values.resize(ReadSize());
+    for (std::size_t i = 0; i < values.size(); i++) {
+      values[i] = Read<uint8_t>();
+    }
+  }
+  void Read(std::map<std::string, int> &values) {
+    values.clear();
+    uint32_t size = ReadSize();
+    for (uint32_t i = 0; i < size; i++) {
+      std::string key;
+      Read(key);
+      values[key] = Read<int32_t>();
+    }
+  }
+  template <typename T>
+  void Read(std::map<std::string, T> &values) {
+    values.clear();
+    uint32_t size = ReadSize();
+    for (uint32_t i = 0; i < size; i++) {
+      std::string key;
+      Read(key);
+      Read(values[key]);
+    }
+  }
+  /**
+   * @return true once every value has been read
+   */
+  bool done() const { return pos_ == size_; }
+  /**
+   * @return number of bytes read so far
+   */
+  std::size_t position() const { return pos_; }
+  /**
+   * Throw an error if a value read from the checkpoint does not match the
+   * model being restored.
+   *
+   * @param match whether the value matches
+   * @param what description of the value
+   */
+  static void Expect(bool match, const std::string &what) {
+    if (!match) {
+      throw std::runtime_error("Checkpoint does not match model: " + what +
+                               " differs.");
+    }
+  }
+  /**
+   * Read a whole file into a string.
+   */
+  static std::string Load(const std::string &path);
+
+ private:
+  const char *data_;
+  std::size_t size_;
+  std::size_t pos_ = 0;
+  /**
+   * Read the size of a string or container, which cannot exceed the bytes
+   * left since every element takes at least one, so that a corrupt size
+   * fails here instead of allocating for it.
+   */
+  uint32_t ReadSize() {
+    uint32_t size = Read<uint32_t>();
+    if (size > size_ - pos_) {
+      throw std::runtime_error("Checkpoint is truncated.");
+    }
+    return size;
+  }
+  void Take(void *value, std::size_t size) {
+    if (pos_ + size > size_) {
+      throw std::runtime_error("Checkpoint is truncated.");
+    }
+    std::memcpy(value, data_ + pos_, size);
+    pos_ += size;
+  }
+};
+
+#endif  // header guard
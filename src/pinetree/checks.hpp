@@ -0,0 +1,31 @@
+#ifndef SRC_CHECKS_HPP  // header guard
+#define SRC_CHECKS_HPP
+
+#include <stdexcept>
+
+/**
+ * Check an internal invariant on the simulation hot path, throwing
+ * std::runtime_error with a given message if it does not hold. Checks are
+ * only compiled in when PINETREE_CHECKED is defined, as in pinetree_test
+ * and the pinetree.core_checked Python module; otherwise neither the
+ * condition nor the message is evaluated. Errors that user input can cause
+ * are always reported and must not use this macro.
+ *
+ * @param condition invariant that should hold
+ * @param message expression giving the error message, evaluated only if the
+ *  check fails
+ */
+#ifdef PINETREE_CHECKED
+#define PINETREE_CHECK(condition, message)   \
+  do {                                       \
+    if (!(condition)) {                      \
+      throw std::runtime_error(message);     \
+    }                                        \
+  } while (0)
+#else
+#define PINETREE_CHECK(condition, message) \
+  do {                                     \
+  } while (0)
+#endif
+
+#endif  // header guard
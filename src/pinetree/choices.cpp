@@ -1,15 +1,201 @@
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
 #include "choices.hpp"
 
-void Random::seed(int seed) {
+/**
+ * SplitMix64 finalizer, a bijective mix of the bits of a 64-bit value.
+ */
+static std::uint64_t Mix(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * Layers of the ziggurat for the exponential distribution: 256 boxes of
+ * equal area under exp(-x), of which box i spans [0, x[i]] horizontally
+ * and [f[i], f[i + 1]] vertically, with f[i] = exp(-x[i]). The first box
+ * also holds the tail beyond x[1] = R. A point drawn in box i lies under
+ * the curve for sure if it is left of x[i + 1], i.e. with probability
+ * ratio[i].
+ */
+struct Ziggurat {
+  static constexpr double R = 7.69711747013104972;
+  static constexpr double AREA = 3.9496598225815571993e-3;
+  double x[257];
+  double f[257];
+  double ratio[256];
+  Ziggurat() {
+    x[0] = AREA / std::exp(-R);
+    x[1] = R;
+    for (int i = 1; i < 255; i++) {
+      x[i + 1] = -std::log(AREA / x[i] + std::exp(-x[i]));
+    }
+    x[256] = 0;
+    for (int i = 0; i <= 256; i++) {
+      f[i] = std::exp(-x[i]);
+    }
+    for (int i = 0; i < 256; i++) {
+      ratio[i] = x[i + 1] / x[i];
+    }
+  }
+};
+
+constexpr double Ziggurat::R;
+constexpr double Ziggurat::AREA;
+
+static const Ziggurat &ZigguratLayers() {
+  static const Ziggurat layers;
+  return layers;
+}
+
+static std::uint64_t RotateLeft(std::uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+Random::Random() : dis_(0, 1) {
+  std::random_device rd;
+  auto seed = rd();
   gen_.seed(seed);
-  seeded_ = true;
+  key_ = Mix(Mix(seed) ^ rd());
+  SeedLanes();
 }
 
-double Random::random() {
-  if (!seeded_) {
-    std::random_device rd;
-    gen_.seed(rd());
-    seeded_ = true;
+void Random::seed(int seed, int stream) {
+  if (stream == 0) {
+    gen_.seed(seed);
+  } else {
+    std::seed_seq seq{seed, stream};
+    gen_.seed(seq);
+  }
+  dis_.reset();
+  key_ = Mix(Mix(static_cast<std::uint32_t>(seed)) ^
+             static_cast<std::uint32_t>(stream));
+  SeedLanes();
+}
+
+void Random::SeedLanes() {
+  // Expand the key into the state of every stream, none of which can be all
+  // zero since Mix is a bijection of distinct inputs
+  std::uint64_t counter = key_;
+  for (int word = 0; word < 4; word++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      lanes_[word][lane] = Mix(counter++);
+    }
+  }
+  position_ = BLOCK_SIZE;
+}
+
+void Random::Refill() {
+  std::uint64_t(&s)[4][LANES] = lanes_;
+  for (int step = 0; step < BLOCK_SIZE; step += LANES) {
+    // The same step of xoshiro256++ on every stream
+    for (int lane = 0; lane < LANES; lane++) {
+      block_[step + lane] =
+          RotateLeft(s[0][lane] + s[3][lane], 23) + s[0][lane];
+      std::uint64_t t = s[1][lane] << 17;
+      s[2][lane] ^= s[0][lane];
+      s[3][lane] ^= s[1][lane];
+      s[1][lane] ^= s[2][lane];
+      s[0][lane] ^= s[3][lane];
+      s[2][lane] ^= t;
+      s[3][lane] = RotateLeft(s[3][lane], 45);
+    }
+  }
+  position_ = 0;
+}
+
+double Random::exponential() {
+  if (!fast_) {
+    return std::log(1.0 / random());
+  }
+  const Ziggurat &layers = ZigguratLayers();
+  while (true) {
+    // The low 8 bits pick a box and the top 53 bits a position in it
+    std::uint64_t bits = NextBits();
+    int box = bits & 0xff;
+    double u = (bits >> 11) * (1.0 / 9007199254740992.0);
+    double x = u * layers.x[box];
+    if (u < layers.ratio[box]) {
+      return x;
+    }
+    if (box == 0) {
+      // The tail beyond R is R plus another exponential draw
+      return Ziggurat::R + exponential();
+    }
+    double y =
+        layers.f[box] + random() * (layers.f[box + 1] - layers.f[box]);
+    if (y < std::exp(-x)) {
+      return x;
+    }
   }
-  return dis_(gen_);
-}
\ No newline at end of file
+}
+
+double Random::keyed(std::uint64_t stream, std::uint64_t counter) const {
+  std::uint64_t bits = Mix(Mix(key_ ^ Mix(stream)) ^ counter);
+  // The top 53 bits, offset by half a step so that 0 never comes up
+  return ((bits >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+int Random::poisson(double mean) {
+  std::poisson_distribution<int> dis(mean);
+  return Draw(dis);
+}
+
+double Random::gamma(double shape, double rate) {
+  std::gamma_distribution<double> dis(shape, 1.0 / rate);
+  return Draw(dis);
+}
+
+int Random::binomial(int trials, double probability) {
+  std::binomial_distribution<int> dis(trials, probability);
+  return Draw(dis);
+}
+
+void Random::Save(CheckpointWriter &writer) const {
+  // The standard library only guarantees a textual representation of engine
+  // and distribution state
+  std::ostringstream state;
+  state << gen_ << " " << dis_;
+  writer.Write(state.str());
+  writer.Write<uint64_t>(key_);
+  writer.Write(fast_);
+  for (int word = 0; word < 4; word++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      writer.Write<uint64_t>(lanes_[word][lane]);
+    }
+  }
+  // Pending draws are saved so that the restored generator continues
+  // mid-block
+  writer.Write<int32_t>(position_);
+  for (int i = position_; i < BLOCK_SIZE; i++) {
+    writer.Write<uint64_t>(block_[i]);
+  }
+}
+
+void Random::Load(CheckpointReader &reader) {
+  std::string text;
+  reader.Read(text);
+  std::istringstream state(text);
+  state >> gen_ >> dis_;
+  if (!state) {
+    throw std::runtime_error("Checkpoint has an invalid generator state.");
+  }
+  key_ = reader.Read<uint64_t>();
+  reader.Read(fast_);
+  for (int word = 0; word < 4; word++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      lanes_[word][lane] = reader.Read<uint64_t>();
+    }
+  }
+  position_ = reader.Read<int32_t>();
+  if (position_ < 0 || position_ > BLOCK_SIZE) {
+    throw std::runtime_error("Checkpoint has an invalid generator state.");
+  }
+  for (int i = position_; i < BLOCK_SIZE; i++) {
+    block_[i] = reader.Read<uint64_t>();
+  }
+}
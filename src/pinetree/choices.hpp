@@ -1,44 +1,235 @@
 #ifndef SRC_CHOICES_HPP_ // header guard
 #define SRC_CHOICES_HPP_
 
-#include <algorithm>
-#include <numeric>
+#include <cstdint>
+#include <memory>
 #include <random>
+#include <vector>
 
-namespace Random {
-static bool seeded_ = false;
-static std::mt19937 gen_;
-static std::uniform_real_distribution<> dis_(0, 1);
-void seed(int seed);
-double random();
-template <typename T>
-int WeightedChoiceIndex(const std::vector<T> &population,
-                        const std::vector<double> &weights) {
-  double random_num = random();
-  // Calculate cumulative sums for weights
-  std::vector<double> cum_weights(weights.size());
-  std::partial_sum(weights.begin(), weights.end(), cum_weights.begin());
-  // Bisect cumulative weights vector
-  std::vector<double>::iterator upper;
-  upper = std::upper_bound(cum_weights.begin(), cum_weights.end(),
-                           random_num * cum_weights.back());
-  // Calculate index and return list item at index
-  int index = (upper - cum_weights.begin());
-  return index;
-}
-template <typename T>
-T WeightedChoice(const std::vector<T> &population,
-                 const std::vector<double> &weights) {
-  int index = WeightedChoiceIndex(population, weights);
-  return population[index];
-}
+#include "checkpoint.hpp"
 
-template <typename T> T WeightedChoice(const std::vector<T> &population) {
-  // Grab random number from python's random module
-  double random_num = random();
-  int index = random_num * population.size();
-  return population[index];
-}
-}
+/**
+ * Random number generator for a single simulation. Each Model owns one and
+ * shares it with the objects that make random choices, so separate models
+ * (e.g. replicates running on different threads) never share state.
+ */
+class Random {
+ public:
+  /**
+   * Construct a generator seeded from std::random_device.
+   */
+  Random();
+  /**
+   * Convenience typedefs.
+   */
+  typedef std::shared_ptr<Random> Ptr;
+  /**
+   * Seed the generator. A stream of 0 reproduces the sequence of earlier
+   * versions of pinetree for the same seed; other streams give independent
+   * sequences for replicates that share a seed.
+   *
+   * @param seed seed value
+   * @param stream stream number
+   */
+  void seed(int seed, int stream = 0);
+  /**
+   * Draw from a faster generator instead of the Mersenne Twister of
+   * std::mt19937: four interleaved xoshiro256++ streams filling blocks of
+   * BLOCK_SIZE draws at a time, in a loop the compiler vectorizes, with
+   * exponential waiting times drawn by the ziggurat method (Marsaglia and
+   * Tsang 2000) instead of a logarithm. Both generators are seeded by seed,
+   * but give different sequences, so results are only reproducible with
+   * the same setting.
+   *
+   * @param enabled whether to use the faster generator
+   */
+  void fast(bool enabled) { fast_ = enabled; }
+  bool fast() const { return fast_; }
+  /**
+   * @return uniform random number in [0, 1)
+   */
+  double random() {
+    if (fast_) {
+      return (NextBits() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    return dis_(gen_);
+  }
+  /**
+   * @return exponentially distributed random number with mean 1, e.g. the
+   *  waiting time of a reaction with unit propensity
+   */
+  double exponential();
+  /**
+   * Random number of a numbered stream that depends only on the seed, the
+   * stream number and a position in the stream, not on any other draw of
+   * this generator, e.g. to give each reaction its own stream (see
+   * Gillespie::common_random_numbers).
+   *
+   * @param stream number of stream
+   * @param counter position in stream
+   * @return uniform random number in (0, 1)
+   */
+  double keyed(std::uint64_t stream, std::uint64_t counter) const;
+  /**
+   * @param mean mean of distribution
+   * @return Poisson-distributed random number
+   */
+  int poisson(double mean);
+  /**
+   * @param shape shape of distribution, e.g. a number of events
+   * @param rate rate of each event
+   * @return gamma-distributed random number, i.e. for an integer shape the
+   *  time until the shape-th event of a Poisson process
+   */
+  double gamma(double shape, double rate);
+  /**
+   * @param trials number of trials
+   * @param probability probability of success of each trial
+   * @return binomially distributed random number
+   */
+  int binomial(int trials, double probability);
+  /**
+   * Save or restore the exact state of the generator.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  /**
+   * Randomly select an index into population, weighted by the given weights.
+   * Weights are scanned in place with an early exit, so selection does not
+   * allocate any memory.
+   *
+   * @param population items to choose from
+   * @param weights weight of each item
+   * @return index of selected item
+   */
+  template <typename T>
+  int WeightedChoiceIndex(const std::vector<T> &population,
+                          const std::vector<double> &weights) {
+    double random_num = random();
+    double total = 0;
+    for (const auto &weight : weights) {
+      total += weight;
+    }
+    // Find first index whose cumulative weight exceeds the target
+    double target = random_num * total;
+    double cum_weight = 0;
+    for (int index = 0; index < static_cast<int>(weights.size()); index++) {
+      cum_weight += weights[index];
+      if (cum_weight > target) {
+        return index;
+      }
+    }
+    return weights.size();
+  }
+  /**
+   * Randomly select an index into population, weighted by a function of each
+   * item, without building a vector of weights.
+   *
+   * @param population items to choose from
+   * @param weight callable returning the weight of an item
+   * @return index of selected item
+   */
+  template <typename T, typename F>
+  int WeightedChoiceIndex(const std::vector<T> &population, F weight) {
+    double random_num = random();
+    double total = 0;
+    for (const auto &item : population) {
+      total += weight(item);
+    }
+    double target = random_num * total;
+    double cum_weight = 0;
+    for (int index = 0; index < static_cast<int>(population.size());
+         index++) {
+      cum_weight += weight(population[index]);
+      if (cum_weight > target) {
+        return index;
+      }
+    }
+    return population.size();
+  }
+  template <typename T>
+  T WeightedChoice(const std::vector<T> &population,
+                   const std::vector<double> &weights) {
+    int index = WeightedChoiceIndex(population, weights);
+    return population[index];
+  }
+  template <typename T>
+  T WeightedChoice(const std::vector<T> &population) {
+    double random_num = random();
+    int index = random_num * population.size();
+    return population[index];
+  }
 
-#endif // SRC_CHOICES_HPP_
\ No newline at end of file
+ private:
+  /**
+   * Underlying engine.
+   */
+  std::mt19937 gen_;
+  /**
+   * Whether draws come from the faster generator (see fast).
+   */
+  bool fast_ = false;
+  /**
+   * Number of interleaved streams of the faster generator, and number of
+   * draws generated at a time.
+   */
+  static const int LANES = 4;
+  static const int BLOCK_SIZE = 256;
+  /**
+   * The four state words of each stream, block of pending draws and
+   * position of the next draw in it.
+   */
+  std::uint64_t lanes_[4][LANES];
+  std::uint64_t block_[BLOCK_SIZE];
+  int position_ = BLOCK_SIZE;
+  /**
+   * Next 64 random bits of the faster generator.
+   */
+  std::uint64_t NextBits() {
+    if (position_ == BLOCK_SIZE) {
+      Refill();
+    }
+    return block_[position_++];
+  }
+  /**
+   * Generate the next block of draws from every stream.
+   */
+  void Refill();
+  /**
+   * Seed the streams of the faster generator from key_.
+   */
+  void SeedLanes();
+  /**
+   * Draws of the faster generator in the form expected by the distributions
+   * of the standard library.
+   */
+  struct Bits {
+    typedef std::uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+    result_type operator()() { return random->NextBits(); }
+    Random *random;
+  };
+  /**
+   * Draw from a distribution of the standard library with whichever
+   * generator is in use.
+   */
+  template <typename Distribution>
+  typename Distribution::result_type Draw(Distribution &distribution) {
+    if (fast_) {
+      Bits bits{this};
+      return distribution(bits);
+    }
+    return distribution(gen_);
+  }
+  /**
+   * Hash of the seed and stream, which keys the streams of keyed().
+   */
+  std::uint64_t key_;
+  /**
+   * Uniform distribution over [0, 1).
+   */
+  std::uniform_real_distribution<> dis_;
+};
+
+#endif // SRC_CHOICES_HPP_
@@ -0,0 +1,58 @@
+#ifndef SRC_COMPENSATED_SUM_HPP  // header guard
+#define SRC_COMPENSATED_SUM_HPP
+
+#include <cmath>
+
+#include "checkpoint.hpp"
+
+/**
+ * A running sum with Neumaier (improved Kahan) compensation. The rounding
+ * error of every addition is carried in a separate term, so a total that is
+ * updated by many small increments and decrements does not drift.
+ */
+class CompensatedSum {
+ public:
+  CompensatedSum() = default;
+  explicit CompensatedSum(double value) : sum_(value) {}
+  /**
+   * Add a value to the sum.
+   *
+   * @param value value to add (may be negative)
+   */
+  void Add(double value) {
+    double total = sum_ + value;
+    if (std::abs(sum_) >= std::abs(value)) {
+      compensation_ += (sum_ - total) + value;
+    } else {
+      compensation_ += (value - total) + sum_;
+    }
+    sum_ = total;
+  }
+  /**
+   * @return compensated total
+   */
+  double value() const { return sum_ + compensation_; }
+  /**
+   * Save or restore both terms of the sum.
+   */
+  void Save(CheckpointWriter &writer) const {
+    writer.Write(sum_);
+    writer.Write(compensation_);
+  }
+  void Load(CheckpointReader &reader) {
+    reader.Read(sum_);
+    reader.Read(compensation_);
+  }
+
+ private:
+  /**
+   * Uncompensated running total.
+   */
+  double sum_ = 0;
+  /**
+   * Accumulated rounding error of sum_.
+   */
+  double compensation_ = 0;
+};
+
+#endif  // header guard
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "counts_file.hpp"
+
+/**
+ * Value of type T at an offset of a mapped file, which may be unaligned.
+ */
+template <typename T>
+static T ReadValue(const char *data, std::size_t offset) {
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+CountsFile::CountsFile(const std::string &path)
+    : path_(path), file_(std::make_shared<MappedFile>(path, "counts file")) {
+  const char *data = file_->data();
+  std::size_t size = file_->size();
+  if (size < 12 || std::memcmp(data, "PTCOUNTS", 8) != 0) {
+    throw std::runtime_error("'" + path +
+                             "' is not a pinetree binary counts file.");
+  }
+  uint32_t version = ReadValue<uint32_t>(data, 8);
+  if (version < 1 || version > 3) {
+    throw std::runtime_error("Unsupported counts file version " +
+                             std::to_string(version) + ".");
+  }
+  auto corrupt = [&path]() {
+    return std::runtime_error("Corrupt counts file '" + path + "'.");
+  };
+  // Check that a record has the bytes it claims before reading them
+  auto need = [&](std::size_t pos, std::size_t bytes) {
+    if (bytes > size - pos) {
+      throw corrupt();
+    }
+  };
+  std::size_t pos = 12;
+  while (pos < size) {
+    char tag = data[pos];
+    std::size_t start = pos;
+    pos++;
+    if (tag == 'S') {
+      need(pos, 8);
+      uint32_t index = ReadValue<uint32_t>(data, pos);
+      uint32_t length = ReadValue<uint32_t>(data, pos + 4);
+      pos += 8;
+      need(pos, length);
+      if (index != species_.size()) {
+        throw corrupt();
+      }
+      species_.emplace_back(data + pos, length);
+      column_of_[species_.back()] = index;
+      pos += length;
+    } else if (tag == 'R' || (tag == 'D' && version >= 3)) {
+      need(pos, tag == 'R' ? 12 : 16);
+      double time = ReadValue<double>(data, pos);
+      uint32_t columns = ReadValue<uint32_t>(data, pos + 8);
+      if (columns > species_.size() ||
+          (!time_.empty() && time < time_.back())) {
+        throw corrupt();
+      }
+      if (tag == 'R') {
+        pos += 12;
+        need(pos, 24 * static_cast<std::size_t>(columns));
+        pos += 24 * static_cast<std::size_t>(columns);
+      } else {
+        uint32_t changed = ReadValue<uint32_t>(data, pos + 12);
+        pos += 16;
+        need(pos, 28 * static_cast<std::size_t>(changed));
+        pos += 28 * static_cast<std::size_t>(changed);
+      }
+      time_.push_back(time);
+      offsets_.push_back(start);
+      tags_.push_back(tag);
+    } else if (tag == 'M' && version >= 2) {
+      need(pos, 4);
+      uint32_t length = ReadValue<uint32_t>(data, pos);
+      pos += 4;
+      need(pos, length + 8);
+      metadata_[std::string(data + pos, length)] =
+          ReadValue<double>(data, pos + length);
+      pos += length + 8;
+    } else {
+      throw corrupt();
+    }
+  }
+}
+
+std::vector<int> CountsFile::Columns(
+    const std::vector<std::string> &species) const {
+  std::vector<int> columns;
+  if (species.empty()) {
+    for (int column = 0; column < static_cast<int>(species_.size());
+         column++) {
+      columns.push_back(column);
+    }
+    return columns;
+  }
+  for (const auto &name : species) {
+    auto found = column_of_.find(name);
+    columns.push_back(found != column_of_.end() ? found->second : -1);
+  }
+  return columns;
+}
+
+void CountsFile::Gather(const std::vector<int> &columns,
+                        const std::vector<std::ptrdiff_t> &records,
+                        CountsTable &table) const {
+  const char *data = file_->data();
+  std::size_t width = columns.size();
+  table.protein.assign(records.size() * width, 0.0);
+  table.transcript.assign(records.size() * width, 0.0);
+  table.ribo_density.assign(records.size() * width, 0.0);
+  // Values of the columns read as of the last record applied
+  std::vector<double> values(3 * width, 0.0);
+  std::ptrdiff_t current = -1;
+  for (std::size_t row = 0; row < records.size(); row++) {
+    std::ptrdiff_t record = records[row];
+    if (record < 0) {
+      continue;
+    }
+    if (record != current) {
+      // Start from the last full record, unless it was already applied
+      std::ptrdiff_t first = record;
+      while (first > current + 1 && tags_[first] != 'R') {
+        first--;
+      }
+      if (tags_[first] != 'R' && current < 0) {
+        throw std::runtime_error("Corrupt counts file '" + path_ + "'.");
+      }
+      for (std::ptrdiff_t r = first; r <= record; r++) {
+        std::size_t offset = offsets_[r];
+        if (tags_[r] == 'R') {
+          uint32_t count = ReadValue<uint32_t>(data, offset + 9);
+          for (std::size_t k = 0; k < width; k++) {
+            int column = columns[k];
+            bool present =
+                column >= 0 && static_cast<uint32_t>(column) < count;
+            for (int q = 0; q < 3; q++) {
+              values[3 * k + q] =
+                  present ? ReadValue<double>(
+                                data, offset + 13 + 24 * column + 8 * q)
+                          : 0.0;
+            }
+          }
+          continue;
+        }
+        // Changed columns are listed in increasing order
+        uint32_t changed = ReadValue<uint32_t>(data, offset + 13);
+        std::size_t entries = offset + 17;
+        for (std::size_t k = 0; k < width; k++) {
+          if (columns[k] < 0) {
+            continue;
+          }
+          uint32_t column = columns[k];
+          uint32_t low = 0, high = changed;
+          while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (ReadValue<uint32_t>(data, entries + 28 * middle) < column) {
+              low = middle + 1;
+            } else {
+              high = middle;
+            }
+          }
+          if (low < changed &&
+              ReadValue<uint32_t>(data, entries + 28 * low) == column) {
+            for (int q = 0; q < 3; q++) {
+              values[3 * k + q] =
+                  ReadValue<double>(data, entries + 28 * low + 4 + 8 * q);
+            }
+          }
+        }
+      }
+      current = record;
+    }
+    for (std::size_t k = 0; k < width; k++) {
+      table.protein[row * width + k] = values[3 * k];
+      table.transcript[row * width + k] = values[3 * k + 1];
+      table.ribo_density[row * width + k] = values[3 * k + 2];
+    }
+  }
+}
+
+CountsTable CountsFile::Read(const std::vector<std::string> &species,
+                             double start, double stop) const {
+  CountsTable table;
+  table.species = species.empty() ? species_ : species;
+  table.metadata = metadata_;
+  auto first = std::lower_bound(time_.begin(), time_.end(), start);
+  auto last = std::upper_bound(first, time_.end(), stop);
+  table.time.assign(first, last);
+  std::vector<std::ptrdiff_t> records;
+  for (auto it = first; it != last; it++) {
+    records.push_back(it - time_.begin());
+  }
+  Gather(Columns(species), records, table);
+  return table;
+}
+
+CountsTable CountsFile::Resample(const std::vector<std::string> &species,
+                                 const std::vector<double> &grid) const {
+  if (!std::is_sorted(grid.begin(), grid.end())) {
+    throw std::invalid_argument("Grid times must be sorted.");
+  }
+  CountsTable table;
+  table.species = species.empty() ? species_ : species;
+  table.metadata = metadata_;
+  table.time = grid;
+  std::vector<std::ptrdiff_t> records;
+  for (double time : grid) {
+    // Last time point at or before the grid time, or -1 if there is none
+    records.push_back(
+        std::upper_bound(time_.begin(), time_.end(), time) - time_.begin() -
+        1);
+  }
+  Gather(Columns(species), records, table);
+  return table;
+}
+
+ResampledCounts ResampleCounts(const std::vector<std::string> &paths,
+                               const std::vector<std::string> &species,
+                               const std::vector<double> &grid) {
+  ResampledCounts counts;
+  counts.time = grid;
+  counts.species = species;
+  if (species.empty()) {
+    for (const auto &path : paths) {
+      CountsFile file(path);
+      for (const auto &name : file.species()) {
+        if (std::find(counts.species.begin(), counts.species.end(), name) ==
+            counts.species.end()) {
+          counts.species.push_back(name);
+        }
+      }
+    }
+  }
+  std::size_t size = paths.size() * grid.size() * counts.species.size();
+  counts.protein.reserve(size);
+  counts.transcript.reserve(size);
+  counts.ribo_density.reserve(size);
+  for (const auto &path : paths) {
+    CountsTable table = CountsFile(path).Resample(counts.species, grid);
+    counts.protein.insert(counts.protein.end(), table.protein.begin(),
+                          table.protein.end());
+    counts.transcript.insert(counts.transcript.end(), table.transcript.begin(),
+                             table.transcript.end());
+    counts.ribo_density.insert(counts.ribo_density.end(),
+                               table.ribo_density.begin(),
+                               table.ribo_density.end());
+    counts.replicates++;
+  }
+  return counts;
+}
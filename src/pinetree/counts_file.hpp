@@ -0,0 +1,116 @@
+#ifndef SRC_COUNTS_FILE_HPP  // header guard
+#define SRC_COUNTS_FILE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "output.hpp"
+
+/**
+ * Reader of a counts file written by BinaryCountsWriter (any version), which
+ * memory-maps the file and decodes only the species and time points asked
+ * for, so that trajectories much larger than memory can be analyzed.
+ *
+ * Opening a file makes one pass over its record headers to index the time
+ * point and offset of every record; counts are read when requested. Reading
+ * a delta-encoded file replays its changes from the first record, but only
+ * for the species read.
+ */
+class CountsFile {
+ public:
+  /**
+   * @throws std::runtime_error if the file cannot be read or is not a valid
+   *  counts file
+   */
+  explicit CountsFile(const std::string &path);
+  /**
+   * Every time point in the file, in order.
+   */
+  const std::vector<double> &time() const { return time_; }
+  /**
+   * Species names in order of first appearance.
+   */
+  const std::vector<std::string> &species() const { return species_; }
+  /**
+   * Last value of each property recorded in the file (see
+   * CountsWriter::WriteMetadata).
+   */
+  const std::map<std::string, double> &metadata() const { return metadata_; }
+  /**
+   * Counts of some species at the time points from start through stop, with
+   * columns in the order given. Species that do not appear in the file, or
+   * have not appeared yet at a time point, are 0.
+   *
+   * @param species species to read, or every species if empty
+   */
+  CountsTable Read(const std::vector<std::string> &species,
+                   double start = -std::numeric_limits<double>::infinity(),
+                   double stop = std::numeric_limits<double>::infinity()) const;
+  /**
+   * Counts of some species at each time of a grid, which must be sorted.
+   * Counts are constant between time points, so each grid time takes the
+   * counts of the latest time point at or before it, or 0 if there is none.
+   *
+   * @param species species to read, or every species if empty
+   */
+  CountsTable Resample(const std::vector<std::string> &species,
+                       const std::vector<double> &grid) const;
+
+ private:
+  std::string path_;
+  std::shared_ptr<MappedFile> file_;
+  std::vector<double> time_;
+  /**
+   * Offset of each record (its tag) in the file.
+   */
+  std::vector<std::size_t> offsets_;
+  /**
+   * Tag of each record, 'R' or 'D'.
+   */
+  std::vector<char> tags_;
+  std::vector<std::string> species_;
+  std::map<std::string, int> column_of_;
+  std::map<std::string, double> metadata_;
+  /**
+   * Columns of some species, or -1 for species not in the file.
+   */
+  std::vector<int> Columns(const std::vector<std::string> &species) const;
+  /**
+   * Write the counts of some columns at each of a sorted list of records
+   * into consecutive rows of a table, with rows of 0 for records of -1.
+   */
+  void Gather(const std::vector<int> &columns,
+              const std::vector<std::ptrdiff_t> &records,
+              CountsTable &table) const;
+};
+
+/**
+ * Counts of many replicates on a common time grid, as arrays of shape
+ * (replicate, time point, species) in row-major order.
+ */
+struct ResampledCounts {
+  std::vector<double> time;
+  std::vector<std::string> species;
+  int replicates = 0;
+  std::vector<double> protein;
+  std::vector<double> transcript;
+  std::vector<double> ribo_density;
+};
+
+/**
+ * Resample the counts files of an ensemble (see CountsFile::Resample) to a
+ * common time grid, one file at a time.
+ *
+ * @param species species to read, or every species in any of the files, in
+ *  order of first appearance, if empty
+ */
+ResampledCounts ResampleCounts(const std::vector<std::string> &paths,
+                               const std::vector<std::string> &species,
+                               const std::vector<double> &grid);
+
+#endif  // header guard
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+
+#include "dependency_graph.hpp"
+
+/**
+ * Disjoint sets of graph nodes, merged as edges are added.
+ */
+class DisjointSets {
+ public:
+  explicit DisjointSets(int size) : parents_(size) {
+    std::iota(parents_.begin(), parents_.end(), 0);
+  }
+  int Find(int node) {
+    while (parents_[node] != node) {
+      parents_[node] = parents_[parents_[node]];
+      node = parents_[node];
+    }
+    return node;
+  }
+  void Merge(int first, int second) {
+    parents_[Find(first)] = Find(second);
+  }
+
+ private:
+  std::vector<int> parents_;
+};
+
+std::vector<int> DependencyGraph::Ids(const std::vector<std::string> &names) {
+  std::vector<int> ids;
+  for (const auto &name : names) {
+    auto found = ids_.emplace(name, names_.size());
+    if (found.second) {
+      names_.push_back(name);
+    }
+    ids.push_back(found.first->second);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+void DependencyGraph::AddReaction(const std::string &label,
+                                  const std::vector<std::string> &reads,
+                                  const std::vector<std::string> &writes) {
+  labels_.push_back(label);
+  reads_.push_back(Ids(reads));
+  writes_.push_back(Ids(writes));
+}
+
+DependencyReport DependencyGraph::Analyze(int partitions,
+                                          double hub_fraction) const {
+  if (partitions < 1) {
+    throw std::invalid_argument("There must be at least one partition.");
+  }
+  if (!(hub_fraction > 0 && hub_fraction <= 1)) {
+    throw std::invalid_argument("Hub fraction must be in (0, 1].");
+  }
+  int species_count = names_.size();
+  int reaction_count = labels_.size();
+  DependencyReport report;
+  report.reactions = reaction_count;
+  // Species each reaction reads or writes
+  std::vector<std::vector<int>> touched(reaction_count);
+  std::vector<int> fan_out(species_count, 0), writers(species_count, 0),
+      degree(species_count, 0);
+  for (int r = 0; r < reaction_count; r++) {
+    std::set_union(reads_[r].begin(), reads_[r].end(), writes_[r].begin(),
+                   writes_[r].end(), std::back_inserter(touched[r]));
+    for (int id : reads_[r]) {
+      fan_out[id]++;
+    }
+    for (int id : writes_[r]) {
+      writers[id]++;
+    }
+    for (int id : touched[r]) {
+      degree[id]++;
+    }
+  }
+  int threshold =
+      std::max(3, static_cast<int>(std::ceil(hub_fraction * reaction_count)));
+  std::vector<bool> hub(species_count, false);
+  for (int id = 0; id < species_count; id++) {
+    hub[id] = degree[id] >= threshold;
+    DependencyReport::Species &species = report.species[names_[id]];
+    species.fan_out = fan_out[id];
+    species.writers = writers[id];
+    species.degree = degree[id];
+    species.hub = hub[id];
+    if (hub[id]) {
+      report.hubs.push_back(names_[id]);
+    }
+  }
+  std::stable_sort(report.hubs.begin(), report.hubs.end(),
+                   [&report](const std::string &a, const std::string &b) {
+                     return report.species[a].degree >
+                            report.species[b].degree;
+                   });
+  // Species are nodes 0 to species_count - 1, followed by the reactions
+  DisjointSets whole(species_count + reaction_count);
+  DisjointSets split(species_count + reaction_count);
+  for (int r = 0; r < reaction_count; r++) {
+    for (int id : touched[r]) {
+      whole.Merge(species_count + r, id);
+      if (!hub[id]) {
+        split.Merge(species_count + r, id);
+      }
+    }
+  }
+  std::set<int> roots;
+  for (int r = 0; r < reaction_count; r++) {
+    roots.insert(whole.Find(species_count + r));
+  }
+  report.connected_components = roots.size();
+  // Components without hubs, each with at least one reaction
+  std::map<int, int> component_of;
+  std::vector<std::vector<int>> component_reactions;
+  for (int r = 0; r < reaction_count; r++) {
+    auto found = component_of.emplace(split.Find(species_count + r),
+                                      component_reactions.size());
+    if (found.second) {
+      component_reactions.emplace_back();
+      report.components.emplace_back();
+    }
+    component_reactions[found.first->second].push_back(r);
+    report.components[found.first->second].reactions.push_back(labels_[r]);
+  }
+  for (int id = 0; id < species_count; id++) {
+    auto found = component_of.find(split.Find(id));
+    if (!hub[id] && found != component_of.end()) {
+      report.components[found->second].species.push_back(names_[id]);
+    }
+  }
+  std::vector<int> order(report.components.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return component_reactions[a].size() > component_reactions[b].size();
+  });
+  std::vector<DependencyReport::Component> components;
+  for (int index : order) {
+    std::sort(report.components[index].species.begin(),
+              report.components[index].species.end());
+    components.push_back(std::move(report.components[index]));
+  }
+  report.components = std::move(components);
+  // Largest component first to the least loaded partition
+  report.partitions.resize(partitions);
+  std::vector<std::set<std::string>> shared(partitions);
+  for (std::size_t c = 0; c < order.size(); c++) {
+    auto least = std::min_element(
+        report.partitions.begin(), report.partitions.end(),
+        [](const DependencyReport::Partition &a,
+           const DependencyReport::Partition &b) {
+          return a.reactions < b.reactions;
+        });
+    least->components.push_back(c);
+    least->reactions += component_reactions[order[c]].size();
+    for (int r : component_reactions[order[c]]) {
+      for (int id : touched[r]) {
+        if (hub[id]) {
+          shared[least - report.partitions.begin()].insert(names_[id]);
+        }
+      }
+    }
+  }
+  for (int p = 0; p < partitions; p++) {
+    report.partitions[p].shared.assign(shared[p].begin(), shared[p].end());
+  }
+  return report;
+}
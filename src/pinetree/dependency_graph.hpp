@@ -0,0 +1,103 @@
+#ifndef SRC_DEPENDENCY_GRAPH_HPP  // header guard
+#define SRC_DEPENDENCY_GRAPH_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * How strongly the reactions of a model are coupled through the species
+ * they share (see DependencyGraph::Analyze).
+ */
+struct DependencyReport {
+  /**
+   * Reactions that read and write one species. A reaction reads a species
+   * if its propensity is recomputed when the count changes, so each change
+   * recomputes fan_out propensities.
+   */
+  struct Species {
+    int fan_out = 0;
+    int writers = 0;
+    /**
+     * Distinct reactions that read or write the species.
+     */
+    int degree = 0;
+    bool hub = false;
+  };
+  /**
+   * Species and reactions connected to each other once hubs are removed.
+   */
+  struct Component {
+    std::vector<std::string> species;
+    std::vector<std::string> reactions;
+  };
+  /**
+   * Components assigned to one partition, the number of reactions they
+   * hold, and the hubs their reactions read or write, which the partition
+   * has to share with others.
+   */
+  struct Partition {
+    std::vector<int> components;
+    int reactions = 0;
+    std::vector<std::string> shared;
+  };
+  int reactions = 0;
+  std::map<std::string, Species> species;
+  /**
+   * Hub species, most connected first.
+   */
+  std::vector<std::string> hubs;
+  /**
+   * Connected components of the whole graph, hubs included.
+   */
+  int connected_components = 0;
+  /**
+   * Components of the graph without hubs, largest first.
+   */
+  std::vector<Component> components;
+  std::vector<Partition> partitions;
+};
+
+/**
+ * Bipartite graph of species and the reactions that read and write them,
+ * built once a model is initialized to find out how it can be split up,
+ * e.g. into the partitions of a parallel engine.
+ */
+class DependencyGraph {
+ public:
+  /**
+   * Add a reaction by a label, which need not be unique, and the names of
+   * the species it reads and writes. Names may repeat.
+   */
+  void AddReaction(const std::string &label,
+                   const std::vector<std::string> &reads,
+                   const std::vector<std::string> &writes);
+  /**
+   * Report the fan-out of every species, its hubs, its components and a
+   * partitioning of the components.
+   *
+   * A species is a hub if at least hub_fraction of the reactions, and at
+   * least 3, read or write it, e.g. a polymerase that binds many promoters
+   * or the ribosomes. Hubs couple nearly everything, so components are
+   * found without them and hubs are instead reported as shared by the
+   * partitions whose reactions use them. Components are then assigned
+   * largest first to the partition with the fewest reactions so far.
+   *
+   * @throws std::invalid_argument if partitions is less than 1 or
+   *  hub_fraction is not in (0, 1]
+   */
+  DependencyReport Analyze(int partitions, double hub_fraction) const;
+
+ private:
+  std::vector<std::string> labels_;
+  std::vector<std::vector<int>> reads_;
+  std::vector<std::vector<int>> writes_;
+  std::map<std::string, int> ids_;
+  std::vector<std::string> names_;
+  /**
+   * Distinct IDs of species names, which are added if they are new.
+   */
+  std::vector<int> Ids(const std::vector<std::string> &names);
+};
+
+#endif  // header guard
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ensemble_stats.hpp"
+
+QuantileSketch::QuantileSketch(double p) : p_(p) {
+  if (p < 0 || p > 1) {
+    throw std::invalid_argument("Quantiles must be between 0 and 1.");
+  }
+  desired_ = {1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5};
+  increments_ = {0, p / 2, p, (1 + p) / 2, 1};
+}
+
+void QuantileSketch::Add(double value) {
+  // The first five values initialize the markers
+  if (count_ < 5) {
+    heights_[count_++] = value;
+    if (count_ == 5) {
+      std::sort(heights_.begin(), heights_.end());
+      positions_ = {1, 2, 3, 4, 5};
+    }
+    return;
+  }
+  count_++;
+  // Find the cell containing the value, extending the extremes if needed
+  int k;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    k = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = value;
+    k = 3;
+  } else {
+    k = 0;
+    while (value >= heights_[k + 1]) {
+      k++;
+    }
+  }
+  for (int i = k + 1; i < 5; i++) {
+    positions_[i] += 1;
+  }
+  for (int i = 0; i < 5; i++) {
+    desired_[i] += increments_[i];
+  }
+  // Move the middle markers towards their desired positions
+  for (int i = 1; i < 4; i++) {
+    double offset = desired_[i] - positions_[i];
+    if ((offset >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+        (offset <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+      int d = offset > 0 ? 1 : -1;
+      double height = Parabolic(i, d);
+      if (heights_[i - 1] < height && height < heights_[i + 1]) {
+        heights_[i] = height;
+      } else {
+        heights_[i] += d * (heights_[i + d] - heights_[i]) /
+                       (positions_[i + d] - positions_[i]);
+      }
+      positions_[i] += d;
+    }
+  }
+}
+
+double QuantileSketch::Parabolic(int i, int d) const {
+  return heights_[i] +
+         d / (positions_[i + 1] - positions_[i - 1]) *
+             ((positions_[i] - positions_[i - 1] + d) *
+                  (heights_[i + 1] - heights_[i]) /
+                  (positions_[i + 1] - positions_[i]) +
+              (positions_[i + 1] - positions_[i] - d) *
+                  (heights_[i] - heights_[i - 1]) /
+                  (positions_[i] - positions_[i - 1]));
+}
+
+double QuantileSketch::value() const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  if (count_ < 5) {
+    // Linear interpolation between the closest ranks of the exact sample
+    std::array<double, 5> sorted = heights_;
+    std::sort(sorted.begin(), sorted.begin() + count_);
+    double rank = p_ * (count_ - 1);
+    int below = std::floor(rank);
+    int above = std::min(below + 1, count_ - 1);
+    return sorted[below] + (rank - below) * (sorted[above] - sorted[below]);
+  }
+  return heights_[2];
+}
+
+void RunningStats::Add(double value) {
+  if (count == 0) {
+    min = value;
+    max = value;
+  } else {
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+  count++;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+void RunningStats::Merge(const RunningStats &other) {
+  if (other.count == 0) {
+    return;
+  }
+  if (count == 0) {
+    *this = other;
+    return;
+  }
+  long long total = count + other.count;
+  double delta = other.mean - mean;
+  mean += delta * other.count / total;
+  m2 += other.m2 + delta * delta * count / total * other.count;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  count = total;
+}
+
+EnsembleStats::EnsembleStats(double time_step,
+                             const std::vector<double> &quantiles)
+    : time_step_(time_step), quantiles_(quantiles) {
+  if (time_step <= 0) {
+    throw std::invalid_argument("Time step must be positive.");
+  }
+  // Check quantiles up front rather than on the first replicate
+  NewCell();
+}
+
+EnsembleStats::Cell EnsembleStats::NewCell() const {
+  Cell cell;
+  for (double p : quantiles_) {
+    cell.quantiles.emplace_back(p);
+  }
+  return cell;
+}
+
+void EnsembleStats::AddValue(Cell &cell, double value) const {
+  cell.moments.Add(value);
+  for (auto &sketch : cell.quantiles) {
+    sketch.Add(value);
+  }
+}
+
+void EnsembleStats::Grow(int columns, int slots) {
+  if (slots > static_cast<int>(slot_counts_.size())) {
+    slot_counts_.resize(slots, 0);
+    Cells empty = {NewCell(), NewCell(), NewCell()};
+    for (auto &column : cells_) {
+      column.resize(slots, empty);
+    }
+  }
+  while (static_cast<int>(cells_.size()) < columns) {
+    std::vector<Cells> column;
+    for (int count : slot_counts_) {
+      Cells cells = {NewCell(), NewCell(), NewCell()};
+      for (auto &cell : cells) {
+        for (int i = 0; i < count; i++) {
+          AddValue(cell, 0.0);
+        }
+      }
+      column.push_back(std::move(cells));
+    }
+    cells_.push_back(std::move(column));
+  }
+}
+
+void EnsembleStats::Add(const CountsTable &table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t width = table.species.size();
+  // Map the replicate's columns to ours, adding any new species
+  std::vector<int> source(species_.size(), -1);
+  for (std::size_t i = 0; i < width; i++) {
+    const auto &name = table.species[i];
+    auto it = column_of_.find(name);
+    if (it == column_of_.end()) {
+      it = column_of_.emplace(name, species_.size()).first;
+      species_.push_back(name);
+      source.push_back(-1);
+    }
+    source[it->second] = i;
+  }
+  // Group rows by the output time point they were recorded for, allowing
+  // for the same tolerance as the simulation loop
+  int slots = 0;
+  std::vector<int> slot_of(table.time.size());
+  for (std::size_t row = 0; row < table.time.size(); row++) {
+    slot_of[row] = std::floor((table.time[row] + 0.001) / time_step_);
+    slots = std::max(slots, slot_of[row] + 1);
+  }
+  Grow(species_.size(), slots);
+  std::vector<bool> seen(slots, false);
+  for (std::size_t row = 0; row < table.time.size(); row++) {
+    int slot = slot_of[row];
+    if (slot < 0 || seen[slot]) {
+      continue;
+    }
+    seen[slot] = true;
+    slot_counts_[slot]++;
+    for (std::size_t column = 0; column < species_.size(); column++) {
+      Cells &cells = cells_[column][slot];
+      if (source[column] == -1) {
+        for (auto &cell : cells) {
+          AddValue(cell, 0.0);
+        }
+        continue;
+      }
+      std::size_t index = row * width + source[column];
+      AddValue(cells[0], table.protein[index]);
+      AddValue(cells[1], table.transcript[index]);
+      AddValue(cells[2], table.ribo_density[index]);
+    }
+  }
+}
+
+EnsembleSummary EnsembleStats::Summary() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EnsembleSummary summary;
+  summary.species = species_;
+  summary.quantiles = quantiles_;
+  std::size_t rows = slot_counts_.size();
+  std::size_t columns = species_.size();
+  for (std::size_t slot = 0; slot < rows; slot++) {
+    summary.time.push_back(slot * time_step_);
+    summary.replicates.push_back(slot_counts_[slot]);
+  }
+  std::array<SummaryStats *, 3> measures = {
+      &summary.protein, &summary.transcript, &summary.ribo_density};
+  for (int m = 0; m < 3; m++) {
+    SummaryStats &stats = *measures[m];
+    stats.mean.resize(rows * columns);
+    stats.variance.resize(rows * columns);
+    stats.min.resize(rows * columns);
+    stats.max.resize(rows * columns);
+    stats.quantiles.resize(quantiles_.size() * rows * columns);
+    for (std::size_t column = 0; column < columns; column++) {
+      for (std::size_t slot = 0; slot < rows; slot++) {
+        const Cell &cell = cells_[column][slot][m];
+        std::size_t index = slot * columns + column;
+        stats.mean[index] = cell.moments.mean;
+        stats.variance[index] = cell.moments.variance();
+        stats.min[index] = cell.moments.min;
+        stats.max[index] = cell.moments.max;
+        for (std::size_t q = 0; q < quantiles_.size(); q++) {
+          stats.quantiles[q * rows * columns + index] =
+              cell.quantiles[q].value();
+        }
+      }
+    }
+  }
+  return summary;
+}
+
+void EnsembleStats::ExpectNoQuantiles(const std::string &what) const {
+  if (!quantiles_.empty()) {
+    throw std::logic_error("Cannot " + what +
+                           " ensemble statistics that estimate quantiles.");
+  }
+}
+
+void EnsembleStats::Merge(const EnsembleStats &other) {
+  if (&other == this) {
+    throw std::invalid_argument("Cannot merge ensemble statistics with "
+                                "themselves.");
+  }
+  std::lock(mutex_, other.mutex_);
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other.mutex_, std::adopt_lock);
+  ExpectNoQuantiles("merge");
+  other.ExpectNoQuantiles("merge");
+  if (other.time_step_ != time_step_) {
+    throw std::invalid_argument(
+        "Cannot merge ensemble statistics with different time steps.");
+  }
+  // Map our columns to the other's, adding any new species
+  for (const auto &name : other.species_) {
+    if (column_of_.emplace(name, species_.size()).second) {
+      species_.push_back(name);
+    }
+  }
+  Grow(species_.size(), other.slot_counts_.size());
+  for (std::size_t column = 0; column < species_.size(); column++) {
+    auto it = other.column_of_.find(species_[column]);
+    for (std::size_t slot = 0; slot < other.slot_counts_.size(); slot++) {
+      Cells &cells = cells_[column][slot];
+      if (it == other.column_of_.end()) {
+        // The other replicates never reported this species
+        for (auto &cell : cells) {
+          for (int i = 0; i < other.slot_counts_[slot]; i++) {
+            AddValue(cell, 0.0);
+          }
+        }
+        continue;
+      }
+      const Cells &added = other.cells_[it->second][slot];
+      for (int m = 0; m < 3; m++) {
+        cells[m].moments.Merge(added[m].moments);
+      }
+    }
+  }
+  for (std::size_t slot = 0; slot < other.slot_counts_.size(); slot++) {
+    slot_counts_[slot] += other.slot_counts_[slot];
+  }
+}
+
+void EnsembleStats::Save(CheckpointWriter &writer) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ExpectNoQuantiles("save");
+  writer.Write(time_step_);
+  writer.Write(species_);
+  writer.Write(slot_counts_);
+  for (const auto &column : cells_) {
+    for (const auto &cells : column) {
+      for (const auto &cell : cells) {
+        writer.Write(cell.moments.count);
+        writer.Write(cell.moments.mean);
+        writer.Write(cell.moments.m2);
+        writer.Write(cell.moments.min);
+        writer.Write(cell.moments.max);
+      }
+    }
+  }
+}
+
+void EnsembleStats::Load(CheckpointReader &reader) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ExpectNoQuantiles("load");
+  reader.Read(time_step_);
+  reader.Read(species_);
+  reader.Read(slot_counts_);
+  column_of_.clear();
+  for (std::size_t i = 0; i < species_.size(); i++) {
+    column_of_[species_[i]] = i;
+  }
+  Cells empty = {NewCell(), NewCell(), NewCell()};
+  cells_.assign(species_.size(),
+                std::vector<Cells>(slot_counts_.size(), empty));
+  for (auto &column : cells_) {
+    for (auto &cells : column) {
+      for (auto &cell : cells) {
+        reader.Read(cell.moments.count);
+        reader.Read(cell.moments.mean);
+        reader.Read(cell.moments.m2);
+        reader.Read(cell.moments.min);
+        reader.Read(cell.moments.max);
+      }
+    }
+  }
+}
@@ -0,0 +1,196 @@
+#ifndef SRC_ENSEMBLE_STATS_HPP  // header guard
+#define SRC_ENSEMBLE_STATS_HPP
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "output.hpp"
+
+/**
+ * Streaming estimate of a single quantile using the P-square algorithm
+ * (Jain and Chlamtac 1985). Keeps five markers regardless of how many values
+ * are added; the estimate is exact for up to five values.
+ */
+class QuantileSketch {
+ public:
+  /**
+   * @param p quantile to estimate, between 0 and 1
+   */
+  explicit QuantileSketch(double p);
+  /**
+   * Add a value to the sample.
+   */
+  void Add(double value);
+  /**
+   * @return estimated quantile, or 0 if no values have been added
+   */
+  double value() const;
+
+ private:
+  double p_;
+  int count_ = 0;
+  /**
+   * Marker heights, actual positions, desired positions, and increments of
+   * the desired positions per value.
+   */
+  std::array<double, 5> heights_;
+  std::array<double, 5> positions_;
+  std::array<double, 5> desired_;
+  std::array<double, 5> increments_;
+  /**
+   * Piecewise-parabolic prediction of the height of marker i moved by d.
+   */
+  double Parabolic(int i, int d) const;
+};
+
+/**
+ * Running count, mean, variance (Welford's algorithm), minimum and maximum of
+ * a sample.
+ */
+struct RunningStats {
+  long long count = 0;
+  double mean = 0;
+  /**
+   * Sum of squared deviations from the mean.
+   */
+  double m2 = 0;
+  double min = 0;
+  double max = 0;
+  void Add(double value);
+  /**
+   * Add the values of another sample (Chan, Golub, and LeVeque 1979).
+   */
+  void Merge(const RunningStats &other);
+  /**
+   * @return sample variance, or 0 for fewer than two values
+   */
+  double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+};
+
+/**
+ * Summary statistics of one measure (protein, transcript or ribo_density)
+ * across replicates. Arrays are row-major with one row per time point and
+ * one column per species; quantiles hold one such array per quantile.
+ */
+struct SummaryStats {
+  std::vector<double> mean;
+  std::vector<double> variance;
+  std::vector<double> min;
+  std::vector<double> max;
+  std::vector<double> quantiles;
+};
+
+/**
+ * Per time point statistics of an ensemble of simulations.
+ */
+struct EnsembleSummary {
+  /**
+   * Output time points.
+   */
+  std::vector<double> time;
+  /**
+   * Species names, one per column, in order of first appearance.
+   */
+  std::vector<std::string> species;
+  /**
+   * Quantiles that were estimated.
+   */
+  std::vector<double> quantiles;
+  /**
+   * Number of replicates that reported each time point.
+   */
+  std::vector<double> replicates;
+  SummaryStats protein;
+  SummaryStats transcript;
+  SummaryStats ribo_density;
+};
+
+/**
+ * Accumulates the counts of replicate simulations into per time point
+ * statistics as each replicate finishes, so that an ensemble can be
+ * summarized without keeping every trajectory. Counts are grouped by output
+ * time point, and a species that a replicate never reported counts as 0 in
+ * that replicate.
+ */
+class EnsembleStats {
+ public:
+  /**
+   * @param time_step interval between output time points
+   * @param quantiles quantiles to estimate for every value, between 0 and 1
+   */
+  explicit EnsembleStats(double time_step,
+                         const std::vector<double> &quantiles = {});
+  /**
+   * Add the counts of one replicate. Safe to call from several threads.
+   *
+   * @param table counts of the replicate
+   */
+  void Add(const CountsTable &table);
+  /**
+   * @return statistics of all replicates added so far
+   */
+  EnsembleSummary Summary() const;
+  /**
+   * Add the replicates of statistics accumulated elsewhere with the same
+   * time step, for example by another process. Quantile sketches cannot be
+   * combined, so neither may estimate quantiles.
+   *
+   * @param other statistics to add
+   */
+  void Merge(const EnsembleStats &other);
+  /**
+   * Save or restore the accumulated statistics, to send them to another
+   * process. Statistics that estimate quantiles cannot be saved.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+
+ private:
+  /**
+   * Statistics of one value (one measure of one species at one time point).
+   */
+  struct Cell {
+    RunningStats moments;
+    std::vector<QuantileSketch> quantiles;
+  };
+  /**
+   * Statistics of protein, transcript and ribo_density values.
+   */
+  typedef std::array<Cell, 3> Cells;
+  double time_step_;
+  std::vector<double> quantiles_;
+  mutable std::mutex mutex_;
+  std::vector<std::string> species_;
+  std::map<std::string, int> column_of_;
+  /**
+   * Number of replicates that have reported each time point.
+   */
+  std::vector<int> slot_counts_;
+  /**
+   * Statistics indexed by column and then time point.
+   */
+  std::vector<std::vector<Cells>> cells_;
+  /**
+   * Add a value to a cell.
+   */
+  void AddValue(Cell &cell, double value) const;
+  /**
+   * Create an empty cell with a sketch for each quantile.
+   */
+  Cell NewCell() const;
+  /**
+   * Add columns and time points up to the given sizes. New cells are filled
+   * with a 0 for every replicate that previously reported their time point.
+   */
+  void Grow(int columns, int slots);
+  /**
+   * Throw std::logic_error if quantiles are estimated.
+   */
+  void ExpectNoQuantiles(const std::string &what) const;
+};
+
+#endif  // header guard
@@ -0,0 +1,228 @@
+#include "equilibrium.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "choices.hpp"
+#include "reaction.hpp"
+#include "tracker.hpp"
+
+/**
+ * Propensity of a species reaction at the current counts.
+ */
+static double Propensity(const SpeciesReaction &reaction,
+                         const SpeciesTracker &tracker) {
+  double propensity = reaction.propensity_constant();
+  for (int reactant : reaction.reactant_ids()) {
+    propensity *= tracker.species(reactant);
+  }
+  return propensity;
+}
+
+/**
+ * Does a reaction take A + B (or A) to a single other species C, and
+ * another take C back to the same reactants?
+ */
+static bool Reverses(const SpeciesReaction &forward,
+                     const SpeciesReaction &reverse) {
+  std::vector<int> reactants = forward.reactant_ids();
+  if (reactants.empty() || forward.product_ids().size() != 1 ||
+      reverse.reactant_ids().size() != 1) {
+    return false;
+  }
+  int c = forward.product_ids()[0];
+  if (reverse.reactant_ids()[0] != c ||
+      std::count(reactants.begin(), reactants.end(), c) != 0 ||
+      (reactants.size() == 2 && reactants[0] == reactants[1])) {
+    return false;
+  }
+  std::vector<int> products = reverse.product_ids();
+  std::sort(reactants.begin(), reactants.end());
+  std::sort(products.begin(), products.end());
+  return reactants == products;
+}
+
+std::vector<SpeciesReaction::Ptr> PartialEquilibrium::Detect(
+    const std::vector<SpeciesReaction::Ptr> &reactions,
+    const SpeciesTracker &tracker, double ratio) {
+  std::vector<double> propensities;
+  double total = 0;
+  for (const auto &reaction : reactions) {
+    propensities.push_back(Propensity(*reaction, tracker));
+    total += propensities.back();
+  }
+  std::vector<SpeciesReaction::Ptr> fast;
+  std::vector<bool> paired(reactions.size(), false);
+  std::set<int> species;
+  int count = reactions.size();
+  for (int i = 0; i < count; i++) {
+    for (int j = i + 1; j < count && !paired[i]; j++) {
+      if (paired[j]) {
+        continue;
+      }
+      int forward = i, reverse = j;
+      if (!Reverses(*reactions[i], *reactions[j])) {
+        if (!Reverses(*reactions[j], *reactions[i])) {
+          continue;
+        }
+        std::swap(forward, reverse);
+      }
+      Pair pair;
+      pair.forward = reactions[forward];
+      pair.reverse = reactions[reverse];
+      const auto &reactants = pair.forward->reactant_ids();
+      pair.a = reactants[0];
+      pair.b = reactants.size() == 2 ? reactants[1] : -1;
+      pair.c = pair.forward->product_ids()[0];
+      double propensity = propensities[i] + propensities[j];
+      if (species.count(pair.a) != 0 || species.count(pair.b) != 0 ||
+          species.count(pair.c) != 0 || propensity <= 0 ||
+          propensity < ratio * (total - propensity)) {
+        continue;
+      }
+      species.insert({pair.a, pair.b, pair.c});
+      paired[i] = paired[j] = true;
+      pair.drawn = {-1, -1, -1};
+      pair.propensity = 0;
+      pair.time = 0;
+      for (const auto &reaction : {pair.forward, pair.reverse}) {
+        reaction->fast(true);
+        fast.push_back(reaction);
+      }
+      pairs_.push_back(pair);
+    }
+  }
+  return fast;
+}
+
+std::array<int, 3> PartialEquilibrium::Counts(const Pair &pair,
+                                              const SpeciesTracker &tracker) {
+  return {tracker.species(pair.a),
+          pair.b == -1 ? 0 : tracker.species(pair.b),
+          tracker.species(pair.c)};
+}
+
+int PartialEquilibrium::Draw(const Pair &pair, int a_total, int b_total,
+                             Random &rng) {
+  double forward = pair.forward->propensity_constant();
+  double reverse = pair.reverse->propensity_constant();
+  if (pair.b == -1) {
+    return rng.binomial(a_total, forward / (forward + reverse));
+  }
+  int most = std::min(a_total, b_total);
+  if (most == 0) {
+    return 0;
+  }
+  // P(c + 1) / P(c) by detailed balance
+  double k = forward / reverse;
+  auto ratio = [&](int c) {
+    return k * double(a_total - c) * double(b_total - c) / (c + 1);
+  };
+  // The distribution is unimodal, with its mode near the root of
+  // ratio(c) = 1, i.e. k c^2 - p c + q = 0
+  double p = k * (double(a_total) + b_total) + 1;
+  double q = k * double(a_total) * b_total - 1;
+  double root = 2 * q / (p + std::sqrt(std::max(0.0, p * p - 4 * k * q)));
+  int mode = std::max(0, std::min(most, int(std::ceil(root))));
+  while (mode < most && ratio(mode) > 1) {
+    mode++;
+  }
+  while (mode > 0 && ratio(mode - 1) < 1) {
+    mode--;
+  }
+  // Weights relative to the mode, cut off once negligible; weights_ holds
+  // mode, mode + 1, ... and lower_ mode - 1, mode - 2, ...
+  const double cutoff = 1e-17;
+  weights_.assign(1, 1.0);
+  double weight = 1;
+  for (int c = mode; c < most && weight >= cutoff; c++) {
+    weight *= ratio(c);
+    weights_.push_back(weight);
+  }
+  lower_.clear();
+  weight = 1;
+  for (int c = mode; c > 0 && weight >= cutoff; c--) {
+    weight /= ratio(c - 1);
+    lower_.push_back(weight);
+  }
+  double total = 0;
+  for (double w : weights_) {
+    total += w;
+  }
+  for (double w : lower_) {
+    total += w;
+  }
+  double target = rng.random() * total;
+  for (int i = 0; i < static_cast<int>(weights_.size()); i++) {
+    target -= weights_[i];
+    if (target < 0) {
+      return mode + i;
+    }
+  }
+  for (int i = 0; i < static_cast<int>(lower_.size()); i++) {
+    target -= lower_[i];
+    if (target < 0) {
+      return mode - 1 - i;
+    }
+  }
+  return mode;
+}
+
+void PartialEquilibrium::Update(double time, SpeciesTracker &tracker,
+                                Random &rng, bool all) {
+  for (auto &pair : pairs_) {
+    auto counts = Counts(pair, tracker);
+    if (!all && counts == pair.drawn) {
+      continue;
+    }
+    if (pair.drawn[0] >= 0) {
+      skipped_events_ += pair.propensity * (time - pair.time);
+    }
+    int c = Draw(pair, counts[0] + counts[2], counts[1] + counts[2], rng);
+    int change = c - counts[2];
+    if (change != 0) {
+      tracker.Increment(pair.a, -change);
+      if (pair.b != -1) {
+        tracker.Increment(pair.b, -change);
+      }
+      tracker.Increment(pair.c, change);
+    }
+    samples_++;
+    Synchronize(pair, time, tracker);
+  }
+}
+
+void PartialEquilibrium::Invalidate() {
+  for (auto &pair : pairs_) {
+    pair.drawn = {-1, -1, -1};
+  }
+}
+
+void PartialEquilibrium::Synchronize(double time,
+                                     const SpeciesTracker &tracker) {
+  for (auto &pair : pairs_) {
+    Synchronize(pair, time, tracker);
+  }
+}
+
+void PartialEquilibrium::Synchronize(Pair &pair, double time,
+                                     const SpeciesTracker &tracker) {
+  pair.drawn = Counts(pair, tracker);
+  pair.propensity = Propensity(*pair.forward, tracker) +
+                    Propensity(*pair.reverse, tracker);
+  pair.time = time;
+}
+
+PartialEquilibrium::Stats PartialEquilibrium::stats(double time) const {
+  Stats stats;
+  stats.pairs = pairs_.size();
+  stats.samples = samples_;
+  stats.skipped_events = skipped_events_;
+  for (const auto &pair : pairs_) {
+    if (pair.drawn[0] >= 0) {
+      stats.skipped_events += pair.propensity * (time - pair.time);
+    }
+  }
+  return stats;
+}
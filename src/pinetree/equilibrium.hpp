@@ -0,0 +1,129 @@
+#ifndef SRC_EQUILIBRIUM_HPP  // header guard
+#define SRC_EQUILIBRIUM_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+
+class Random;
+class SpeciesReaction;
+class SpeciesTracker;
+
+/**
+ * Partial equilibrium approximation of fast reversible pairs of species
+ * reactions, A + B <-> C or A <-> C (Haseltine and Rawlings 2002). The
+ * reactions of a fast pair are taken out of the simulation (see
+ * SpeciesReaction::fast) and, whenever another event changes the amount
+ * of A, B or C, and after every other species or binding event, the pair
+ * is redrawn from its equilibrium distribution given the amounts it
+ * conserves. A species takes part in at most one fast pair.
+ */
+class PartialEquilibrium {
+ public:
+  /**
+   * Counts of the work done and saved.
+   */
+  struct Stats {
+    /**
+     * Number of fast pairs.
+     */
+    int pairs = 0;
+    /**
+     * Number of times a pair was redrawn from its equilibrium.
+     */
+    long long samples = 0;
+    /**
+     * Expected number of fast events that the samples stand in for, i.e.
+     * the integral of the fast propensities over time.
+     */
+    double skipped_events = 0;
+  };
+  /**
+   * Find fast pairs among the species reactions of a model, and take their
+   * reactions out of the simulation. A pair is fast if the sum of its two
+   * propensities is at least a given multiple of the total propensity of
+   * all other species reactions at the current counts.
+   *
+   * @param reactions every species reaction of a model
+   * @param ratio multiple of the other propensities a pair needs to reach
+   * @return the reactions of fast pairs, whose propensities are now 0
+   */
+  std::vector<std::shared_ptr<SpeciesReaction>> Detect(
+      const std::vector<std::shared_ptr<SpeciesReaction>> &reactions,
+      const SpeciesTracker &tracker, double ratio);
+  /**
+   * Redraw every pair, or only those whose amounts changed since they were
+   * last drawn.
+   *
+   * @param time current simulation time
+   * @param all whether to redraw pairs whose amounts did not change, e.g.
+   *  after a slow event, by which time they have relaxed
+   */
+  void Update(double time, SpeciesTracker &tracker, Random &rng, bool all);
+  /**
+   * Redraw every pair at the next Update, e.g. after the counts were reset.
+   */
+  void Invalidate();
+  /**
+   * Take the current counts as drawn at a given time, e.g. after they were
+   * restored from a checkpoint taken right after an Update.
+   */
+  void Synchronize(double time, const SpeciesTracker &tracker);
+  /**
+   * @param time current simulation time
+   */
+  Stats stats(double time) const;
+  bool empty() const { return pairs_.empty(); }
+
+ private:
+  struct Pair {
+    /**
+     * A + B -> C (or A -> C) and its reverse.
+     */
+    std::shared_ptr<SpeciesReaction> forward;
+    std::shared_ptr<SpeciesReaction> reverse;
+    /**
+     * Species IDs of A, B and C, where B is -1 for A <-> C.
+     */
+    int a;
+    int b;
+    int c;
+    /**
+     * Counts of A, B and C as last drawn, or -1 before the first draw.
+     */
+    std::array<int, 3> drawn;
+    /**
+     * Sum of the two propensities at the last draw, and its time.
+     */
+    double propensity;
+    double time;
+  };
+  std::vector<Pair> pairs_;
+  long long samples_ = 0;
+  double skipped_events_ = 0;
+  /**
+   * Unnormalized probabilities of the amounts of C from the mode up and
+   * from below the mode down, reused between draws.
+   */
+  std::vector<double> weights_;
+  std::vector<double> lower_;
+  /**
+   * Current counts of A, B (or 0) and C of a pair.
+   */
+  static std::array<int, 3> Counts(const Pair &pair,
+                                   const SpeciesTracker &tracker);
+  /**
+   * Draw the amount of C of a pair from its equilibrium distribution.
+   *
+   * @param a_total amount of A plus C
+   * @param b_total amount of B plus C, ignored for A <-> C
+   */
+  int Draw(const Pair &pair, int a_total, int b_total, Random &rng);
+  /**
+   * Take the current counts of a pair as drawn.
+   */
+  static void Synchronize(Pair &pair, double time,
+                          const SpeciesTracker &tracker);
+};
+
+#endif  // header guard
@@ -62,7 +62,7 @@ public:
 
   // calls all connected functions
   void Emit(Args... p) {
-    for (auto it : slots_) {
+    for (const auto &it : slots_) {
       it.second(p...);
     }
   }
@@ -1,76 +1,160 @@
 /* Copyright (c) 2017 Benjamin Jack All Rights Reserved. */
 
 #include <algorithm>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "feature.hpp"
 #include "tracker.hpp"
 
+namespace {
+/**
+ * Names and IDs, shared by InternedName::Id and InternedName::Name.
+ */
+struct NameTable {
+  std::mutex mutex;
+  std::map<std::string, int> ids = {{"__ribosome", InternedName::RIBOSOME},
+                                    {"__rnase", InternedName::RNASE},
+                                    {"__mask", InternedName::MASK},
+                                    {"", InternedName::NONE}};
+  std::vector<std::string> names = {"__ribosome", "__rnase", "__mask", ""};
+};
+
+NameTable &names() {
+  static NameTable table;
+  return table;
+}
+}  // namespace
+
+int InternedName::Id(const std::string &name) {
+  // Built-in names are looked up without locking, since masks and ribosomes
+  // are constructed throughout a simulation
+  if (name.empty()) {
+    return NONE;
+  } else if (name == "__ribosome") {
+    return RIBOSOME;
+  } else if (name == "__rnase") {
+    return RNASE;
+  } else if (name == "__mask") {
+    return MASK;
+  }
+  NameTable &table = names();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) {
+    return it->second;
+  }
+  int id = table.names.size();
+  table.ids[name] = id;
+  table.names.push_back(name);
+  return id;
+}
+
+std::string InternedName::Name(int id) {
+  NameTable &table = names();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return table.names.at(id);
+}
+
 FixedElement::FixedElement(const std::string &name, int start, int stop,
                            const std::map<std::string, double> &interactions)
-    : name_(name),
+    : properties_(std::make_shared<Properties>(
+          Properties{name, std::string(), interactions,
+                     InternedName::NONE, InternedName::Id(name), {}})),
       start_(start),
       stop_(stop),
-      interactions_(interactions),
       covered_(0),
-      old_covered_(0),
       reading_frame_(-1) {
   if (start_ < 0 || stop_ < 0) {
     throw std::invalid_argument(
-        "Fixed element '" + name_ +
+        "Fixed element '" + name +
         "' has a negative start and/or stop coordinate.");
   }
+  for (auto const &item : interactions) {
+    int type_id = InternedName::Id(item.first);
+    if (type_id >= static_cast<int>(properties_->rates.size())) {
+      properties_->rates.resize(type_id + 1, -1.0);
+    }
+    properties_->rates[type_id] = item.second;
+  }
 }
 
 FixedElement::~FixedElement(){};
 
+void FixedElement::gene(const std::string &gene) {
+  if (properties_.use_count() > 1) {
+    properties_ = std::make_shared<Properties>(*properties_);
+  }
+  properties_->gene = gene;
+  properties_->gene_id = InternedName::Id(gene);
+}
+
 BindingSite::BindingSite(const std::string &name, int start, int stop,
                          const std::map<std::string, double> &interactions)
     : FixedElement(name, start, stop, interactions) {
-  first_exposure_ = false;
   for (auto const &item : interactions) {
     if (item.second < 0) {
       throw std::invalid_argument(
-          "Binding site '" + name_ +
+          "Binding site '" + name +
           "' must have non-negative interaction rate constants.");
     }
   }
 }
 
 bool BindingSite::CheckInteraction(const std::string &name) {
-  return interactions_.count(name);
+  return properties_->interactions.count(name);
+}
+
+void FixedElement::Save(CheckpointWriter &writer) const {
+  writer.Write<int32_t>(covered_);
+  writer.Write<int32_t>(state(OLD_COVERED));
+  writer.Write(state(FIRST_EXPOSURE));
+}
+
+void FixedElement::Load(CheckpointReader &reader) {
+  covered_ = reader.Read<int32_t>();
+  state(OLD_COVERED, reader.Read<int32_t>() > 0);
+  state(FIRST_EXPOSURE, reader.Read<uint8_t>());
 }
 
 BindingSite::Ptr BindingSite::Clone() const {
   return std::make_shared<BindingSite>(*this);
 }
 
+void BindingSite::Save(CheckpointWriter &writer) const {
+  FixedElement::Save(writer);
+  writer.Write(state(DEGRADED));
+}
+
+void BindingSite::Load(CheckpointReader &reader) {
+  FixedElement::Load(reader);
+  state(DEGRADED, reader.Read<uint8_t>());
+}
+
 void BindingSite::Degrade() {
   if (covered_ == 0) {
     std::runtime_error(
         "Attempting to mark an uncovered binding site for degradation.");
   } else {
-    degraded_ = true;
+    state(DEGRADED, true);
   }
 }
 
 ReleaseSite::ReleaseSite(const std::string &name, int start, int stop,
                          const std::map<std::string, double> &interactions)
     : FixedElement(name, start, stop, interactions) {
-  first_exposure_ = false;
-  readthrough_ = false;
   for (auto const &item : interactions) {
     if (item.second < 0 || item.second > 1) {
       throw std::invalid_argument(
-          "Release site '" + name_ +
+          "Release site '" + name +
           "' must have efficiency values between 0.0 and 1.0.");
     }
   }
 }
 
 bool ReleaseSite::CheckInteraction(const std::string &name, int reading_frame) {
-  if (interactions_.count(name) == 1) {
+  if (properties_->interactions.count(name) == 1) {
     if (reading_frame_ == -1) {
       return true;
     }
@@ -85,8 +169,52 @@ ReleaseSite::Ptr ReleaseSite::Clone() const {
   return std::make_shared<ReleaseSite>(*this);
 }
 
+void ReleaseSite::Save(CheckpointWriter &writer) const {
+  FixedElement::Save(writer);
+  writer.Write(state(READTHROUGH));
+}
+
+void ReleaseSite::Load(CheckpointReader &reader) {
+  FixedElement::Load(reader);
+  state(READTHROUGH, reader.Read<uint8_t>());
+}
+
+double ReleaseSite::efficiency(const std::string &pol_name) const {
+  auto it = properties_->interactions.find(pol_name);
+  if (it == properties_->interactions.end()) {
+    return 0.0;
+  }
+  return it->second;
+}
+
+void ReleaseSite::efficiency(const std::string &pol_name, double efficiency) {
+  if (properties_.use_count() > 1) {
+    properties_ = std::make_shared<Properties>(*properties_);
+  }
+  properties_->interactions.at(pol_name) = efficiency;
+  properties_->rates[InternedName::Id(pol_name)] = efficiency;
+}
+
 MobileElement::MobileElement(const std::string &name, int footprint, int speed)
-    : name_(name), footprint_(footprint), speed_(speed), reading_frame_(-1) {
+    : name_(name),
+      type_id_(InternedName::Id(name)),
+      footprint_(footprint),
+      speed_(speed),
+      reading_frame_(-1),
+      gene_bound_id_(InternedName::NONE) {
+  switch (type_id_) {
+    case InternedName::RIBOSOME:
+      kind_ = ElementKind::RIBOSOME;
+      break;
+    case InternedName::RNASE:
+      kind_ = ElementKind::RNASE;
+      break;
+    case InternedName::MASK:
+      kind_ = ElementKind::MASK;
+      break;
+    default:
+      kind_ = ElementKind::POLYMERASE;
+  }
   start_ = 0;
   stop_ = start_ + footprint_;
   if (footprint_ < 0) {
@@ -101,6 +229,34 @@ MobileElement::MobileElement(const std::string &name, int footprint, int speed)
 
 MobileElement::~MobileElement(){};
 
+void MobileElement::Save(CheckpointWriter &writer) const {
+  writer.Write<int32_t>(start_);
+  writer.Write<int32_t>(stop_);
+  writer.Write<int32_t>(footprint_);
+  writer.Write<int32_t>(reading_frame_);
+  writer.Write(gene_bound_);
+  writer.Write(arrival_);
+  writer.Write<int32_t>(run_steps_);
+  writer.Write(run_from_);
+  writer.Write(run_until_);
+}
+
+void MobileElement::Load(CheckpointReader &reader) {
+  start_ = reader.Read<int32_t>();
+  stop_ = reader.Read<int32_t>();
+  footprint_ = reader.Read<int32_t>();
+  reading_frame_ = reader.Read<int32_t>();
+  std::string gene;
+  reader.Read(gene);
+  // Interned IDs are only valid within one process, so look the gene up again
+  gene_bound(gene);
+  reader.Read(arrival_);
+  run_steps_ = reader.Read<int32_t>();
+  reader.Read(run_from_);
+  reader.Read(run_until_);
+  release(0, -1);
+}
+
 Polymerase::Polymerase(const std::string &name, int footprint, int speed)
     : MobileElement(name, footprint, speed) {
   reading_frame_ = -1;
@@ -128,6 +284,13 @@ Mask::Mask(int start, int stop,
       interactions_(interactions) {
   start_ = start;
   stop_ = stop;
+  for (auto const &item : interactions) {
+    int type_id = InternedName::Id(item.first);
+    if (type_id >= static_cast<int>(interacts_.size())) {
+      interacts_.resize(type_id + 1, false);
+    }
+    interacts_[type_id] = true;
+  }
 }
 
 /**
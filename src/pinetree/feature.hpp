@@ -4,18 +4,57 @@
 #define SRC_FEATURE_HPP_
 
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "checkpoint.hpp"
 #include "event_signal.hpp"
 
+/**
+ * Process-wide table of small integer IDs for mobile element, gene and site
+ * names, so that interactions can be looked up by index instead of by string.
+ * IDs
+ * are assigned on first use and never change; built-in elements have fixed
+ * IDs.
+ */
+class InternedName {
+ public:
+  /**
+   * IDs of built-in names. NONE is the ID of the empty name.
+   */
+  enum Reserved { RIBOSOME = 0, RNASE = 1, MASK = 2, NONE = 3 };
+  /**
+   * Look up (or assign) the ID of a name. Thread-safe.
+   *
+   * @param name name of mobile element or gene
+   * @return ID of name
+   */
+  static int Id(const std::string &name);
+  /**
+   * Look up the name with a given ID. Thread-safe.
+   *
+   * @param id ID returned by Id()
+   * @return name with that ID
+   */
+  static std::string Name(int id);
+};
+
+/**
+ * Kinds of MobileElement that polymers treat differently from ordinary
+ * polymerases.
+ */
+enum class ElementKind { POLYMERASE, RIBOSOME, RNASE, MASK };
+
 /**
  * Abstract class from which all fixed elements on a polymer inherit. These
  * include promoters, terminators, ribosome binding sites, and stop codons.
  * They all share a common interface for tracking whether they're covered
  * or uncovered.
  */
-class FixedElement : public std::enable_shared_from_this<FixedElement> {
+class FixedElement {
  public:
   /**
    * Only constructor for FixedElement.
@@ -36,17 +75,17 @@ class FixedElement : public std::enable_shared_from_this<FixedElement> {
   /**
    * Save covering state.
    */
-  void ResetState() { old_covered_ = covered_; }
+  void ResetState() { state(OLD_COVERED, covered_ > 0); }
   /**
    * Was this element just uncovered?
    * @return True if element was just uncovered.
    */
-  bool WasUncovered() { return old_covered_ >= 1 && covered_ == 0; }
+  bool WasUncovered() { return state(OLD_COVERED) && covered_ == 0; }
   /**
    * Was this element just covered?
    * @return True if element was just covered.
    */
-  bool WasCovered() { return old_covered_ == 0 && covered_ > 0; }
+  bool WasCovered() { return !state(OLD_COVERED) && covered_ > 0; }
   /**
    * Cover this element. Elements can be covered by multiple features.
    */
@@ -67,21 +106,71 @@ class FixedElement : public std::enable_shared_from_this<FixedElement> {
   /**
    * Getters and setters
    */
-  const std::string &gene() const { return gene_; }
-  void gene(const std::string &gene) { gene_ = gene; }
-  std::string const &name() const { return name_; }
+  const std::string &gene() const { return properties_->gene; }
+  void gene(const std::string &gene);
+  int gene_id() const { return properties_->gene_id; }
+  std::string const &name() const { return properties_->name; }
+  int name_id() const { return properties_->name_id; }
   int start() const { return start_; }
   int stop() const { return stop_; }
   int reading_frame() const { return reading_frame_; }
   void reading_frame(int reading_frame) { reading_frame_ = reading_frame; }
-  bool first_exposure() const { return first_exposure_; }
-  void first_exposure(bool first_exposure) { first_exposure_ = first_exposure; }
+  bool first_exposure() const { return state(FIRST_EXPOSURE); }
+  void first_exposure(bool first_exposure) {
+    state(FIRST_EXPOSURE, first_exposure);
+  }
+  /**
+   * Save or restore the cover state of this element. Its definition (name,
+   * position, interactions) is not saved.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
 
  protected:
   /**
-   * Name of this feature.
-   */
-  std::string name_;
+   * Properties of a FixedElement that do not change during a simulation.
+   * Copies of an element (e.g. the sites of every transcript built from one
+   * genome) share a single Properties object; setters copy it first if it is
+   * shared.
+   */
+  struct Properties {
+    /**
+     * Name of this feature.
+     */
+    std::string name;
+    /**
+     * Name of gene associated with this FixedElement. This is the value that
+     * will get reported to the species tracker.
+     */
+    std::string gene;
+    /**
+     * Vector of names of other features/polymerases that this feature
+     * interacts with.
+     */
+    std::map<std::string, double> interactions;
+    /**
+     * Interned ID of gene.
+     */
+    int gene_id;
+    /**
+     * Interned ID of name.
+     */
+    int name_id;
+    /**
+     * Interaction rate constants (or efficiencies) indexed by the interned ID
+     * of each MobileElement name; negative where there is no interaction.
+     */
+    std::vector<double> rates;
+  };
+  std::shared_ptr<Properties> properties_;
+  /**
+   * @param type_id interned ID of a MobileElement name
+   * @return true if this element interacts with that MobileElement
+   */
+  bool Interacts(int type_id) const {
+    return type_id < static_cast<int>(properties_->rates.size()) &&
+           properties_->rates[type_id] >= 0;
+  }
   /**
    * The start site of the feature. Usually the most upstream site position.
    */
@@ -90,32 +179,33 @@ class FixedElement : public std::enable_shared_from_this<FixedElement> {
    * The stop site of the feature. Usually the most downstream site position.
    */
   int stop_;
-  /**
-   * Vector of names of other features/polymerases that this feature interacts
-   * with.
-   */
-  std::map<std::string, double> interactions_;
-  /**
-   * Name of gene associated with this FixedElement. This is the value that
-   * will get reported to the species tracker.
-   */
-  std::string gene_;
   /**
    * Count of how many features are currently covering this element.
    */
   int covered_;
   /**
-   * Used to cache old covering count to then test for changes in state.
-   */
-  int old_covered_;
-  /**
-   * Reading frame for FixedElement.
-   */
-  int reading_frame_;
-  /**
-   * Has the site been exposed before?
-   */
-  bool first_exposure_;
+   * Reading frame for FixedElement, or -1 for any.
+   */
+  int8_t reading_frame_;
+  /**
+   * Boolean state of this element, packed into one byte since every
+   * transcript carries its own copy of every site:
+   *  - OLD_COVERED: was the element covered when its state was last saved?
+   *  - FIRST_EXPOSURE: has the site been exposed before?
+   *  - DEGRADED: has a binding site been degraded (covered by an RNase)?
+   *  - READTHROUGH: is a polymerase reading through a release site?
+   */
+  enum State : uint8_t {
+    OLD_COVERED = 1,
+    FIRST_EXPOSURE = 2,
+    DEGRADED = 4,
+    READTHROUGH = 8
+  };
+  uint8_t state_ = 0;
+  bool state(State flag) const { return (state_ & flag) != 0; }
+  void state(State flag, bool value) {
+    state_ = value ? (state_ | flag) : (state_ & ~flag);
+  }
 };
 
 /**
@@ -159,17 +249,32 @@ class BindingSite : public FixedElement {
    * @return bool true if MobileElement interacts with BindingSite
    */
   bool CheckInteraction(const std::string &name);
+  /**
+   * Check to see if BindingSite interacts with a MobileElement, by interned
+   * ID.
+   *
+   * @param type_id interned ID of MobileElement name
+   *
+   * @return bool true if MobileElement interacts with BindingSite
+   */
+  bool CheckInteraction(int type_id) const { return Interacts(type_id); }
   /**
    * Mark this site as degraded.
    */
   void Degrade();
-  bool degraded() { return degraded_; }
-
- private:
+  bool degraded() { return state(DEGRADED); }
   /**
-   * Has this site been degraded? (I.e. covered by RNAse)
+   * Are ribosomes binding this site translated by the mean-field
+   * approximation (see Genome::MeanFieldTranslation)? Part of the site's
+   * definition, so not saved with its state.
    */
-  bool degraded_ = false;
+  bool mean_field() const { return mean_field_; }
+  void mean_field(bool enabled) { mean_field_ = enabled; }
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+
+ private:
+  bool mean_field_ = false;
 };
 
 /**
@@ -213,21 +318,28 @@ class ReleaseSite : public FixedElement {
    * @return bool true if feature interacts with ReleaseSite
    */
   bool CheckInteraction(const std::string &name, int reading_frame);
+  /**
+   * Same as above, by interned ID of the other feature's name.
+   */
+  bool CheckInteraction(int type_id, int reading_frame) const {
+    return Interacts(type_id) &&
+           (reading_frame_ == -1 || reading_frame == reading_frame_);
+  }
   /**
    * Getters and setters
    */
-  bool readthrough() const { return readthrough_; }
-  void readthrough(bool readthrough) { readthrough_ = readthrough; }
-  double efficiency(const std::string &pol_name) {
-    return interactions_[pol_name];
+  bool readthrough() const { return state(READTHROUGH); }
+  void readthrough(bool readthrough) { state(READTHROUGH, readthrough); }
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  double efficiency(const std::string &pol_name) const;
+  double efficiency(int type_id) const {
+    return Interacts(type_id) ? properties_->rates[type_id] : 0.0;
   }
-
- private:
   /**
-   * Readthrough state of ReleaseSite. True if a polymerase is reading through
-   * it and false otherwise.
+   * Set the efficiency for a polymerase this site already interacts with.
    */
-  bool readthrough_;
+  void efficiency(const std::string &pol_name, double efficiency);
 };
 
 /**
@@ -265,22 +377,75 @@ class MobileElement : public std::enable_shared_from_this<MobileElement> {
    * Getters and setters.
    */
   std::string const &name() const { return name_; }
+  int type_id() const { return type_id_; }
+  ElementKind kind() const { return kind_; }
   int start() const { return start_; }
   int stop() const { return stop_; }
   void start(int start) { start_ = start; }
   void stop(int stop) { stop_ = stop; }
   double speed() const { return speed_; }
+  void speed(double speed) { speed_ = speed; }
   int footprint() const { return footprint_; }
   int reading_frame() const { return reading_frame_; }
   void reading_frame(int reading_frame) { reading_frame_ = reading_frame; }
   std::string gene_bound() const { return gene_bound_; }
-  void gene_bound(std::string gene) { gene_bound_ = gene; }
+  void gene_bound(std::string gene) {
+    gene_bound_id_ = InternedName::Id(gene);
+    gene_bound_ = gene;
+  }
+  void gene_bound(const std::string &gene, int gene_id) {
+    gene_bound_ = gene;
+    gene_bound_id_ = gene_id;
+  }
+  int gene_bound_id() const { return gene_bound_id_; }
+  double arrival() const { return arrival_; }
+  void arrival(double time) { arrival_ = time; }
+  /**
+   * State of a run of moves taken in one event (see Polymer::StartRun): the
+   * number of moves left, the time at which the position was last brought
+   * up to date, and the time of the last move of the run.
+   */
+  bool running() const { return run_steps_ > 0; }
+  int run_steps() const { return run_steps_; }
+  double run_from() const { return run_from_; }
+  double run_until() const { return run_until_; }
+  void run(int steps, double from, double until) {
+    run_steps_ = steps;
+    run_from_ = from;
+    run_until_ = until;
+  }
+  /**
+   * Start and stop of the next release site that can release this element
+   * (see Polymer::MayRelease), cached so that moves between release sites
+   * skip looking sites up. A stop before the element's start marks the cache
+   * as out of date.
+   */
+  int release_start() const { return release_start_; }
+  int release_stop() const { return release_stop_; }
+  void release(int start, int stop) {
+    release_start_ = start;
+    release_stop_ = stop;
+  }
+  /**
+   * Save or restore the position of this element, the gene it is
+   * translating and any run it is taking. Its name and speed are not saved.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
 
  protected:
   /**
    * Name of this feature.
    */
   std::string name_;
+  /**
+   * Interned ID of name.
+   */
+  int type_id_;
+  /**
+   * Kind of element, derived from name.
+   */
+  ElementKind kind_;
 
   /**
    * The start site of the feature. Usually the most upstream site position.
@@ -307,6 +472,26 @@ class MobileElement : public std::enable_shared_from_this<MobileElement> {
    * (used for ribosomes)
    */
   std::string gene_bound_ = "";
+  /**
+   * Interned ID of gene_bound_.
+   */
+  int gene_bound_id_;
+  /**
+   * Time at which this element arrived at its current position, if dwell
+   * times are being recorded; -infinity otherwise.
+   */
+  double arrival_ = -std::numeric_limits<double>::infinity();
+  /**
+   * Current run of moves, if run_steps_ > 0.
+   */
+  int run_steps_ = 0;
+  double run_from_ = 0;
+  double run_until_ = 0;
+  /**
+   * Next release site, if release_stop_ >= start_.
+   */
+  int release_start_ = 0;
+  int release_stop_ = -1;
 };
 
 /**
@@ -378,6 +563,13 @@ class Mask : public MobileElement {
    * @return bool true if elements interact
    */
   bool CheckInteraction (const std::string &name) const;
+  /**
+   * Same as above, by interned ID of polymerase name.
+   */
+  bool CheckInteraction(int type_id) const {
+    return type_id < static_cast<int>(interacts_.size()) &&
+           interacts_[type_id];
+  }
 
  private:
   /**
@@ -385,6 +577,10 @@ class Mask : public MobileElement {
    * with.
    */
   std::map<std::string, double> interactions_;
+  /**
+   * Interactions indexed by interned ID of polymerase name.
+   */
+  std::vector<bool> interacts_;
 };
 
 /**
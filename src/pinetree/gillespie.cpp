@@ -1,45 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
 #include "gillespie.hpp"
 #include "choices.hpp"
+#include "profile.hpp"
+#include "tracker.hpp"
+
+/**
+ * Tau-leaping parameters used by the HYBRID method. A species reaction is
+ * critical if it is within LEAP_CRITICAL_FIRINGS firings of exhausting a
+ * reactant. If a leap would be shorter than LEAP_MIN_STEPS expected exact
+ * steps, LEAP_EXACT_STEPS exact steps are taken instead. LEAP_EPSILON bounds
+ * the relative change in propensities during a leap.
+ */
+const static int LEAP_CRITICAL_FIRINGS = 10;
+const static double LEAP_MIN_STEPS = 10.0;
+const static int LEAP_EXACT_STEPS = 100;
+const static double LEAP_EPSILON = 0.03;
 
 void Gillespie::LinkReaction(Reaction::Ptr reaction) {
-  auto it = std::find(reactions_.begin(), reactions_.end(), reaction);
-  if (it == reactions_.end()) {
+  if (!IsLinked(reaction)) {
     reaction->index(reactions_.size());
-    double new_prop = reaction->CalculatePropensity();
-    alpha_list_.push_back(new_prop);
-    alpha_sum_ += new_prop;
+    // Use the full propensity rather than the change in propensity, in case
+    // this reaction's propensity was already cached before it was linked
+    reaction->DispatchPropensity();
+    double new_prop = reaction->propensity();
+    streams_.push_back(next_stream_++);
+    draws_.push_back(0);
+    PushAlpha(new_prop);
+    alpha_sum_.Add(new_prop);
+    schedule_.PushBack(reaction->DispatchScheduledTime());
     reactions_.push_back(reaction);
   }
 }
 
+void Gillespie::LinkSpeciesReaction(SpeciesReaction::Ptr reaction) {
+  if (!IsLinked(reaction)) {
+    species_reactions_.push_back(reaction);
+  }
+  LinkReaction(reaction);
+}
+
 void Gillespie::DeleteReaction(int index) {
   if (index >= reactions_.size() || index < 0) {
     throw std::range_error(
         "Gillespie: Reaction index out of range for reaction deletion.");
   }
   // Update alpha sum
-  alpha_sum_ -= reactions_[index]->CalculatePropensity();
-  // Remove from alpha list
-  alpha_list_.erase(alpha_list_.begin() + index);
-  // Remove from reactions list
-  reactions_.erase(reactions_.begin() + index);
-}
-
-void Gillespie::UpdatePropensity(Reaction::Ptr reaction) {
-  // if (index >= reactions_.size() || index >= alpha_list_.size() || index < 0)
-  // {
-  //  throw std::range_error(
-  //      "Gillespie: Reaction index out of range for propensity update.");
-  // }
-  // double new_prop = reactions_[index]->CalculatePropensity();
-  // double diff = new_prop - alpha_list_[index];
-  // alpha_sum_ += diff;
-  // alpha_list_[index] = new_prop;
-  double alpha_diff = reaction->CalculatePropensity();
-  auto it = std::find(reactions_.begin(), reactions_.end(), reaction);
-  if (it != reactions_.end()) {
-    auto index = std::distance(reactions_.begin(), it);
-    alpha_list_[index] += alpha_diff;
+  alpha_sum_.Add(-alpha_list_[index]);
+  reactions_[index]->index(-1);
+  // Move last reaction into the vacated slot so nothing needs to be shifted
+  int last = reactions_.size() - 1;
+  if (index != last) {
+    reactions_[index] = reactions_[last];
+    reactions_[index]->index(index);
+    MoveAlpha(last, index);
+    schedule_.Update(index, schedule_.key(last));
+    streams_[index] = streams_[last];
+    draws_[index] = draws_[last];
+  }
+  PopAlpha();
+  schedule_.PopBack();
+  streams_.pop_back();
+  draws_.pop_back();
+  reactions_.pop_back();
+}
+
+void Gillespie::UpdatePropensity(const Reaction::Ptr &reaction) {
+  stats_.propensity_updates++;
+  double alpha_diff = reaction->DispatchPropensity();
+  if (IsLinked(reaction)) {
+    int index = reaction->index();
+    // A reaction that can no longer fire drops out of selection exactly,
+    // rather than keeping the rounding error of its propensity deltas
+    SetAlpha(index, reaction->propensity() > 0
+                        ? alpha_list_[index] + alpha_diff
+                        : 0.0);
+    alpha_sum_.Add(alpha_diff);
+    if (active_.empty()) {
+      // Nothing can fire, so the sum is exactly 0 whatever rounding error
+      // its deltas left
+      alpha_sum_ = CompensatedSum();
+    }
+    double scheduled = reaction->DispatchScheduledTime();
+    if (scheduled != schedule_.key(index)) {
+      schedule_.Update(index, scheduled);
+    }
   } else {
     // Don't throw an error unless everything has been initialized
     if (initialized_ == true) {
@@ -47,37 +95,565 @@ void Gillespie::UpdatePropensity(Reaction::Ptr reaction) {
           "Attempting to update propensity of invalid reaction.");
     }
   }
-  alpha_sum_ += alpha_diff;
+}
+
+void Gillespie::MarkDirty(const Reaction::Ptr &reaction) {
+  if (!in_event_) {
+    UpdatePropensity(reaction);
+  } else if (reaction->dirty()) {
+    stats_.redundant_updates++;
+  } else {
+    reaction->dirty(true);
+    dirty_.push_back(reaction);
+  }
+}
+
+void Gillespie::Resum() {
+  resum_order_ = active_;
+  std::sort(resum_order_.begin(), resum_order_.end());
+  CompensatedSum alpha_sum;
+  for (int i : resum_order_) {
+    double alpha = reactions_[i]->propensity();
+    if (alpha != alpha_list_[i]) {
+      SetAlpha(i, alpha);
+    }
+    alpha_sum.Add(alpha);
+  }
+  alpha_sum_ = alpha_sum;
+}
+
+void Gillespie::TrackActive(int index) {
+  bool active = alpha_list_[index] != 0;
+  if (active && active_slot_[index] < 0) {
+    active_sorted_ =
+        active_sorted_ && (active_.empty() || index > active_.back());
+    active_slot_[index] = active_.size();
+    active_.push_back(index);
+  } else if (!active && active_slot_[index] >= 0) {
+    int moved = active_.back();
+    active_sorted_ = active_sorted_ && moved == index;
+    active_[active_slot_[index]] = moved;
+    active_slot_[moved] = active_slot_[index];
+    active_.pop_back();
+    active_slot_[index] = -1;
+  }
+}
+
+int Gillespie::LinearChoice() {
+  if (active_.empty()) {
+    throw std::runtime_error(
+        "Gillespie: Propensity of system is 0. No reactions will execute.");
+  }
+  // Reactions are scanned in index order, so that a random number selects
+  // the same reaction as a scan of every propensity would
+  if (!active_sorted_) {
+    std::sort(active_.begin(), active_.end());
+    for (std::size_t slot = 0; slot < active_.size(); slot++) {
+      active_slot_[active_[slot]] = slot;
+    }
+    active_sorted_ = true;
+  }
+  double random_num = rng_->random();
+  double total = 0;
+  for (int index : active_) {
+    total += alpha_list_[index];
+  }
+  // Find the first active reaction whose cumulative propensity exceeds the
+  // target
+  double target = random_num * total;
+  double cum_alpha = 0;
+  for (int index : active_) {
+    cum_alpha += alpha_list_[index];
+    if (cum_alpha > target) {
+      return index;
+    }
+  }
+  return active_.back();
+}
+
+void Gillespie::UpdateDirty() {
+  PINETREE_ZONE("update propensities");
+  for (const auto &reaction : dirty_) {
+    reaction->dirty(false);
+    UpdatePropensity(reaction);
+  }
+  dirty_.clear();
+}
+
+bool Gillespie::IsLinked(const Reaction::Ptr &reaction) const {
+  int index = reaction->index();
+  return index >= 0 && index < static_cast<int>(reactions_.size()) &&
+         reactions_[index] == reaction;
+}
+
+void Gillespie::method(Method method) {
+  // Selection structures already match the current method; rebuilding them
+  // would discard the waiting times of the next reaction method
+  if (method == method_) {
+    return;
+  }
+  method_ = method;
+  pending_ = false;
+  // Rebuild (or drop) selection structures so that they match the new method
+  alpha_tree_.Clear();
+  alpha_bins_.Clear();
+  reaction_times_.Clear();
+  residuals_.clear();
+  for (int index = 0; index < static_cast<int>(alpha_list_.size()); index++) {
+    double alpha = alpha_list_[index];
+    if (UsesTree()) {
+      alpha_tree_.PushBack(alpha);
+    } else if (method_ == Method::COMPOSITION_REJECTION) {
+      alpha_bins_.PushBack(alpha);
+    } else if (method_ == Method::NEXT_REACTION) {
+      residuals_.push_back(WaitingTime(index));
+      reaction_times_.PushBack(ScheduledTime(residuals_.size() - 1));
+    }
+  }
+}
+
+void Gillespie::PushAlpha(double alpha) {
+  pending_ = false;
+  alpha_list_.push_back(alpha);
+  active_slot_.push_back(-1);
+  TrackActive(alpha_list_.size() - 1);
+  if (UsesTree()) {
+    alpha_tree_.PushBack(alpha);
+  } else if (method_ == Method::COMPOSITION_REJECTION) {
+    alpha_bins_.PushBack(alpha);
+  } else if (method_ == Method::NEXT_REACTION) {
+    residuals_.push_back(WaitingTime(alpha_list_.size() - 1));
+    reaction_times_.PushBack(ScheduledTime(residuals_.size() - 1));
+  }
+}
+
+void Gillespie::SetAlpha(int index, double alpha) {
+  pending_ = false;
+  double old_alpha = alpha_list_[index];
+  alpha_list_[index] = alpha;
+  TrackActive(index);
+  if (UsesTree()) {
+    alpha_tree_.Update(index, alpha);
+  } else if (method_ == Method::COMPOSITION_REJECTION) {
+    alpha_bins_.Update(index, alpha);
+  } else if (method_ == Method::NEXT_REACTION && index != firing_) {
+    // Rescale the remaining waiting time to the new propensity, so that no
+    // new random number is needed. If the old propensity was 0, the residual
+    // saved when the reaction was switched off is reused.
+    if (old_alpha > 0) {
+      residuals_[index] = old_alpha * (reaction_times_.key(index) - time_);
+    }
+    reaction_times_.Update(index, ScheduledTime(index));
+  }
+}
+
+void Gillespie::PopAlpha() {
+  pending_ = false;
+  alpha_list_.back() = 0;
+  TrackActive(alpha_list_.size() - 1);
+  active_slot_.pop_back();
+  alpha_list_.pop_back();
+  if (UsesTree()) {
+    alpha_tree_.PopBack();
+  } else if (method_ == Method::COMPOSITION_REJECTION) {
+    alpha_bins_.PopBack();
+  } else if (method_ == Method::NEXT_REACTION) {
+    residuals_.pop_back();
+    reaction_times_.PopBack();
+  }
+}
+
+void Gillespie::MoveAlpha(int from, int to) {
+  alpha_list_[to] = alpha_list_[from];
+  TrackActive(to);
+  if (UsesTree()) {
+    alpha_tree_.Update(to, alpha_list_[to]);
+  } else if (method_ == Method::COMPOSITION_REJECTION) {
+    alpha_bins_.Update(to, alpha_list_[to]);
+  } else if (method_ == Method::NEXT_REACTION) {
+    residuals_[to] = residuals_[from];
+    reaction_times_.Update(to, reaction_times_.key(from));
+  }
+}
+
+double Gillespie::WaitingTime(int index) {
+  if (!common_random_numbers_) {
+    return rng_->exponential();
+  }
+  double random_num = rng_->keyed(streams_[index], draws_[index]++);
+  return std::log(1.0 / random_num);
+}
+
+double Gillespie::ScheduledTime(int index) const {
+  if (alpha_list_[index] <= 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return time_ + residuals_[index] / alpha_list_[index];
 }
 
 void Gillespie::Iterate() {
+  Step(std::numeric_limits<double>::infinity());
+}
+
+bool Gillespie::RunUntil(double until, int *budget) {
+  while (time_ < until) {
+    if (budget) {
+      if (*budget <= 0 || (tracker_ && tracker_->watched_changed())) {
+        return false;
+      }
+      --*budget;
+    }
+    if (!Step(until)) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool Gillespie::Step(double until) {
   // Make sure propensities have been initialized
   if (initialized_ == false) {
     Initialize();
   }
+  // A scheduled event due no later than until takes the place of until
+  double next_scheduled = schedule_.size() > 0
+                              ? schedule_.key(schedule_.top())
+                              : std::numeric_limits<double>::infinity();
+  int scheduled = -1;
+  double limit = until;
+  if (next_scheduled <= until) {
+    scheduled = schedule_.top();
+    limit = next_scheduled;
+    if (limit <= time_) {
+      return Advance(time_, scheduled);
+    }
+  }
+  if (pending_) {
+    if (pending_time_ > limit) {
+      return Advance(limit, scheduled);
+    }
+    pending_ = false;
+    time_ = pending_time_;
+    Fire(Choose());
+    iteration_++;
+    return true;
+  }
 
   // Basic sanity checks
-  if (alpha_sum_ <= 0) {
+  if (active_.empty() || alpha_sum_.value() <= 0) {
+    if (std::isfinite(next_scheduled) || (idle_ && std::isfinite(limit))) {
+      // Nothing happens until the next scheduled event or the end of the run
+      return Advance(limit, scheduled);
+    }
     throw std::runtime_error(
         "Gillespie: Propensity of system is 0. No reactions will execute.");
   }
-  double random_num = Random::random();
-  // Calculate tau, i.e. time until next reaction
-  double tau = (1.0 / alpha_sum_) * std::log(1.0 / random_num);
-  if (!std::isnormal(tau)) {
-    throw std::underflow_error("Underflow error.");
+  if (resummation_interval_ > 0 && iteration_ > 0 &&
+      iteration_ % resummation_interval_ == 0) {
+    Resum();
   }
-  time_ += tau;
-  // Randomly select next reaction to execute, weighted by propensities
-  auto next_reaction = Random::WeightedChoiceIndex(reactions_, alpha_list_);
-  reactions_[next_reaction]->Execute();
-  // std::cout << std::to_string(alpha_list_[next_reaction]) << std::endl;
-  UpdatePropensity(reactions_[next_reaction]);
-  if (reactions_[next_reaction]->remove() == true) {
-    // std::cout << std::to_string(alpha_list_[next_reaction]) << std::endl;
-    DeleteReaction(next_reaction);
+  if (method_ == Method::HYBRID && Leap(limit)) {
+    iteration_++;
+    return true;
   }
+  int next_reaction;
+  if (method_ == Method::NEXT_REACTION) {
+    // The reaction with the earliest putative time fires next
+    next_reaction = reaction_times_.top();
+    double next_time = reaction_times_.key(next_reaction);
+    if (!std::isfinite(next_time) && !std::isfinite(next_scheduled) &&
+        !(idle_ && std::isfinite(limit))) {
+      throw std::runtime_error(
+          "Gillespie: Propensity of system is 0. No reactions will execute.");
+    }
+    if (next_time > limit) {
+      return Advance(limit, scheduled);
+    }
+    time_ = next_time;
+    firing_ = next_reaction;
+  } else {
+    // Calculate tau, i.e. time until next reaction
+    double tau = (1.0 / alpha_sum_.value()) * rng_->exponential();
+    if (!std::isnormal(tau)) {
+      throw std::underflow_error("Underflow error.");
+    }
+    double next_time = time_ + tau;
+    if (next_time > limit) {
+      // The reaction is only selected once it fires, so that stopping draws
+      // no extra random numbers; an event scheduled at limit discards it
+      pending_ = true;
+      pending_time_ = next_time;
+      return Advance(limit, scheduled);
+    }
+    time_ = next_time;
+    next_reaction = Choose();
+  }
+  Fire(next_reaction);
   iteration_++;
+  return true;
+}
+
+int Gillespie::Choose() {
+  // Randomly select next reaction to execute, weighted by propensities
+  PINETREE_ZONE("select reaction");
+  if (UsesTree()) {
+    return alpha_tree_.Find(rng_->random() * alpha_tree_.total());
+  }
+  if (method_ == Method::COMPOSITION_REJECTION) {
+    return alpha_bins_.Choose(*rng_);
+  }
+  return LinearChoice();
+}
+
+void Gillespie::Fire(int index) {
+  stats_.events[reactions_[index]->kind()]++;
+  in_event_ = true;
+  {
+    PINETREE_ZONE("execute");
+    reactions_[index]->DispatchExecute();
+  }
+  // The executed reaction is usually queued already, e.g. by a change in its
+  // own reactants
+  MarkDirty(reactions_[index]);
+  if (after_event_) {
+    after_event_(reactions_[index]->kind());
+  }
+  if (observers_) {
+    observers_->Event(*reactions_[index]);
+  }
+  in_event_ = false;
+  UpdateDirty();
+  if (method_ == Method::NEXT_REACTION) {
+    // Only the reaction that just fired draws a new random number
+    firing_ = -1;
+    residuals_[index] = WaitingTime(index);
+    reaction_times_.Update(index, ScheduledTime(index));
+  }
+  if (reactions_[index]->remove() == true) {
+    DeleteReaction(index);
+  }
+}
+
+bool Gillespie::Advance(double limit, int scheduled) {
+  time_ = limit;
+  if (scheduled == -1) {
+    return false;
+  }
+  // The event changes propensities, so a reaction drawn past it no longer
+  // holds; by memorylessness the next one is simply drawn afresh
+  pending_ = false;
+  stats_.scheduled++;
+  in_event_ = true;
+  reactions_[scheduled]->DispatchExecuteScheduled();
+  MarkDirty(reactions_[scheduled]);
+  if (after_event_) {
+    after_event_(reactions_[scheduled]->kind());
+  }
+  in_event_ = false;
+  UpdateDirty();
+  return true;
+}
+
+void Gillespie::UpdateLeapTable() {
+  if (leap_table_.first.size() == species_reactions_.size()) {
+    return;
+  }
+  LeapTable &table = leap_table_;
+  table = LeapTable();
+  for (const auto &reaction : species_reactions_) {
+    table.species.insert(table.species.end(), reaction->reactant_ids().begin(),
+                         reaction->reactant_ids().end());
+    table.species.insert(table.species.end(), reaction->product_ids().begin(),
+                         reaction->product_ids().end());
+  }
+  std::sort(table.species.begin(), table.species.end());
+  table.species.erase(std::unique(table.species.begin(), table.species.end()),
+                      table.species.end());
+  auto position = [&table](int id) {
+    return std::lower_bound(table.species.begin(), table.species.end(), id) -
+           table.species.begin();
+  };
+  table.order.assign(table.species.size(), 0);
+  table.change_start.push_back(0);
+  std::map<int, int> changes;
+  for (const auto &reaction : species_reactions_) {
+    const auto &reactants = reaction->reactant_ids();
+    table.first.push_back(reactants.size() > 0 ? position(reactants[0]) : -1);
+    table.second.push_back(reactants.size() > 1 ? position(reactants[1]) : -1);
+    changes.clear();
+    for (int reactant : reactants) {
+      changes[position(reactant)]--;
+    }
+    for (const auto &item : changes) {
+      int rxn_order = (item.second == -2) ? -2 : reactants.size();
+      int &current = table.order[item.first];
+      if (rxn_order == -2 || (current != -2 && rxn_order > current)) {
+        current = rxn_order;
+      }
+    }
+    for (int product : reaction->product_ids()) {
+      changes[position(product)]++;
+    }
+    for (const auto &item : changes) {
+      if (item.second != 0) {
+        table.change_species.push_back(item.first);
+        table.change_count.push_back(item.second);
+      }
+    }
+    table.change_start.push_back(table.change_species.size());
+  }
+}
+
+bool Gillespie::Leap(double until) {
+  if (exact_steps_ > 0) {
+    exact_steps_--;
+    return false;
+  }
+  UpdateLeapTable();
+  const LeapTable &table = leap_table_;
+  int species_count = table.species.size();
+  leap_counts_.resize(species_count);
+  for (int i = 0; i < species_count; i++) {
+    leap_counts_[i] = tracker_->species(table.species[i]);
+  }
+  // Find non-critical reactions, i.e. species reactions that can fire at
+  // least LEAP_CRITICAL_FIRINGS more times before exhausting a reactant
+  leap_noncritical_.clear();
+  for (int j = 0; j < static_cast<int>(species_reactions_.size()); j++) {
+    if (alpha_list_[species_reactions_[j]->index()] <= 0) {
+      continue;
+    }
+    int first = table.first[j];
+    int second = table.second[j];
+    int firings = std::numeric_limits<int>::max();
+    if (first != -1 && first == second) {
+      firings = leap_counts_[first] / 2;
+    } else {
+      if (first != -1) {
+        firings = leap_counts_[first];
+      }
+      if (second != -1) {
+        firings = std::min(firings, leap_counts_[second]);
+      }
+    }
+    if (firings >= LEAP_CRITICAL_FIRINGS) {
+      leap_noncritical_.push_back(j);
+    }
+  }
+  const std::vector<int> &noncritical = leap_noncritical_;
+  if (noncritical.empty()) {
+    exact_steps_ = LEAP_EXACT_STEPS - 1;
+    return false;
+  }
+
+  // Cao step size selection: bound the expected relative change in the
+  // propensity of every reaction by LEAP_EPSILON
+  leap_mean_.assign(species_count, 0.0);
+  leap_variance_.assign(species_count, 0.0);
+  for (int j : noncritical) {
+    double alpha = alpha_list_[species_reactions_[j]->index()];
+    for (int k = table.change_start[j]; k < table.change_start[j + 1]; k++) {
+      int i = table.change_species[k];
+      int change = table.change_count[k];
+      if (table.order[i] == 0) {
+        continue;
+      }
+      leap_mean_[i] += change * alpha;
+      leap_variance_[i] += change * change * alpha;
+    }
+  }
+  double tau_leap = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < species_count; i++) {
+    if (table.order[i] == 0) {
+      continue;
+    }
+    int count = leap_counts_[i];
+    double g = table.order[i];
+    if (table.order[i] == -2) {
+      g = (count > 1) ? 2.0 + 1.0 / (count - 1) : 2.0;
+    }
+    double bound = std::max(LEAP_EPSILON * count / g, 1.0);
+    if (leap_mean_[i] != 0) {
+      tau_leap = std::min(tau_leap, bound / std::abs(leap_mean_[i]));
+    }
+    if (leap_variance_[i] != 0) {
+      tau_leap = std::min(tau_leap, bound * bound / leap_variance_[i]);
+    }
+  }
+  // Leaping only pays off if it covers several exact steps
+  if (tau_leap < LEAP_MIN_STEPS / alpha_sum_.value()) {
+    exact_steps_ = LEAP_EXACT_STEPS - 1;
+    return false;
+  }
+  // Never leap past the time the caller wants to stop at
+  tau_leap = std::min(tau_leap, until - time_);
+
+  // Remove non-critical reactions from the tree so that critical (exact)
+  // reactions can be selected on their own
+  for (int j : noncritical) {
+    alpha_tree_.Update(species_reactions_[j]->index(), 0.0);
+  }
+  double critical_sum = alpha_tree_.total();
+  double tau_exact = std::numeric_limits<double>::infinity();
+  if (critical_sum > 0) {
+    tau_exact = rng_->exponential() / critical_sum;
+  }
+  int critical = -1;
+  if (tau_exact <= tau_leap) {
+    critical = alpha_tree_.Find(rng_->random() * critical_sum);
+  }
+  for (int j : noncritical) {
+    int index = species_reactions_[j]->index();
+    alpha_tree_.Update(index, alpha_list_[index]);
+  }
+
+  // Draw firing counts, halving the step until no species goes negative
+  double tau = std::min(tau_leap, tau_exact);
+  while (true) {
+    leap_net_.assign(species_count, 0);
+    for (int j : noncritical) {
+      int firings = rng_->poisson(alpha_list_[species_reactions_[j]->index()] *
+                                  tau);
+      for (int k = table.change_start[j]; k < table.change_start[j + 1];
+           k++) {
+        leap_net_[table.change_species[k]] += table.change_count[k] * firings;
+      }
+    }
+    bool negative = false;
+    for (int i = 0; i < species_count; i++) {
+      if (leap_counts_[i] + leap_net_[i] < 0) {
+        negative = true;
+        break;
+      }
+    }
+    if (!negative) {
+      break;
+    }
+    tau_leap = tau_leap / 2;
+    if (tau_leap < tau_exact) {
+      tau = tau_leap;
+      critical = -1;
+    }
+  }
+
+  time_ += tau;
+  stats_.leaps++;
+  // Apply net changes so that no species passes through a negative count
+  in_event_ = true;
+  for (int i = 0; i < species_count; i++) {
+    if (leap_net_[i] != 0) {
+      tracker_->Increment(table.species[i], leap_net_[i]);
+    }
+  }
+  if (after_event_) {
+    after_event_(Reaction::SPECIES);
+  }
+  in_event_ = false;
+  UpdateDirty();
+  if (critical != -1) {
+    Fire(critical);
+  }
+  return true;
 }
 
 void Gillespie::Initialize() {
@@ -97,3 +673,145 @@ void Gillespie::Initialize() {
   // }
   initialized_ = true;
 }
+
+void Gillespie::Save(
+    CheckpointWriter &writer,
+    const std::function<int(const Reaction::Ptr &)> &reaction_id) const {
+  writer.Write(initialized_);
+  writer.Write(time_);
+  writer.Write<int32_t>(iteration_);
+  writer.Write<int32_t>(static_cast<int>(method_));
+  writer.Write<int32_t>(exact_steps_);
+  writer.Write<int64_t>(stats_.propensity_updates);
+  writer.Write<int64_t>(stats_.redundant_updates);
+  for (long long events : stats_.events) {
+    writer.Write<int64_t>(events);
+  }
+  writer.Write<int64_t>(stats_.leaps);
+  writer.Write<int64_t>(stats_.scheduled);
+  writer.Write<uint32_t>(reactions_.size());
+  for (const auto &reaction : reactions_) {
+    writer.Write<int32_t>(reaction_id(reaction));
+    writer.Write(reaction->propensity());
+  }
+  writer.Write(alpha_list_);
+  alpha_sum_.Save(writer);
+  alpha_tree_.Save(writer);
+  alpha_bins_.Save(writer);
+  reaction_times_.Save(writer);
+  writer.Write(residuals_);
+  writer.Write<int32_t>(pending_ ? 0 : -1);
+  writer.Write(pending_time_);
+  if (common_random_numbers_) {
+    writer.Write(streams_);
+    writer.Write(draws_);
+    writer.Write<uint64_t>(next_stream_);
+  }
+}
+
+void Gillespie::Load(CheckpointReader &reader,
+                     const std::function<Reaction::Ptr(int)> &reaction) {
+  reader.Read(initialized_);
+  reader.Read(time_);
+  iteration_ = reader.Read<int32_t>();
+  method_ = static_cast<Method>(reader.Read<int32_t>());
+  exact_steps_ = reader.Read<int32_t>();
+  stats_.propensity_updates = reader.Read<int64_t>();
+  stats_.redundant_updates = reader.Read<int64_t>();
+  for (long long &events : stats_.events) {
+    events = reader.Read<int64_t>();
+  }
+  stats_.leaps = reader.Read<int64_t>();
+  stats_.scheduled = reader.Read<int64_t>();
+  int count = reader.Read<uint32_t>();
+  CheckpointReader::Expect(count == static_cast<int>(reactions_.size()),
+                           "number of reactions");
+  for (int i = 0; i < count; i++) {
+    auto next = reaction(reader.Read<int32_t>());
+    next->index(i);
+    next->propensity(reader.Read<double>());
+    next->dirty(false);
+    reactions_[i] = next;
+  }
+  reader.Read(alpha_list_);
+  active_.clear();
+  active_slot_.assign(alpha_list_.size(), -1);
+  active_sorted_ = true;
+  for (int i = 0; i < static_cast<int>(alpha_list_.size()); i++) {
+    TrackActive(i);
+  }
+  alpha_sum_.Load(reader);
+  alpha_tree_.Load(reader);
+  alpha_bins_.Load(reader);
+  reaction_times_.Load(reader);
+  reader.Read(residuals_);
+  pending_ = reader.Read<int32_t>() >= 0;
+  reader.Read(pending_time_);
+  if (common_random_numbers_) {
+    reader.Read(streams_);
+    reader.Read(draws_);
+    CheckpointReader::Expect(
+        static_cast<int>(streams_.size()) == count &&
+            static_cast<int>(draws_.size()) == count,
+        "random streams");
+    next_stream_ = reader.Read<uint64_t>();
+  }
+  // Scheduled events are part of the state of the restored reactions
+  schedule_.Clear();
+  for (const auto &next : reactions_) {
+    schedule_.PushBack(next->DispatchScheduledTime());
+  }
+  firing_ = -1;
+  in_event_ = false;
+  dirty_.clear();
+}
+
+void Gillespie::Memory(MemoryReport &report) const {
+  const LeapTable &table = leap_table_;
+  report.Add(
+      "engine", 1,
+      MemoryReport::Bytes(alpha_list_) + MemoryReport::Bytes(active_) +
+          MemoryReport::Bytes(active_slot_) +
+          MemoryReport::Bytes(resum_order_) + alpha_tree_.memory() +
+          alpha_bins_.memory() + reaction_times_.memory() +
+          MemoryReport::Bytes(residuals_) + MemoryReport::Bytes(streams_) +
+          MemoryReport::Bytes(draws_) + schedule_.memory() +
+          MemoryReport::Bytes(reactions_) +
+          MemoryReport::Bytes(species_reactions_) +
+          MemoryReport::Bytes(table.first) + MemoryReport::Bytes(table.second) +
+          MemoryReport::Bytes(table.change_start) +
+          MemoryReport::Bytes(table.change_species) +
+          MemoryReport::Bytes(table.change_count) +
+          MemoryReport::Bytes(table.species) +
+          MemoryReport::Bytes(table.order) +
+          MemoryReport::Bytes(leap_noncritical_) +
+          MemoryReport::Bytes(leap_counts_) + MemoryReport::Bytes(leap_net_) +
+          MemoryReport::Bytes(leap_mean_) +
+          MemoryReport::Bytes(leap_variance_) + MemoryReport::Bytes(dirty_));
+  std::size_t bytes = 0;
+  for (const auto &reaction : reactions_) {
+    switch (reaction->kind()) {
+      case Reaction::SPECIES:
+        bytes += sizeof(SpeciesReaction);
+        break;
+      case Reaction::BIND_POLYMERASE:
+        bytes += sizeof(BindPolymerase);
+        break;
+      case Reaction::BIND_RNASE:
+        bytes += sizeof(BindRnase);
+        break;
+      case Reaction::POLYMER:
+        bytes += sizeof(PolymerWrapper);
+        break;
+      default:
+        bytes += sizeof(Perturbations);
+    }
+  }
+  for (const auto &reaction : species_reactions_) {
+    bytes += MemoryReport::Bytes(reaction->reactants()) +
+             MemoryReport::Bytes(reaction->products()) +
+             MemoryReport::Bytes(reaction->reactant_ids()) +
+             MemoryReport::Bytes(reaction->product_ids());
+  }
+  report.Add("reactions", reactions_.size(), bytes);
+}
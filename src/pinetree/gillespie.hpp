@@ -1,38 +1,210 @@
 #ifndef SRC_GILLESPIE_HPP  // header guard
 #define SRC_GILLESPIE_HPP
 
+#include <array>
+#include <functional>
 #include <vector>
 
+#include "compensated_sum.hpp"
+#include "indexed_priority_queue.hpp"
+#include "memory_report.hpp"
+#include "observer.hpp"
+#include "propensity_bins.hpp"
+#include "propensity_tree.hpp"
 #include "reaction.hpp"
 
 class Gillespie {
  public:
+  /**
+   * Strategies for selecting the next reaction to execute. DIRECT_TREE stores
+   * propensities in a sum tree for O(log n) selection, DIRECT_LINEAR scans the
+   * full propensity list on every iteration, and COMPOSITION_REJECTION groups
+   * propensities into power-of-two bins for O(1) average selection.
+   * NEXT_REACTION is the next reaction method of Gibson and Bruck, which keeps
+   * a putative firing time for every reaction in an indexed priority queue
+   * and only reschedules reactions whose propensities change. HYBRID
+   * advances species reactions with high copy-number reactants by adaptive
+   * tau-leaping (Cao, Gillespie, and Petzold 2006) and executes all other
+   * reactions exactly using DIRECT_TREE.
+   */
+  enum class Method {
+    DIRECT_TREE,
+    DIRECT_LINEAR,
+    COMPOSITION_REJECTION,
+    NEXT_REACTION,
+    HYBRID
+  };
+  /**
+   * Counts of work done by the engine.
+   */
+  struct Stats {
+    /**
+     * Number of reaction propensities recomputed.
+     */
+    long long propensity_updates = 0;
+    /**
+     * Number of updates skipped because the reaction was already queued for
+     * recomputation in the same event.
+     */
+    long long redundant_updates = 0;
+    /**
+     * Number of events of each class of reaction (see Reaction::Kind).
+     */
+    std::array<long long, Reaction::KIND_COUNT> events = {};
+    /**
+     * Number of tau-leaps taken by the hybrid method.
+     */
+    long long leaps = 0;
+    /**
+     * Number of scheduled events (see Reaction::scheduled_time).
+     */
+    long long scheduled = 0;
+  };
   /**
    * Add Reaction object to reaction queue.
    */
   void LinkReaction(Reaction::Ptr reaction);
   /**
-   * Remove Reaction object from reaction queue.
+   * Add a SpeciesReaction to reaction queue. Species reactions are the only
+   * reactions that may be tau-leaped.
+   */
+  void LinkSpeciesReaction(SpeciesReaction::Ptr reaction);
+  /**
+   * Remove Reaction object from reaction queue. The last reaction in the
+   * queue takes the place of the removed reaction.
    */
   void DeleteReaction(int index);
   /**
    * Update propensity of a reaction.
    */
-  void UpdatePropensity(Reaction::Ptr reaction);
+  void UpdatePropensity(const Reaction::Ptr &reaction);
+  /**
+   * Mark the propensity of a reaction as out of date. While a reaction is
+   * executing, dirty reactions are queued and recomputed in one batch once
+   * execution is complete, so that each is recomputed only once per event;
+   * at any other time the propensity is updated immediately.
+   */
+  void MarkDirty(const Reaction::Ptr &reaction);
   /**
    * Execute one iteration of the gillespie algorithm.
    */
   void Iterate();
+  /**
+   * Execute every reaction that occurs up to a given time and advance the
+   * clock to exactly that time, so that the state afterwards is the state
+   * of the system at that time. An event that was sampled but falls after
+   * the given time is kept and fires on the next call, so stopping does not
+   * change the trajectory.
+   *
+   * @param until time to advance to
+   * @param budget if given, the number of events left before the run
+   *  returns early, decremented as events execute; the run also returns
+   *  early as soon as a count watched by the tracker changes (see
+   *  SpeciesTracker::Watch), so the caller can poll for cancellation and
+   *  check stop conditions between batches without changing the trajectory
+   * @return false if the run returned before reaching until
+   */
+  bool RunUntil(double until, int *budget = nullptr);
   /**
    * Getters and setters.
    */
-  double time() { return time_; }
+  double time() const { return time_; }
+  /**
+   * @return the simulation clock, for collectors that read the time
+   */
+  const double *clock() const { return &time_; }
+  Method method() const { return method_; }
+  void method(Method method);
+  void tracker(std::shared_ptr<SpeciesTracker> tracker) { tracker_ = tracker; }
+  void rng(std::shared_ptr<Random> rng) { rng_ = rng; }
+  const Stats &stats() const { return stats_; }
+  /**
+   * Count events of a class of reaction executed outside the engine, e.g.
+   * by the worker threads of a parallel simulation.
+   */
+  void CountEvents(Reaction::Kind kind, long long events) {
+    stats_.events[kind] += events;
+  }
+  /**
+   * Call a function with the class of reaction (see Reaction::Kind) at the
+   * end of every event, before the propensities it changed are updated,
+   * e.g. to redraw fast species (see PartialEquilibrium). Leaps count as
+   * species events, the ends of runs as polymer events and timed changes
+   * as perturbation events.
+   */
+  void after_event(std::function<void(Reaction::Kind)> hook) {
+    after_event_ = hook;
+  }
+  /**
+   * Report every reaction fired by the exact methods to observers.
+   *
+   * @param observers observers to report to, or nullptr to stop reporting
+   */
+  void observers(Observers::Ptr observers) { observers_ = observers; }
+  /**
+   * Draw the waiting times of the next reaction method of each reaction
+   * from a stream of its own (see Random::keyed), numbered by the order in
+   * which reactions were linked, instead of from the shared sequence of
+   * the generator. Two runs from the same seed then use the same random
+   * numbers for the same reaction even where they diverge, so the
+   * differences between paired runs of nearby parameter values have much
+   * lower variance (common random numbers). Has no effect on the other
+   * methods, and must not change while a simulation is underway.
+   */
+  bool common_random_numbers() const { return common_random_numbers_; }
+  void common_random_numbers(bool enabled) {
+    common_random_numbers_ = enabled;
+  }
+  /**
+   * Let the clock advance to the end of a run (see RunUntil) when no
+   * reaction can fire, instead of throwing, e.g. while the polymers of a
+   * parallel simulation are parked and moved outside the engine.
+   */
+  void idle(bool enabled) { idle_ = enabled; }
+  int resummation_interval() const { return resummation_interval_; }
+  void resummation_interval(int interval) { resummation_interval_ = interval; }
+  const Reaction::VecPtr &reactions() const { return reactions_; }
+  /**
+   * Number of reactions with a non-zero propensity, which are the only ones
+   * visited by linear selection and resummation.
+   */
+  int active_count() const { return active_.size(); }
+  /**
+   * Save or restore the clock, the order of reactions and every structure
+   * used to select them, so that a restored simulation continues exactly as
+   * the original would have. Restoring requires the same set of reactions
+   * to be linked already, in any order.
+   *
+   * @param reaction_id stable ID of a linked reaction
+   * @param reaction linked reaction with a given ID
+   */
+  void Save(CheckpointWriter &writer,
+            const std::function<int(const Reaction::Ptr &)> &reaction_id) const;
+  void Load(CheckpointReader &reader,
+            const std::function<Reaction::Ptr(int)> &reaction);
+  /**
+   * Add the reactions and the structures used to select them to a memory
+   * report. Polymers are not included.
+   */
+  void Memory(MemoryReport &report) const;
 
  private:
+  /**
+   * Tracker holding species counts, used to size tau-leaping steps.
+   */
+  std::shared_ptr<SpeciesTracker> tracker_;
+  /**
+   * Random number generator of the Model running this simulation.
+   */
+  std::shared_ptr<Random> rng_;
   /**
    * True if Initialize() has been called.
    */
   bool initialized_ = false;
+  /**
+   * Whether the clock may advance without any reaction (see idle).
+   */
+  bool idle_ = false;
   /**
    * Current simulation time.
    */
@@ -45,18 +217,255 @@ class Gillespie {
    * Vector of individual reaction propensities in same order as reactions_.
    */
   std::vector<double> alpha_list_;
+  /**
+   * Indices of reactions whose entry in alpha_list_ is not 0, and the
+   * position of each reaction in it or -1. Reactions drop out when their
+   * propensity falls to 0 (e.g. binding to a promoter covered on every
+   * genome) and rejoin when it becomes positive. Removals swap the last
+   * entry into place, so the indices are only in order while active_sorted_
+   * is set; linear selection sorts them when it is not.
+   */
+  std::vector<int> active_;
+  std::vector<int> active_slot_;
+  bool active_sorted_ = true;
+  /**
+   * Scratch space of Resum, reused between resummations.
+   */
+  std::vector<int> resum_order_;
+  /**
+   * Add a reaction to active_ or remove it, to match its entry in
+   * alpha_list_.
+   */
+  void TrackActive(int index);
+  /**
+   * Select an active reaction weighted by propensity, scanning active_ in
+   * index order.
+   */
+  int LinearChoice();
+  /**
+   * Select the reaction of the next event of a direct method.
+   */
+  int Choose();
   /**
    * Running total of propensities.
    */
-  double alpha_sum_ = 0;
+  CompensatedSum alpha_sum_;
+  /**
+   * Number of iterations between exact resummations of all propensities, or
+   * 0 to never resum.
+   */
+  int resummation_interval_ = 100000;
+  /**
+   * Sum tree over alpha_list_, only maintained when using DIRECT_TREE.
+   */
+  PropensityTree alpha_tree_;
+  /**
+   * Binned propensities, only maintained when using COMPOSITION_REJECTION.
+   */
+  PropensityBins alpha_bins_;
+  /**
+   * Putative firing time of each reaction, only maintained when using
+   * NEXT_REACTION.
+   */
+  IndexedPriorityQueue reaction_times_;
+  /**
+   * Remaining unit-rate exponential waiting time of each reaction as of its
+   * last reschedule. Used to rescale firing times when a propensity changes,
+   * and to remember the waiting time of a reaction while its propensity is 0.
+   */
+  std::vector<double> residuals_;
+  /**
+   * Whether reactions draw from streams of their own (see
+   * common_random_numbers), the stream number of each reaction and the
+   * number of draws from it, and the number of the next reaction to be
+   * linked.
+   */
+  bool common_random_numbers_ = false;
+  std::vector<std::uint64_t> streams_;
+  std::vector<std::uint64_t> draws_;
+  std::uint64_t next_stream_ = 0;
+  /**
+   * Draw a new unit-rate exponential waiting time for a reaction.
+   */
+  double WaitingTime(int index);
+  /**
+   * Time of the next scheduled event of each reaction, maintained for every
+   * method and rebuilt from the reactions when restoring a checkpoint.
+   * Scheduled events take precedence over any random event drawn for a
+   * later time, which the scheduled event discards (see pending_).
+   */
+  IndexedPriorityQueue schedule_;
+  /**
+   * Index of the reaction currently executing under NEXT_REACTION, which gets
+   * a fresh firing time once execution is complete.
+   */
+  int firing_ = -1;
+  /**
+   * Whether a direct method sampled a firing time, pending_time_, that fell
+   * after the end of a run (see RunUntil) or the next scheduled event. The
+   * event fires then unless a propensity changes first, in which case it is
+   * discarded and a new event is sampled from the current time. Its
+   * reaction is only selected when it fires, so that a run stopping in
+   * between uses the same random numbers as one that does not.
+   */
+  bool pending_ = false;
+  double pending_time_ = 0;
+  /**
+   * Reaction selection strategy.
+   */
+  Method method_ = Method::DIRECT_TREE;
   /**
    * Vector of all reactions.
    */
   Reaction::VecPtr reactions_;
+  /**
+   * All species reactions, which are also stored in reactions_.
+   */
+  std::vector<SpeciesReaction::Ptr> species_reactions_;
+  /**
+   * Stoichiometry of species_reactions_ as flat arrays, so that Leap does
+   * not rebuild it from the reactions at every leap. Species are numbered
+   * by their position in `species`, which lists every species a reaction
+   * consumes or produces in order of tracker ID.
+   */
+  struct LeapTable {
+    /**
+     * Positions of the (up to two) reactants of each reaction, or -1.
+     */
+    std::vector<int> first;
+    std::vector<int> second;
+    /**
+     * Non-zero net changes per firing of reaction j, as (position, change)
+     * pairs in order of position over [change_start[j], change_start[j+1]).
+     */
+    std::vector<int> change_start;
+    std::vector<int> change_species;
+    std::vector<int> change_count;
+    /**
+     * Tracker ID of each species.
+     */
+    std::vector<int> species;
+    /**
+     * Highest order of any reaction consuming each species, where -2 marks a
+     * second-order reaction with two copies of the same species, or 0 if no
+     * reaction consumes it.
+     */
+    std::vector<int> order;
+  };
+  LeapTable leap_table_;
+  /**
+   * Scratch space of Leap, reused between leaps.
+   */
+  std::vector<int> leap_noncritical_;
+  std::vector<int> leap_counts_;
+  std::vector<int> leap_net_;
+  std::vector<double> leap_mean_;
+  std::vector<double> leap_variance_;
+  /**
+   * Rebuild leap_table_ if species reactions were linked since it was
+   * built.
+   */
+  void UpdateLeapTable();
+  /**
+   * Number of exact steps left to take under HYBRID before attempting another
+   * leap. Set when leaping would not be faster than exact simulation.
+   */
+  int exact_steps_ = 0;
+  /**
+   * True while an event is being executed, i.e. while propensity updates
+   * are queued in dirty_.
+   */
+  bool in_event_ = false;
+  /**
+   * Reactions whose propensities changed during the current event, each
+   * listed once.
+   */
+  Reaction::VecPtr dirty_;
+  /**
+   * Counts of work done.
+   */
+  Stats stats_;
+  /**
+   * Function called at the end of every event, if any.
+   */
+  std::function<void(Reaction::Kind)> after_event_;
+  Observers::Ptr observers_;
+  /**
+   * Recompute the propensities of all queued reactions.
+   */
+  void UpdateDirty();
+  /**
+   * Reset every active entry of alpha_list_ to the cached propensity of its
+   * reaction and recompute alpha_sum_ from scratch, discarding rounding error
+   * accumulated by propensity deltas. Entries are summed in index order, so
+   * the result does not depend on the order of active_. Takes O(k log k)
+   * time for k active reactions, plus O(log n) for each entry that had
+   * drifted.
+   */
+  void Resum();
   /**
    * Compute all propensities after all reactions have been added.
    */
   void Initialize();
+  /**
+   * Is this reaction in the reaction list? Relies on the index stored in the
+   * reaction itself, so takes constant time.
+   */
+  bool IsLinked(const Reaction::Ptr &reaction) const;
+  /**
+   * Append, set, or remove a propensity in alpha_list_ and in whichever
+   * selection structure the current method uses.
+   */
+  void PushAlpha(double alpha);
+  void SetAlpha(int index, double alpha);
+  void PopAlpha();
+  /**
+   * Copy the propensity (and any scheduling state) of one reaction slot to
+   * another, used when moving a reaction during deletion.
+   */
+  void MoveAlpha(int from, int to);
+  /**
+   * Firing time of a reaction given its current residual and propensity.
+   */
+  double ScheduledTime(int index) const;
+  /**
+   * Does the current method keep propensities in alpha_tree_?
+   */
+  bool UsesTree() const {
+    return method_ == Method::DIRECT_TREE || method_ == Method::HYBRID;
+  }
+  /**
+   * Execute a selected reaction and update its propensity.
+   *
+   * @param index index of reaction to execute
+   */
+  void Fire(int index);
+  /**
+   * Advance the clock to the time of the earliest scheduled event, if
+   * given, and execute it.
+   *
+   * @param limit time to advance to
+   * @param scheduled index of reaction whose scheduled event is at limit, or
+   *  -1 to only advance the clock
+   * @return true if an event was executed
+   */
+  bool Advance(double limit, int scheduled);
+  /**
+   * Execute the next event if it occurs no later than a given time.
+   * Otherwise advance the clock to that time.
+   *
+   * @param until latest time at which the next event may occur
+   * @return true if an event was executed
+   */
+  bool Step(double until);
+  /**
+   * Attempt one tau-leaping step, firing non-critical species reactions
+   * in bulk and at most one critical reaction.
+   *
+   * @param until time at which the leap must end at the latest
+   * @return false if an exact step should be taken instead
+   */
+  bool Leap(double until);
 };
 
 #endif  // header guard
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef SRC_GUARD_HPP  // header guard
+#define SRC_GUARD_HPP
+
+#include <mutex>
+
+/**
+ * Lock held around changes to an object that the worker threads of a
+ * parallel simulation share (see Model::parallel). Shared objects hold a
+ * pointer to the mutex of the simulation while its workers run and null at
+ * any other time, in which case the guard does nothing. The mutex is
+ * recursive, since shared objects call into each other.
+ */
+class Guard {
+ public:
+  explicit Guard(std::recursive_mutex *mutex) : mutex_(mutex) {
+    if (mutex_ != nullptr) {
+      mutex_->lock();
+    }
+  }
+  ~Guard() {
+    if (mutex_ != nullptr) {
+      mutex_->unlock();
+    }
+  }
+  Guard(const Guard &other) = delete;
+  Guard &operator=(const Guard &other) = delete;
+
+ private:
+  std::recursive_mutex *mutex_;
+};
+
+#endif  // header guard
@@ -0,0 +1,347 @@
+#include "hdf5_store.hpp"
+
+#include <hdf5.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+static_assert(sizeof(hid_t) == sizeof(int64_t), "HDF5 handles are 64 bits");
+
+/**
+ * Number of species in each chunk of the count datasets.
+ */
+static const hsize_t SPECIES_CHUNK = 64;
+
+static const char *const COUNT_NAMES[3] = {"protein", "transcript",
+                                           "ribo_density"};
+
+Hdf5Store::Ptr Hdf5Store::Create(const std::string &path, int replicates,
+                                 int time_chunk, int compression) {
+  if (replicates < 1 || time_chunk < 1) {
+    throw std::invalid_argument(
+        "An HDF5 store needs at least one replicate and one time point per "
+        "chunk.");
+  }
+  if (compression < 0 || compression > 9) {
+    throw std::invalid_argument("Compression level must be from 0 to 9.");
+  }
+  return Ptr(new Hdf5Store(path, replicates, time_chunk, compression));
+}
+
+Hdf5Store::Hdf5Store(const std::string &path, int replicates, int time_chunk,
+                     int compression)
+    : path_(path),
+      replicates_(replicates),
+      time_chunk_(time_chunk),
+      compression_(compression) {
+  // Errors are reported by exceptions instead of printed by the library
+  H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_ = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file_ < 0) {
+    throw std::runtime_error("Could not create HDF5 file '" + path + "'.");
+  }
+  try {
+    time_ = CreateDataset("time", 2, std::numeric_limits<double>::quiet_NaN());
+    for (int i = 0; i < 3; i++) {
+      counts_[i] = CreateDataset(COUNT_NAMES[i], 3, 0.0);
+    }
+    hsize_t dims = replicates;
+    hid_t space = Check(H5Screate_simple(1, &dims, nullptr), "create dataspace");
+    time_points_ = H5Dcreate2(file_, "time_points", H5T_STD_I64LE, space,
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Sclose(space);
+    Check(time_points_, "create dataset time_points");
+  } catch (...) {
+    Release();
+    throw;
+  }
+}
+
+Hdf5Store::~Hdf5Store() {
+  try {
+    Close();
+  } catch (...) {
+  }
+}
+
+CountsWriter::Ptr Hdf5Store::Writer(int replicate, bool close_store) {
+  if (replicate < 0 || replicate >= replicates_) {
+    throw std::invalid_argument("Replicate " + std::to_string(replicate) +
+                                " is not in HDF5 file '" + path_ + "'.");
+  }
+  return CountsWriter::Ptr(
+      new Hdf5CountsWriter(shared_from_this(), replicate, close_store));
+}
+
+void Hdf5Store::WriteAttribute(const std::string &key, double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Check(file_, "write attribute " + key);
+  if (Check(H5Aexists(file_, key.c_str()), "look up attribute " + key) > 0) {
+    Check(H5Adelete(file_, key.c_str()), "replace attribute " + key);
+  }
+  hid_t space = Check(H5Screate(H5S_SCALAR), "create dataspace");
+  hid_t attribute = H5Acreate2(file_, key.c_str(), H5T_IEEE_F64LE, space,
+                               H5P_DEFAULT, H5P_DEFAULT);
+  H5Sclose(space);
+  Check(attribute, "create attribute " + key);
+  herr_t status = H5Awrite(attribute, H5T_NATIVE_DOUBLE, &value);
+  H5Aclose(attribute);
+  Check(status, "write attribute " + key);
+}
+
+void Hdf5Store::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ < 0) {
+    return;
+  }
+  try {
+    WriteSpecies();
+  } catch (...) {
+    Release();
+    throw;
+  }
+  Release();
+}
+
+int Hdf5Store::Column(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = columns_.find(name);
+  if (it != columns_.end()) {
+    return it->second;
+  }
+  int column = names_.size();
+  columns_[name] = column;
+  names_.push_back(name);
+  return column;
+}
+
+void Hdf5Store::Append(int replicate, int first,
+                       const std::vector<double> &times,
+                       const std::vector<std::vector<double>> &points) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Check(file_, "append time points");
+  uint64_t n = times.size();
+  uint64_t columns = names_.size();
+  if (first + n > time_size_ || columns > species_size_) {
+    time_size_ = std::max<uint64_t>(time_size_, first + n);
+    species_size_ = std::max(species_size_, columns);
+    hsize_t dims[3] = {hsize_t(replicates_), time_size_, species_size_};
+    Check(H5Dset_extent(time_, dims), "extend dataset time");
+    for (int i = 0; i < 3; i++) {
+      Check(H5Dset_extent(counts_[i], dims),
+            std::string("extend dataset ") + COUNT_NAMES[i]);
+    }
+  }
+  uint64_t start[3] = {uint64_t(replicate), uint64_t(first), 0};
+  uint64_t count[3] = {1, n, columns};
+  WriteSlab(time_, 2, start, count, H5T_NATIVE_DOUBLE, times.data());
+  if (columns > 0) {
+    std::vector<double> block(n * columns);
+    for (int i = 0; i < 3; i++) {
+      for (uint64_t row = 0; row < n; row++) {
+        const auto &point = points[row];
+        for (uint64_t column = 0; column < columns; column++) {
+          std::size_t index = 3 * column + i;
+          block[row * columns + column] =
+              index < point.size() ? point[index] : 0.0;
+        }
+      }
+      WriteSlab(counts_[i], 3, start, count, H5T_NATIVE_DOUBLE, block.data());
+    }
+  }
+  int64_t written = first + n;
+  WriteSlab(time_points_, 1, start, count, H5T_NATIVE_INT64, &written);
+}
+
+void Hdf5Store::WriteMetadata(int replicate, const std::string &key,
+                              double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Check(file_, "write metadata " + key);
+  auto it = metadata_.find(key);
+  if (it == metadata_.end()) {
+    it = metadata_
+             .emplace(key, CreateDataset("metadata/" + key, 1,
+                                         std::numeric_limits<double>::quiet_NaN()))
+             .first;
+  }
+  uint64_t start = replicate;
+  uint64_t count = 1;
+  WriteSlab(it->second, 1, &start, &count, H5T_NATIVE_DOUBLE, &value);
+}
+
+void Hdf5Store::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Check(file_, "flush");
+  WriteSpecies();
+  Check(H5Fflush(file_, H5F_SCOPE_LOCAL), "flush");
+}
+
+void Hdf5Store::WriteSpecies() {
+  if (Check(H5Lexists(file_, "species", H5P_DEFAULT), "look up species") > 0) {
+    Check(H5Ldelete(file_, "species", H5P_DEFAULT), "replace species");
+  }
+  hid_t type = Check(H5Tcopy(H5T_C_S1), "create string type");
+  H5Tset_size(type, H5T_VARIABLE);
+  H5Tset_cset(type, H5T_CSET_UTF8);
+  hsize_t dims = names_.size();
+  hid_t space = H5Screate_simple(1, &dims, nullptr);
+  hid_t dataset = space < 0 ? space
+                            : H5Dcreate2(file_, "species", type, space,
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status = dataset < 0 ? -1 : 0;
+  if (dataset >= 0 && !names_.empty()) {
+    std::vector<const char *> names;
+    for (const auto &name : names_) {
+      names.push_back(name.c_str());
+    }
+    status = H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                      names.data());
+  }
+  if (dataset >= 0) {
+    H5Dclose(dataset);
+  }
+  if (space >= 0) {
+    H5Sclose(space);
+  }
+  H5Tclose(type);
+  Check(status, "write species");
+}
+
+int64_t Hdf5Store::CreateDataset(const std::string &name, int rank,
+                                 double fill) {
+  hsize_t dims[3] = {hsize_t(replicates_), 0, 0};
+  hsize_t max_dims[3] = {hsize_t(replicates_), H5S_UNLIMITED, H5S_UNLIMITED};
+  hsize_t chunk[3] = {1, hsize_t(time_chunk_), SPECIES_CHUNK};
+  hid_t space =
+      Check(H5Screate_simple(rank, dims, max_dims), "create dataspace");
+  hid_t create = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_fill_value(create, H5T_NATIVE_DOUBLE, &fill);
+  if (rank > 1) {
+    H5Pset_chunk(create, rank, chunk);
+    if (compression_ > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0) {
+      H5Pset_shuffle(create);
+      H5Pset_deflate(create, compression_);
+    }
+  }
+  // Names such as "metadata/key" create their groups
+  hid_t link = H5Pcreate(H5P_LINK_CREATE);
+  H5Pset_create_intermediate_group(link, 1);
+  hid_t dataset = H5Dcreate2(file_, name.c_str(), H5T_IEEE_F64LE, space,
+                             link, create, H5P_DEFAULT);
+  H5Pclose(link);
+  H5Pclose(create);
+  H5Sclose(space);
+  return Check(dataset, "create dataset " + name);
+}
+
+void Hdf5Store::WriteSlab(int64_t dataset, int rank, const uint64_t *start,
+                          const uint64_t *count, int64_t type,
+                          const void *data) {
+  hsize_t offsets[3], sizes[3];
+  for (int i = 0; i < rank; i++) {
+    offsets[i] = start[i];
+    sizes[i] = count[i];
+  }
+  hid_t file_space = Check(H5Dget_space(dataset), "get dataspace");
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offsets,
+                                      nullptr, sizes, nullptr);
+  hid_t memory_space = H5Screate_simple(rank, sizes, nullptr);
+  if (memory_space < 0) {
+    status = -1;
+  } else {
+    if (status >= 0) {
+      status = H5Dwrite(dataset, type, memory_space, file_space, H5P_DEFAULT,
+                        data);
+    }
+    H5Sclose(memory_space);
+  }
+  H5Sclose(file_space);
+  Check(status, "write data");
+}
+
+void Hdf5Store::Release() {
+  for (auto &item : metadata_) {
+    H5Dclose(item.second);
+  }
+  metadata_.clear();
+  for (int64_t *dataset : {&time_, &time_points_, &counts_[0], &counts_[1],
+                         &counts_[2]}) {
+    if (*dataset >= 0) {
+      H5Dclose(*dataset);
+      *dataset = -1;
+    }
+  }
+  if (file_ >= 0) {
+    H5Fclose(file_);
+    file_ = -1;
+  }
+}
+
+int64_t Hdf5Store::Check(int64_t status, const std::string &action) const {
+  if (status < 0) {
+    throw std::runtime_error("Could not " + action + " in HDF5 file '" +
+                             path_ + "'.");
+  }
+  return status;
+}
+
+Hdf5CountsWriter::Hdf5CountsWriter(Hdf5Store::Ptr store, int replicate,
+                                   bool close_store)
+    : store_(std::move(store)),
+      replicate_(replicate),
+      close_store_(close_store) {}
+
+void Hdf5CountsWriter::WriteRows(double time, const Rows &rows,
+                                 const std::vector<std::string> &names) {
+  if (times_.size() == points_.size()) {
+    points_.emplace_back();
+  }
+  auto &point = points_[times_.size()];
+  point.clear();
+  for (const auto &row : rows) {
+    if (row.species_id >= column_of_.size()) {
+      column_of_.resize(row.species_id + 1, -1);
+    }
+    int &column = column_of_[row.species_id];
+    if (column == -1) {
+      column = store_->Column(names[row.species_id]);
+    }
+    if (3 * (column + 1) > point.size()) {
+      point.resize(3 * (column + 1), 0.0);
+    }
+    point[3 * column] = row.protein;
+    point[3 * column + 1] = row.transcript;
+    point[3 * column + 2] = row.ribo_density;
+  }
+  times_.push_back(time);
+  if (times_.size() >= store_->time_chunk_) {
+    Drain();
+  }
+}
+
+void Hdf5CountsWriter::WriteMetadata(const std::string &key, double value) {
+  store_->WriteMetadata(replicate_, key, value);
+}
+
+void Hdf5CountsWriter::Flush() {
+  Drain();
+  store_->Flush();
+}
+
+void Hdf5CountsWriter::Close() {
+  Drain();
+  if (close_store_) {
+    store_->Close();
+  }
+}
+
+void Hdf5CountsWriter::Drain() {
+  if (times_.empty()) {
+    return;
+  }
+  store_->Append(replicate_, written_, times_, points_);
+  written_ += times_.size();
+  times_.clear();
+}
@@ -0,0 +1,205 @@
+#ifndef SRC_HDF5_STORE_HPP  // header guard
+#define SRC_HDF5_STORE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "output.hpp"
+
+/**
+ * One HDF5 file holding the counts of every replicate of an ensemble, so
+ * that large ensembles do not create a file per replicate. Only built when
+ * pinetree is configured with -DPINETREE_HDF5=ON. The file contains:
+ *
+ * - "protein", "transcript" and "ribo_density": float64 datasets of shape
+ *   (replicate, time point, species), 0 where a species had not appeared.
+ * - "time": float64 dataset of shape (replicate, time point), NaN past the
+ *   last time point of a replicate.
+ * - "time_points": int64 dataset with the number of time points written
+ *   for each replicate.
+ * - "species": variable-length string dataset naming the species columns,
+ *   which are shared by all replicates and numbered in order of first
+ *   appearance in any of them.
+ * - "metadata/<key>": float64 dataset with one value per replicate (see
+ *   CountsWriter::WriteMetadata), NaN where it was not written.
+ * - Attributes of the root group set with WriteAttribute, e.g. parameters.
+ *
+ * Time point and species dimensions grow as replicates write. Datasets are
+ * chunked by one replicate, time_chunk time points and 64 species, and
+ * compressed with the shuffle and deflate filters, so reading a few species
+ * or replicates does not decompress the whole file.
+ *
+ * Replicates write through their own writers (see Writer), which may run
+ * on different threads. Each writer buffers time_chunk time points and
+ * appends them while holding a lock on the file, since the HDF5 library is
+ * not thread-safe.
+ */
+class Hdf5Store : public std::enable_shared_from_this<Hdf5Store> {
+ public:
+  typedef std::shared_ptr<Hdf5Store> Ptr;
+  /**
+   * Create a store, overwriting any file at path.
+   *
+   * @param path path of HDF5 file
+   * @param replicates number of replicates
+   * @param time_chunk number of time points in each chunk
+   * @param compression deflate level from 1 to 9, or 0 not to compress
+   * @throws std::invalid_argument if replicates or time_chunk is not
+   *  positive or compression is not in 0..9
+   * @throws std::runtime_error if the file cannot be created
+   */
+  static Ptr Create(const std::string &path, int replicates,
+                    int time_chunk = 64, int compression = 4);
+  /**
+   * Closes the file if Close was not called, discarding any error.
+   */
+  ~Hdf5Store();
+  /**
+   * Create the writer of one replicate, which keeps this store open. Each
+   * replicate should have one writer.
+   *
+   * @param replicate replicate number
+   * @param close_store also close this store when the writer is closed
+   * @throws std::invalid_argument if replicate is out of range
+   */
+  CountsWriter::Ptr Writer(int replicate, bool close_store = false);
+  /**
+   * Set a numeric attribute of the root group, e.g. a parameter value
+   * shared by every replicate.
+   */
+  void WriteAttribute(const std::string &key, double value);
+  /**
+   * Write the species names and close the file. Writers still buffering
+   * time points must be closed first.
+   */
+  void Close();
+  int replicates() const { return replicates_; }
+
+ private:
+  friend class Hdf5CountsWriter;
+  Hdf5Store(const std::string &path, int replicates, int time_chunk,
+            int compression);
+  /**
+   * Column of a species, declaring it if it is new.
+   */
+  int Column(const std::string &name);
+  /**
+   * Write consecutive time points of a replicate.
+   *
+   * @param first index of the first time point
+   * @param times time of each time point
+   * @param points values of each time point, three per column, of which
+   *  the first times.size() are written
+   */
+  void Append(int replicate, int first, const std::vector<double> &times,
+              const std::vector<std::vector<double>> &points);
+  void WriteMetadata(int replicate, const std::string &key, double value);
+  /**
+   * Write the species names and flush the file to disk.
+   */
+  void Flush();
+  /**
+   * Replace the species dataset with the current names. Requires mutex_.
+   */
+  void WriteSpecies();
+  /**
+   * Create a float64 dataset with one row per replicate, which is chunked
+   * and extendible in its other dimensions if it has any. Requires mutex_.
+   *
+   * @param rank number of dimensions, from 1 to 3
+   * @param fill value of elements that have not been written
+   */
+  int64_t CreateDataset(const std::string &name, int rank, double fill);
+  /**
+   * Write a block of a dataset from contiguous memory. Requires mutex_.
+   */
+  void WriteSlab(int64_t dataset, int rank, const uint64_t *start,
+                 const uint64_t *count, int64_t type, const void *data);
+  /**
+   * Close every open handle, ignoring errors. Requires mutex_.
+   */
+  void Release();
+  /**
+   * Throw a std::runtime_error naming this file and action if status is
+   * negative.
+   *
+   * @return status
+   */
+  int64_t Check(int64_t status, const std::string &action) const;
+  std::string path_;
+  int replicates_;
+  int time_chunk_;
+  int compression_;
+  /**
+   * Guards every call into the HDF5 library and the members below.
+   */
+  std::mutex mutex_;
+  /**
+   * HDF5 handles of the file, the time, time_points and metadata datasets,
+   * and the datasets of the three counts, or -1 once closed.
+   */
+  int64_t file_ = -1;
+  int64_t time_ = -1;
+  int64_t time_points_ = -1;
+  int64_t counts_[3] = {-1, -1, -1};
+  std::map<std::string, int64_t> metadata_;
+  /**
+   * Size of the time point dimension of the datasets.
+   */
+  uint64_t time_size_ = 0;
+  /**
+   * Size of the species dimension of the count datasets.
+   */
+  uint64_t species_size_ = 0;
+  std::map<std::string, int> columns_;
+  std::vector<std::string> names_;
+};
+
+/**
+ * Writer of one replicate of an Hdf5Store.
+ */
+class Hdf5CountsWriter : public CountsWriter {
+ public:
+  Hdf5CountsWriter(Hdf5Store::Ptr store, int replicate, bool close_store);
+  void WriteRows(double time, const Rows &rows,
+                 const std::vector<std::string> &names);
+  void WriteMetadata(const std::string &key, double value);
+  /**
+   * Append buffered time points and flush the file.
+   */
+  void Flush();
+  /**
+   * Append buffered time points, and close the store if this writer owns
+   * it.
+   */
+  void Close();
+
+ private:
+  /**
+   * Append buffered time points to the store.
+   */
+  void Drain();
+  Hdf5Store::Ptr store_;
+  int replicate_;
+  bool close_store_;
+  /**
+   * Number of time points already appended.
+   */
+  int written_ = 0;
+  /**
+   * Store column of each species ID, or -1 if it has not appeared.
+   */
+  std::vector<int> column_of_;
+  /**
+   * Buffered time points and their values. points_ is reused, and only its
+   * first times_.size() entries are pending.
+   */
+  std::vector<double> times_;
+  std::vector<std::vector<double>> points_;
+};
+
+#endif  // header guard
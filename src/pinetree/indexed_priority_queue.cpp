@@ -0,0 +1,93 @@
+#include <stdexcept>
+
+#include "indexed_priority_queue.hpp"
+
+void IndexedPriorityQueue::PushBack(double key) {
+  keys_.push_back(key);
+  position_.push_back(heap_.size());
+  heap_.push_back(keys_.size() - 1);
+  Restore(heap_.size() - 1);
+}
+
+void IndexedPriorityQueue::PopBack() {
+  if (keys_.empty()) {
+    throw std::range_error(
+        "IndexedPriorityQueue: Cannot remove from empty queue.");
+  }
+  int index = keys_.size() - 1;
+  int position = position_[index];
+  int last = heap_.size() - 1;
+  Swap(position, last);
+  heap_.pop_back();
+  keys_.pop_back();
+  position_.pop_back();
+  if (position < static_cast<int>(heap_.size())) {
+    Restore(position);
+  }
+}
+
+void IndexedPriorityQueue::Update(int index, double key) {
+  if (index < 0 || index >= static_cast<int>(keys_.size())) {
+    throw std::range_error(
+        "IndexedPriorityQueue: Index out of range for update.");
+  }
+  keys_[index] = key;
+  Restore(position_[index]);
+}
+
+void IndexedPriorityQueue::Clear() {
+  keys_.clear();
+  heap_.clear();
+  position_.clear();
+}
+
+void IndexedPriorityQueue::Restore(int position) {
+  // Sift up
+  while (position > 0) {
+    int parent = (position - 1) / 2;
+    if (keys_[heap_[position]] >= keys_[heap_[parent]]) {
+      break;
+    }
+    Swap(position, parent);
+    position = parent;
+  }
+  // Sift down
+  int size = heap_.size();
+  while (true) {
+    int smallest = position;
+    int left = 2 * position + 1;
+    int right = left + 1;
+    if (left < size && keys_[heap_[left]] < keys_[heap_[smallest]]) {
+      smallest = left;
+    }
+    if (right < size && keys_[heap_[right]] < keys_[heap_[smallest]]) {
+      smallest = right;
+    }
+    if (smallest == position) {
+      break;
+    }
+    Swap(position, smallest);
+    position = smallest;
+  }
+}
+
+void IndexedPriorityQueue::Swap(int position_a, int position_b) {
+  int index_a = heap_[position_a];
+  int index_b = heap_[position_b];
+  heap_[position_a] = index_b;
+  heap_[position_b] = index_a;
+  position_[index_a] = position_b;
+  position_[index_b] = position_a;
+}
+
+void IndexedPriorityQueue::Save(CheckpointWriter &writer) const {
+  writer.Write(keys_);
+  writer.Write(heap_);
+  writer.Write(position_);
+}
+
+void IndexedPriorityQueue::Load(CheckpointReader &reader) {
+  reader.Read(keys_);
+  reader.Read(heap_);
+  reader.Read(position_);
+}
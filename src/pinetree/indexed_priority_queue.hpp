@@ -0,0 +1,82 @@
+#ifndef SRC_INDEXED_PRIORITY_QUEUE_HPP  // header guard
+#define SRC_INDEXED_PRIORITY_QUEUE_HPP
+
+#include <vector>
+
+#include "checkpoint.hpp"
+
+/**
+ * A binary min-heap of keys (e.g. putative reaction times) that are addressed
+ * by a stable index, as used by the next reaction method (Gibson and Bruck
+ * 2000). Changing the key of any index takes O(log n) time and the smallest
+ * key can be read in constant time.
+ */
+class IndexedPriorityQueue {
+ public:
+  /**
+   * Append a key with index size().
+   *
+   * @param key key of new entry
+   */
+  void PushBack(double key);
+  /**
+   * Remove the entry with the largest index (not the largest key).
+   */
+  void PopBack();
+  /**
+   * Change the key of an entry and restore heap order.
+   *
+   * @param index index of entry
+   * @param key new key
+   */
+  void Update(int index, double key);
+  /**
+   * Remove all entries.
+   */
+  void Clear();
+  /**
+   * Save or restore the exact state of this queue, so that a restored
+   * simulation makes the same choices as the original.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  /**
+   * Getters and setters.
+   */
+  int top() const { return heap_[0]; }
+  double key(int index) const { return keys_[index]; }
+  int size() const { return keys_.size(); }
+  /**
+   * @return bytes of heap memory held
+   */
+  std::size_t memory() const {
+    return keys_.capacity() * sizeof(double) +
+           (heap_.capacity() + position_.capacity()) * sizeof(int);
+  }
+
+ private:
+  /**
+   * Keys in index order.
+   */
+  std::vector<double> keys_;
+  /**
+   * Indices in heap order; heap_[0] has the smallest key.
+   */
+  std::vector<int> heap_;
+  /**
+   * Position of each index in heap_.
+   */
+  std::vector<int> position_;
+  /**
+   * Move an entry up or down the heap until heap order is restored.
+   *
+   * @param position position of entry in heap_
+   */
+  void Restore(int position);
+  /**
+   * Swap two entries in heap_.
+   */
+  void Swap(int position_a, int position_b);
+};
+
+#endif  // header guard
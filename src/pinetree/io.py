@@ -0,0 +1,92 @@
+"""
+Out-of-core readers for binary pinetree output.
+
+Counts files written by Model.simulate with format="binary" or
+format="binary_delta" are memory-mapped, and only the species and time points
+asked for are decoded, so ensembles much larger than memory can be analyzed a
+slice at a time. Arrays are NumPy arrays, or memoryviews if NumPy is not
+installed.
+"""
+
+from .core import CountsFile, resample_counts, summarize_counts
+
+
+def open_counts(path):
+    """
+    Open a binary counts file.
+
+    Args:
+        path (str): path to counts file
+
+    Returns:
+        CountsFile: the memory-mapped file, with ``time``, ``species`` and
+        ``metadata`` properties and ``read`` and ``resample`` methods
+    """
+    return CountsFile(path)
+
+
+class Ensemble(object):
+    """
+    Binary counts files of the replicates of an ensemble, e.g. those written
+    by Model.simulate_ensemble with format="binary". Files are opened when
+    they are read.
+
+    Args:
+        paths (list): path to the counts file of each replicate
+    """
+
+    def __init__(self, paths):
+        self.paths = list(paths)
+
+    def __len__(self):
+        return len(self.paths)
+
+    def replicate(self, index):
+        """Open the counts file of a replicate."""
+        return CountsFile(self.paths[index])
+
+    def read(self, replicate, species=None, start=None, stop=None):
+        """
+        Read the counts of some species of a replicate at the time points
+        from start through stop (see ``CountsFile.read``).
+
+        Args:
+            replicate (int): index of the replicate
+            species (list): species to read, or every species if None
+            start (float): first time to read, or the first time point if
+                None
+            stop (float): last time to read, or the last time point if None
+        """
+        return self.replicate(replicate).read(
+            species or [], float("-inf") if start is None else start,
+            float("inf") if stop is None else stop)
+
+    def resample(self, grid, species=None, replicates=None):
+        """
+        Resample the counts of some replicates to a common time grid (see
+        ``resample_counts``).
+
+        Args:
+            grid (list): sorted times to read counts at
+            species (list): species to read, or every species in any of the
+                replicates read if None
+            replicates (list): indexes of the replicates to read, or every
+                replicate if None
+
+        Returns:
+            dict: "time", "species", "replicates", and "protein",
+            "transcript" and "ribo_density" arrays of shape (replicate, time
+            point, species)
+        """
+        paths = self.paths if replicates is None else [
+            self.paths[i] for i in replicates
+        ]
+        return resample_counts(paths, list(grid), species or [])
+
+    def summarize(self, time_step, quantiles=None):
+        """
+        Mean, variance, minimum, maximum and quantiles of every count at each
+        multiple of time_step over the replicates (see ``summarize_counts``),
+        reading one replicate at a time.
+        """
+        return summarize_counts(self.paths, time_step, quantiles or [])
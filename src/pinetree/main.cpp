@@ -0,0 +1,130 @@
+/**
+ * Command line runner for pinetree models, which loads a YAML model
+ * description (see ModelFile) and simulates it without Python.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "model_file.hpp"
+
+static const char *USAGE =
+    "usage: pinetree [options] MODEL.yml\n"
+    "\n"
+    "Simulate a model description and write species counts.\n"
+    "\n"
+    "options:\n"
+    "  -o, --output PATH     output file (default: MODEL_counts.tsv, or\n"
+    "                        MODEL_counts.bin for binary output)\n"
+    "  -f, --format FORMAT   output format: tsv, binary or binary_delta\n"
+    "                        (default: tsv)\n"
+    "  -m, --method METHOD   reaction selection method: direct,\n"
+    "                        direct_linear, composition_rejection,\n"
+    "                        next_reaction or hybrid (default: direct)\n"
+    "  -s, --seed SEED       override the model's random seed\n"
+    "  -t, --runtime TIME    override the model's runtime\n"
+    "  --time-step STEP      override the model's output time step\n"
+    "  --run-ahead           let elements take stretches of moves that\n"
+    "                        change nothing else in one event\n"
+    "  --time-buckets        write each count's average, minimum and\n"
+    "                        maximum over every output interval\n"
+    "  -h, --help            show this message\n";
+
+/**
+ * Parse an integer option value, throwing std::invalid_argument if it is not
+ * one.
+ */
+static int ParseInt(const std::string &option, const std::string &value) {
+  char *end = nullptr;
+  long result = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0') {
+    throw std::invalid_argument("option " + option +
+                                " expects an integer, got '" + value + "'.");
+  }
+  return static_cast<int>(result);
+}
+
+int main(int argc, char *argv[]) {
+  std::string path, output, format = "tsv", method = "direct";
+  std::string seed, runtime, time_step;
+  bool run_ahead = false, time_buckets = false;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (arg == "-h" || arg == "--help") {
+        std::cout << USAGE;
+        return 0;
+      }
+      if (arg == "--run-ahead") {
+        run_ahead = true;
+        continue;
+      }
+      if (arg == "--time-buckets") {
+        time_buckets = true;
+        continue;
+      }
+      std::string *value = nullptr;
+      if (arg == "-o" || arg == "--output") {
+        value = &output;
+      } else if (arg == "-f" || arg == "--format") {
+        value = &format;
+      } else if (arg == "-m" || arg == "--method") {
+        value = &method;
+      } else if (arg == "-s" || arg == "--seed") {
+        value = &seed;
+      } else if (arg == "-t" || arg == "--runtime") {
+        value = &runtime;
+      } else if (arg == "--time-step") {
+        value = &time_step;
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        throw std::invalid_argument("unknown option " + arg + ".");
+      } else if (path.empty()) {
+        path = arg;
+        continue;
+      } else {
+        throw std::invalid_argument("only one model file may be given.");
+      }
+      if (++i == argc) {
+        throw std::invalid_argument("option " + arg + " expects a value.");
+      }
+      *value = argv[i];
+    }
+    if (path.empty()) {
+      throw std::invalid_argument("no model file given.");
+    }
+  } catch (const std::invalid_argument &error) {
+    std::cerr << "pinetree: " << error.what() << "\n\n" << USAGE;
+    return 2;
+  }
+
+  try {
+    if (output.empty()) {
+      // Name output after the model file, as in tests/output
+      std::size_t slash = path.find_last_of("/\\");
+      std::string stem = path.substr(slash == std::string::npos ? 0 : slash + 1);
+      stem = stem.substr(0, stem.rfind('.'));
+      output = stem + (format == "tsv" ? "_counts.tsv" : "_counts.bin");
+    }
+    ModelFile file = ModelFile::Load(path);
+    auto model = file.model();
+    if (!seed.empty()) {
+      model->seed(ParseInt("--seed", seed));
+    }
+    if (run_ahead) {
+      model->run_ahead(true);
+    }
+    if (time_buckets) {
+      model->time_buckets(true);
+    }
+    int time_limit = runtime.empty() ? file.runtime()
+                                     : ParseInt("--runtime", runtime);
+    int step = time_step.empty() ? file.time_step()
+                                 : ParseInt("--time-step", time_step);
+    model->Simulate(time_limit, step, output, method, format);
+  } catch (const std::exception &error) {
+    std::cerr << "pinetree: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+MappedFile::MappedFile(const std::string &path, const std::string &what) {
+#ifdef _WIN32
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("Could not open " + what + " '" + path + "'.");
+  }
+  contents_.assign(std::istreambuf_iterator<char>(input),
+                   std::istreambuf_iterator<char>());
+  data_ = contents_.data();
+  size_ = contents_.size();
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("Could not open " + what + " '" + path + "'.");
+  }
+  size_ = info.st_size;
+  if (size_ > 0) {
+    void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Could not map " + what + " '" + path + "'.");
+    }
+    data_ = static_cast<const char *>(mapped);
+  }
+  close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef SRC_MAPPED_FILE_HPP  // header guard
+#define SRC_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only view of a whole file, memory-mapped where the platform allows.
+ */
+class MappedFile {
+ public:
+  /**
+   * @param path path of the file
+   * @param what description of the file in error messages, e.g.
+   *  "annotation file"
+   * @throws std::runtime_error if the file cannot be opened or mapped
+   */
+  MappedFile(const std::string &path, const std::string &what);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+#ifdef _WIN32
+  std::string contents_;
+#endif
+};
+
+#endif  // header guard
@@ -0,0 +1,50 @@
+#include <new>
+
+#include "memory_pool.hpp"
+
+MemoryPool::~MemoryPool() {
+  for (auto chunk : chunks_) {
+    ::operator delete(chunk);
+  }
+}
+
+void *MemoryPool::Allocate(std::size_t size) {
+  if (size > MAX_BLOCK_SIZE) {
+    return ::operator new(size);
+  }
+  Guard guard(guard_);
+  std::size_t size_class = (size + ALIGNMENT - 1) / ALIGNMENT;
+  if (size_class >= free_lists_.size()) {
+    free_lists_.resize(size_class + 1, nullptr);
+  }
+  // Reuse a freed block if possible
+  FreeBlock *head = free_lists_[size_class];
+  if (head != nullptr) {
+    free_lists_[size_class] = head->next;
+    return head;
+  }
+  // Otherwise carve a new block from the current chunk. Whatever is left of
+  // a full chunk is abandoned; it is at most MAX_BLOCK_SIZE bytes.
+  std::size_t block_size = size_class * ALIGNMENT;
+  if (chunk_pos_ == nullptr ||
+      static_cast<std::size_t>(chunk_end_ - chunk_pos_) < block_size) {
+    chunk_pos_ = static_cast<char *>(::operator new(CHUNK_SIZE));
+    chunk_end_ = chunk_pos_ + CHUNK_SIZE;
+    chunks_.push_back(chunk_pos_);
+  }
+  void *block = chunk_pos_;
+  chunk_pos_ += block_size;
+  return block;
+}
+
+void MemoryPool::Deallocate(void *block, std::size_t size) {
+  if (size > MAX_BLOCK_SIZE) {
+    ::operator delete(block);
+    return;
+  }
+  Guard guard(guard_);
+  std::size_t size_class = (size + ALIGNMENT - 1) / ALIGNMENT;
+  auto free_block = static_cast<FreeBlock *>(block);
+  free_block->next = free_lists_[size_class];
+  free_lists_[size_class] = free_block;
+}
@@ -0,0 +1,133 @@
+#ifndef SRC_MEMORY_POOL_HPP  // header guard
+#define SRC_MEMORY_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "guard.hpp"
+
+/**
+ * A pool of small memory blocks for the objects that are created and
+ * destroyed throughout a simulation (polymerases, transcripts and their
+ * wrappers). Freed blocks are kept on a free list per size class and reused,
+ * so a long simulation reaches a steady memory footprint instead of
+ * fragmenting the heap.
+ *
+ * Each Model owns one pool. A pool is not thread-safe; it must only be used
+ * by the thread simulating its model, or under the lock of a parallel
+ * simulation (see guard).
+ */
+class MemoryPool {
+ public:
+  MemoryPool() = default;
+  MemoryPool(const MemoryPool &other) = delete;
+  MemoryPool &operator=(const MemoryPool &other) = delete;
+  ~MemoryPool();
+  /**
+   * Convenience typedefs.
+   */
+  typedef std::shared_ptr<MemoryPool> Ptr;
+  /**
+   * Allocate a block. Blocks larger than MAX_BLOCK_SIZE come from the global
+   * heap.
+   *
+   * @param size size of block in bytes
+   * @return pointer to block aligned for any type
+   */
+  void *Allocate(std::size_t size);
+  /**
+   * Return a block to the pool.
+   *
+   * @param block pointer returned by Allocate
+   * @param size size passed to Allocate
+   */
+  void Deallocate(void *block, std::size_t size);
+  /**
+   * @return number of bytes reserved from the global heap
+   */
+  std::size_t reserved() const { return chunks_.size() * CHUNK_SIZE; }
+  /**
+   * Lock allocations with a mutex while the worker threads of a parallel
+   * simulation run, or stop locking (see Guard).
+   */
+  void guard(std::recursive_mutex *mutex) { guard_ = mutex; }
+
+ private:
+  static const std::size_t ALIGNMENT = alignof(std::max_align_t);
+  static const std::size_t MAX_BLOCK_SIZE = 1024;
+  static const std::size_t CHUNK_SIZE = 64 * 1024;
+  /**
+   * A freed block, linked into the free list of its size class.
+   */
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+  /**
+   * Head of the free list for each size class (block size / ALIGNMENT).
+   */
+  std::vector<FreeBlock *> free_lists_;
+  /**
+   * Chunks reserved from the global heap.
+   */
+  std::vector<char *> chunks_;
+  /**
+   * Unused part of the most recent chunk.
+   */
+  char *chunk_pos_ = nullptr;
+  char *chunk_end_ = nullptr;
+  std::recursive_mutex *guard_ = nullptr;
+};
+
+/**
+ * Standard allocator that takes memory from a MemoryPool. Each allocation
+ * made through std::allocate_shared stores a copy of the allocator, so the
+ * pool stays alive until the last pooled object is destroyed.
+ */
+template <typename T>
+class PoolAllocator {
+ public:
+  typedef T value_type;
+  explicit PoolAllocator(MemoryPool::Ptr pool) : pool_(std::move(pool)) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(pool_->Allocate(n * sizeof(T)));
+  }
+  void deallocate(T *block, std::size_t n) {
+    pool_->Deallocate(block, n * sizeof(T));
+  }
+  const MemoryPool::Ptr &pool() const { return pool_; }
+
+ private:
+  MemoryPool::Ptr pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+  return a.pool() == b.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+  return !(a == b);
+}
+
+/**
+ * Create a shared object in a pool, or on the heap if there is no pool (e.g.
+ * for polymers that are not registered with a Model).
+ *
+ * @param pool pool to allocate from, may be null
+ * @param args arguments forwarded to the constructor of T
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooled(const MemoryPool::Ptr &pool, Args &&... args) {
+  if (!pool) {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+  return std::allocate_shared<T>(PoolAllocator<T>(pool),
+                                 std::forward<Args>(args)...);
+}
+
+#endif  // header guard
@@ -0,0 +1,114 @@
+#ifndef SRC_MEMORY_REPORT_HPP  // header guard
+#define SRC_MEMORY_REPORT_HPP
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Estimated heap memory of a model, broken down by subsystem (genomes,
+ * transcripts, sites, mobile elements, tracker, engine, ...), with the
+ * number of live objects of each. Sizes are estimated from the sizes and
+ * capacities of containers when a report is made, instead of counting
+ * allocations as they happen, so accounting costs nothing while
+ * simulating. Node-based containers are charged a typical per-node
+ * overhead, and data shared between objects, e.g. the translation weights
+ * of every transcript of a genome, is only counted once.
+ */
+class MemoryReport {
+ public:
+  /**
+   * Memory of one subsystem.
+   */
+  struct Usage {
+    long long objects = 0;
+    std::size_t bytes = 0;
+  };
+  /**
+   * Charge objects and bytes to a subsystem.
+   */
+  void Add(const std::string &subsystem, long long objects,
+           std::size_t bytes) {
+    Usage &usage = usage_[subsystem];
+    usage.objects += objects;
+    usage.bytes += bytes;
+  }
+  /**
+   * @return true the first time it is called with a shared object, which
+   *  should then be counted by the caller
+   */
+  bool First(const void *shared) {
+    return shared != nullptr && seen_.insert(shared).second;
+  }
+  /**
+   * @return usage by subsystem
+   */
+  const std::map<std::string, Usage> &usage() const { return usage_; }
+  /**
+   * @return estimated total over all subsystems
+   */
+  std::size_t total() const {
+    std::size_t bytes = 0;
+    for (const auto &item : usage_) {
+      bytes += item.second.bytes;
+    }
+    return bytes;
+  }
+  /**
+   * Bytes reserved from the heap by the memory pool that elements and
+   * transcripts are allocated from. Pooled objects are already charged to
+   * their subsystems, so this is not part of the total.
+   */
+  std::size_t pool_reserved() const { return pool_reserved_; }
+  void pool_reserved(std::size_t bytes) { pool_reserved_ = bytes; }
+  /**
+   * Estimated heap memory of common containers.
+   */
+  template <typename T>
+  static std::size_t Bytes(const std::vector<T> &values) {
+    return values.capacity() * sizeof(T);
+  }
+  static std::size_t Bytes(const std::vector<bool> &values) {
+    return values.capacity() / 8;
+  }
+  static std::size_t Bytes(const std::string &value) {
+    // Short strings are stored inline
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+  }
+  template <typename K, typename V, typename C>
+  static std::size_t Bytes(const std::map<K, V, C> &values) {
+    return values.size() * (sizeof(typename std::map<K, V, C>::value_type) +
+                            NODE_OVERHEAD);
+  }
+  template <typename K, typename V, typename C>
+  static std::size_t Bytes(const std::multimap<K, V, C> &values) {
+    return values.size() *
+           (sizeof(typename std::multimap<K, V, C>::value_type) +
+            NODE_OVERHEAD);
+  }
+  template <typename T>
+  static std::size_t Bytes(const std::set<T> &values) {
+    return values.size() * (sizeof(T) + NODE_OVERHEAD);
+  }
+  template <typename K, typename V>
+  static std::size_t Bytes(const std::unordered_map<K, V> &values) {
+    return values.size() *
+               (sizeof(typename std::unordered_map<K, V>::value_type) +
+                sizeof(void *)) +
+           values.bucket_count() * sizeof(void *);
+  }
+
+ private:
+  /**
+   * Bytes taken by the links and colour of a node of a red-black tree.
+   */
+  static const std::size_t NODE_OVERHEAD = 32;
+  std::map<std::string, Usage> usage_;
+  std::set<const void *> seen_;
+  std::size_t pool_reserved_ = 0;
+};
+
+#endif  // header guard
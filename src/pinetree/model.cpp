@@ -1,56 +1,1737 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 
+#include "checkpoint.hpp"
 #include "choices.hpp"
 #include "model.hpp"
+#include "output.hpp"
 #include "polymer.hpp"
+#include "profile.hpp"
+#include "species_batch.hpp"
+#include "steady_state.hpp"
 #include "tracker.hpp"
 
-Model::Model(double cell_volume) : cell_volume_(cell_volume) {
-  auto &tracker = SpeciesTracker::Instance();
-  tracker.Clear();
+Model::Model(double cell_volume)
+    : tracker_(std::make_shared<SpeciesTracker>()),
+      rng_(std::make_shared<Random>()),
+      pool_(std::make_shared<MemoryPool>()),
+      cell_volume_(cell_volume),
+      polymer_stats_(std::make_shared<PolymerStats>()) {
   gillespie_ = Gillespie();
-  tracker.propensity_signal_.ConnectMember(&gillespie_,
-                                           &Gillespie::UpdatePropensity);
+  gillespie_.tracker(tracker_);
+  gillespie_.rng(rng_);
+  tracker_->engine(&gillespie_);
 }
 
-void Model::seed(int seed) { Random::seed(seed); }
+Model::~Model() {
+  // Reactions and polymers hold pointers back to the tracker, so clear it to
+  // break reference cycles
+  tracker_->Clear();
+  try {
+    CloseOutput();
+  } catch (...) {
+    // Errors writing output were already reported by the last run
+  }
+}
+
+void Model::seed(int seed, int stream) { rng_->seed(seed, stream); }
+
+void Model::resummation_interval(int events) {
+  if (events < 0) {
+    throw std::invalid_argument("Resummation interval must be non-negative.");
+  }
+  gillespie_.resummation_interval(events);
+  Define([=](Model &model) { model.resummation_interval(events); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(RESUMMATION_INTERVAL);
+           writer.Write<int32_t>(events);
+         });
+}
+
+void Model::output_species(const std::vector<std::string> &patterns) {
+  tracker_->output_species(patterns);
+  Define([=](Model &model) { model.output_species(patterns); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(OUTPUT_SPECIES);
+           writer.Write(patterns);
+         });
+}
+
+void Model::record_totals(bool enabled) {
+  tracker_->record_totals(enabled);
+  Define([=](Model &model) { model.record_totals(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(RECORD_TOTALS);
+           writer.Write(enabled);
+         });
+}
+
+void Model::time_buckets(bool enabled) {
+  tracker_->time_buckets(enabled ? gillespie_.clock() : nullptr);
+  Define([=](Model &model) { model.time_buckets(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(TIME_BUCKETS);
+           writer.Write(enabled);
+         });
+}
+
+void Model::async_output(bool enabled) {
+  async_output_ = enabled;
+  Define([=](Model &model) { model.async_output(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(ASYNC_OUTPUT);
+           writer.Write(enabled);
+         });
+}
+
+void Model::run_ahead(bool enabled) {
+  run_ahead_ = enabled;
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      wrapper->polymer()->run_ahead(enabled, gillespie_.clock());
+    }
+  }
+  Define([=](Model &model) { model.run_ahead(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(RUN_AHEAD);
+           writer.Write(enabled);
+         });
+}
+
+void Model::codon_steps(bool enabled) {
+  codon_steps_ = enabled;
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      wrapper->polymer()->codon_steps(enabled);
+      gillespie_.UpdatePropensity(wrapper);
+    }
+  }
+  Define([=](Model &model) { model.codon_steps(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(CODON_STEPS);
+           writer.Write(enabled);
+         });
+}
+
+void Model::skip_blocked(bool enabled) {
+  skip_blocked_ = enabled;
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      wrapper->polymer()->skip_blocked(enabled);
+      gillespie_.UpdatePropensity(wrapper);
+    }
+  }
+  Define([=](Model &model) { model.skip_blocked(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(SKIP_BLOCKED);
+           writer.Write(enabled);
+         });
+}
+
+void Model::partial_equilibrium(double ratio) {
+  if (ratio < 0) {
+    throw std::invalid_argument("Partial equilibrium ratio must be "
+                                "non-negative.");
+  }
+  if (initialized_) {
+    throw std::runtime_error("Partial equilibrium must be enabled before the "
+                             "model is simulated.");
+  }
+  equilibrium_ratio_ = ratio;
+  Define([=](Model &model) { model.partial_equilibrium(ratio); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(PARTIAL_EQUILIBRIUM);
+           writer.Write(ratio);
+         });
+}
+
+void Model::steady_state(int window, double tolerance) {
+  if (window < 0 || window == 1) {
+    throw std::invalid_argument("Steady-state windows must hold at least 2 "
+                                "output time points.");
+  }
+  if (!(tolerance >= 0)) {
+    throw std::invalid_argument("Steady-state tolerance must be "
+                                "non-negative.");
+  }
+  steady_state_window_ = window;
+  steady_state_tolerance_ = tolerance;
+  Define([=](Model &model) { model.steady_state(window, tolerance); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(STEADY_STATE);
+           writer.Write<int32_t>(window);
+           writer.Write(tolerance);
+         });
+}
+
+void Model::fast_random(bool enabled) {
+  rng_->fast(enabled);
+  Define([=](Model &model) { model.fast_random(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(FAST_RANDOM);
+           writer.Write(enabled);
+         });
+}
+
+MemoryReport Model::memory_report() const {
+  MemoryReport report;
+  gillespie_.Memory(report);
+  tracker_->Memory(report);
+  // Transcripts built during the simulation are only reachable through
+  // their reactions
+  for (const auto &reaction : gillespie_.reactions()) {
+    if (reaction->kind() == Reaction::POLYMER) {
+      const auto &polymer =
+          static_cast<const PolymerWrapper &>(*reaction).polymer();
+      if (report.First(polymer.get())) {
+        polymer->Memory(report);
+      }
+    }
+  }
+  for (const auto &genome : genomes_) {
+    if (report.First(genome.get())) {
+      genome->Memory(report);
+    }
+  }
+  for (const auto &transcript : transcripts_) {
+    if (report.First(transcript.get())) {
+      transcript->Memory(report);
+    }
+  }
+  report.pool_reserved(pool_->reserved());
+  return report;
+}
+
+DependencyReport Model::dependency_report(int partitions,
+                                          double hub_fraction) {
+  if (!initialized_) {
+    Initialize();
+  }
+  // Species each reaction's propensity is recomputed for
+  std::map<const Reaction *, std::vector<std::string>> reads;
+  for (const auto &name : tracker_->names()) {
+    for (const auto &reaction : tracker_->FindReactions(name)) {
+      reads[reaction.get()].push_back(name);
+    }
+  }
+  DependencyGraph graph;
+  for (const auto &reaction : gillespie_.reactions()) {
+    std::vector<std::string> writes;
+    std::string label;
+    if (reaction->kind() == Reaction::SPECIES) {
+      const auto &species = static_cast<const SpeciesReaction &>(*reaction);
+      writes = species.reactants();
+      writes.insert(writes.end(), species.products().begin(),
+                    species.products().end());
+      auto join = [](const std::vector<std::string> &names) {
+        std::string joined;
+        for (const auto &name : names) {
+          joined += (joined.empty() ? "" : " + ") + name;
+        }
+        return joined.empty() ? std::string("0") : joined;
+      };
+      label = join(species.reactants()) + " -> " + join(species.products());
+    } else if (reaction->kind() == Reaction::BIND_POLYMERASE) {
+      const auto &bind = static_cast<const BindPolymerase &>(*reaction);
+      writes = {bind.promoter_name(), bind.pol_template().name()};
+      label = "bind " + bind.pol_template().name() + " to " +
+              bind.promoter_name();
+    } else if (reaction->kind() == Reaction::BIND_RNASE) {
+      const auto &bind = static_cast<const Bind &>(*reaction);
+      writes = {bind.promoter_name()};
+      label = "bind rnase to " + bind.promoter_name();
+    } else if (reaction->kind() == Reaction::POLYMER) {
+      const auto &polymer =
+          static_cast<const PolymerWrapper &>(*reaction).polymer();
+      label = "polymer " + polymer->name();
+      auto add_bindings =
+          [&writes](
+              const std::map<std::string, std::map<std::string, double>>
+                  &bindings) {
+            for (const auto &binding : bindings) {
+              writes.push_back(binding.first);
+              for (const auto &element : binding.second) {
+                writes.push_back(element.first);
+              }
+            }
+          };
+      if (auto genome = std::dynamic_pointer_cast<Genome>(polymer)) {
+        add_bindings(genome->bindings());
+        for (const auto &gene : genome->gene_names()) {
+          writes.push_back(gene);
+        }
+        if (genome->transcript_degradation_rate() != 0.0) {
+          writes.push_back("__rnase_site");
+        }
+        if (genome->transcript_degradation_rate_ext() != 0.0) {
+          writes.push_back("__rnase_site_ext");
+        }
+        for (const auto &site : genome->rnase_bindings()) {
+          writes.push_back(site.first);
+        }
+      } else if (auto transcript =
+                     std::dynamic_pointer_cast<Transcript>(polymer)) {
+        add_bindings(transcript->bindings());
+        for (const auto &interval : transcript->GetBindingIntervals()) {
+          writes.push_back(interval.value->name());
+          if (!interval.value->gene().empty()) {
+            writes.push_back(interval.value->gene());
+          }
+        }
+      }
+    } else {
+      continue;
+    }
+    graph.AddReaction(label, reads[reaction.get()], writes);
+  }
+  return graph.Analyze(partitions, hub_fraction);
+}
+
+void Model::memory_sampling(bool enabled) {
+  memory_sampling_ = enabled;
+  Define([=](Model &model) { model.memory_sampling(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(MEMORY_SAMPLING);
+           writer.Write(enabled);
+         });
+}
+
+void Model::common_random_numbers(bool enabled) {
+  if (initialized_) {
+    throw std::runtime_error("Common random numbers must be enabled before "
+                             "the model is simulated.");
+  }
+  gillespie_.common_random_numbers(enabled);
+  Define([=](Model &model) { model.common_random_numbers(enabled); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(COMMON_RANDOM_NUMBERS);
+           writer.Write(enabled);
+         });
+}
+
+void Model::stop_when(const std::string &expression) {
+  if (expression.empty()) {
+    stop_condition_.Clear();
+  } else {
+    stop_condition_.Add(expression);
+  }
+  Define([=](Model &model) { model.stop_when(expression); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(STOP_WHEN);
+           writer.Write(expression);
+         });
+}
+
+void Model::parallel(int threads, double window) {
+  if (threads < 0) {
+    throw std::invalid_argument("Number of threads must be non-negative.");
+  }
+  if (threads > 0 && !(window > 0)) {
+    throw std::invalid_argument("Parallel windows must have a positive "
+                                "length.");
+  }
+  parallel_threads_ = threads;
+  parallel_window_ = window;
+  Define([=](Model &model) { model.parallel(threads, window); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(PARALLEL);
+           writer.Write<int32_t>(threads);
+           writer.Write(window);
+         });
+}
+
+void Model::RecordOccupancy() {
+  if (occupancy_) {
+    return;
+  }
+  occupancy_ = std::make_shared<OccupancyProfiles>(gillespie_.clock());
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      RecordOccupancy(wrapper->polymer());
+    }
+  }
+  Define([](Model &model) { model.RecordOccupancy(); },
+         [](CheckpointWriter &writer) { writer.Write<uint8_t>(OCCUPANCY); });
+}
+
+void Model::RecordOccupancy(const Polymer::Ptr &polymer) {
+  if (!occupancy_) {
+    return;
+  }
+  auto transcript = std::dynamic_pointer_cast<Transcript>(polymer);
+  auto genome = transcript ? transcript->genome() : nullptr;
+  polymer->occupancy(occupancy_, genome ? genome->name() : polymer->name());
+}
+
+OccupancyProfiles::Averages Model::occupancy() const {
+  if (!occupancy_) {
+    return OccupancyProfiles::Averages();
+  }
+  return occupancy_->averages();
+}
+
+void Model::RecordDwellTimes(double min_time, double max_time, int bins) {
+  RecordOccupancy();
+  occupancy_->RecordDwellTimes(min_time, max_time, bins);
+  Define(
+      [=](Model &model) { model.RecordDwellTimes(min_time, max_time, bins); },
+      [=](CheckpointWriter &writer) {
+        writer.Write<uint8_t>(DWELL_TIMES);
+        writer.Write(min_time);
+        writer.Write(max_time);
+        writer.Write<int32_t>(bins);
+      });
+}
+
+void Model::Trace(const std::string &path) {
+#ifndef PINETREE_TRACE
+  throw std::runtime_error(
+      "Pinetree was built without event tracing; rebuild with the CMake "
+      "option PINETREE_TRACE=ON.");
+#else
+  StopTrace();
+  trace_ = std::make_shared<EventTrace>(path, gillespie_.clock());
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      TracePolymer(wrapper->polymer());
+    }
+  }
+#endif
+}
+
+void Model::StopTrace() {
+  if (!trace_) {
+    return;
+  }
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      wrapper->polymer()->trace(nullptr, 0);
+    }
+  }
+  trace_->Close();
+  trace_ = nullptr;
+}
+
+void Model::AddObserver(Observer::Ptr observer) {
+  if (!observers_) {
+    observers_ = std::make_shared<Observers>(gillespie_.clock());
+    gillespie_.observers(observers_);
+    for (const auto &reaction : gillespie_.reactions()) {
+      auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+      if (wrapper) {
+        wrapper->polymer()->observers(observers_);
+      }
+    }
+  }
+  observers_->Add(observer);
+}
+
+void Model::RemoveObservers() {
+  if (!observers_) {
+    return;
+  }
+  gillespie_.observers(nullptr);
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      wrapper->polymer()->observers(nullptr);
+    }
+  }
+  observers_ = nullptr;
+}
+
+void Model::RecordSnapshots(const std::string &path) {
+  StopSnapshots();
+  snapshots_ = PolymerSnapshots::Ptr(new PolymerSnapshots(path));
+}
+
+void Model::StopSnapshots() {
+  if (snapshots_) {
+    auto snapshots = std::move(snapshots_);
+    snapshots->Close();
+  }
+}
+
+void Model::TracePolymer(const Polymer::Ptr &polymer) {
+  if (!trace_) {
+    return;
+  }
+  auto transcript = std::dynamic_pointer_cast<Transcript>(polymer);
+  auto genome = transcript ? transcript->genome() : nullptr;
+  polymer->trace(trace_, trace_->AddPolymer(genome ? genome->name()
+                                                   : polymer->name()));
+}
+
+OccupancyProfiles::Averages Model::dwell_times() const {
+  if (!occupancy_) {
+    return OccupancyProfiles::Averages();
+  }
+  return occupancy_->dwell_times();
+}
+
+std::vector<double> Model::dwell_edges() const {
+  if (!occupancy_) {
+    return std::vector<double>();
+  }
+  return occupancy_->dwell_edges();
+}
 
 void Model::Simulate(int time_limit, int time_step,
-                     const std::string &output = "counts.tsv") {
-  auto &tracker = SpeciesTracker::Instance();
-  Initialize();
-  // Set up file output streams
-  std::ofstream countfile(output, std::ios::trunc);
-  // Output header
-  countfile << "time\tspecies\tprotein\ttranscript\tribo_density\n";
-  int out_time = 0;
+                     const std::string &output = "counts.tsv",
+                     const std::string &method = "direct",
+                     const std::string &format = "tsv") {
+  // Set up output before initializing, so that a bad format or path fails
+  // early
+  Run(time_limit, time_step, method, Output(output, format));
+  std::cout << "Simulation successful. Ignore any warnings that follow." << std::endl;
+}
+
+CountsTable Model::SimulateToTable(int time_limit, int time_step,
+                                   const std::string &method = "direct") {
+  TableCountsWriter writer(time_step > 0 ? time_limit / time_step + 1 : 1);
+  Run(time_limit, time_step, method, writer);
+  writer.Close();
+  return std::move(writer.table());
+}
+
+void Model::SimulateToWriter(int time_limit, int time_step,
+                             const std::string &method, CountsWriter &writer) {
+  Run(time_limit, time_step, method, writer);
+}
+
+void Model::SimulateAt(const std::vector<double> &times,
+                       const std::string &output = "counts.tsv",
+                       const std::string &method = "direct",
+                       const std::string &format = "tsv") {
+  // Check the times before setting up output, so that bad times leave the
+  // output file untouched
+  CheckTimes(times);
+  RunAt(times, method, Output(output, format));
+  std::cout << "Simulation successful. Ignore any warnings that follow." << std::endl;
+}
+
+CountsTable Model::SimulateToTableAt(const std::vector<double> &times,
+                                     const std::string &method = "direct") {
+  CheckTimes(times);
+  TableCountsWriter writer(times.size());
+  RunAt(times, method, writer);
+  writer.Close();
+  return std::move(writer.table());
+}
+
+CompiledModel::CompiledModel(
+    double cell_volume, std::vector<std::function<void(Model &)>> definition,
+    std::vector<std::function<void(CheckpointWriter &)>> calls)
+    : cell_volume_(cell_volume),
+      definition_(std::move(definition)),
+      calls_(std::move(calls)) {}
+
+std::shared_ptr<Model> CompiledModel::Instantiate() const {
+  auto model = std::make_shared<Model>(cell_volume_);
+  model->compiled_ = shared_from_this();
+  model->replaying_ = true;
+  for (const auto &step : definition_) {
+    step(*model);
+  }
+  model->replaying_ = false;
+  return model;
+}
+
+void Model::Define(std::function<void(Model &)> step,
+                   std::function<void(CheckpointWriter &)> call) {
+  if (!replaying_) {
+    definition_.push_back(std::move(step));
+    calls_.push_back(std::move(call));
+  }
+}
+
+CompiledModel::Ptr Model::Compile() const {
+  if (compiled_ && definition_.empty() && !parameters_changed_) {
+    return compiled_;
+  }
+  std::vector<std::function<void(Model &)>> definition;
+  std::vector<std::function<void(CheckpointWriter &)>> calls;
+  if (compiled_) {
+    definition = compiled_->definition_;
+    calls = compiled_->calls_;
+  }
+  definition.insert(definition.end(), definition_.begin(), definition_.end());
+  calls.insert(calls.end(), calls_.begin(), calls_.end());
+  if (!parameters_.empty()) {
+    // Set parameters last, once everything they refer to is defined
+    auto parameters = parameters_;
+    definition.push_back([parameters](Model &model) {
+      for (const auto &parameter : parameters) {
+        model.parameter(parameter.first, parameter.second);
+      }
+    });
+    calls.push_back([parameters](CheckpointWriter &writer) {
+      writer.Write<uint8_t>(PARAMETERS);
+      writer.Write(parameters);
+    });
+  }
+  return CompiledModel::Ptr(new CompiledModel(
+      cell_volume_, std::move(definition), std::move(calls)));
+}
+
+std::string Model::SaveDefinition() const {
+  auto compiled = Compile();
+  CheckpointWriter writer;
+  writer.Write(std::string("pinetree model"));
+  writer.Write<uint32_t>(1);
+  writer.Write(cell_volume_);
+  for (const auto &call : compiled->calls_) {
+    call(writer);
+  }
+  return writer.buffer();
+}
+
+std::shared_ptr<Model> Model::LoadDefinition(const std::string &definition) {
+  return LoadDefinition(definition.data(), definition.size());
+}
+
+std::shared_ptr<Model> Model::LoadDefinition(const char *data,
+                                             std::size_t size) {
+  CheckpointReader reader(data, size);
+  std::string magic;
+  reader.Read(magic);
+  if (magic != "pinetree model") {
+    throw std::runtime_error("Not a pinetree model definition.");
+  }
+  if (reader.Read<uint32_t>() != 1) {
+    throw std::runtime_error("Unsupported model definition version.");
+  }
+  auto model = std::make_shared<Model>(reader.Read<double>());
+  while (!reader.done()) {
+    std::string name;
+    std::vector<std::string> reactants, products;
+    std::map<std::string, double> parameters;
+    int footprint;
+    double rate, mean_speed;
+    bool enabled;
+    switch (reader.Read<uint8_t>()) {
+      case SPECIES:
+        reader.Read(name);
+        model->AddSpecies(name, reader.Read<int32_t>());
+        break;
+      case POLYMERASE:
+        reader.Read(name);
+        footprint = reader.Read<int32_t>();
+        mean_speed = reader.Read<double>();
+        model->AddPolymerase(name, footprint, mean_speed,
+                             reader.Read<int32_t>());
+        break;
+      case RIBOSOME:
+        footprint = reader.Read<int32_t>();
+        mean_speed = reader.Read<double>();
+        model->AddRibosome(footprint, mean_speed, reader.Read<int32_t>());
+        break;
+      case REACTION:
+        rate = reader.Read<double>();
+        reader.Read(reactants);
+        reader.Read(products);
+        reader.Read(name);
+        model->AddReaction(rate, reactants, products, name);
+        break;
+      case GENOME:
+        model->RegisterGenome(Genome::LoadDefinition(reader));
+        break;
+      case PARALLEL: {
+        int threads = reader.Read<int32_t>();
+        model->parallel(threads, reader.Read<double>());
+        break;
+      }
+      case GENOME_COPIES: {
+        int copies = reader.Read<int32_t>();
+        model->RegisterGenome(Genome::LoadDefinition(reader), copies);
+        break;
+      }
+      case TRANSCRIPT:
+        model->RegisterTranscript(Transcript::LoadDefinition(reader));
+        break;
+      case RESUMMATION_INTERVAL:
+        model->resummation_interval(reader.Read<int32_t>());
+        break;
+      case OUTPUT_SPECIES: {
+        std::vector<std::string> patterns;
+        reader.Read(patterns);
+        model->output_species(patterns);
+        break;
+      }
+      case ASYNC_OUTPUT:
+        reader.Read(enabled);
+        model->async_output(enabled);
+        break;
+      case RUN_AHEAD:
+        reader.Read(enabled);
+        model->run_ahead(enabled);
+        break;
+      case OCCUPANCY:
+        model->RecordOccupancy();
+        break;
+      case DWELL_TIMES: {
+        double min_time = reader.Read<double>();
+        double max_time = reader.Read<double>();
+        model->RecordDwellTimes(min_time, max_time, reader.Read<int32_t>());
+        break;
+      }
+      case PARAMETERS:
+        reader.Read(parameters);
+        for (const auto &parameter : parameters) {
+          model->parameter(parameter.first, parameter.second);
+        }
+        break;
+      case CODON_STEPS:
+        reader.Read(enabled);
+        model->codon_steps(enabled);
+        break;
+      case SKIP_BLOCKED:
+        reader.Read(enabled);
+        model->skip_blocked(enabled);
+        break;
+      case PARTIAL_EQUILIBRIUM:
+        model->partial_equilibrium(reader.Read<double>());
+        break;
+      case STEADY_STATE: {
+        int window = reader.Read<int32_t>();
+        model->steady_state(window, reader.Read<double>());
+        break;
+      }
+      case COMMON_RANDOM_NUMBERS:
+        reader.Read(enabled);
+        model->common_random_numbers(enabled);
+        break;
+      case FAST_RANDOM:
+        reader.Read(enabled);
+        model->fast_random(enabled);
+        break;
+      case RECORD_TOTALS:
+        reader.Read(enabled);
+        model->record_totals(enabled);
+        break;
+      case MEMORY_SAMPLING:
+        reader.Read(enabled);
+        model->memory_sampling(enabled);
+        break;
+      case TIME_BUCKETS:
+        reader.Read(enabled);
+        model->time_buckets(enabled);
+        break;
+      case STOP_WHEN:
+        reader.Read(name);
+        model->stop_when(name);
+        break;
+      case SCHEDULE_SPECIES: {
+        double time = reader.Read<double>();
+        reader.Read(name);
+        model->ScheduleSpecies(time, name, reader.Read<int32_t>());
+        break;
+      }
+      case SCHEDULE_PARAMETER: {
+        double time = reader.Read<double>();
+        reader.Read(name);
+        model->ScheduleParameter(time, name, reader.Read<double>());
+        break;
+      }
+      default:
+        throw std::runtime_error("Unknown call in model definition.");
+    }
+  }
+  return model;
+}
+
+std::shared_ptr<Model> Model::Clone() const { return Compile()->Instantiate(); }
+
+/**
+ * Choose the shared seed for a set of replicates, checking that there is
+ * either one seed per replicate or a single shared seed.
+ */
+static int SharedSeed(int replicates, const std::vector<int> &seeds) {
+  if (seeds.size() > 1 && static_cast<int>(seeds.size()) != replicates) {
+    throw std::invalid_argument(
+        "Expected one seed per replicate or a single shared seed.");
+  }
+  return seeds.empty() ? std::random_device()() : seeds[0];
+}
+
+/**
+ * Seed a replicate with its own seed, or with its own stream of the shared
+ * seed.
+ */
+static void SeedReplicate(Model &model, int replicate,
+                          const std::vector<int> &seeds, int shared_seed) {
+  if (seeds.size() > 1) {
+    model.seed(seeds[replicate]);
+  } else {
+    model.seed(shared_seed, replicate);
+  }
+}
+
+void Model::placement(const std::string &policy) {
+  placement_ = ParsePlacement(policy);
+}
+
+void Model::SimulateEnsemble(
+    int replicates, const std::vector<int> &seeds, int threads,
+    const std::function<void(int, Model &)> &run) const {
+  int shared_seed = SharedSeed(replicates, seeds);
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, replicates);
+  auto compiled = Compile();
+  std::vector<int> cpus = PlacementCpus(placement_, threads);
+  // Workers take replicates in order until all are done or one fails, so a
+  // worker that drew cheap replicates takes more of them
+  std::atomic<int> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&](int thread_index) {
+    if (!cpus.empty()) {
+      PinThread(cpus[thread_index]);
+    }
+    // Each worker instantiates one model and resets it for every later
+    // replicate, unless it records occupancy or a trace
+    std::shared_ptr<Model> model;
+    int replicate;
+    while (!failed && (replicate = next++) < replicates) {
+      try {
+        if (model && !model->occupancy_ && !model->trace_) {
+          model->Reset(0);
+        } else {
+          model = compiled->Instantiate();
+        }
+        SeedReplicate(*model, replicate, seeds, shared_seed);
+        run(replicate, *model);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed) {
+          error = std::current_exception();
+          failed = true;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void Model::SimulateBatch(
+    int replicates, const std::vector<int> &seeds, int threads,
+    const std::vector<double> &times,
+    const std::function<std::unique_ptr<CountsWriter>(int)> &open,
+    const std::function<void(int, CountsWriter &)> &close) const {
+  double previous = 0;
+  for (double time : times) {
+    if (!(time >= previous)) {
+      throw std::invalid_argument(
+          "Output times must be in non-decreasing order and no earlier than "
+          "0.");
+    }
+    previous = time;
+  }
+  int shared_seed = SharedSeed(replicates, seeds);
+
+  // Extract the reaction network from an initialized instance
+  auto model = Compile()->Instantiate();
+  if (!model->stop_condition_.empty()) {
+    throw std::invalid_argument(
+        "Batch simulation does not support stop conditions.");
+  }
+  if (model->tracker_->time_buckets()) {
+    throw std::invalid_argument(
+        "Batch simulation does not support time buckets.");
+  }
+  model->Initialize();
+  SpeciesTracker &tracker = *model->tracker_;
+  std::vector<SpeciesBatch::Reaction> network;
+  for (const auto &reaction : model->gillespie_.reactions()) {
+    if (reaction->kind() == Reaction::SPECIES) {
+      auto species_reaction = static_cast<SpeciesReaction *>(reaction.get());
+      network.push_back({species_reaction->propensity_constant(),
+                         species_reaction->reactant_ids(),
+                         species_reaction->product_ids()});
+    } else if (reaction->kind() != Reaction::POLYMER ||
+               static_cast<PolymerWrapper *>(reaction.get())
+                       ->polymer()
+                       ->prop_sum() != 0) {
+      throw std::invalid_argument(
+          "Batch simulation requires a model whose only reactions are "
+          "species reactions.");
+    }
+  }
+  int species = tracker.names().size();
+  std::vector<bool> present(species, false);
+  CountsWriter::Rows rows;
+  tracker.GatherCounts(rows);
+  for (const auto &row : rows) {
+    present[row.species_id] = true;
+  }
+  // Products are reported once they appear, in order of name like any
+  // other species
+  std::vector<int> counts(species, 0);
+  for (const auto &reaction : network) {
+    for (const auto *ids : {&reaction.reactants, &reaction.products}) {
+      for (int id : *ids) {
+        tracker.Increment(id, 0);
+        counts[id] = tracker.species(id);
+      }
+    }
+  }
+  tracker.GatherCounts(rows);
+  std::vector<int> reported;
+  for (const auto &row : rows) {
+    reported.push_back(row.species_id);
+  }
+  const SpeciesBatch batch(counts, present, network);
+
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  int batches = (replicates + SpeciesBatch::LANES - 1) / SpeciesBatch::LANES;
+  threads = std::min(threads, batches);
+  std::vector<int> cpus = PlacementCpus(placement_, threads);
+  std::atomic<int> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&](int thread_index) {
+    if (!cpus.empty()) {
+      PinThread(cpus[thread_index]);
+    }
+    SpeciesBatch lanes(batch);
+    std::vector<Random> rngs(SpeciesBatch::LANES);
+    std::vector<CountsWriter::Ptr> writers(SpeciesBatch::LANES);
+    CountsWriter::Rows lane_rows;
+    int index;
+    while (!failed && (index = next++) < batches) {
+      try {
+        int first = index * SpeciesBatch::LANES;
+        int size = std::min(SpeciesBatch::LANES, replicates - first);
+        std::vector<Random *> lane_rngs;
+        for (int lane = 0; lane < size; lane++) {
+          int replicate = first + lane;
+          if (seeds.size() > 1) {
+            rngs[lane].seed(seeds[replicate]);
+          } else {
+            rngs[lane].seed(shared_seed, replicate);
+          }
+          rngs[lane].fast(rng_->fast());
+          lane_rngs.push_back(&rngs[lane]);
+          writers[lane] = open(replicate);
+        }
+        lanes.Run(lane_rngs, times,
+                  [&](int lane, int time, const double *lane_counts) {
+                    lane_rows.clear();
+                    for (int id : reported) {
+                      if (lanes.appeared(id, lane)) {
+                        lane_rows.push_back(
+                            {id, lane_counts[id * SpeciesBatch::LANES], 0, 0});
+                      }
+                    }
+                    writers[lane]->WriteRows(times[time], lane_rows,
+                                             tracker.names());
+                  });
+        for (int lane = 0; lane < size; lane++) {
+          writers[lane]->Close();
+          if (close) {
+            close(first + lane, *writers[lane]);
+          }
+          writers[lane].reset();
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed) {
+          error = std::current_exception();
+          failed = true;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::vector<std::shared_ptr<Model>> Model::Fork(
+    int forks, const std::vector<int> &seeds) {
+  int shared_seed = SharedSeed(forks, seeds);
+  CheckpointWriter writer;
+  Save(writer);
+  auto compiled = Compile();
+  std::vector<std::shared_ptr<Model>> models;
+  for (int i = 0; i < forks; i++) {
+    auto model = compiled->Instantiate();
+    CheckpointReader reader(writer.buffer());
+    model->Load(reader);
+    SeedReplicate(*model, i, seeds, shared_seed);
+    models.push_back(model);
+  }
+  return models;
+}
+
+void Model::PartitionSpecies(Model &daughter) {
+  int names = tracker_->names().size();
+  for (int id = 0; id < names; id++) {
+    int count = tracker_->count(id);
+    if (!tracker_->free_species(id) || count == 0) {
+      continue;
+    }
+    int kept = rng_->binomial(count, 0.5);
+    tracker_->Increment(id, kept - count);
+    daughter.tracker_->Increment(tracker_->species_name(id), -kept);
+  }
+}
+
+void Model::Checkpoint(const std::string &path) {
+  CheckpointWriter writer;
+  Save(writer);
+  writer.Save(path);
+}
+
+void Model::Restore(const std::string &path) {
+  std::string buffer = CheckpointReader::Load(path);
+  CheckpointReader reader(buffer);
+  Load(reader);
+}
+
+/**
+ * Identifies each polymer in a checkpoint: a registered genome, a registered
+ * transcript, or a transcript built by a genome during the simulation.
+ */
+enum class CheckpointPolymer { GENOME, TRANSCRIPT, GENOME_TRANSCRIPT };
+
+void Model::Save(CheckpointWriter &writer) {
+  if (!initialized_) {
+    Initialize();
+  }
+  writer.Write(std::string("pinetree checkpoint"));
+  writer.Write<uint32_t>(9);
+  // Enough of the definition to catch restoring into the wrong model
+  writer.Write(cell_volume_);
+  writer.Write<uint32_t>(genomes_.size());
+  writer.Write<uint32_t>(transcripts_.size());
+  writer.Write<uint32_t>(reactions_.size());
+  tracker_->SaveNames(writer);
+
+  // Number polymers: registered ones first, then those built during the
+  // simulation in the order the engine holds them
+  Polymer::VecPtr polymers(genomes_.begin(), genomes_.end());
+  polymers.insert(polymers.end(), transcripts_.begin(), transcripts_.end());
+  std::map<const Polymer *, int> polymer_ids;
+  for (int i = 0; i < static_cast<int>(polymers.size()); i++) {
+    polymer_ids[polymers[i].get()] = i;
+  }
+  for (const auto &reaction : gillespie_.reactions()) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper && polymer_ids.count(wrapper->polymer().get()) == 0) {
+      polymer_ids[wrapper->polymer().get()] = polymers.size();
+      polymers.push_back(wrapper->polymer());
+    }
+  }
+  auto polymer_id = [&polymer_ids](const Polymer::Ptr &polymer) {
+    if (!polymer) {
+      return -1;
+    }
+    auto it = polymer_ids.find(polymer.get());
+    if (it == polymer_ids.end()) {
+      throw std::runtime_error(
+          "Cannot checkpoint a polymer that is not part of the simulation.");
+    }
+    return it->second;
+  };
+  std::map<const Genome *, int> genome_ids;
+  for (int i = 0; i < static_cast<int>(genomes_.size()); i++) {
+    genome_ids[genomes_[i].get()] = i;
+  }
+  int polymer_count = polymers.size();
+  writer.Write<uint32_t>(polymer_count);
+  for (int i = genomes_.size() + transcripts_.size(); i < polymer_count; i++) {
+    auto transcript = std::dynamic_pointer_cast<Transcript>(polymers[i]);
+    auto genome = transcript ? transcript->genome() : nullptr;
+    if (!genome || genome_ids.count(genome.get()) == 0) {
+      throw std::runtime_error(
+          "Cannot checkpoint a transcript without a registered genome.");
+    }
+    writer.Write<int32_t>(genome_ids[genome.get()]);
+    writer.Write<int32_t>(transcript->start());
+    writer.Write<int32_t>(transcript->stop());
+  }
+  for (const auto &polymer : polymers) {
+    polymer->Save(writer, polymer_id);
+  }
+  tracker_->Save(writer, polymer_id);
+  writer.Write<int32_t>(perturbation_reaction_ ? perturbation_reaction_->next()
+                                               : 0);
+
+  std::map<const Reaction *, int> reaction_ids;
+  for (int i = 0; i < static_cast<int>(reactions_.size()); i++) {
+    reaction_ids[reactions_[i].get()] = i;
+  }
+  // Polymer wrappers are identified by their polymer, as -1 - polymer ID
+  gillespie_.Save(writer, [&](const Reaction::Ptr &reaction) {
+    auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+    if (wrapper) {
+      return -1 - polymer_id(wrapper->polymer());
+    }
+    return reaction_ids.at(reaction.get());
+  });
+  rng_->Save(writer);
+  writer.Write<int32_t>(output_time_);
+  polymer_stats_->Save(writer);
+}
+
+void Model::Reset(int seed, int stream) {
+  if (occupancy_ || trace_) {
+    throw std::runtime_error(
+        "Cannot reset a model that records occupancy or an event trace.");
+  }
+  CloseOutput();
+  if (initialized_) {
+    // Drop the transcripts built since initialization; their wrappers
+    // unlink them from the tracker as they are destroyed
+    std::set<const Polymer *> registered;
+    for (const auto &genome : genomes_) {
+      registered.insert(genome.get());
+    }
+    for (const auto &transcript : transcripts_) {
+      registered.insert(transcript.get());
+    }
+    Reaction::VecPtr built;
+    for (const auto &reaction : gillespie_.reactions()) {
+      auto wrapper = std::dynamic_pointer_cast<PolymerWrapper>(reaction);
+      if (wrapper && registered.count(wrapper->polymer().get()) == 0) {
+        built.push_back(reaction);
+      }
+    }
+    for (const auto &reaction : built) {
+      gillespie_.DeleteReaction(reaction->index());
+    }
+    built.clear();
+    tracker_->Truncate(initial_species_);
+    CheckpointReader reader(initial_state_);
+    LoadState(reader);
+    // The saved state holds the selection structures of the method this
+    // model was first run with, including the random waiting times of the
+    // next reaction method. Go back to the default method of a new model so
+    // that the next run sets them up from the new seed.
+    gillespie_.method(Gillespie::Method::DIRECT_TREE);
+    equilibrium_.Invalidate();
+    // The saved propensities predate any parameters set since
+    for (const auto &parameter : parameters_) {
+      AccessParameter(parameter.first, &parameter.second);
+    }
+  }
+  rng_->seed(seed, stream);
+}
+
+void Model::Load(CheckpointReader &reader) {
+  if (initialized_) {
+    throw std::runtime_error(
+        "Checkpoints can only be restored into a model that has not been "
+        "simulated.");
+  }
+  LoadState(reader);
+}
+
+void Model::LoadState(CheckpointReader &reader) {
+  std::string magic;
+  reader.Read(magic);
+  if (magic != "pinetree checkpoint") {
+    throw std::runtime_error("Not a pinetree checkpoint.");
+  }
+  CheckpointReader::Expect(reader.Read<uint32_t>() == 9,
+                           "checkpoint version");
+  CheckpointReader::Expect(reader.Read<double>() == cell_volume_,
+                           "cell volume");
+  CheckpointReader::Expect(reader.Read<uint32_t>() == genomes_.size(),
+                           "number of genomes");
+  CheckpointReader::Expect(reader.Read<uint32_t>() == transcripts_.size(),
+                           "number of transcripts");
+  int reaction_count = reader.Read<uint32_t>();
+  if (!initialized_) {
+    Initialize();
+  }
+  CheckpointReader::Expect(
+      reaction_count == static_cast<int>(reactions_.size()),
+      "number of reactions");
+  tracker_->LoadNames(reader);
+
+  // Rebuild transcripts made during the simulation. Registering them
+  // changes counts and propensities, but all of that is overwritten below.
+  Polymer::VecPtr polymers(genomes_.begin(), genomes_.end());
+  polymers.insert(polymers.end(), transcripts_.begin(), transcripts_.end());
+  int polymer_count = reader.Read<uint32_t>();
+  while (static_cast<int>(polymers.size()) < polymer_count) {
+    int genome_id = reader.Read<int32_t>();
+    int start = reader.Read<int32_t>();
+    int stop = reader.Read<int32_t>();
+    CheckpointReader::Expect(
+        genome_id >= 0 && genome_id < static_cast<int>(genomes_.size()),
+        "genome of transcript");
+    auto transcript = genomes_[genome_id]->BuildTranscript(start, stop);
+    RegisterTranscript(transcript);
+    polymers.push_back(transcript);
+  }
+  auto polymer = [&polymers](int id) {
+    if (id == -1) {
+      return Polymer::Ptr();
+    }
+    CheckpointReader::Expect(id >= 0 && id < static_cast<int>(polymers.size()),
+                             "polymer ID");
+    return polymers[id];
+  };
+  for (const auto &item : polymers) {
+    item->Load(reader, polymer);
+  }
+  tracker_->Load(reader, polymer);
+  int made = reader.Read<int32_t>();
+  CheckpointReader::Expect(
+      made >= 0 && made <= static_cast<int>(perturbations_.size()) &&
+          (made == 0 || perturbation_reaction_ != nullptr),
+      "scheduled changes");
+  if (perturbation_reaction_) {
+    perturbation_reaction_->next(made);
+  }
+  // Parameters are not saved, so they are set to the values the changes
+  // made so far left them at
+  RestorePerturbedParameters(made);
+  gillespie_.Load(reader, [&](int id) -> Reaction::Ptr {
+    if (id < 0) {
+      return polymer(-1 - id)->wrapper();
+    }
+    CheckpointReader::Expect(id < static_cast<int>(reactions_.size()),
+                             "reaction ID");
+    return reactions_[id];
+  });
+  rng_->Load(reader);
+  output_time_ = reader.Read<int32_t>();
+  polymer_stats_->Load(reader);
+  // Fast pairs are redrawn at the end of every event, so they were saved
+  // in equilibrium
+  equilibrium_.Synchronize(gillespie_.time(), *tracker_);
+}
+
+/**
+ * @return wall time in seconds since a given time point
+ */
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void Model::Prepare(const std::string &method) {
+  if (gillespie_.common_random_numbers() && method != "next_reaction") {
+    throw std::invalid_argument(
+        "Common random numbers require the next_reaction method.");
+  }
+  if (method == "direct") {
+    gillespie_.method(Gillespie::Method::DIRECT_TREE);
+  } else if (method == "direct_linear") {
+    gillespie_.method(Gillespie::Method::DIRECT_LINEAR);
+  } else if (method == "composition_rejection") {
+    gillespie_.method(Gillespie::Method::COMPOSITION_REJECTION);
+  } else if (method == "next_reaction") {
+    gillespie_.method(Gillespie::Method::NEXT_REACTION);
+  } else if (method == "hybrid") {
+    gillespie_.method(Gillespie::Method::HYBRID);
+  } else {
+    throw std::invalid_argument("Unknown simulation method '" + method + "'.");
+  }
+  // A model that has been simulated (or restored) before continues from
+  // where it left off
+  if (!initialized_) {
+    auto started = std::chrono::steady_clock::now();
+    Initialize();
+    timings_.initialize += SecondsSince(started);
+  }
+  // Fast pairs start from their equilibrium, and follow any change made
+  // between runs
+  equilibrium_.Update(gillespie_.time(), *tracker_, *rng_, false);
+}
+
+CountsWriter &Model::Output(const std::string &path,
+                            const std::string &format) {
+  if (!output_ || path != output_path_ || format != output_format_) {
+    CloseOutput();
+    output_ = CountsWriter::Create(format, path, async_output_);
+    output_path_ = path;
+    output_format_ = format;
+  }
+  return *output_;
+}
+
+void Model::CloseOutput() {
+  if (output_) {
+    auto output = std::move(output_);
+    output->Close();
+  }
+}
+
+void Model::progress(std::function<void(double, double)> callback,
+                     double interval) {
+  progress_ = std::move(callback);
+  progress_interval_ = interval;
+}
+
+void Model::Cancel() { cancelled_.store(true); }
+
+// Number of events between reads of the clock for progress reports
+static const int kPollEvents = 1024;
+
+static long long EventCount(const Gillespie::Stats &stats) {
+  long long events = 0;
+  for (auto count : stats.events) {
+    events += count;
+  }
+  return events;
+}
+
+void Model::StartProgress() {
+  poll_countdown_ = kPollEvents;
+  progress_time_ = std::chrono::steady_clock::now();
+  progress_events_ = EventCount(stats());
+}
+
+bool Model::Poll(int events) {
+  if (cancelled_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  if (progress_ && (poll_countdown_ -= events) <= 0) {
+    poll_countdown_ = kPollEvents;
+    double elapsed = SecondsSince(progress_time_);
+    if (elapsed >= progress_interval_) {
+      long long events = EventCount(stats());
+      progress_time_ = std::chrono::steady_clock::now();
+      progress_(time(), (events - progress_events_) / elapsed);
+      progress_events_ = events;
+    }
+  }
+  return false;
+}
+
+void Model::Run(int time_limit, int time_step, const std::string &method,
+                CountsWriter &writer) {
+  Prepare(method);
+  auto started = std::chrono::steady_clock::now();
+  StartProgress();
+  double output = 0;
+  int out_time = output_time_;
+  std::unique_ptr<SteadyState> detector = StartSteadyState();
+  StartStopCondition();
+  bool steady = false;
+  auto write = [&]() {
+    auto writing = std::chrono::steady_clock::now();
+    PINETREE_ZONE("output");
+    writer.Write(gillespie_.time(), *tracker_);
+    WriteMemory(writer);
+    if (snapshots_) {
+      snapshots_->Write(gillespie_.time(), gillespie_.reactions());
+    }
+    if (detector && detector->Add(*tracker_)) {
+      steady = true;
+      steady_state_time_ = gillespie_.time();
+      writer.WriteMetadata("steady_state_time", steady_state_time_);
+    }
+    output += SecondsSince(writing);
+    out_time += time_step;
+  };
+  // Events can be far apart when elements run ahead, wait while blocked or
+  // are translated in the mean-field approximation, so the first event past
+  // an output time may be long after it
+  bool sparse = run_ahead_ || skip_blocked_ ||
+                std::any_of(genomes_.begin(), genomes_.end(),
+                            [](const Genome::Ptr &genome) {
+                              return genome->mean_field();
+                            });
   while (gillespie_.time() < time_limit) {
     if ((out_time - gillespie_.time()) < 0.001) {
-      countfile << tracker.GatherCounts(gillespie_.time());
-      countfile.flush();
-      out_time += time_step;
+      write();
+    }
+    if (steady || Poll() || Stopped()) {
+      break;
+    }
+    if (parallel_threads_ > 0 || sparse) {
+      // Runs stop exactly at the next output time, which is written on the
+      // next pass, or here if it is the time limit
+      double until = std::min(out_time, time_limit);
+      if (!(parallel_threads_ > 0 ? RunWindows(until) : RunTo(until))) {
+        break;
+      }
+      if (gillespie_.time() >= time_limit && out_time <= time_limit) {
+        write();
+      }
+      continue;
     }
     gillespie_.Iterate();
   }
-  countfile.close();
-  std::cout << "Simulation successful. Ignore any warnings that follow." << std::endl;
+  output_time_ = out_time;
+  cancelled_.store(false);
+  auto closing = std::chrono::steady_clock::now();
+  WriteStop(writer);
+  writer.Flush();
+  if (snapshots_) {
+    snapshots_->Flush();
+  }
+  output += SecondsSince(closing);
+  timings_.output += output;
+  timings_.simulate += SecondsSince(started) - output;
+}
+
+void Model::CheckTimes(const std::vector<double> &times) const {
+  double previous = gillespie_.time();
+  for (double time : times) {
+    if (!(time >= previous)) {
+      throw std::invalid_argument(
+          "Output times must be in non-decreasing order and no earlier than "
+          "the current simulation time.");
+    }
+    previous = time;
+  }
+}
+
+void Model::RunAt(const std::vector<double> &times, const std::string &method,
+                  CountsWriter &writer) {
+  Prepare(method);
+  auto started = std::chrono::steady_clock::now();
+  StartProgress();
+  double output = 0;
+  std::unique_ptr<SteadyState> detector = StartSteadyState();
+  StartStopCondition();
+  for (double time : times) {
+    bool finished = parallel_threads_ > 0 ? RunWindows(time) : RunTo(time);
+    if (!finished) {
+      break;
+    }
+    auto writing = std::chrono::steady_clock::now();
+    PINETREE_ZONE("output");
+    writer.Write(time, *tracker_);
+    WriteMemory(writer);
+    if (snapshots_) {
+      snapshots_->Write(time, gillespie_.reactions());
+    }
+    bool steady = detector && detector->Add(*tracker_);
+    if (steady) {
+      steady_state_time_ = time;
+      writer.WriteMetadata("steady_state_time", time);
+    }
+    output += SecondsSince(writing);
+    if (steady) {
+      break;
+    }
+  }
+  cancelled_.store(false);
+  auto closing = std::chrono::steady_clock::now();
+  WriteStop(writer);
+  writer.Flush();
+  if (snapshots_) {
+    snapshots_->Flush();
+  }
+  output += SecondsSince(closing);
+  timings_.output += output;
+  timings_.simulate += SecondsSince(started) - output;
+}
+
+bool Model::RunTo(double time) {
+  int events = 0;
+  while (!Poll(events) && !Stopped()) {
+    int budget = kPollEvents;
+    if (gillespie_.RunUntil(time, &budget)) {
+      return true;
+    }
+    events = kPollEvents - budget;
+  }
+  return false;
+}
+
+std::unique_ptr<SteadyState> Model::StartSteadyState() {
+  steady_state_time_ = -1;
+  if (steady_state_window_ == 0) {
+    return nullptr;
+  }
+  return std::unique_ptr<SteadyState>(
+      new SteadyState(steady_state_window_, steady_state_tolerance_));
+}
+
+void Model::StartStopCondition() {
+  stop_time_ = -1;
+  stop_clause_ = -1;
+  stop_clause_text_.clear();
+  tracker_->Unwatch();
+  stop_condition_.Watch(*tracker_);
+}
+
+bool Model::Stopped() {
+  if (!tracker_->TakeWatchedChange()) {
+    return false;
+  }
+  stop_clause_ = stop_condition_.Check(*tracker_);
+  if (stop_clause_ < 0) {
+    return false;
+  }
+  stop_time_ = gillespie_.time();
+  stop_clause_text_ = stop_condition_.clause(stop_clause_);
+  return true;
+}
+
+void Model::WriteStop(CountsWriter &writer) {
+  if (stop_clause_ >= 0) {
+    writer.WriteMetadata("stop_time", stop_time_);
+    writer.WriteMetadata("stop_condition", stop_clause_);
+  }
+}
+
+void Model::WriteMemory(CountsWriter &writer) const {
+  if (!memory_sampling_) {
+    return;
+  }
+  MemoryReport report = memory_report();
+  for (const auto &usage : report.usage()) {
+    writer.WriteMetadata("memory_" + usage.first, usage.second.bytes);
+  }
+  writer.WriteMetadata("memory_total", report.total());
+  writer.WriteMetadata("memory_pool_reserved", report.pool_reserved());
+}
+
+bool Model::RunWindows(double until) {
+  if (run_ahead_ || skip_blocked_ || occupancy_ || trace_ || observers_) {
+    throw std::runtime_error(
+        "Parallel simulation cannot be combined with run-ahead, skipping "
+        "blocked moves, occupancy, event traces or observers.");
+  }
+  ParkPolymers(true);
+  bool finished = true;
+  try {
+    while (gillespie_.time() < until) {
+      if (Poll() || Stopped()) {
+        finished = false;
+        break;
+      }
+      double start = gillespie_.time();
+      double end = std::min(until, start + parallel_window_);
+      gillespie_.RunUntil(end);
+      MovePolymers(start, end);
+    }
+  } catch (...) {
+    ParkPolymers(false);
+    throw;
+  }
+  ParkPolymers(false);
+  return finished;
+}
+
+void Model::ParkPolymers(bool parked) {
+  parallel_running_ = parked;
+  // Parked polymers move between runs of the engine, so the clock has to
+  // reach the end of a window even if nothing else can happen in it
+  gillespie_.idle(parked);
+  for (const auto &reaction : gillespie_.reactions()) {
+    if (reaction->kind() == Reaction::POLYMER) {
+      static_cast<PolymerWrapper *>(reaction.get())->park(parked);
+      gillespie_.UpdatePropensity(reaction);
+    }
+  }
+}
+
+void Model::MovePolymers(double start, double end) {
+  // Polymerases extend the transcripts of their genome, so a genome and the
+  // transcripts it built are moved together
+  std::vector<std::vector<PolymerWrapper *>> groups;
+  std::unordered_map<const Polymer *, int> group_ids;
+  for (const auto &reaction : gillespie_.reactions()) {
+    if (reaction->kind() != Reaction::POLYMER) {
+      continue;
+    }
+    auto wrapper = static_cast<PolymerWrapper *>(reaction.get());
+    const Polymer *owner = wrapper->polymer().get();
+    auto transcript = dynamic_cast<const Transcript *>(owner);
+    auto genome = transcript ? transcript->genome() : nullptr;
+    if (genome) {
+      owner = genome.get();
+    }
+    auto group = group_ids.emplace(owner, groups.size());
+    if (group.second) {
+      groups.emplace_back();
+    }
+    groups[group.first->second].push_back(wrapper);
+  }
+  int group_count = groups.size();
+  while (group_rngs_.size() < groups.size()) {
+    group_rngs_.push_back(std::make_shared<Random>());
+    group_stats_.push_back(std::make_shared<PolymerStats>());
+  }
+  // Each group draws from its own stream, so that with one thread the
+  // trajectory only depends on the seed
+  int seed = static_cast<int>(rng_->random() *
+                              std::numeric_limits<int>::max());
+  for (int i = 0; i < group_count; i++) {
+    group_rngs_[i]->seed(seed, i);
+    group_rngs_[i]->fast(rng_->fast());
+    for (auto wrapper : groups[i]) {
+      wrapper->polymer()->rng(group_rngs_[i]);
+      wrapper->polymer()->stats(group_stats_[i]);
+    }
+  }
+
+  tracker_->guard(&parallel_guard_);
+  pool_->guard(&parallel_guard_);
+  for (const auto &genome : genomes_) {
+    genome->guard(&parallel_guard_);
+  }
+  std::vector<long long> moves(groups.size(), 0);
+  std::atomic<int> next_group(0);
+  std::exception_ptr error;
+  std::mutex error_lock;
+  auto work = [&]() {
+    for (int i = next_group++; i < group_count; i = next_group++) {
+      try {
+        moves[i] = MoveGroup(groups[i], *group_rngs_[i], start, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_lock);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  int extra_threads = std::min<int>(parallel_threads_, groups.size()) - 1;
+  for (int i = 0; i < extra_threads; i++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  tracker_->guard(nullptr);
+  pool_->guard(nullptr);
+  for (const auto &genome : genomes_) {
+    genome->guard(nullptr);
+  }
+
+  long long total_moves = 0;
+  for (int i = 0; i < group_count; i++) {
+    total_moves += moves[i];
+    polymer_stats_->Collect(*group_stats_[i]);
+    for (auto wrapper : groups[i]) {
+      wrapper->polymer()->rng(rng_);
+      wrapper->polymer()->stats(polymer_stats_);
+    }
+  }
+  gillespie_.CountEvents(Reaction::POLYMER, total_moves);
+  for (const auto &group : groups) {
+    for (auto wrapper : group) {
+      if (wrapper->remove()) {
+        gillespie_.DeleteReaction(wrapper->index());
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+long long Model::MoveGroup(const std::vector<PolymerWrapper *> &group,
+                           Random &rng, double start, double end) {
+  long long moves = 0;
+  double time = start;
+  while (true) {
+    double total = 0;
+    for (auto wrapper : group) {
+      if (!wrapper->remove()) {
+        total += wrapper->polymer()->prop_sum();
+      }
+    }
+    if (total <= 0) {
+      break;
+    }
+    time += rng.exponential() / total;
+    if (time > end) {
+      break;
+    }
+    double target = rng.random() * total;
+    PolymerWrapper *chosen = nullptr;
+    for (auto wrapper : group) {
+      if (wrapper->remove() || wrapper->polymer()->prop_sum() <= 0) {
+        continue;
+      }
+      chosen = wrapper;
+      target -= wrapper->polymer()->prop_sum();
+      if (target < 0) {
+        break;
+      }
+    }
+    chosen->Execute();
+    moves++;
+  }
+  return moves;
 }
 
 void Model::AddReaction(double rate_constant,
                         const std::vector<std::string> &reactants,
-                        const std::vector<std::string> &products) {
+                        const std::vector<std::string> &products,
+                        const std::string &name) {
+  if (!name.empty() && named_reactions_.count(name) != 0) {
+    throw std::invalid_argument("There is already a reaction named '" + name +
+                                "'.");
+  }
   auto rxn = std::make_shared<SpeciesReaction>(rate_constant, cell_volume_,
-                                               reactants, products);
-  auto &tracker = SpeciesTracker::Instance();
+                                               reactants, products, tracker_);
+  if (!name.empty()) {
+    named_reactions_[name] = rxn;
+  }
   for (const auto &reactant : reactants) {
-    tracker.Add(reactant, rxn);
+  tracker_->Add(reactant, rxn);
   }
   for (const auto &product : products) {
-    tracker.Add(product, rxn);
+  tracker_->Add(product, rxn);
   }
-  gillespie_.LinkReaction(rxn);
+  gillespie_.LinkSpeciesReaction(rxn);
+  reactions_.push_back(rxn);
+  Define([=](Model &model) {
+    model.AddReaction(rate_constant, reactants, products, name);
+  }, [=](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(REACTION);
+    writer.Write(rate_constant);
+    writer.Write(reactants);
+    writer.Write(products);
+    writer.Write(name);
+  });
 }
 
 void Model::AddSpecies(const std::string &name, int copy_number) {
@@ -59,46 +1740,104 @@ void Model::AddSpecies(const std::string &name, int copy_number) {
         "Names prefixed with '__' (double underscore) are reserved for "
         "internal use.");
   }
-  auto &tracker = SpeciesTracker::Instance();
-  tracker.Increment(name, copy_number);
+  tracker_->Increment(name, copy_number);
+  Define([=](Model &model) { model.AddSpecies(name, copy_number); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(SPECIES);
+           writer.Write(name);
+           writer.Write<int32_t>(copy_number);
+         });
 }
 
 void Model::AddPolymerase(const std::string &name, int footprint,
                           double mean_speed, int copy_number) {
   auto pol = Polymerase(name, footprint, mean_speed);
   polymerases_.push_back(pol);
-  auto &tracker = SpeciesTracker::Instance();
-  tracker.Increment(name, copy_number);
+  tracker_->Increment(name, copy_number);
+  Define([=](Model &model) {
+    model.AddPolymerase(name, footprint, mean_speed, copy_number);
+  }, [=](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(POLYMERASE);
+    writer.Write(name);
+    writer.Write<int32_t>(footprint);
+    writer.Write(mean_speed);
+    writer.Write<int32_t>(copy_number);
+  });
 }
 
 void Model::AddRibosome(int footprint, double mean_speed, int copy_number) {
   auto pol = Polymerase("__ribosome", footprint, mean_speed);
   polymerases_.push_back(pol);
-  auto &tracker = SpeciesTracker::Instance();
-  tracker.Increment("__ribosome", copy_number);
+  tracker_->Increment("__ribosome", copy_number);
+  Define([=](Model &model) {
+    model.AddRibosome(footprint, mean_speed, copy_number);
+  }, [=](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(RIBOSOME);
+    writer.Write<int32_t>(footprint);
+    writer.Write(mean_speed);
+    writer.Write<int32_t>(copy_number);
+  });
 }
 
 void Model::RegisterPolymer(Polymer::Ptr polymer) {
   // Encapsulate polymer in PolymerWrapper reaction and add to reaction list
-  auto wrapper = std::make_shared<PolymerWrapper>(polymer);
+  polymer->tracker(tracker_);
+  polymer->rng(rng_);
+  polymer->pool(pool_);
+  polymer->stats(polymer_stats_);
+  RecordOccupancy(polymer);
+  TracePolymer(polymer);
+  polymer->observers(observers_);
+  polymer->run_ahead(run_ahead_, gillespie_.clock());
+  polymer->codon_steps(codon_steps_);
+  polymer->skip_blocked(skip_blocked_);
+  auto wrapper = MakePooled<PolymerWrapper>(pool_, polymer);
   polymer->wrapper(wrapper);
+  wrapper->park(parallel_running_);
   gillespie_.LinkReaction(wrapper);
 }
 
-void Model::RegisterGenome(Genome::Ptr genome) {
-  RegisterPolymer(genome);
-  genome->termination_signal_.ConnectMember(
-      &SpeciesTracker::Instance(), &SpeciesTracker::TerminateTranscription);
-  genome->transcript_signal_.ConnectMember(this, &Model::RegisterTranscript);
-  genomes_.push_back(genome);
+void Model::RegisterGenome(Genome::Ptr genome, int copies) {
+  if (copies < 1) {
+    throw std::invalid_argument("Genome " + genome->name() +
+                                " needs at least one copy.");
+  }
+  for (int i = 0; i < copies; i++) {
+    // The first copy builds the layouts that the others share
+    auto copy = i == 0 ? genome : genome->Copy();
+    RegisterPolymer(copy);
+    copy->termination_signal_.ConnectMember(
+        tracker_.get(), &SpeciesTracker::TerminateTranscription);
+    copy->transcript_signal_.ConnectMember(this, &Model::RegisterTranscript);
+    genomes_.push_back(copy);
+  }
+  Define([genome, copies](Model &model) {
+    model.RegisterGenome(genome->Clone(), copies);
+  }, [genome, copies](CheckpointWriter &writer) {
+    if (copies == 1) {
+      writer.Write<uint8_t>(GENOME);
+    } else {
+      writer.Write<uint8_t>(GENOME_COPIES);
+      writer.Write<int32_t>(copies);
+    }
+    genome->SaveDefinition(writer);
+  });
 }
 
 void Model::RegisterTranscript(Transcript::Ptr transcript) {
   RegisterPolymer(transcript);
   transcript->termination_signal_.ConnectMember(
-      &SpeciesTracker::Instance(), &SpeciesTracker::TerminateTranslation);
-  if (initialized_ == false) {
+      tracker_.get(), &SpeciesTracker::TerminateTranslation);
+  if (initialized_) {
+    polymer_stats_->transcripts_created++;
+  } else {
     transcripts_.push_back(transcript);
+    Define([transcript](Model &model) {
+      model.RegisterTranscript(transcript->Clone());
+    }, [transcript](CheckpointWriter &writer) {
+      writer.Write<uint8_t>(TRANSCRIPT);
+      transcript->SaveDefinition(writer);
+    });
   }
 }
 
@@ -108,58 +1847,84 @@ void Model::Initialize() {
                  "Model. Did you forget to register a Genome?"
               << std::endl;
   }
-  // Create Bind reactions for each promoter-polymerase pair
+  // Create Bind reactions for each promoter-polymerase pair. A reaction
+  // already binds to every polymer carrying its promoter, so copies of a
+  // genome (or genomes sharing a promoter at the same rate) share one.
+  std::set<std::tuple<std::string, std::string, double>> bindings;
+  std::set<std::tuple<std::string, double, int, double>> rnase_bindings;
   for (Genome::Ptr genome : genomes_) {
     for (auto promoter_name : genome->bindings()) {
       for (auto pol : polymerases_) {
         if (promoter_name.second.count(pol.name()) != 0) {
           double rate_constant = promoter_name.second[pol.name()];
+          if (!bindings
+                   .emplace(promoter_name.first, pol.name(), rate_constant)
+                   .second) {
+            continue;
+          }
           Polymerase pol_template = Polymerase(pol);
           auto reaction = std::make_shared<BindPolymerase>(
-              rate_constant, cell_volume_, promoter_name.first, pol_template);
-          auto &tracker = SpeciesTracker::Instance();
-          tracker.Add(promoter_name.first, reaction);
-          tracker.Add(pol.name(), reaction);
+              rate_constant, cell_volume_, promoter_name.first, pol_template,
+              tracker_, rng_);
+          tracker_->Add(promoter_name.first, reaction);
+          tracker_->Add(pol.name(), reaction);
           gillespie_.LinkReaction(reaction);
+          reactions_.push_back(reaction);
         }
       }
     }
+    auto new_rnase_binding = [&](const std::string &site, double rate) {
+      return rnase_bindings
+          .emplace(site, rate, genome->rnase_footprint(),
+                   genome->rnase_speed())
+          .second;
+    };
     // Create reaction for external rnase binding
-    if (genome->transcript_degradation_rate_ext() != 0.0) {
+    if (genome->transcript_degradation_rate_ext() != 0.0 &&
+        new_rnase_binding("__rnase_site_ext",
+                          genome->transcript_degradation_rate_ext())) {
       auto rnase_template_ext =
           Rnase(genome->rnase_footprint(), genome->rnase_speed());
       auto reaction_ext = std::make_shared<BindRnase>(
           genome->transcript_degradation_rate_ext(), cell_volume_,
-          rnase_template_ext, "__rnase_site_ext");
-      auto &tracker = SpeciesTracker::Instance();
-      tracker.Add("__rnase_site_ext", reaction_ext);
+          rnase_template_ext, "__rnase_site_ext", tracker_, rng_);
+      tracker_->Add("__rnase_site_ext", reaction_ext);
       gillespie_.LinkReaction(reaction_ext);
+      reactions_.push_back(reaction_ext);
     }
     
     // Create reaction for internal rnase binding
     if (genome->transcript_degradation_rate() != 0.0) {
+      if (!new_rnase_binding("__rnase_site",
+                             genome->transcript_degradation_rate())) {
+        continue;
+      }
       // TODO: user defined Rnase speed
       // auto rnase_template = Rnase(10, 30);
       auto rnase_template =
           Rnase(genome->rnase_footprint(), genome->rnase_speed());
       auto reaction = std::make_shared<BindRnase>(
           genome->transcript_degradation_rate(), cell_volume_, rnase_template,
-          "__rnase_site");
-      auto &tracker = SpeciesTracker::Instance();
-      tracker.Add("__rnase_site", reaction);
+          "__rnase_site", tracker_, rng_);
+      tracker_->Add("__rnase_site", reaction);
       gillespie_.LinkReaction(reaction);
+      reactions_.push_back(reaction);
     } 
     
     // Alternatively, create bind reactions for individual rnase sites
     else if (genome->rnase_bindings().size() != 0) {
       for (auto rnase_site : genome->rnase_bindings()) {
+        if (!new_rnase_binding(rnase_site.first, rnase_site.second)) {
+          continue;
+        }
         auto rnase_template =
           Rnase(genome->rnase_footprint(), genome->rnase_speed());
         auto reaction = std::make_shared<BindRnase>(
-          rnase_site.second, cell_volume_, rnase_template, rnase_site.first);
-        auto &tracker = SpeciesTracker::Instance();
-        tracker.Add(rnase_site.first, reaction);
+            rnase_site.second, cell_volume_, rnase_template, rnase_site.first,
+            tracker_, rng_);
+        tracker_->Add(rnase_site.first, reaction);
         gillespie_.LinkReaction(reaction);
+        reactions_.push_back(reaction);
       }
     }
   }
@@ -170,26 +1935,234 @@ void Model::Initialize() {
       for (auto pol : polymerases_) {
         if (rbs_name.second.count(pol.name()) != 0) {
           double rate_constant = rbs_name.second[pol.name()];
+          if (!bindings.emplace(rbs_name.first, pol.name(), rate_constant)
+                   .second) {
+            continue;
+          }
           Polymerase pol_template = Polymerase(pol);
           auto reaction = std::make_shared<BindPolymerase>(
-              rate_constant, cell_volume_, rbs_name.first, pol_template);
-          auto &tracker = SpeciesTracker::Instance();
-          tracker.Add(rbs_name.first, reaction);
-          tracker.Add(pol.name(), reaction);
+              rate_constant, cell_volume_, rbs_name.first, pol_template,
+              tracker_, rng_);
+          tracker_->Add(rbs_name.first, reaction);
+          tracker_->Add(pol.name(), reaction);
           gillespie_.LinkReaction(reaction);
+          reactions_.push_back(reaction);
         }
       }
     }
   }
 
+  if (!perturbations_.empty()) {
+    std::vector<double> times;
+    for (const auto &perturbation : perturbations_) {
+      times.push_back(perturbation.time);
+    }
+    perturbation_reaction_ = std::make_shared<Perturbations>(
+        times, [this](int index) { ApplyPerturbation(perturbations_[index]); });
+    gillespie_.LinkReaction(perturbation_reaction_);
+    reactions_.push_back(perturbation_reaction_);
+  }
+
+  for (const auto &parameter : parameters_) {
+    AccessParameter(parameter.first, &parameter.second);
+  }
+  if (equilibrium_ratio_ > 0) {
+    std::vector<SpeciesReaction::Ptr> species_reactions;
+    for (const auto &reaction : gillespie_.reactions()) {
+      if (reaction->kind() == Reaction::SPECIES) {
+        species_reactions.push_back(
+            std::static_pointer_cast<SpeciesReaction>(reaction));
+      }
+    }
+    for (const auto &reaction : equilibrium_.Detect(
+             species_reactions, *tracker_, equilibrium_ratio_)) {
+      gillespie_.UpdatePropensity(reaction);
+    }
+    if (!equilibrium_.empty()) {
+      // Pairs relax between two slow events, but not necessarily between
+      // two moves of an element
+      gillespie_.after_event([this](Reaction::Kind kind) {
+        equilibrium_.Update(gillespie_.time(), *tracker_, *rng_,
+                            kind != Reaction::POLYMER);
+      });
+    }
+  }
   initialized_ = true;
+  CheckpointWriter writer;
+  Save(writer);
+  initial_state_ = writer.buffer();
+  initial_species_ = tracker_->names().size();
+}
+
+void Model::parameter(const std::string &name, double value) {
+  if (!(value >= 0)) {
+    throw std::invalid_argument("Parameter '" + name +
+                                "' cannot be negative.");
+  }
+  AccessParameter(name, &value);
+  parameters_[name] = value;
+  if (!replaying_) {
+    parameters_changed_ = true;
+  }
+}
+
+double Model::parameter(const std::string &name) {
+  auto it = parameters_.find(name);
+  if (it != parameters_.end()) {
+    return it->second;
+  }
+  return AccessParameter(name, nullptr);
+}
+
+void Model::ScheduleSpecies(double time, const std::string &name,
+                            int copy_number) {
+  SchedulePerturbation({time, name, false, static_cast<double>(copy_number)});
+  Define([=](Model &model) { model.ScheduleSpecies(time, name, copy_number); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(SCHEDULE_SPECIES);
+           writer.Write(time);
+           writer.Write(name);
+           writer.Write<int32_t>(copy_number);
+         });
+}
+
+void Model::ScheduleParameter(double time, const std::string &name,
+                              double value) {
+  if (!(value >= 0)) {
+    throw std::invalid_argument("Parameter '" + name +
+                                "' cannot be negative.");
+  }
+  // Looking up the current value also checks the name
+  double current = AccessParameter(name, nullptr);
+  SchedulePerturbation({time, name, true, value});
+  perturbed_parameters_.emplace(name, current);
+  Define([=](Model &model) { model.ScheduleParameter(time, name, value); },
+         [=](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(SCHEDULE_PARAMETER);
+           writer.Write(time);
+           writer.Write(name);
+           writer.Write(value);
+         });
+}
+
+void Model::SchedulePerturbation(const Perturbation &perturbation) {
+  if (!(perturbation.time >= 0) || !std::isfinite(perturbation.time)) {
+    throw std::invalid_argument(
+        "Scheduled changes need a finite, non-negative time.");
+  }
+  if (initialized_) {
+    throw std::runtime_error(
+        "Changes must be scheduled before the model is simulated.");
+  }
+  auto position = std::upper_bound(
+      perturbations_.begin(), perturbations_.end(), perturbation.time,
+      [](double time, const Perturbation &other) { return time < other.time; });
+  perturbations_.insert(position, perturbation);
 }
 
-void Model::CountTermination(const std::string &name) {
-  auto new_name = name + "_total";
-  if (terminations_.count(name) == 0) {
-    terminations_[new_name] = 1;
+void Model::ApplyPerturbation(const Perturbation &perturbation) {
+  if (perturbation.parameter) {
+    AccessParameter(perturbation.name, &perturbation.value);
   } else {
-    terminations_[new_name]++;
+    tracker_->Increment(perturbation.name,
+                        static_cast<int>(perturbation.value));
+  }
+}
+
+void Model::RestorePerturbedParameters(int made) {
+  for (const auto &base : perturbed_parameters_) {
+    auto it = parameters_.find(base.first);
+    double value = it != parameters_.end() ? it->second : base.second;
+    AccessParameter(base.first, &value);
+  }
+  for (int i = 0; i < made; i++) {
+    if (perturbations_[i].parameter) {
+      ApplyPerturbation(perturbations_[i]);
+    }
+  }
+}
+
+double Model::AccessParameter(const std::string &name, const double *value) {
+  std::size_t dot = name.rfind('.');
+  std::string owner = name.substr(0, dot);
+  std::string field = dot == std::string::npos ? "" : name.substr(dot + 1);
+  if (field == "rate") {
+    auto it = named_reactions_.find(owner);
+    if (it != named_reactions_.end()) {
+      if (value) {
+        it->second->rate_constant(*value);
+        gillespie_.MarkDirty(it->second);
+      }
+      return it->second->rate_constant();
+    }
+  }
+  if (field == "speed") {
+    std::string pol_name = owner == "ribosome" ? "__ribosome" : owner;
+    for (auto &pol : polymerases_) {
+      if (pol.name() != pol_name) {
+        continue;
+      }
+      if (value) {
+        pol.speed(*value);
+        for (const auto &reaction : reactions_) {
+          auto bind = std::dynamic_pointer_cast<BindPolymerase>(reaction);
+          if (bind && bind->pol_template().name() == pol_name) {
+            bind->speed(*value);
+          }
+        }
+      }
+      return pol.speed();
+    }
+  }
+  // Binding rate constants are looked up in the polymers' definitions and
+  // set on the binding reactions, which only exist once initialized
+  std::string site = field == "rbs" ? "__" + owner + "_rbs" : owner;
+  std::string element = field == "rbs" ? "__ribosome" : field;
+  std::vector<const std::map<std::string, std::map<std::string, double>> *>
+      bindings;
+  for (const auto &genome : genomes_) {
+    bindings.push_back(&genome->bindings());
+  }
+  for (const auto &transcript : transcripts_) {
+    bindings.push_back(&transcript->bindings());
+  }
+  for (const auto *polymer : bindings) {
+    auto it = polymer->find(site);
+    if (it == polymer->end() || it->second.count(element) == 0) {
+      continue;
+    }
+    if (value) {
+      for (const auto &reaction : reactions_) {
+        auto bind = std::dynamic_pointer_cast<BindPolymerase>(reaction);
+        if (bind && bind->promoter_name() == site &&
+            bind->pol_template().name() == element) {
+          bind->rate_constant(*value);
+          gillespie_.MarkDirty(bind);
+        }
+      }
+    }
+    return it->second.at(element);
+  }
+  // Terminator efficiencies are properties of the genomes' sites
+  bool found = false;
+  double current = 0;
+  for (const auto &genome : genomes_) {
+    for (const auto &interval : genome->GetReleaseIntervals()) {
+      const auto &terminator = interval.value;
+      if (terminator->name() != owner ||
+          !terminator->CheckInteraction(element, -1)) {
+        continue;
+      }
+      if (value) {
+        terminator->efficiency(element, *value);
+      }
+      found = true;
+      current = terminator->efficiency(element);
+    }
+  }
+  if (!found) {
+    throw std::invalid_argument("Model has no parameter named '" + name +
+                                "'.");
   }
+  return current;
 }
@@ -3,11 +3,60 @@
 #ifndef SRC_SIMULATION_HPP  // header guard
 #define SRC_SIMULATION_HPP
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 
+#include "dependency_graph.hpp"
+#include "equilibrium.hpp"
 #include "gillespie.hpp"
+#include "placement.hpp"
 #include "polymer.hpp"
 #include "reaction.hpp"
+#include "snapshot.hpp"
+#include "stop_condition.hpp"
+
+class CheckpointReader;
+class CheckpointWriter;
+struct CountsTable;
+class CountsWriter;
+class SteadyState;
+class Model;
+
+/**
+ * Frozen definition of a Model (species, polymerases, reactions, genomes,
+ * transcripts and options), from which any number of independent models
+ * can be instantiated, e.g. one per replicate of an ensemble. Instantiated
+ * models reference this definition instead of copying it, and their
+ * genomes and transcripts share element properties and translation
+ * weights with it, so each one only holds its own simulation state.
+ */
+class CompiledModel : public std::enable_shared_from_this<CompiledModel> {
+ public:
+  typedef std::shared_ptr<const CompiledModel> Ptr;
+  /**
+   * Create an unseeded model in its initial state. Thread-safe.
+   */
+  std::shared_ptr<Model> Instantiate() const;
+
+ private:
+  friend class Model;
+  CompiledModel(double cell_volume,
+                std::vector<std::function<void(Model &)>> definition,
+                std::vector<std::function<void(CheckpointWriter &)>> calls);
+  const double cell_volume_;
+  /**
+   * Calls that define the model, replayed by Instantiate().
+   */
+  const std::vector<std::function<void(Model &)>> definition_;
+  /**
+   * Functions that serialize each of those calls (see
+   * Model::SaveDefinition).
+   */
+  const std::vector<std::function<void(CheckpointWriter &)>> calls_;
+};
 
 /**
  * Coordinate polymers and species-level reactions.
@@ -18,16 +67,488 @@ class Model : public std::enable_shared_from_this<Model> {
    * Construct a simulation
    */
   Model(double cell_volume);
+  /**
+   * Release reactions and polymers held by this model's tracker.
+   */
+  ~Model();
   /**
    * Run the simulation until the given time point and write output to a file.
+   * A model that has been simulated before continues from where it stopped,
+   * and when it writes to the same file in the same format as the previous
+   * call, the new time points are appended to it, so running in several
+   * steps gives the same output as one call. The file is complete when this
+   * returns. With run-ahead, skipping blocked moves or mean-field
+   * translation, whose events can be far apart, the counts are those at
+   * exactly each time point, as for SimulateAt, rather than those of the
+   * first event past it.
    *
    * @param prefix for output files
+   * @param method name of the reaction selection method: "direct" (tree-based
+   *  direct method), "direct_linear" (linear scan), "composition_rejection",
+   *  "next_reaction" (Gibson-Bruck next reaction method), or "hybrid"
+   *  (tau-leaping for high copy-number species reactions)
+   * @param format output format: "tsv" (tab-separated text), "binary"
+   *  (packed records, see BinaryCountsWriter), "binary_delta" (packed
+   *  records of the counts that changed) or "hdf5" (see Hdf5Store; only if
+   *  built with PINETREE_HDF5)
+   */
+  void Simulate(int time_limit, int time_step, const std::string &output,
+                const std::string &method, const std::string &format);
+  /**
+   * Run the simulation until the given time point and return counts in
+   * memory instead of writing them to a file.
+   *
+   * @param method name of the reaction selection method, as for Simulate
+   * @return table of counts at each output time point
    */
-  void Simulate(int time_limit, int time_step, const std::string &output);
+  CountsTable SimulateToTable(int time_limit, int time_step,
+                              const std::string &method);
+  /**
+   * Run the simulation until the given time point and pass counts to a
+   * writer owned by the caller, e.g. the writer of one replicate of an
+   * Hdf5Store. The writer is not closed.
+   *
+   * @param method name of the reaction selection method, as for Simulate
+   */
+  void SimulateToWriter(int time_limit, int time_step,
+                        const std::string &method, CountsWriter &writer);
+  /**
+   * Run the simulation through a list of output times and write the counts
+   * at exactly each of those times to a file. Unlike Simulate, which writes
+   * the counts of the first event past each time point, this records the
+   * state of the system at the given times, whatever their spacing.
+   *
+   * @param times output times, in non-decreasing order and no earlier than
+   *  the current simulation time
+   * @param method name of the reaction selection method, as for Simulate
+   * @param format output format, as for Simulate
+   */
+  void SimulateAt(const std::vector<double> &times, const std::string &output,
+                  const std::string &method, const std::string &format);
+  /**
+   * As SimulateAt, but return counts in memory.
+   */
+  CountsTable SimulateToTableAt(const std::vector<double> &times,
+                                const std::string &method);
+  /**
+   * Freeze the definition of this model so far (see CompiledModel). The
+   * simulation state of this model is not part of it.
+   */
+  CompiledModel::Ptr Compile() const;
+  /**
+   * Create a model with the same definition (species, polymerases,
+   * reactions, genomes and transcripts) as this one, but its own tracker,
+   * random number generator and simulation state. The clone is unseeded.
+   * Same as Compile()->Instantiate().
+   */
+  std::shared_ptr<Model> Clone() const;
+  /**
+   * Serialize the definition of this model (everything Compile() freezes,
+   * including its genomes and transcripts) into a compact binary string,
+   * e.g. to send it to other processes, or build an unseeded model in its
+   * initial state from one. Simulation state is not included; see
+   * Checkpoint for that.
+   */
+  std::string SaveDefinition() const;
+  static std::shared_ptr<Model> LoadDefinition(const std::string &definition);
+  static std::shared_ptr<Model> LoadDefinition(const char *data,
+                                               std::size_t size);
+  /**
+   * Simulate independent replicates of this model on a pool of threads.
+   * Each replicate is instantiated from one Compile() of this model, so
+   * this model is left untouched and may itself be simulated later. Worker
+   * threads take replicates one at a time as they finish, and each reuses
+   * one instance for all of its replicates by resetting it (see Reset).
+   *
+   * @param replicates number of replicates
+   * @param seeds one seed per replicate, or a single seed shared by all
+   *  replicates with replicate i using random number stream i, or empty to
+   *  seed the shared seed from std::random_device
+   * @param threads number of worker threads, or 0 to use one per hardware
+   *  thread
+   * @param run called from a worker thread with the replicate number and a
+   *  seeded clone, and should simulate it and keep its output without
+   *  changing its definition or keeping a reference to it
+   */
+  void SimulateEnsemble(int replicates, const std::vector<int> &seeds,
+                        int threads,
+                        const std::function<void(int, Model &)> &run) const;
+  /**
+   * Pin the worker threads of SimulateEnsemble and SimulateBatch to CPUs
+   * (see Placement). Each worker pins itself before it builds its model,
+   * memory pool and output, so that memory is allocated on the worker's
+   * NUMA node by first touch and stays there. Workers that cannot be
+   * pinned run unpinned. Placement is not part of the model definition.
+   *
+   * @param policy "none" (the default), "compact" or "spread"
+   * @throws std::invalid_argument for an unknown policy
+   */
+  void placement(const std::string &policy);
+  /**
+   * Simulate independent replicates of a model whose only reactions are
+   * species reactions (see SpeciesBatch), in lockstep batches of
+   * SpeciesBatch::LANES replicates on a pool of threads. Genomes and
+   * transcripts are allowed as long as nothing can ever bind to them.
+   * Replicates are seeded as for SimulateEnsemble, but draw their random
+   * numbers differently, so they follow other trajectories from the same
+   * distribution.
+   *
+   * @param times output times, as for SimulateAt
+   * @param open called from a worker thread with a replicate number, and
+   *  returns the writer that receives its counts at each output time
+   * @param close if given, called from a worker thread with each replicate
+   *  number and its writer once the writer is closed
+   * @throws std::invalid_argument if the model has reactions other than
+   *  species reactions, or stop conditions (see stop_when)
+   */
+  void SimulateBatch(
+      int replicates, const std::vector<int> &seeds, int threads,
+      const std::vector<double> &times,
+      const std::function<std::unique_ptr<CountsWriter>(int)> &open,
+      const std::function<void(int, CountsWriter &)> &close = nullptr) const;
+  /**
+   * Branch independent copies from the current state of this model, e.g.
+   * after a shared burn-in period. Each fork is a Clone() with this model's
+   * complete simulation state restored in memory, and continues from this
+   * model's current time with its own random number stream.
+   *
+   * @param forks number of forks
+   * @param seeds one seed per fork, or a single seed shared by all forks
+   *  with fork i using random number stream i, or empty to seed the shared
+   *  seed from std::random_device
+   * @return the forks, none of which have any effect on this model
+   */
+  std::vector<std::shared_ptr<Model>> Fork(int forks,
+                                           const std::vector<int> &seeds);
+  /**
+   * Split the free copies of every species (see
+   * SpeciesTracker::free_species) between this model and a fork of it, as
+   * at cell division: each copy stays with probability 1/2 and otherwise
+   * goes to the fork, drawn from this model's random numbers. Binding
+   * sites, polymers and the elements bound to them are left as they are,
+   * so both models keep them.
+   *
+   * @param daughter model with the same state as this one
+   */
+  void PartitionSpecies(Model &daughter);
+  /**
+   * Write the complete simulation state to a file: the clock and reaction
+   * propensities, species counts, every polymer with its bound elements,
+   * mask and site states, and the random number generator. The model
+   * definition itself is not saved.
+   *
+   * @param path path of checkpoint file, which is overwritten
+   */
+  void Checkpoint(const std::string &path);
+  /**
+   * Restore the state written by Checkpoint. This model must have the same
+   * definition as the one that was checkpointed and must not have been
+   * simulated yet. Simulating it afterwards continues exactly where the
+   * checkpointed model left off.
+   *
+   * @param path path of checkpoint file
+   */
+  void Restore(const std::string &path);
+  /**
+   * Return this model to the state it was initialized in (species counts,
+   * pristine genomes and transcripts, no transcripts built yet, time 0)
+   * and seed it, keeping every polymer and reaction object, so that another
+   * replicate can be simulated without building the model again. A model
+   * that has not been initialized is only seeded.
+   *
+   * @param seed seed value
+   * @param stream stream number, as for seed()
+   * @throws std::runtime_error if recording occupancy or an event trace
+   */
+  void Reset(int seed, int stream = 0);
+  /**
+   * Save or restore the simulation state, as for Checkpoint and Restore.
+   */
+  void Save(CheckpointWriter &writer);
+  void Load(CheckpointReader &reader);
   /**
    * Set a seed for random number generator.
+   *
+   * @param seed seed value
+   * @param stream stream number; replicates that share a seed but use
+   *  different streams draw independent random numbers
+   */
+  void seed(int seed, int stream = 0);
+  /**
+   * Set how often all propensities are resummed exactly, to stop rounding
+   * error from accumulating in very long simulations.
+   *
+   * @param events number of events between resummations, or 0 to disable
+   */
+  void resummation_interval(int events);
+  /**
+   * Only report species matching one of the given names or wildcard patterns
+   * in output (see SpeciesTracker::output_species).
+   *
+   * @param patterns names or patterns, or empty to report all species
+   */
+  void output_species(const std::vector<std::string> &patterns);
+  /**
+   * Also report cumulative counts of the proteins and transcripts made of
+   * each gene as "<gene>_total", and of completed transcripts as
+   * "transcript_total" (see SpeciesTracker::record_totals).
+   *
+   * @param enabled whether to count totals
+   */
+  void record_totals(bool enabled);
+  /**
+   * Write each count as its average over the interval since the previous
+   * output time point, weighted by the time it held each value, and its
+   * minimum and maximum over the interval as "<name>_min" and "<name>_max"
+   * (see SpeciesTracker::time_buckets), so that coarse output does not
+   * alias dynamics faster than the time step. The first time point reports
+   * the initial counts. Stop conditions and steady state detection still
+   * see the current counts.
+   *
+   * @param enabled whether to write interval statistics
+   */
+  void time_buckets(bool enabled);
+  /**
+   * Encode and write output files on a background thread, so that the
+   * simulation only waits for output when the buffer of pending time points
+   * is full (see AsyncCountsWriter).
+   *
+   * @param enabled whether to write output asynchronously
+   */
+  void async_output(bool enabled);
+  /**
+   * Let polymerases, ribosomes and RNases take long stretches of moves that
+   * change no propensity in one scheduled event (see Polymer::run_ahead),
+   * so that e.g. an RNase degrading an unoccupied transcript tail reaches
+   * the next binding site in one event. The trajectories have the same
+   * distribution as without it. Runs are not taken on polymers recording
+   * occupancy or traces.
+   *
+   * @param enabled whether elements run ahead
+   */
+  void run_ahead(bool enabled);
+  /**
+   * Let ribosomes step a codon at a time, at a third of the rate, so that
+   * translation takes a third of the events (see Polymer::codon_steps).
+   *
+   * @param enabled whether ribosomes step by codon
+   */
+  void codon_steps(bool enabled);
+  /**
+   * Give elements blocked by the element or mask ahead of them a
+   * propensity of 0 until they can move again, instead of spending events
+   * on moves that change nothing (see Polymer::skip_blocked). The
+   * trajectories have the same distribution as without it.
+   *
+   * @param enabled whether blocked elements wait
+   */
+  void skip_blocked(bool enabled);
+  /**
+   * Simulate each trajectory on several threads (experimental). Time is cut
+   * into windows of a given length. In each window, species and binding
+   * reactions are first simulated exactly while polymers stand still, and
+   * then the elements on every polymer move over the same window, with each
+   * genome and the transcripts it built simulated by one thread. Changes
+   * that moves make to shared counts (free polymerases and ribosomes,
+   * uncovered promoters, proteins) only affect other reactions from the
+   * next window on, so the window length is the accuracy knob: the error
+   * shrinks with it, and windows much shorter than the time an element
+   * takes to clear its binding site give the serial distribution. With more
+   * than one thread, these shared changes are applied in the order the
+   * threads make them, so trajectories are only reproducible from the seed
+   * on a single thread. Cannot be combined with run-ahead, occupancy or
+   * traces.
+   *
+   * @param threads number of threads, or 0 to simulate serially
+   * @param window length of each window in seconds
+   */
+  void parallel(int threads, double window);
+  /**
+   * Treat fast reversible pairs of species reactions, A + B <-> C or
+   * A <-> C, as being in partial equilibrium (see PartialEquilibrium). When
+   * the model is initialized, a pair whose two propensities add up to at
+   * least the given multiple of the total propensity of all other species
+   * reactions is taken out of the simulation, and its species are redrawn
+   * from their equilibrium distribution after every other species or
+   * binding event and after any move that changes them. This is an
+   * approximation, which is good while the pair stays
+   * much faster than the reactions it is compared with.
+   *
+   * @param ratio multiple of the other propensities a pair needs to reach,
+   *  or 0 to simulate every reaction exactly
+   * @throws std::runtime_error if the model has already been simulated
+   */
+  void partial_equilibrium(double ratio);
+  /**
+   * End each run early once the counts of the output species have become
+   * stationary (see SteadyState), testing the last two windows of output
+   * time points at every output time. The time of the output point at
+   * which the run stopped is returned by steady_state_time() and written
+   * into the output as "steady_state_time" (see CountsWriter::
+   * WriteMetadata). Every call to a Simulate method starts detecting
+   * afresh, so a run that is continued by another call does not stop
+   * before two more windows have been written.
+   *
+   * @param window number of output time points in each window, at least 2,
+   *  or 0 to always run to the end
+   * @param tolerance largest relative change of a mean count between
+   *  windows allowed beyond the statistical error
+   */
+  void steady_state(int window, double tolerance);
+  /**
+   * End each run as soon as a condition on species, transcript or ribosome
+   * counts holds (see StopCondition), e.g. "gp10A >= 5000". Conditions
+   * added by several calls end a run when any of them holds. Only events
+   * that change a name in a condition cause it to be evaluated, and runs
+   * in parallel windows (see parallel) check at the end of each window. A
+   * condition that already holds when a run starts stops it immediately.
+   * The clause that held and the time are returned by stop_condition() and
+   * stop_time(), and written into the output as "stop_time" and
+   * "stop_condition", the index of the clause in the order added (see
+   * CountsWriter::WriteMetadata).
+   *
+   * @param expression condition to add, or empty to remove every condition
+   * @throws std::invalid_argument if the expression is malformed
+   */
+  void stop_when(const std::string &expression);
+  /**
+   * Give each reaction a random number stream of its own for its waiting
+   * times (see Gillespie::common_random_numbers), so that paired runs from
+   * the same seed at nearby parameter values stay correlated. Requires the
+   * next_reaction method. Choices made inside a polymer, e.g. which element
+   * moves, and which polymer an element binds still draw from the shared
+   * sequence of the model's generator.
+   *
+   * @throws std::runtime_error if the model has already been simulated
+   */
+  void common_random_numbers(bool enabled);
+  /**
+   * Draw random numbers from a faster generator than the default Mersenne
+   * Twister (see Random::fast). Seeded runs give different trajectories
+   * than with the default generator, but the same ones from run to run.
+   *
+   * @param enabled whether to use the faster generator
+   */
+  void fast_random(bool enabled);
+  /**
+   * Estimate the heap memory held by this model, broken down by subsystem
+   * with the number of live objects of each (see MemoryReport).
+   */
+  MemoryReport memory_report() const;
+  /**
+   * Analyze the graph of species and the reactions that read and write them
+   * (see DependencyGraph::Analyze), initializing the model if needed.
+   * Reactions read the species whose changes recompute their propensities
+   * in the tracker. Species reactions write their reactants and products,
+   * binding reactions their promoter and element, and each polymer the
+   * sites it covers and uncovers, the elements it releases and, for
+   * genomes, the transcripts and proteins of its genes and their RNase
+   * sites. Scheduled changes are left out, since they happen at fixed
+   * times.
+   *
+   * @param partitions number of partitions to split the components into
+   * @param hub_fraction fraction of reactions a hub species is used by
+   */
+  DependencyReport dependency_report(int partitions = 1,
+                                     double hub_fraction = 0.1);
+  /**
+   * Sample memory_report into the output after every time point, as
+   * metadata "memory_<subsystem>" and "memory_total" in bytes. Each sample
+   * visits every polymer, so this slows down runs with frequent output.
+   *
+   * @param enabled whether to sample memory
    */
-  void seed(int seed);
+  void memory_sampling(bool enabled);
+  /**
+   * Report progress while simulating by periodically calling a function
+   * with the current simulation time and the number of events executed per
+   * second of wall time since the previous report. Reports are not part of
+   * the model definition, so clones and replicates do not make them.
+   *
+   * @param callback function to call, or an empty function to stop reporting
+   * @param interval minimum wall time in seconds between reports
+   */
+  void progress(std::function<void(double, double)> callback,
+                double interval);
+  /**
+   * Ask the run in progress, or the next one to start, to stop before its
+   * next event. May be called from any thread. The stopped run returns
+   * normally with its output flushed, and the model can be simulated
+   * further from where it stopped.
+   */
+  void Cancel();
+  /**
+   * Start recording time-averaged occupancy of polymerases, ribosomes and
+   * RNases at each position of every polymer (see OccupancyProfiles).
+   * Transcripts are aggregated under the name of the genome that made them.
+   */
+  void RecordOccupancy();
+  /**
+   * @return occupancy recorded so far by polymer name, element name and
+   *  position, or nothing if RecordOccupancy has not been called
+   */
+  OccupancyProfiles::Averages occupancy() const;
+  /**
+   * Also record how long elements dwell at each position before moving on,
+   * starting occupancy recording if needed (see
+   * OccupancyProfiles::RecordDwellTimes).
+   *
+   * @param min_time upper edge of the first bin
+   * @param max_time lower edge of the last bin
+   * @param bins total number of bins
+   */
+  void RecordDwellTimes(double min_time, double max_time, int bins);
+  /**
+   * @return dwell time counts by polymer name, element name, and then
+   *  position and bin, or nothing if RecordDwellTimes has not been called
+   */
+  OccupancyProfiles::Averages dwell_times() const;
+  /**
+   * @return edges of the dwell time bins
+   */
+  std::vector<double> dwell_edges() const;
+  /**
+   * Start recording the movements of mobile elements on every polymer to a
+   * binary event trace (see EventTrace). Clones of this model are not
+   * traced.
+   *
+   * @param path trace file to write
+   * @throws std::runtime_error if built without PINETREE_TRACE
+   */
+  void Trace(const std::string &path);
+  /**
+   * Stop recording the event trace and close its file.
+   */
+  void StopTrace();
+  /**
+   * Report the events of the simulation to an observer, e.g. a custom
+   * measurement written in C++ (see Observer). Observers are not part of
+   * the model definition, so clones and replicates do not report to them.
+   * Elements do not run ahead while observers are registered, so that every
+   * move is reported.
+   *
+   * @param observer observer to add
+   */
+  void AddObserver(Observer::Ptr observer);
+  /**
+   * Stop reporting to every observer.
+   */
+  void RemoveObservers();
+  /**
+   * Start writing the positions of every polymerase, ribosome and RNase on
+   * every polymer to a binary file at each output time (see
+   * PolymerSnapshots), replacing any snapshot file being written. Clones of
+   * this model do not write snapshots. Elements running ahead are brought
+   * up to date for each snapshot, which draws random numbers, so runs
+   * with run-ahead follow another trajectory than without snapshots.
+   *
+   * @param path snapshot file to write
+   */
+  void RecordSnapshots(const std::string &path);
+  /**
+   * Stop writing snapshots and close their file.
+   */
+  void StopSnapshots();
   /**
    * Add species to simulation.
    *
@@ -59,16 +580,23 @@ class Model : public std::enable_shared_from_this<Model> {
    * @param rate_constant macroscopic rate constant of reaction
    * @param reactants vector of reactant names
    * @param products vector of product names
+   * @param name name of the reaction for its "<name>.rate" parameter (see
+   *  parameter), or empty
    */
   void AddReaction(double rate_constant,
                    const std::vector<std::string> &reactants,
-                   const std::vector<std::string> &products);
+                   const std::vector<std::string> &products,
+                   const std::string &name = "");
   /**
-   * Add a genome to the list of reactions.
+   * Add a genome to the list of reactions. Further copies of the genome
+   * share its transcript layouts (see Genome::Copy), and all copies share
+   * one binding reaction per promoter and polymerase, so neither grows with
+   * the copy number.
    *
    * @param genome pointer to Genome object
+   * @param copies number of copies of the genome in the cell
    */
-  void RegisterGenome(Genome::Ptr genome);
+  void RegisterGenome(Genome::Ptr genome, int copies = 1);
   /**
    * Add a transcript to the list of reactions.
    *
@@ -77,14 +605,128 @@ class Model : public std::enable_shared_from_this<Model> {
   void RegisterTranscript(Transcript::Ptr transcript);
   void Initialize();
   /**
-   * Record when a polymerase reaches a terminator so that we can track total
-   * quantity of a species synthesized during simulation.
+   * Set a rate parameter by name without rebuilding the model, for example
+   * between replicates of a parameter sweep. Only the propensities of
+   * reactions that depend on the parameter are recomputed. Names are:
+   *  - "<promoter>.<polymerase>": binding rate constant of a promoter
+   *  - "<gene>.rbs": ribosome binding strength of a gene
+   *  - "<terminator>.<polymerase>": efficiency of a terminator
+   *  - "<polymerase>.speed" or "ribosome.speed": mean speed, truncated to
+   *    whole bp/s as in AddPolymerase, of elements that bind from then on
+   *  - "<reaction>.rate": rate constant of a named species reaction
+   * Values set are part of the model definition, so clones and replicates
+   * compiled afterwards use them, and Reset keeps them. Checkpoints do not
+   * record them.
    *
-   * TODO: Move to species tracker.
+   * @param name name of the parameter
+   * @param value new value, which may not be negative
+   * @throws std::invalid_argument if no parameter has this name
    */
-  void CountTermination(const std::string &name);
+  void parameter(const std::string &name, double value);
+  /**
+   * @return current value of a parameter
+   */
+  double parameter(const std::string &name);
+  /**
+   * @return value of every parameter set with parameter, by name
+   */
+  const std::map<std::string, double> &parameters() const {
+    return parameters_;
+  }
+  /**
+   * Add copies of a species (or remove them, if negative) at a given time
+   * during the simulation, e.g. to model the addition of a drug. The change
+   * is made by the engine as a scheduled event at exactly that time (see
+   * Perturbations), and changes at the same time are made in the order
+   * they were scheduled. Scheduled changes are part of the model
+   * definition.
+   *
+   * @param time simulation time of the change
+   * @param name name of species, which need not exist yet
+   * @param copy_number number of copies to add
+   * @throws std::invalid_argument if time is negative or not finite
+   * @throws std::runtime_error if the model has already been simulated, or
+   *  when the change is made if it would leave a negative count
+   */
+  void ScheduleSpecies(double time, const std::string &name, int copy_number);
+  /**
+   * Set a parameter (see parameter) at a given time during the simulation,
+   * e.g. to switch on a promoter whose binding rate was 0. Unlike a call to
+   * parameter, the change only applies from that time on in each run, and
+   * restoring a checkpoint or calling Reset restores the value in effect
+   * at that point of the simulation.
+   *
+   * @param time simulation time of the change
+   * @param name name of parameter
+   * @param value new value, which may not be negative
+   * @throws std::invalid_argument if time is negative or not finite, or no
+   *  parameter has this name
+   * @throws std::runtime_error if the model has already been simulated
+   */
+  void ScheduleParameter(double time, const std::string &name, double value);
+  /**
+   * Getters and setters.
+   */
+  std::shared_ptr<SpeciesTracker> tracker() { return tracker_; }
+  /**
+   * Current simulation time.
+   */
+  double time() const { return gillespie_.time(); }
+  const Gillespie::Stats &stats() const { return gillespie_.stats(); }
+  /**
+   * Number of reactions that can currently fire, out of all reactions.
+   */
+  int active_reactions() const { return gillespie_.active_count(); }
+  int reaction_count() const { return gillespie_.reactions().size(); }
+  const PolymerStats &polymer_stats() const { return *polymer_stats_; }
+  PartialEquilibrium::Stats equilibrium_stats() const {
+    return equilibrium_.stats(gillespie_.time());
+  }
+  /**
+   * Time at which the last run was found to be in steady state and
+   * stopped (see steady_state), or -1 if it was not.
+   */
+  double steady_state_time() const { return steady_state_time_; }
+  /**
+   * Time at which the last run was stopped by a stop condition (see
+   * stop_when), or -1 if it was not, and the text of the clause that held.
+   */
+  double stop_time() const { return stop_time_; }
+  const std::string &stop_condition() const { return stop_clause_text_; }
+  /**
+   * Wall time in seconds spent in each phase of simulation, summed over all
+   * runs of this model.
+   */
+  struct Timings {
+    /**
+     * Building reactions and computing initial propensities.
+     */
+    double initialize = 0;
+    /**
+     * Executing reactions.
+     */
+    double simulate = 0;
+    /**
+     * Writing or storing output.
+     */
+    double output = 0;
+  };
+  const Timings &timings() const { return timings_; }
 
  private:
+  friend class CompiledModel;
+  /**
+   * Species counts and lookup maps for this simulation
+   */
+  std::shared_ptr<SpeciesTracker> tracker_;
+  /**
+   * Random number generator for this simulation
+   */
+  std::shared_ptr<Random> rng_;
+  /**
+   * Memory pool for objects created during this simulation
+   */
+  MemoryPool::Ptr pool_;
   /**
    * Gillespie object
    */
@@ -110,15 +752,356 @@ class Model : public std::enable_shared_from_this<Model> {
    */
   bool initialized_ = false;
   /**
-   * Map of terminations.
+   * Next time at which counts are due to be written.
+   */
+  int output_time_ = 0;
+  /**
+   * Output file of the last call to Simulate or SimulateAt, kept open so that
+   * the next call can append to it.
+   */
+  std::unique_ptr<CountsWriter> output_;
+  std::string output_path_;
+  std::string output_format_;
+  /**
+   * Writer for an output file, reusing the open one if it has the same path
+   * and format.
+   */
+  CountsWriter &Output(const std::string &path, const std::string &format);
+  /**
+   * Close the open output file, if any.
+   */
+  void CloseOutput();
+  /**
+   * Species reactions by name.
+   */
+  std::map<std::string, SpeciesReaction::Ptr> named_reactions_;
+  /**
+   * Parameters set on this model, reapplied once binding reactions are
+   * built and after a Reset, and whether any were set since this model was
+   * instantiated from compiled_.
+   */
+  std::map<std::string, double> parameters_;
+  bool parameters_changed_ = false;
+  /**
+   * Scheduled changes (see ScheduleSpecies and ScheduleParameter) in order
+   * of time, and the reaction that makes them once the model has been
+   * initialized, or null if there are none.
+   */
+  struct Perturbation {
+    double time;
+    std::string name;
+    bool parameter;
+    /**
+     * Copies to add, or new value of a parameter.
+     */
+    double value;
+  };
+  std::vector<Perturbation> perturbations_;
+  std::shared_ptr<Perturbations> perturbation_reaction_;
+  /**
+   * Value of each parameter changed by a scheduled change when the first
+   * such change was scheduled, unless it is in parameters_.
+   */
+  std::map<std::string, double> perturbed_parameters_;
+  /**
+   * Look up a parameter and set it to a value, if given.
+   *
+   * @return the current value of the parameter
+   */
+  double AccessParameter(const std::string &name, const double *value);
+  /**
+   * Progress reporting and cancellation (see progress and Cancel).
+   */
+  std::function<void(double, double)> progress_;
+  double progress_interval_ = 1;
+  std::atomic<bool> cancelled_{false};
+  /**
+   * Placement of ensemble worker threads (see placement).
+   */
+  Placement placement_ = Placement::NONE;
+  /**
+   * Events left before Poll next reads the clock, and the wall time and
+   * event count of the last progress report.
+   */
+  int poll_countdown_ = 0;
+  std::chrono::steady_clock::time_point progress_time_;
+  long long progress_events_ = 0;
+  /**
+   * Start progress reporting for a run.
+   */
+  void StartProgress();
+  /**
+   * Report progress if due, called before every event of a run or between
+   * batches of events (see RunTo).
+   *
+   * @param events number of events executed since the last call
+   * @return true if the run has been cancelled
+   */
+  bool Poll(int events = 1);
+  /**
+   * State saved at the end of Initialize, restored by Reset, and the number
+   * of species the tracker had then.
+   */
+  std::string initial_state_;
+  int initial_species_ = 0;
+  /**
+   * Counters shared by all polymers of this model.
+   */
+  std::shared_ptr<PolymerStats> polymer_stats_;
+  Timings timings_;
+  /**
+   * Write output files on a background thread.
+   */
+  bool async_output_ = false;
+  /**
+   * Let elements run ahead on polymers.
+   */
+  bool run_ahead_ = false;
+  /**
+   * Let ribosomes step by codon.
+   */
+  bool codon_steps_ = false;
+  /**
+   * Let blocked elements wait with a propensity of 0.
+   */
+  bool skip_blocked_ = false;
+  /**
+   * Write memory reports with the output (see memory_sampling).
+   */
+  bool memory_sampling_ = false;
+  /**
+   * Multiple of the other propensities that makes a reversible pair fast
+   * (see partial_equilibrium), or 0, and the fast pairs found.
+   */
+  double equilibrium_ratio_ = 0;
+  PartialEquilibrium equilibrium_;
+  /**
+   * Window and tolerance of steady-state detection (see steady_state), or
+   * a window of 0 to run to the end, and the time the last run stopped.
+   */
+  int steady_state_window_ = 0;
+  double steady_state_tolerance_ = 0;
+  double steady_state_time_ = -1;
+  /**
+   * Conditions that end a run (see stop_when), and the time and clause
+   * that ended the last run, or -1.
+   */
+  StopCondition stop_condition_;
+  double stop_time_ = -1;
+  int stop_clause_ = -1;
+  std::string stop_clause_text_;
+  /**
+   * Threads and window length of parallel simulation (see parallel), or 0
+   * threads to simulate serially.
    */
-  std::map<std::string, int> terminations_;
+  int parallel_threads_ = 0;
+  double parallel_window_ = 0;
+  /**
+   * Lock shared by the threads of a parallel simulation (see Guard), and
+   * whether they may be running, in which case new polymers are parked.
+   */
+  std::recursive_mutex parallel_guard_;
+  bool parallel_running_ = false;
+  /**
+   * Random number generator and counters of each group of polymers that one
+   * thread moves in a window, kept for the next window.
+   */
+  std::vector<std::shared_ptr<Random>> group_rngs_;
+  std::vector<std::shared_ptr<PolymerStats>> group_stats_;
+  /**
+   * Occupancy recording, or nullptr if disabled.
+   */
+  OccupancyProfiles::Ptr occupancy_;
+  /**
+   * Start recording occupancy on a polymer, if enabled.
+   */
+  void RecordOccupancy(const Polymer::Ptr &polymer);
+  /**
+   * Event trace, or nullptr if disabled.
+   */
+  EventTrace::Ptr trace_;
+  /**
+   * Start tracing a polymer, if enabled.
+   */
+  void TracePolymer(const Polymer::Ptr &polymer);
+  /**
+   * Registered observers, or nullptr if there are none.
+   */
+  Observers::Ptr observers_;
+  /**
+   * Snapshot file, or nullptr if disabled.
+   */
+  PolymerSnapshots::Ptr snapshots_;
+  /**
+   * Reactions other than polymer wrappers, in order of creation.
+   */
+  Reaction::VecPtr reactions_;
+  /**
+   * Definition this model was instantiated from, or null.
+   */
+  CompiledModel::Ptr compiled_;
+  /**
+   * Calls that defined this model (after those of compiled_), replayed by
+   * instances of Compile().
+   */
+  std::vector<std::function<void(Model &)>> definition_;
+  /**
+   * True while CompiledModel::Instantiate replays a definition, so that the
+   * calls it replays are not recorded again.
+   */
+  bool replaying_ = false;
+  /**
+   * Functions that serialize each call in definition_.
+   */
+  std::vector<std::function<void(CheckpointWriter &)>> calls_;
+  /**
+   * Calls written by SaveDefinition.
+   */
+  enum Call : uint8_t {
+    SPECIES,
+    POLYMERASE,
+    RIBOSOME,
+    REACTION,
+    GENOME,
+    TRANSCRIPT,
+    RESUMMATION_INTERVAL,
+    OUTPUT_SPECIES,
+    ASYNC_OUTPUT,
+    RUN_AHEAD,
+    OCCUPANCY,
+    DWELL_TIMES,
+    PARAMETERS,
+    CODON_STEPS,
+    GENOME_COPIES,
+    PARALLEL,
+    PARTIAL_EQUILIBRIUM,
+    STEADY_STATE,
+    STOP_WHEN,
+    SCHEDULE_SPECIES,
+    SCHEDULE_PARAMETER,
+    COMMON_RANDOM_NUMBERS,
+    SKIP_BLOCKED,
+    FAST_RANDOM,
+    RECORD_TOTALS,
+    MEMORY_SAMPLING,
+    TIME_BUCKETS
+  };
+  /**
+   * Add a change to perturbations_ after those at the same or an earlier
+   * time.
+   */
+  void SchedulePerturbation(const Perturbation &perturbation);
+  /**
+   * Make a scheduled change.
+   */
+  void ApplyPerturbation(const Perturbation &perturbation);
+  /**
+   * Set every parameter changed by scheduled changes to the value it has
+   * after a given number of changes were made, e.g. after restoring a
+   * checkpoint.
+   *
+   * @param made number of changes made
+   */
+  void RestorePerturbedParameters(int made);
+  /**
+   * Record a call that defines this model.
+   *
+   * @param step replays the call on an instance
+   * @param call serializes the call
+   */
+  void Define(std::function<void(Model &)> step,
+              std::function<void(CheckpointWriter &)> call);
   /**
    * Add a generic polymer to the list of reactions.
    *
    * @param polymer pointer to Polymer object
    */
   void RegisterPolymer(Polymer::Ptr polymer);
+  /**
+   * Select a reaction selection method and initialize the model if it has
+   * not been simulated yet.
+   */
+  void Prepare(const std::string &method);
+  /**
+   * Restore a state written by Save into this model, initializing it first
+   * if needed.
+   */
+  void LoadState(CheckpointReader &reader);
+  /**
+   * Simulate until the given time point, passing counts to a writer every
+   * time_step seconds.
+   */
+  void Run(int time_limit, int time_step, const std::string &method,
+           CountsWriter &writer);
+  /**
+   * Simulate on this thread until a given time, stopping early if the run
+   * is cancelled or the stop condition holds. Cancellation is checked, and
+   * progress reported, between batches of events, and the stop condition
+   * only after an event that changed a watched count.
+   *
+   * @return false if the run stopped early
+   */
+  bool RunTo(double time);
+  /**
+   * @throws std::invalid_argument unless times are in non-decreasing order
+   *  and no earlier than the current simulation time
+   */
+  void CheckTimes(const std::vector<double> &times) const;
+  /**
+   * Simulate through a list of output times, passing the counts at each of
+   * them to a writer. The times must have passed CheckTimes.
+   */
+  void RunAt(const std::vector<double> &times, const std::string &method,
+             CountsWriter &writer);
+  /**
+   * Clear the result of the previous run's steady-state detection and
+   * create a detector for the next run, or return null if detection is
+   * off.
+   */
+  std::unique_ptr<SteadyState> StartSteadyState();
+  /**
+   * Clear the result of the previous run's stop conditions and watch the
+   * names they compare.
+   */
+  void StartStopCondition();
+  /**
+   * Evaluate the stop conditions if a name they compare has changed, and
+   * record the clause that holds, if any.
+   *
+   * @return true if the run should stop
+   */
+  bool Stopped();
+  /**
+   * Write the time and clause that stopped a run, if any.
+   */
+  void WriteStop(CountsWriter &writer);
+  /**
+   * Write a memory report as metadata, if memory is sampled.
+   */
+  void WriteMemory(CountsWriter &writer) const;
+  /**
+   * Simulate in parallel windows (see parallel) until a given time.
+   *
+   * @return false if the run was cancelled first
+   */
+  bool RunWindows(double until);
+  /**
+   * Park every polymer for a parallel simulation, or undo that.
+   */
+  void ParkPolymers(bool parked);
+  /**
+   * Move the elements on all polymers from one time to another, one group
+   * of polymers per thread at a time.
+   */
+  void MovePolymers(double start, double end);
+  /**
+   * Simulate the moves inside a group of polymers exactly, as if nothing
+   * else happened in the meantime.
+   *
+   * @return number of moves
+   */
+  static long long MoveGroup(const std::vector<PolymerWrapper *> &group,
+                             Random &rng, double start, double end);
 };
 
 #endif  // header guard
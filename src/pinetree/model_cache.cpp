@@ -0,0 +1,140 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "checkpoint.hpp"
+#include "mapped_file.hpp"
+#include "model_cache.hpp"
+
+/**
+ * Header of every entry, followed by its key and the model definition.
+ * Bump the version whenever the layout of an entry changes.
+ */
+static const char *MAGIC = "pinetree model cache";
+static const uint32_t VERSION = 1;
+
+/**
+ * 64-bit FNV-1a hash, continued from a previous hash.
+ */
+static std::uint64_t Hash(std::uint64_t hash, const char *data,
+                          std::size_t size) {
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * Hash the size of a value before the value, so that different splits of
+ * the same bytes into files and values hash differently.
+ */
+static std::uint64_t HashField(std::uint64_t hash, const char *data,
+                               std::size_t size) {
+  std::uint64_t length = size;
+  hash = Hash(hash, reinterpret_cast<const char *>(&length), sizeof(length));
+  return Hash(hash, data, size);
+}
+
+ModelCache::ModelCache(const std::string &directory)
+    : directory_(directory) {}
+
+std::string ModelCache::Key(const std::vector<std::string> &files,
+                            const std::vector<std::string> &values) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const auto &path : files) {
+    MappedFile file(path, "model input");
+    hash = HashField(hash, file.data(), file.size());
+  }
+  // Separate files from values
+  hash = Hash(hash, "", 1);
+  for (const auto &value : values) {
+    hash = HashField(hash, value.data(), value.size());
+  }
+  char key[17];
+  std::snprintf(key, sizeof(key), "%016llx",
+                static_cast<unsigned long long>(hash));
+  return key;
+}
+
+std::string ModelCache::path(const std::string &key) const {
+  return directory_ + "/" + key + ".ptmodel";
+}
+
+std::shared_ptr<Model> ModelCache::Load(const std::string &key) const {
+  try {
+    MappedFile file(path(key), "cached model");
+    CheckpointReader reader(file.data(), file.size());
+    std::string magic, stored_key;
+    reader.Read(magic);
+    if (magic != MAGIC || reader.Read<uint32_t>() != VERSION) {
+      return nullptr;
+    }
+    reader.Read(stored_key);
+    if (stored_key != key) {
+      return nullptr;
+    }
+    return Model::LoadDefinition(file.data() + reader.position(),
+                                 file.size() - reader.position());
+  } catch (const std::exception &) {
+    // Missing, truncated or otherwise unreadable entries are rebuilt
+    return nullptr;
+  }
+}
+
+void ModelCache::Store(const std::string &key, const Model &model) const {
+#ifdef _WIN32
+  _mkdir(directory_.c_str());
+#else
+  mkdir(directory_.c_str(), 0777);
+#endif
+  CheckpointWriter header;
+  header.Write(std::string(MAGIC));
+  header.Write<uint32_t>(VERSION);
+  header.Write(key);
+  std::string definition = model.SaveDefinition();
+  // Unique per thread and time, since jobs may store the same key at once
+  std::string temporary =
+      path(key) + ".tmp" +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+      "-" +
+      std::to_string(
+          std::chrono::steady_clock::now().time_since_epoch().count());
+  {
+    std::ofstream file(temporary, std::ios::trunc | std::ios::binary);
+    file.write(header.buffer().data(), header.buffer().size());
+    file.write(definition.data(), definition.size());
+    if (!file) {
+      std::remove(temporary.c_str());
+      throw std::runtime_error("Could not write cached model '" + path(key) +
+                               "'.");
+    }
+  }
+  if (std::rename(temporary.c_str(), path(key).c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("Could not write cached model '" + path(key) +
+                             "'.");
+  }
+}
+
+std::shared_ptr<Model> ModelCache::Get(
+    const std::string &key,
+    const std::function<std::shared_ptr<Model>()> &build) const {
+  auto model = Load(key);
+  if (model) {
+    return model;
+  }
+  auto built = build();
+  Store(key, *built);
+  return Model::LoadDefinition(built->SaveDefinition());
+}
@@ -0,0 +1,67 @@
+#ifndef SRC_MODEL_CACHE_HPP  // header guard
+#define SRC_MODEL_CACHE_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model.hpp"
+
+/**
+ * Directory of model definitions (see Model::SaveDefinition) keyed by a hash
+ * of the inputs they were built from, e.g. a GenBank file and the
+ * parameters applied to it, so that repeated runs skip parsing and building
+ * the model. Entries are memory-mapped when loaded and start with a
+ * versioned header, so entries written by another version of pinetree are
+ * ignored and rebuilt.
+ *
+ * The key must cover every input of the build: a cached model is reused
+ * whenever its key matches, whatever the build would do.
+ */
+class ModelCache {
+ public:
+  /**
+   * @param directory directory holding the entries, created when the first
+   *  entry is stored
+   */
+  explicit ModelCache(const std::string &directory);
+  /**
+   * Hash of the contents of files and of other values (e.g. parameters
+   * formatted as text), as 16 hexadecimal digits.
+   *
+   * @throws std::runtime_error if a file cannot be read
+   */
+  static std::string Key(const std::vector<std::string> &files,
+                         const std::vector<std::string> &values);
+  /**
+   * Model with a given key, unseeded and in its initial state, or nullptr
+   * if there is no readable entry for it.
+   */
+  std::shared_ptr<Model> Load(const std::string &key) const;
+  /**
+   * Store the definition of a model under a key, replacing any entry for
+   * it. The entry is written to a temporary file and renamed, so that
+   * concurrent jobs never load a partial one.
+   *
+   * @throws std::runtime_error if the entry cannot be written
+   */
+  void Store(const std::string &key, const Model &model) const;
+  /**
+   * Load the model with a given key, or build it and store it if there is
+   * none. The model returned is unseeded either way, since a built model is
+   * replaced by the one loaded from its definition.
+   */
+  std::shared_ptr<Model> Get(
+      const std::string &key,
+      const std::function<std::shared_ptr<Model>()> &build) const;
+  /**
+   * Path of the entry for a key.
+   */
+  std::string path(const std::string &key) const;
+
+ private:
+  std::string directory_;
+};
+
+#endif  // header guard
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "model_file.hpp"
+
+ModelFile ModelFile::Load(const std::string &path) {
+  std::ifstream input(path);
+  if (!input) {
+    throw std::runtime_error("Could not open model file '" + path + "'.");
+  }
+  return Parse(input, path);
+}
+
+ModelFile ModelFile::Parse(std::istream &input, const std::string &name) {
+  ModelFile file;
+  std::size_t slash = name.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    file.directory_ = name.substr(0, slash + 1);
+  }
+  try {
+    YamlNode root = ParseYaml(input);
+    if (!root.IsMapping()) {
+      throw std::runtime_error("line 1: expected a model description.");
+    }
+    file.Build(root);
+  } catch (const std::runtime_error &error) {
+    throw std::runtime_error(name + ": " + error.what());
+  }
+  return file;
+}
+
+/**
+ * Map polymerase names to one parameter of their interactions with an
+ * element, e.g. the binding_constant of "interactions: {rnapol:
+ * {binding_constant: 2e8}}".
+ */
+static std::map<std::string, double> Interactions(const YamlNode &element,
+                                                  const std::string &key) {
+  std::map<std::string, double> interactions;
+  if (!element.Has("interactions")) {
+    return interactions;
+  }
+  for (const auto &entry : element["interactions"].entries()) {
+    interactions[entry.first] = entry.second.IsScalar()
+                                    ? entry.second.AsDouble()
+                                    : entry.second[key].AsDouble();
+  }
+  return interactions;
+}
+
+/**
+ * Value of an optional numeric key of a mapping.
+ */
+static double Optional(const YamlNode &node, const std::string &key,
+                       double fallback) {
+  return node.Has(key) && !node[key].IsNone() ? node[key].AsDouble()
+                                              : fallback;
+}
+
+/**
+ * Optional list under a key of a mapping, empty if it is missing.
+ */
+static const YamlNode &List(const YamlNode &root, const std::string &key) {
+  static const YamlNode empty(YamlNode::SEQUENCE);
+  if (!root.Has(key) || root[key].IsNone()) {
+    return empty;
+  }
+  root[key].items();  // fail early if this is not a list
+  return root[key];
+}
+
+AnnotationRules ModelFile::ParseRules(const YamlNode &node,
+                                     double rbs_strength) {
+  AnnotationRules rules;
+  if (node.Has("name_qualifiers")) {
+    rules.name_qualifiers = node["name_qualifiers"].AsStrings();
+  }
+  if (node.Has("codon_weights")) {
+    for (const auto &entry : node["codon_weights"].entries()) {
+      std::string codon = entry.first;
+      std::transform(codon.begin(), codon.end(), codon.begin(), ::toupper);
+      rules.codon_weights[codon] = entry.second.AsDouble();
+    }
+  }
+  rules.default_codon_weight = Optional(node, "default_codon_weight", 1.0);
+  if (node.Has("coding_type")) {
+    rules.coding_type = node["coding_type"].AsString();
+  }
+  static const std::map<std::string, AnnotationRule::Action> actions = {
+      {"promoter", AnnotationRule::PROMOTER},
+      {"terminator", AnnotationRule::TERMINATOR},
+      {"gene", AnnotationRule::GENE},
+      {"rnase_site", AnnotationRule::RNASE_SITE},
+      {"ignore", AnnotationRule::IGNORE}};
+  for (const auto &item : List(node, "rules").items()) {
+    AnnotationRule rule;
+    const std::string &element = item["element"].AsString();
+    auto action = actions.find(element);
+    if (action == actions.end()) {
+      throw std::runtime_error("line " + std::to_string(item.line()) +
+                               ": unknown element type '" + element + "'.");
+    }
+    rule.action = action->second;
+    if (item.Has("type")) {
+      rule.type = item["type"].AsString();
+    }
+    if (item.Has("match")) {
+      for (const auto &entry : item["match"].entries()) {
+        rule.match.emplace_back(entry.first,
+                                entry.second.IsSequence()
+                                    ? entry.second.AsStrings()
+                                    : std::vector<std::string>{
+                                          entry.second.AsString()});
+      }
+    }
+    if (item.Has("name")) {
+      rule.name = item["name"].AsString();
+    }
+    rule.interactions = Interactions(
+        item, rule.action == AnnotationRule::TERMINATOR ? "efficiency"
+                                                        : "binding_constant");
+    rule.min_length = item.Has("min_length") ? item["min_length"].AsInt() : 0;
+    rule.rbs_offset = item.Has("rbs") ? item["rbs"].AsInt() : -30;
+    rule.rbs_strength = Optional(item, "binding_constant", rbs_strength);
+    rule.rate = Optional(item, "rate", 0.0);
+    rules.rules.push_back(rule);
+  }
+  return rules;
+}
+
+void ModelFile::Build(const YamlNode &root) {
+  const YamlNode &simulation = root["simulation"];
+  runtime_ = simulation["runtime"].AsInt();
+  time_step_ = simulation.Has("time_step") ? simulation["time_step"].AsInt()
+                                           : 1;
+  model_ = std::make_shared<Model>(simulation["cell_volume"].AsDouble());
+  if (simulation.Has("seed")) {
+    seeds_ = {simulation["seed"].AsInt()};
+    model_->seed(seeds_[0]);
+  }
+
+  // Add components in the order of the Python model scripts
+  for (const auto &species : List(root, "species").items()) {
+    model_->AddSpecies(species["name"].AsString(),
+                       species["copy_number"].AsInt());
+  }
+  for (const auto &pol : List(root, "polymerases").items()) {
+    model_->AddPolymerase(pol["name"].AsString(), pol["footprint"].AsInt(),
+                          pol["speed"].AsDouble(),
+                          pol["copy_number"].AsInt());
+  }
+  const YamlNode &ribosomes = List(root, "ribosomes");
+  if (ribosomes.size() > 1) {
+    throw std::runtime_error("line " + std::to_string(ribosomes[1].line()) +
+                             ": only one kind of ribosome is supported.");
+  }
+  double rbs_strength = 0.0;
+  if (ribosomes.size() == 1) {
+    const YamlNode &ribosome = ribosomes[0];
+    model_->AddRibosome(ribosome["footprint"].AsInt(),
+                        ribosome["speed"].AsDouble(),
+                        ribosome["copy_number"].AsInt());
+    rbs_strength = ribosome["binding_constant"].AsDouble();
+  }
+  for (const auto &reaction : List(root, "reactions").items()) {
+    model_->AddReaction(
+        reaction["propensity"].AsDouble(),
+        List(reaction, "reactants").AsStrings(),
+        List(reaction, "products").AsStrings(),
+        reaction.Has("name") ? reaction["name"].AsString() : std::string());
+  }
+
+  if (!root.Has("genome")) {
+    return;
+  }
+  const YamlNode &genome_node = root["genome"];
+  auto genome = BuildGenome(genome_node, List(root, "elements"), rbs_strength);
+  int copies = genome_node.Has("copy_number")
+                   ? genome_node["copy_number"].AsInt()
+                   : 1;
+  model_->RegisterGenome(genome, copies);
+}
+
+Genome::Ptr ModelFile::BuildGenome(const YamlNode &genome_node,
+                                   const YamlNode &elements,
+                                   double rbs_strength) {
+  AnnotationFile annotations;
+  AnnotationRules rules;
+  bool annotated = genome_node.Has("annotations");
+  if (annotated) {
+    const YamlNode &node = genome_node["annotations"];
+    std::string path = node["file"].AsString();
+    if (path[0] != '/') {
+      path = directory_ + path;
+    }
+    annotations = AnnotationFile::Load(path);
+    rules = ParseRules(node, rbs_strength);
+  }
+  int length = annotations.length;
+  for (const auto &element : elements.items()) {
+    length = std::max(length, element["stop"].AsInt());
+  }
+  if (genome_node.Has("length")) {
+    length = genome_node["length"].AsInt();
+  }
+  if (length <= 0) {
+    throw std::runtime_error("line " + std::to_string(genome_node.line()) +
+                             ": genome needs a length or elements.");
+  }
+  auto genome = std::make_shared<Genome>(
+      annotated && !genome_node.Has("name") ? annotations.name
+                                            : genome_node["name"].AsString(),
+      length,
+      Optional(genome_node, "transcript_degradation_rate_ext", 0.0),
+      Optional(genome_node, "rnase_speed", 0.0),
+      Optional(genome_node, "rnase_footprint", 0.0),
+      Optional(genome_node, "transcript_degradation_rate", 0.0));
+  if (genome_node.Has("entered")) {
+    genome->AddMask(genome_node["entered"].AsInt() + 1,
+                    List(genome_node, "mask_interactions").AsStrings());
+  }
+  if (annotated) {
+    rules.Apply(annotations, *genome);
+  }
+  for (const auto &element : elements.items()) {
+    const std::string &type = element["type"].AsString();
+    const std::string &name = element["name"].AsString();
+    int start = element["start"].AsInt();
+    int stop = element["stop"].AsInt();
+    if (type == "promoter") {
+      genome->AddPromoter(name, start, stop,
+                          Interactions(element, "binding_constant"));
+    } else if (type == "terminator") {
+      genome->AddTerminator(name, start, stop,
+                            Interactions(element, "efficiency"));
+    } else if (type == "transcript") {
+      int rbs = element["rbs"].AsInt();
+      genome->AddGene(name, start, stop, start + rbs, start, rbs_strength);
+    } else {
+      throw std::runtime_error("line " + std::to_string(element.line()) +
+                               ": unknown element type '" + type + "'.");
+    }
+  }
+  if (genome_node.Has("translation_weights")) {
+    genome->AddWeights(genome_node["translation_weights"].AsDoubles());
+  }
+  return genome;
+}
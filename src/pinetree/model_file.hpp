@@ -0,0 +1,98 @@
+#ifndef SRC_MODEL_FILE_HPP  // header guard
+#define SRC_MODEL_FILE_HPP
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotations.hpp"
+#include "model.hpp"
+#include "yaml.hpp"
+
+/**
+ * A model and its simulation settings read from a YAML model description,
+ * in the schema of the YAML files in tests/models:
+ *
+ *  - simulation: seed, runtime, time_step, cell_volume (and debug, which is
+ *    ignored)
+ *  - genome: name, copy_number (default 1), length (default the last stop
+ *    position of the elements), transcript_degradation_rate,
+ *    transcript_degradation_rate_ext, rnase_speed, rnase_footprint,
+ *    translation_weights (one per position), entered together with
+ *    mask_interactions to mask the genome past the first `entered` bases,
+ *    and annotations (see ParseRules) to add the features of a GenBank,
+ *    GFF3 or FASTA file
+ *  - polymerases: list of name, copy_number, speed, footprint
+ *  - ribosomes: at most one entry of name, copy_number, speed, footprint,
+ *    binding_constant (ribosome binding site strength)
+ *  - species: list of name, copy_number
+ *  - reactions: list of name, propensity (rate constant), reactants,
+ *    products
+ *  - elements: list of type (promoter, terminator or transcript), name,
+ *    start, stop, and interactions mapping polymerase names to
+ *    binding_constant (promoters) or efficiency (terminators); transcripts
+ *    have an rbs offset from their start
+ */
+class ModelFile {
+ public:
+  /**
+   * Read a model description from a file. Errors are reported as
+   * std::runtime_error with the file name and line number.
+   *
+   * @param path YAML file to read
+   */
+  static ModelFile Load(const std::string &path);
+  /**
+   * Read a model description from a stream.
+   *
+   * @param input YAML document
+   * @param name name of the document in error messages
+   */
+  static ModelFile Parse(std::istream &input,
+                         const std::string &name = "<model>");
+  /**
+   * Read the rules for the annotations of a genome:
+   *
+   *  - file: GenBank, GFF3 or FASTA file, relative to the model file
+   *  - name_qualifiers: qualifiers to name elements after, in order of
+   *    preference (default [gene, locus_tag, note])
+   *  - codon_weights: mapping of codons to their relative translation speed,
+   *    with default_codon_weight for other codons and coding_type for the
+   *    type of coding features (default CDS)
+   *  - rules: list of type, match (qualifiers mapped to a value or a list of
+   *    values), element (promoter, terminator, gene, rnase_site or ignore),
+   *    and name to rename the element; promoters and terminators have
+   *    interactions as elements do, or mapping polymerase names straight to
+   *    values, and promoters a min_length; genes have an rbs offset
+   *    (default -30) and a binding_constant; RNase sites have a rate
+   *
+   * @param node annotations mapping
+   * @param rbs_strength default binding constant of genes
+   */
+  static AnnotationRules ParseRules(const YamlNode &node,
+                                    double rbs_strength = 1e7);
+  std::shared_ptr<Model> model() const { return model_; }
+  int runtime() const { return runtime_; }
+  int time_step() const { return time_step_; }
+  /**
+   * @return the seed of the simulation section, or nothing if it has none,
+   *  as the seeds of an ensemble (see Model::SimulateEnsemble)
+   */
+  const std::vector<int> &seeds() const { return seeds_; }
+
+ private:
+  std::shared_ptr<Model> model_;
+  int runtime_ = 0;
+  int time_step_ = 1;
+  std::vector<int> seeds_;
+  /**
+   * Directory of the model file, which relative paths are resolved against.
+   */
+  std::string directory_;
+  void Build(const YamlNode &root);
+  Genome::Ptr BuildGenome(const YamlNode &genome, const YamlNode &elements,
+                          double rbs_strength);
+};
+
+#endif  // header guard
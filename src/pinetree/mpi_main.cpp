@@ -0,0 +1,272 @@
+/**
+ * Command line runner that spreads the replicates of a YAML model
+ * description (see ModelFile) over MPI ranks. Each rank simulates a
+ * contiguous block of replicates on its own threads with
+ * Model::SimulateEnsemble, and either writes every replicate to its own
+ * file or reduces summary statistics onto rank 0.
+ */
+#include <mpi.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "ensemble_stats.hpp"
+#include "model_file.hpp"
+
+static const char *USAGE =
+    "usage: mpirun pinetree_mpi [options] MODEL.yml\n"
+    "\n"
+    "Simulate replicates of a model description across MPI ranks.\n"
+    "\n"
+    "options:\n"
+    "  -n, --replicates N    number of replicates (default: one per rank)\n"
+    "  -o, --output PREFIX   replicate i writes PREFIX_i.tsv (or .bin);\n"
+    "                        default: MODEL\n"
+    "  --stats               only write the mean, variance, minimum and\n"
+    "                        maximum of every count over all replicates,\n"
+    "                        to PREFIX_stats.tsv\n"
+    "  --threads N           threads per rank (default: one per CPU)\n"
+    "  --placement POLICY    pin each rank's threads to the CPUs it may use:\n"
+    "                        none, compact (fill one NUMA node first) or\n"
+    "                        spread (take CPUs from each node in turn)\n"
+    "                        (default: none)\n"
+    "  -f, --format FORMAT   output format: tsv, binary or binary_delta\n"
+    "                        (default: tsv)\n"
+    "  -m, --method METHOD   reaction selection method, as for pinetree\n"
+    "                        (default: direct)\n"
+    "  -s, --seed SEED       seed shared by all replicates, each of which\n"
+    "                        uses its own random number stream (default:\n"
+    "                        the model's seed, or a random one)\n"
+    "  -t, --runtime TIME    override the model's runtime\n"
+    "  --time-step STEP      override the model's output time step\n"
+    "  --run-ahead           let elements take stretches of moves that\n"
+    "                        change nothing else in one event\n"
+    "  -h, --help            show this message\n";
+
+/**
+ * Parse an integer option value, throwing std::invalid_argument if it is not
+ * one.
+ */
+static int ParseInt(const std::string &option, const std::string &value) {
+  char *end = nullptr;
+  long result = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0') {
+    throw std::invalid_argument("option " + option +
+                                " expects an integer, got '" + value + "'.");
+  }
+  return static_cast<int>(result);
+}
+
+/**
+ * Write summary statistics as tab separated text, one row per time point
+ * and species.
+ */
+static void WriteSummary(const EnsembleSummary &summary,
+                         const std::string &path) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Could not open output file " + path + ".");
+  }
+  const char *measures[] = {"protein", "transcript", "ribo_density"};
+  const SummaryStats *stats[] = {&summary.protein, &summary.transcript,
+                                 &summary.ribo_density};
+  file << "time\tspecies\treplicates";
+  for (const char *measure : measures) {
+    file << "\t" << measure << "_mean\t" << measure << "_variance\t"
+         << measure << "_min\t" << measure << "_max";
+  }
+  file << "\n";
+  std::size_t columns = summary.species.size();
+  for (std::size_t row = 0; row < summary.time.size(); row++) {
+    for (std::size_t column = 0; column < columns; column++) {
+      std::size_t i = row * columns + column;
+      file << summary.time[row] << "\t" << summary.species[column] << "\t"
+           << summary.replicates[row];
+      for (const SummaryStats *measure : stats) {
+        file << "\t" << measure->mean[i] << "\t" << measure->variance[i]
+             << "\t" << measure->min[i] << "\t" << measure->max[i];
+      }
+      file << "\n";
+    }
+  }
+  if (!file) {
+    throw std::runtime_error("Could not write output file " + path + ".");
+  }
+}
+
+/**
+ * Gather the statistics of every rank onto rank 0 and merge them there.
+ */
+static void ReduceStats(EnsembleStats &stats, int rank, int ranks) {
+  CheckpointWriter writer;
+  stats.Save(writer);
+  int size = writer.buffer().size();
+  std::vector<int> sizes(ranks);
+  MPI_Gather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+  std::vector<int> offsets(ranks, 0);
+  std::string buffer;
+  if (rank == 0) {
+    for (int i = 1; i < ranks; i++) {
+      offsets[i] = offsets[i - 1] + sizes[i - 1];
+    }
+    buffer.resize(offsets[ranks - 1] + sizes[ranks - 1]);
+  }
+  MPI_Gatherv(const_cast<char *>(writer.buffer().data()), size, MPI_CHAR,
+              &buffer[0], sizes.data(), offsets.data(), MPI_CHAR, 0,
+              MPI_COMM_WORLD);
+  if (rank != 0) {
+    return;
+  }
+  for (int i = 1; i < ranks; i++) {
+    std::string part = buffer.substr(offsets[i], sizes[i]);
+    CheckpointReader reader(part);
+    EnsembleStats other(1);
+    other.Load(reader);
+    stats.Merge(other);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+  int rank, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  std::string path, output, format = "tsv", method = "direct",
+              placement = "none";
+  std::string replicates_arg, threads_arg, seed, runtime, time_step;
+  bool run_ahead = false, summarize = false;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (arg == "-h" || arg == "--help") {
+        if (rank == 0) {
+          std::cout << USAGE;
+        }
+        MPI_Finalize();
+        return 0;
+      }
+      if (arg == "--run-ahead") {
+        run_ahead = true;
+        continue;
+      }
+      if (arg == "--stats") {
+        summarize = true;
+        continue;
+      }
+      std::string *value = nullptr;
+      if (arg == "-n" || arg == "--replicates") {
+        value = &replicates_arg;
+      } else if (arg == "-o" || arg == "--output") {
+        value = &output;
+      } else if (arg == "--threads") {
+        value = &threads_arg;
+      } else if (arg == "--placement") {
+        value = &placement;
+      } else if (arg == "-f" || arg == "--format") {
+        value = &format;
+      } else if (arg == "-m" || arg == "--method") {
+        value = &method;
+      } else if (arg == "-s" || arg == "--seed") {
+        value = &seed;
+      } else if (arg == "-t" || arg == "--runtime") {
+        value = &runtime;
+      } else if (arg == "--time-step") {
+        value = &time_step;
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        throw std::invalid_argument("unknown option " + arg + ".");
+      } else if (path.empty()) {
+        path = arg;
+        continue;
+      } else {
+        throw std::invalid_argument("only one model file may be given.");
+      }
+      if (++i == argc) {
+        throw std::invalid_argument("option " + arg + " expects a value.");
+      }
+      *value = argv[i];
+    }
+    if (path.empty()) {
+      throw std::invalid_argument("no model file given.");
+    }
+  } catch (const std::invalid_argument &error) {
+    // Every rank parses the same arguments, so only one reports
+    if (rank == 0) {
+      std::cerr << "pinetree_mpi: " << error.what() << "\n\n" << USAGE;
+    }
+    MPI_Finalize();
+    return 2;
+  }
+
+  try {
+    if (output.empty()) {
+      std::size_t slash = path.find_last_of("/\\");
+      output = path.substr(slash == std::string::npos ? 0 : slash + 1);
+      output = output.substr(0, output.rfind('.'));
+    }
+    ModelFile file = ModelFile::Load(path);
+    auto model = file.model();
+    if (run_ahead) {
+      model->run_ahead(true);
+    }
+    model->placement(placement);
+    int replicates = replicates_arg.empty()
+                         ? ranks
+                         : ParseInt("--replicates", replicates_arg);
+    int threads = threads_arg.empty() ? 0 : ParseInt("--threads", threads_arg);
+    int time_limit = runtime.empty() ? file.runtime()
+                                     : ParseInt("--runtime", runtime);
+    int step = time_step.empty() ? file.time_step()
+                                 : ParseInt("--time-step", time_step);
+    // All ranks share one seed so that replicate i is the same wherever it
+    // runs
+    int shared_seed;
+    if (!seed.empty()) {
+      shared_seed = ParseInt("--seed", seed);
+    } else if (!file.seeds().empty()) {
+      shared_seed = file.seeds()[0];
+    } else {
+      shared_seed = std::random_device()();
+      MPI_Bcast(&shared_seed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+
+    int first = static_cast<long long>(replicates) * rank / ranks;
+    int last = static_cast<long long>(replicates) * (rank + 1) / ranks;
+    auto extension = format == "tsv" ? ".tsv" : ".bin";
+    EnsembleStats stats(step);
+    model->SimulateEnsemble(
+        last - first, {shared_seed}, threads,
+        [&](int i, Model &replicate_model) {
+          int replicate = first + i;
+          replicate_model.seed(shared_seed, replicate);
+          if (summarize) {
+            stats.Add(
+                replicate_model.SimulateToTable(time_limit, step, method));
+          } else {
+            replicate_model.Simulate(
+                time_limit, step,
+                output + "_" + std::to_string(replicate) + extension, method,
+                format);
+          }
+        });
+    if (summarize) {
+      ReduceStats(stats, rank, ranks);
+      if (rank == 0) {
+        WriteSummary(stats.Summary(), output + "_stats.tsv");
+      }
+    }
+  } catch (const std::exception &error) {
+    // Other ranks may be waiting on this one, so stop them all
+    std::cerr << "pinetree_mpi: rank " << rank << ": " << error.what()
+              << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  MPI_Finalize();
+  return 0;
+}
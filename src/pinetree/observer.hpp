@@ -0,0 +1,109 @@
+#ifndef SRC_OBSERVER_HPP  // header guard
+#define SRC_OBSERVER_HPP
+
+#include <memory>
+#include <vector>
+
+class MobileElement;
+class Polymer;
+class Reaction;
+
+/**
+ * Receives the events of a simulation, for custom measurements such as
+ * first-passage times or collision statistics written in C++ without
+ * patching the engine. Override the hooks of interest; the others do
+ * nothing. Register observers with Model::AddObserver.
+ *
+ * Hooks are called synchronously from inside the simulation, while the
+ * polymer or reaction is in the middle of an update, so they must not
+ * change the model. Polymers with no observers skip the hooks entirely, as
+ * they do for occupancy and stats (see Polymer::MoveElement).
+ */
+class Observer {
+ public:
+  typedef std::shared_ptr<Observer> Ptr;
+  virtual ~Observer() {}
+  /**
+   * A reaction was fired by one of the exact methods, after its changes
+   * were made. Ends of runs, timed changes and leaps are not reported.
+   */
+  virtual void OnEvent(double time, const Reaction &reaction) {}
+  /**
+   * An element bound to a polymer.
+   */
+  virtual void OnBind(double time, const Polymer &polymer,
+                      const MobileElement &element) {}
+  /**
+   * An element advanced by one position.
+   */
+  virtual void OnMove(double time, const Polymer &polymer,
+                      const MobileElement &element) {}
+  /**
+   * An element could not move because of the element ahead of it or the
+   * polymer's mask.
+   */
+  virtual void OnBlocked(double time, const Polymer &polymer,
+                         const MobileElement &element) {}
+  /**
+   * An element terminated or ran off the end of the polymer, just before
+   * it is released.
+   */
+  virtual void OnTerminate(double time, const Polymer &polymer,
+                           const MobileElement &element) {}
+  /**
+   * A transcript was degraded by RNases and is about to leave the
+   * simulation.
+   */
+  virtual void OnDegrade(double time, const Polymer &polymer) {}
+};
+
+/**
+ * The observers registered with a model, passing the current simulation
+ * time to each hook.
+ */
+class Observers {
+ public:
+  typedef std::shared_ptr<Observers> Ptr;
+  /**
+   * @param clock current simulation time, which must outlive the observers
+   */
+  explicit Observers(const double *clock) : clock_(clock) {}
+  void Add(Observer::Ptr observer) { observers_.push_back(observer); }
+  bool empty() const { return observers_.empty(); }
+  void Event(const Reaction &reaction) const {
+    for (const auto &observer : observers_) {
+      observer->OnEvent(*clock_, reaction);
+    }
+  }
+  void Bind(const Polymer &polymer, const MobileElement &element) const {
+    for (const auto &observer : observers_) {
+      observer->OnBind(*clock_, polymer, element);
+    }
+  }
+  void Move(const Polymer &polymer, const MobileElement &element) const {
+    for (const auto &observer : observers_) {
+      observer->OnMove(*clock_, polymer, element);
+    }
+  }
+  void Blocked(const Polymer &polymer, const MobileElement &element) const {
+    for (const auto &observer : observers_) {
+      observer->OnBlocked(*clock_, polymer, element);
+    }
+  }
+  void Terminate(const Polymer &polymer, const MobileElement &element) const {
+    for (const auto &observer : observers_) {
+      observer->OnTerminate(*clock_, polymer, element);
+    }
+  }
+  void Degrade(const Polymer &polymer) const {
+    for (const auto &observer : observers_) {
+      observer->OnDegrade(*clock_, polymer);
+    }
+  }
+
+ private:
+  const double *clock_;
+  std::vector<Observer::Ptr> observers_;
+};
+
+#endif  // header guard
@@ -0,0 +1,83 @@
+#include <limits>
+#include <stdexcept>
+
+#include "occupancy.hpp"
+
+OccupancyProfiles::OccupancyProfiles(const double *clock)
+    : clock_(clock), start_(*clock) {}
+
+void OccupancyProfiles::RecordDwellTimes(double min_time, double max_time,
+                                         int bins) {
+  if (!(min_time > 0 && max_time > min_time && bins >= 2)) {
+    throw std::invalid_argument(
+        "Dwell time bins need 0 < min_time < max_time and at least 2 bins.");
+  }
+  dwell_bins_ = bins;
+  dwell_min_ = min_time;
+  dwell_max_ = max_time;
+  bins_per_log_ = (bins - 2) / std::log(max_time / min_time);
+  for (auto &item : profiles_) {
+    item.second.dwell.assign(item.second.count.size() * bins, 0);
+  }
+}
+
+OccupancyProfiles::Profile &OccupancyProfiles::profile(
+    const std::string &polymer, const std::string &element, int length) {
+  Profile &profile = profiles_[std::make_pair(polymer, element)];
+  if (static_cast<int>(profile.count.size()) < length) {
+    profile.integral.resize(length, 0.0);
+    profile.count.resize(length, 0);
+    profile.since.resize(length, start_);
+    profile.dwell.resize(length * dwell_bins_, 0);
+  }
+  return profile;
+}
+
+OccupancyProfiles::Averages OccupancyProfiles::averages() const {
+  double now = *clock_;
+  double elapsed = now - start_;
+  Averages averages;
+  for (const auto &item : profiles_) {
+    const Profile &profile = item.second;
+    auto &values = averages[item.first.first][item.first.second];
+    values.resize(profile.count.size(), 0.0);
+    if (elapsed <= 0) {
+      continue;
+    }
+    // Include the time elements have spent at their current positions
+    for (std::size_t i = 0; i < values.size(); i++) {
+      values[i] = (profile.integral[i] +
+                   profile.count[i] * (now - profile.since[i])) /
+                  elapsed;
+    }
+  }
+  return averages;
+}
+
+OccupancyProfiles::Averages OccupancyProfiles::dwell_times() const {
+  Averages histograms;
+  if (dwell_bins_ == 0) {
+    return histograms;
+  }
+  for (const auto &item : profiles_) {
+    const auto &dwell = item.second.dwell;
+    histograms[item.first.first][item.first.second].assign(dwell.begin(),
+                                                           dwell.end());
+  }
+  return histograms;
+}
+
+std::vector<double> OccupancyProfiles::dwell_edges() const {
+  std::vector<double> edges;
+  if (dwell_bins_ == 0) {
+    return edges;
+  }
+  edges.push_back(0);
+  int inner = dwell_bins_ - 2;
+  edges.push_back(dwell_min_);
+  for (int i = 1; i <= inner; i++) {
+    edges.push_back(dwell_min_ * std::exp(i / bins_per_log_));
+  }
+  edges.push_back(std::numeric_limits<double>::infinity());
+  return edges;
+}
@@ -0,0 +1,166 @@
+#ifndef SRC_OCCUPANCY_HPP  // header guard
+#define SRC_OCCUPANCY_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "feature.hpp"
+
+/**
+ * Integrates the number of mobile elements at each position of a polymer
+ * over simulated time, for time-averaged occupancy profiles comparable with
+ * Ribo-seq or NET-seq data. An element is counted at its leading (stop)
+ * position. Profiles are aggregated by polymer name and element name, so
+ * that e.g. ribosome occupancy is summed over all transcripts of a genome.
+ *
+ * Optionally, the time each element spends at a position before moving on
+ * is also counted in a histogram with logarithmically spaced bins, for
+ * pausing analysis.
+ *
+ * Positions are only updated as elements enter and leave them, so
+ * recording costs a constant amount of work per movement, and histograms
+ * are allocated in full when a profile is created.
+ */
+class OccupancyProfiles {
+ public:
+  typedef std::shared_ptr<OccupancyProfiles> Ptr;
+  /**
+   * Occupancy of one kind of element on one kind of polymer, indexed by
+   * position.
+   */
+  struct Profile {
+    /**
+     * Occupancy integrated over time up to since.
+     */
+    std::vector<double> integral;
+    /**
+     * Number of elements currently at each position.
+     */
+    std::vector<int> count;
+    /**
+     * Time at which integral was last brought up to date.
+     */
+    std::vector<double> since;
+    /**
+     * Dwell time histogram of each position, with the bins of a position
+     * stored contiguously. Empty unless dwell times are recorded.
+     */
+    std::vector<uint32_t> dwell;
+  };
+  /**
+   * Time-averaged occupancy by polymer name, element name and position.
+   */
+  typedef std::map<std::string, std::map<std::string, std::vector<double>>>
+      Averages;
+  /**
+   * @param clock current simulation time, which must outlive all recording
+   */
+  explicit OccupancyProfiles(const double *clock);
+  /**
+   * Also record a histogram of dwell times at each position.
+   *
+   * @param min_time upper edge of the first bin; shorter dwell times are
+   *  counted in the first bin
+   * @param max_time lower edge of the last bin; longer dwell times are
+   *  counted in the last bin
+   * @param bins total number of bins (at least 2); all but the first and
+   *  last are logarithmically spaced between min_time and max_time
+   */
+  void RecordDwellTimes(double min_time, double max_time, int bins);
+  /**
+   * Find or create the profile of an element on a polymer.
+   *
+   * @param polymer name under which the polymer is aggregated
+   * @param element name of mobile element
+   * @param length number of positions, i.e. the polymer's last position + 1
+   */
+  Profile &profile(const std::string &polymer, const std::string &element,
+                   int length);
+  /**
+   * Record an element arriving at a position.
+   */
+  void Enter(Profile &profile, int position, MobileElement &element) {
+    Settle(profile, position);
+    profile.count[position]++;
+    element.arrival(*clock_);
+  }
+  /**
+   * Record an element moving on from a position. Elements that arrived
+   * before recording started are ignored.
+   */
+  void Leave(Profile &profile, int position, const MobileElement &element) {
+    Remove(profile, position);
+    if (dwell_bins_ > 0) {
+      double dwell = *clock_ - element.arrival();
+      if (std::isfinite(dwell)) {
+        profile.dwell[position * dwell_bins_ + DwellBin(dwell)]++;
+      }
+    }
+  }
+  /**
+   * Record an element being removed from a position without completing its
+   * dwell, e.g. because its polymer was degraded.
+   */
+  void Remove(Profile &profile, int position) {
+    Settle(profile, position);
+    if (profile.count[position] > 0) {
+      profile.count[position]--;
+    }
+  }
+  /**
+   * @return mean number of elements at each position since recording
+   *  started
+   */
+  Averages averages() const;
+  /**
+   * @return dwell time counts by polymer name, element name, and then
+   *  position and bin, flattened with the bins of a position stored
+   *  contiguously
+   */
+  Averages dwell_times() const;
+  /**
+   * @return edges of the dwell time bins, from 0 to infinity
+   */
+  std::vector<double> dwell_edges() const;
+
+ private:
+  const double *clock_;
+  /**
+   * Time at which recording started.
+   */
+  double start_;
+  std::map<std::pair<std::string, std::string>, Profile> profiles_;
+  /**
+   * Number of dwell time bins, or 0 if dwell times are not recorded, and the
+   * parameters used to find the bin of a dwell time. The first bin holds
+   * dwell times up to dwell_min_ and the last those above dwell_max_.
+   */
+  int dwell_bins_ = 0;
+  double dwell_min_ = 0;
+  double dwell_max_ = 0;
+  double bins_per_log_ = 0;
+  int DwellBin(double dwell) const {
+    if (dwell <= dwell_min_) {
+      return 0;
+    }
+    int bin =
+        1 + static_cast<int>(std::log(dwell / dwell_min_) * bins_per_log_);
+    return bin < dwell_bins_ ? bin : dwell_bins_ - 1;
+  }
+  /**
+   * Bring the integral at a position up to the current time.
+   */
+  void Settle(Profile &profile, int position) {
+    double now = *clock_;
+    profile.integral[position] +=
+        profile.count[position] * (now - profile.since[position]);
+    profile.since[position] = now;
+  }
+};
+
+#endif  // header guard
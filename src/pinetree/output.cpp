@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "output.hpp"
+
+#ifdef PINETREE_HDF5
+#include "hdf5_store.hpp"
+#endif
+
+CountsWriter::Ptr CountsWriter::Create(const std::string &format,
+                                       const std::string &path, bool async) {
+  Ptr writer;
+  if (format == "tsv") {
+    writer = Ptr(new TsvCountsWriter(path));
+  } else if (format == "binary") {
+    writer = Ptr(new BinaryCountsWriter(path));
+  } else if (format == "binary_delta") {
+    writer = Ptr(new BinaryCountsWriter(path, true));
+  } else if (format == "hdf5") {
+#ifdef PINETREE_HDF5
+    writer = Hdf5Store::Create(path, 1)->Writer(0, true);
+#else
+    throw std::invalid_argument(
+        "HDF5 output needs pinetree built with -DPINETREE_HDF5=ON.");
+#endif
+  } else {
+    throw std::invalid_argument("Unknown output format '" + format + "'.");
+  }
+  if (async) {
+    writer = Ptr(new AsyncCountsWriter(std::move(writer)));
+  }
+  return writer;
+}
+
+void CountsWriter::Write(double time, SpeciesTracker &tracker) {
+  if (tracker.time_buckets()) {
+    tracker.GatherBuckets(time, rows_);
+    WriteRows(time, rows_, tracker.bucket_names());
+    return;
+  }
+  tracker.GatherCounts(rows_);
+  WriteRows(time, rows_, tracker.names());
+}
+
+FileCountsWriter::FileCountsWriter(const std::string &path)
+    : file_(path, std::ios::trunc | std::ios::binary) {
+  if (!file_) {
+    throw std::runtime_error("Could not open output file '" + path + "'.");
+  }
+  buffer_.reserve(BUFFER_SIZE);
+}
+
+void FileCountsWriter::Flush() {
+  file_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+  file_.flush();
+}
+
+void FileCountsWriter::Close() {
+  file_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+  file_.close();
+}
+
+void FileCountsWriter::MaybeFlush() {
+  if (buffer_.size() >= BUFFER_SIZE) {
+    file_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+}
+
+TsvCountsWriter::TsvCountsWriter(const std::string &path)
+    : FileCountsWriter(path) {
+  buffer_ += "time\tspecies\tprotein\ttranscript\tribo_density\n";
+}
+
+void TsvCountsWriter::WriteRows(double time, const Rows &rows,
+                                const std::vector<std::string> &names) {
+  // Same formatting as std::to_string
+  char time_string[64];
+  std::snprintf(time_string, sizeof(time_string), "%f", time);
+  char values[192];
+  for (const auto &row : rows) {
+    std::snprintf(values, sizeof(values), "\t%f\t%f\t%f\n", row.protein,
+                  row.transcript, row.ribo_density);
+    buffer_ += time_string;
+    buffer_ += '\t';
+    buffer_ += names[row.species_id];
+    buffer_ += values;
+  }
+  MaybeFlush();
+}
+
+void TsvCountsWriter::WriteMetadata(const std::string &key, double value) {
+  char value_string[64];
+  std::snprintf(value_string, sizeof(value_string), "%f", value);
+  buffer_ += "# " + key + "=" + value_string + "\n";
+  MaybeFlush();
+}
+
+BinaryCountsWriter::BinaryCountsWriter(const std::string &path, bool delta)
+    : FileCountsWriter(path), delta_(delta) {
+  buffer_.append("PTCOUNTS", 8);
+  Append<uint32_t>(delta ? 3 : 2);
+}
+
+void BinaryCountsWriter::Write(double time, SpeciesTracker &tracker) {
+  // Interval statistics change with every event, so they are compared in
+  // full rather than gathered as changes
+  if (!delta_ || tracker.time_buckets()) {
+    CountsWriter::Write(time, tracker);
+    return;
+  }
+  if (!started_) {
+    // Changes are counted from the full record of the first time point
+    tracker.track_changes(true);
+    tracker.GatherCounts(rows_);
+  } else {
+    tracker.GatherChangedCounts(rows_);
+  }
+  WriteRows(time, rows_, tracker.names());
+}
+
+template <typename T>
+void BinaryCountsWriter::Append(const T &value) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  buffer_.append(bytes, sizeof(T));
+}
+
+void BinaryCountsWriter::WriteMetadata(const std::string &key,
+                                       double value) {
+  buffer_ += 'M';
+  Append<uint32_t>(key.size());
+  buffer_ += key;
+  Append<double>(value);
+  MaybeFlush();
+}
+
+void BinaryCountsWriter::WriteRows(double time, const Rows &rows,
+                                   const std::vector<std::string> &names) {
+  // Declare columns for species reported for the first time
+  for (const auto &row : rows) {
+    if (row.species_id >= static_cast<int>(column_of_.size())) {
+      column_of_.resize(row.species_id + 1, -1);
+    }
+    if (column_of_[row.species_id] == -1) {
+      const std::string &name = names[row.species_id];
+      column_of_[row.species_id] = column_count_;
+      buffer_ += 'S';
+      Append<uint32_t>(column_count_);
+      Append<uint32_t>(name.size());
+      buffer_ += name;
+      column_count_++;
+    }
+  }
+  if (delta_ && started_) {
+    WriteChanges(time, rows);
+    return;
+  }
+  values_.assign(3 * column_count_, 0.0);
+  for (const auto &row : rows) {
+    int column = column_of_[row.species_id];
+    values_[3 * column] = row.protein;
+    values_[3 * column + 1] = row.transcript;
+    values_[3 * column + 2] = row.ribo_density;
+  }
+  buffer_ += 'R';
+  Append<double>(time);
+  Append<uint32_t>(column_count_);
+  buffer_.append(reinterpret_cast<const char *>(values_.data()),
+                 values_.size() * sizeof(double));
+  started_ = true;
+  MaybeFlush();
+}
+
+void BinaryCountsWriter::WriteChanges(double time, const Rows &rows) {
+  // Columns declared since the last record start from 0
+  values_.resize(3 * column_count_, 0.0);
+  changed_.clear();
+  for (const auto &row : rows) {
+    int column = column_of_[row.species_id];
+    double *values = &values_[3 * column];
+    if (values[0] != row.protein || values[1] != row.transcript ||
+        values[2] != row.ribo_density) {
+      values[0] = row.protein;
+      values[1] = row.transcript;
+      values[2] = row.ribo_density;
+      changed_.push_back(column);
+    }
+  }
+  // Columns are listed in order, whichever order the rows came in
+  std::sort(changed_.begin(), changed_.end());
+  buffer_ += 'D';
+  Append<double>(time);
+  Append<uint32_t>(column_count_);
+  Append<uint32_t>(changed_.size());
+  for (int column : changed_) {
+    Append<uint32_t>(column);
+    buffer_.append(reinterpret_cast<const char *>(&values_[3 * column]),
+                   3 * sizeof(double));
+  }
+  MaybeFlush();
+}
+
+/**
+ * Wait for the other end of the ring buffer: briefly yield, then sleep, so
+ * that an idle writer thread does not compete with the simulation for CPU.
+ */
+static void Backoff(int &attempts) {
+  if (attempts++ < 16) {
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+AsyncCountsWriter::AsyncCountsWriter(Ptr writer, std::size_t capacity)
+    : writer_(std::move(writer)),
+      slots_(std::max<std::size_t>(capacity, 1)),
+      head_(0),
+      tail_(0),
+      closing_(false),
+      failed_(false) {
+  thread_ = std::thread(&AsyncCountsWriter::Drain, this);
+}
+
+AsyncCountsWriter::~AsyncCountsWriter() { Join(); }
+
+AsyncCountsWriter::Snapshot &AsyncCountsWriter::Acquire(
+    double time, const std::vector<std::string> &names) {
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  int attempts = 0;
+  while (head - tail_.load(std::memory_order_acquire) == slots_.size()) {
+    if (failed_.load(std::memory_order_acquire)) {
+      Join();
+      std::rethrow_exception(error_);
+    }
+    Backoff(attempts);
+  }
+  Snapshot &slot = slots_[head % slots_.size()];
+  slot.time = time;
+  slot.new_names.assign(names.begin() + names_sent_, names.end());
+  names_sent_ = names.size();
+  return slot;
+}
+
+void AsyncCountsWriter::Publish() {
+  head_.store(head_.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+}
+
+void AsyncCountsWriter::Write(double time, SpeciesTracker &tracker) {
+  if (tracker.time_buckets()) {
+    tracker.GatherBuckets(time, rows_);
+    WriteRows(time, rows_, tracker.bucket_names());
+    return;
+  }
+  Snapshot &slot = Acquire(time, tracker.names());
+  tracker.GatherCounts(slot.rows);
+  Publish();
+}
+
+void AsyncCountsWriter::WriteRows(double time, const Rows &rows,
+                                  const std::vector<std::string> &names) {
+  Snapshot &slot = Acquire(time, names);
+  slot.rows = rows;
+  Publish();
+}
+
+void AsyncCountsWriter::Drain() {
+  int attempts = 0;
+  while (true) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      // Check for new snapshots once more after seeing the close flag
+      if (closing_.load(std::memory_order_acquire) &&
+          tail == head_.load(std::memory_order_acquire)) {
+        return;
+      }
+      Backoff(attempts);
+      continue;
+    }
+    attempts = 0;
+    Snapshot &slot = slots_[tail % slots_.size()];
+    names_.insert(names_.end(), slot.new_names.begin(), slot.new_names.end());
+    try {
+      writer_->WriteRows(slot.time, slot.rows, names_);
+    } catch (...) {
+      error_ = std::current_exception();
+      failed_.store(true, std::memory_order_release);
+      return;
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+}
+
+void AsyncCountsWriter::Join() {
+  if (thread_.joinable()) {
+    closing_.store(true, std::memory_order_release);
+    thread_.join();
+  }
+}
+
+void AsyncCountsWriter::Wait() {
+  // The background thread leaves the wrapped writer alone once it has
+  // caught up, until the next time point is published from this thread
+  int attempts = 0;
+  while (tail_.load(std::memory_order_acquire) !=
+         head_.load(std::memory_order_relaxed)) {
+    if (failed_.load(std::memory_order_acquire)) {
+      Join();
+      std::rethrow_exception(error_);
+    }
+    Backoff(attempts);
+  }
+}
+
+void AsyncCountsWriter::WriteMetadata(const std::string &key, double value) {
+  Wait();
+  writer_->WriteMetadata(key, value);
+}
+
+void AsyncCountsWriter::Flush() {
+  Wait();
+  writer_->Flush();
+}
+
+void AsyncCountsWriter::Close() {
+  Join();
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  writer_->Close();
+}
+
+TableCountsWriter::TableCountsWriter(int expected_rows) {
+  table_.time.reserve(expected_rows);
+  row_widths_.reserve(expected_rows);
+}
+
+void TableCountsWriter::WriteRows(double time, const Rows &rows,
+                                  const std::vector<std::string> &names) {
+  for (const auto &row : rows) {
+    if (row.species_id >= static_cast<int>(column_of_.size())) {
+      column_of_.resize(row.species_id + 1, -1);
+    }
+    if (column_of_[row.species_id] == -1) {
+      column_of_[row.species_id] = table_.species.size();
+      table_.species.push_back(names[row.species_id]);
+    }
+  }
+  // Rows are appended at their current width and padded in Close()
+  int width = table_.species.size();
+  std::size_t offset = table_.protein.size();
+  table_.protein.resize(offset + width, 0.0);
+  table_.transcript.resize(offset + width, 0.0);
+  table_.ribo_density.resize(offset + width, 0.0);
+  for (const auto &row : rows) {
+    std::size_t index = offset + column_of_[row.species_id];
+    table_.protein[index] = row.protein;
+    table_.transcript[index] = row.transcript;
+    table_.ribo_density[index] = row.ribo_density;
+  }
+  table_.time.push_back(time);
+  row_widths_.push_back(width);
+}
+
+void TableCountsWriter::Close() {
+  std::size_t width = table_.species.size();
+  std::size_t rows = table_.time.size();
+  if (table_.protein.size() == rows * width) {
+    return;
+  }
+  // Move rows to their padded positions, starting from the last row so that
+  // nothing is overwritten before it has been moved
+  for (auto values :
+       {&table_.protein, &table_.transcript, &table_.ribo_density}) {
+    std::vector<double> &v = *values;
+    std::size_t end = v.size();
+    v.resize(rows * width, 0.0);
+    for (std::size_t i = rows; i-- > 0;) {
+      std::size_t row_width = row_widths_[i];
+      std::size_t start = end - row_width;
+      std::copy_backward(v.begin() + start, v.begin() + end,
+                         v.begin() + i * width + row_width);
+      std::fill(v.begin() + i * width + row_width, v.begin() + (i + 1) * width,
+                0.0);
+      end = start;
+    }
+  }
+}
@@ -0,0 +1,379 @@
+#ifndef SRC_OUTPUT_HPP  // header guard
+#define SRC_OUTPUT_HPP
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tracker.hpp"
+
+/**
+ * Records species counts at each output time point of a simulation.
+ */
+class CountsWriter {
+ public:
+  /**
+   * Convenience typedefs.
+   */
+  typedef std::unique_ptr<CountsWriter> Ptr;
+  typedef std::vector<SpeciesTracker::Counts> Rows;
+  virtual ~CountsWriter() {}
+  /**
+   * Create a file writer for a given output format.
+   *
+   * @param format "tsv", "binary" or "binary_delta" (see
+   *  BinaryCountsWriter), or "hdf5" (a single-replicate Hdf5Store) if built
+   *  with PINETREE_HDF5
+   * @param path path of output file, which is overwritten
+   * @param async encode and write output on a background thread (see
+   *  AsyncCountsWriter)
+   */
+  static Ptr Create(const std::string &format, const std::string &path,
+                    bool async = false);
+  /**
+   * Record the counts of all reported species.
+   *
+   * @param time current simulation time
+   * @param tracker tracker holding counts
+   */
+  virtual void Write(double time, SpeciesTracker &tracker);
+  /**
+   * Record counts already gathered from a tracker.
+   *
+   * @param time simulation time of the counts
+   * @param rows counts of each reported species
+   * @param names species names indexed by ID, covering every ID in rows
+   */
+  virtual void WriteRows(double time, const Rows &rows,
+                         const std::vector<std::string> &names) = 0;
+  /**
+   * Record a property of the run after the time points written so far,
+   * e.g. the time at which it reached steady state. Ignored by default.
+   *
+   * @param key name of the property
+   * @param value value of the property
+   */
+  virtual void WriteMetadata(const std::string &key, double value) {}
+  /**
+   * Make everything recorded so far visible, e.g. write it to disk, keeping
+   * the writer open for more time points.
+   */
+  virtual void Flush() {}
+  /**
+   * Finish output once the simulation is done.
+   */
+  virtual void Close() {}
+
+ protected:
+  /**
+   * Reused storage for the counts of each time point.
+   */
+  Rows rows_;
+};
+
+/**
+ * Base class for writers that buffer their output in memory and write it to
+ * disk in large blocks.
+ */
+class FileCountsWriter : public CountsWriter {
+ public:
+  /**
+   * Write any buffered output to the file.
+   */
+  void Flush();
+  /**
+   * Write any buffered output and close the file.
+   */
+  void Close();
+
+ protected:
+  /**
+   * Open the output file.
+   */
+  explicit FileCountsWriter(const std::string &path);
+  /**
+   * Write the buffer to the file if it has grown past BUFFER_SIZE.
+   */
+  void MaybeFlush();
+  /**
+   * Flush the buffer once it holds this many bytes.
+   */
+  static const std::size_t BUFFER_SIZE = 1 << 20;
+  /**
+   * Output file.
+   */
+  std::ofstream file_;
+  /**
+   * Output not yet written to file_.
+   */
+  std::string buffer_;
+};
+
+/**
+ * Tab-separated text output with one row per species and time point, with the
+ * columns time, species, protein, transcript and ribo_density. Metadata is
+ * written as comment lines of the form "# key=value".
+ */
+class TsvCountsWriter : public FileCountsWriter {
+ public:
+  explicit TsvCountsWriter(const std::string &path);
+  void WriteRows(double time, const Rows &rows,
+                 const std::vector<std::string> &names);
+  void WriteMetadata(const std::string &key, double value);
+};
+
+/**
+ * Packed binary output. Values are written in host byte order, which is
+ * little-endian on every platform pinetree supports. The file starts with
+ * the 8 bytes "PTCOUNTS" and a uint32 format version (currently 2), followed
+ * by a sequence of blocks, each starting with a one-byte tag:
+ *
+ * - 'S' declares a new column: uint32 column index, uint32 name length,
+ *   then the name in UTF-8 without a terminator. Columns are numbered from 0
+ *   in order of declaration.
+ * - 'R' records one time point: float64 time, uint32 number of columns n,
+ *   then for each column 0..n-1 three float64 values: protein, transcript
+ *   and ribo_density.
+ * - 'M' records metadata (since version 2): uint32 key length, the key in
+ *   UTF-8 without a terminator, then a float64 value.
+ * - 'D' records one time point as changes to the previous one (since
+ *   version 3): float64 time, uint32 number of columns n, uint32 number of
+ *   changed columns k, then for each changed column, in increasing order, a
+ *   uint32 column index and its three float64 values. Columns that are not
+ *   listed keep their values from the previous time point, or are 0 if they
+ *   were declared since.
+ *
+ * A species gets a column the first time it appears in the output and keeps
+ * it for the rest of the file, so every record is a superset of the previous
+ * one. Species names are mapped to columns once, when they are declared.
+ *
+ * Delta-encoded files (format version 3) start with an 'R' record and
+ * record every later time point as a 'D' record, so their size grows with
+ * the number of counts that change between time points rather than with the
+ * number of species. Plain files are still written as version 2.
+ */
+class BinaryCountsWriter : public FileCountsWriter {
+ public:
+  /**
+   * @param path path of output file, which is overwritten
+   * @param delta record time points after the first as changes ('D'
+   *  records)
+   */
+  explicit BinaryCountsWriter(const std::string &path, bool delta = false);
+  /**
+   * With delta encoding, turn on change tracking in the tracker (see
+   * SpeciesTracker::track_changes) at the first time point and gather only
+   * the counts that changed after that, so that the cost of each time point
+   * does not grow with the number of species that stay constant. The
+   * tracker must not be shared with another delta-encoding writer.
+   */
+  void Write(double time, SpeciesTracker &tracker);
+  /**
+   * Record counts of some or all reported species. With delta encoding,
+   * rows after the first time point may leave out species whose counts did
+   * not change, and species whose counts equal those last written are not
+   * recorded again.
+   */
+  void WriteRows(double time, const Rows &rows,
+                 const std::vector<std::string> &names);
+  void WriteMetadata(const std::string &key, double value);
+
+ private:
+  /**
+   * Record time points after the first as changes?
+   */
+  bool delta_;
+  /**
+   * Has a time point been recorded?
+   */
+  bool started_ = false;
+  /**
+   * Columns whose values changed in the current 'D' record.
+   */
+  std::vector<int> changed_;
+  /**
+   * Column of each species ID, or -1 if it has not been declared.
+   */
+  std::vector<int> column_of_;
+  /**
+   * Number of declared columns.
+   */
+  int column_count_ = 0;
+  /**
+   * Reused storage for the values of one record, in column order. With
+   * delta encoding, the values last written for each column.
+   */
+  std::vector<double> values_;
+  /**
+   * Append the bytes of a value to the buffer.
+   */
+  template <typename T>
+  void Append(const T &value);
+  /**
+   * Write a 'D' record of the rows whose values differ from values_.
+   */
+  void WriteChanges(double time, const Rows &rows);
+};
+
+/**
+ * Passes counts to another writer running on a background thread, so that
+ * the simulation does not wait for formatting or disk I/O. Each time point
+ * is copied into a slot of a fixed-size single-producer, single-consumer
+ * ring buffer without locking or allocating (once slots have grown to size);
+ * the simulation only waits when every slot is full.
+ */
+class AsyncCountsWriter : public CountsWriter {
+ public:
+  /**
+   * @param writer writer to run on the background thread
+   * @param capacity number of time points the buffer holds
+   */
+  explicit AsyncCountsWriter(Ptr writer, std::size_t capacity = 256);
+  /**
+   * Finishes the background thread, discarding any error.
+   */
+  ~AsyncCountsWriter();
+  void Write(double time, SpeciesTracker &tracker);
+  void WriteRows(double time, const Rows &rows,
+                 const std::vector<std::string> &names);
+  /**
+   * Wait for all buffered time points to be written, then pass metadata to
+   * the wrapped writer.
+   */
+  void WriteMetadata(const std::string &key, double value);
+  /**
+   * Wait for all buffered time points to be written, then flush the wrapped
+   * writer. Rethrows any error raised on the background thread.
+   */
+  void Flush();
+  /**
+   * Wait for all buffered time points to be written, then close the wrapped
+   * writer. Rethrows any error raised on the background thread.
+   */
+  void Close();
+
+ private:
+  /**
+   * Counts of one time point, with any species names that were added since
+   * the previous time point.
+   */
+  struct Snapshot {
+    double time;
+    Rows rows;
+    std::vector<std::string> new_names;
+  };
+  Ptr writer_;
+  std::vector<Snapshot> slots_;
+  /**
+   * Number of snapshots published by the simulation thread and consumed by
+   * the background thread. Each is written by one thread only.
+   */
+  std::atomic<std::size_t> head_;
+  std::atomic<std::size_t> tail_;
+  /**
+   * Set once no more snapshots will be published.
+   */
+  std::atomic<bool> closing_;
+  /**
+   * Set by the background thread if the wrapped writer threw error_.
+   */
+  std::atomic<bool> failed_;
+  std::exception_ptr error_;
+  /**
+   * Number of names already passed to the background thread.
+   */
+  std::size_t names_sent_ = 0;
+  /**
+   * Background thread's copy of all species names.
+   */
+  std::vector<std::string> names_;
+  std::thread thread_;
+  /**
+   * Wait for a free slot and fill in its time and any new names.
+   */
+  Snapshot &Acquire(double time, const std::vector<std::string> &names);
+  /**
+   * Hand the slot returned by Acquire to the background thread.
+   */
+  void Publish();
+  /**
+   * Background thread: write snapshots until closed.
+   */
+  void Drain();
+  /**
+   * Stop the background thread once it has drained the buffer.
+   */
+  void Join();
+  /**
+   * Wait for the background thread to write every published time point.
+   * Rethrows any error raised on the background thread.
+   */
+  void Wait();
+};
+
+/**
+ * A dense time x species table of counts, held in memory.
+ */
+struct CountsTable {
+  /**
+   * Output time points.
+   */
+  std::vector<double> time;
+  /**
+   * Species names, one per column, in order of first appearance.
+   */
+  std::vector<std::string> species;
+  /**
+   * Values in row-major order, with one row per time point and one column
+   * per species. Species that have not appeared yet at a time point are 0.
+   */
+  std::vector<double> protein;
+  std::vector<double> transcript;
+  std::vector<double> ribo_density;
+  /**
+   * Properties of the run (see CountsWriter::WriteMetadata).
+   */
+  std::map<std::string, double> metadata;
+};
+
+/**
+ * Collects counts into a CountsTable instead of a file.
+ */
+class TableCountsWriter : public CountsWriter {
+ public:
+  /**
+   * @param expected_rows number of time points to reserve space for
+   */
+  explicit TableCountsWriter(int expected_rows);
+  void WriteRows(double time, const Rows &rows,
+                 const std::vector<std::string> &names);
+  void WriteMetadata(const std::string &key, double value) {
+    table_.metadata[key] = value;
+  }
+  /**
+   * Pad rows written before the last species appeared to the full width.
+   */
+  void Close();
+  /**
+   * @return the finished table; only valid after Close()
+   */
+  CountsTable &table() { return table_; }
+
+ private:
+  CountsTable table_;
+  /**
+   * Column of each species ID, or -1 if it has not appeared yet.
+   */
+  std::vector<int> column_of_;
+  /**
+   * Number of columns in each row as written.
+   */
+  std::vector<int> row_widths_;
+};
+
+#endif  // header guard
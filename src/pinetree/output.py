@@ -0,0 +1,96 @@
+"""Readers for pinetree output files."""
+
+import struct
+
+MAGIC = b"PTCOUNTS"
+COLUMNS = ("time", "species", "protein", "transcript", "ribo_density")
+
+
+def read_counts(path):
+    """
+    Read a counts file written by Model.simulate with format="binary" or
+    format="binary_delta".
+
+    Args:
+        path (str): path to counts file
+
+    Returns:
+        dict: one list per column ("time", "species", "protein",
+        "transcript", "ribo_density"), with one entry per species and time
+        point in the same order as the tab separated output.
+    """
+    return _read(path)[0]
+
+
+def read_metadata(path):
+    """
+    Read the properties of a run recorded in a counts file written by
+    Model.simulate with format="binary", such as "steady_state_time" (see
+    Model.set_steady_state).
+
+    Args:
+        path (str): path to counts file
+
+    Returns:
+        dict: value of each property by name
+    """
+    return _read(path)[1]
+
+
+def _read(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError("'{}' is not a pinetree binary counts file.".format(
+            path))
+    version, = struct.unpack_from("<I", data, 8)
+    if version not in (1, 2, 3):
+        raise ValueError("Unsupported counts file version {}.".format(version))
+    results = {column: [] for column in COLUMNS}
+    metadata = {}
+    names = []
+    order = []
+    # Values of every column at the last time point, for delta records
+    values = []
+    pos = 12
+    while pos < len(data):
+        tag = data[pos:pos + 1]
+        pos += 1
+        if tag == b"S":
+            index, length = struct.unpack_from("<II", data, pos)
+            pos += 8
+            names.append(data[pos:pos + length].decode("utf-8"))
+            pos += length
+            order = sorted(range(len(names)), key=lambda i: names[i])
+        elif tag in (b"R", b"D") and (tag == b"R" or version >= 3):
+            time, n = struct.unpack_from("<dI", data, pos)
+            pos += 12
+            if tag == b"R":
+                values = list(struct.unpack_from("<{}d".format(3 * n), data,
+                                                 pos))
+                pos += 24 * n
+            else:
+                values.extend([0.0] * (3 * n - len(values)))
+                k, = struct.unpack_from("<I", data, pos)
+                pos += 4
+                for _ in range(k):
+                    column, = struct.unpack_from("<I", data, pos)
+                    values[3 * column:3 * column + 3] = struct.unpack_from(
+                        "<3d", data, pos + 4)
+                    pos += 28
+            for i in order:
+                results["time"].append(time)
+                results["species"].append(names[i])
+                results["protein"].append(values[3 * i])
+                results["transcript"].append(values[3 * i + 1])
+                results["ribo_density"].append(values[3 * i + 2])
+        elif tag == b"M" and version >= 2:
+            length, = struct.unpack_from("<I", data, pos)
+            pos += 4
+            key = data[pos:pos + length].decode("utf-8")
+            pos += length
+            metadata[key], = struct.unpack_from("<d", data, pos)
+            pos += 8
+        else:
+            raise ValueError("Corrupt counts file '{}'.".format(path))
+    return results, metadata
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "placement.hpp"
+
+Placement ParsePlacement(const std::string &name) {
+  if (name == "none") {
+    return Placement::NONE;
+  }
+  if (name == "compact") {
+    return Placement::COMPACT;
+  }
+  if (name == "spread") {
+    return Placement::SPREAD;
+  }
+  throw std::invalid_argument("Unknown placement '" + name +
+                              "'; expected none, compact or spread.");
+}
+
+#ifdef __linux__
+/**
+ * CPUs of a list such as "0-3,8,10-11", as in sysfs.
+ */
+static std::vector<int> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    int first, last;
+    char dash;
+    std::stringstream parts(range);
+    if (!(parts >> first)) {
+      continue;
+    }
+    if (!(parts >> dash >> last)) {
+      last = first;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+#endif
+
+std::vector<std::vector<int>> NumaNodes() {
+  std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    CPU_ZERO(&allowed);
+  }
+  std::vector<int> ids;
+  if (DIR *directory = opendir("/sys/devices/system/node")) {
+    while (dirent *entry = readdir(directory)) {
+      std::string name = entry->d_name;
+      if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+          std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+        ids.push_back(std::stoi(name.substr(4)));
+      }
+    }
+    closedir(directory);
+  }
+  std::sort(ids.begin(), ids.end());
+  for (int id : ids) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) +
+                       "/cpulist");
+    std::string list;
+    std::getline(file, list);
+    std::vector<int> cpus;
+    for (int cpu : ParseCpuList(list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      nodes.push_back(cpus);
+    }
+  }
+  if (nodes.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    nodes.push_back(cpus);
+  }
+#else
+  nodes.emplace_back();
+  unsigned count = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned cpu = 0; cpu < count; cpu++) {
+    nodes.back().push_back(cpu);
+  }
+#endif
+  return nodes;
+}
+
+std::vector<int> PlacementCpus(Placement placement, int workers) {
+  std::vector<int> cpus;
+  if (placement == Placement::NONE || workers <= 0) {
+    return cpus;
+  }
+  auto nodes = NumaNodes();
+  std::vector<int> order;
+  if (placement == Placement::COMPACT) {
+    for (const auto &node : nodes) {
+      order.insert(order.end(), node.begin(), node.end());
+    }
+  } else {
+    std::size_t longest = 0;
+    for (const auto &node : nodes) {
+      longest = std::max(longest, node.size());
+    }
+    for (std::size_t i = 0; i < longest; i++) {
+      for (const auto &node : nodes) {
+        if (i < node.size()) {
+          order.push_back(node[i]);
+        }
+      }
+    }
+  }
+  if (order.empty()) {
+    return cpus;
+  }
+  for (int i = 0; i < workers; i++) {
+    cpus.push_back(order[i % order.size()]);
+  }
+  return cpus;
+}
+
+bool PinThread(int cpu) {
+#ifdef __linux__
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,46 @@
+#ifndef SRC_PLACEMENT_HPP  // header guard
+#define SRC_PLACEMENT_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * How the worker threads of an ensemble are placed on CPUs (see
+ * Model::placement). Workers build their own models, memory pools and
+ * output buffers once placed, so on NUMA machines pinning them keeps that
+ * memory on the node of the CPU that uses it.
+ *  - NONE: leave threads to the operating system
+ *  - COMPACT: fill the CPUs of one NUMA node before the next
+ *  - SPREAD: take CPUs from each node in turn, to use every node's memory
+ *    bandwidth with few workers
+ */
+enum class Placement { NONE, COMPACT, SPREAD };
+
+/**
+ * @param name "none", "compact" or "spread"
+ * @throws std::invalid_argument for any other name
+ */
+Placement ParsePlacement(const std::string &name);
+
+/**
+ * CPUs of each NUMA node that this process may run on, in order of node,
+ * leaving out nodes without any. Machines without NUMA information are
+ * one node.
+ */
+std::vector<std::vector<int>> NumaNodes();
+
+/**
+ * CPU to pin each of a number of workers to, reusing CPUs in the same order
+ * if there are more workers than CPUs, or nothing for Placement::NONE.
+ */
+std::vector<int> PlacementCpus(Placement placement, int workers);
+
+/**
+ * Pin the calling thread to a CPU.
+ *
+ * @return false if threads cannot be pinned on this platform or the CPU
+ *  could not be used, in which case the thread is left as it was
+ */
+bool PinThread(int cpu);
+
+#endif  // header guard
@@ -1,122 +1,231 @@
 #include "polymer.hpp"
 #include "IntervalTree.h"
+#include "checkpoint.hpp"
+#include "checks.hpp"
 #include "choices.hpp"
+#include "profile.hpp"
 #include "tracker.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 MobileElementManager::MobileElementManager(const std::vector<double> &weights)
+    : weights_(std::make_shared<const std::vector<double>>(weights)) {}
+
+MobileElementManager::MobileElementManager(
+    std::shared_ptr<const std::vector<double>> weights)
     : weights_(weights) {}
 
 void MobileElementManager::Insert(MobileElement::Ptr pol,
                                   Polymer::Ptr polymer) {
-  // Find where in vector polymerase should insert; use a lambda function
-  // to make comparison between polymerase pointers
-  auto pol_polymer = std::make_pair(pol, polymer);
-  auto it =
-      std::upper_bound(polymerases_.begin(), polymerases_.end(), pol_polymer,
-                       [](std::pair<MobileElement::Ptr, Polymer::Ptr> a,
-                          std::pair<MobileElement::Ptr, Polymer::Ptr> b) {
-                         return a.first->start() < b.first->start();
-                       });
-  // Record position for prop_list_
-  // NOTE: iterators become invalid as soon as a vector is changed!!
-  // Attempting to use an iterator twice will lead to a segfault.
-  auto prop_it = (it - polymerases_.begin()) + prop_list_.begin();
+  // Find where in vector polymerase should insert
+  auto it = std::upper_bound(
+      spans_.begin(), spans_.end(), pol->start(),
+      [](int start, const Span &span) { return start < span.start; });
+  int prop_index = it - spans_.begin();
   // Add polymerase to this polymer
-  polymerases_.insert(it, std::make_pair(pol, polymer));
+  spans_.insert(it, Span{pol->start(), pol->stop()});
+  elements_.insert(elements_.begin() + prop_index, pol);
+  attached_.insert(attached_.begin() + prop_index, polymer);
+  blocked_.insert(blocked_.begin() + prop_index, false);
   
   //Set propensity
   //Currently, this should only be weighted if pol is a ribosome
-  if (pol->name() == "__ribosome") {
+  if (pol->kind() == ElementKind::RIBOSOME) {
     // Cache polymerase speed, weighted
-    double weight = weights_[pol->stop() - 1];
-    // Update total move propensity of this polymer
-    prop_sum_ += weight * pol->speed();
-    prop_list_.insert(prop_it, weight * pol->speed());
+    prop_tree_.Insert(prop_index, RibosomePropensity(*pol));
   } else {
-    // Update total move propensity of this polymer, unweighted
-    prop_sum_ += pol->speed();
-    prop_list_.insert(prop_it, pol->speed());
+    // Unweighted
+    prop_tree_.Insert(prop_index, pol->speed());
   }
 
-  if (prop_list_.size() != polymerases_.size()) {
-    throw std::runtime_error("Prop list not correct size.");
-  }
+  PINETREE_CHECK(prop_tree_.size() == static_cast<int>(elements_.size()),
+                 "Prop list not correct size.");
   // Keep running count of non-RNAse mobile elements
-  if (pol->name() != "__rnase") {
+  if (pol->kind() != ElementKind::RNASE) {
     pol_count_ += 1;
   }
 }
 
 void MobileElementManager::Delete(int index) {
-  prop_sum_ -= prop_list_[index];
   // Keep running count of non-RNAse mobile elements
-  if (polymerases_[index].first->name() != "__rnase") {
+  if (elements_[index]->kind() != ElementKind::RNASE) {
     pol_count_ -= 1;
   }
-  polymerases_.erase(polymerases_.begin() + index);
-  prop_list_.erase(prop_list_.begin() + index);
-  if (prop_list_.size() != polymerases_.size()) {
-    throw std::runtime_error("Prop list not correct size.");
-  }
+  elements_.erase(elements_.begin() + index);
+  attached_.erase(attached_.begin() + index);
+  blocked_.erase(blocked_.begin() + index);
+  spans_.erase(spans_.begin() + index);
+  prop_tree_.Erase(index);
+  PINETREE_CHECK(prop_tree_.size() == static_cast<int>(elements_.size()),
+                 "Prop list not correct size.");
+}
+
+void MobileElementManager::Move(int index) {
+  elements_[index]->Move();
+  Sync(index);
+}
+
+void MobileElementManager::MoveBack(int index) {
+  elements_[index]->MoveBack();
+  Sync(index);
+}
+
+void MobileElementManager::Shift(int index, int steps) {
+  MobileElement &pol = *elements_[index];
+  pol.start(pol.start() + steps);
+  pol.stop(pol.stop() + steps);
+  Sync(index);
 }
 
 void MobileElementManager::UpdatePropensity(int index) {
   auto pol = GetPol(index);
-  int weight_index = pol->stop() - 1;
-  if (weight_index >= weights_.size() || weight_index < 0) {
-    throw std::runtime_error("Weight is missing for this position.");
+  prop_tree_.Update(index, RibosomePropensity(*pol));
+}
+
+void MobileElementManager::Resume(int index) {
+  auto pol = GetPol(index);
+  if (pol->kind() == ElementKind::RIBOSOME) {
+    prop_tree_.Update(index, RibosomePropensity(*pol));
+  } else {
+    prop_tree_.Update(index, pol->speed());
+  }
+}
+
+bool MobileElementManager::Unblock(int index) {
+  if (!blocked_[index]) {
+    return false;
+  }
+  blocked_[index] = false;
+  Resume(index);
+  return true;
+}
+
+int MobileElementManager::UniformWeights(int position, int limit) const {
+  if (!weights_) {
+    return limit;
+  }
+  double weight = Weight(position);
+  int count = 0;
+  int size = weights_->size();
+  while (count < limit && position + count < size &&
+         (*weights_)[position + count] == weight) {
+    count++;
   }
-  double weight = weights_[weight_index];
-  double new_speed = weight * pol->speed();
-  double diff = new_speed - prop_list_[index];
-  prop_sum_ += diff;
-  prop_list_[index] = new_speed;
+  return count;
 }
 
 MobileElement::Ptr MobileElementManager::GetPol(int index) {
-  if (index >= polymerases_.size()) {
+  PINETREE_CHECK(ValidIndex(index), "Polymerase index out of range.");
+  return elements_[index];
+}
+
+void MobileElementManager::SetAttached(int index, Polymer::Ptr polymer) {
+  if (index >= static_cast<int>(elements_.size())) {
     throw std::range_error("Polymerase index out of range.");
   }
-  return polymerases_[index].first;
+  attached_[index] = polymer;
 }
 
 Polymer::Ptr MobileElementManager::GetAttached(int index) {
-  if (index >= polymerases_.size()) {
-    throw std::range_error("Polymerase index out of range.");
-  }
-  return polymerases_[index].second;
+  PINETREE_CHECK(ValidIndex(index), "Polymerase index out of range.");
+  return attached_[index];
 }
 
-int MobileElementManager::Choose() {
-  if (prop_list_.size() == 0) {
+int MobileElementManager::Choose(Random &rng) {
+  if (prop_tree_.size() == 0) {
     std::string err =
         "There are no active polymerases on polymer (propensity sum: " +
-        std::to_string(prop_sum_) + ").";
+        std::to_string(prop_tree_.total()) + ").";
     throw std::runtime_error(err);
   }
-  int pol_index = Random::WeightedChoiceIndex(polymerases_, prop_list_);
+  int pol_index = prop_tree_.Find(rng.random() * prop_tree_.total());
   // Error checking to make sure that pol is in vector
-  if (pol_index >= polymerases_.size()) {
+  if (pol_index >= static_cast<int>(elements_.size())) {
     std::string err = "Attempting to move unbound polymerase with index " +
                       std::to_string(pol_index) + " on polymer.";
     throw std::runtime_error(err);
   }
-  if (pol_index >= prop_list_.size()) {
+  if (pol_index >= prop_tree_.size()) {
     throw std::runtime_error(
         "Prop list vector index is invalid (before move).");
   }
   return pol_index;
 }
 
+void MobileElementManager::Save(
+    CheckpointWriter &writer,
+    const std::function<int(const Polymer::Ptr &)> &polymer_id) const {
+  writer.Write<int32_t>(pol_count_);
+  writer.Write<uint32_t>(elements_.size());
+  for (std::size_t i = 0; i < elements_.size(); i++) {
+    writer.Write<int32_t>(static_cast<int>(elements_[i]->kind()));
+    writer.Write(elements_[i]->name());
+    writer.Write(elements_[i]->speed());
+    elements_[i]->Save(writer);
+    writer.Write<int32_t>(polymer_id(attached_[i]));
+    writer.Write(static_cast<bool>(blocked_[i]));
+  }
+  prop_tree_.Save(writer);
+}
+
+void MobileElementManager::Load(
+    CheckpointReader &reader,
+    const std::function<Polymer::Ptr(int)> &polymer,
+    const MemoryPool::Ptr &pool) {
+  pol_count_ = reader.Read<int32_t>();
+  std::size_t size = reader.Read<uint32_t>();
+  elements_.resize(size);
+  attached_.resize(size);
+  blocked_.resize(size);
+  spans_.resize(size);
+  for (std::size_t i = 0; i < size; i++) {
+    auto kind = static_cast<ElementKind>(reader.Read<int32_t>());
+    std::string name;
+    reader.Read(name);
+    double speed = reader.Read<double>();
+    // Footprints are restored along with positions
+    if (kind == ElementKind::RNASE) {
+      elements_[i] = MakePooled<Rnase>(pool, 0, static_cast<int>(speed));
+    } else {
+      elements_[i] =
+          MakePooled<Polymerase>(pool, name, 0, static_cast<int>(speed));
+    }
+    elements_[i]->Load(reader);
+    attached_[i] = polymer(reader.Read<int32_t>());
+    blocked_[i] = reader.Read<uint8_t>() != 0;
+    Sync(i);
+  }
+  prop_tree_.Load(reader);
+}
+
+void MobileElementManager::Memory(MemoryReport &report) const {
+  std::size_t bytes = MemoryReport::Bytes(elements_) +
+                      MemoryReport::Bytes(attached_) +
+                      MemoryReport::Bytes(blocked_) +
+                      MemoryReport::Bytes(spans_) + prop_tree_.memory();
+  for (const auto &element : elements_) {
+    bytes += (element->kind() == ElementKind::RNASE ? sizeof(Rnase)
+                                                    : sizeof(Polymerase)) +
+             MemoryReport::Bytes(element->name());
+  }
+  report.Add("elements", elements_.size(), bytes);
+  if (weights_ && report.First(weights_.get())) {
+    report.Add("weights", 1, MemoryReport::Bytes(*weights_));
+  }
+}
+
 Polymer::Polymer(const std::string &name, int start, int stop)
+    : Polymer(name, start, stop, nullptr) {}
+
+Polymer::Polymer(const std::string &name, int start, int stop,
+                 std::shared_ptr<const std::vector<double>> weights)
     : name_(name),
       start_(start),
       stop_(stop),
-      polymerases_(MobileElementManager(std::vector<double>())) {
-  weights_ = std::vector<double>(stop - start + 1, 1.0);
-  polymerases_ = MobileElementManager(weights_);
+      polymerases_(MobileElementManager(weights)) {
+  weights_ = weights;
   std::map<std::string, double> interaction_map;
   mask_ = Mask(stop_ + 1, stop_, interaction_map);
 }
@@ -150,58 +259,273 @@ Polymer::~Polymer() {
   }*/
 }
 
-void Polymer::Unlink() {
-  // Remove all pointers to polymer from promoter-polymer map
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(start_, stop_, results);
-  for (auto &interval : results) {
-    // std::cout << "Destroying " + interval.value->name() + " \n" << std::endl;
-    SpeciesTracker::Instance().Remove(interval.value->name(),
-                                      shared_from_this());
+void Polymer::Save(CheckpointWriter &writer,
+                   const std::function<int(const Ptr &)> &polymer_id) const {
+  writer.Write(attached_);
+  writer.Write(degrade_);
+  writer.Write<int32_t>(total_elements_);
+  writer.Write<int32_t>(degraded_elements_);
+  mask_.Save(writer);
+  // Counts are saved by name, since interned IDs differ between processes
+  std::map<std::string, int> uncovered;
+  for (int id = 0; id < static_cast<int>(uncovered_.size()); id++) {
+    if (uncovered_[id] >= 0) {
+      uncovered[InternedName::Name(id)] = uncovered_[id];
+    }
+  }
+  writer.Write(uncovered);
+  writer.Write<uint32_t>(binding_intervals_.size());
+  for (const auto &interval : binding_intervals_) {
+    interval.value->Save(writer);
+  }
+  writer.Write<uint32_t>(release_intervals_.size());
+  for (const auto &interval : release_intervals_) {
+    interval.value->Save(writer);
   }
+  polymerases_.Save(writer, polymer_id);
+  // Sites of mean-field events are saved by their index on the polymer
+  auto save_event = [&](const MeanFieldEvent &event) {
+    int index = -1;
+    int count = binding_intervals_.size();
+    for (int i = 0; event.site && i < count; i++) {
+      if (binding_intervals_[i].value == event.site) {
+        index = i;
+      }
+    }
+    writer.Write<int32_t>(index);
+    writer.Write(event.pol_name);
+    writer.Write(event.gene);
+    writer.Write<int32_t>(event.front);
+  };
+  writer.Write<uint32_t>(mean_field_events_.size());
+  for (const auto &event : mean_field_events_) {
+    writer.Write(event.first);
+    save_event(event.second);
+  }
+  writer.Write<uint32_t>(mean_field_waiting_.size());
+  for (const auto &event : mean_field_waiting_) {
+    save_event(event);
+  }
+  std::map<std::string, double> last;
+  for (const auto &gene : mean_field_last_) {
+    last[InternedName::Name(gene.first)] = gene.second;
+  }
+  writer.Write(last);
 }
 
-void Polymer::Initialize() {
-  // Construct invterval trees
-  binding_sites_ = IntervalTree<BindingSite::Ptr>(binding_intervals_);
-  release_sites_ = IntervalTree<ReleaseSite::Ptr>(release_intervals_);
-  std::vector<Interval<BindingSite::Ptr>> results;
+void Polymer::Memory(MemoryReport &report) const {
+  MemoryOf(report, "polymers", sizeof(Polymer));
+}
 
-  // Cover all masked sites
-  int mask_start = mask_.start();
-  int mask_stop = mask_.stop();
-  binding_sites_.findOverlapping(mask_start, mask_stop, results);
+void Polymer::MemoryOf(MemoryReport &report, const std::string &subsystem,
+                       std::size_t size) const {
+  report.Add(subsystem, 1,
+             size + MemoryReport::Bytes(name_) +
+                 MemoryReport::Bytes(binding_intervals_) +
+                 MemoryReport::Bytes(release_intervals_) +
+                 binding_sites_.memory() + release_sites_.memory() +
+                 MemoryReport::Bytes(uncovered_) +
+                 MemoryReport::Bytes(occupancy_name_) +
+                 MemoryReport::Bytes(occupancy_cache_) +
+                 MemoryReport::Bytes(mean_field_events_) +
+                 MemoryReport::Bytes(mean_field_waiting_) +
+                 MemoryReport::Bytes(mean_field_genes_) +
+                 MemoryReport::Bytes(mean_field_last_));
+  // Sites may be shared, e.g. by copies of a genome
+  for (const auto &interval : binding_intervals_) {
+    if (report.First(interval.value.get())) {
+      report.Add("sites", 1, sizeof(BindingSite));
+    }
+  }
+  for (const auto &interval : release_intervals_) {
+    if (report.First(interval.value.get())) {
+      report.Add("sites", 1, sizeof(ReleaseSite));
+    }
+  }
+  polymerases_.Memory(report);
+  if (weights_ && report.First(weights_.get())) {
+    report.Add("weights", 1, MemoryReport::Bytes(*weights_));
+  }
+}
+
+void Polymer::Load(CheckpointReader &reader,
+                   const std::function<Ptr(int)> &polymer) {
+  reader.Read(attached_);
+  reader.Read(degrade_);
+  total_elements_ = reader.Read<int32_t>();
+  degraded_elements_ = reader.Read<int32_t>();
+  mask_.Load(reader);
+  std::map<std::string, int> uncovered;
+  reader.Read(uncovered);
+  uncovered_.clear();
+  for (const auto &count : uncovered) {
+    UncoveredCount(InternedName::Id(count.first)) = count.second;
+  }
+  CheckpointReader::Expect(
+      reader.Read<uint32_t>() == binding_intervals_.size(),
+      "number of binding sites on " + name_);
+  for (const auto &interval : binding_intervals_) {
+    interval.value->Load(reader);
+  }
+  CheckpointReader::Expect(
+      reader.Read<uint32_t>() == release_intervals_.size(),
+      "number of release sites on " + name_);
+  for (const auto &interval : release_intervals_) {
+    interval.value->Load(reader);
+  }
+  polymerases_.Load(reader, polymer, pool_);
+  auto load_event = [&]() {
+    MeanFieldEvent event;
+    int index = reader.Read<int32_t>();
+    CheckpointReader::Expect(index < int(binding_intervals_.size()),
+                             "binding site of a ribosome on " + name_);
+    if (index >= 0) {
+      event.site = binding_intervals_[index].value;
+    }
+    reader.Read(event.pol_name);
+    reader.Read(event.gene);
+    event.front = reader.Read<int32_t>();
+    return event;
+  };
+  mean_field_events_.clear();
+  for (uint32_t i = reader.Read<uint32_t>(); i > 0; i--) {
+    double time = reader.Read<double>();
+    mean_field_events_.emplace(time, load_event());
+  }
+  mean_field_waiting_.clear();
+  for (uint32_t i = reader.Read<uint32_t>(); i > 0; i--) {
+    mean_field_waiting_.push_back(load_event());
+  }
+  std::map<std::string, double> last;
+  reader.Read(last);
+  mean_field_last_.clear();
+  for (const auto &gene : last) {
+    mean_field_last_[InternedName::Id(gene.first)] = gene.second;
+  }
+  runs_ = 0;
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    if (polymerases_.pol(i)->running()) {
+      runs_++;
+    }
+  }
+  UpdateNextRunEnd();
+}
+
+void PolymerStats::Save(CheckpointWriter &writer) const {
+  for (long long count : {moves, polymerase_collisions, mask_collisions,
+                          readthroughs, transcripts_created,
+                          transcripts_destroyed, runs, mean_field_ribosomes,
+                          mean_field_moves}) {
+    writer.Write<int64_t>(count);
+  }
+}
 
-  for (auto &interval : results) {
-    // TODO: move to wrapper reaction
-    SpeciesTracker::Instance().Add(interval.value->name(), shared_from_this());
-    interval.value->Cover();
-    interval.value->ResetState();
-    // We don't need to log anything here because covered promoters are
-    // invisible to SpeciesTracker.
+void PolymerStats::Collect(PolymerStats &other) {
+  moves += other.moves;
+  polymerase_collisions += other.polymerase_collisions;
+  mask_collisions += other.mask_collisions;
+  readthroughs += other.readthroughs;
+  transcripts_created += other.transcripts_created;
+  transcripts_destroyed += other.transcripts_destroyed;
+  runs += other.runs;
+  mean_field_ribosomes += other.mean_field_ribosomes;
+  mean_field_moves += other.mean_field_moves;
+  other = PolymerStats();
+}
+
+void PolymerStats::Load(CheckpointReader &reader) {
+  for (long long *count : {&moves, &polymerase_collisions, &mask_collisions,
+                           &readthroughs, &transcripts_created,
+                           &transcripts_destroyed, &runs,
+                           &mean_field_ribosomes, &mean_field_moves}) {
+    *count = reader.Read<int64_t>();
   }
+}
+
+void Polymer::occupancy(OccupancyProfiles::Ptr profiles,
+                        const std::string &name) {
+  occupancy_ = profiles;
+  occupancy_name_ = name;
+  occupancy_cache_.clear();
+}
 
-  std::vector<Interval<ReleaseSite::Ptr>> term_results;
-  release_sites_.findOverlapping(mask_start, mask_stop, term_results);
+OccupancyProfiles::Profile &Polymer::OccupancyProfile(
+    const MobileElement &pol) {
+  if (pol.type_id() >= static_cast<int>(occupancy_cache_.size())) {
+    occupancy_cache_.resize(pol.type_id() + 1, nullptr);
+  }
+  auto &profile = occupancy_cache_[pol.type_id()];
+  if (profile == nullptr) {
+    profile = &occupancy_->profile(occupancy_name_, pol.name(), stop_ + 1);
+  }
+  return *profile;
+}
+
+void Polymer::Unlink() {
+  // Elements still bound to a polymer leaving the simulation stop counting
+  if (occupancy_) {
+    for (int i = 0; i < polymerases_.pair_count(); i++) {
+      auto pol = polymerases_.GetPol(i);
+      occupancy_->Remove(OccupancyProfile(*pol), pol->stop());
+    }
+  }
+#ifdef PINETREE_TRACE
+  for (int i = 0; trace_ && i < polymerases_.pair_count(); i++) {
+    auto pol = polymerases_.GetPol(i);
+    PINETREE_TRACE_EVENT(trace_, REMOVE, trace_id_, *pol, pol->stop());
+  }
+#endif
+  // Remove all pointers to polymer from promoter-polymer map
+  binding_sites_.ForEachOverlapping(
+      start_, stop_, [this](const BindingSite::Ptr &site) {
+        tracker_->Remove(site->name(), *this);
+      });
+}
 
-  for (auto &interval : term_results) {
-    interval.value->Cover();
-    interval.value->ResetState();
+void Polymer::Initialize() {
+  // Construct site indices
+  if (!indexed_) {
+    binding_sites_ = SiteIndex<BindingSite::Ptr>(binding_intervals_);
+    release_sites_ = SiteIndex<ReleaseSite::Ptr>(release_intervals_);
+    rnase_sites_ = std::any_of(
+        binding_intervals_.begin(), binding_intervals_.end(),
+        [](const Interval<BindingSite::Ptr> &interval) {
+          return interval.value->CheckInteraction(InternedName::RNASE);
+        });
+    indexed_ = true;
   }
 
+  // Cover all masked sites
+  int mask_start = mask_.start();
+  int mask_stop = mask_.stop();
+  binding_sites_.ForEachOverlapping(
+      mask_start, mask_stop, [this](const BindingSite::Ptr &site) {
+        // TODO: move to wrapper reaction
+        tracker_->Add(site->name(), shared_from_this());
+        site->Cover();
+        site->ResetState();
+        // We don't need to log anything here because covered promoters are
+        // invisible to SpeciesTracker.
+      });
+
+  release_sites_.ForEachOverlapping(mask_start, mask_stop,
+                                    [](const ReleaseSite::Ptr &site) {
+                                      site->Cover();
+                                      site->ResetState();
+                                    });
+
   // Make sure all unmasked sites are uncovered
-  results.clear();
   total_elements_ = 0;
   degraded_elements_ = 0;
-  binding_sites_.findContained(start_, mask_start, results);
-  for (auto &interval : results) {
-    // TODO: Move to bridge reaction
-    SpeciesTracker::Instance().Add(interval.value->name(), shared_from_this());
-    interval.value->Uncover();
-    interval.value->ResetState();
-    LogUncover(interval.value->name());
-    total_elements_ += 1;
-  }
+  binding_sites_.ForEachContained(
+      start_, mask_start, [this](const BindingSite::Ptr &site) {
+        // TODO: Move to bridge reaction
+        tracker_->Add(site->name(), shared_from_this());
+        site->Uncover();
+        site->ResetState();
+        LogUncover(*site);
+        total_elements_ += 1;
+      });
 
   // for (auto elem : uncovered_) {
   //  std::cout << elem.first + " " + std::to_string(elem.second) << std::endl;
@@ -210,29 +534,36 @@ void Polymer::Initialize() {
 
 BindingSite::Ptr Polymer::FindBindingSite(MobileElement::Ptr pol,
                                           const std::string &promoter_name) {
-  // Make a list of free promoters that pol can bind
-  bool found = false;
-  BindingSite::VecPtr promoter_choices;
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(start_, mask_.start(), results);
-  for (auto &interval : results) {
-    if (interval.value->name() == promoter_name &&
-        !interval.value->IsCovered()) {
-      promoter_choices.push_back(interval.value);
-      found = true;
-    }
-  }
+  // Count the free promoters that pol can bind, then pick one of them
+  // uniformly in a second pass, without collecting them
+  int free_sites = 0;
+  auto is_free = [&](const BindingSite::Ptr &site) {
+    return site->name() == promoter_name && !site->IsCovered();
+  };
+  binding_sites_.ForEachOverlapping(
+      start_, mask_.start(), [&](const BindingSite::Ptr &site) {
+        if (is_free(site)) {
+          free_sites++;
+        }
+      });
   // Error checking
-  if (!found) {
+  if (free_sites == 0) {
     std::string err = "Polymerase " + pol->name() +
                       " could not find free promoter " + promoter_name +
                       " to bind in the polymer " + name_;
     throw std::runtime_error(err);
   }
   // Randomly select promoter.
-  BindingSite::Ptr elem = Random::WeightedChoice(promoter_choices);
+  int choice = rng_->random() * free_sites;
+  BindingSite::Ptr elem;
+  binding_sites_.ForEachOverlapping(
+      start_, mask_.start(), [&](const BindingSite::Ptr &site) {
+        if (is_free(site) && choice-- == 0) {
+          elem = site;
+        }
+      });
   // More error checking.
-  if (!elem->CheckInteraction(pol->name())) {
+  if (!elem->CheckInteraction(pol->type_id())) {
     std::string err = "Polymerase " + pol->name() +
                       " does not interact with promoter " + promoter_name;
     throw std::runtime_error(err);
@@ -249,10 +580,14 @@ void Polymer::Bind(MobileElement::Ptr pol, const std::string &promoter_name) {
   pol->stop(elem->start() + pol->footprint() - 1);
   pol->reading_frame(elem->reading_frame());
   // Only set gene_bound_ for transcripts and ribosomesinit
-  if (pol->name() == "__ribosome") {
-    pol->gene_bound(elem->gene());
+  if (pol->kind() == ElementKind::RIBOSOME) {
+    pol->gene_bound(elem->gene(), elem->gene_id());
   }
+  pol->release(0, -1);
   // More error checking.
+  if (clock_) {
+    SyncMask();
+  }
   if (pol->stop() >= mask_.start()) {
     std::string err = "MobileElement " + pol->name() +
                       " will overlap with mask upon promoter binding. This may "
@@ -260,47 +595,239 @@ void Polymer::Bind(MobileElement::Ptr pol, const std::string &promoter_name) {
                       "behavior.";
     throw std::runtime_error(err);
   }
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(pol->start(), pol->stop(), results);
-  for (auto &interval : results) {
-    interval.value->Cover();
-    if (interval.value->WasCovered()) {
-      // Cover promoter in cache
-      LogCover(interval.value->name());
-    }
-    interval.value->ResetState();
-    // Report some data to tracker
-    if (pol->name() != "__rnase" &&
-        interval.value->CheckInteraction("__ribosome")) {
-      auto &tracker = SpeciesTracker::Instance();
-      tracker.IncrementRibo(interval.value->gene(), 1);
-    }
-    if (pol->name() == "__rnase" &&
-        interval.value->CheckInteraction("__ribosome") &&
-        interval.value->degraded() == false) {
-      // Only decrement transcript count if this binding site has
-      // been exposed and logged by SpeciesTracker before
-      if (interval.value->first_exposure() == true) {
-        auto &tracker = SpeciesTracker::Instance();
-        tracker.IncrementTranscript(interval.value->gene(), -1);
-      }
-      interval.value->Degrade();
-    }
+  if (elem->mean_field() && pol->kind() == ElementKind::RIBOSOME) {
+    BindMeanField(pol, elem);
+    return;
   }
+  binding_sites_.ForEachOverlapping(
+      pol->start(), pol->stop(), [&](const BindingSite::Ptr &site) {
+        site->Cover();
+        if (site->WasCovered()) {
+          // Cover promoter in cache
+          LogCover(*site);
+        }
+        site->ResetState();
+        // Report some data to tracker
+        if (pol->kind() != ElementKind::RNASE &&
+            site->CheckInteraction(InternedName::RIBOSOME)) {
+          tracker_->IncrementRibo(site->gene(), 1);
+        }
+        if (pol->kind() == ElementKind::RNASE &&
+            site->CheckInteraction(InternedName::RIBOSOME) &&
+            site->degraded() == false) {
+          // Only decrement transcript count if this binding site has
+          // been exposed and logged by SpeciesTracker before
+          if (site->first_exposure() == true) {
+            tracker_->IncrementTranscript(site->gene(), -1);
+          }
+          site->Degrade();
+        }
+      });
   // Add polymerase to this polymer
   Attach(pol);
+  if (occupancy_) {
+    occupancy_->Enter(OccupancyProfile(*pol), pol->stop(), *pol);
+  }
+  if (observers_) {
+    observers_->Bind(*this, *pol);
+  }
+  PINETREE_TRACE_EVENT(trace_, BIND, trace_id_, *pol, pol->stop());
+}
+
+void Polymer::BindMeanField(MobileElement::Ptr pol,
+                            const BindingSite::Ptr &site) {
+  if (!clock_) {
+    throw std::runtime_error("Polymer " + name_ +
+                             " must be registered with a model to translate "
+                             "genes by the mean-field approximation.");
+  }
+  double now = *clock_;
+  const MeanFieldGene &gene = MeanField(*pol, *site);
+  std::string pol_name = pol->name();
+  binding_sites_.ForEachOverlapping(
+      pol->start(), pol->stop(), [&](const BindingSite::Ptr &covered) {
+        covered->Cover();
+        if (covered->WasCovered()) {
+          LogCover(*covered);
+        }
+        covered->ResetState();
+        if (covered->CheckInteraction(InternedName::RIBOSOME)) {
+          tracker_->IncrementRibo(covered->gene(), 1);
+        }
+        // The back of the ribosome leaves the site once its start has moved
+        // past the site's stop
+        int moves = std::min(covered->stop() - pol->start() + 1, gene.moves);
+        mean_field_events_.emplace(
+            now + MeanFieldTime(*pol, 0, moves),
+            MeanFieldEvent{covered, pol_name, "", 0});
+      });
+  auto last = mean_field_last_.find(site->gene_id());
+  double finish = now + gene.transit;
+  if (last != mean_field_last_.end()) {
+    finish = std::max(finish, last->second + gene.headway);
+  }
+  mean_field_last_[site->gene_id()] = finish;
+  mean_field_events_.emplace(
+      finish, MeanFieldEvent{nullptr, pol_name, gene.gene, gene.front});
+  next_run_end_ = std::min(next_run_end_, mean_field_events_.begin()->first);
+  if (stats_) {
+    stats_->mean_field_ribosomes++;
+    stats_->mean_field_moves += gene.moves;
+  }
+}
+
+const Polymer::MeanFieldGene &Polymer::MeanField(const MobileElement &pol,
+                                                 const BindingSite &site) {
+  auto found = mean_field_genes_.find(site.gene_id());
+  if (found != mean_field_genes_.end()) {
+    return found->second;
+  }
+  // The ribosome terminates once its front reaches the stop codon of its
+  // gene, or runs off the end of the polymer if there is none
+  MeanFieldGene gene{0, 0, 0, "NA", stop_};
+  for (const auto &interval : release_intervals_) {
+    const ReleaseSite &stop_codon = *interval.value;
+    if (stop_codon.CheckInteraction(pol.type_id(), pol.reading_frame()) &&
+        stop_codon.gene_id() == site.gene_id() &&
+        stop_codon.stop() >= pol.start()) {
+      gene.gene = stop_codon.gene();
+      gene.front = stop_codon.start();
+      break;
+    }
+  }
+  gene.moves = std::max(gene.front - pol.stop(), 1);
+  gene.transit = MeanFieldTime(pol, 0, gene.moves);
+  gene.headway = MeanFieldTime(pol, 0, std::min(pol.footprint(), gene.moves));
+  // Slide a window of one footprint along the gene to find its slowest
+  // stretch
+  double window = gene.headway;
+  for (int move = pol.footprint(); move < gene.moves; move++) {
+    window += MeanFieldTime(pol, move, move + 1) -
+              MeanFieldTime(pol, move - pol.footprint(),
+                            move - pol.footprint() + 1);
+    gene.headway = std::max(gene.headway, window);
+  }
+  return mean_field_genes_.emplace(site.gene_id(), gene).first->second;
+}
+
+double Polymer::MeanFieldTime(const MobileElement &pol, int from,
+                              int to) const {
+  if (!weights_) {
+    return (to - from) / pol.speed();
+  }
+  double time = 0;
+  for (int move = from; move < to; move++) {
+    // As for a moving ribosome, the rate of a move is set by the weight of
+    // the position its front leaves
+    int index = pol.stop() + move - 1;
+    if (index < 0 || index >= static_cast<int>(weights_->size())) {
+      throw std::runtime_error("Weight is missing for this position.");
+    }
+    time += 1.0 / ((*weights_)[index] * pol.speed());
+  }
+  return time;
+}
+
+void Polymer::FinishMeanField(double until) {
+  while (!mean_field_events_.empty() &&
+         mean_field_events_.begin()->first <= until) {
+    MeanFieldEvent event = std::move(mean_field_events_.begin()->second);
+    mean_field_events_.erase(mean_field_events_.begin());
+    if (!event.site) {
+      TerminateMeanField(event);
+      continue;
+    }
+    event.site->Uncover();
+    if (event.site->WasUncovered() && !event.site->degraded()) {
+      LogUncover(*event.site);
+    }
+    event.site->ResetState();
+  }
+}
+
+void Polymer::TerminateMeanField(const MeanFieldEvent &event) {
+  if (clock_) {
+    SyncMask();
+  }
+  if (event.front >= mask_.start() || !mean_field_waiting_.empty()) {
+    mean_field_waiting_.push_back(event);
+    ReleaseMeanField();
+    return;
+  }
+  termination_signal_.Emit(wrapper(), event.pol_name, event.gene);
+}
+
+void Polymer::ReleaseMeanField() {
+  std::size_t released = 0;
+  while (released < mean_field_waiting_.size() &&
+         mean_field_waiting_[released].front < mask_.start()) {
+    released++;
+  }
+  if (released == 0) {
+    return;
+  }
+  std::vector<MeanFieldEvent> events(
+      mean_field_waiting_.begin(), mean_field_waiting_.begin() + released);
+  mean_field_waiting_.erase(mean_field_waiting_.begin(),
+                            mean_field_waiting_.begin() + released);
+  for (const auto &event : events) {
+    termination_signal_.Emit(wrapper(), event.pol_name, event.gene);
+  }
+}
+
+void Polymer::DegradeMeanField() {
+  FinishMeanField(std::numeric_limits<double>::infinity());
+  std::vector<MeanFieldEvent> events;
+  events.swap(mean_field_waiting_);
+  for (const auto &event : events) {
+    termination_signal_.Emit(wrapper(), event.pol_name, event.gene);
+  }
+  UpdateNextRunEnd();
 }
 
 void Polymer::Attach(MobileElement::Ptr pol) {
   polymerases_.Insert(pol, Polymer::Ptr());
 }
 
+void Polymer::Detach(int pol_index) {
+  polymerases_.Delete(pol_index);
+  if (skip_blocked_ && pol_index > 0) {
+    Unblock(pol_index - 1);
+  }
+}
+
+void Polymer::skip_blocked(bool enabled) {
+  skip_blocked_ = enabled;
+  for (int i = 0; !enabled && i < polymerases_.pair_count(); i++) {
+    polymerases_.Unblock(i);
+  }
+}
+
+void Polymer::Unblock(int pol_index) {
+  if (!polymerases_.Unblock(pol_index) || !tracker_) {
+    return;
+  }
+  auto wrapper = wrapper_.lock();
+  if (wrapper) {
+    tracker_->UpdatePropensity(wrapper);
+  }
+}
+
+void Polymer::ExtendTranscript(int pol_index, int positions) {
+  auto transcript = polymerases_.GetAttached(pol_index);
+  if (transcript != nullptr) {
+    for (int i = 0; i < positions; i++) {
+      transcript->ShiftMask();
+    }
+  }
+}
+
 void Polymer::Execute() {
   if (polymerases_.prop_sum() == 0) {
     throw std::runtime_error(
         "Attempting to execute polymer with reaction propensity of 0.");
   }
-  int pol_index = polymerases_.Choose();
+  int pol_index = polymerases_.Choose(*rng_);
   Move(pol_index);
 }
 
@@ -308,63 +835,204 @@ void Polymer::ShiftMask() {
   if (mask_.start() <= mask_.stop()) {
     int old_start = mask_.start();
     mask_.Move();
+    if (skip_blocked_ && polymerases_.pair_count() > 0) {
+      Unblock(polymerases_.pair_count() - 1);
+    }
     CheckBehind(old_start, mask_.start());
+    if (!mean_field_waiting_.empty()) {
+      ReleaseMeanField();
+    }
   }
 }
 
-void Polymer::LogCover(const std::string &species_name) {
-  if (uncovered_.count(species_name) == 0) {
-    uncovered_[species_name] = 0;
-  } else {
-    uncovered_[species_name]--;
-    SpeciesTracker::Instance().Increment(species_name, -1);
+int Polymer::uncovered(const std::string &name) const {
+  int id = InternedName::Id(name);
+  return id < static_cast<int>(uncovered_.size()) ? std::max(uncovered_[id], 0)
+                                                  : 0;
+}
+
+int &Polymer::UncoveredCount(int name_id) {
+  if (name_id >= static_cast<int>(uncovered_.size())) {
+    uncovered_.resize(name_id + 1, -1);
   }
-  if (uncovered_[species_name] < 0) {
-    std::string err = "Cached count of uncovered element " + species_name +
+  int &count = uncovered_[name_id];
+  if (count < 0) {
+    count = 0;
+  }
+  return count;
+}
+
+void Polymer::LogCover(const FixedElement &site) {
+  bool logged = site.name_id() < static_cast<int>(uncovered_.size()) &&
+                uncovered_[site.name_id()] >= 0;
+  int &count = UncoveredCount(site.name_id());
+  if (!logged) {
+    tracker_->IncrementUncovered(site.name(), *this, 0, 0);
+    return;
+  }
+  count--;
+  if (count < 0) {
+    std::string err = "Cached count of uncovered element " + site.name() +
                       " cannot be a negative value";
     throw std::runtime_error(err);
   }
+  tracker_->IncrementUncovered(site.name(), *this, -1, count);
+}
+
+void Polymer::LogUncover(const FixedElement &site) {
+  int &count = UncoveredCount(site.name_id());
+  count++;
+  tracker_->IncrementUncovered(site.name(), *this, 1, count);
 }
 
-void Polymer::LogUncover(const std::string &species_name) {
-  if (uncovered_.count(species_name) == 0) {
-    uncovered_[species_name] = 1;
+void Polymer::Move(int pol_index) {
+  PINETREE_ZONE("move");
+  if (codon_steps_ && polymerases_.pol(pol_index)->kind() ==
+                          ElementKind::RIBOSOME) {
+    MoveCodon(pol_index);
+    return;
+  }
+  // Stats, occupancy and observers may be switched on or off between moves
+  bool observed = stats_ || occupancy_ || observers_;
+  if (rnase_sites_ && observed) {
+    MoveElement<true, true>(pol_index);
+  } else if (rnase_sites_) {
+    MoveElement<true, false>(pol_index);
+  } else if (observed) {
+    MoveElement<false, true>(pol_index);
   } else {
-    uncovered_[species_name]++;
+    MoveElement<false, false>(pol_index);
   }
-  SpeciesTracker::Instance().Increment(species_name, 1);
 }
 
-void Polymer::Move(int pol_index) {
+void Polymer::MoveCodon(int pol_index) {
+  if (clock_) {
+    if (runs_ > 0 && polymerases_.ValidIndex(pol_index + 1)) {
+      SyncRun(pol_index + 1);
+    }
+    SyncMask();
+  }
+  const MobileElement *pol = polymerases_.pol(pol_index);
+  // Only take whole codons, so wait unless there is room for one
+  if (polymerases_.ValidIndex(pol_index + 1) &&
+      polymerases_.pol_start(pol_index + 1) - 1 - pol->stop() <
+          CODON_LENGTH) {
+    if (skip_blocked_ && !polymerases_.pol(pol_index + 1)->running()) {
+      polymerases_.Block(pol_index);
+    }
+    if (stats_) {
+      stats_->polymerase_collisions++;
+    }
+    if (observers_) {
+      observers_->Blocked(*this, *pol);
+    }
+    PINETREE_TRACE_EVENT(trace_, BLOCKED, trace_id_, *pol, pol->stop());
+    return;
+  }
+  if (mask_.start() <= stop_ && !mask_.CheckInteraction(pol->type_id()) &&
+      mask_.start() - 1 - pol->stop() < CODON_LENGTH) {
+    if (skip_blocked_ && !MaskMayRun()) {
+      polymerases_.Block(pol_index);
+    }
+    if (stats_) {
+      stats_->mask_collisions++;
+    }
+    if (observers_) {
+      observers_->Blocked(*this, *pol);
+    }
+    PINETREE_TRACE_EVENT(trace_, MASKED, trace_id_, *pol, pol->stop());
+    return;
+  }
+  bool observed = stats_ || occupancy_ || observers_;
+  for (int i = 0; i < CODON_LENGTH; i++) {
+    bool moved = observed ? MoveElement<false, true>(pol_index)
+                          : MoveElement<false, false>(pol_index);
+    if (!moved) {
+      return;
+    }
+  }
+}
+
+void Polymer::codon_steps(bool enabled) {
+  codon_steps_ = enabled;
+  polymerases_.ribosome_step(enabled ? CODON_LENGTH : 1);
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    if (polymerases_.pol(i)->kind() == ElementKind::RIBOSOME &&
+        !polymerases_.pol(i)->running() && !polymerases_.blocked(i)) {
+      polymerases_.UpdatePropensity(i);
+    }
+  }
+}
+
+template <bool kRnase, bool kObserved>
+bool Polymer::MoveElement(int pol_index) {
   auto pol = polymerases_.GetPol(pol_index);
+  // Bring anything this move can run into up to date
+  if (clock_) {
+    if (runs_ > 0 && polymerases_.ValidIndex(pol_index + 1)) {
+      SyncRun(pol_index + 1);
+    }
+    SyncMask();
+  }
 
   // Record old positions
   int old_start = pol->start();
   int old_stop = pol->stop();
 
   // Move polymerase
-  pol->Move();
+  polymerases_.Move(pol_index);
 
   // Check for upstream polymerase collision
   bool pol_collision = CheckPolCollisions(pol_index);
   if (pol_collision) {
-    pol->MoveBack();
-    return;
+    polymerases_.MoveBack(pol_index);
+    if (skip_blocked_ && !polymerases_.pol(pol_index + 1)->running()) {
+      polymerases_.Block(pol_index);
+    }
+    if (kObserved && stats_) {
+      stats_->polymerase_collisions++;
+    }
+    if (kObserved && observers_) {
+      observers_->Blocked(*this, *pol);
+    }
+    PINETREE_TRACE_EVENT(trace_, BLOCKED, trace_id_, *pol, pol->stop());
+    return false;
   }
 
   // Check for collisions with mask
   bool mask_collision = CheckMaskCollisions(pol);
   if (mask_collision) {
-    pol->MoveBack();
-    return;
+    polymerases_.MoveBack(pol_index);
+    if (skip_blocked_ && !MaskMayRun()) {
+      polymerases_.Block(pol_index);
+    }
+    if (kObserved && stats_) {
+      stats_->mask_collisions++;
+    }
+    if (kObserved && observers_) {
+      observers_->Blocked(*this, *pol);
+    }
+    PINETREE_TRACE_EVENT(trace_, MASKED, trace_id_, *pol, pol->stop());
+    return false;
+  }
+  PINETREE_TRACE_EVENT(trace_, MOVE, trace_id_, *pol, pol->stop());
+  if (kObserved && stats_) {
+    stats_->moves++;
+  }
+  if (kObserved && observers_) {
+    observers_->Move(*this, *pol);
+  }
+  if (skip_blocked_ && pol_index > 0) {
+    Unblock(pol_index - 1);
   }
 
-    // Check for new covered and uncovered elements
-  if (pol->name() == "__ribosome") {
-    // std::cout << "CheckBehind pol" << std::endl;
+  if (kObserved && occupancy_) {
+    occupancy_->Leave(OccupancyProfile(*pol), old_stop, *pol);
   }
+
+  // Check for new covered and uncovered elements
   CheckBehind(old_start, pol->start());
-  if (pol->name() == "__rnase") {
+  if (kRnase && pol->kind() == ElementKind::RNASE) {
     CheckAheadRnase(old_stop, pol->stop());
   } else {
     CheckAhead(old_stop, pol->stop());
@@ -372,174 +1040,377 @@ void Polymer::Move(int pol_index) {
   
   // Check if polymerase has run into a terminator
   bool terminating = CheckTermination(pol_index);
-  if (terminating && pol->name() != "__rnase") {
-    std::vector<Interval<BindingSite::Ptr>> results;
-    binding_sites_.findOverlapping(old_start, pol->stop(), results);
-    for (auto &interval : results) {
-      interval.value->Uncover();
-      if (interval.value->WasUncovered()) {
-        // Record changes that species was covered
-        LogUncover(interval.value->name());
-      }
-      interval.value->ResetState();
-    }
+  if (kObserved && occupancy_ && !terminating) {
+    occupancy_->Enter(OccupancyProfile(*pol), pol->stop(), *pol);
+  }
+  if (terminating) {
+    PINETREE_TRACE_EVENT(trace_, TERMINATE, trace_id_, *pol, pol->stop());
+  }
+  if (terminating && !(kRnase && pol->kind() == ElementKind::RNASE)) {
+    binding_sites_.ForEachOverlapping(
+        old_start, pol->stop(), [this](const BindingSite::Ptr &site) {
+          site->Uncover();
+          if (site->WasUncovered()) {
+            // Record changes that species was covered
+            LogUncover(*site);
+          }
+          site->ResetState();
+        });
+    return false;
+  }
+
+  ExtendTranscript(pol_index, 1);
+
+  // Update propensity for new codon (TODO: make its own function)
+  if (pol->kind() == ElementKind::RIBOSOME) {
+    polymerases_.UpdatePropensity(pol_index);
+  }
+  if (run_ahead_) {
+    StartRun(pol_index);
+  }
+  return true;
+}
+
+void Polymer::StartRun(int pol_index) {
+  if (occupancy_ || trace_ || observers_) {
+    return;
+  }
+  auto pol = polymerases_.GetPol(pol_index);
+  if (codon_steps_ && pol->kind() == ElementKind::RIBOSOME) {
+    return;
+  }
+  int steps = FreeMoves(pol_index, stop_ - start_ + 1);
+  double rate = polymerases_.propensity(pol_index);
+  if (steps < RUN_AHEAD_MIN_MOVES || rate <= 0) {
     return;
   }
+  // The moves of the run are a Poisson process of their own, so the last
+  // one comes after an Erlang-distributed time
+  double now = *clock_;
+  pol->run(steps, now, now + rng_->gamma(steps, rate));
+  polymerases_.Suspend(pol_index);
+  runs_++;
+  next_run_end_ = std::min(next_run_end_, pol->run_until());
+  if (stats_) {
+    stats_->runs++;
+  }
+}
+
+int Polymer::FreeMoves(int pol_index, int limit) {
+  const MobileElement *pol = polymerases_.pol(pol_index);
+  // Stop short of the mask, the end of the polymer and the element ahead
+  limit = std::min(limit, std::min(mask_.start(), stop_) - 1 - pol->stop());
+  if (polymerases_.ValidIndex(pol_index + 1)) {
+    limit = std::min(limit,
+                     polymerases_.pol_start(pol_index + 1) - 1 - pol->stop());
+  }
+  // Binding sites are covered once the element's front passes their start,
+  // and release sites are checked as soon as it reaches them
+  limit = std::min(limit, binding_sites_.NextStart(pol->stop()) - pol->stop());
+  limit = std::min(limit, release_sites_.NextStart(pol->stop() + 1) - 1 -
+                              pol->stop());
+  if (limit <= 0) {
+    return 0;
+  }
+  // An RNase covers the sites its front is inside again at every move
+  if (pol->kind() == ElementKind::RNASE) {
+    bool inside = false;
+    binding_sites_.ForEachOverlapping(
+        pol->stop() + 1, pol->stop() + 1,
+        [&inside](const BindingSite::Ptr &site) { inside = true; });
+    if (inside) {
+      return 0;
+    }
+  }
+  // Release sites under the element are checked again at every move
+  bool releasing = false;
+  if (MayRelease(polymerases_.GetPol(pol_index).get())) {
+    release_sites_.ForEachOverlapping(
+        pol->start(), pol->stop(), [&](const ReleaseSite::Ptr &site) {
+          if (site->CheckInteraction(pol->type_id(), pol->reading_frame()) &&
+              !site->readthrough() && pol->gene_bound_id() == site->gene_id()) {
+            releasing = true;
+          }
+        });
+  }
+  if (releasing) {
+    return 0;
+  }
+  // Binding sites behind the element are uncovered once its back leaves them
+  binding_sites_.ForEachOverlapping(
+      pol->start(), pol->start() + limit, [&](const BindingSite::Ptr &site) {
+        if (site->stop() >= pol->start()) {
+          limit = std::min(limit, site->stop() - pol->start());
+        }
+      });
+  // A ribosome's propensity changes with the weight of its position
+  if (pol->kind() == ElementKind::RIBOSOME) {
+    limit = polymerases_.UniformWeights(pol->stop() - 1, limit);
+  }
+  return FreeTranscriptShifts(pol_index, limit);
+}
 
+int Polymer::FreeMaskShifts(int limit) {
+  if (mask_.start() > mask_.stop()) {
+    return limit;
+  }
+  int start = mask_.start();
+  binding_sites_.ForEachOverlapping(
+      start, start + limit, [&](const BindingSite::Ptr &site) {
+        if (site->stop() >= start) {
+          limit = std::min(limit, site->stop() - start);
+        }
+      });
+  return limit;
+}
+
+int Polymer::FreeTranscriptShifts(int pol_index, int limit) {
   auto transcript = polymerases_.GetAttached(pol_index);
   if (transcript != nullptr) {
-    transcript->ShiftMask();
+    return transcript->FreeMaskShifts(limit);
+  }
+  return limit;
+}
+
+void Polymer::SyncRun(int pol_index) {
+  auto pol = polymerases_.GetPol(pol_index);
+  if (!pol->running()) {
+    return;
   }
+  // Given when the last move of the run happens, the others are uniformly
+  // distributed over the run
+  double now = *clock_;
+  int moves = 0;
+  if (pol->run_steps() > 1 && now > pol->run_from()) {
+    double fraction = std::min(
+        1.0, (now - pol->run_from()) / (pol->run_until() - pol->run_from()));
+    moves = rng_->binomial(pol->run_steps() - 1, fraction);
+  }
+  AdvanceRun(pol_index, moves);
+  pol->run(pol->run_steps() - moves, now, pol->run_until());
+}
 
-  // Update propensity for new codon (TODO: make its own function)
-  if (pol->name() == "__ribosome") {
-    polymerases_.UpdatePropensity(pol_index);
+void Polymer::SyncRuns() {
+  if (runs_ == 0) {
+    return;
+  }
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    SyncRun(i);
   }
 }
 
-void Polymer::CheckAhead(int old_stop, int new_stop) {
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(old_stop + 1, new_stop, results);
-  for (auto &interval : results) {
-    if (interval.value->start() < new_stop &&
-        interval.value->start() >= old_stop) {
-      interval.value->Cover();
-      if (interval.value->WasCovered()) {
-        // Record changes that species was covered
-        LogCover(interval.value->name());
-      }
-      interval.value->ResetState();
+void Polymer::SyncAttached(const Polymer *attached) {
+  if (runs_ == 0) {
+    return;
+  }
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    if (polymerases_.attached(i) == attached) {
+      SyncRun(i);
+      return;
     }
   }
 }
 
-void Polymer::CheckAheadRnase(int old_stop, int new_stop) {
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(old_stop + 1, new_stop, results);
-  for (auto &interval : results) {
-    if (interval.value->start() < new_stop) {
-      interval.value->Cover();
-      if (interval.value->WasCovered()) {
-        // Record changes that species was covered
-        LogCover(interval.value->name());
-      }
-      if (interval.value->gene() != "" &&
-          interval.value->first_exposure() == true &&
-          interval.value->degraded() == false) {
-        degraded_elements_ += 1;
-        SpeciesTracker::Instance().IncrementTranscript(interval.value->gene(),
-                                                       -1);
-      }
-      interval.value->Degrade();
-      interval.value->ResetState();
+void Polymer::AdvanceRun(int pol_index, int steps) {
+  if (steps == 0) {
+    return;
+  }
+  int old_start = polymerases_.pol_start(pol_index);
+  polymerases_.Shift(pol_index, steps);
+  if (skip_blocked_ && pol_index > 0) {
+    Unblock(pol_index - 1);
+  }
+  // Only release sites can be uncovered behind a run
+  CheckBehind(old_start, polymerases_.pol_start(pol_index));
+  ExtendTranscript(pol_index, steps);
+  if (stats_) {
+    stats_->moves += steps;
+  }
+}
+
+void Polymer::FinishRuns() {
+  double now = *clock_;
+  FinishMeanField(now);
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    const MobileElement *pol = polymerases_.pol(i);
+    if (!pol->running() || pol->run_until() > now) {
+      continue;
+    }
+    AdvanceRun(i, pol->run_steps());
+    polymerases_.GetPol(i)->run(0, 0, 0);
+    runs_--;
+    polymerases_.Resume(i);
+    if (run_ahead_) {
+      StartRun(i);
     }
   }
+  UpdateNextRunEnd();
+}
+
+void Polymer::UpdateNextRunEnd() {
+  next_run_end_ = std::numeric_limits<double>::infinity();
+  for (int i = 0; runs_ > 0 && i < polymerases_.pair_count(); i++) {
+    const MobileElement *pol = polymerases_.pol(i);
+    if (pol->running()) {
+      next_run_end_ = std::min(next_run_end_, pol->run_until());
+    }
+  }
+  if (!mean_field_events_.empty()) {
+    next_run_end_ = std::min(next_run_end_, mean_field_events_.begin()->first);
+  }
+}
+
+void Polymer::CheckAhead(int old_stop, int new_stop) {
+  PINETREE_ZONE("check ahead");
+  binding_sites_.ForEachOverlapping(
+      old_stop + 1, new_stop, [&](const BindingSite::Ptr &site) {
+        if (site->start() < new_stop && site->start() >= old_stop) {
+          site->Cover();
+          if (site->WasCovered()) {
+            // Record changes that species was covered
+            LogCover(*site);
+          }
+          site->ResetState();
+        }
+      });
+}
+
+void Polymer::CheckAheadRnase(int old_stop, int new_stop) {
+  PINETREE_ZONE("check ahead");
+  binding_sites_.ForEachOverlapping(
+      old_stop + 1, new_stop, [&](const BindingSite::Ptr &site) {
+        if (site->start() < new_stop) {
+          site->Cover();
+          if (site->WasCovered()) {
+            // Record changes that species was covered
+            LogCover(*site);
+          }
+          if (site->gene_id() != InternedName::NONE &&
+              site->first_exposure() == true &&
+              site->degraded() == false) {
+            degraded_elements_ += 1;
+            tracker_->IncrementTranscript(site->gene(), -1);
+          }
+          site->Degrade();
+          site->ResetState();
+        }
+      });
 }
 
 void Polymer::CheckBehind(int old_start, int new_start) {
-  std::vector<Interval<BindingSite::Ptr>> results;
-  binding_sites_.findOverlapping(old_start, new_start + 1, results);
-  for (auto &interval : results) {
-    // std::cout << interval.value->name() + " " +
-    //                  std::to_string(interval.value->start()) +
-    //                  std::to_string(interval.value->stop()) + " " +
-    //                  std::to_string(new_start)
-    //           << std::endl;
-    if (interval.value->stop() < new_start) {
-      // std::cout << interval.value->name() << std::endl;
-      interval.value->Uncover();
-      if (interval.value->WasUncovered()) {
-        if (interval.value->CheckInteraction("__ribosome")) {
-          // std::cout << "RBS uncovered!" << std::endl;
+  PINETREE_ZONE("check behind");
+  binding_sites_.ForEachOverlapping(
+      old_start, new_start + 1, [&](const BindingSite::Ptr &site) {
+        if (site->stop() < new_start) {
+          site->Uncover();
+          if (site->WasUncovered()) {
+            // Record changes that species was covered
+            LogUncover(*site);
+            // Is this a new transcript?
+            if (!site->first_exposure() &&
+                site->CheckInteraction(InternedName::RIBOSOME)) {
+              tracker_->ExposeTranscript(site->gene());
+              site->first_exposure(true);
+              total_elements_ += 1;
+            }
+          }
+          site->ResetState();
         }
-        // Record changes that species was covered
-        LogUncover(interval.value->name());
-        // Is this a new transcript?
-        if (!interval.value->first_exposure() &&
-            interval.value->CheckInteraction("__ribosome")) {
-          SpeciesTracker::Instance().IncrementTranscript(interval.value->gene(),
-                                                         1);
-          interval.value->first_exposure(true);
-          total_elements_ += 1;
+      });
+
+  release_sites_.ForEachOverlapping(
+      old_start, new_start + 1, [&](const ReleaseSite::Ptr &site) {
+        if (site->stop() < new_start) {
+          site->Uncover();
+          if (site->WasUncovered()) {
+            // Uncovering a terminator resets its readthrough state
+            site->readthrough(false);
+          }
+          site->ResetState();
         }
-      }
-      interval.value->ResetState();
-    }
-  }
-
-  std::vector<Interval<ReleaseSite::Ptr>> term_results;
-  release_sites_.findOverlapping(old_start, new_start + 1, term_results);
-  for (auto &interval : term_results) {
-    if (interval.value->stop() < new_start) {
-      interval.value->Uncover();
-      // if (interval.value->name() != "stop_codon") {
-      //   std::cout << "Terminator uncovered!" + interval.value->name()
-      //             << std::endl;
-      //   std::cout << interval.value->IsCovered() << std::endl;
-      // }
-      if (interval.value->WasUncovered()) {
-        // Record changes that species was covered
-        // LogUncover(interval.value->name());
-        // Is this a terminator being uncovered?
-        // if (interval.value->name() != "stop_codon") {
-        //   std::cout << "Readthrough set to false!" << std::endl;
-        // }
-        interval.value->readthrough(false);
-      }
-      interval.value->ResetState();
-    }
-  }
+      });
 }
 
 bool Polymer::CheckTermination(int pol_index) {
+  PINETREE_ZONE("check termination");
   auto pol = polymerases_.GetPol(pol_index);
   if (pol->stop() >= stop_) {
-    if (pol->name() == "__rnase") {
+    if (observers_) {
+      observers_->Terminate(*this, *pol);
+    }
+    if (pol->kind() == ElementKind::RNASE) {
       // std::cout << "rnase ran off end of transcript" << std::endl;
-      polymerases_.Delete(pol_index);
+      Detach(pol_index);
       degrade_ = true;
+      DegradeMeanField();
+      if (observers_) {
+        observers_->Degrade(*this);
+      }
       return true;
     } else {
       termination_signal_.Emit(wrapper(), pol->name(), "NA");
-      polymerases_.Delete(pol_index);
+      Detach(pol_index);
       return true;
     }
   }
-  std::vector<Interval<ReleaseSite::Ptr>> results;
-  release_sites_.findOverlapping(pol->start(), pol->stop(), results);
-  for (auto &interval : results) {
-    if (interval.value->CheckInteraction(pol->name(), pol->reading_frame()) &&
-        !interval.value->readthrough() &&
-        pol->gene_bound() == interval.value->gene()) {
-      // terminate
-      // std::cout << pol->name() + " " + interval.value->name() << std::endl;
-      double random_num = Random::random();
-      if (random_num <= interval.value->efficiency(pol->name())) {
-        // std::cout << pol->name() + " terminating" << std::endl;
-        // Fire Emit signal until entire terminator is uncovered
-        // Coordinates are inclusive, so must add 1 after calculating
-        // difference
-        int dist = interval.value->stop() - pol->stop() + 1;
-        auto transcript = polymerases_.GetAttached(pol_index);
-        if (transcript != nullptr) {
-          for (int i = 0; i < dist; i++) {
-            transcript->ShiftMask();
+  if (!MayRelease(pol.get())) {
+    return false;
+  }
+  bool terminated = false;
+  release_sites_.ForEachOverlapping(
+      pol->start(), pol->stop(), [&](const ReleaseSite::Ptr &site) {
+        if (terminated ||
+            !site->CheckInteraction(pol->type_id(), pol->reading_frame()) ||
+            site->readthrough() || pol->gene_bound_id() != site->gene_id()) {
+          return;
+        }
+        double random_num = rng_->random();
+        if (random_num <= site->efficiency(pol->type_id())) {
+          // Fire Emit signal until entire terminator is uncovered
+          // Coordinates are inclusive, so must add 1 after calculating
+          // difference
+          int dist = site->stop() - pol->stop() + 1;
+          ExtendTranscript(pol_index, dist);
+          auto transcript = polymerases_.GetAttached(pol_index);
+          if (transcript != nullptr) {
+            transcript->attached(false);
+          }
+          if (observers_) {
+            observers_->Terminate(*this, *pol);
+          }
+          termination_signal_.Emit(wrapper(), pol->name(), site->gene());
+          Detach(pol_index);
+          terminated = true;
+        } else {
+          site->Cover();
+          site->ResetState();
+          site->readthrough(true);
+          if (stats_) {
+            stats_->readthroughs++;
           }
-          transcript->attached(false);
         }
-        termination_signal_.Emit(wrapper(), pol->name(),
-                                 interval.value->gene());
-        polymerases_.Delete(pol_index);
-        return true;
-      } else {
-        interval.value->Cover();
-        interval.value->ResetState();
-        // std::cout << "Readthrough set to true!" << std::endl;
-        interval.value->readthrough(true);
-      }
+      });
+  return terminated;
+}
+
+bool Polymer::MayRelease(MobileElement *pol) {
+  if (pol->release_stop() < pol->start()) {
+    // The cached site is behind the element, so find the next one. Elements
+    // only move forward, so the sites it skips can never release it.
+    int index = release_sites_.FindEnding(
+        pol->start(), [pol](const ReleaseSite::Ptr &site) {
+          return site->CheckInteraction(pol->type_id(),
+                                        pol->reading_frame()) &&
+                 pol->gene_bound_id() == site->gene_id();
+        });
+    if (index < release_sites_.size()) {
+      pol->release(release_sites_.start(index), release_sites_.stop(index));
+    } else {
+      pol->release(std::numeric_limits<int>::max(),
+                   std::numeric_limits<int>::max());
     }
   }
-  return false;
+  return pol->stop() >= pol->release_start();
 }
 
 bool Polymer::CheckMaskCollisions(MobileElement::Ptr pol) {
@@ -551,13 +1422,17 @@ bool Polymer::CheckMaskCollisions(MobileElement::Ptr pol) {
           " is overlapping mask by more than one position on polymer";
       throw std::runtime_error(err);
     }
-    if (mask_.CheckInteraction(pol->name())) {
+    if (mask_.CheckInteraction(pol->type_id())) {
       ShiftMask();
     } else {
-      if (pol->name() == "__rnase" && attached_ == false &&
+      if (pol->kind() == ElementKind::RNASE && attached_ == false &&
           degraded_elements_ == total_elements_ &&
           polymerases_.pol_count() == 0) {
         degrade_ = true;
+        DegradeMeanField();
+        if (observers_) {
+          observers_->Degrade(*this);
+        }
       }
       return true;
     }
@@ -565,30 +1440,34 @@ bool Polymer::CheckMaskCollisions(MobileElement::Ptr pol) {
   return false;
 }
 
+std::string Polymer::OverlapError(int index, int next_index) const {
+  const MobileElement *pol = polymerases_.pol(index);
+  const MobileElement *next_pol = polymerases_.pol(next_index);
+  return "Polymerase " + pol->name() + " (start: " +
+         std::to_string(pol->start()) + ", stop: " +
+         std::to_string(pol->stop()) + ", index: " + std::to_string(index) +
+         ") is overlapping polymerase " + next_pol->name() + " (start: " +
+         std::to_string(next_pol->start()) + ", stop: " +
+         std::to_string(next_pol->stop()) + ", index: " +
+         std::to_string(next_index) + ") by more than one position on polymer " +
+         name_;
+}
+
 bool Polymer::CheckPolCollisions(int pol_index) {
-  auto this_pol = polymerases_.GetPol(pol_index);
   if (!polymerases_.ValidIndex(pol_index + 1)) {
     // Are there any polymerases ahead of this one?
     return false;
   }
-  auto next_pol = polymerases_.GetPol(pol_index + 1);
   // We only need to check the polymerase one position ahead of this
   // polymerase
-  if ((this_pol->stop() >= next_pol->start()) &&
-      (next_pol->stop() >= this_pol->start())) {
-    // Error checking. TODO: Can this be removed?
-    if (this_pol->stop() - next_pol->start() > 1) {
-      std::string err = "Polymerase " + this_pol->name() +
-                        " (start: " + std::to_string(this_pol->start()) +
-                        ", stop: " + std::to_string(this_pol->stop()) +
-                        ", index: " + std::to_string(pol_index) +
-                        ") is overlapping polymerase " + next_pol->name() +
-                        " (start: " + std::to_string(next_pol->start()) +
-                        ", stop: " + std::to_string(next_pol->stop()) +
-                        ", index: " + std::to_string(pol_index + 1) +
-                        ") by more than one position on polymer " + name_;
-      throw std::runtime_error(err);
-    }
+  int this_start = polymerases_.pol_start(pol_index);
+  int this_stop = polymerases_.pol_stop(pol_index);
+  int next_start = polymerases_.pol_start(pol_index + 1);
+  int next_stop = polymerases_.pol_stop(pol_index + 1);
+  if ((this_stop >= next_start) && (next_stop >= this_start)) {
+    // Elements only ever move one position at a time
+    PINETREE_CHECK(this_stop - next_start <= 1,
+                   OverlapError(pol_index, pol_index + 1));
     return true;
   }
   return false;
@@ -596,21 +1475,18 @@ bool Polymer::CheckPolCollisions(int pol_index) {
 
 Transcript::Transcript(
     const std::string &name, int start, int stop,
-    const std::vector<Interval<BindingSite::Ptr>> &rbs_intervals,
-    const std::vector<Interval<ReleaseSite::Ptr>> &stop_site_intervals,
-    const Mask &mask, const std::vector<double> &weights)
-    : Polymer(name, start, stop) {
+    std::vector<Interval<BindingSite::Ptr>> rbs_intervals,
+    std::vector<Interval<ReleaseSite::Ptr>> stop_site_intervals,
+    const Mask &mask, std::shared_ptr<const std::vector<double>> weights)
+    : Polymer(name, start, stop, weights) {
   mask_ = mask;
-  weights_ = weights;
-  polymerases_ = MobileElementManager(weights_);
-  binding_intervals_ = rbs_intervals;
-  release_intervals_ = stop_site_intervals;
+  binding_intervals_ = std::move(rbs_intervals);
+  release_intervals_ = std::move(stop_site_intervals);
   attached_ = true;
 }
 
 Transcript::Transcript(const std::string &name, int length)
     : Polymer(name, 1, length) {
-  weights_ = std::vector<double>(length, 1.0);
   attached_ = false;
   mask_ = Mask(stop_ + 1, stop_, std::map<std::string, double>());
 }
@@ -618,6 +1494,54 @@ Transcript::Transcript(const std::string &name, int length)
 void Transcript::Initialize() {
   Polymer::Initialize();
   polymerases_ = MobileElementManager(weights_);
+  polymerases_.ribosome_step(codon_steps_ ? CODON_LENGTH : 1);
+}
+
+void Transcript::Recycle() {
+  auto genome = genome_.lock();
+  if (genome) {
+    genome->RecycleTranscript(
+        std::static_pointer_cast<Transcript>(shared_from_this()));
+  }
+}
+
+void Transcript::Memory(MemoryReport &report) const {
+  Memory(report, "transcripts");
+}
+
+void Transcript::Memory(MemoryReport &report,
+                        const std::string &subsystem) const {
+  MemoryOf(report, subsystem, sizeof(Transcript));
+  report.Add(subsystem, 0, MemoryReport::Bytes(bindings_));
+  if (definition_ && report.First(definition_.get())) {
+    report.Add("definitions", 1,
+               sizeof(Definition) +
+                   MemoryReport::Bytes(definition_->steps) +
+                   MemoryReport::Bytes(definition_->calls));
+  }
+}
+
+void Transcript::Reset(const std::vector<BindingSite> &rbs_sites,
+                       const std::vector<ReleaseSite> &stop_sites,
+                       const Mask &mask) {
+  for (std::size_t i = 0; i < rbs_sites.size(); i++) {
+    *binding_intervals_[i].value = rbs_sites[i];
+  }
+  for (std::size_t i = 0; i < stop_sites.size(); i++) {
+    *release_intervals_[i].value = stop_sites[i];
+  }
+  mask_ = mask;
+  degrade_ = false;
+  attached_ = true;
+  std::fill(uncovered_.begin(), uncovered_.end(), -1);
+  runs_ = 0;
+  next_run_end_ = std::numeric_limits<double>::infinity();
+  mean_field_events_.clear();
+  mean_field_waiting_.clear();
+  mean_field_last_.clear();
+  // Whoever registers the transcript again connects to it anew
+  termination_signal_.DisconnectAll();
+  wrapper_.reset();
 }
 
 void Transcript::AddGene(const std::string &name, int start, int stop,
@@ -628,14 +1552,25 @@ void Transcript::AddGene(const std::string &name, int start, int stop,
                                            rbs_stop, binding);
   rbs->gene(name);
   rbs->reading_frame(start % 3);
-  binding_intervals_.emplace_back(rbs->start(), rbs->stop(), rbs);
-  bindings_["__" + name + "_rbs"] = binding;
   auto stop_codon =
       std::make_shared<ReleaseSite>("stop_codon", stop - 1, stop, term);
   stop_codon->reading_frame(start % 3);
   stop_codon->gene(name);
-  release_intervals_.emplace_back(stop_codon->start(), stop_codon->stop(),
-                                  stop_codon);
+  Define([=](Transcript &transcript) {
+    transcript.binding_intervals_.emplace_back(rbs->start(), rbs->stop(),
+                                               rbs->Clone());
+    transcript.bindings_["__" + name + "_rbs"] = binding;
+    transcript.release_intervals_.emplace_back(
+        stop_codon->start(), stop_codon->stop(), stop_codon->Clone());
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(GENE);
+    writer.Write(name);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+    writer.Write<int32_t>(rbs_start);
+    writer.Write<int32_t>(rbs_stop);
+    writer.Write(rbs_strength);
+  });
 }
 
 void Transcript::AddWeights(const std::vector<double> &transcript_weights) {
@@ -644,7 +1579,88 @@ void Transcript::AddWeights(const std::vector<double> &transcript_weights) {
                             std::to_string(transcript_weights.size()) + " " +
                             std::to_string(stop_ - start_ + 1));
   }
-  weights_ = transcript_weights;
+  auto weights =
+      std::make_shared<const std::vector<double>>(transcript_weights);
+  Define([weights](Transcript &transcript) { transcript.weights_ = weights; },
+         [&](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(WEIGHTS);
+           writer.Write(transcript_weights);
+         });
+}
+
+void Transcript::Define(const std::function<void(Transcript &)> &step,
+                        const std::function<void(CheckpointWriter &)> &call) {
+  step(*this);
+  // Clones share one definition until one of them is extended
+  if (!definition_ || definition_.use_count() > 1) {
+    definition_ = definition_ ? std::make_shared<Definition>(*definition_)
+                              : std::make_shared<Definition>();
+  }
+  definition_->steps.push_back(step);
+  CheckpointWriter writer;
+  call(writer);
+  definition_->calls += writer.buffer();
+}
+
+void Transcript::SyncMask() {
+  if (!attached_) {
+    return;
+  }
+  auto genome = genome_.lock();
+  if (genome) {
+    genome->SyncAttached(this);
+  }
+}
+
+Transcript::Ptr Transcript::Clone() const {
+  auto transcript = std::make_shared<Transcript>(name_, stop_);
+  if (definition_) {
+    for (const auto &step : definition_->steps) {
+      step(*transcript);
+    }
+    transcript->definition_ = definition_;
+  }
+  return transcript;
+}
+
+void Transcript::SaveDefinition(CheckpointWriter &writer) const {
+  writer.Write(name_);
+  writer.Write<int32_t>(stop_);
+  writer.Write(definition_ ? definition_->calls : std::string());
+}
+
+Transcript::Ptr Transcript::LoadDefinition(CheckpointReader &reader) {
+  std::string name;
+  reader.Read(name);
+  int length = reader.Read<int32_t>();
+  auto transcript = std::make_shared<Transcript>(name, length);
+  std::string calls;
+  reader.Read(calls);
+  CheckpointReader call_reader(calls);
+  while (!call_reader.done()) {
+    switch (call_reader.Read<uint8_t>()) {
+      case GENE: {
+        std::string gene;
+        call_reader.Read(gene);
+        int start = call_reader.Read<int32_t>();
+        int stop = call_reader.Read<int32_t>();
+        int rbs_start = call_reader.Read<int32_t>();
+        int rbs_stop = call_reader.Read<int32_t>();
+        transcript->AddGene(gene, start, stop, rbs_start, rbs_stop,
+                            call_reader.Read<double>());
+        break;
+      }
+      case WEIGHTS: {
+        std::vector<double> weights;
+        call_reader.Read(weights);
+        transcript->AddWeights(weights);
+        break;
+      }
+      default:
+        throw std::runtime_error("Unknown call in transcript definition.");
+    }
+  }
+  return transcript;
 }
 
 void Transcript::Bind(MobileElement::Ptr pol,
@@ -667,7 +1683,6 @@ Genome::Genome(const std::string &name, int length,
       transcript_degradation_rate_ext_(transcript_degradation_rate_ext),
       rnase_speed_(rnase_speed),
       rnase_footprint_(rnase_footprint) {
-  transcript_weights_ = std::vector<double>(length, 1.0);
   if (transcript_degradation_rate_ext != 0 || transcript_degradation_rate != 0) {
     if (!(rnase_speed_ != 0 && rnase_footprint_ != 0)) {
       throw std::runtime_error(
@@ -678,9 +1693,29 @@ Genome::Genome(const std::string &name, int length,
 
 void Genome::Initialize() {
   Polymer::Initialize();
-  transcript_rbs_ = IntervalTree<BindingSite::Ptr>(transcript_rbs_intervals_);
-  transcript_stop_sites_ =
-      IntervalTree<ReleaseSite::Ptr>(transcript_stop_site_intervals_);
+  if (!transcript_sites_) {
+    IndexTranscriptSites();
+  }
+}
+
+void Genome::IndexTranscriptSites() {
+  std::set<std::string> mean_field = mean_field_translation_;
+  for (const auto &interval : transcript_rbs_intervals_) {
+    interval.value->mean_field(mean_field_translation_.count(
+                                   interval.value->gene()) != 0);
+    mean_field.erase(interval.value->gene());
+  }
+  if (!mean_field.empty()) {
+    throw std::invalid_argument("Genome " + name_ + " has no gene named '" +
+                                *mean_field.begin() +
+                                "' to translate by the mean-field "
+                                "approximation.");
+  }
+  transcript_sites_ = std::make_shared<TranscriptSites>();
+  transcript_sites_->rbs =
+      SiteIndex<BindingSite::Ptr>(transcript_rbs_intervals_);
+  transcript_sites_->stop_sites =
+      SiteIndex<ReleaseSite::Ptr>(transcript_stop_site_intervals_);
 }
 
 void Genome::AddMask(int start, const std::vector<std::string> &interactions) {
@@ -688,46 +1723,226 @@ void Genome::AddMask(int start, const std::vector<std::string> &interactions) {
   for (auto name : interactions) {
     interaction_map[name] = 1.0;
   }
-  mask_ = Mask(start, stop_, interaction_map);
+  Define([=](Genome &genome) {
+    genome.mask_ = Mask(start, genome.stop_, interaction_map);
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(MASK);
+    writer.Write<int32_t>(start);
+    writer.Write(interactions);
+  });
 }
 
 void Genome::AddPromoter(const std::string &name, int start, int stop,
                          const std::map<std::string, double> &interactions) {
   BindingSite::Ptr promoter =
       std::make_shared<BindingSite>(name, start, stop, interactions);
-  binding_intervals_.emplace_back(start, stop, promoter);
-  bindings_[name] = interactions;
+  Define([=](Genome &genome) {
+    genome.binding_intervals_.emplace_back(start, stop, promoter->Clone());
+    genome.bindings_[name] = interactions;
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(PROMOTER);
+    writer.Write(name);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+    writer.Write(interactions);
+  });
 }
 
 const std::map<std::string, std::map<std::string, double>> &Genome::bindings() {
   return bindings_;
 }
 
+std::vector<std::string> Genome::gene_names() const {
+  std::vector<std::string> names;
+  for (const auto &interval : transcript_stop_site_intervals_) {
+    names.push_back(interval.value->gene());
+  }
+  return names;
+}
+
 void Genome::AddTerminator(const std::string &name, int start, int stop,
                            const std::map<std::string, double> &efficiency) {
   ReleaseSite::Ptr terminator =
       std::make_shared<ReleaseSite>(name, start, stop, efficiency);
-  // New code for IntervalTree
-  release_intervals_.emplace_back(start, stop, terminator);
+  Define([=](Genome &genome) {
+    genome.release_intervals_.emplace_back(start, stop, terminator->Clone());
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(TERMINATOR);
+    writer.Write(name);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+    writer.Write(efficiency);
+  });
 }
 
-// TODO: Add error checking to make sure rbs does not overlap with terminator
-void Genome::AddGene(const std::string &name, int start, int stop,
-                     int rbs_start, int rbs_stop, double rbs_strength) {
+/**
+ * Throw std::invalid_argument unless every column of a bulk definition has
+ * as many entries as there are features.
+ */
+static void CheckColumns(const std::string &what, std::size_t count,
+                         const std::vector<std::size_t> &sizes) {
+  for (std::size_t size : sizes) {
+    if (size != count) {
+      throw std::invalid_argument(
+          "Every column of " + what + " must have the same length (" +
+          std::to_string(count) + " and " + std::to_string(size) + ").");
+    }
+  }
+}
+
+/**
+ * Rows of a bulk definition given as one value per polymerase and feature,
+ * so that each row can be applied as the map individual definitions take.
+ */
+static std::vector<std::map<std::string, double>> Rows(
+    const std::string &what, std::size_t count,
+    const std::map<std::string, std::vector<double>> &columns) {
+  std::vector<std::map<std::string, double>> rows(count);
+  for (const auto &column : columns) {
+    CheckColumns(what, count, {column.second.size()});
+    for (std::size_t i = 0; i < count; i++) {
+      rows[i].emplace(column.first, column.second[i]);
+    }
+  }
+  return rows;
+}
+
+void Genome::AddPromoters(
+    const std::vector<std::string> &names, const std::vector<int> &starts,
+    const std::vector<int> &stops,
+    const std::map<std::string, std::vector<double>> &interactions) {
+  CheckColumns("promoters", names.size(), {starts.size(), stops.size()});
+  auto rows = Rows("promoters", names.size(), interactions);
+  std::vector<BindingSite::Ptr> promoters;
+  promoters.reserve(names.size());
+  for (std::size_t i = 0; i < names.size(); i++) {
+    promoters.push_back(
+        std::make_shared<BindingSite>(names[i], starts[i], stops[i], rows[i]));
+  }
+  Define([=](Genome &genome) {
+    genome.binding_intervals_.reserve(genome.binding_intervals_.size() +
+                                      promoters.size());
+    for (std::size_t i = 0; i < promoters.size(); i++) {
+      genome.binding_intervals_.emplace_back(starts[i], stops[i],
+                                             promoters[i]->Clone());
+      genome.bindings_[names[i]] = rows[i];
+    }
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(PROMOTERS);
+    writer.Write(names);
+    writer.Write(starts);
+    writer.Write(stops);
+    writer.Write(interactions);
+  });
+}
+
+void Genome::AddTerminators(
+    const std::vector<std::string> &names, const std::vector<int> &starts,
+    const std::vector<int> &stops,
+    const std::map<std::string, std::vector<double>> &efficiency) {
+  CheckColumns("terminators", names.size(), {starts.size(), stops.size()});
+  auto rows = Rows("terminators", names.size(), efficiency);
+  std::vector<ReleaseSite::Ptr> terminators;
+  terminators.reserve(names.size());
+  for (std::size_t i = 0; i < names.size(); i++) {
+    terminators.push_back(
+        std::make_shared<ReleaseSite>(names[i], starts[i], stops[i], rows[i]));
+  }
+  Define([=](Genome &genome) {
+    genome.release_intervals_.reserve(genome.release_intervals_.size() +
+                                      terminators.size());
+    for (std::size_t i = 0; i < terminators.size(); i++) {
+      genome.release_intervals_.emplace_back(starts[i], stops[i],
+                                             terminators[i]->Clone());
+    }
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(TERMINATORS);
+    writer.Write(names);
+    writer.Write(starts);
+    writer.Write(stops);
+    writer.Write(efficiency);
+  });
+}
+
+/**
+ * Ribosome binding site and stop codon of a gene.
+ */
+static std::pair<BindingSite::Ptr, ReleaseSite::Ptr> GeneSites(
+    const std::string &name, int start, int stop, int rbs_start, int rbs_stop,
+    double rbs_strength) {
   auto binding = std::map<std::string, double>{{"__ribosome", rbs_strength}};
   auto term = std::map<std::string, double>{{"__ribosome", 1.0}};
   auto rbs = std::make_shared<BindingSite>("__" + name + "_rbs", rbs_start,
                                            rbs_stop, binding);
   rbs->gene(name);
   rbs->reading_frame(start % 3);
-  transcript_rbs_intervals_.emplace_back(rbs->start(), rbs->stop(), rbs);
-  bindings_["__" + name + "_rbs"] = binding;
   auto stop_codon =
       std::make_shared<ReleaseSite>("stop_codon", stop - 1, stop, term);
   stop_codon->reading_frame(start % 3);
   stop_codon->gene(name);
-  transcript_stop_site_intervals_.emplace_back(stop_codon->start(),
-                                               stop_codon->stop(), stop_codon);
+  return std::make_pair(rbs, stop_codon);
+}
+
+// TODO: Add error checking to make sure rbs does not overlap with terminator
+void Genome::AddGene(const std::string &name, int start, int stop,
+                     int rbs_start, int rbs_stop, double rbs_strength) {
+  auto sites = GeneSites(name, start, stop, rbs_start, rbs_stop, rbs_strength);
+  auto binding = std::map<std::string, double>{{"__ribosome", rbs_strength}};
+  Define([=](Genome &genome) {
+    genome.transcript_rbs_intervals_.emplace_back(
+        sites.first->start(), sites.first->stop(), sites.first->Clone());
+    genome.bindings_["__" + name + "_rbs"] = binding;
+    genome.transcript_stop_site_intervals_.emplace_back(
+        sites.second->start(), sites.second->stop(), sites.second->Clone());
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(GENE);
+    writer.Write(name);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+    writer.Write<int32_t>(rbs_start);
+    writer.Write<int32_t>(rbs_stop);
+    writer.Write(rbs_strength);
+  });
+}
+
+void Genome::AddGenes(const std::vector<std::string> &names,
+                      const std::vector<int> &starts,
+                      const std::vector<int> &stops,
+                      const std::vector<int> &rbs_starts,
+                      const std::vector<int> &rbs_stops,
+                      const std::vector<double> &rbs_strengths) {
+  CheckColumns("genes", names.size(),
+               {starts.size(), stops.size(), rbs_starts.size(),
+                rbs_stops.size(), rbs_strengths.size()});
+  std::vector<std::pair<BindingSite::Ptr, ReleaseSite::Ptr>> genes;
+  genes.reserve(names.size());
+  for (std::size_t i = 0; i < names.size(); i++) {
+    genes.push_back(GeneSites(names[i], starts[i], stops[i], rbs_starts[i],
+                              rbs_stops[i], rbs_strengths[i]));
+  }
+  Define([=](Genome &genome) {
+    genome.transcript_rbs_intervals_.reserve(
+        genome.transcript_rbs_intervals_.size() + genes.size());
+    genome.transcript_stop_site_intervals_.reserve(
+        genome.transcript_stop_site_intervals_.size() + genes.size());
+    for (std::size_t i = 0; i < genes.size(); i++) {
+      const auto &rbs = genes[i].first;
+      const auto &stop_codon = genes[i].second;
+      genome.transcript_rbs_intervals_.emplace_back(rbs->start(), rbs->stop(),
+                                                    rbs->Clone());
+      genome.bindings_[rbs->name()] = {{"__ribosome", rbs_strengths[i]}};
+      genome.transcript_stop_site_intervals_.emplace_back(
+          stop_codon->start(), stop_codon->stop(), stop_codon->Clone());
+    }
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(GENES);
+    writer.Write(names);
+    writer.Write(starts);
+    writer.Write(stops);
+    writer.Write(rbs_starts);
+    writer.Write(rbs_stops);
+    writer.Write(rbs_strengths);
+  });
 }
 
 void Genome::AddRnaseSite(int start, int stop) {
@@ -735,8 +1950,14 @@ void Genome::AddRnaseSite(int start, int stop) {
       std::map<std::string, double>{{"__rnase", transcript_degradation_rate_}};
   auto rnase_site =
       std::make_shared<BindingSite>("__rnase_site", start, stop, binding);
-  transcript_rbs_intervals_.emplace_back(rnase_site->start(),
-                                         rnase_site->stop(), rnase_site);
+  Define([=](Genome &genome) {
+    genome.transcript_rbs_intervals_.emplace_back(
+        rnase_site->start(), rnase_site->stop(), rnase_site->Clone());
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(RNASE_SITE);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+  });
 }
 
 //Overloading allows for user to specify a rnase rate constant unique to this site
@@ -757,17 +1978,49 @@ void Genome::AddRnaseSite(const std::string &name, int start,
       std::map<std::string, double>{{"__rnase", transcript_degradation_rate}};
   auto rnase_site =
       std::make_shared<BindingSite>(name, start, stop, binding);
-  transcript_rbs_intervals_.emplace_back(rnase_site->start(),
-                                         rnase_site->stop(), rnase_site);
 
   //rnase sites need to have unique names
   //Otherwise propensity calculations will be incorrect                                      
   if (rnase_bindings_.count(name) != 0) {
     throw std::runtime_error(
         "Rnase site name '" + name + "' already in use.");
-  } else {
-    rnase_bindings_[name] = transcript_degradation_rate;
   }
+  Define([=](Genome &genome) {
+    genome.transcript_rbs_intervals_.emplace_back(
+        rnase_site->start(), rnase_site->stop(), rnase_site->Clone());
+    genome.rnase_bindings_[name] = transcript_degradation_rate;
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(UNIQUE_RNASE_SITE);
+    writer.Write(name);
+    writer.Write<int32_t>(start);
+    writer.Write<int32_t>(stop);
+    writer.Write(transcript_degradation_rate);
+  });
+}
+
+void Genome::AddRnaseSites(const std::vector<int> &starts,
+                           const std::vector<int> &stops) {
+  CheckColumns("rnase sites", starts.size(), {stops.size()});
+  auto binding =
+      std::map<std::string, double>{{"__rnase", transcript_degradation_rate_}};
+  std::vector<BindingSite::Ptr> rnase_sites;
+  rnase_sites.reserve(starts.size());
+  for (std::size_t i = 0; i < starts.size(); i++) {
+    rnase_sites.push_back(std::make_shared<BindingSite>(
+        "__rnase_site", starts[i], stops[i], binding));
+  }
+  Define([=](Genome &genome) {
+    genome.transcript_rbs_intervals_.reserve(
+        genome.transcript_rbs_intervals_.size() + rnase_sites.size());
+    for (const auto &rnase_site : rnase_sites) {
+      genome.transcript_rbs_intervals_.emplace_back(
+          rnase_site->start(), rnase_site->stop(), rnase_site->Clone());
+    }
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(RNASE_SITES);
+    writer.Write(starts);
+    writer.Write(stops);
+  });
 }
 
 void Genome::AddWeights(const std::vector<double> &transcript_weights) {
@@ -776,45 +2029,300 @@ void Genome::AddWeights(const std::vector<double> &transcript_weights) {
                             std::to_string(transcript_weights.size()) + " " +
                             std::to_string(stop_ - start_ + 1));
   }
-  transcript_weights_ = transcript_weights;
+  auto weights =
+      std::make_shared<const std::vector<double>>(transcript_weights);
+  Define([weights](Genome &genome) { genome.transcript_weights_ = weights; },
+         [&](CheckpointWriter &writer) {
+           writer.Write<uint8_t>(WEIGHTS);
+           writer.Write(transcript_weights);
+         });
+}
+
+void Genome::MeanFieldTranslation(const std::string &gene_name,
+                                  bool enabled) {
+  Define([=](Genome &genome) {
+    if (enabled) {
+      genome.mean_field_translation_.insert(gene_name);
+    } else {
+      genome.mean_field_translation_.erase(gene_name);
+    }
+  }, [&](CheckpointWriter &writer) {
+    writer.Write<uint8_t>(MEAN_FIELD);
+    writer.Write(gene_name);
+    writer.Write(enabled);
+  });
+}
+
+void Genome::Define(const std::function<void(Genome &)> &step,
+                    const std::function<void(CheckpointWriter &)> &call) {
+  step(*this);
+  transcript_sites_.reset();
+  // Clones share one definition until one of them is extended
+  if (!definition_ || definition_.use_count() > 1) {
+    definition_ = definition_ ? std::make_shared<Definition>(*definition_)
+                              : std::make_shared<Definition>();
+  }
+  definition_->steps.push_back(step);
+  CheckpointWriter writer;
+  call(writer);
+  definition_->calls += writer.buffer();
+}
+
+Genome::Ptr Genome::Clone() const {
+  auto genome = std::make_shared<Genome>(
+      name_, stop_, transcript_degradation_rate_ext_, rnase_speed_,
+      rnase_footprint_, transcript_degradation_rate_);
+  if (definition_) {
+    for (const auto &step : definition_->steps) {
+      step(*genome);
+    }
+    genome->definition_ = definition_;
+  }
+  return genome;
+}
+
+Genome::Ptr Genome::Copy() {
+  auto genome = Clone();
+  if (!transcript_sites_) {
+    IndexTranscriptSites();
+  }
+  genome->transcript_sites_ = transcript_sites_;
+  return genome;
+}
+
+void Genome::SaveDefinition(CheckpointWriter &writer) const {
+  writer.Write(name_);
+  writer.Write<int32_t>(stop_);
+  writer.Write(transcript_degradation_rate_ext_);
+  writer.Write(rnase_speed_);
+  writer.Write<int32_t>(rnase_footprint_);
+  writer.Write(transcript_degradation_rate_);
+  writer.Write(definition_ ? definition_->calls : std::string());
+}
+
+Genome::Ptr Genome::LoadDefinition(CheckpointReader &reader) {
+  std::string name;
+  reader.Read(name);
+  int length = reader.Read<int32_t>();
+  double degradation_rate_ext = reader.Read<double>();
+  double rnase_speed = reader.Read<double>();
+  int rnase_footprint = reader.Read<int32_t>();
+  double degradation_rate = reader.Read<double>();
+  auto genome =
+      std::make_shared<Genome>(name, length, degradation_rate_ext, rnase_speed,
+                               rnase_footprint, degradation_rate);
+  std::string calls;
+  reader.Read(calls);
+  CheckpointReader call_reader(calls);
+  while (!call_reader.done()) {
+    std::string feature;
+    std::vector<std::string> names;
+    std::vector<int> starts, stops, rbs_starts, rbs_stops;
+    std::map<std::string, double> values;
+    std::map<std::string, std::vector<double>> columns;
+    std::vector<double> weights;
+    int start, stop, rbs_start, rbs_stop;
+    switch (call_reader.Read<uint8_t>()) {
+      case MASK:
+        start = call_reader.Read<int32_t>();
+        call_reader.Read(names);
+        genome->AddMask(start, names);
+        break;
+      case PROMOTER:
+        call_reader.Read(feature);
+        start = call_reader.Read<int32_t>();
+        stop = call_reader.Read<int32_t>();
+        call_reader.Read(values);
+        genome->AddPromoter(feature, start, stop, values);
+        break;
+      case TERMINATOR:
+        call_reader.Read(feature);
+        start = call_reader.Read<int32_t>();
+        stop = call_reader.Read<int32_t>();
+        call_reader.Read(values);
+        genome->AddTerminator(feature, start, stop, values);
+        break;
+      case GENE:
+        call_reader.Read(feature);
+        start = call_reader.Read<int32_t>();
+        stop = call_reader.Read<int32_t>();
+        rbs_start = call_reader.Read<int32_t>();
+        rbs_stop = call_reader.Read<int32_t>();
+        genome->AddGene(feature, start, stop, rbs_start, rbs_stop,
+                        call_reader.Read<double>());
+        break;
+      case RNASE_SITE:
+        start = call_reader.Read<int32_t>();
+        stop = call_reader.Read<int32_t>();
+        genome->AddRnaseSite(start, stop);
+        break;
+      case UNIQUE_RNASE_SITE:
+        call_reader.Read(feature);
+        start = call_reader.Read<int32_t>();
+        stop = call_reader.Read<int32_t>();
+        genome->AddRnaseSite(feature, start, stop, call_reader.Read<double>());
+        break;
+      case WEIGHTS:
+        call_reader.Read(weights);
+        genome->AddWeights(weights);
+        break;
+      case PROMOTERS:
+        call_reader.Read(names);
+        call_reader.Read(starts);
+        call_reader.Read(stops);
+        call_reader.Read(columns);
+        genome->AddPromoters(names, starts, stops, columns);
+        break;
+      case TERMINATORS:
+        call_reader.Read(names);
+        call_reader.Read(starts);
+        call_reader.Read(stops);
+        call_reader.Read(columns);
+        genome->AddTerminators(names, starts, stops, columns);
+        break;
+      case GENES:
+        call_reader.Read(names);
+        call_reader.Read(starts);
+        call_reader.Read(stops);
+        call_reader.Read(rbs_starts);
+        call_reader.Read(rbs_stops);
+        call_reader.Read(weights);
+        genome->AddGenes(names, starts, stops, rbs_starts, rbs_stops, weights);
+        break;
+      case RNASE_SITES:
+        call_reader.Read(starts);
+        call_reader.Read(stops);
+        genome->AddRnaseSites(starts, stops);
+        break;
+      case MEAN_FIELD:
+        call_reader.Read(feature);
+        genome->MeanFieldTranslation(feature, call_reader.Read<uint8_t>());
+        break;
+      default:
+        throw std::runtime_error("Unknown call in genome definition.");
+    }
+  }
+  return genome;
 }
 
 void Genome::Attach(MobileElement::Ptr pol) {
-  Transcript::Ptr transcript = BuildTranscript(pol->stop(), stop_);
-  polymerases_.Insert(pol, transcript);
-  transcript_signal_.Emit(transcript);
+  int start = pol->stop();
+  int exposed_at = FindTranscriptLayout(start, stop_).exposed_at;
+  nascent_[pol.get()] = NascentTranscript{start, start, exposed_at};
+  polymerases_.Insert(pol, Polymer::Ptr());
 }
 
-Transcript::Ptr Genome::BuildTranscript(int start, int stop) {
-  std::vector<Interval<BindingSite::Ptr>> prom_results;
-  std::vector<Interval<BindingSite::Ptr>> rbs_intervals;
-  transcript_rbs_.findContained(start, stop, prom_results);
-  for (auto &interval : prom_results) {
-    int istart = interval.start;
-    int istop = interval.stop;
-    auto elem = interval.value;
-    rbs_intervals.emplace_back(istart, istop, elem->Clone());
+void Genome::Detach(int pol_index) {
+  if (!nascent_.empty()) {
+    nascent_.erase(polymerases_.GetPol(pol_index).get());
   }
+  Polymer::Detach(pol_index);
+}
 
-  // Add __rnase_site
-  if (transcript_degradation_rate_ext_ != 0) {
-    // std::cout << "Adding degradation site" << std::endl;
-    rbs_intervals.emplace_back(
-        start + 1, start + 1 + 10,
-        std::make_shared<BindingSite>(
-            "__rnase_site_ext", start + 1, start + 1 + 10,
-            std::map<std::string, double>{
-                {"__rnase", transcript_degradation_rate_ext_}}));
+void Genome::ExtendTranscript(int pol_index, int positions) {
+  auto transcript = polymerases_.GetAttached(pol_index);
+  if (transcript != nullptr) {
+    for (int i = 0; i < positions; i++) {
+      transcript->ShiftMask();
+    }
+    return;
+  }
+  auto nascent = nascent_.find(polymerases_.GetPol(pol_index).get());
+  if (nascent == nascent_.end()) {
+    return;
+  }
+  nascent->second.mask_start += positions;
+  if (nascent->second.mask_start < nascent->second.exposed_at) {
+    return;
   }
+  // Build the transcript as it was when the polymerase bound, then catch its
+  // mask up with the polymerase
+  Guard guard(guard_);
+  int start = nascent->second.start;
+  int shifts = nascent->second.mask_start - start;
+  nascent_.erase(nascent);
+  auto built = BuildTranscript(start, stop_);
+  polymerases_.SetAttached(pol_index, built);
+  transcript_signal_.Emit(built);
+  for (int i = 0; i < shifts; i++) {
+    built->ShiftMask();
+  }
+}
+
+int Genome::FreeTranscriptShifts(int pol_index, int limit) {
+  if (polymerases_.attached(pol_index) != nullptr) {
+    return Polymer::FreeTranscriptShifts(pol_index, limit);
+  }
+  // Stop short of building the transcript
+  auto nascent = nascent_.find(polymerases_.pol(pol_index));
+  if (nascent == nascent_.end()) {
+    return limit;
+  }
+  return std::min(limit, nascent->second.exposed_at -
+                             nascent->second.mask_start - 1);
+}
 
-  std::vector<Interval<ReleaseSite::Ptr>> term_results;
+void Genome::Save(CheckpointWriter &writer,
+                  const std::function<int(const Polymer::Ptr &)> &polymer_id)
+    const {
+  Polymer::Save(writer, polymer_id);
+  writer.Write<uint32_t>(nascent_.size());
+  for (int i = 0; i < polymerases_.pair_count(); i++) {
+    auto pol = polymerases_.pol(i);
+    auto nascent = nascent_.find(pol);
+    if (nascent != nascent_.end()) {
+      writer.Write<int32_t>(i);
+      writer.Write<int32_t>(nascent->second.start);
+      writer.Write<int32_t>(nascent->second.mask_start);
+    }
+  }
+}
+
+void Genome::Load(CheckpointReader &reader,
+                  const std::function<Polymer::Ptr(int)> &polymer) {
+  Polymer::Load(reader, polymer);
+  nascent_.clear();
+  int count = reader.Read<uint32_t>();
+  for (int i = 0; i < count; i++) {
+    int index = reader.Read<int32_t>();
+    CheckpointReader::Expect(index >= 0 && index < polymerases_.pair_count(),
+                             "polymerase of unbuilt transcript");
+    int start = reader.Read<int32_t>();
+    int mask_start = reader.Read<int32_t>();
+    nascent_[polymerases_.pol(index)] = NascentTranscript{
+        start, mask_start, FindTranscriptLayout(start, stop_).exposed_at};
+  }
+}
+
+Transcript::Ptr Genome::BuildTranscript(int start, int stop) {
+  PINETREE_ZONE("build transcript");
+  TranscriptLayout &layout = FindTranscriptLayout(start, stop);
+  if (!layout.recycled.empty()) {
+    auto transcript = std::move(layout.recycled.back());
+    layout.recycled.pop_back();
+    transcript->Reset(layout.rbs_sites, layout.stop_sites,
+                      Mask(start, stop, std::map<std::string, double>()));
+    transcript->genome(std::static_pointer_cast<Genome>(shared_from_this()));
+    return transcript;
+  }
+  // Copy each kind of site into a single block, so that building a transcript
+  // takes a constant number of allocations however many genes it carries.
+  // Site names and interactions stay shared with the layout.
+  auto rbs_block =
+      MakePooled<std::vector<BindingSite>>(pool_, layout.rbs_sites);
+  std::vector<Interval<BindingSite::Ptr>> rbs_intervals;
+  rbs_intervals.reserve(rbs_block->size());
+  for (auto &site : *rbs_block) {
+    rbs_intervals.emplace_back(site.start(), site.stop(),
+                               BindingSite::Ptr(rbs_block, &site));
+  }
+  auto stop_block =
+      MakePooled<std::vector<ReleaseSite>>(pool_, layout.stop_sites);
   std::vector<Interval<ReleaseSite::Ptr>> stop_site_intervals;
-  transcript_stop_sites_.findContained(start, stop, term_results);
-  for (auto &interval : term_results) {
-    int istart = interval.start;
-    int istop = interval.stop;
-    auto elem = interval.value;
-    stop_site_intervals.emplace_back(istart, istop, elem->Clone());
+  stop_site_intervals.reserve(stop_block->size());
+  for (auto &site : *stop_block) {
+    stop_site_intervals.emplace_back(site.start(), site.stop(),
+                                     ReleaseSite::Ptr(stop_block, &site));
   }
 
   Transcript::Ptr transcript;
@@ -822,8 +2330,101 @@ Transcript::Ptr Genome::BuildTranscript(int start, int stop) {
   // We need to used the standard shared_ptr constructor here because the
   // constructor of Transcript needs to know its address in memory to wire
   // signals appropriately.
-  transcript = std::make_shared<Transcript>("__rna", start, stop_,
-                                            rbs_intervals, stop_site_intervals,
-                                            mask, transcript_weights_);
+  transcript = MakePooled<Transcript>(
+      pool_, "__rna", start, stop_, std::move(rbs_intervals),
+      std::move(stop_site_intervals), mask, transcript_weights_);
+  transcript->genome(std::static_pointer_cast<Genome>(shared_from_this()));
   return transcript;
-}
\ No newline at end of file
+}
+
+void Genome::Memory(MemoryReport &report) const {
+  MemoryOf(report, "genomes", sizeof(Genome));
+  report.Add("genomes", 0,
+             MemoryReport::Bytes(transcript_rbs_intervals_) +
+                 MemoryReport::Bytes(transcript_stop_site_intervals_) +
+                 MemoryReport::Bytes(mean_field_translation_) +
+                 MemoryReport::Bytes(nascent_) +
+                 MemoryReport::Bytes(bindings_) +
+                 MemoryReport::Bytes(rnase_bindings_));
+  for (const auto &interval : transcript_rbs_intervals_) {
+    if (report.First(interval.value.get())) {
+      report.Add("sites", 1, sizeof(BindingSite));
+    }
+  }
+  for (const auto &interval : transcript_stop_site_intervals_) {
+    if (report.First(interval.value.get())) {
+      report.Add("sites", 1, sizeof(ReleaseSite));
+    }
+  }
+  if (transcript_weights_ && report.First(transcript_weights_.get())) {
+    report.Add("weights", 1, MemoryReport::Bytes(*transcript_weights_));
+  }
+  if (definition_ && report.First(definition_.get())) {
+    report.Add("definitions", 1,
+               sizeof(Definition) +
+                   MemoryReport::Bytes(definition_->steps) +
+                   MemoryReport::Bytes(definition_->calls));
+  }
+  // Layouts are shared by the copies of this genome
+  if (!transcript_sites_ || !report.First(transcript_sites_.get())) {
+    return;
+  }
+  std::size_t bytes = sizeof(TranscriptSites) +
+                      transcript_sites_->rbs.memory() +
+                      transcript_sites_->stop_sites.memory() +
+                      MemoryReport::Bytes(transcript_sites_->layouts);
+  for (const auto &layout : transcript_sites_->layouts) {
+    bytes += MemoryReport::Bytes(layout.second.rbs_sites) +
+             MemoryReport::Bytes(layout.second.stop_sites) +
+             MemoryReport::Bytes(layout.second.recycled);
+    for (const auto &transcript : layout.second.recycled) {
+      transcript->Memory(report, "recycled");
+    }
+  }
+  report.Add("layouts", transcript_sites_->layouts.size(), bytes);
+}
+
+void Genome::RecycleTranscript(Transcript::Ptr transcript) {
+  if (!transcript_sites_) {
+    return;
+  }
+  auto layout = transcript_sites_->layouts.find(
+      std::make_pair(transcript->start(), transcript->stop()));
+  if (layout != transcript_sites_->layouts.end()) {
+    layout->second.recycled.push_back(std::move(transcript));
+  }
+}
+
+Genome::TranscriptLayout &Genome::FindTranscriptLayout(int start, int stop) {
+  auto key = std::make_pair(start, stop);
+  auto &layouts = transcript_sites_->layouts;
+  auto it = layouts.find(key);
+  if (it != layouts.end()) {
+    return it->second;
+  }
+  TranscriptLayout &layout = layouts[key];
+  transcript_sites_->rbs.ForEachContained(
+      start, stop, [&layout](const BindingSite::Ptr &site) {
+        layout.rbs_sites.push_back(*site);
+      });
+
+  // Add __rnase_site
+  if (transcript_degradation_rate_ext_ != 0) {
+    layout.rbs_sites.emplace_back(
+        "__rnase_site_ext", start + 1, start + 1 + 10,
+        std::map<std::string, double>{
+            {"__rnase", transcript_degradation_rate_ext_}});
+  }
+
+  transcript_sites_->stop_sites.ForEachContained(
+      start, stop, [&layout](const ReleaseSite::Ptr &site) {
+        layout.stop_sites.push_back(*site);
+      });
+  // A site is uncovered once the mask starts past its stop; transcripts
+  // without binding sites are never built
+  layout.exposed_at = std::numeric_limits<int>::max();
+  for (const auto &site : layout.rbs_sites) {
+    layout.exposed_at = std::min(layout.exposed_at, site.stop() + 1);
+  }
+  return layout;
+}
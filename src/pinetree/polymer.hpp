@@ -3,25 +3,85 @@
 #ifndef SRC_POLYMER_HPP_  // header guard
 #define SRC_POLYMER_HPP_
 
+#include <functional>
+#include <limits>
 #include <map>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "IntervalTree.h"
+#include "site_index.hpp"
 #include "feature.hpp"
+#include "guard.hpp"
+#include "memory_pool.hpp"
+#include "memory_report.hpp"
+#include "observer.hpp"
+#include "occupancy.hpp"
+#include "propensity_tree.hpp"
+#include "trace.hpp"
 
 /**
  * Hack-y forward declaration.
  */
+class Genome;
 class Polymer;
 class PolymerWrapper;
+class Random;
 class Reaction;
+class SpeciesTracker;
+
+/**
+ * Counts of what happened to mobile elements and polymers, shared by all
+ * polymers of a simulation.
+ */
+struct PolymerStats {
+  /**
+   * Moves that advanced an element.
+   */
+  long long moves = 0;
+  /**
+   * Moves blocked by the element ahead and by the polymer's mask.
+   */
+  long long polymerase_collisions = 0;
+  long long mask_collisions = 0;
+  /**
+   * Terminators read through rather than terminated at.
+   */
+  long long readthroughs = 0;
+  long long transcripts_created = 0;
+  long long transcripts_destroyed = 0;
+  /**
+   * Runs of moves taken in one event (see Polymer::StartRun). Their moves
+   * are also counted in moves.
+   */
+  long long runs = 0;
+  /**
+   * Ribosomes translated by the mean-field approximation (see
+   * Genome::MeanFieldTranslation), and the moves they stood in for.
+   */
+  long long mean_field_ribosomes = 0;
+  long long mean_field_moves = 0;
+  /**
+   * Save or restore all counts.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  /**
+   * Add the counts of another set of counters, then reset those to 0.
+   */
+  void Collect(PolymerStats &other);
+};
 
 /**
  * Manages all MobileElements (e.g., polymerases and ribosomes) on a Polymer.
  * MobileElements are maintained in order. It also tracks any polymers
  * (transcripts) that may be attached to a polymerase. This class also tracks
- * the total propensity of all the MobileElements.
+ * the total propensity of all the MobileElements in a PropensityTree, so that
+ * choosing a MobileElement to move and updating its propensity take
+ * O(log n) time.
  */
 class MobileElementManager {
  public:
@@ -31,6 +91,14 @@ class MobileElementManager {
    * @param weights Base-pair specific movement weights.
    */
   MobileElementManager(const std::vector<double> &weights);
+  /**
+   * Construct a MobileElementManager that shares its movement weights with
+   * other polymers (e.g. all transcripts of a genome).
+   *
+   * @param weights Base-pair specific movement weights, or null if every
+   *  position has a weight of 1.
+   */
+  MobileElementManager(std::shared_ptr<const std::vector<double>> weights);
   /**
    * Insert an MobileElement-Polymer pair while maintaining order of
    * MobileElements
@@ -50,16 +118,19 @@ class MobileElementManager {
    * Return a randomly selected MobileElement, weighted by speed and base-pair
    * specific weights.
    *
+   * @param rng random number generator to draw from
    * @return index of MobileElement-Polymer pair
    */
-  int Choose();
+  int Choose(Random &rng);
   /**
    * Is this a valid index?
    *
    * @param index Index of MobileElement-Polymer pair
    * @return true if index is valid
    */
-  bool ValidIndex(int index) { return index < polymerases_.size(); };
+  bool ValidIndex(int index) {
+    return index < static_cast<int>(elements_.size());
+  };
   /**
    * Get a Polymer at a given index.
    *
@@ -73,25 +144,92 @@ class MobileElementManager {
    * @return pointer to Polymer
    */
   std::shared_ptr<Polymer> GetAttached(int index);
+  /**
+   * Attach a Polymer to the MobileElement at a given index, e.g. a transcript
+   * built after its polymerase bound.
+   */
+  void SetAttached(int index, std::shared_ptr<Polymer> polymer);
+  /**
+   * Move the MobileElement at a given index one position forward or back,
+   * or forward by several positions at once. Elements must only be moved
+   * through these once inserted, so that their positions here stay current.
+   *
+   * @param index Index of MobileElement-Polymer pair
+   */
+  void Move(int index);
+  void MoveBack(int index);
+  void Shift(int index, int steps);
   /**
    * Update movement propensity of MobileElement at a given index.
    *
    * @param index Index of MobileElement-Polymer pair
    */
   void UpdatePropensity(int index);
+  /**
+   * Stop the MobileElement at a given index from being chosen while it runs
+   * ahead, and restore its propensity afterwards.
+   *
+   * @param index Index of MobileElement-Polymer pair
+   */
+  void Suspend(int index) { prop_tree_.Update(index, 0.0); }
+  void Resume(int index);
+  /**
+   * Stop the MobileElement at a given index from being chosen while it is
+   * blocked by the element or mask ahead of it, or let it be chosen again.
+   *
+   * @param index Index of MobileElement-Polymer pair
+   * @return true if the element was blocked before Unblock
+   */
+  void Block(int index) {
+    blocked_[index] = true;
+    prop_tree_.Update(index, 0.0);
+  }
+  bool Unblock(int index);
+  bool blocked(int index) const { return blocked_[index]; }
+  /**
+   * Number of positions, up to limit, from a given position on that have the
+   * same movement weight as that position.
+   */
+  int UniformWeights(int position, int limit) const;
+  /**
+   * Number of positions a ribosome moves per event (1, or 3 when stepping by
+   * codon). Ribosome propensities are divided by it, so that ribosomes keep
+   * their speed in positions per second. Setting it does not update the
+   * propensities of elements already inserted.
+   */
+  int ribosome_step() const { return ribosome_step_; }
+  void ribosome_step(int step) { ribosome_step_ = step; }
   /**
    * Getters and setters.
    */
-  double prop_sum() { return prop_sum_; }
+  double prop_sum() { return prop_tree_.total(); }
+  double propensity(int index) const { return prop_tree_.value(index); }
   int pol_count() { return pol_count_; }
-  int pair_count() const { return polymerases_.size(); }
-  int pol_start(int index) const { return polymerases_[index].first->start(); }
-
- private:
+  int pair_count() const { return elements_.size(); }
+  int pol_start(int index) const { return spans_[index].start; }
+  int pol_stop(int index) const { return spans_[index].stop; }
+  const MobileElement *pol(int index) const { return elements_[index].get(); }
+  const Polymer *attached(int index) const { return attached_[index].get(); }
   /**
-   * Total propensity sum of all MobileElements being tracked
+   * Save or restore all elements and their propensities.
+   *
+   * @param polymer_id ID of an attached polymer (-1 for none)
+   * @param polymer attached polymer with a given ID (null for -1)
+   * @param pool pool to allocate restored elements from
    */
-  double prop_sum_ = 0;
+  void Save(CheckpointWriter &writer,
+            const std::function<int(const std::shared_ptr<Polymer> &)>
+                &polymer_id) const;
+  void Load(CheckpointReader &reader,
+            const std::function<std::shared_ptr<Polymer>(int)> &polymer,
+            const MemoryPool::Ptr &pool);
+  /**
+   * Add the elements, their propensities and the movement weights to a
+   * memory report.
+   */
+  void Memory(MemoryReport &report) const;
+
+ private:
   /**
    * Total number of polymerases (anything except RNases). Used to make sure
    * that there are no active polymerases left on the polymer before degrading
@@ -99,19 +237,60 @@ class MobileElementManager {
    */
   int pol_count_ = 0;
   /**
-   * Vector of propensities corresponding to each MobileElement-Polymer pair
+   * Propensities corresponding to each MobileElement-Polymer pair, in the same
+   * order as elements_
+   */
+  PropensityTree prop_tree_;
+  /**
+   * MobileElements in order of position, and the polymer (if any) attached
+   * to each.
+   */
+  std::vector<std::shared_ptr<MobileElement>> elements_;
+  std::vector<std::shared_ptr<Polymer>> attached_;
+  /**
+   * Which elements_ are blocked (see Block).
+   */
+  std::vector<bool> blocked_;
+  /**
+   * Positions of elements_, copied into one array so that collision checks
+   * and finding where to insert read neighbouring memory instead of
+   * following a pointer per element.
    */
-  std::vector<double> prop_list_;
+  struct Span {
+    int start;
+    int stop;
+  };
+  std::vector<Span> spans_;
   /**
-   * MobileElement-Polymer pairs
+   * Copy the position of an element into spans_.
    */
-  std::vector<
-      std::pair<std::shared_ptr<MobileElement>, std::shared_ptr<Polymer>>>
-      polymerases_;
+  void Sync(int index) {
+    spans_[index] = Span{elements_[index]->start(), elements_[index]->stop()};
+  }
   /**
-   * Base-pair specific movement weights.
+   * Base-pair specific movement weights, or null if they are all 1.
    */
-  std::vector<double> weights_;
+  std::shared_ptr<const std::vector<double>> weights_;
+  int ribosome_step_ = 1;
+  /**
+   * Propensity of a ribosome, from its speed and the weight of the position
+   * it would move onto.
+   */
+  double RibosomePropensity(const MobileElement &pol) const {
+    return Weight(pol.stop() - 1) * pol.speed() / ribosome_step_;
+  }
+  /**
+   * Weight of the position a MobileElement would move onto.
+   */
+  double Weight(int index) const {
+    if (!weights_) {
+      return 1.0;
+    }
+    if (index < 0 || index >= static_cast<int>(weights_->size())) {
+      throw std::runtime_error("Weight is missing for this position.");
+    }
+    return (*weights_)[index];
+  }
 };
 
 /**
@@ -146,6 +325,15 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    *     are currently inaccessible
    */
   Polymer(const std::string &name, int start, int stop);
+  /**
+   * Construct a Polymer whose movement weights are shared with other
+   * polymers.
+   *
+   * @param weights base-pair specific movement weights, or null if every
+   *  position has a weight of 1
+   */
+  Polymer(const std::string &name, int start, int stop,
+          std::shared_ptr<const std::vector<double>> weights);
   /**
    * Remove from promoter-polymer lap. Error checking to make sure this
    * polymer is no longer linked to a polymerase. Make sure there are no
@@ -198,6 +386,66 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    * Shift mask by 1 base-pair and check for uncovered elements.
    */
   virtual void ShiftMask();
+  /**
+   * Let elements run ahead: an element with a long stretch of moves ahead
+   * of it that cannot change any propensity (no site to cover or uncover,
+   * no element or mask to run into, uniform weights) takes the whole
+   * stretch in one scheduled event. Since nothing else depends on its
+   * moves, they form a Poisson process of their own, so the run takes an
+   * Erlang-distributed time and the element's position in between is drawn
+   * from the exact conditional distribution whenever it is needed, e.g.
+   * when the element behind it moves. An RNase runs up to the next binding
+   * site, which it then degrades in a move of its own. Runs are not taken
+   * while occupancy or events are being recorded on the polymer.
+   *
+   * @param enabled whether to start runs
+   * @param clock simulation clock
+   */
+  void run_ahead(bool enabled, const double *clock) {
+    run_ahead_ = enabled;
+    clock_ = clock;
+  }
+  /**
+   * Let ribosomes step a codon (three positions) at a time, at a third of
+   * the rate, so that translation takes a third of the events. A ribosome
+   * only takes whole codons: it waits if the element or mask ahead leaves
+   * less than a codon of room, and it covers, uncovers and checks sites for
+   * termination at every position it passes as if it had moved one position
+   * at a time. Ribosomes stepping by codon do not run ahead.
+   *
+   * @param enabled whether ribosomes step by codon
+   */
+  void codon_steps(bool enabled);
+  bool codon_steps() const { return codon_steps_; }
+  /**
+   * Give an element that is blocked by the element or mask ahead of it a
+   * propensity of 0 instead of letting it take moves that change nothing,
+   * and restore its propensity once the element ahead moves or leaves or
+   * the mask shifts. The trajectories have the same distribution as
+   * without it, but blocked elements no longer use up events, and each
+   * wait counts as one collision in stats(). Elements are not blocked by
+   * an element or mask that is running ahead (see run_ahead), since it
+   * moves without telling the elements behind it.
+   *
+   * @param enabled whether blocked elements wait
+   */
+  void skip_blocked(bool enabled);
+  bool skip_blocked() const { return skip_blocked_; }
+  /**
+   * Finish the runs that end at the current time, starting new ones where
+   * possible.
+   */
+  void FinishRuns();
+  /**
+   * @return time at which the next run on this polymer ends, or infinity
+   */
+  double next_run_end() const { return next_run_end_; }
+  /**
+   * Bring the element that a polymer is attached to (e.g. the polymerase
+   * making a transcript) up to date with the current time, if it is running
+   * ahead.
+   */
+  void SyncAttached(const Polymer *attached);
 
   /**
    * Getters and setters. There are two getters for prop_sum_... mostly to
@@ -205,20 +453,88 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    */
   void index(int index) { index_ = index; }
   int index() { return index_; }
+  const std::string &name() const { return name_; }
   double prop_sum() { return polymerases_.prop_sum(); }
-  int uncovered(const std::string &name) { return uncovered_[name]; }
+  int uncovered(const std::string &name) const;
   int start() const { return start_; }
   int stop() const { return stop_; }
   bool degrade() { return degrade_; }
   bool attached() { return attached_; }
   void attached(bool attached) { attached_ = attached; }
   void wrapper(std::shared_ptr<PolymerWrapper> wrapper) { wrapper_ = wrapper; }
+  /**
+   * Hand this polymer back to whatever built it, once it has been degraded
+   * and unlinked from the simulation, so that it can be reused. Only called
+   * while nothing else refers to the polymer.
+   */
+  virtual void Recycle() {}
   std::shared_ptr<PolymerWrapper> wrapper() { return wrapper_.lock(); }
+  void tracker(std::shared_ptr<SpeciesTracker> tracker) { tracker_ = tracker; }
+  void rng(std::shared_ptr<Random> rng) { rng_ = rng; }
+  const MemoryPool::Ptr &pool() const { return pool_; }
+  void pool(MemoryPool::Ptr pool) { pool_ = pool; }
   const std::vector<Interval<BindingSite::Ptr>>& GetBindingIntervals() { return binding_intervals_; }
   const std::vector<Interval<ReleaseSite::Ptr>>& GetReleaseIntervals() { return release_intervals_; }
   const Mask& GetMask() { return mask_; }
   int num_attached() const { return polymerases_.pair_count(); }
   int attached_pol_start(int index) const { return polymerases_.pol_start(index); }
+  /**
+   * Mobile elements on this polymer, in order of position.
+   */
+  const MobileElementManager &mobile_elements() const { return polymerases_; }
+  /**
+   * Bring the positions of all elements running ahead up to date (see
+   * run_ahead), e.g. before reading them through mobile_elements().
+   */
+  void SyncRuns();
+  /**
+   * Record the occupancy of mobile elements on this polymer.
+   *
+   * @param profiles profiles to record into, or nullptr to stop recording
+   * @param name name under which this polymer's profiles are aggregated
+   */
+  void occupancy(OccupancyProfiles::Ptr profiles, const std::string &name);
+  /**
+   * Record the movements of mobile elements on this polymer. Only has an
+   * effect in builds with PINETREE_TRACE defined.
+   *
+   * @param trace trace to record into, or nullptr to stop recording
+   * @param id ID of this polymer in the trace
+   */
+  void trace(EventTrace::Ptr trace, uint32_t id) {
+    trace_ = trace;
+    trace_id_ = id;
+  }
+  /**
+   * Report binding, moves, collisions, terminations and degradation on this
+   * polymer to observers. Elements do not run ahead while observed, so
+   * that every move is reported.
+   *
+   * @param observers observers to report to, or nullptr to stop reporting
+   */
+  void observers(Observers::Ptr observers) { observers_ = observers; }
+  /**
+   * Counters to record into, or nullptr to not count.
+   */
+  PolymerStats *stats() const { return stats_.get(); }
+  void stats(std::shared_ptr<PolymerStats> stats) { stats_ = stats; }
+  /**
+   * Add an estimate of the memory held by this polymer, its sites and the
+   * elements bound to it to a report.
+   */
+  virtual void Memory(MemoryReport &report) const;
+  /**
+   * Save or restore the simulation state of this polymer: its mask, bound
+   * elements, and the cover state of its sites. Sites themselves come from
+   * the polymer's definition and must match.
+   *
+   * @param polymer_id ID of an attached polymer (-1 for none)
+   * @param polymer attached polymer with a given ID (null for -1)
+   */
+  virtual void Save(CheckpointWriter &writer,
+                    const std::function<int(const Ptr &)> &polymer_id) const;
+  virtual void Load(CheckpointReader &reader,
+                    const std::function<Ptr(int)> &polymer);
 
   /**
    * Signal to fire when a polymerase terminates.
@@ -229,6 +545,21 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
 
  protected:
   std::weak_ptr<PolymerWrapper> wrapper_;
+  /**
+   * Tracker of the Model that this polymer is registered with.
+   */
+  std::shared_ptr<SpeciesTracker> tracker_;
+  /**
+   * Random number generator of the Model that this polymer is registered
+   * with.
+   */
+  std::shared_ptr<Random> rng_;
+  /**
+   * Memory pool of the Model that this polymer is registered with, used for
+   * polymerases bound to it and transcripts built from it. Null if the
+   * polymer is not registered.
+   */
+  MemoryPool::Ptr pool_;
   int index_;
   /**
    * Name of polymer
@@ -273,28 +604,218 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    */
   std::vector<Interval<ReleaseSite::Ptr>> release_intervals_;
   /**
-   * Interval tree of binding sites
+   * Have binding_sites_ and release_sites_ been built from the intervals?
+   * Recycled transcripts keep theirs, since their sites are reset in place.
    */
-  IntervalTree<BindingSite::Ptr> binding_sites_;
+  bool indexed_ = false;
   /**
-   * Interval tree of release sites
+   * Index of binding sites
    */
-  IntervalTree<ReleaseSite::Ptr> release_sites_;
+  SiteIndex<BindingSite::Ptr> binding_sites_;
+  /**
+   * Index of release sites
+   */
+  SiteIndex<ReleaseSite::Ptr> release_sites_;
   /**
    * Mask corresponding to this polymer. Controls which elements are hidden.
    */
   Mask mask_ = Mask(0, 0, std::map<std::string, double>());
   /**
-   * Cached count of uncovered elements on this polymer, used by Model.
+   * Can an RNase bind anywhere on this polymer? Set from the binding sites
+   * by Initialize. Elements on polymers without RNase sites are moved by a
+   * variant of Move that leaves out RNase handling.
+   */
+  bool rnase_sites_ = true;
+  /**
+   * Cached count of uncovered elements on this polymer, used by Model,
+   * indexed by the interned ID of each site name (see
+   * FixedElement::name_id); -1 for names that were never logged.
    */
-  std::map<std::string, int> uncovered_;
+  std::vector<int> uncovered_;
   /**
    * Vector of the same length as this polymer, containing weights for different
    * positions along the polymer. When a polymerase passes over a given position
    * in the genome, the weight * speed of polymerase will determine the
-   * propensity for the next movement of that polymerase.
+   * propensity for the next movement of that polymerase. Weights are never
+   * modified in place, so they may be shared between polymers. Null if no
+   * weights were given, in which case every position has a weight of 1.
+   */
+  std::shared_ptr<const std::vector<double>> weights_;
+  /**
+   * Occupancy recording, if enabled, with the profile of each element type
+   * looked up once and cached by type ID.
+   */
+  OccupancyProfiles::Ptr occupancy_;
+  std::string occupancy_name_;
+  std::vector<OccupancyProfiles::Profile *> occupancy_cache_;
+  /**
+   * Profile of a mobile element on this polymer. Only valid while occupancy
+   * is being recorded.
+   */
+  OccupancyProfiles::Profile &OccupancyProfile(const MobileElement &pol);
+  /**
+   * Event trace, if enabled.
+   */
+  EventTrace::Ptr trace_;
+  uint32_t trace_id_ = 0;
+  /**
+   * Observers of this polymer, if any.
+   */
+  Observers::Ptr observers_;
+  std::shared_ptr<PolymerStats> stats_;
+  /**
+   * Whether elements start runs, the simulation clock if they may have
+   * started any, and the number of elements running and the end of the
+   * earliest run.
+   */
+  bool run_ahead_ = false;
+  /**
+   * Whether ribosomes step by codon (see codon_steps).
+   */
+  bool codon_steps_ = false;
+  /**
+   * Whether blocked elements wait with a propensity of 0 (see
+   * skip_blocked).
+   */
+  bool skip_blocked_ = false;
+  const double *clock_ = nullptr;
+  /**
+   * Shortest run worth scheduling; shorter stretches are moved one by one.
+   */
+  static const int RUN_AHEAD_MIN_MOVES = 4;
+  /**
+   * Positions a ribosome moves per event when stepping by codon.
+   */
+  static const int CODON_LENGTH = 3;
+  int runs_ = 0;
+  double next_run_end_ = std::numeric_limits<double>::infinity();
+  /**
+   * Start a run of the MobileElement at a given index, if it can take enough
+   * moves that change nothing else.
+   */
+  void StartRun(int pol_index);
+  /**
+   * Number of moves, up to limit, that the MobileElement at a given index can
+   * take without changing any propensity.
+   */
+  int FreeMoves(int pol_index, int limit);
+  /**
+   * Number of mask shifts, up to limit, that uncover no binding site.
+   */
+  int FreeMaskShifts(int limit);
+  /**
+   * Number of moves, up to limit, that the MobileElement at a given index can
+   * take without uncovering a binding site on the polymer it is making.
    */
-  std::vector<double> weights_;
+  virtual int FreeTranscriptShifts(int pol_index, int limit);
+  /**
+   * Bring the position of a running MobileElement up to date.
+   */
+  void SyncRun(int pol_index);
+  /**
+   * Bring the mask up to date if it is moved by a running element.
+   */
+  virtual void SyncMask() {}
+  /**
+   * Can the mask be moved by a running element, without being brought up
+   * to date first?
+   */
+  virtual bool MaskMayRun() const { return false; }
+  /**
+   * Let the MobileElement at a given index be chosen again if it was
+   * blocked (see skip_blocked), and tell the simulation that this polymer's
+   * propensity changed.
+   */
+  void Unblock(int pol_index);
+  /**
+   * Move a running MobileElement forward, knowing that the moves change
+   * nothing else.
+   */
+  void AdvanceRun(int pol_index, int steps);
+  void UpdateNextRunEnd();
+  /**
+   * Charge this polymer, whose objects take size bytes, to a subsystem of a
+   * memory report, with the sites and elements it holds.
+   */
+  void MemoryOf(MemoryReport &report, const std::string &subsystem,
+                std::size_t size) const;
+  /**
+   * A ribosome bound to a site marked for mean-field translation (see
+   * Genome::MeanFieldTranslation) is not attached to the polymer. Binding
+   * covers the sites under its footprint as usual and schedules events: the
+   * time at which its back leaves each of those sites, and the time at
+   * which it terminates. Events are kept in order of time and run with the
+   * ends of runs (see FinishRuns).
+   */
+  struct MeanFieldEvent {
+    /**
+     * Site to uncover, or null for a termination.
+     */
+    BindingSite::Ptr site;
+    std::string pol_name;
+    /**
+     * Gene the ribosome terminates at ("NA" if it runs off the polymer) and
+     * the position of its front then, which must no longer be masked.
+     */
+    std::string gene;
+    int front;
+  };
+  std::multimap<double, MeanFieldEvent> mean_field_events_;
+  /**
+   * Terminations that came due while their position was still masked, in
+   * order, released as soon as the mask uncovers it.
+   */
+  std::vector<MeanFieldEvent> mean_field_waiting_;
+  /**
+   * Translation of a gene by a ribosome under the mean-field approximation:
+   * the number of moves from binding to termination, the mean time they
+   * take (the sum of the inverse rates of the positions moved through), and
+   * the time to cross the slowest stretch of one footprint, which bounds the
+   * interval between two ribosomes leaving the gene as it does in a
+   * crowded exclusion process. Computed once per gene.
+   */
+  struct MeanFieldGene {
+    int moves;
+    double transit;
+    double headway;
+    std::string gene;
+    int front;
+  };
+  std::map<int, MeanFieldGene> mean_field_genes_;
+  /**
+   * Time of the latest termination scheduled for each gene, by gene ID.
+   */
+  std::map<int, double> mean_field_last_;
+  /**
+   * Bind a ribosome to a site marked for mean-field translation. The
+   * ribosome has already been placed on the site.
+   */
+  void BindMeanField(MobileElement::Ptr pol, const BindingSite::Ptr &site);
+  const MeanFieldGene &MeanField(const MobileElement &pol,
+                                 const BindingSite &site);
+  /**
+   * Mean time a ribosome takes for the moves from the given numbers of
+   * moves after binding at a site, up to but not including the other.
+   */
+  double MeanFieldTime(const MobileElement &pol, int from, int to) const;
+  /**
+   * Run the mean-field events due by a given time, in order.
+   */
+  void FinishMeanField(double until);
+  /**
+   * Terminate the waiting ribosomes whose position is no longer masked.
+   */
+  void ReleaseMeanField();
+  /**
+   * Terminate a mean-field ribosome, or keep it waiting if its position is
+   * still masked.
+   */
+  void TerminateMeanField(const MeanFieldEvent &event);
+  /**
+   * Terminate every mean-field ribosome once the polymer is degraded: the
+   * RNase that degraded it would have been held up behind them.
+   */
+  void DegradeMeanField();
   /**
    * Finding which binding site (promoter) that the polymerase should bind to.
    *
@@ -309,6 +830,20 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    * @param pol Pointer to polymerase
    */
   virtual void Attach(MobileElement::Ptr pol);
+  /**
+   * Remove the MobileElement at a given index from the polymer.
+   *
+   * @param pol_index index of MobileElement
+   */
+  virtual void Detach(int pol_index);
+  /**
+   * Uncover more of the polymer attached to a MobileElement, if any, as the
+   * element moves along, by shifting its mask.
+   *
+   * @param pol_index index of MobileElement
+   * @param positions number of positions to shift the mask by
+   */
+  virtual void ExtendTranscript(int pol_index, int positions);
   /**
    * Check downstream of polymerase for any interactions and respond
    * accordingly.
@@ -341,6 +876,32 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    * @return true if polymerase is terminating
    */
   bool CheckTermination(int pol_index);
+  /**
+   * Implementation of Move, compiled once for each combination of optional
+   * features so that polymers without them skip their checks entirely. Move
+   * picks the variant for the current state of the polymer.
+   *
+   * @tparam kRnase may the element be an RNase?
+   * @tparam kObserved are stats, occupancy or observers being recorded?
+   * @return true if the element moved and is still on the polymer
+   */
+  template <bool kRnase, bool kObserved>
+  bool MoveElement(int pol_index);
+  /**
+   * Move a ribosome by one codon (see codon_steps), one position at a time.
+   */
+  void MoveCodon(int pol_index);
+  /**
+   * Could the element overlap a release site that may release it? Sites are
+   * sorted by start, so only the first site that ends at or after the
+   * element's start and interacts with it (in its reading frame and for the
+   * gene it is bound to) can overlap it first; that site is cached in the
+   * element and only looked up again once the element has moved past it.
+   *
+   * @param pol element to check
+   * @return false if no release site that interacts with pol overlaps it
+   */
+  bool MayRelease(MobileElement *pol);
   /**
    * Check for collisions between polymerase and this polymer's mask.
    *
@@ -357,18 +918,28 @@ class Polymer : public std::enable_shared_from_this<Polymer> {
    * @return true if polymerases will collide
    */
   bool CheckPolCollisions(int pol_index);
+  /**
+   * @return description of two elements overlapping by more than one
+   *  position, for error messages
+   */
+  std::string OverlapError(int index, int next_index) const;
   /**
    * Update the cached count of uncovered promoters/elements.
    *
-   * @param species_name name of species to cover
+   * @param site element that was covered
    */
-  void LogCover(const std::string &species_name);
+  void LogCover(const FixedElement &site);
   /**
    * Update the cached count of uncovered promoters/elements.
    *
-   * @param species_name name of species to uncover
+   * @param site element that was uncovered
    */
-  void LogUncover(const std::string &species_name);
+  void LogUncover(const FixedElement &site);
+  /**
+   * @return cached count of uncovered elements with a given interned name
+   *  ID, creating it (as 0) if it was never logged
+   */
+  int &UncoveredCount(int name_id);
 };
 
 /**
@@ -391,9 +962,10 @@ class Transcript : public Polymer {
    *  of the transcript
    */
   Transcript(const std::string &name, int start, int stop,
-             const std::vector<Interval<BindingSite::Ptr>> &rbs_intervals,
-             const std::vector<Interval<ReleaseSite::Ptr>> &stop_site_intervals,
-             const Mask &mask, const std::vector<double> &weights);
+             std::vector<Interval<BindingSite::Ptr>> rbs_intervals,
+             std::vector<Interval<ReleaseSite::Ptr>> stop_site_intervals,
+             const Mask &mask,
+             std::shared_ptr<const std::vector<double>> weights);
   /**
    * Constructor of transcript used for specifying transcripts without Genome
    *
@@ -433,9 +1005,75 @@ class Transcript : public Polymer {
    * Add transcript weights directly
    */
   void AddWeights(const std::vector<double> &transcript_weights);
+  /**
+   * Create a transcript with the same definition and none of the simulation
+   * state of this one.
+   */
+  std::shared_ptr<Transcript> Clone() const;
+  /**
+   * Return this transcript to the genome that built it, if any (see
+   * Genome::RecycleTranscript).
+   */
+  void Recycle();
+  void Memory(MemoryReport &report) const;
+  /**
+   * Charge this transcript to a given subsystem of a memory report, e.g.
+   * "recycled" for transcripts kept for reuse by a genome.
+   */
+  void Memory(MemoryReport &report, const std::string &subsystem) const;
+  /**
+   * Return a recycled transcript to the state it was built in, reusing its
+   * sites, site indices and other storage: copy the pristine sites over its
+   * own, in the order it was built with, and restore its mask. Initialize
+   * must be called again before it is simulated.
+   */
+  void Reset(const std::vector<BindingSite> &rbs_sites,
+             const std::vector<ReleaseSite> &stop_sites, const Mask &mask);
+  /**
+   * Serialize the definition of this transcript (its name, length and every
+   * call that added to it), or build a new transcript from one, so that
+   * models can be sent between processes. Simulation state is not included.
+   */
+  void SaveDefinition(CheckpointWriter &writer) const;
+  static std::shared_ptr<Transcript> LoadDefinition(CheckpointReader &reader);
+  /**
+   * Getters and setters.
+   */
+  std::shared_ptr<Genome> genome() const { return genome_.lock(); }
+  void genome(std::shared_ptr<Genome> genome) { genome_ = genome; }
+
+ protected:
+  void SyncMask();
+  bool MaskMayRun() const { return attached_ && run_ahead_; }
 
  private:
+  /**
+   * Genome that built this transcript, if any.
+   */
+  std::weak_ptr<Genome> genome_;
   std::map<std::string, std::map<std::string, double>> bindings_;
+  /**
+   * Steps that defined this transcript, replayed by Clone(), and the calls
+   * that made them, serialized for LoadDefinition. Steps hold pristine
+   * copies of the sites they add, so clones share the sites' properties,
+   * and clones share the definition itself.
+   */
+  struct Definition {
+    std::vector<std::function<void(Transcript &)>> steps;
+    std::string calls;
+  };
+  std::shared_ptr<Definition> definition_;
+  /**
+   * Calls recorded in Definition::calls.
+   */
+  enum Call : uint8_t { GENE, WEIGHTS };
+  /**
+   * Apply a step to this transcript and add it to its definition.
+   *
+   * @param call writes the call that made the step
+   */
+  void Define(const std::function<void(Transcript &)> &step,
+              const std::function<void(CheckpointWriter &)> &call);
 };
 
 /**
@@ -470,9 +1108,55 @@ class Genome : public Polymer {
                int rbs_stop, double rbs_strength);
   void AddRnaseSite(int start, int stop);
   void AddRnaseSite(const std::string &name, int start, int stop, double rnase_degradation_rate);
+  /**
+   * Define many features of one kind in a single call, as if each had been
+   * added individually in order. Every argument holds one entry per feature,
+   * except that interactions and efficiencies map each polymerase to one
+   * value per feature. Throws std::invalid_argument if the lengths differ.
+   */
+  void AddPromoters(
+      const std::vector<std::string> &names, const std::vector<int> &starts,
+      const std::vector<int> &stops,
+      const std::map<std::string, std::vector<double>> &interactions);
+  void AddTerminators(
+      const std::vector<std::string> &names, const std::vector<int> &starts,
+      const std::vector<int> &stops,
+      const std::map<std::string, std::vector<double>> &efficiency);
+  void AddGenes(const std::vector<std::string> &names,
+                const std::vector<int> &starts, const std::vector<int> &stops,
+                const std::vector<int> &rbs_starts,
+                const std::vector<int> &rbs_stops,
+                const std::vector<double> &rbs_strengths);
+  void AddRnaseSites(const std::vector<int> &starts,
+                     const std::vector<int> &stops);
   void AddWeights(const std::vector<double> &transcript_weights);
+  /**
+   * Translate a gene by a mean-field approximation of ribosome traffic
+   * instead of moving its ribosomes one position at a time. Ribosomes bind
+   * its RBS as usual and cover it until their back would have left it, but
+   * then take the mean time of the moves to the stop codon given the
+   * translation weights, and leave the gene no closer together than the
+   * time it takes to cross its slowest stretch of one footprint. They do
+   * not run into other elements, cover sites downstream of the RBS or
+   * appear in occupancy profiles, and still wait for the stop codon to be
+   * transcribed. The ribosomes of a transcript that is degraded terminate
+   * at once. Must be chosen before the genome is registered.
+   *
+   * @param gene_name name of a gene of this genome
+   * @param enabled whether the gene is translated by the approximation
+   */
+  void MeanFieldTranslation(const std::string &gene_name, bool enabled = true);
+  /**
+   * Is any gene of this genome translated by the mean-field approximation?
+   */
+  bool mean_field() const { return !mean_field_translation_.empty(); }
   const std::map<std::string, std::map<std::string, double>> &bindings();
   const std::map<std::string, double> &rnase_bindings() { return rnase_bindings_; }
+  /**
+   * Names of the genes translated from transcripts of this genome, i.e. the
+   * proteins it encodes, in the order they were added.
+   */
+  std::vector<std::string> gene_names() const;
   const double &transcript_degradation_rate() {
     return transcript_degradation_rate_;
   }
@@ -487,20 +1171,145 @@ class Genome : public Polymer {
   typedef std::shared_ptr<Genome> Ptr;
   typedef std::vector<std::shared_ptr<Genome>> VecPtr;
   /**
-   * Bind a polymerase to genome and construct new transcript.
+   * Bind a polymerase to genome. Its transcript is only built once the
+   * polymerase has moved far enough to uncover the transcript's first
+   * binding site (see ExtendTranscript), since nothing can happen on it
+   * before then.
    *
    * @param pol pointer to polymerase to bind
    * @param promoter name of promoter to which this polymerase binds
    */
   void Attach(MobileElement::Ptr pol);
+  void Detach(int pol_index);
+  /**
+   * Shift the mask of a polymerase's transcript, building and registering
+   * the transcript when the mask first uncovers one of its binding sites.
+   * Building it then shifts its mask as far as the polymerase has moved.
+   */
+  void ExtendTranscript(int pol_index, int positions);
+  int FreeTranscriptShifts(int pol_index, int limit);
+  /**
+   * Save or restore the polymer state and the transcripts that have not been
+   * built yet.
+   */
+  void Save(CheckpointWriter &writer,
+            const std::function<int(const Polymer::Ptr &)> &polymer_id)
+      const;
+  void Load(CheckpointReader &reader,
+            const std::function<Polymer::Ptr(int)> &polymer);
+  /**
+   * Number of bound polymerases whose transcripts have not been built yet.
+   */
+  int nascent_count() const { return nascent_.size(); }
+  /**
+   * Add this genome, the transcript layouts it shares with its copies and
+   * the transcripts it keeps for reuse to a memory report.
+   */
+  void Memory(MemoryReport &report) const;
+  /**
+   * Create a genome with the same definition and none of the simulation state
+   * of this one.
+   */
+  Ptr Clone() const;
+  /**
+   * Create another copy of this genome for the same model: a clone that
+   * shares the transcript layouts of this one (and the transcripts recycled
+   * with them) instead of building its own. Copies must not be used by
+   * different threads.
+   */
+  Ptr Copy();
+  /**
+   * Serialize the definition of this genome, or build a new genome from one,
+   * as for Transcript::SaveDefinition.
+   */
+  void SaveDefinition(CheckpointWriter &writer) const;
+  static Ptr LoadDefinition(CheckpointReader &reader);
+  /**
+   * Build a transcript object corresponding to start and stop positions
+   * within this genome. Also used to rebuild transcripts from a checkpoint.
+   *
+   * NOTE: Assumes that elements are already ordered by start position.
+   *
+   * @param start start position of transcript within genome
+   * @param stop stop position of transcript within genome
+   *
+   * @returns pointer to Transcript object
+   */
+  Transcript::Ptr BuildTranscript(int start, int stop);
+  /**
+   * Keep a degraded transcript built by this genome for reuse, so that the
+   * next transcript with the same start and stop is reset in place instead
+   * of being built from scratch, and memory stays constant once every kind
+   * of transcript has been degraded as often as it is built.
+   *
+   * @param transcript transcript that nothing else refers to any more
+   */
+  void RecycleTranscript(Transcript::Ptr transcript);
+  /**
+   * Lock the building and registration of transcripts with a mutex while
+   * the worker threads of a parallel simulation run, since copies of a
+   * genome share their layouts, or stop locking (see Guard).
+   */
+  void guard(std::recursive_mutex *mutex) { guard_ = mutex; }
   Signal<Transcript::Ptr> transcript_signal_;
 
  private:
   std::vector<Interval<BindingSite::Ptr>> transcript_rbs_intervals_;
   std::vector<Interval<ReleaseSite::Ptr>> transcript_stop_site_intervals_;
-  IntervalTree<BindingSite::Ptr> transcript_rbs_;
-  IntervalTree<ReleaseSite::Ptr> transcript_stop_sites_;
-  std::vector<double> transcript_weights_;
+  /**
+   * Translation weights shared by all transcripts, or null if none were
+   * added.
+   */
+  std::shared_ptr<const std::vector<double>> transcript_weights_;
+  /**
+   * Genes translated by the mean-field approximation, whose ribosome
+   * binding sites are marked when transcript sites are indexed.
+   */
+  std::set<std::string> mean_field_translation_;
+  /**
+   * Binding and release sites of a transcript, which depend only on where
+   * the transcript starts and stops. Computed once per start and stop
+   * position and shared by every transcript built from them.
+   */
+  struct TranscriptLayout {
+    std::vector<BindingSite> rbs_sites;
+    std::vector<ReleaseSite> stop_sites;
+    /**
+     * Mask start position at which the first binding site is uncovered.
+     */
+    int exposed_at = 0;
+    /**
+     * Degraded transcripts with this layout, ready to be reused.
+     */
+    std::vector<Transcript::Ptr> recycled;
+  };
+  /**
+   * Index of the sites that transcripts of this genome may carry, and the
+   * layout of every transcript built so far. Only depends on the definition
+   * of the genome, so copies of it in one model share them (see Copy).
+   * Built by Initialize.
+   */
+  struct TranscriptSites {
+    SiteIndex<BindingSite::Ptr> rbs;
+    SiteIndex<ReleaseSite::Ptr> stop_sites;
+    std::map<std::pair<int, int>, TranscriptLayout> layouts;
+  };
+  std::shared_ptr<TranscriptSites> transcript_sites_;
+  std::recursive_mutex *guard_ = nullptr;
+  /**
+   * Build transcript_sites_ from the intervals of this genome.
+   */
+  void IndexTranscriptSites();
+  /**
+   * Transcript of a bound polymerase that has not been built yet, with the
+   * position its mask would start at.
+   */
+  struct NascentTranscript {
+    int start;
+    int mask_start;
+    int exposed_at;
+  };
+  std::unordered_map<const MobileElement *, NascentTranscript> nascent_;
   std::map<std::string, std::map<std::string, double>> bindings_;
   std::map<std::string, double> rnase_bindings_;
   double transcript_degradation_rate_ = 0.0;
@@ -508,17 +1317,46 @@ class Genome : public Polymer {
   double rnase_speed_ = 0.0;
   int rnase_footprint_ = 0;
   /**
-   * Build a transcript object corresponding to start and stop positions
-   * within this genome.
-   *
-   * NOTE: Assumes that elements are already ordered by start position.
+   * Steps that defined this genome after construction, replayed by Clone(),
+   * and the calls that made them. As for Transcript, clones share the
+   * definition and the properties of the sites it adds.
+   */
+  struct Definition {
+    std::vector<std::function<void(Genome &)>> steps;
+    std::string calls;
+  };
+  std::shared_ptr<Definition> definition_;
+  /**
+   * Calls recorded in Definition::calls.
+   */
+  enum Call : uint8_t {
+    MASK,
+    PROMOTER,
+    TERMINATOR,
+    GENE,
+    RNASE_SITE,
+    UNIQUE_RNASE_SITE,
+    WEIGHTS,
+    PROMOTERS,
+    TERMINATORS,
+    GENES,
+    RNASE_SITES,
+    MEAN_FIELD
+  };
+  /**
+   * Apply a step to this genome and add it to its definition.
    *
-   * @param start start position of transcript within genome
-   * @param stop stop position of transcript within genome
+   * @param call writes the call that made the step
+   */
+  void Define(const std::function<void(Genome &)> &step,
+              const std::function<void(CheckpointWriter &)> &call);
+  /**
+   * Find (or compute and cache) the layout of a transcript.
    *
-   * @returns pointer to Transcript object
+   * @param start start position of transcript
+   * @param stop stop position of transcript
    */
-  Transcript::Ptr BuildTranscript(int start, int stop);
+  TranscriptLayout &FindTranscriptLayout(int start, int stop);
 };
 
 #endif  // SRC_POLYMER_HPP_
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "checkpoint.hpp"
+#include "population.hpp"
+
+Population::Population(const Model &model, int cells, int seed)
+    : compiled_(model.Compile()), seed_(seed), next_stream_(cells) {
+  if (cells < 1) {
+    throw std::invalid_argument("A population needs at least one cell.");
+  }
+  // Stream -1 is never used by a cell
+  rng_.seed(seed, -1);
+  for (int i = 0; i < cells; i++) {
+    auto cell = compiled_->Instantiate();
+    cell->seed(seed, i);
+    cells_.push_back({cell, std::numeric_limits<double>::infinity(), 0, {}});
+  }
+}
+
+void Population::division(double generation, bool partition) {
+  if (!(generation >= 0)) {
+    throw std::invalid_argument("Division time must not be negative.");
+  }
+  generation_ = generation;
+  partition_ = partition;
+  for (auto &cell : cells_) {
+    cell.divides = generation > 0
+                       ? cell.reached + generation
+                       : std::numeric_limits<double>::infinity();
+  }
+}
+
+void Population::max_cells(int cells) {
+  if (cells < 0) {
+    throw std::invalid_argument("Maximum number of cells must not be "
+                                "negative.");
+  }
+  max_cells_ = cells;
+}
+
+void Population::threads(int threads) {
+  if (threads < 0) {
+    throw std::invalid_argument("Number of threads must be non-negative.");
+  }
+  threads_ = threads;
+}
+
+void Population::ForEachCell(const std::function<void(int)> &step) {
+  int cells = cells_.size();
+  int threads = threads_ > 0
+                    ? threads_
+                    : std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, cells);
+  if (threads <= 1) {
+    for (int i = 0; i < cells; i++) {
+      step(i);
+    }
+    return;
+  }
+  // Workers take cells in order until all are done or one fails
+  std::atomic<int> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    int index;
+    while (!failed && (index = next++) < cells) {
+      try {
+        step(index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed) {
+          error = std::current_exception();
+          failed = true;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void Population::Divide(double time) {
+  // Daughters are appended, and divide in a later round if they are due
+  std::size_t cells = cells_.size();
+  for (std::size_t i = 0; i < cells; i++) {
+    if (cells_[i].divides > time) {
+      continue;
+    }
+    Model &mother = *cells_[i].model;
+    CheckpointWriter writer;
+    mother.Save(writer);
+    auto daughter = compiled_->Instantiate();
+    CheckpointReader reader(writer.buffer());
+    daughter->Load(reader);
+    daughter->seed(seed_, next_stream_++);
+    if (partition_) {
+      mother.PartitionSpecies(*daughter);
+    }
+    double born = cells_[i].divides;
+    cells_[i].divides = born + generation_;
+    cells_.push_back({daughter, born + generation_, born, {}});
+    divisions_++;
+  }
+}
+
+void Population::Simulate(double time_limit, double time_step,
+                          const std::string &method) {
+  if (!(time_step > 0)) {
+    throw std::invalid_argument("Time step must be positive.");
+  }
+  if (!stats_) {
+    time_step_ = time_step;
+    stats_.reset(new EnsembleStats(time_step));
+  } else if (time_step != time_step_) {
+    throw std::invalid_argument(
+        "Populations must keep the time step of their first run.");
+  }
+  for (; next_output_ * time_step_ <= time_limit + 1e-9; next_output_++) {
+    double time = next_output_ * time_step_;
+    // Bring every cell to its division or the output time, whichever is
+    // first, until no more cells divide before the output time
+    while (true) {
+      ForEachCell([&](int index) {
+        Cell &cell = cells_[index];
+        if (cell.divides <= time) {
+          if (cell.reached < cell.divides) {
+            cell.model->SimulateToTableAt({cell.divides}, method);
+            cell.reached = cell.divides;
+          }
+        } else if (cell.counts.time.empty()) {
+          cell.counts = cell.model->SimulateToTableAt({time}, method);
+          cell.reached = time;
+        }
+      });
+      if (std::none_of(cells_.begin(), cells_.end(), [time](const Cell &cell) {
+            return cell.divides <= time;
+          })) {
+        break;
+      }
+      Divide(time);
+    }
+    // Only the cells that are kept count at the output time
+    if (max_cells_ > 0) {
+      while (static_cast<int>(cells_.size()) > max_cells_) {
+        int index = std::min<int>(rng_.random() * cells_.size(),
+                                  cells_.size() - 1);
+        cells_.erase(cells_.begin() + index);
+      }
+    }
+    for (auto &cell : cells_) {
+      stats_->Add(cell.counts);
+      cell.counts = CountsTable();
+    }
+    time_ = time;
+  }
+}
+
+EnsembleSummary Population::Summary() const {
+  if (!stats_) {
+    return EnsembleSummary();
+  }
+  return stats_->Summary();
+}
@@ -0,0 +1,133 @@
+#ifndef SRC_POPULATION_HPP  // header guard
+#define SRC_POPULATION_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "choices.hpp"
+#include "ensemble_stats.hpp"
+#include "model.hpp"
+
+/**
+ * A growing population of cells, each an instance of one compiled model
+ * (see CompiledModel) with its own simulation state and random number
+ * stream. Cells are simulated on a pool of threads between output times,
+ * divide when they reach the division time, and their counts are added to
+ * population statistics at every output time as the cells reach it, so no
+ * trajectory is kept.
+ *
+ * A dividing cell is forked from its saved state (see Model::Fork). With
+ * partitioning, its free molecules are then split between the two cells
+ * (see Model::PartitionSpecies), while polymers are copied, as if they had
+ * been replicated before division. Divisions and removals happen between
+ * simulation steps in order of cell, so results depend on the seed but not
+ * on the number of threads.
+ */
+class Population {
+ public:
+  /**
+   * @param model template model; its definition so far is compiled once,
+   *  and it is left untouched
+   * @param cells number of founder cells, each in the model's initial state
+   * @param seed seed shared by all cells, founder i using random number
+   *  stream i and each daughter the next unused stream
+   * @throws std::invalid_argument if cells is less than 1
+   */
+  Population(const Model &model, int cells, int seed);
+  /**
+   * Divide cells when they have lived for a time, or never if 0 (the
+   * default).
+   *
+   * @param generation time between a cell's birth and its division
+   * @param partition whether to split free molecules between daughters
+   *  rather than copying them to both
+   */
+  void division(double generation, bool partition = true);
+  /**
+   * Keep at most a number of cells, removing cells chosen at random at each
+   * output time, once the cells due have divided, as in a chemostat. 0 (the
+   * default) keeps every cell.
+   */
+  void max_cells(int cells);
+  /**
+   * Number of worker threads, or 0 (the default) for one per hardware
+   * thread.
+   */
+  void threads(int threads);
+  /**
+   * Simulate every cell through each multiple of time_step from the
+   * population's current time through time_limit, dividing cells as they
+   * come due, and add the counts of every cell at each of those times to
+   * the statistics. Calling this again continues from where it stopped.
+   *
+   * @param method name of the reaction selection method, as for
+   *  Model::Simulate
+   * @throws std::invalid_argument if time_step is not positive or differs
+   *  from that of a previous call
+   */
+  void Simulate(double time_limit, double time_step,
+                const std::string &method);
+  /**
+   * Statistics of the counts of every cell alive at each output time so
+   * far, where "replicates" is the number of cells.
+   */
+  EnsembleSummary Summary() const;
+  /**
+   * Number of live cells, and the number of divisions so far.
+   */
+  int size() const { return cells_.size(); }
+  long long divisions() const { return divisions_; }
+  /**
+   * Simulation time the cells have all reached.
+   */
+  double time() const { return time_; }
+  /**
+   * Live cell by index, in order of birth. Cells keep their index until
+   * cells before them are removed.
+   */
+  const Model &cell(int index) const { return *cells_.at(index).model; }
+
+ private:
+  struct Cell {
+    std::shared_ptr<Model> model;
+    /**
+     * Time of the cell's next division, the time it has been simulated to,
+     * and its counts at the output time once it has reached it.
+     */
+    double divides;
+    double reached;
+    CountsTable counts;
+  };
+  CompiledModel::Ptr compiled_;
+  std::vector<Cell> cells_;
+  int seed_;
+  int next_stream_;
+  /**
+   * Chooses cells to remove.
+   */
+  Random rng_;
+  double generation_ = 0;
+  bool partition_ = true;
+  int max_cells_ = 0;
+  int threads_ = 0;
+  double time_ = 0;
+  double time_step_ = 0;
+  /**
+   * Index of the next output time.
+   */
+  long long next_output_ = 0;
+  long long divisions_ = 0;
+  std::unique_ptr<EnsembleStats> stats_;
+  /**
+   * Call a function with the index of every cell on the worker threads.
+   */
+  void ForEachCell(const std::function<void(int)> &step);
+  /**
+   * Divide every cell that is due by a time once, appending the daughters.
+   */
+  void Divide(double time);
+};
+
+#endif  // header guard
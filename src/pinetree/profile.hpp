@@ -0,0 +1,25 @@
+#ifndef SRC_PROFILE_HPP  // header guard
+#define SRC_PROFILE_HPP
+
+/**
+ * Mark the rest of the enclosing scope as a named phase of the engine, e.g.
+ * reaction selection or propensity updates, so that profilers attribute
+ * time to phases instead of to whatever they were inlined into.
+ *
+ * Zones are Tracy zones when pinetree is built with the CMake option
+ * PINETREE_TRACY, which links the Tracy client; connect the Tracy profiler
+ * to a running simulation to see them. Otherwise they expand to nothing, so
+ * normal builds pay nothing for them.
+ *
+ * @param name string literal naming the phase
+ */
+#ifdef PINETREE_TRACY
+#include <tracy/Tracy.hpp>
+#define PINETREE_ZONE(name) ZoneScopedN(name)
+#else
+#define PINETREE_ZONE(name) \
+  do {                      \
+  } while (0)
+#endif
+
+#endif  // header guard
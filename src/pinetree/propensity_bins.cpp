@@ -0,0 +1,162 @@
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+
+#include "propensity_bins.hpp"
+
+/**
+ * Marks a value that is not stored in any bin.
+ */
+const static int NO_BIN = INT_MIN;
+
+void PropensityBins::PushBack(double value) {
+  values_.push_back(value);
+  bin_of_.push_back(NO_BIN);
+  slot_of_.push_back(-1);
+  AddToBin(values_.size() - 1);
+}
+
+void PropensityBins::PopBack() {
+  if (values_.empty()) {
+    throw std::range_error("PropensityBins: Cannot remove from empty bins.");
+  }
+  RemoveFromBin(values_.size() - 1);
+  values_.pop_back();
+  bin_of_.pop_back();
+  slot_of_.pop_back();
+}
+
+void PropensityBins::Update(int index, double value) {
+  if (index < 0 || index >= static_cast<int>(values_.size())) {
+    throw std::range_error("PropensityBins: Index out of range for update.");
+  }
+  int exponent;
+  std::frexp(value, &exponent);
+  if (value > 0 && bin_of_[index] == exponent) {
+    // Value stays in the same bin, so only the bin sum changes
+    bins_[exponent - min_exponent_].sum += value - values_[index];
+    values_[index] = value;
+    return;
+  }
+  RemoveFromBin(index);
+  values_[index] = value;
+  AddToBin(index);
+}
+
+int PropensityBins::Choose(Random &rng) const {
+  double total = 0;
+  for (const auto &bin : bins_) {
+    total += bin.sum;
+  }
+  if (total <= 0) {
+    throw std::runtime_error("PropensityBins: Cannot select from empty bins.");
+  }
+  // Composition step: pick a bin, starting from the largest propensities
+  double target = rng.random() * total;
+  int bin_index = bins_.size() - 1;
+  for (; bin_index > 0; bin_index--) {
+    if (bins_[bin_index].members.empty()) {
+      continue;
+    }
+    if (target < bins_[bin_index].sum) {
+      break;
+    }
+    target -= bins_[bin_index].sum;
+  }
+  // Rounding error may leave us in an empty bin; fall back to any non-empty
+  // bin
+  while (bins_[bin_index].members.empty()) {
+    bin_index = (bin_index + 1) % bins_.size();
+  }
+  // Rejection step: pick uniformly within the bin and accept in proportion
+  // to value
+  const Bin &bin = bins_[bin_index];
+  double bin_max = std::ldexp(1.0, bin_index + min_exponent_);
+  while (true) {
+    int member = bin.members.size() * rng.random();
+    if (member >= static_cast<int>(bin.members.size())) {
+      member = bin.members.size() - 1;
+    }
+    int index = bin.members[member];
+    if (rng.random() * bin_max < values_[index]) {
+      return index;
+    }
+  }
+}
+
+void PropensityBins::Clear() {
+  values_.clear();
+  bin_of_.clear();
+  slot_of_.clear();
+  bins_.clear();
+  min_exponent_ = 0;
+}
+
+void PropensityBins::AddToBin(int index) {
+  double value = values_[index];
+  if (value <= 0 || !std::isfinite(value)) {
+    return;
+  }
+  int exponent;
+  std::frexp(value, &exponent);
+  // Grow the range of bins to include this exponent
+  if (bins_.empty()) {
+    min_exponent_ = exponent;
+    bins_.resize(1);
+  } else if (exponent < min_exponent_) {
+    bins_.insert(bins_.begin(), min_exponent_ - exponent, Bin());
+    min_exponent_ = exponent;
+  } else if (exponent - min_exponent_ >= static_cast<int>(bins_.size())) {
+    bins_.resize(exponent - min_exponent_ + 1);
+  }
+  Bin &bin = bins_[exponent - min_exponent_];
+  bin_of_[index] = exponent;
+  slot_of_[index] = bin.members.size();
+  bin.members.push_back(index);
+  bin.sum += value;
+}
+
+void PropensityBins::RemoveFromBin(int index) {
+  if (bin_of_[index] == NO_BIN) {
+    return;
+  }
+  Bin &bin = bins_[bin_of_[index] - min_exponent_];
+  // Swap with last member of bin so removal takes constant time
+  int slot = slot_of_[index];
+  int last = bin.members.back();
+  bin.members[slot] = last;
+  slot_of_[last] = slot;
+  bin.members.pop_back();
+  if (bin.members.empty()) {
+    // Reset sum so rounding error does not accumulate in empty bins
+    bin.sum = 0;
+  } else {
+    bin.sum -= values_[index];
+  }
+  bin_of_[index] = NO_BIN;
+  slot_of_[index] = -1;
+}
+
+void PropensityBins::Save(CheckpointWriter &writer) const {
+  writer.Write(values_);
+  writer.Write(bin_of_);
+  writer.Write(slot_of_);
+  writer.Write<uint32_t>(bins_.size());
+  for (const auto &bin : bins_) {
+    writer.Write(bin.sum);
+    writer.Write(bin.members);
+  }
+  writer.Write<int32_t>(min_exponent_);
+}
+
+void PropensityBins::Load(CheckpointReader &reader) {
+  reader.Read(values_);
+  reader.Read(bin_of_);
+  reader.Read(slot_of_);
+  bins_.resize(reader.Read<uint32_t>());
+  for (auto &bin : bins_) {
+    reader.Read(bin.sum);
+    reader.Read(bin.members);
+  }
+  min_exponent_ = reader.Read<int32_t>();
+}
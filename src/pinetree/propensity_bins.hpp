@@ -0,0 +1,122 @@
+#ifndef SRC_PROPENSITY_BINS_HPP  // header guard
+#define SRC_PROPENSITY_BINS_HPP
+
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "choices.hpp"
+
+/**
+ * Propensities grouped into bins by powers of two, for the composition-
+ * rejection selection method (Slepoy, Thompson, and Plimpton 2008). A value
+ * in [2^(e-1), 2^e) is stored in bin e. Selection first picks a bin weighted
+ * by its total propensity, then repeatedly picks a uniformly random value in
+ * that bin and accepts it with probability value / 2^e. Acceptance is at
+ * least 1/2, so selection takes constant time on average regardless of how
+ * many values are stored. Values of zero (or less) are not stored in any bin
+ * and are never selected.
+ */
+class PropensityBins {
+ public:
+  /**
+   * Append a value.
+   *
+   * @param value propensity to append
+   */
+  void PushBack(double value);
+  /**
+   * Remove the last value.
+   */
+  void PopBack();
+  /**
+   * Set the value at a given index.
+   *
+   * @param index index of value to update
+   * @param value new propensity
+   */
+  void Update(int index, double value);
+  /**
+   * Randomly select an index, weighted by value.
+   *
+   * @param rng random number generator to draw from
+   * @return index of selected value
+   */
+  int Choose(Random &rng) const;
+  /**
+   * Remove all values.
+   */
+  void Clear();
+  /**
+   * Save or restore the exact state of this structure, so that a restored
+   * simulation makes the same choices as the original.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  /**
+   * Getters and setters.
+   */
+  double value(int index) const { return values_[index]; }
+  int size() const { return values_.size(); }
+  /**
+   * @return bytes of heap memory held
+   */
+  std::size_t memory() const {
+    std::size_t bytes = values_.capacity() * sizeof(double) +
+                        (bin_of_.capacity() + slot_of_.capacity()) *
+                            sizeof(int) +
+                        bins_.capacity() * sizeof(Bin);
+    for (const auto &bin : bins_) {
+      bytes += bin.members.capacity() * sizeof(int);
+    }
+    return bytes;
+  }
+
+ private:
+  /**
+   * A group of values that all share the same power-of-two exponent.
+   */
+  struct Bin {
+    /**
+     * Sum over all values in this bin.
+     */
+    double sum = 0;
+    /**
+     * Indices of values in this bin, in no particular order.
+     */
+    std::vector<int> members;
+  };
+  /**
+   * All values, in index order.
+   */
+  std::vector<double> values_;
+  /**
+   * Bin exponent that each value is stored in.
+   */
+  std::vector<int> bin_of_;
+  /**
+   * Position of each value within its bin's member list.
+   */
+  std::vector<int> slot_of_;
+  /**
+   * Bins ordered by exponent, starting at min_exponent_.
+   */
+  std::vector<Bin> bins_;
+  /**
+   * Exponent of the first bin in bins_.
+   */
+  int min_exponent_ = 0;
+  /**
+   * Place the value at a given index into its bin.
+   *
+   * @param index index of value
+   */
+  void AddToBin(int index);
+  /**
+   * Take the value at a given index out of its bin.
+   *
+   * @param index index of value
+   */
+  void RemoveFromBin(int index);
+};
+
+#endif  // header guard
@@ -0,0 +1,132 @@
+#include <stdexcept>
+
+#include "propensity_tree.hpp"
+
+void PropensityTree::PushBack(double value) {
+  if (size_ == capacity_) {
+    Grow();
+  }
+  size_++;
+  Update(size_ - 1, value);
+}
+
+void PropensityTree::PopBack() {
+  if (size_ == 0) {
+    throw std::range_error("PropensityTree: Cannot remove from empty tree.");
+  }
+  Update(size_ - 1, 0.0);
+  size_--;
+}
+
+void PropensityTree::Insert(int index, double value) {
+  if (index > size_ || index < 0) {
+    throw std::range_error("PropensityTree: Index out of range for insertion.");
+  }
+  if (size_ == capacity_) {
+    Grow();
+  }
+  for (int i = size_; i > index; i--) {
+    nodes_[capacity_ + i] = nodes_[capacity_ + i - 1];
+  }
+  nodes_[capacity_ + index] = value;
+  size_++;
+  Rebuild(index);
+}
+
+void PropensityTree::Erase(int index) {
+  if (index >= size_ || index < 0) {
+    throw std::range_error("PropensityTree: Index out of range for removal.");
+  }
+  for (int i = index; i < size_ - 1; i++) {
+    nodes_[capacity_ + i] = nodes_[capacity_ + i + 1];
+  }
+  nodes_[capacity_ + size_ - 1] = 0.0;
+  Rebuild(index);
+  size_--;
+}
+
+void PropensityTree::Update(int index, double value) {
+  if (index >= size_ || index < 0) {
+    throw std::range_error("PropensityTree: Index out of range for update.");
+  }
+  int node = capacity_ + index;
+  nodes_[node] = value;
+  Propagate(node);
+}
+
+int PropensityTree::Find(double target) const {
+  if (size_ == 0) {
+    throw std::runtime_error("PropensityTree: Cannot select from empty tree.");
+  }
+  int node = 1;
+  while (node < capacity_) {
+    int left = 2 * node;
+    // Descend right only if the target lies beyond the left subtree and there
+    // is something to the right; this keeps rounding error from selecting an
+    // empty leaf past the end of the tree.
+    if (target >= nodes_[left] && nodes_[left + 1] > 0) {
+      target -= nodes_[left];
+      node = left + 1;
+    } else {
+      node = left;
+    }
+  }
+  int index = node - capacity_;
+  if (index >= size_) {
+    index = size_ - 1;
+  }
+  return index;
+}
+
+void PropensityTree::Clear() {
+  capacity_ = 0;
+  size_ = 0;
+  nodes_.clear();
+}
+
+void PropensityTree::Grow() {
+  int new_capacity = (capacity_ == 0) ? 1 : 2 * capacity_;
+  std::vector<double> new_nodes(2 * new_capacity, 0.0);
+  for (int i = 0; i < size_; i++) {
+    new_nodes[new_capacity + i] = nodes_[capacity_ + i];
+  }
+  for (int node = new_capacity - 1; node > 0; node--) {
+    new_nodes[node] = new_nodes[2 * node] + new_nodes[2 * node + 1];
+  }
+  capacity_ = new_capacity;
+  nodes_.swap(new_nodes);
+}
+
+void PropensityTree::Propagate(int node) {
+  node /= 2;
+  while (node > 0) {
+    nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+    node /= 2;
+  }
+}
+
+void PropensityTree::Rebuild(int index) {
+  // Walk up one level at a time, recomputing the range of parents whose
+  // subtrees contain any leaf in [index, size_)
+  int first = (capacity_ + index) / 2;
+  int last = (capacity_ + size_ - 1) / 2;
+  while (first > 0) {
+    for (int node = first; node <= last; node++) {
+      nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+    }
+    first /= 2;
+    last /= 2;
+  }
+}
+
+void PropensityTree::Save(CheckpointWriter &writer) const {
+  writer.Write<int32_t>(capacity_);
+  writer.Write<int32_t>(size_);
+  writer.Write(nodes_);
+}
+
+void PropensityTree::Load(CheckpointReader &reader) {
+  capacity_ = reader.Read<int32_t>();
+  size_ = reader.Read<int32_t>();
+  reader.Read(nodes_);
+}
@@ -0,0 +1,113 @@
+#ifndef SRC_PROPENSITY_TREE_HPP  // header guard
+#define SRC_PROPENSITY_TREE_HPP
+
+#include <vector>
+
+#include "checkpoint.hpp"
+
+/**
+ * A binary sum tree (segment tree) over a list of propensities. Updating a
+ * single propensity and selecting an index weighted by propensity both take
+ * O(log n) time, and no memory is allocated during selection.
+ *
+ * Internal nodes always hold the exact sum of their two children, so the total
+ * does not accumulate rounding error as individual values are updated.
+ */
+class PropensityTree {
+ public:
+  /**
+   * Append a value to the end of the tree.
+   *
+   * @param value propensity to append
+   */
+  void PushBack(double value);
+  /**
+   * Remove the last value in the tree.
+   */
+  void PopBack();
+  /**
+   * Insert a value at a given index, shifting all later values up by one.
+   * Sums are only recomputed for nodes covering the shifted values, which
+   * takes O(n - index) time.
+   *
+   * @param index index of new value, between 0 and size()
+   * @param value propensity to insert
+   */
+  void Insert(int index, double value);
+  /**
+   * Remove the value at a given index, shifting all later values down by one.
+   * Like Insert, this takes O(n - index) time.
+   *
+   * @param index index of value to remove
+   */
+  void Erase(int index);
+  /**
+   * Set the value at a given index.
+   *
+   * @param index index of value to update
+   * @param value new propensity
+   */
+  void Update(int index, double value);
+  /**
+   * Find the first index whose cumulative sum exceeds target. Target should
+   * lie in [0, total()).
+   *
+   * @param target a value between 0 and the total of all values
+   *
+   * @return index of selected value
+   */
+  int Find(double target) const;
+  /**
+   * Remove all values.
+   */
+  void Clear();
+  /**
+   * Save or restore the exact state of this tree, so that a restored
+   * simulation makes the same choices as the original.
+   */
+  void Save(CheckpointWriter &writer) const;
+  void Load(CheckpointReader &reader);
+  /**
+   * Getters and setters.
+   */
+  double total() const { return nodes_.empty() ? 0.0 : nodes_[1]; }
+  double value(int index) const { return nodes_[capacity_ + index]; }
+  int size() const { return size_; }
+  /**
+   * @return bytes of heap memory held
+   */
+  std::size_t memory() const { return nodes_.capacity() * sizeof(double); }
+
+ private:
+  /**
+   * Number of leaves available before the tree must grow. Always a power of 2.
+   */
+  int capacity_ = 0;
+  /**
+   * Number of values currently stored.
+   */
+  int size_ = 0;
+  /**
+   * Tree nodes stored in breadth-first order. Node 1 is the root, node i has
+   * children 2i and 2i + 1, and leaves start at capacity_.
+   */
+  std::vector<double> nodes_;
+  /**
+   * Double the capacity of the tree, preserving all stored values.
+   */
+  void Grow();
+  /**
+   * Recompute sums along the path from a leaf to the root.
+   *
+   * @param node index of leaf node
+   */
+  void Propagate(int node);
+  /**
+   * Recompute sums of all nodes covering leaves from a given index onward.
+   *
+   * @param index index of first changed value
+   */
+  void Rebuild(int index);
+};
+
+#endif  // header guard
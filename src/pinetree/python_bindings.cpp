@@ -1,8 +1,23 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/functional.h>
 #include <pybind11/stl.h>
+
+#include <limits>
+#include <random>
+
+#include "checkpoint.hpp"
 #include "choices.hpp"
+#include "counts_file.hpp"
+#include "ensemble_stats.hpp"
 #include "feature.hpp"
+#ifdef PINETREE_HDF5
+#include "hdf5_store.hpp"
+#endif
 #include "model.hpp"
+#include "model_cache.hpp"
+#include "output.hpp"
+#include "placement.hpp"
+#include "population.hpp"
 #include "polymer.hpp"
 #include "reaction.hpp"
 #include "tracker.hpp"
@@ -10,15 +25,237 @@
 namespace py = pybind11;
 using namespace pybind11::literals;
 
-PYBIND11_MODULE(core, m) {
+/**
+ * pinetree.core_checked is this module built with PINETREE_CHECKED (see
+ * checks.hpp). Its types are local to it, so that it can be imported
+ * alongside pinetree.core.
+ */
+#ifdef PINETREE_CHECKED
+#define PINETREE_MODULE core_checked
+static const bool LOCAL_TYPES = true;
+#else
+#define PINETREE_MODULE core
+static const bool LOCAL_TYPES = false;
+#endif
+
+/**
+ * A view of one array in a CountsTable or EnsembleSummary, exposed through
+ * the buffer protocol. The view shares ownership of the table, so arrays
+ * built on it stay valid after the other arrays are released.
+ */
+struct CountsArray {
+  std::shared_ptr<const void> owner;
+  double *data;
+  std::vector<py::ssize_t> shape;
+};
+
+/**
+ * Wrap an array owned by a table as a NumPy array without copying it, or as
+ * a memoryview if NumPy is not installed.
+ */
+static py::object WrapCountsArray(std::shared_ptr<const void> owner,
+                                  std::vector<double> &values,
+                                  std::vector<py::ssize_t> shape) {
+  py::object array =
+      py::cast(CountsArray{std::move(owner), values.data(), std::move(shape)});
+  try {
+    return py::module::import("numpy").attr("asarray")(array);
+  } catch (py::error_already_set &) {
+    return py::memoryview(array);
+  }
+}
+
+/**
+ * A read-only view of the live species counts of a model's tracker, exposed
+ * through the buffer protocol. The view shares ownership of the tracker.
+ */
+struct SpeciesCountsArray {
+  std::shared_ptr<const SpeciesTracker> owner;
+  const int *data;
+  py::ssize_t size;
+};
+
+/**
+ * Pickled state of a genome or transcript: its serialized definition.
+ */
+template <typename T>
+static py::bytes SaveDefinition(const T &polymer) {
+  CheckpointWriter writer;
+  polymer.SaveDefinition(writer);
+  return py::bytes(writer.buffer());
+}
+
+template <typename T>
+static std::shared_ptr<T> LoadDefinition(const py::bytes &state) {
+  std::string buffer = state;
+  CheckpointReader reader(buffer);
+  return T::LoadDefinition(reader);
+}
+
+/**
+ * Buffer protocol handler that exports SpeciesCountsArray buffers as
+ * read-only, which pybind11 has no option for.
+ */
+static int GetReadOnlyBuffer(PyObject *obj, Py_buffer *view, int flags) {
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Species counts are read-only.");
+    return -1;
+  }
+  int result = py::detail::pybind11_getbuffer(obj, view, flags);
+  if (result == 0) {
+    view->readonly = 1;
+  }
+  return result;
+}
+
+/**
+ * Convert a CountsTable to the dict returned by Model.simulate_to_arrays.
+ */
+static py::dict CountsTableToDict(std::shared_ptr<CountsTable> table) {
+  py::ssize_t rows = table->time.size();
+  py::ssize_t columns = table->species.size();
+  py::dict results;
+  results["time"] = WrapCountsArray(table, table->time, {rows});
+  results["species"] = table->species;
+  results["protein"] = WrapCountsArray(table, table->protein, {rows, columns});
+  results["transcript"] =
+      WrapCountsArray(table, table->transcript, {rows, columns});
+  results["ribo_density"] =
+      WrapCountsArray(table, table->ribo_density, {rows, columns});
+  results["metadata"] = table->metadata;
+  return results;
+}
+
+/**
+ * Convert ResampledCounts to the dict returned by pinetree.core.resample_counts.
+ */
+static py::dict ResampledCountsToDict(std::shared_ptr<ResampledCounts> counts) {
+  py::ssize_t replicates = counts->replicates;
+  py::ssize_t rows = counts->time.size();
+  py::ssize_t columns = counts->species.size();
+  py::dict results;
+  results["time"] = WrapCountsArray(counts, counts->time, {rows});
+  results["species"] = counts->species;
+  results["replicates"] = replicates;
+  results["protein"] =
+      WrapCountsArray(counts, counts->protein, {replicates, rows, columns});
+  results["transcript"] =
+      WrapCountsArray(counts, counts->transcript, {replicates, rows, columns});
+  results["ribo_density"] = WrapCountsArray(counts, counts->ribo_density,
+                                            {replicates, rows, columns});
+  return results;
+}
+
+/**
+ * Output times of a batch ensemble standing in for the output of
+ * Model::SimulateToTable, from 0 through time_limit.
+ */
+static std::vector<double> BatchTimes(int time_limit, int time_step) {
+  if (time_step <= 0) {
+    throw std::invalid_argument("Time step must be positive.");
+  }
+  std::vector<double> times;
+  for (int time = 0; time <= time_limit; time += time_step) {
+    times.push_back(time);
+  }
+  return times;
+}
+
+/**
+ * Simulate an ensemble into one HDF5 file (see Hdf5Store), recording the
+ * seed and stream of each replicate, the run length and output step, and
+ * the parameters set on the model. A random shared seed is drawn here if
+ * none is given, so that it can be recorded.
+ */
+static void SimulateEnsembleToHdf5(const Model &model, int n, int time_limit,
+                                   int time_step, std::vector<int> seeds,
+                                   int threads, const std::string &method,
+                                   const std::string &path) {
+#ifdef PINETREE_HDF5
+  if (seeds.empty()) {
+    seeds.push_back(std::random_device()() & 0x7fffffff);
+  }
+  auto store = Hdf5Store::Create(path, std::max(n, 1));
+  store->WriteAttribute("time_limit", time_limit);
+  store->WriteAttribute("time_step", time_step);
+  for (const auto &item : model.parameters()) {
+    store->WriteAttribute(item.first, item.second);
+  }
+  std::vector<CountsWriter::Ptr> writers(n);
+  for (int i = 0; i < n; i++) {
+    writers[i] = store->Writer(i);
+    bool shared = seeds.size() == 1;
+    writers[i]->WriteMetadata("seed", seeds[shared ? 0 : i]);
+    writers[i]->WriteMetadata("stream", shared ? i : 0);
+  }
+  if (method == "batch") {
+    model.SimulateBatch(
+        n, seeds, threads, BatchTimes(time_limit, time_step),
+        [&](int replicate) { return std::move(writers[replicate]); });
+  } else {
+    model.SimulateEnsemble(n, seeds, threads,
+                           [&](int replicate, Model &replicate_model) {
+                             CountsWriter &writer = *writers[replicate];
+                             replicate_model.SimulateToWriter(
+                                 time_limit, time_step, method, writer);
+                             writer.Close();
+                           });
+  }
+  store->Close();
+#else
+  throw std::invalid_argument(
+      "HDF5 output needs pinetree built with -DPINETREE_HDF5=ON.");
+#endif
+}
+
+/**
+ * Convert an EnsembleSummary to the dict returned by
+ * Model.simulate_ensemble_stats.
+ */
+static py::dict EnsembleSummaryToDict(std::shared_ptr<EnsembleSummary> summary) {
+  py::ssize_t rows = summary->time.size();
+  py::ssize_t columns = summary->species.size();
+  py::ssize_t quantiles = summary->quantiles.size();
+  py::dict results;
+  results["time"] = WrapCountsArray(summary, summary->time, {rows});
+  results["species"] = summary->species;
+  results["quantiles"] = summary->quantiles;
+  results["replicates"] = WrapCountsArray(summary, summary->replicates, {rows});
+  std::vector<std::pair<const char *, SummaryStats *>> measures = {
+      {"protein", &summary->protein},
+      {"transcript", &summary->transcript},
+      {"ribo_density", &summary->ribo_density}};
+  for (auto &measure : measures) {
+    SummaryStats &stats = *measure.second;
+    py::dict values;
+    values["mean"] = WrapCountsArray(summary, stats.mean, {rows, columns});
+    values["variance"] =
+        WrapCountsArray(summary, stats.variance, {rows, columns});
+    values["min"] = WrapCountsArray(summary, stats.min, {rows, columns});
+    values["max"] = WrapCountsArray(summary, stats.max, {rows, columns});
+    values["quantiles"] =
+        WrapCountsArray(summary, stats.quantiles, {quantiles, rows, columns});
+    results[measure.first] = values;
+  }
+  return results;
+}
+
+PYBIND11_MODULE(PINETREE_MODULE, m) {
   m.doc() = (R"doc(
     Python module
     -----------------------
     .. currentmodule:: pinetree
   )doc");
 
-  py::class_<BindingSite, std::shared_ptr<BindingSite>>(m, "BindingSite",
-                                                        R"doc(
+#ifdef PINETREE_TRACE
+  m.attr("trace_enabled") = true;
+#else
+  m.attr("trace_enabled") = false;
+#endif
+
+  py::class_<BindingSite, std::shared_ptr<BindingSite>>(
+      m, "BindingSite", py::module_local(LOCAL_TYPES),
+      R"doc(
             BindingSite class that corresponds to both promoters and ribosome 
             binding sites. For internal use only.
 
@@ -31,14 +268,16 @@ PYBIND11_MODULE(core, m) {
       .def("uncover", &BindingSite::Uncover)
       .def("is_covered", &BindingSite::IsCovered)
       .def("clone", &BindingSite::Clone)
-      .def("check_interaction", &BindingSite::CheckInteraction)
+      .def("check_interaction", (bool (BindingSite::*)(const std::string &)) &
+                                    BindingSite::CheckInteraction)
       .def_property(
           "first_exposure",
           (bool (BindingSite::*)(void) const) & BindingSite::first_exposure,
           (void (BindingSite::*)(bool)) & BindingSite::first_exposure);
 
-  py::class_<ReleaseSite, std::shared_ptr<ReleaseSite>>(m, "ReleaseSite",
-                                                        R"doc(
+  py::class_<ReleaseSite, std::shared_ptr<ReleaseSite>>(
+      m, "ReleaseSite", py::module_local(LOCAL_TYPES),
+      R"doc(
             ReleaseSite class that corresponds to both terminators and stop codons. For internal use only.
 
             )doc")
@@ -50,15 +289,19 @@ PYBIND11_MODULE(core, m) {
       .def("uncover", &ReleaseSite::Uncover)
       .def("is_covered", &ReleaseSite::IsCovered)
       .def("clone", &ReleaseSite::Clone)
-      .def("check_interaction", &ReleaseSite::CheckInteraction)
+      .def("check_interaction",
+           (bool (ReleaseSite::*)(const std::string &, int)) &
+               ReleaseSite::CheckInteraction)
       .def_property(
           "readthrough",
           (bool (ReleaseSite::*)(void) const) & ReleaseSite::readthrough,
           (void (ReleaseSite::*)(bool)) & ReleaseSite::readthrough)
-      .def("efficiency", &ReleaseSite::efficiency);
+      .def("efficiency", (double (ReleaseSite::*)(const std::string &) const) &
+                             ReleaseSite::efficiency);
 
-  py::class_<Polymerase, std::shared_ptr<Polymerase>>(m, "Polymerase",
-                                                      R"doc(
+  py::class_<Polymerase, std::shared_ptr<Polymerase>>(
+      m, "Polymerase", py::module_local(LOCAL_TYPES),
+      R"doc(
             Polymerase class that corresponds to both biological polymerases and ribosomes. For internal use only.
 
             )doc")
@@ -72,7 +315,7 @@ PYBIND11_MODULE(core, m) {
                     (int (Polymerase::*)(void) const) & Polymerase::stop,
                     (void (Polymerase::*)(int)) & Polymerase::stop)
       .def_property_readonly(
-          "speed", (int (Polymerase::*)(void) const) & Polymerase::speed)
+          "speed", (double (Polymerase::*)(void) const) & Polymerase::speed)
       .def_property_readonly("footprint", (int (Polymerase::*)(void) const) &
                                               Polymerase::footprint)
       .def_property(
@@ -80,8 +323,9 @@ PYBIND11_MODULE(core, m) {
           (int (Polymerase::*)(void) const) & Polymerase::reading_frame,
           (void (Polymerase::*)(int)) & Polymerase::reading_frame);
 
-  py::class_<Mask, std::shared_ptr<Mask>>(m, "Mask",
-                                          R"doc(
+  py::class_<Mask, std::shared_ptr<Mask>>(
+      m, "Mask", py::module_local(LOCAL_TYPES),
+      R"doc(
             Mask class that corresponds to polymers that are still undergoing 
             synthesis. For internal use only.
 
@@ -93,16 +337,18 @@ PYBIND11_MODULE(core, m) {
                     (void (Mask::*)(int)) & Mask::start)
       .def_property("stop", (int (Mask::*)(void) const) & Mask::stop,
                     (void (Mask::*)(int)) & Mask::stop)
-      .def_property_readonly("speed", (int (Mask::*)(void) const) & Mask::speed)
+      .def_property_readonly("speed", (double (Mask::*)(void) const) & Mask::speed)
       .def_property_readonly("footprint",
                              (int (Mask::*)(void) const) & Mask::footprint)
       .def_property("reading_frame",
                     (int (Mask::*)(void) const) & Mask::reading_frame,
                     (void (Mask::*)(int)) & Mask::reading_frame)
-      .def("check_interaction", &Mask::CheckInteraction);
+      .def("check_interaction",
+           (bool (Mask::*)(const std::string &) const) & Mask::CheckInteraction);
 
-  py::class_<Rnase, std::shared_ptr<Rnase>>(m, "Rnase",
-                                            R"doc(
+  py::class_<Rnase, std::shared_ptr<Rnase>>(
+      m, "Rnase", py::module_local(LOCAL_TYPES),
+      R"doc(
             Rnase class that corresponds to polymers that are being degraded 
             from 5' to 3' end. For internal use only.
 
@@ -115,7 +361,7 @@ PYBIND11_MODULE(core, m) {
       .def_property("stop", (int (Rnase::*)(void) const) & Rnase::stop,
                     (void (Rnase::*)(int)) & Rnase::stop)
       .def_property_readonly("speed",
-                             (int (Rnase::*)(void) const) & Rnase::speed)
+                             (double (Rnase::*)(void) const) & Rnase::speed)
       .def_property_readonly("footprint",
                              (int (Rnase::*)(void) const) & Rnase::footprint)
       .def_property("reading_frame",
@@ -123,15 +369,21 @@ PYBIND11_MODULE(core, m) {
                     (void (Rnase::*)(int)) & Rnase::reading_frame);
 
   py::class_<SpeciesReaction, std::shared_ptr<SpeciesReaction>>(
-      m, "SpeciesReaction",
+      m, "SpeciesReaction", py::module_local(LOCAL_TYPES),
       R"doc(
             
             Defines reactions between two or fewer species (with stoichiometries
              of 1). For internal use only.
             
             )doc")
-      .def(py::init<double, double, std::vector<std::string>,
-                    std::vector<std::string>>())
+      .def(py::init([](double rate_constant, double volume,
+                       const std::vector<std::string> &reactants,
+                       const std::vector<std::string> &products) {
+        // Reactions built outside of a Model get a tracker of their own
+        return std::make_shared<SpeciesReaction>(
+            rate_constant, volume, reactants, products,
+            std::make_shared<SpeciesTracker>());
+      }))
       .def("caculate_propensity", &SpeciesReaction::CalculatePropensity)
       .def("execute", &SpeciesReaction::Execute)
       .def_property_readonly(
@@ -144,7 +396,7 @@ PYBIND11_MODULE(core, m) {
               SpeciesReaction::products);
 
   py::class_<MobileElementManager, std::shared_ptr<MobileElementManager>>(
-      m, "MobileElementManager",
+      m, "MobileElementManager", py::module_local(LOCAL_TYPES),
       R"doc(
 
       Manages MobileElements (polymerases, ribosomes, RNases) on a Polymer. For
@@ -156,8 +408,21 @@ PYBIND11_MODULE(core, m) {
       .def("delete", &MobileElementManager::Delete)
       .def("choose", &MobileElementManager::Choose)
       .def("valid_index", &MobileElementManager::ValidIndex)
-      .def("get_pol", &MobileElementManager::GetPol)
-      .def("get_attached", &MobileElementManager::GetAttached)
+      // Indices from Python are always range checked
+      .def("get_pol",
+           [](MobileElementManager &manager, int index) {
+             if (!manager.ValidIndex(index)) {
+               throw std::range_error("Polymerase index out of range.");
+             }
+             return manager.GetPol(index);
+           })
+      .def("get_attached",
+           [](MobileElementManager &manager, int index) {
+             if (!manager.ValidIndex(index)) {
+               throw std::range_error("Polymerase index out of range.");
+             }
+             return manager.GetAttached(index);
+           })
       .def("update_propensity", &MobileElementManager::UpdatePropensity)
       .def_property_readonly("prop_sum",
                              (double (MobileElementManager::*)(void)) &
@@ -166,8 +431,150 @@ PYBIND11_MODULE(core, m) {
                              (int (MobileElementManager::*)(void)) &
                                  MobileElementManager::pol_count);
 
-  py::class_<Model, std::shared_ptr<Model>>(m, "Model",
-                                            R"doc(
+  py::class_<CountsArray>(m, "CountsArray", py::module_local(LOCAL_TYPES),
+                          py::buffer_protocol())
+      .def_buffer([](CountsArray &array) {
+        std::vector<py::ssize_t> strides;
+        py::ssize_t stride = sizeof(double);
+        for (auto i = array.shape.size(); i-- > 0;) {
+          strides.insert(strides.begin(), stride);
+          stride *= array.shape[i];
+        }
+        return py::buffer_info(array.data, sizeof(double),
+                               py::format_descriptor<double>::format(),
+                               array.shape.size(), array.shape, strides);
+      });
+
+  py::class_<SpeciesCountsArray> species_counts_array(
+      m, "_SpeciesCountsArray", py::module_local(LOCAL_TYPES),
+      py::buffer_protocol());
+  species_counts_array.def_buffer([](SpeciesCountsArray &array) {
+    return py::buffer_info(
+        const_cast<int *>(array.data), sizeof(int),
+        py::format_descriptor<int>::format(), 1, {array.size},
+        {static_cast<py::ssize_t>(SpeciesTracker::counts_stride())});
+  });
+  reinterpret_cast<PyTypeObject *>(species_counts_array.ptr())
+      ->tp_as_buffer->bf_getbuffer = GetReadOnlyBuffer;
+
+  py::class_<CountsFile, std::shared_ptr<CountsFile>>(
+      m, "CountsFile", py::module_local(LOCAL_TYPES),
+      R"doc(
+
+            A counts file written with format="binary" or "binary_delta", 
+            memory-mapped so that only the species and time points read are 
+            decoded. See ``pinetree.io``.
+
+          )doc")
+      .def(py::init<const std::string &>(), "path"_a)
+      .def_property_readonly(
+          "time",
+          [](const CountsFile &file) {
+            auto time = std::make_shared<std::vector<double>>(file.time());
+            py::ssize_t rows = time->size();
+            return WrapCountsArray(time, *time, {rows});
+          },
+          "Every time point in the file.")
+      .def_property_readonly("species", &CountsFile::species,
+                             "Species names in order of first appearance.")
+      .def_property_readonly("metadata", &CountsFile::metadata,
+                             "Last value of each property of the run.")
+      .def(
+          "read",
+          [](const CountsFile &file, const std::vector<std::string> &species,
+             double start, double stop) {
+            return CountsTableToDict(
+                std::make_shared<CountsTable>(file.Read(species, start, stop)));
+          },
+          "species"_a = std::vector<std::string>(),
+          "start"_a = -std::numeric_limits<double>::infinity(),
+          "stop"_a = std::numeric_limits<double>::infinity(),
+          R"doc(
+
+            Read the counts of some species at the time points from start 
+            through stop, in the format of ``Model.simulate_to_arrays``. 
+            Species not in the file are 0.
+
+            Args:
+                species (list): species to read, or every species if empty
+                start (float): first time to read
+                stop (float): last time to read
+
+          )doc")
+      .def(
+          "resample",
+          [](const CountsFile &file, const std::vector<double> &grid,
+             const std::vector<std::string> &species) {
+            return CountsTableToDict(
+                std::make_shared<CountsTable>(file.Resample(species, grid)));
+          },
+          "grid"_a, "species"_a = std::vector<std::string>(),
+          R"doc(
+
+            Read the counts of some species at each time of a sorted grid: 
+            the counts of the latest time point at or before it, or 0 
+            before the first time point.
+
+          )doc");
+
+  m.def(
+      "resample_counts",
+      [](const std::vector<std::string> &paths, const std::vector<double> &grid,
+         const std::vector<std::string> &species) {
+        return ResampledCountsToDict(std::make_shared<ResampledCounts>(
+            ResampleCounts(paths, species, grid)));
+      },
+      "paths"_a, "grid"_a, "species"_a = std::vector<std::string>(),
+      R"doc(
+
+        Resample the counts files of an ensemble to a common time grid (see 
+        ``CountsFile.resample``), one file at a time. Returns "time", 
+        "species", "replicates" and arrays of shape (replicate, time point, 
+        species) for "protein", "transcript" and "ribo_density". Species 
+        default to every species in any of the files.
+
+      )doc");
+
+  m.def(
+      "summarize_counts",
+      [](const std::vector<std::string> &paths, double time_step,
+         const std::vector<double> &quantiles) {
+        EnsembleStats stats(time_step, quantiles);
+        {
+          py::gil_scoped_release release;
+          for (const auto &path : paths) {
+            CountsFile file(path);
+            std::vector<double> grid;
+            double last = file.time().empty() ? -1 : file.time().back();
+            for (int k = 0; k * time_step <= last + 0.001; k++) {
+              grid.push_back(k * time_step);
+            }
+            stats.Add(file.Resample({}, grid));
+          }
+        }
+        return EnsembleSummaryToDict(
+            std::make_shared<EnsembleSummary>(stats.Summary()));
+      },
+      "paths"_a, "time_step"_a, "quantiles"_a = std::vector<double>(),
+      R"doc(
+
+        Summarize the counts files of an ensemble at every multiple of 
+        time_step, in the format of ``Model.simulate_ensemble_stats``, 
+        reading one file at a time. Each file is resampled as by 
+        ``CountsFile.resample``.
+
+      )doc");
+  m.def("numa_nodes", &NumaNodes, R"doc(
+
+        CPUs of each NUMA node that this process may run on, as used by 
+        ``Model.set_placement``. Machines without NUMA information are one 
+        node.
+
+      )doc");
+
+  py::class_<Model, std::shared_ptr<Model>>(
+      m, "Model", py::module_local(LOCAL_TYPES),
+      R"doc(
             
             Define a pinetree model.
             
@@ -181,17 +588,556 @@ PYBIND11_MODULE(core, m) {
 
            )doc")
       .def(py::init<double>(), "cell_volume"_a)
-      .def("seed", &Model::seed,
+      .def(py::pickle(
+          [](const Model &model) {
+            return py::bytes(model.SaveDefinition());
+          },
+          [](const py::bytes &state) {
+            return Model::LoadDefinition(state);
+          }))
+      .def("seed", &Model::seed, "seed"_a, "stream"_a = 0,
            R"doc(
              
-             Set a seed for reproducible simulations.
+             Set a seed for reproducible simulations. Each model has its own 
+             random number generator, so models may be simulated 
+             concurrently from different threads.
              
              Args:
                 seed (int): a seed for the random number generator
+                stream (int): stream number (default 0). Replicates that 
+                    share a seed but use different streams are independent.
+
+             )doc")
+      .def("set_resummation_interval", &Model::resummation_interval,
+           "events"_a, R"doc(
+
+             Set how often reaction propensities are summed exactly. Between
+             resummations the total propensity is updated incrementally, 
+             which accumulates rounding error over very long simulations.
+
+             Args:
+                events (int): number of events between resummations 
+                    (default 100000), or 0 to disable resummation
+
+             )doc")
+      .def("set_output_species", &Model::output_species, "species"_a,
+           R"doc(
+
+             Only write the given species to output, instead of every 
+             species, transcript and internal entry (such as promoters and 
+             polymerases) in the model. This makes output much smaller and 
+             faster to produce for large models.
+
+             Args:
+                species (list): species names or shell-style patterns, in 
+                    which '*' matches any sequence of characters and '?' any 
+                    single character, e.g. ["proteinX", "gene*"]. An empty 
+                    list reports all species again.
+
+             )doc")
+      .def("set_record_totals", &Model::record_totals, "enabled"_a = true,
+           R"doc(
+
+             Also report how much of each gene has been made since the start 
+             of the simulation, e.g. to fit production rates. The species 
+             ``<gene>_total`` has the number of proteins of the gene 
+             synthesized so far as its protein count and the number of its 
+             transcripts made as its transcript count, and 
+             ``transcript_total`` counts transcripts completed by 
+             polymerases. Totals are not reduced by degradation.
+
+             Args:
+                enabled (bool): whether to count totals
+
+             )doc")
+      .def("set_time_buckets", &Model::time_buckets, "enabled"_a = true,
+           R"doc(
+
+             Write each count as its average over the interval since the 
+             previous output time point, weighted by the time it held each 
+             value, instead of its value at the time point, with its minimum 
+             and maximum over the interval as ``<name>_min`` and 
+             ``<name>_max``. Coarse output then keeps the signal of dynamics 
+             faster than the time step. The first time point reports the 
+             initial counts. Not supported by the "batch" method.
+
+             Args:
+                enabled (bool): whether to write interval statistics
+
+             )doc")
+      .def("set_async_output", &Model::async_output, "enabled"_a = true,
+           R"doc(
+
+             Encode and write output files on a background thread. The 
+             simulation hands each time point to the writer thread through 
+             a fixed-size buffer and only waits for output when that buffer 
+             is full, which helps when formatting or disk writes are slow.
+
+             Args:
+                enabled (bool): whether to write output asynchronously 
+                    (default True)
+
+             )doc")
+      .def("set_run_ahead", &Model::run_ahead, "enabled"_a = true,
+           R"doc(
+
+             Let polymerases, ribosomes and RNases take long stretches of 
+             moves in a single event when nothing ahead of or behind them can change 
+             along the way (no promoter, binding site, terminator, element 
+             or mask, and uniform translation weights). The stretch takes 
+             an exactly distributed time, and an element's position in the 
+             middle of one is drawn from its exact distribution whenever 
+             another element needs it, so results have the same 
+             distribution as without run-ahead but take fewer events. 
+             Elements do not run ahead on polymers recording occupancy or 
+             event traces. Since events are then far apart, ``simulate`` 
+             records the counts at exactly each time point, as 
+             ``simulate_at`` does, rather than those of the first event 
+             past it.
+
+             Args:
+                enabled (bool): whether elements run ahead (default True)
+
+             )doc")
+      .def("set_codon_steps", &Model::codon_steps, "enabled"_a = true,
+           R"doc(
+
+             Let ribosomes move a codon (three nucleotides) per event, at a 
+             third of the rate, so that translation takes a third of the 
+             events. Ribosomes only take whole codons, waiting while the 
+             element ahead leaves less room, and cover, uncover and 
+             terminate at the same positions as when moving one nucleotide 
+             at a time. A ribosome's translation weight is looked up once 
+             per codon step. Ribosomes stepping by codon do not run ahead.
+
+             Args:
+                enabled (bool): whether ribosomes step by codon (default 
+                    True)
+
+             )doc")
+      .def("set_skip_blocked", &Model::skip_blocked, "enabled"_a = true,
+           R"doc(
+
+             Let polymerases, ribosomes and RNases that are blocked by the
+             element or mask ahead of them wait with a propensity of 0 until
+             they can move again, instead of spending events on moves that
+             change nothing. Results have the same distribution as without
+             it but take fewer events on crowded polymers. Each wait counts
+             as a single collision in ``stats``. As with ``set_run_ahead``, 
+             ``simulate`` then records the counts at exactly each time 
+             point.
+
+             Args:
+                enabled (bool): whether blocked elements wait (default
+                    True)
+
+             )doc")
+      .def("set_partial_equilibrium", &Model::partial_equilibrium,
+           "ratio"_a = 100.0, R"doc(
+
+             Treat fast reversible pairs of reactions added with 
+             ``add_reaction``, A + B <-> C or A <-> C, as being in 
+             equilibrium. When the simulation starts, a pair whose two 
+             propensities add up to at least ``ratio`` times those of all 
+             other species reactions stops firing, and its species are 
+             redrawn from their equilibrium distribution after every 
+             other reaction that could have let them relax (species 
+             reactions and binding) or that changes them. A species is part of at most one 
+             pair. This approximation holds while the pair stays much 
+             faster than the rest of the model; ``stats`` reports the 
+             events it saved.
+
+             Args:
+                ratio (float): how much faster than the other species 
+                    reactions a pair must be (default 100), or 0 to 
+                    simulate every reaction exactly
+
+             )doc")
+      .def("set_steady_state", &Model::steady_state, "window"_a,
+           "tolerance"_a = 0.01, R"doc(
+
+             Stop each simulation early once the counts of the output 
+             species (see ``set_output_species``) stop changing. At every 
+             output time point, the last ``2 * window`` points are split 
+             into two windows, and the run stops when every protein, 
+             transcript and ribo_density count has a mean in the newer 
+             window within ``tolerance`` (relative) plus two standard 
+             errors of its mean in the older one. The time of the point 
+             at which the run stopped is written to the output 
+             (as a ``# steady_state_time=...`` line in tab separated 
+             output, see ``pinetree.output.read_metadata`` for binary 
+             output, and under ``"metadata"`` by ``simulate_to_arrays``) 
+             and returned by ``steady_state_time``. Each call to a 
+             simulate method starts detecting afresh.
+
+             Args:
+                window (int): number of output time points per window, at 
+                    least 2, or 0 to always run to the time limit
+                tolerance (float): largest relative change of a mean 
+                    allowed beyond the statistical error (default 0.01)
+
+             )doc")
+      .def("set_common_random_numbers", &Model::common_random_numbers,
+           "enabled"_a = true, R"doc(
+
+             Give every reaction its own stream of random numbers for its 
+             waiting times, so that two runs from the same seed that 
+             differ in a parameter stay correlated and the difference 
+             between them has a much lower variance than between 
+             independent runs (common random numbers). Requires 
+             ``method="next_reaction"``. Which element of a polymer moves 
+             and which polymer an element binds are still drawn from the 
+             model's shared random number sequence. Must be set before the 
+             model is simulated.
+
+             Args:
+                enabled (bool): whether to use common random numbers
+
+             )doc")
+      .def("set_fast_random", &Model::fast_random, "enabled"_a = true,
+           R"doc(
+
+             Draw random numbers from a faster generator than the default 
+             Mersenne Twister: several xoshiro256++ streams generated in 
+             blocks, with waiting times drawn by the ziggurat method 
+             instead of a logarithm. Runs with the same seed still give the 
+             same results as each other, but not the same as with the 
+             default generator.
+
+             Args:
+                enabled (bool): whether to use the faster generator
+
+             )doc")
+      .def("steady_state_time",
+           [](const Model &model) -> py::object {
+             if (model.steady_state_time() < 0) {
+               return py::none();
+             }
+             return py::float_(model.steady_state_time());
+           },
+           R"doc(
+
+             Returns:
+                float: time at which the last simulation was found to be 
+                in steady state and stopped (see ``set_steady_state``), or 
+                None if it ran to the end.
+
+             )doc")
+      .def("stop_when", &Model::stop_when, "expression"_a, R"doc(
+
+             Stop each simulation as soon as a condition on counts holds, 
+             e.g. to measure first-passage times. A condition compares the 
+             copy number of a species, ``transcripts(gene)`` or 
+             ``ribosomes(gene)`` with a number using ``<``, ``<=``, ``>``, 
+             ``>=``, ``==`` or ``!=``, and comparisons are combined with 
+             ``and`` and ``or`` (or ``&&`` and ``||``), ``and`` binding 
+             more tightly, e.g. ``"gp10A >= 5000 or transcripts(gp10A) > 
+             20 and rnapol < 5"``. Conditions added by several calls stop 
+             a run when any of them holds, and are only evaluated after 
+             events that change a count they compare. The time and the 
+             clause that held are returned by ``stop_time`` and 
+             ``stop_condition``, and written to the output as 
+             ``stop_time`` and ``stop_condition`` (the index of the 
+             clause, in the order added) metadata, as for 
+             ``set_steady_state``.
+
+             Args:
+                expression (str): condition to add, or "" to remove every 
+                    condition
+
+             )doc")
+      .def("stop_time",
+           [](const Model &model) -> py::object {
+             if (model.stop_time() < 0) {
+               return py::none();
+             }
+             return py::float_(model.stop_time());
+           },
+           R"doc(
+
+             Returns:
+                float: time at which the last simulation was stopped by a 
+                condition (see ``stop_when``), or None if it was not.
+
+             )doc")
+      .def("stop_condition",
+           [](const Model &model) -> py::object {
+             if (model.stop_time() < 0) {
+               return py::none();
+             }
+             return py::str(model.stop_condition());
+           },
+           R"doc(
+
+             Returns:
+                str: clause that stopped the last simulation (see 
+                ``stop_when``), or None if it was not stopped.
+
+             )doc")
+      .def("set_parallel", &Model::parallel, "threads"_a, "window"_a = 0.1,
+           R"doc(
+
+             Move the elements on different genomes (each with the 
+             transcripts it made) on separate threads. Time is split into 
+             windows: species reactions and binding are simulated first 
+             over a window, then every genome moves its elements through 
+             the same window independently. Shorter windows are more 
+             accurate but synchronize more often. Results are only 
+             reproducible for a given seed with one thread. Parallel 
+             simulation cannot be combined with run-ahead, occupancy or 
+             event traces.
+
+             Args:
+                threads (int): number of threads, or 0 to simulate 
+                    serially
+                window (float): length of a window in seconds (default 
+                    0.1)
+
+             )doc")
+      .def("set_placement", &Model::placement, "policy"_a,
+           R"doc(
+
+             Pin the worker threads of ``simulate_ensemble`` and related 
+             methods to CPUs. Each worker pins itself before it builds its 
+             copy of the model and its output, so on machines with several 
+             NUMA nodes (e.g. sockets) that memory stays on the node that 
+             uses it. Workers that cannot be pinned, e.g. on platforms 
+             other than Linux, run unpinned. The placement is not copied to 
+             clones.
+
+             Args:
+                policy (str): "none" to leave threads to the operating 
+                    system (the default), "compact" to fill the CPUs of one 
+                    node before the next, or "spread" to take CPUs from 
+                    each node in turn
+
+             )doc")
+      .def("set_parameter",
+           (void (Model::*)(const std::string &, double)) & Model::parameter,
+           "name"_a, "value"_a, R"doc(
+
+             Change a rate parameter without rebuilding the model, for 
+             example between the replicates of a parameter sweep (see 
+             ``reset``). Only the propensities of reactions that depend on 
+             it are recomputed. Values set are kept by ``reset`` and copied 
+             by ``simulate_ensemble`` and ``fork``, but are not saved in 
+             checkpoints.
+
+             Args:
+                name (str): ``"<promoter>.<polymerase>"`` for the binding 
+                    constant of a promoter, ``"<gene>.rbs"`` for the 
+                    ribosome binding strength of a gene, 
+                    ``"<terminator>.<polymerase>"`` for the efficiency of a 
+                    terminator, ``"<polymerase>.speed"`` or 
+                    ``"ribosome.speed"`` for the speed of elements that bind 
+                    from then on, or ``"<reaction>.rate"`` for the rate 
+                    constant of a reaction given a name in 
+                    ``add_reaction``.
+                value (float): New value, which may not be negative.
+
+             )doc")
+      .def("parameter",
+           (double (Model::*)(const std::string &)) & Model::parameter,
+           "name"_a, R"doc(
+
+             Return the current value of a parameter named as for 
+             ``set_parameter``.
+
+             )doc")
+      .def("schedule_species", &Model::ScheduleSpecies, "time"_a, "name"_a,
+           "copy_number"_a, R"doc(
+
+             Add copies of a species (or remove them, if ``copy_number`` is 
+             negative) at a given simulation time, e.g. to model the 
+             addition of a drug. The engine makes the change at exactly 
+             that time in every run, without returning to Python, and 
+             changes at the same time are made in the order they were 
+             scheduled. Changes must be scheduled before the model is 
+             simulated.
+
+             Args:
+                time (float): simulation time of the change, in seconds
+                name (str): name of the species
+                copy_number (int): number of copies to add
+
+             )doc")
+      .def("schedule_parameter", &Model::ScheduleParameter, "time"_a,
+           "name"_a, "value"_a, R"doc(
+
+             Set a parameter, named as for ``set_parameter``, at a given 
+             simulation time, e.g. to switch on the promoter of a 
+             superinfecting genome whose binding constant starts at 0. 
+             The change applies from that time on in each run, including 
+             after ``reset`` and in restored checkpoints.
+
+             Args:
+                time (float): simulation time of the change, in seconds
+                name (str): name of the parameter
+                value (float): New value, which may not be negative.
+
+             )doc")
+      .def("set_progress",
+           [](Model &model, py::object callback, double interval) {
+             if (callback.is_none()) {
+               model.progress(nullptr, interval);
+               return;
+             }
+             auto function = callback.cast<py::function>();
+             model.progress(
+                 [function](double time, double events_per_second) {
+                   // Simulations run without the GIL
+                   py::gil_scoped_acquire acquire;
+                   function(time, events_per_second);
+                 },
+                 interval);
+           },
+           "callback"_a, "interval"_a = 1.0, R"doc(
+
+             Report progress while this model is simulated by calling a 
+             function with the current simulated time and the number of 
+             events executed per second of wall time since the previous 
+             report. Exceptions raised by the function stop the simulation 
+             and are raised by the simulating call. Clones, forks and 
+             ensemble replicates do not report progress.
+
+             Args:
+                callback (callable): function taking the simulated time and 
+                    events per second, or None to stop reporting
+                interval (float): minimum wall time, in seconds, between 
+                    reports (default 1)
+
+             )doc")
+      .def("cancel", &Model::Cancel, R"doc(
+
+             Ask the simulation in progress on another thread, or the next 
+             one to start if none is running, to stop before its next 
+             event. The simulating call returns normally with its output 
+             written up to that point, ``time`` reports where it stopped, 
+             and calling it again continues from there. Simulations release 
+             the GIL, so models may be simulated, monitored and cancelled 
+             from a Python thread pool.
+
+             )doc")
+      .def("record_occupancy", (void (Model::*)()) & Model::RecordOccupancy,
+           R"doc(
+
+             Start recording the time-averaged occupancy of polymerases, 
+             ribosomes and RNases at each position, for comparison with 
+             NET-seq or Ribo-seq profiles. An element is counted at its 
+             leading position. Retrieve the profiles with ``occupancy``.
+
+             )doc")
+      .def("occupancy",
+           [](const Model &model) {
+             auto averages = std::make_shared<OccupancyProfiles::Averages>(
+                 model.occupancy());
+             py::dict results;
+             for (auto &polymer : *averages) {
+               py::dict elements;
+               for (auto &element : polymer.second) {
+                 py::ssize_t length = element.second.size();
+                 elements[py::str(element.first)] =
+                     WrapCountsArray(averages, element.second, {length});
+               }
+               results[py::str(polymer.first)] = elements;
+             }
+             return results;
+           },
+           R"doc(
+
+             Report occupancy recorded since ``record_occupancy`` was called.
+
+             Returns:
+                dict: for each genome (or standalone transcript) name, a dict 
+                mapping element names (e.g. "rnapol", "__ribosome", 
+                "__rnase") to an array, indexed by position, of the mean 
+                number of elements at that position over simulated time. 
+                Ribosome and RNase occupancy is summed over all transcripts 
+                of a genome.
+
+             )doc")
+      .def("record_dwell_times", &Model::RecordDwellTimes,
+           "min_time"_a = 0.01, "max_time"_a = 100.0, "bins"_a = 32, R"doc(
+
+             Also record, at each position, a histogram of how long 
+             polymerases, ribosomes and RNases stay there before moving on, 
+             for pausing analysis. Starts occupancy recording if needed.
+
+             Args:
+                min_time (float): upper edge of the first bin (default 0.01)
+                max_time (float): lower edge of the last bin (default 100)
+                bins (int): total number of bins, all but the first and last 
+                    logarithmically spaced between min_time and max_time 
+                    (default 32)
+
+             )doc")
+      .def("dwell_times",
+           [](const Model &model) {
+             auto histograms = std::make_shared<OccupancyProfiles::Averages>(
+                 model.dwell_times());
+             auto edges = model.dwell_edges();
+             py::ssize_t bins = edges.empty() ? 0 : edges.size() - 1;
+             py::dict results;
+             results["edges"] = edges;
+             for (auto &polymer : *histograms) {
+               py::dict elements;
+               for (auto &element : polymer.second) {
+                 py::ssize_t length = element.second.size() / bins;
+                 elements[py::str(element.first)] =
+                     WrapCountsArray(histograms, element.second, {length, bins});
+               }
+               results[py::str(polymer.first)] = elements;
+             }
+             return results;
+           },
+           R"doc(
+
+             Report dwell times recorded since ``record_dwell_times`` was 
+             called.
+
+             Returns:
+                dict: "edges" maps to the list of bin edges, from 0 to 
+                infinity. Each genome (or standalone transcript) name maps 
+                to a dict from element names to an array of counts indexed 
+                by position and bin.
+
+             )doc")
+      .def("trace", &Model::Trace, "path"_a, R"doc(
+
+             Start recording every binding, movement, collision and 
+             termination of polymerases, ribosomes and RNases to a compact 
+             binary trace file. Read or replay it with ``pinetree.trace``. 
+             Only available when pinetree is built with the CMake option 
+             ``PINETREE_TRACE=ON`` (see ``pinetree.core.trace_enabled``).
+
+             Args:
+                path (str): trace file to write
+
+             )doc")
+      .def("stop_trace", &Model::StopTrace, R"doc(
+
+             Stop recording the event trace and close its file.
+
+             )doc")
+      .def("record_snapshots", &Model::RecordSnapshots, "path"_a, R"doc(
+
+             Write the positions of every polymerase, ribosome and RNase on 
+             every genome and transcript to a compact binary file at each 
+             output time of later simulations, e.g. for kymographs. Read it 
+             with ``pinetree.snapshot.read_snapshots``. Replicates of 
+             ``simulate_ensemble`` do not write snapshots.
+
+             Args:
+                path (str): snapshot file to write
+
+             )doc")
+      .def("stop_snapshots", &Model::StopSnapshots, R"doc(
+
+             Stop writing snapshots and close their file.
 
              )doc")
       .def("add_reaction", &Model::AddReaction, "rate_constant"_a,
-           "reactants"_a, "products"_a, R"doc(
+           "reactants"_a, "products"_a, "name"_a = "", R"doc(
              
             Define a reaction between species, which may include free 
             ribosomes and polymerases.
@@ -204,6 +1150,8 @@ PYBIND11_MODULE(core, m) {
                     ribosomes, or polymerases
                 products (list): List of products which may be species, 
                     ribosomes, or polymerases
+                name (str): Optional name of the reaction, so that its rate 
+                    constant can be changed with ``set_parameter``.
         
             Note:
                 Reaction rate constants should be given as macroscopic rate 
@@ -268,12 +1216,18 @@ PYBIND11_MODULE(core, m) {
               footprint (int): Footprint, in base pairs, of the ribosome on RNA
 
            )doc")
-      .def("register_genome", &Model::RegisterGenome, R"doc(
+      .def("register_genome", &Model::RegisterGenome, "genome"_a,
+           "copies"_a = 1, R"doc(
         
         Register a genome with the model.
 
+        Copies of the genome share their transcript layouts and one 
+        binding reaction per promoter and polymerase, so neither grows 
+        with the copy number.
+
         Args:
             genome (Genome): a pinetree ``Genome`` object.
+            copies (int): number of copies of the genome (default 1)
         
         )doc")
       .def("register_transcript", &Model::RegisterTranscript, R"doc(
@@ -284,8 +1238,272 @@ PYBIND11_MODULE(core, m) {
             transcript (Transcript): a pinetree ``Transcript`` object.
         
         )doc")
+      .def("simulate_to_arrays",
+           [](Model &model, int time_limit, int time_step,
+              const std::string &method) {
+             std::shared_ptr<CountsTable> table;
+             {
+               py::gil_scoped_release release;
+               table = std::make_shared<CountsTable>(
+                   model.SimulateToTable(time_limit, time_step, method));
+             }
+             return CountsTableToDict(table);
+           },
+           "time_limit"_a, "time_step"_a, "method"_a = "direct",
+           R"doc(
+            
+            Run a gene expression simulation and return species counts in 
+            memory instead of writing them to a file.
+
+            Args:
+                time_limit (int): Simulated time, in seconds, at which this 
+                    simulation should stop executing reactions.
+                time_step (int): Time interval, in seconds, that species 
+                    counts are reported.
+                method (str): Algorithm used to select the next reaction, as 
+                    for ``simulate``.
+
+            Returns:
+                dict: ``time`` is a 1-D array of output time points and 
+                ``species`` a list of species names. ``protein``, 
+                ``transcript`` and ``ribo_density`` are 2-D arrays with one 
+                row per time point and one column per species, in the order 
+                of ``species``; a species that has not appeared yet at a 
+                time point has zero counts. The arrays are NumPy arrays that 
+                share memory with the simulation output, or memoryviews if 
+                NumPy is not installed. ``metadata`` is a dict of 
+                properties of the run, such as ``steady_state_time`` (see 
+                ``set_steady_state``).
+
+          )doc")
+      .def("simulate_to_arrays_at",
+           [](Model &model, const std::vector<double> &times,
+              const std::string &method) {
+             std::shared_ptr<CountsTable> table;
+             {
+               py::gil_scoped_release release;
+               table = std::make_shared<CountsTable>(
+                   model.SimulateToTableAt(times, method));
+             }
+             return CountsTableToDict(table);
+           },
+           "times"_a, "method"_a = "direct",
+           R"doc(
+
+            Run a simulation through a list of output times and return the 
+            counts at exactly those times, as for ``simulate_at``, in the 
+            arrays returned by ``simulate_to_arrays``.
+
+            Args:
+                times (list): Output times, in seconds, in non-decreasing 
+                    order.
+                method (str): Algorithm used to select the next reaction, as 
+                    for ``simulate``.
+
+          )doc")
+      .def("simulate_at", &Model::SimulateAt, "times"_a,
+           "output"_a = "counts.tsv", "method"_a = "direct",
+           "format"_a = "tsv", py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Run a simulation through a list of output times, writing the 
+            counts at exactly each of those times. ``simulate`` writes the 
+            counts of the first reaction past each time step; this records 
+            the state of the system at the requested times instead, and 
+            the times need not be evenly spaced, e.g. 
+            ``[0] + [10 ** (k / 10) for k in range(31)]`` for log-spaced 
+            output up to 1000 seconds.
+
+            Args:
+                times (list): Output times, in seconds, in non-decreasing 
+                    order and no earlier than the current simulation time.
+                output (str): Name of output file (default: counts.tsv).
+                method (str): Algorithm used to select the next reaction, as 
+                    for ``simulate``.
+                format (str): Output file format, as for ``simulate``.
+
+          )doc")
+      .def("simulate_ensemble",
+           [](const Model &model, int n, int time_limit, int time_step,
+              const std::vector<int> &seeds, int threads,
+              const std::string &method, py::object output,
+              const std::string &format) -> py::object {
+             bool batch = method == "batch";
+             if (!output.is_none() && format == "hdf5") {
+               auto path = output.cast<std::string>();
+               py::gil_scoped_release release;
+               SimulateEnsembleToHdf5(model, n, time_limit, time_step, seeds,
+                                      threads, method, path);
+               return py::none();
+             }
+             if (!output.is_none()) {
+               auto prefix = output.cast<std::string>();
+               auto extension = format == "tsv" ? ".tsv" : ".bin";
+               py::gil_scoped_release release;
+               if (batch) {
+                 model.SimulateBatch(
+                     n, seeds, threads, BatchTimes(time_limit, time_step),
+                     [&](int replicate) {
+                       return CountsWriter::Create(
+                           format, prefix + "_" + std::to_string(replicate) +
+                                       extension);
+                     });
+                 return py::none();
+               }
+               model.SimulateEnsemble(
+                   n, seeds, threads, [&](int replicate, Model &replicate_model) {
+                     replicate_model.Simulate(
+                         time_limit, time_step,
+                         prefix + "_" + std::to_string(replicate) + extension,
+                         method, format);
+                   });
+               return py::none();
+             }
+             std::vector<std::shared_ptr<CountsTable>> tables(n);
+             if (batch) {
+               auto times = BatchTimes(time_limit, time_step);
+               py::gil_scoped_release release;
+               model.SimulateBatch(
+                   n, seeds, threads, times,
+                   [&](int) -> CountsWriter::Ptr {
+                     return CountsWriter::Ptr(
+                         new TableCountsWriter(times.size()));
+                   },
+                   [&](int replicate, CountsWriter &writer) {
+                     tables[replicate] = std::make_shared<CountsTable>(
+                         std::move(static_cast<TableCountsWriter &>(writer)
+                                       .table()));
+                   });
+             } else {
+               py::gil_scoped_release release;
+               model.SimulateEnsemble(
+                   n, seeds, threads, [&](int replicate, Model &replicate_model) {
+                     tables[replicate] = std::make_shared<CountsTable>(
+                         replicate_model.SimulateToTable(time_limit, time_step,
+                                                         method));
+                   });
+             }
+             py::list results;
+             for (auto &table : tables) {
+               results.append(CountsTableToDict(table));
+             }
+             return results;
+           },
+           "n"_a, "time_limit"_a, "time_step"_a,
+           "seeds"_a = std::vector<int>(), "threads"_a = 0,
+           "method"_a = "direct", "output"_a = py::none(), "format"_a = "tsv",
+           R"doc(
+            
+            Run independent replicates of this model in parallel threads. 
+            Each replicate is a copy of the model as defined so far, with 
+            its own random number generator; the model itself is not 
+            simulated and may be reused.
+
+            Args:
+                n (int): Number of replicates.
+                time_limit (int): Simulated time, in seconds, at which each 
+                    replicate stops executing reactions.
+                time_step (int): Time interval, in seconds, that species 
+                    counts are reported.
+                seeds (list): One seed per replicate, or a single seed 
+                    shared by all replicates, each using its own random 
+                    number stream. By default the shared seed is random.
+                threads (int): Number of threads (default: one per CPU).
+                method (str): Algorithm used to select the next reaction, as 
+                    for ``simulate``, or "batch" to simulate a model whose 
+                    only reactions are species reactions in lockstep 
+                    batches of 8 replicates, with vectorized propensity and 
+                    selection loops. Batch replicates report the state at 
+                    exactly each multiple of ``time_step`` up to 
+                    ``time_limit``, and follow other trajectories than the 
+                    other methods for the same seeds.
+                output (str): If given, replicate i writes its counts to 
+                    ``<output>_<i>.tsv`` (or ``.bin``) instead of returning 
+                    them. With format "hdf5", every replicate is written 
+                    to the single HDF5 file ``output`` instead.
+                format (str): Output file format, as for ``simulate``, or 
+                    "hdf5" if pinetree was built with 
+                    ``-DPINETREE_HDF5=ON``. The HDF5 file holds 
+                    "protein", "transcript" and "ribo_density" datasets 
+                    of shape (replicate, time point, species), chunked 
+                    and compressed, with "time", "species", 
+                    "time_points", per-replicate "metadata/seed" and 
+                    "metadata/stream", and the run length, output step 
+                    and parameters as attributes.
+
+            Returns:
+                list: One dict per replicate, as returned by 
+                ``simulate_to_arrays``, or None if ``output`` is given.
+
+          )doc")
+      .def("simulate_ensemble_stats",
+           [](const Model &model, int n, int time_limit, int time_step,
+              const std::vector<int> &seeds, int threads,
+              const std::string &method,
+              const std::vector<double> &quantiles) {
+             EnsembleStats stats(time_step, quantiles);
+             if (method == "batch") {
+               auto times = BatchTimes(time_limit, time_step);
+               py::gil_scoped_release release;
+               model.SimulateBatch(
+                   n, seeds, threads, times,
+                   [&](int) -> CountsWriter::Ptr {
+                     return CountsWriter::Ptr(
+                         new TableCountsWriter(times.size()));
+                   },
+                   [&](int, CountsWriter &writer) {
+                     stats.Add(static_cast<TableCountsWriter &>(writer).table());
+                   });
+             } else {
+               py::gil_scoped_release release;
+               model.SimulateEnsemble(
+                   n, seeds, threads, [&](int, Model &replicate_model) {
+                     stats.Add(replicate_model.SimulateToTable(
+                         time_limit, time_step, method));
+                   });
+             }
+             return EnsembleSummaryToDict(
+                 std::make_shared<EnsembleSummary>(stats.Summary()));
+           },
+           "n"_a, "time_limit"_a, "time_step"_a,
+           "seeds"_a = std::vector<int>(), "threads"_a = 0,
+           "method"_a = "direct", "quantiles"_a = std::vector<double>(),
+           R"doc(
+
+            Run replicates as for ``simulate_ensemble``, but return only 
+            per time point statistics of the ensemble. Each replicate's 
+            counts are added to running statistics as soon as it finishes 
+            and then discarded, so memory use does not grow with the number 
+            of replicates.
+
+            Args:
+                n (int): Number of replicates.
+                time_limit (int): Simulated time, in seconds, at which each 
+                    replicate stops executing reactions.
+                time_step (int): Time interval, in seconds, that species 
+                    counts are reported.
+                seeds (list): Seeds, as for ``simulate_ensemble``.
+                threads (int): Number of threads (default: one per CPU).
+                method (str): Algorithm used to select the next reaction, as 
+                    for ``simulate_ensemble``, including "batch".
+                quantiles (list): Quantiles to estimate, between 0 and 1, 
+                    e.g. [0.05, 0.5, 0.95]. Estimates are exact for up to five 
+                    replicates and use the P-square streaming algorithm 
+                    beyond that.
+
+            Returns:
+                dict: ``time``, ``species``, ``quantiles``, the number of 
+                ``replicates`` that reported each time point, and for each of 
+                ``protein``, ``transcript`` and ``ribo_density`` a dict of 
+                time x species arrays ``mean``, ``variance`` (sample 
+                variance), ``min`` and ``max``, plus a quantile x time x 
+                species array ``quantiles``. A species that a replicate never 
+                produced counts as 0 in that replicate.
+
+          )doc")
       .def("simulate", &Model::Simulate, "time_limit"_a, "time_step"_a,
-           "output"_a = "counts.tsv",
+           "output"_a = "counts.tsv", "method"_a = "direct",
+           "format"_a = "tsv", py::call_guard<py::gil_scoped_release>(),
            R"doc(
             
             Run a gene expression simulation. Produces a tab separated file of 
@@ -301,12 +1519,355 @@ PYBIND11_MODULE(core, m) {
                 time_step (int): Time interval, in seconds, that species counts 
                     are reported.
                 output (str): Name of output file (default: counts.tsv).
+                method (str): Algorithm used to select the next reaction. 
+                    "direct" (default) selects reactions from a sum tree in 
+                    logarithmic time. "direct_linear" scans all reaction 
+                    propensities on every step, and is kept for comparison.
+                    "composition_rejection" groups reactions into 
+                    power-of-two propensity bins and selects in constant 
+                    average time, which scales best for very large models.
+                    "next_reaction" uses the Gibson-Bruck next reaction 
+                    method, which only reschedules reactions whose 
+                    propensities change and works well for species 
+                    reaction networks where each event affects few 
+                    reactions.
+                    "hybrid" advances species reactions whose reactants 
+                    have high copy numbers by adaptive tau-leaping, while 
+                    polymerase, ribosome and RNase events remain exact. 
+                    This is much faster when bulk species reactions 
+                    dominate the event count, at a small cost in accuracy.
+                format (str): Output file format. "tsv" (default) writes 
+                    tab separated text. "binary" writes a compact packed 
+                    file that is much smaller and faster to write for large 
+                    models; read it with pinetree.output.read_counts. 
+                    "binary_delta" writes the same file, but records each 
+                    time point after the first as the counts that changed 
+                    since the previous one, which is much smaller when most 
+                    counts stay constant; read_counts restores every time 
+                    point in full.
+
+            Calling simulate again on the same model continues the 
+            simulation from where the previous call stopped. If it writes 
+            to the same output file in the same format, the new time points 
+            are appended, so simulating in several steps gives the same 
+            file as one call. The file is complete whenever simulate 
+            returns.
+
+          )doc")
+      .def("time", &Model::time, R"doc(
+
+            Current simulation time, in seconds.
+
+          )doc")
+      .def("species_names",
+           [](Model &model) { return model.tracker()->names(); },
+           R"doc(
+
+            Names of every species, gene and promoter known to the model, in
+            the order of the entries of ``species_counts``. Names are only
+            ever appended, so an index stays valid for the life of the
+            model.
+
+          )doc")
+      .def("species_counts",
+           [](Model &model) -> py::object {
+             std::shared_ptr<const SpeciesTracker> tracker = model.tracker();
+             py::object array = py::cast(SpeciesCountsArray{
+                 tracker, tracker->counts(),
+                 static_cast<py::ssize_t>(tracker->names().size())});
+             try {
+               return py::module::import("numpy").attr("asarray")(array);
+             } catch (py::error_already_set &) {
+               return py::memoryview(array);
+             }
+           },
+           R"doc(
+
+            Live copy numbers of the names in ``species_names``, as a 
+            read-only NumPy array (or a memoryview if NumPy is not 
+            installed) that reads the simulation's own counts without 
+            copying them. Names that are not species read 0.
+
+            The array follows the simulation as it continues, but only 
+            while the model has no new names: take a fresh one after each
+            call that may add species, such as ``simulate``, before reading
+            it again.
+
+            Example:
+
+                >>> sim.simulate_to_arrays(time_limit=10, time_step=1)
+                >>> names = sim.species_names()
+                >>> counts = sim.species_counts()
+                >>> print(counts[names.index("proteinX")])
+
+          )doc")
+      .def("checkpoint", &Model::Checkpoint, "path"_a,
+           py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Save the complete state of a simulation to a file, so that it 
+            can be resumed later with ``restore``.
+
+            Args:
+                path (str): Name of checkpoint file.
+
+          )doc")
+      .def("restore", &Model::Restore, "path"_a,
+           py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Resume a simulation saved with ``checkpoint``. Build this model 
+            with exactly the same definition as the checkpointed one and 
+            call restore before simulating; the next call to simulate then 
+            continues exactly where the checkpointed simulation stopped.
+
+            Args:
+                path (str): Name of checkpoint file.
+
+          )doc")
+      .def("reset", &Model::Reset, "seed"_a, "stream"_a = 0,
+           py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Return the model to the state it was in before it was first 
+            simulated and seed it, so that another replicate can be run 
+            without building the model again. The model's polymers and 
+            reactions are kept, so this is much faster than rebuilding it.
+
+            Args:
+                seed (int): Seed for the next replicate.
+                stream (int): Stream number, as for ``seed``.
+
+          )doc")
+      .def("fork", &Model::Fork, "n"_a, "seeds"_a = std::vector<int>(),
+           py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Branch independent copies of this model from its current state, 
+            without going through a checkpoint file. Simulate a model once 
+            through a shared burn-in period, then fork it and continue each 
+            fork with ``simulate``.
+
+            Args:
+                n (int): Number of forks.
+                seeds (list): One seed per fork, or a single seed shared by 
+                    all forks with fork i using random number stream i. If 
+                    empty (default), a random shared seed is chosen.
+
+            Returns:
+                list: ``n`` new models, each continuing from this model's 
+                current time with its own random number stream.
+
+          )doc")
+      .def("stats",
+           [](const Model &model) {
+             const auto &stats = model.stats();
+             const auto &polymers = model.polymer_stats();
+             const auto &timings = model.timings();
+             py::dict events;
+             events["species_reaction"] = stats.events[Reaction::SPECIES];
+             events["bind_polymerase"] =
+                 stats.events[Reaction::BIND_POLYMERASE];
+             events["bind_rnase"] = stats.events[Reaction::BIND_RNASE];
+             events["polymer"] = stats.events[Reaction::POLYMER];
+             long long total = 0;
+             for (long long count : stats.events) {
+               total += count;
+             }
+             py::dict wall_time;
+             wall_time["initialize"] = timings.initialize;
+             wall_time["simulate"] = timings.simulate;
+             wall_time["output"] = timings.output;
+             py::dict results;
+             results["propensity_updates"] = stats.propensity_updates;
+             results["redundant_updates"] = stats.redundant_updates;
+             results["propensity_updates_per_event"] =
+                 total > 0 ? double(stats.propensity_updates) / total : 0.0;
+             results["events"] = events;
+             results["leaps"] = stats.leaps;
+             results["scheduled_events"] = stats.scheduled;
+             results["reactions"] = model.reaction_count();
+             results["active_reactions"] = model.active_reactions();
+             results["moves"] = polymers.moves;
+             results["polymerase_collisions"] = polymers.polymerase_collisions;
+             results["mask_collisions"] = polymers.mask_collisions;
+             results["readthroughs"] = polymers.readthroughs;
+             results["transcripts_created"] = polymers.transcripts_created;
+             results["transcripts_destroyed"] = polymers.transcripts_destroyed;
+             results["runs"] = polymers.runs;
+             results["mean_field_ribosomes"] = polymers.mean_field_ribosomes;
+             results["mean_field_moves"] = polymers.mean_field_moves;
+             const auto &equilibrium = model.equilibrium_stats();
+             results["fast_pairs"] = equilibrium.pairs;
+             results["equilibrium_samples"] = equilibrium.samples;
+             results["fast_events_skipped"] = equilibrium.skipped_events;
+             results["wall_time"] = wall_time;
+             return results;
+           },
+           R"doc(
+
+            Report counts of work done by the simulation engine so far.
+
+            Returns:
+                dict: ``propensity_updates`` is the number of reaction 
+                propensities recomputed, ``redundant_updates`` the number 
+                of recomputations avoided because a reaction was affected 
+                more than once by the same event, and 
+                ``propensity_updates_per_event`` their ratio to events. 
+                ``events`` counts events by reaction class 
+                ("species_reaction", "bind_polymerase", "bind_rnase" and 
+                "polymer", i.e. moves of elements along a polymer), and 
+                ``leaps`` the tau-leaps of the hybrid method. 
+                ``scheduled_events`` counts the ends of runs of moves (see 
+                ``set_run_ahead``) and ``runs`` the runs started. 
+                ``reactions`` is the number of reactions in the simulation 
+                and ``active_reactions`` the number of them with a non-zero 
+                propensity, which are the only ones the linear method scans. 
+                ``moves`` 
+                counts moves that advanced an element, including those 
+                taken in runs, 
+                ``polymerase_collisions`` and ``mask_collisions`` the moves 
+                that were blocked, ``readthroughs`` the terminators read 
+                through, and ``transcripts_created`` and 
+                ``transcripts_destroyed`` the transcripts made and degraded 
+                during simulation. ``mean_field_ribosomes`` counts the 
+                ribosomes translated by the mean-field approximation (see 
+                ``Genome.set_mean_field_translation``) and 
+                ``mean_field_moves`` the moves they stood in for. 
+                ``fast_pairs`` is the number of pairs in 
+                partial equilibrium (see ``set_partial_equilibrium``), 
+                ``equilibrium_samples`` the times they were redrawn, and 
+                ``fast_events_skipped`` the expected number of their events 
+                that the samples stood in for. ``wall_time`` gives the 
+                seconds spent initializing, simulating and writing output.
+
+          )doc")
+      .def("memory_report",
+           [](const Model &model) {
+             MemoryReport report = model.memory_report();
+             py::dict results;
+             for (const auto &usage : report.usage()) {
+               py::dict values;
+               values["objects"] = usage.second.objects;
+               values["bytes"] = usage.second.bytes;
+               results[py::str(usage.first)] = values;
+             }
+             results["total"] = report.total();
+             results["pool_reserved"] = report.pool_reserved();
+             return results;
+           },
+           R"doc(
+
+            Estimate the heap memory held by the model, e.g. to find out 
+            what grows in a long run. Sizes are estimated from the 
+            containers of each part of the model when called, so they cost 
+            nothing while simulating, and data shared between objects is 
+            counted once.
+
+            Returns:
+                dict: for each subsystem ("genomes", "transcripts", 
+                "recycled" transcripts kept for reuse, "sites", "layouts" 
+                of transcript sites, "elements" bound to polymers, 
+                "weights", "definitions", "tracker", "reactions" and 
+                "engine"), a dict with the number of live ``objects`` and 
+                their estimated ``bytes``. ``total`` is the sum of bytes 
+                and ``pool_reserved`` the bytes reserved by the memory pool 
+                that elements and transcripts are allocated from, which 
+                are already counted in their subsystems.
+
+          )doc")
+      .def("dependency_report",
+           [](Model &model, int partitions, double hub_fraction) {
+             DependencyReport report =
+                 model.dependency_report(partitions, hub_fraction);
+             py::dict species;
+             for (const auto &item : report.species) {
+               py::dict values;
+               values["fan_out"] = item.second.fan_out;
+               values["writers"] = item.second.writers;
+               values["degree"] = item.second.degree;
+               values["hub"] = item.second.hub;
+               species[py::str(item.first)] = values;
+             }
+             py::list components;
+             for (const auto &component : report.components) {
+               py::dict values;
+               values["species"] = component.species;
+               values["reactions"] = component.reactions;
+               components.append(values);
+             }
+             py::list partition_list;
+             for (const auto &partition : report.partitions) {
+               py::dict values;
+               values["components"] = partition.components;
+               values["reactions"] = partition.reactions;
+               values["shared"] = partition.shared;
+               partition_list.append(values);
+             }
+             py::dict results;
+             results["reactions"] = report.reactions;
+             results["species"] = species;
+             results["hubs"] = report.hubs;
+             results["connected_components"] = report.connected_components;
+             results["components"] = components;
+             results["partitions"] = partition_list;
+             return results;
+           },
+           "partitions"_a = 1, "hub_fraction"_a = 0.1,
+           R"doc(
+
+            Analyze how the reactions of the model are coupled through the 
+            species they share, e.g. to choose an engine or split the model 
+            into partitions. Initializes the model if needed. Reactions 
+            read the species whose changes recompute their propensities. 
+            Species reactions write their reactants and products, binding 
+            reactions their promoter and element, and each polymer writes 
+            the sites it covers and 
+            uncovers, the elements it releases and, for genomes, the 
+            transcripts and proteins of its genes.
+
+            A species used by at least ``hub_fraction`` of the reactions, 
+            and by at least 3, is a hub, e.g. RNA polymerase or 
+            ``__ribosome``. Components are found without hubs and assigned 
+            largest first to the partition with the fewest reactions.
+
+            Args:
+                partitions (int): number of partitions to suggest
+                hub_fraction (float): fraction of reactions a hub is used by
+
+            Returns:
+                dict: number of ``reactions``; for each species, its 
+                ``fan_out`` (reactions whose propensity depends on it), 
+                ``writers``, ``degree`` (reactions using it) and whether it 
+                is a ``hub``; ``hubs``, most used first; the number of 
+                ``connected_components`` with hubs included; the 
+                ``components`` without hubs, largest first, as lists of 
+                ``species`` and ``reactions``; and the ``partitions``, each 
+                with the indexes of its ``components``, its number of 
+                ``reactions`` and the hubs it ``shared`` with others.
+
+          )doc")
+      .def("set_memory_sampling", &Model::memory_sampling, "enabled"_a = true,
+           R"doc(
+
+             Write the memory report (see ``memory_report``) to the output 
+             after every time point, as metadata ``memory_<subsystem>`` and 
+             ``memory_total`` in bytes. TSV and binary output keep every 
+             sample in order; other outputs keep the latest. Each sample 
+             visits every polymer, so this slows down runs with frequent 
+             output.
+
+             Args:
+                enabled (bool): whether to sample memory
 
           )doc");
 
   // Polymers, genomes, and transcripts
-  py::class_<Polymer, Polymer::Ptr>(m, "Polymer");
-  py::class_<Genome, Polymer, Genome::Ptr>(m, "Genome")
+  py::class_<Polymer, Polymer::Ptr>(m, "Polymer",
+                                    py::module_local(LOCAL_TYPES));
+  py::class_<Genome, Polymer, Genome::Ptr>(m, "Genome",
+                                            py::module_local(LOCAL_TYPES))
+      .def(py::pickle(&SaveDefinition<Genome>, &LoadDefinition<Genome>))
       .def(py::init<const std::string &, int, double, double, int, double>(),
            "name"_a, "length"_a, "transcript_degradation_rate_ext"_a = 0.0, 
            "rnase_speed"_a = 0.0, "rnase_footprint"_a = 0,
@@ -355,6 +1916,30 @@ PYBIND11_MODULE(core, m) {
                     weights are multiplied by the ribosome speed to calculate a 
                     final translation rate at every position in the genome.
 
+            )doc")
+      .def("set_mean_field_translation", &Genome::MeanFieldTranslation,
+           "gene"_a, "enabled"_a = true,
+           R"doc(
+
+            Translate a gene by a mean-field approximation of ribosome 
+            traffic instead of moving its ribosomes one position at a time, 
+            which saves the events of their moves. Ribosomes bind the 
+            gene's ribosome binding site as usual and cover it until they 
+            would have moved off it, then terminate after the mean time 
+            their moves take given the ribosome speed and translation 
+            weights, no closer together than the time it takes to cross 
+            the gene's slowest stretch of one ribosome footprint. They do 
+            not collide with other elements, cover sites downstream of 
+            the ribosome binding site or appear in occupancy profiles, and 
+            the ribosomes of a degraded transcript terminate at once. Must 
+            be called before the genome is registered. ``Model.simulate`` 
+            then records the counts at exactly each time point.
+
+            Args:
+                gene (str): Name of a gene of this genome.
+                enabled (bool): Whether to translate the gene by the 
+                    approximation (True) or exactly (False).
+
             )doc")
       .def("add_promoter", &Genome::AddPromoter, "name"_a, "start"_a, "stop"_a,
            "interactions"_a,
@@ -427,8 +2012,74 @@ PYBIND11_MODULE(core, m) {
             )doc")
       .def("add_rnase_site", (void (Genome::*)(const std::string&, int, int, double)) &Genome::AddRnaseSite, 
            "name"_a, "start"_a, "stop"_a, "rate"_a)
-      .def("add_rnase_site", (void (Genome::*)(int, int)) &Genome::AddRnaseSite, "start"_a, "stop"_a);
-  py::class_<Transcript, Polymer, Transcript::Ptr>(m, "Transcript")
+      .def("add_rnase_site", (void (Genome::*)(int, int)) &Genome::AddRnaseSite, "start"_a, "stop"_a)
+      .def("add_promoters", &Genome::AddPromoters, "names"_a, "starts"_a,
+           "stops"_a, "interactions"_a,
+           R"doc(
+            
+            Define many promoters in one call. Equivalent to calling
+            ``add_promoter`` for each entry in order, but much faster for
+            large genomes.
+
+            Args:
+                names (list): Names of promoters.
+                starts (list): Start positions, one per promoter.
+                stops (list): Stop positions, one per promoter.
+                interactions (dict): Binding rate constants of each 
+                    Polymerase, as a list with one entry per promoter.
+            
+            Example:
+                
+                >>> genome.add_promoters(names=["p1", "p2"], starts=[1, 40],
+                >>>                      stops=[10, 49],
+                >>>                      interactions={'rnapol': [1e7, 2e7]})
+
+            )doc")
+      .def("add_terminators", &Genome::AddTerminators, "names"_a, "starts"_a,
+           "stops"_a, "efficiency"_a,
+           R"doc(
+            
+            Define many terminators in one call. Equivalent to calling
+            ``add_terminator`` for each entry in order.
+
+            Args:
+                names (list): Names of terminators.
+                starts (list): Start positions, one per terminator.
+                stops (list): Stop positions, one per terminator.
+                efficiency (dict): Termination efficiencies of each 
+                    Polymerase, as a list with one entry per terminator.
+
+            )doc")
+      .def("add_genes", &Genome::AddGenes, "names"_a, "starts"_a, "stops"_a,
+           "rbs_starts"_a, "rbs_stops"_a, "rbs_strengths"_a,
+           R"doc(
+            
+            Define many genes in one call. Equivalent to calling 
+            ``add_gene`` for each entry in order. Arguments may be lists or
+            any other sequences, such as NumPy arrays, with one entry per 
+            gene.
+
+            Args:
+                names (list): Names of genes.
+                starts (list): Start positions of genes.
+                stops (list): Stop positions of genes.
+                rbs_starts (list): Start positions of ribosome binding sites.
+                rbs_stops (list): Stop positions of ribosome binding sites.
+                rbs_strengths (list): Binding rate constants between ribosomes
+                    and ribosome binding sites.
+
+            )doc")
+      .def("add_rnase_sites", &Genome::AddRnaseSites, "starts"_a, "stops"_a,
+           R"doc(
+            
+            Define many rnase sites in one call. Equivalent to calling
+            ``add_rnase_site(start, stop)`` for each entry in order.
+
+            )doc");
+  py::class_<Transcript, Polymer, Transcript::Ptr>(
+      m, "Transcript", py::module_local(LOCAL_TYPES))
+      .def(py::pickle(&SaveDefinition<Transcript>,
+                      &LoadDefinition<Transcript>))
       .def(py::init<const std::string &, int>(), "name"_a, "length"_a,
            R"doc(
             
@@ -472,4 +2123,137 @@ PYBIND11_MODULE(core, m) {
                 weights (list): List of weights of same length as Transcript. These weights are multiplied by the ribosome speed to calculate a final translation rate at every position in the genome.
 
             )doc");
+
+  py::class_<ModelCache>(m, "ModelCache", py::module_local(LOCAL_TYPES))
+      .def(py::init<const std::string &>(), "directory"_a,
+           R"doc(
+
+            Directory of compiled models keyed by a hash of the inputs they 
+            were built from, so that repeated runs skip parsing annotation 
+            files and building the model. Entries written by another 
+            version of pinetree are ignored and rebuilt.
+
+            Args:
+                directory (str): Directory holding the entries, created 
+                    when the first entry is stored.
+
+          )doc")
+      .def_static("key", &ModelCache::Key, "files"_a, "values"_a,
+                  R"doc(
+
+            Hash of the contents of input files and of other values (e.g. 
+            parameters formatted as text), as 16 hexadecimal digits. The 
+            key must cover every input of the build.
+
+            Args:
+                files (list): Paths of input files.
+                values (list): Other inputs, as strings.
+
+          )doc")
+      .def("load", &ModelCache::Load, "key"_a,
+           R"doc(
+
+            Model stored under a key, unseeded and in its initial state, or 
+            None if there is no readable entry for it.
+
+          )doc")
+      .def("store", &ModelCache::Store, "key"_a, "model"_a,
+           R"doc(
+
+            Store the definition of a model under a key, replacing any 
+            entry for it.
+
+          )doc")
+      .def("get", &ModelCache::Get, "key"_a, "build"_a,
+           R"doc(
+
+            Load the model stored under a key, or call ``build()`` and 
+            store the model it returns if there is none. The model returned 
+            is unseeded either way.
+
+            Args:
+                key (str): Key from ``ModelCache.key``.
+                build (callable): Function returning a new Model.
+
+          )doc")
+      .def("path", &ModelCache::path, "key"_a,
+           R"doc(
+
+            Path of the entry for a key.
+
+          )doc");
+
+  py::class_<Population>(m, "Population", py::module_local(LOCAL_TYPES))
+      .def(py::init<const Model &, int, int>(), "model"_a, "cells"_a,
+           "seed"_a,
+           R"doc(
+
+            A growing population of cells, each an instance of one compiled 
+            copy of a model with its own simulation state and random number 
+            stream, simulated on a pool of threads. Counts of every cell are 
+            summarized at each output time as the cells reach it, so no 
+            trajectory is kept. Results depend on the seed but not on the 
+            number of threads.
+
+            Args:
+                model (Model): Template model, which is left untouched.
+                cells (int): Number of founder cells, each in the model's 
+                    initial state.
+                seed (int): Seed shared by all cells, each using its own 
+                    random number stream.
+
+          )doc")
+      .def("set_division", &Population::division, "generation"_a,
+           "partition"_a = true,
+           R"doc(
+
+            Divide cells when they have lived for a time. A dividing cell 
+            is forked from its state; with ``partition``, each free 
+            molecule then goes to either cell with probability 1/2, while 
+            polymers and the elements bound to them are copied to both.
+
+            Args:
+                generation (float): Time from a cell's birth to its 
+                    division, or 0 to never divide.
+                partition (bool): Whether to split free molecules between 
+                    the daughters rather than copying them to both.
+
+          )doc")
+      .def("set_max_cells", &Population::max_cells, "cells"_a,
+           R"doc(
+
+            Keep at most a number of cells, removing cells at random at each 
+            output time, as in a chemostat, or every cell if 0.
+
+          )doc")
+      .def("set_threads", &Population::threads, "threads"_a,
+           R"doc(
+
+            Number of worker threads, or 0 for one per hardware thread.
+
+          )doc")
+      .def("simulate", &Population::Simulate, "time_limit"_a, "time_step"_a,
+           "method"_a = "direct", py::call_guard<py::gil_scoped_release>(),
+           R"doc(
+
+            Simulate every cell through each multiple of time_step up to 
+            time_limit, dividing cells as they come due. Calling this again 
+            continues from where it stopped with the same time step.
+
+          )doc")
+      .def("summary",
+           [](const Population &population) {
+             return EnsembleSummaryToDict(
+                 std::make_shared<EnsembleSummary>(population.Summary()));
+           },
+           R"doc(
+
+            Statistics of the counts of the cells alive at each output time 
+            so far, in the format of ``Model.simulate_ensemble_stats``, 
+            where ``replicates`` is the number of cells.
+
+          )doc")
+      .def("__len__", &Population::size)
+      .def_property_readonly("divisions", &Population::divisions)
+      .def_property_readonly("time", &Population::time);
 }
\ No newline at end of file
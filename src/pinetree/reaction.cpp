@@ -6,8 +6,13 @@ const static double AVAGADRO = double(6.0221409e+23);
 
 SpeciesReaction::SpeciesReaction(double rate_constant, double volume,
                                  const std::vector<std::string> &reactants,
-                                 const std::vector<std::string> &products)
-    : rate_constant_(rate_constant),
+                                 const std::vector<std::string> &products,
+                                 SpeciesTracker::Ptr tracker)
+    : Reaction(SPECIES),
+      tracker_(tracker),
+      rate_constant_(rate_constant),
+      macroscopic_rate_constant_(rate_constant),
+      volume_(volume),
       reactants_(reactants),
       products_(products) {
   // Error checking
@@ -32,15 +37,32 @@ SpeciesReaction::SpeciesReaction(double rate_constant, double volume,
   if (reactants_.size() == 2) {
     rate_constant_ = rate_constant_ / (AVAGADRO * volume);
   }
+  for (const auto &reactant : reactants_) {
+    reactant_ids_.push_back(tracker_->SpeciesId(reactant));
+  }
+  for (const auto &product : products_) {
+    product_ids_.push_back(tracker_->SpeciesId(product));
+  }
+}
+
+void SpeciesReaction::rate_constant(double rate_constant) {
+  if (rate_constant <= 0) {
+    throw std::invalid_argument("Reaction rate constant cannot be zero.");
+  }
+  macroscopic_rate_constant_ = rate_constant;
+  rate_constant_ = rate_constant;
+  if (reactants_.size() == 2) {
+    rate_constant_ = rate_constant_ / (AVAGADRO * volume_);
+  }
 }
 
 double SpeciesReaction::CalculatePropensity() {
   if (remove_ == true) {
     old_prop_ = 0;
   }
-  double new_prop = rate_constant_;
-  for (const auto &reactant : reactants_) {
-    new_prop *= SpeciesTracker::Instance().species(reactant);
+  double new_prop = fast_ ? 0 : rate_constant_;
+  for (int reactant : reactant_ids_) {
+    new_prop *= tracker_->species(reactant);
   }
   double prop_diff = new_prop - old_prop_;
   old_prop_ = new_prop;
@@ -48,17 +70,23 @@ double SpeciesReaction::CalculatePropensity() {
 }
 
 void SpeciesReaction::Execute() {
-  for (const auto &reactant : reactants_) {
-    SpeciesTracker::Instance().Increment(reactant, -1);
+  for (int reactant : reactant_ids_) {
+    tracker_->Increment(reactant, -1);
   }
-  for (const auto &product : products_) {
-    SpeciesTracker::Instance().Increment(product, 1);
+  for (int product : product_ids_) {
+    tracker_->Increment(product, 1);
   }
 }
 
-Bind::Bind(double rate_constant, double volume,
-           const std::string &promoter_name)
-    : rate_constant_(rate_constant), promoter_name_(promoter_name) {
+Bind::Bind(Kind kind, double rate_constant, double volume,
+           const std::string &promoter_name, SpeciesTracker::Ptr tracker,
+           Random::Ptr rng)
+    : Reaction(kind),
+      tracker_(tracker),
+      rng_(rng),
+      rate_constant_(rate_constant),
+      promoter_name_(promoter_name),
+      promoter_id_(tracker->SpeciesId(promoter_name)) {
   old_prop_ = 0;
   // Check volume
   if (volume <= 0) {
@@ -67,27 +95,30 @@ Bind::Bind(double rate_constant, double volume,
 }
 
 Polymer::Ptr Bind::ChoosePolymer() {
-  auto &tracker = SpeciesTracker::Instance();
-  auto weights = std::vector<double>();
-  for (const auto &polymer : tracker.FindPolymers(promoter_name_)) {
-    weights.push_back(double(polymer->uncovered(promoter_name_)));
-  }
-  Polymer::Ptr polymer =
-      Random::WeightedChoice(tracker.FindPolymers(promoter_name_), weights);
-  return polymer;
+  return tracker_->ChoosePolymer(promoter_id_, *rng_);
 }
 
 BindPolymerase::BindPolymerase(double rate_constant, double volume,
                                const std::string &promoter_name,
-                               const Polymerase &pol_template)
-    : Bind(rate_constant, volume, promoter_name), pol_template_(pol_template) {
+                               const Polymerase &pol_template,
+                               SpeciesTracker::Ptr tracker, Random::Ptr rng)
+    : Bind(BIND_POLYMERASE, rate_constant, volume, promoter_name, tracker,
+           rng),
+      pol_template_(pol_template),
+      macroscopic_rate_constant_(rate_constant),
+      volume_(volume),
+      pol_id_(tracker->SpeciesId(pol_template.name())) {
   rate_constant_ = rate_constant_ / (AVAGADRO * volume);
 }
 
+void BindPolymerase::rate_constant(double rate_constant) {
+  macroscopic_rate_constant_ = rate_constant;
+  rate_constant_ = rate_constant / (AVAGADRO * volume_);
+}
+
 double BindPolymerase::CalculatePropensity() {
-  auto &tracker = SpeciesTracker::Instance();
-  double new_prop = rate_constant_ * tracker.species(pol_template_.name()) *
-                    tracker.species(promoter_name_);
+  double new_prop = rate_constant_ * tracker_->species(pol_id_) *
+                    tracker_->species(promoter_id_);
   double prop_diff = new_prop - old_prop_;
   old_prop_ = new_prop;
   return prop_diff;
@@ -95,42 +126,47 @@ double BindPolymerase::CalculatePropensity() {
 
 void BindPolymerase::Execute() {
   auto polymer = ChoosePolymer();
-  auto new_pol = std::make_shared<Polymerase>(pol_template_);
+  auto new_pol = MakePooled<Polymerase>(polymer->pool(), pol_template_);
   polymer->Bind(new_pol, promoter_name_);
-  SpeciesTracker::Instance().propensity_signal_.Emit(polymer->wrapper());
+  tracker_->UpdatePropensity(polymer->wrapper());
   // Polymer should handle decrementing promoter
-  SpeciesTracker::Instance().Increment(new_pol->name(), -1);
+  tracker_->Increment(pol_id_, -1);
 }
 
 BindRnase::BindRnase(double rate_constant, double volume,
-                     const Rnase &rnase_template, const std::string &name)
-    : Bind(rate_constant, volume, name), pol_template_(rnase_template) {}
+                     const Rnase &rnase_template, const std::string &name,
+                     SpeciesTracker::Ptr tracker, Random::Ptr rng)
+    : Bind(BIND_RNASE, rate_constant, volume, name, tracker, rng),
+      pol_template_(rnase_template) {}
 
 void BindRnase::Execute() {
   auto polymer = ChoosePolymer();
-  auto new_pol = std::make_shared<Rnase>(pol_template_);
+  auto new_pol = MakePooled<Rnase>(polymer->pool(), pol_template_);
   polymer->Bind(new_pol, promoter_name_);
-  SpeciesTracker::Instance().propensity_signal_.Emit(polymer->wrapper());
+  tracker_->UpdatePropensity(polymer->wrapper());
 }
 
 double BindRnase::CalculatePropensity() {
   if (remove_ == true) {
     old_prop_ = 0;
   }
-  auto &tracker = SpeciesTracker::Instance();
-  double new_prop = rate_constant_ * tracker.species(promoter_name_);
+  double new_prop = rate_constant_ * tracker_->species(promoter_id_);
   double prop_diff = new_prop - old_prop_;
   old_prop_ = new_prop;
   return prop_diff;
 }
 
-PolymerWrapper::PolymerWrapper(Polymer::Ptr polymer) : polymer_(polymer) {
+PolymerWrapper::PolymerWrapper(Polymer::Ptr polymer)
+    : Reaction(POLYMER), polymer_(polymer) {
   old_prop_ = 0;
   polymer_->Initialize();
 }
 
 PolymerWrapper::~PolymerWrapper() {
   polymer_->Unlink();
+  if (polymer_->degrade() && polymer_.use_count() == 1) {
+    polymer_->Recycle();
+  }
   // std::cout << "Destroying polymer wrapper." << std::endl;
 }
 
@@ -143,6 +179,9 @@ void PolymerWrapper::Execute() {
   polymer_->Execute();
   if (polymer_->degrade() == true && polymer_->attached() == false) {
     remove_ = true;
+    if (polymer_->stats()) {
+      polymer_->stats()->transcripts_destroyed++;
+    }
     // std::cout << "Removing polymer wrapper...\n" << std::endl;
   }
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #ifndef SRC_REACTION_HPP  // header guard
 #define SRC_REACTION_HPP
 
+#include <functional>
+#include <limits>
+
 #include "polymer.hpp"
 /**
  * An abstract reaction class. Propensity refers to the reaction propensity, or
@@ -16,6 +19,21 @@ class Reaction : public std::enable_shared_from_this<Reaction> {
    */
   typedef std::shared_ptr<Reaction> Ptr;
   typedef std::vector<std::shared_ptr<Reaction>> VecPtr;
+  /**
+   * Classes of reaction, for counting events by class.
+   */
+  enum Kind {
+    SPECIES = 0,
+    BIND_POLYMERASE = 1,
+    BIND_RNASE = 2,
+    POLYMER = 3,
+    PERTURBATION = 4
+  };
+  /**
+   * Number of classes whose events are counted. Perturbations only have
+   * scheduled events, which are not counted by class.
+   */
+  static const int KIND_COUNT = 4;
   /**
    * Return the propensity of this reaction.
    *
@@ -26,6 +44,15 @@ class Reaction : public std::enable_shared_from_this<Reaction> {
    * Execute the reaction.
    */
   virtual void Execute() = 0;
+  /**
+   * Time of the next event that this reaction has scheduled for itself, or
+   * infinity if none. Unlike its random events, a scheduled event happens
+   * at exactly this time; Gillespie executes it with ExecuteScheduled().
+   */
+  virtual double scheduled_time() const {
+    return std::numeric_limits<double>::infinity();
+  }
+  virtual void ExecuteScheduled() {}
   /**
    * Should this reaction be removed from the reaction queue?
    *
@@ -37,25 +64,64 @@ class Reaction : public std::enable_shared_from_this<Reaction> {
    */
   virtual int index() const { return index_; }
   virtual void index(int index) { index_ = index; }
+  /**
+   * Propensity as of the last call to CalculatePropensity().
+   */
+  double propensity() const { return old_prop_; }
+  /**
+   * Set the cached propensity directly, when restoring a checkpoint.
+   */
+  void propensity(double propensity) { old_prop_ = propensity; }
+  /**
+   * Is this reaction queued for a propensity update? Maintained by
+   * Gillespie.
+   */
+  bool dirty() const { return dirty_; }
+  void dirty(bool dirty) { dirty_ = dirty; }
+  Kind kind() const { return kind_; }
+  /**
+   * Same as CalculatePropensity(), Execute(), scheduled_time() and
+   * ExecuteScheduled(), but dispatched on kind() to the final class of the
+   * reaction instead of through the vtable, so that Gillespie's inner loop
+   * makes direct (and often inlined) calls.
+   */
+  inline double DispatchPropensity();
+  inline void DispatchExecute();
+  inline double DispatchScheduledTime() const;
+  inline void DispatchExecuteScheduled();
 
  protected:
   /**
-   * The index of this reaction in the reaction list maintained by Model.
+   * @param kind class of this reaction, which must match its final class
+   *  (see DispatchPropensity)
+   */
+  explicit Reaction(Kind kind) : kind_(kind) {}
+  /**
+   * The index of this reaction in the reaction list maintained by Gillespie,
+   * or -1 if the reaction has not been linked.
    */
-  int index_;
+  int index_ = -1;
 
   double old_prop_ = 0;
   /**
    * Flag to mark reaction for removal.
    */
   bool remove_ = false;
+  /**
+   * Flag to mark reaction as queued for a propensity update.
+   */
+  bool dirty_ = false;
+  /**
+   * Class of this reaction.
+   */
+  const Kind kind_;
 };
 
 /**
  * A generic class for a species-level reaction. It currently only supports 2 or
  * fewer reactants.
  */
-class SpeciesReaction : public Reaction {
+class SpeciesReaction final : public Reaction {
  public:
   /**
    * The only constructor of SpeciesReaction.
@@ -65,11 +131,13 @@ class SpeciesReaction : public Reaction {
    * @param reactants vector of reactant names
    * @param products vector of product names
    * @param volume the volume in which these reactions will occur
+   * @param tracker SpeciesTracker that holds reactant and product counts
    *
    */
   SpeciesReaction(double rate_constant, double volume,
                   const std::vector<std::string> &reactants,
-                  const std::vector<std::string> &products);
+                  const std::vector<std::string> &products,
+                  std::shared_ptr<SpeciesTracker> tracker);
   /**
    * Convenience typedefs.
    */
@@ -89,12 +157,40 @@ class SpeciesReaction : public Reaction {
    */
   const std::vector<std::string> &reactants() const { return reactants_; }
   const std::vector<std::string> &products() const { return products_; }
+  const std::vector<int> &reactant_ids() const { return reactant_ids_; }
+  const std::vector<int> &product_ids() const { return product_ids_; }
+  const std::shared_ptr<SpeciesTracker> &tracker() const { return tracker_; }
+  /**
+   * Macroscopic rate constant, as given to the constructor. Setting it does
+   * not update the propensity.
+   */
+  double rate_constant() const { return macroscopic_rate_constant_; }
+  void rate_constant(double rate_constant);
+  /**
+   * Mesoscopic rate constant, i.e. the propensity per combination of
+   * reactants.
+   */
+  double propensity_constant() const { return rate_constant_; }
+  /**
+   * Fast reactions are left to PartialEquilibrium and have propensity 0.
+   * Setting this does not update the propensity.
+   */
+  bool fast() const { return fast_; }
+  void fast(bool fast) { fast_ = fast; }
 
  private:
   /**
-   * Rate constant of reaction.
+   * Tracker that holds reactant and product counts.
+   */
+  std::shared_ptr<SpeciesTracker> tracker_;
+  /**
+   * Mesoscopic rate constant of reaction, and the macroscopic rate constant
+   * and volume it was converted from.
    */
   double rate_constant_;
+  double macroscopic_rate_constant_;
+  double volume_;
+  bool fast_ = false;
   /**
    * Vector of reactant names.
    */
@@ -103,6 +199,11 @@ class SpeciesReaction : public Reaction {
    * Vector of product names.
    */
   const std::vector<std::string> products_;
+  /**
+   * SpeciesTracker IDs of reactants and products.
+   */
+  std::vector<int> reactant_ids_;
+  std::vector<int> product_ids_;
 };
 
 /**
@@ -113,12 +214,15 @@ class Bind : public Reaction {
   /**
    * The only constructor of Bind.
    *
+   * @param kind BIND_POLYMERASE or BIND_RNASE
    * @param rate_constant rate constant of the binding reaction
    * @param promoter_name name of promoter involved in this reaction
-   * @param pol_template Polymerase object that will get copied and bound to
-   *  Polymer upon execution of this reaction
+   * @param tracker SpeciesTracker that holds promoter and polymerase counts
+   * @param rng random number generator used to choose a polymer
    */
-  Bind(double rate_constant, double volume, const std::string &promoter_name);
+  Bind(Kind kind, double rate_constant, double volume,
+       const std::string &promoter_name,
+       std::shared_ptr<SpeciesTracker> tracker, std::shared_ptr<Random> rng);
   /**
    * Calculate propensity of binding reaction.
    *
@@ -136,8 +240,20 @@ class Bind : public Reaction {
    * @return pointer to polymer
    */
   Polymer::Ptr ChoosePolymer();
+  /**
+   * Name of the promoter (or binding site) bound.
+   */
+  const std::string &promoter_name() const { return promoter_name_; }
 
  protected:
+  /**
+   * Tracker that holds promoter and polymerase counts.
+   */
+  std::shared_ptr<SpeciesTracker> tracker_;
+  /**
+   * Random number generator used to choose a polymer.
+   */
+  std::shared_ptr<Random> rng_;
   /**
    * Rate constant of this reaction.
    */
@@ -146,12 +262,16 @@ class Bind : public Reaction {
    * Name of promoter involved in this binding reaction.
    */
   const std::string promoter_name_;
+  /**
+   * SpeciesTracker ID of promoter.
+   */
+  int promoter_id_;
 };
 
 /**
  * Bind a Polymerase to a polymer.
  */
-class BindPolymerase : public Bind {
+class BindPolymerase final : public Bind {
  public:
   /**
    * Only constructor for BindPolymerase.
@@ -159,10 +279,14 @@ class BindPolymerase : public Bind {
    * @param rate_constant binding rate constant
    * @param volume volume that in which reaction occurs
    * @param pol_template polymerase object to construct upon binding
+   * @param tracker SpeciesTracker that holds promoter and polymerase counts
+   * @param rng random number generator used to choose a polymer
    */
   BindPolymerase(double rate_constant, double volume,
                  const std::string &promoter_name,
-                 const Polymerase &pol_template);
+                 const Polymerase &pol_template,
+                 std::shared_ptr<SpeciesTracker> tracker,
+                 std::shared_ptr<Random> rng);
   /**
    * Bind the polymerase.
    */
@@ -171,18 +295,49 @@ class BindPolymerase : public Bind {
    * Calculate the propensity of binding occurring.
    */
   double CalculatePropensity();
+  /**
+   * Getters and setters. Setting the rate constant does not update the
+   * propensity, and setting the speed only affects polymerases bound from
+   * then on.
+   */
+  const Polymerase &pol_template() const { return pol_template_; }
+  double rate_constant() const { return macroscopic_rate_constant_; }
+  void rate_constant(double rate_constant);
+  /**
+   * Mesoscopic rate constant, i.e. the propensity per combination of
+   * reactants.
+   */
+  double propensity_constant() const { return rate_constant_; }
+  /**
+   * Fast reactions are left to PartialEquilibrium and have propensity 0.
+   * Setting this does not update the propensity.
+   */
+  bool fast() const { return fast_; }
+  void fast(bool fast) { fast_ = fast; }
+  void speed(double speed) { pol_template_.speed(speed); }
 
  private:
   /**
    * Polymerase object to be copied and bound to Polymer upon execution.
    */
-  const Polymerase pol_template_;
+  Polymerase pol_template_;
+  /**
+   * Binding rate constant as given to the constructor, and the volume used
+   * to convert it.
+   */
+  double macroscopic_rate_constant_;
+  double volume_;
+  bool fast_ = false;
+  /**
+   * SpeciesTracker ID of polymerase.
+   */
+  int pol_id_;
 };
 
 /**
  * Bind an RNase to a polymer.
  */
-class BindRnase : public Bind {
+class BindRnase final : public Bind {
  public:
   /**
    * Only constructor of BindRnase.
@@ -190,9 +345,12 @@ class BindRnase : public Bind {
    * @param rate_constant rate constant of binding reaction
    * @param volume volume in which reaction occurs
    * @param rnase_template Rnase to construct upon binding
+   * @param tracker SpeciesTracker that holds binding site counts
+   * @param rng random number generator used to choose a polymer
    */
   BindRnase(double rate_constant, double volume, const Rnase &rnase_template,
-            const std::string &name);
+            const std::string &name, std::shared_ptr<SpeciesTracker> tracker,
+            std::shared_ptr<Random> rng);
   /**
    * Bind Rnase to open binding site.
    */
@@ -212,8 +370,15 @@ class BindRnase : public Bind {
 /**
  * A thin wrapper for Polymer so it can participate in species-level reaction
  * processing.
+ *
+ * Together with Gillespie this forms a two-level sampler: Gillespie chooses a
+ * wrapper by the total propensity of its polymer's elements, which the
+ * polymer keeps at the root of its own PropensityTree, and the polymer then
+ * chooses one of its elements from that tree. A change to an element's
+ * propensity costs O(log n) in its polymer's tree and, once per event, one
+ * update of the wrapper at the top level.
  */
-class PolymerWrapper : public Reaction {
+class PolymerWrapper final : public Reaction {
  public:
   /**
    * Only constructor for PolymerWrapper.
@@ -223,7 +388,8 @@ class PolymerWrapper : public Reaction {
    */
   PolymerWrapper(Polymer::Ptr polymer);
   /**
-   * Make sure polymer that this object is wrapping is properly destroyed.
+   * Unlink the wrapped polymer, handing it back for reuse if it was degraded
+   * (see Polymer::Recycle).
    */
   ~PolymerWrapper();
   /**
@@ -236,25 +402,134 @@ class PolymerWrapper : public Reaction {
     if (remove_ == true) {
       old_prop_ = 0;
     }
-    double new_prop = polymer_->prop_sum() - old_prop_;
-    old_prop_ = polymer_->prop_sum();
+    double prop = parked_ ? 0 : polymer_->prop_sum();
+    double new_prop = prop - old_prop_;
+    old_prop_ = prop;
     return new_prop;
   }
   /**
    * Execute reaction within polymer (e.g. typically moving a polymerase)
    */
   void Execute();
+  /**
+   * Elements of the polymer finishing their runs of moves.
+   */
+  double scheduled_time() const { return polymer_->next_run_end(); }
+  void ExecuteScheduled() { polymer_->FinishRuns(); }
   /**
    * Getters and setters
    */
   void index(int index);
   int index() const { return index_; }
+  const Polymer::Ptr &polymer() const { return polymer_; }
+  /**
+   * Take the polymer out of the reaction queue, with a propensity of 0, or
+   * put it back. Parked polymers are moved by the worker threads of a
+   * parallel simulation instead (see Model::parallel), and their propensity
+   * must be updated after parking or unparking them.
+   */
+  void park(bool parked) { parked_ = parked; }
 
  private:
   /**
    * Pointer to polymer object that this reaction encapsulates.
    */
   Polymer::Ptr polymer_;
+  bool parked_ = false;
 };
 
+/**
+ * Timed changes to a model (see Model::ScheduleSpecies), which take effect
+ * as scheduled events at exactly their times and never fire at random.
+ */
+class Perturbations final : public Reaction {
+ public:
+  /**
+   * @param times times of the changes in non-decreasing order
+   * @param apply called with the index of each change at its time
+   */
+  Perturbations(const std::vector<double> &times,
+                std::function<void(int)> apply)
+      : Reaction(PERTURBATION), times_(times), apply_(std::move(apply)) {}
+  double CalculatePropensity() { return 0; }
+  void Execute() {}
+  double scheduled_time() const {
+    return next_ < static_cast<int>(times_.size())
+               ? times_[next_]
+               : std::numeric_limits<double>::infinity();
+  }
+  /**
+   * Make every change due at the time of the next one.
+   */
+  void ExecuteScheduled() {
+    double time = times_[next_];
+    while (next_ < static_cast<int>(times_.size()) && times_[next_] == time) {
+      apply_(next_++);
+    }
+  }
+  /**
+   * Number of changes made so far, which is saved in checkpoints. Setting
+   * it does not reschedule the reaction.
+   */
+  int next() const { return next_; }
+  void next(int next) { next_ = next; }
+
+ private:
+  std::vector<double> times_;
+  std::function<void(int)> apply_;
+  int next_ = 0;
+};
+
+double Reaction::DispatchPropensity() {
+  switch (kind_) {
+    case SPECIES:
+      return static_cast<SpeciesReaction *>(this)->CalculatePropensity();
+    case BIND_POLYMERASE:
+      return static_cast<BindPolymerase *>(this)->CalculatePropensity();
+    case BIND_RNASE:
+      return static_cast<BindRnase *>(this)->CalculatePropensity();
+    case PERTURBATION:
+      return 0;
+    default:
+      return static_cast<PolymerWrapper *>(this)->CalculatePropensity();
+  }
+}
+
+void Reaction::DispatchExecute() {
+  switch (kind_) {
+    case SPECIES:
+      static_cast<SpeciesReaction *>(this)->Execute();
+      break;
+    case BIND_POLYMERASE:
+      static_cast<BindPolymerase *>(this)->Execute();
+      break;
+    case BIND_RNASE:
+      static_cast<BindRnase *>(this)->Execute();
+      break;
+    case PERTURBATION:
+      break;
+    default:
+      static_cast<PolymerWrapper *>(this)->Execute();
+  }
+}
+
+double Reaction::DispatchScheduledTime() const {
+  // Only polymers and perturbations schedule events
+  if (kind_ == POLYMER) {
+    return static_cast<const PolymerWrapper *>(this)->scheduled_time();
+  }
+  if (kind_ == PERTURBATION) {
+    return static_cast<const Perturbations *>(this)->scheduled_time();
+  }
+  return std::numeric_limits<double>::infinity();
+}
+
+void Reaction::DispatchExecuteScheduled() {
+  if (kind_ == POLYMER) {
+    static_cast<PolymerWrapper *>(this)->ExecuteScheduled();
+  } else if (kind_ == PERTURBATION) {
+    static_cast<Perturbations *>(this)->ExecuteScheduled();
+  }
+}
+
 #endif  // header guard
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef SRC_SITE_INDEX_HPP  // header guard
+#define SRC_SITE_INDEX_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "IntervalTree.h"
+
+/**
+ * A static index of the fixed sites on a polymer, used in place of an
+ * IntervalTree on the polymerase movement path. Sites are sorted by start
+ * position and stored in flat arrays, so a query is a binary search followed
+ * by a short linear scan, and no memory is allocated.
+ *
+ * Because no site is longer than the longest site, only sites starting at
+ * most max_length() positions before a query can overlap it.
+ */
+template <class T>
+class SiteIndex {
+ public:
+  SiteIndex() = default;
+  /**
+   * Build an index from a list of intervals.
+   *
+   * @param intervals intervals to index, in any order
+   */
+  explicit SiteIndex(std::vector<Interval<T>> intervals) {
+    std::stable_sort(intervals.begin(), intervals.end(),
+                     [](const Interval<T> &a, const Interval<T> &b) {
+                       return a.start < b.start;
+                     });
+    starts_.reserve(intervals.size());
+    stops_.reserve(intervals.size());
+    values_.reserve(intervals.size());
+    for (auto &interval : intervals) {
+      starts_.push_back(interval.start);
+      stops_.push_back(interval.stop);
+      values_.push_back(interval.value);
+      int length = interval.stop - interval.start;
+      max_length_ = std::max(max_length_, length);
+    }
+  }
+  /**
+   * Call f on the value of every site overlapping [start, stop], in order of
+   * site start position.
+   *
+   * @param start first position of query (inclusive)
+   * @param stop last position of query (inclusive)
+   * @param f callable taking a const reference to a value
+   */
+  template <typename F>
+  void ForEachOverlapping(int start, int stop, F f) const {
+    for (int i = First(start - max_length_); i < size() && starts_[i] <= stop;
+         i++) {
+      if (stops_[i] >= start) {
+        f(values_[i]);
+      }
+    }
+  }
+  /**
+   * Call f on the value of every site contained in [start, stop], in order
+   * of site start position.
+   *
+   * @param start first position of query (inclusive)
+   * @param stop last position of query (inclusive)
+   * @param f callable taking a const reference to a value
+   */
+  template <typename F>
+  void ForEachContained(int start, int stop, F f) const {
+    for (int i = First(start); i < size() && starts_[i] <= stop; i++) {
+      if (stops_[i] <= stop) {
+        f(values_[i]);
+      }
+    }
+  }
+  /**
+   * @param position position to search from
+   * @return start of the first site starting at or after position, or the
+   *  largest int if there is none
+   */
+  int NextStart(int position) const {
+    int i = First(position);
+    return i < size() ? starts_[i] : std::numeric_limits<int>::max();
+  }
+  /**
+   * Find the first site, in order of start position, that ends at or after a
+   * position and satisfies a predicate.
+   *
+   * @param position position to search from
+   * @param f callable taking a const reference to a value and returning bool
+   * @return index of that site, or size() if there is none
+   */
+  template <typename F>
+  int FindEnding(int position, F f) const {
+    int i = First(position - max_length_);
+    while (i < size() && (stops_[i] < position || !f(values_[i]))) {
+      i++;
+    }
+    return i;
+  }
+  /**
+   * Getters and setters.
+   */
+  int size() const { return starts_.size(); }
+  int start(int index) const { return starts_[index]; }
+  int stop(int index) const { return stops_[index]; }
+  int max_length() const { return max_length_; }
+  /**
+   * @return bytes of heap memory held, not counting what values point to
+   */
+  std::size_t memory() const {
+    return (starts_.capacity() + stops_.capacity()) * sizeof(int) +
+           values_.capacity() * sizeof(T);
+  }
+
+ private:
+  /**
+   * Start positions, sorted.
+   */
+  std::vector<int> starts_;
+  /**
+   * Stop positions, in the same order as starts_.
+   */
+  std::vector<int> stops_;
+  /**
+   * Values, in the same order as starts_.
+   */
+  std::vector<T> values_;
+  /**
+   * Largest stop - start of any site.
+   */
+  int max_length_ = 0;
+  /**
+   * @param position position to search for
+   * @return index of first site starting at or after position
+   */
+  int First(int position) const {
+    return std::lower_bound(starts_.begin(), starts_.end(), position) -
+           starts_.begin();
+  }
+};
+
+#endif  // header guard
@@ -0,0 +1,100 @@
+#include <stdexcept>
+
+#include "polymer.hpp"
+#include "snapshot.hpp"
+
+PolymerSnapshots::PolymerSnapshots(const std::string &path)
+    : file_(path, std::ios::trunc | std::ios::binary) {
+  if (!file_) {
+    throw std::runtime_error("Could not open snapshot file '" + path + "'.");
+  }
+  buffer_.reserve(BUFFER_SIZE);
+  buffer_.append("PTSNAPS\0", 8);
+  Append<uint32_t>(buffer_, 1);
+}
+
+void PolymerSnapshots::Write(double time, const Reaction::VecPtr &reactions) {
+  snapshot_count_++;
+  entries_.clear();
+  uint32_t count = 0;
+  for (const auto &reaction : reactions) {
+    if (reaction->kind() != Reaction::POLYMER) {
+      continue;
+    }
+    const auto &polymer =
+        static_cast<PolymerWrapper *>(reaction.get())->polymer();
+    polymer->SyncRuns();
+    uint32_t id = PolymerId(reaction, *polymer);
+    const MobileElementManager &elements = polymer->mobile_elements();
+    for (int i = 0; i < elements.pair_count(); i++) {
+      const MobileElement *element = elements.pol(i);
+      int type_id = element->type_id();
+      int declared = declared_.size();
+      if (type_id >= declared || !declared_[type_id]) {
+        if (type_id >= declared) {
+          declared_.resize(type_id + 1, false);
+        }
+        declared_[type_id] = true;
+        buffer_ += 'N';
+        AppendName(type_id, static_cast<uint8_t>(element->kind()),
+                   element->name());
+      }
+      Append<uint32_t>(entries_, id);
+      Append<uint32_t>(entries_, type_id);
+      Append<int32_t>(entries_, elements.pol_start(i));
+      Append<int32_t>(entries_, elements.pol_stop(i));
+      count++;
+    }
+  }
+  // Forget polymers that have left the simulation
+  for (auto it = polymers_.begin(); it != polymers_.end();) {
+    if (it->second.snapshot != snapshot_count_) {
+      it = polymers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  buffer_ += 'T';
+  Append<double>(buffer_, time);
+  Append<uint32_t>(buffer_, count);
+  buffer_ += entries_;
+  if (buffer_.size() >= BUFFER_SIZE) {
+    Flush();
+  }
+}
+
+uint32_t PolymerSnapshots::PolymerId(const Reaction::Ptr &reaction,
+                                     const Polymer &polymer) {
+  Seen &seen = polymers_[reaction.get()];
+  if (seen.wrapper.lock() != reaction) {
+    auto transcript = dynamic_cast<const Transcript *>(&polymer);
+    auto genome = transcript ? transcript->genome() : nullptr;
+    seen.id = polymer_count_++;
+    seen.wrapper = reaction;
+    buffer_ += 'P';
+    AppendName(seen.id, transcript ? 1 : 0,
+               genome ? genome->name() : polymer.name());
+  }
+  seen.snapshot = snapshot_count_;
+  return seen.id;
+}
+
+void PolymerSnapshots::AppendName(uint32_t id, uint8_t kind,
+                                  const std::string &name) {
+  Append<uint32_t>(buffer_, id);
+  Append<uint8_t>(buffer_, kind);
+  Append<uint32_t>(buffer_, name.size());
+  buffer_ += name;
+}
+
+void PolymerSnapshots::Flush() {
+  file_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void PolymerSnapshots::Close() {
+  if (file_.is_open()) {
+    Flush();
+    file_.close();
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef SRC_SNAPSHOT_HPP  // header guard
+#define SRC_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "reaction.hpp"
+
+class Polymer;
+
+/**
+ * Compact binary record of where every polymerase, ribosome and RNase sits
+ * on every live genome and transcript at each output time, e.g. for
+ * kymographs. Snapshots are buffered in memory and appended to a file; read
+ * them back with pinetree.snapshot.
+ *
+ * The file starts with the magic bytes "PTSNAPS\0" and a uint32 version,
+ * followed by tagged little-endian records:
+ *  - 'P' uint32 polymer ID, uint8 kind (0 genome, 1 transcript), uint32 name
+ *    length, name: declares a polymer before its first snapshot. Each
+ *    genome and transcript gets its own ID for as long as it is part of the
+ *    simulation; transcripts are named after the genome that made them.
+ *  - 'N' uint32 element type ID, uint8 kind (0 polymerase, 1 ribosome, 2
+ *    RNase), uint32 name length, name: declares an element name before its
+ *    first snapshot
+ *  - 'T' double time, uint32 element count n, then n fixed-size entries of
+ *    uint32 polymer ID, uint32 element type ID, int32 start and int32 stop,
+ *    grouped by polymer and in order of position on each polymer
+ *
+ * Ribosomes translating by mean field (see Genome::MeanFieldTranslation)
+ * have no positions and are not recorded.
+ */
+class PolymerSnapshots {
+ public:
+  typedef std::unique_ptr<PolymerSnapshots> Ptr;
+  /**
+   * @param path file to write
+   * @throws std::runtime_error if the file cannot be opened
+   */
+  explicit PolymerSnapshots(const std::string &path);
+  ~PolymerSnapshots() { Close(); }
+  /**
+   * Record the elements on every polymer among the reactions of a
+   * simulation. Elements that are running ahead (see Polymer::run_ahead)
+   * are brought up to date first.
+   *
+   * @param time current simulation time
+   * @param reactions every reaction of the simulation
+   */
+  void Write(double time, const Reaction::VecPtr &reactions);
+  /**
+   * Write buffered snapshots to the file.
+   */
+  void Flush();
+  /**
+   * Flush and close the file. Further snapshots must not be written.
+   */
+  void Close();
+
+ private:
+  static const std::size_t BUFFER_SIZE = 1 << 20;
+  std::ofstream file_;
+  std::string buffer_;
+  /**
+   * Snapshot ID of each polymer wrapper seen in the last snapshot. The weak
+   * pointer tells a wrapper apart from a later one at the same address.
+   */
+  struct Seen {
+    uint32_t id = 0;
+    std::weak_ptr<Reaction> wrapper;
+    uint64_t snapshot = 0;
+  };
+  std::unordered_map<const Reaction *, Seen> polymers_;
+  uint32_t polymer_count_ = 0;
+  uint64_t snapshot_count_ = 0;
+  /**
+   * Which element type IDs have been declared.
+   */
+  std::vector<bool> declared_;
+  /**
+   * Reused storage for the entries of one snapshot.
+   */
+  std::string entries_;
+  /**
+   * Snapshot ID of a polymer wrapper, declaring it if it is new.
+   */
+  uint32_t PolymerId(const Reaction::Ptr &reaction, const Polymer &polymer);
+  template <typename T>
+  static void Append(std::string &buffer, const T &value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer.append(bytes, sizeof(T));
+  }
+  void AppendName(uint32_t id, uint8_t kind, const std::string &name);
+};
+
+#endif  // header guard
@@ -0,0 +1,85 @@
+"""Reader for polymer snapshots written by Model.record_snapshots."""
+
+import array
+import struct
+import sys
+
+MAGIC = b"PTSNAPS\0"
+POLYMER_KINDS = ("genome", "transcript")
+ELEMENT_KINDS = ("polymerase", "ribosome", "rnase")
+FIELDS = ("polymer", "element", "start", "stop")
+
+try:
+    import numpy
+    # One snapshot entry, as written by PolymerSnapshots
+    ENTRY_DTYPE = numpy.dtype([("polymer", "<u4"), ("element", "<u4"),
+                               ("start", "<i4"), ("stop", "<i4")])
+except ImportError:
+    numpy = None
+
+
+def read_snapshots(path):
+    """
+    Read a snapshot file written by Model.record_snapshots.
+
+    Args:
+        path (str): path to snapshot file
+
+    Returns:
+        dict: "polymers" maps polymer IDs to (name, kind) tuples, with kind
+        "genome" or "transcript" and transcripts named after their genome,
+        and "elements" maps element IDs to (name, kind) tuples, with kind
+        "polymerase", "ribosome" or "rnase". "time" lists the time of each
+        snapshot, and "polymer", "element", "start" and "stop" list one
+        array per snapshot with the polymer ID, element ID and position of
+        each element, grouped by polymer and in order of position. The
+        arrays are NumPy arrays if NumPy is installed, or array.array
+        otherwise; with NumPy they share memory with the file contents.
+    """
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError("'{}' is not a pinetree snapshot file.".format(path))
+    version, = struct.unpack_from("<I", data, 8)
+    if version != 1:
+        raise ValueError(
+            "Unsupported snapshot file version {}.".format(version))
+    results = {"polymers": {}, "elements": {}, "time": []}
+    for field in FIELDS:
+        results[field] = []
+    pos = 12
+    while pos < len(data):
+        tag = data[pos:pos + 1]
+        pos += 1
+        if tag == b"T":
+            time, n = struct.unpack_from("<dI", data, pos)
+            pos += 12
+            results["time"].append(time)
+            block = data[pos:pos + 16 * n]
+            pos += 16 * n
+            if numpy is not None:
+                entries = numpy.frombuffer(block, dtype=ENTRY_DTYPE)
+                for field in FIELDS:
+                    results[field].append(entries[field])
+            else:
+                values = array.array("i")
+                values.frombytes(block)
+                if sys.byteorder != "little":
+                    values.byteswap()
+                for i, field in enumerate(FIELDS):
+                    column = values[i::4]
+                    if i < 2:
+                        column = array.array("I", column.tobytes())
+                    results[field].append(column)
+        elif tag in (b"P", b"N"):
+            index, kind, length = struct.unpack_from("<IBI", data, pos)
+            pos += 9
+            name = data[pos:pos + length].decode("utf-8")
+            pos += length
+            if tag == b"P":
+                results["polymers"][index] = (name, POLYMER_KINDS[kind])
+            else:
+                results["elements"][index] = (name, ELEMENT_KINDS[kind])
+        else:
+            raise ValueError("Corrupt snapshot file '{}'.".format(path))
+    return results
@@ -0,0 +1,152 @@
+#include "species_batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+const int SpeciesBatch::LANES;
+
+SpeciesBatch::SpeciesBatch(const std::vector<int> &counts,
+                           const std::vector<bool> &present,
+                           const std::vector<Reaction> &reactions)
+    : species_(counts.size()),
+      initial_counts_(counts),
+      initially_present_(present) {
+  change_start_.push_back(0);
+  for (const auto &reaction : reactions) {
+    if (reaction.reactants.size() > 2) {
+      throw std::invalid_argument(
+          "Pinetree does not support reactions with more than two reactant "
+          "species.");
+    }
+    rate_constants_.push_back(reaction.rate_constant);
+    first_.push_back(reaction.reactants.size() > 0 ? reaction.reactants[0]
+                                                   : species_);
+    second_.push_back(reaction.reactants.size() > 1 ? reaction.reactants[1]
+                                                    : species_);
+    std::map<int, int> changes;
+    for (int reactant : reaction.reactants) {
+      changes[reactant]--;
+    }
+    for (int product : reaction.products) {
+      changes[product]++;
+    }
+    for (const auto &change : changes) {
+      if (change.second != 0) {
+        change_species_.push_back(change.first);
+        change_count_.push_back(change.second);
+      }
+    }
+    change_start_.push_back(change_species_.size());
+  }
+  counts_.resize((species_ + 1) * LANES);
+  appeared_.resize(species_ * LANES);
+  propensities_.resize(reactions.size() * LANES);
+}
+
+long long SpeciesBatch::Run(const std::vector<Random *> &rngs,
+                            const std::vector<double> &times,
+                            const Output &output) {
+  if (rngs.size() > LANES) {
+    throw std::invalid_argument("A batch holds at most " +
+                                std::to_string(LANES) + " replicates.");
+  }
+  int lanes = rngs.size();
+  int reactions = rate_constants_.size();
+  int outputs = times.size();
+  for (int species = 0; species < species_; species++) {
+    std::fill_n(&counts_[species * LANES], LANES,
+                double(initial_counts_[species]));
+  }
+  std::fill_n(&counts_[species_ * LANES], LANES, 1.0);
+  for (int species = 0; species < species_; species++) {
+    std::fill_n(&appeared_[species * LANES], LANES,
+                char(initially_present_[species]));
+  }
+
+  std::array<double, LANES> time = {}, total, target, sum;
+  std::array<int, LANES> next = {}, chosen, last;
+  std::array<bool, LANES> active;
+  int running = 0;
+  for (int lane = 0; lane < LANES; lane++) {
+    active[lane] = lane < lanes && !times.empty();
+    running += active[lane];
+  }
+  long long fired = 0;
+  while (running > 0) {
+    // Propensities of every reaction in every lane, including lanes that
+    // have finished, so that the loops have no branches
+    for (int j = 0; j < reactions; j++) {
+      const double *first = &counts_[first_[j] * LANES];
+      const double *second = &counts_[second_[j] * LANES];
+      double *propensity = &propensities_[j * LANES];
+      double rate_constant = rate_constants_[j];
+      for (int lane = 0; lane < LANES; lane++) {
+        propensity[lane] = rate_constant * first[lane] * second[lane];
+      }
+    }
+    total.fill(0);
+    for (int j = 0; j < reactions; j++) {
+      const double *propensity = &propensities_[j * LANES];
+      for (int lane = 0; lane < LANES; lane++) {
+        total[lane] += propensity[lane];
+      }
+    }
+
+    // Time of the next event, reporting the current state at every output
+    // time before it
+    for (int lane = 0; lane < LANES; lane++) {
+      if (!active[lane]) {
+        continue;
+      }
+      Random &rng = *rngs[lane];
+      double event = std::numeric_limits<double>::infinity();
+      if (total[lane] > 0) {
+        event = time[lane] + rng.exponential() / total[lane];
+      }
+      while (next[lane] < outputs && times[next[lane]] < event) {
+        output(lane, next[lane], &counts_[lane]);
+        next[lane]++;
+      }
+      if (next[lane] == outputs) {
+        active[lane] = false;
+        running--;
+        continue;
+      }
+      time[lane] = event;
+      target[lane] = rng.random() * total[lane];
+    }
+
+    // Reaction j fires when its cumulative propensity is the first to pass
+    // the target, i.e. j reactions have cumulative propensities no greater
+    // than it; rounding can carry the count past the last reaction that
+    // may fire, which is then chosen
+    sum.fill(0);
+    chosen.fill(0);
+    last.fill(0);
+    for (int j = 0; j < reactions; j++) {
+      const double *propensity = &propensities_[j * LANES];
+      for (int lane = 0; lane < LANES; lane++) {
+        sum[lane] += propensity[lane];
+        chosen[lane] += sum[lane] <= target[lane];
+        last[lane] = propensity[lane] > 0 ? j : last[lane];
+      }
+    }
+    for (int lane = 0; lane < LANES; lane++) {
+      if (!active[lane]) {
+        continue;
+      }
+      int j = std::min(chosen[lane], last[lane]);
+      for (int k = change_start_[j]; k < change_start_[j + 1]; k++) {
+        int species = change_species_[k];
+        counts_[species * LANES + lane] += change_count_[k];
+        appeared_[species * LANES + lane] = 1;
+      }
+      fired++;
+    }
+  }
+  return fired;
+}
@@ -0,0 +1,105 @@
+#ifndef SRC_SPECIES_BATCH_HPP  // header guard
+#define SRC_SPECIES_BATCH_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "choices.hpp"
+
+/**
+ * Exact simulation of a network of species reactions for a batch of
+ * replicates in lockstep. Every replicate (lane) takes one step of the
+ * direct method per iteration, and counts and propensities are stored as
+ * [species][lane] and [reaction][lane] arrays so that computing
+ * propensities, their sums and the selected reaction are loops over lanes
+ * that the compiler vectorizes. Only the firing of the selected reactions
+ * and the random numbers are handled lane by lane.
+ *
+ * Propensities are recomputed in full at every step, which beats the
+ * bookkeeping of incremental updates for the small networks that lockstep
+ * suits; large networks are better served by Gillespie.
+ */
+class SpeciesBatch {
+ public:
+  /**
+   * Number of replicates simulated in lockstep.
+   */
+  static const int LANES = 8;
+  /**
+   * A species reaction: its mesoscopic rate constant (see
+   * SpeciesReaction) and the IDs of its (up to two) reactants and its
+   * products.
+   */
+  struct Reaction {
+    double rate_constant;
+    std::vector<int> reactants;
+    std::vector<int> products;
+  };
+  /**
+   * Called with a lane, the index of an output time and the count of
+   * every species in that lane at that time, strided by LANES.
+   */
+  typedef std::function<void(int, int, const double *)> Output;
+  /**
+   * @param counts initial count of each species, indexed by ID
+   * @param present whether each species has a count initially, as opposed
+   *  to appearing once a reaction produces it
+   * @param reactions reactions over those species
+   */
+  SpeciesBatch(const std::vector<int> &counts,
+               const std::vector<bool> &present,
+               const std::vector<Reaction> &reactions);
+  /**
+   * Simulate one batch from the initial counts.
+   *
+   * @param rngs random number generator of each lane, at most LANES; lanes
+   *  beyond them are not simulated
+   * @param times output times, in non-decreasing order and no earlier
+   *  than 0
+   * @param output called with the state of each lane at each output time
+   * @return number of reactions fired over all lanes
+   */
+  long long Run(const std::vector<Random *> &rngs,
+                const std::vector<double> &times, const Output &output);
+  /**
+   * Has a species appeared in a lane, i.e. was it present initially or has
+   * a reaction produced it?
+   */
+  bool appeared(int species, int lane) const {
+    return appeared_[species * LANES + lane];
+  }
+
+ private:
+  /**
+   * Number of species, not counting the constant row (see counts_).
+   */
+  int species_;
+  std::vector<int> initial_counts_;
+  std::vector<bool> initially_present_;
+  /**
+   * Rate constant and the rows of counts_ holding the two reactants of
+   * each reaction, where a missing reactant is the constant row.
+   */
+  std::vector<double> rate_constants_;
+  std::vector<int> first_;
+  std::vector<int> second_;
+  /**
+   * Net changes of reaction j as (species, change) pairs over
+   * [change_start_[j], change_start_[j + 1]).
+   */
+  std::vector<int> change_start_;
+  std::vector<int> change_species_;
+  std::vector<int> change_count_;
+  /**
+   * Counts as [species][lane], followed by a row of ones.
+   */
+  std::vector<double> counts_;
+  std::vector<char> appeared_;
+  /**
+   * Propensities as [reaction][lane].
+   */
+  std::vector<double> propensities_;
+};
+
+#endif  // header guard
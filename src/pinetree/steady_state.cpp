@@ -0,0 +1,66 @@
+#include "steady_state.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tracker.hpp"
+
+SteadyState::SteadyState(int window, double tolerance)
+    : window_(window), tolerance_(tolerance) {
+  samples_.reserve(2 * window);
+}
+
+bool SteadyState::Add(SpeciesTracker &tracker) {
+  std::vector<SpeciesTracker::Counts> rows;
+  tracker.GatherCounts(rows);
+  std::vector<double> sample;
+  if (static_cast<int>(samples_.size()) == 2 * window_) {
+    sample.swap(samples_[next_]);
+  }
+  sample.clear();
+  for (const auto &row : rows) {
+    if (3 * (row.species_id + 1) > static_cast<int>(sample.size())) {
+      sample.resize(3 * (row.species_id + 1), 0.0);
+    }
+    sample[3 * row.species_id] = row.protein;
+    sample[3 * row.species_id + 1] = row.transcript;
+    sample[3 * row.species_id + 2] = row.ribo_density;
+  }
+  if (static_cast<int>(samples_.size()) < 2 * window_) {
+    samples_.push_back(std::move(sample));
+    if (static_cast<int>(samples_.size()) < 2 * window_) {
+      return false;
+    }
+  } else {
+    samples_[next_].swap(sample);
+    next_ = (next_ + 1) % samples_.size();
+  }
+  std::size_t values = 0;
+  for (const auto &held : samples_) {
+    values = std::max(values, held.size());
+  }
+  for (std::size_t value = 0; value < values; value++) {
+    // Mean and variance of the older and newer windows
+    double sums[2] = {0, 0};
+    double squares[2] = {0, 0};
+    for (int i = 0; i < 2 * window_; i++) {
+      const auto &held = samples_[(next_ + i) % samples_.size()];
+      double x = value < held.size() ? held[value] : 0.0;
+      sums[i / window_] += x;
+      squares[i / window_] += x * x;
+    }
+    double means[2], variance = 0;
+    for (int half = 0; half < 2; half++) {
+      means[half] = sums[half] / window_;
+      variance += std::max(
+          (squares[half] - sums[half] * means[half]) / (window_ - 1), 0.0);
+    }
+    double allowed =
+        tolerance_ * std::max(std::abs(means[0]), std::abs(means[1])) +
+        2 * std::sqrt(variance / window_);
+    if (std::abs(means[1] - means[0]) > allowed) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SRC_STEADY_STATE_HPP  // header guard
+#define SRC_STEADY_STATE_HPP
+
+#include <vector>
+
+class SpeciesTracker;
+
+/**
+ * Online test of whether the reported counts of a simulation have become
+ * stationary. The counts (protein, transcript and ribo_density of every
+ * output species) are sampled at each output time point, and the run is
+ * stationary once, for every one of them, the means over the last two
+ * windows of samples differ by no more than a given fraction of the larger
+ * mean plus twice the standard error of their difference. A trend shows up
+ * as a difference of means larger than the spread it adds within each
+ * window, so only counts that fluctuate around a level pass.
+ */
+class SteadyState {
+ public:
+  /**
+   * @param window number of samples in each window, at least 2
+   * @param tolerance largest relative change of a mean between windows
+   *  allowed beyond the statistical error
+   */
+  SteadyState(int window, double tolerance);
+  /**
+   * Sample the reported counts of a tracker.
+   *
+   * @return true if the last two windows are stationary
+   */
+  bool Add(SpeciesTracker &tracker);
+
+ private:
+  int window_;
+  double tolerance_;
+  /**
+   * The last 2 * window_ samples, oldest first once full, as flat vectors
+   * with three values per species ID. Samples taken before a species
+   * appeared are shorter and count as 0.
+   */
+  std::vector<std::vector<double>> samples_;
+  /**
+   * Index in samples_ of the next sample to overwrite once it is full.
+   */
+  int next_ = 0;
+};
+
+#endif  // header guard
@@ -0,0 +1,176 @@
+#include "stop_condition.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "tracker.hpp"
+
+/**
+ * Split an expression into names, numbers, operators and parentheses.
+ */
+static std::vector<std::string> Tokenize(const std::string &expression) {
+  static const std::string kOperators = "<>=!&|";
+  std::vector<std::string> tokens;
+  std::size_t i = 0;
+  while (i < expression.size()) {
+    char c = expression[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      i++;
+    } else if (c == '(' || c == ')') {
+      tokens.push_back(std::string(1, c));
+      i++;
+    } else if (kOperators.find(c) != std::string::npos) {
+      std::size_t end = i;
+      while (end < expression.size() &&
+             kOperators.find(expression[end]) != std::string::npos) {
+        end++;
+      }
+      tokens.push_back(expression.substr(i, end - i));
+      i = end;
+    } else {
+      std::size_t end = i;
+      while (end < expression.size() &&
+             !std::isspace(static_cast<unsigned char>(expression[end])) &&
+             kOperators.find(expression[end]) == std::string::npos &&
+             expression[end] != '(' && expression[end] != ')') {
+        end++;
+      }
+      tokens.push_back(expression.substr(i, end - i));
+      i = end;
+    }
+  }
+  return tokens;
+}
+
+void StopCondition::Add(const std::string &expression) {
+  std::vector<std::string> tokens = Tokenize(expression);
+  auto fail = [&](const std::string &message) {
+    throw std::invalid_argument("Invalid stop condition '" + expression +
+                                "': " + message + ".");
+  };
+  std::vector<Clause> clauses(1);
+  std::size_t i = 0;
+  auto next = [&]() -> const std::string & {
+    if (i == tokens.size()) {
+      fail("unexpected end");
+    }
+    return tokens[i++];
+  };
+  while (true) {
+    Comparison comparison;
+    std::string operand = next();
+    comparison.quantity = Quantity::SPECIES;
+    if ((operand == "transcripts" || operand == "ribosomes") &&
+        i < tokens.size() && tokens[i] == "(") {
+      comparison.quantity = operand == "transcripts" ? Quantity::TRANSCRIPTS
+                                                     : Quantity::RIBOSOMES;
+      i++;
+      comparison.name = next();
+      if (next() != ")") {
+        fail("expected ')' after " + operand + "(" + comparison.name);
+      }
+      operand += "(" + comparison.name + ")";
+    } else {
+      comparison.name = operand;
+    }
+    if (comparison.name == "(" || comparison.name == ")" ||
+        std::isdigit(static_cast<unsigned char>(comparison.name.front()))) {
+      fail("expected a name instead of '" + comparison.name + "'");
+    }
+    const std::string &op = next();
+    if (op == "<") {
+      comparison.op = Op::LESS;
+    } else if (op == "<=") {
+      comparison.op = Op::LESS_EQUAL;
+    } else if (op == ">") {
+      comparison.op = Op::GREATER;
+    } else if (op == ">=") {
+      comparison.op = Op::GREATER_EQUAL;
+    } else if (op == "==") {
+      comparison.op = Op::EQUAL;
+    } else if (op == "!=") {
+      comparison.op = Op::NOT_EQUAL;
+    } else {
+      fail("unknown comparison '" + op + "'");
+    }
+    const std::string &number = next();
+    char *end = nullptr;
+    comparison.value = std::strtod(number.c_str(), &end);
+    if (number.empty() || *end != '\0') {
+      fail("expected a number instead of '" + number + "'");
+    }
+    Clause &clause = clauses.back();
+    if (!clause.text.empty()) {
+      clause.text += " and ";
+    }
+    clause.text += operand + " " + op + " " + number;
+    clause.comparisons.push_back(comparison);
+    if (i == tokens.size()) {
+      break;
+    }
+    const std::string &junction = next();
+    if (junction == "or" || junction == "||") {
+      clauses.emplace_back();
+    } else if (junction != "and" && junction != "&&") {
+      fail("expected 'and' or 'or' instead of '" + junction + "'");
+    }
+  }
+  clauses_.insert(clauses_.end(), clauses.begin(), clauses.end());
+}
+
+void StopCondition::Watch(SpeciesTracker &tracker) {
+  for (auto &clause : clauses_) {
+    for (auto &comparison : clause.comparisons) {
+      comparison.id = tracker.SpeciesId(comparison.name);
+      tracker.Watch(comparison.id);
+    }
+  }
+}
+
+int StopCondition::Check(const SpeciesTracker &tracker) const {
+  for (int index = 0; index < static_cast<int>(clauses_.size()); index++) {
+    bool holds = true;
+    for (const auto &comparison : clauses_[index].comparisons) {
+      double count;
+      switch (comparison.quantity) {
+        case Quantity::SPECIES:
+          count = tracker.count(comparison.id);
+          break;
+        case Quantity::TRANSCRIPTS:
+          count = tracker.transcripts(comparison.id);
+          break;
+        default:
+          count = tracker.ribo_per_transcript(comparison.id);
+          break;
+      }
+      switch (comparison.op) {
+        case Op::LESS:
+          holds = count < comparison.value;
+          break;
+        case Op::LESS_EQUAL:
+          holds = count <= comparison.value;
+          break;
+        case Op::GREATER:
+          holds = count > comparison.value;
+          break;
+        case Op::GREATER_EQUAL:
+          holds = count >= comparison.value;
+          break;
+        case Op::EQUAL:
+          holds = count == comparison.value;
+          break;
+        default:
+          holds = count != comparison.value;
+          break;
+      }
+      if (!holds) {
+        break;
+      }
+    }
+    if (holds) {
+      return index;
+    }
+  }
+  return -1;
+}
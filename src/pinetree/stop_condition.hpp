@@ -0,0 +1,73 @@
+#ifndef SRC_STOP_CONDITION_HPP  // header guard
+#define SRC_STOP_CONDITION_HPP
+
+#include <string>
+#include <vector>
+
+class SpeciesTracker;
+
+/**
+ * Conditions on counts that end a run as soon as they hold, e.g. to
+ * measure first-passage times. A condition is a list of clauses, any of
+ * which may hold, and each clause is a list of comparisons that must all
+ * hold, written as in "gp10A >= 5000 and rnapol < 10 or transcripts(gp10A)
+ * > 20". A comparison compares the copy number of a species, the number of
+ * transcripts of a gene (transcripts(gene)) or the number of ribosomes on
+ * transcripts of a gene (ribosomes(gene)) with a number, using <, <=, >,
+ * >=, == or !=. "and" binds more tightly than "or", "&&" and "||" may be
+ * used instead, and parentheses do not group comparisons.
+ *
+ * Only the names in a condition are watched (see SpeciesTracker::Watch), so
+ * the comparisons are only evaluated after events that change one of them.
+ */
+class StopCondition {
+ public:
+  /**
+   * Parse an expression and add its clauses to this condition.
+   *
+   * @throws std::invalid_argument if the expression is malformed
+   */
+  void Add(const std::string &expression);
+  /**
+   * Remove every clause.
+   */
+  void Clear() { clauses_.clear(); }
+  bool empty() const { return clauses_.empty(); }
+  /**
+   * Look up the ID of every name in a tracker, adding names it has not
+   * seen yet, and watch them.
+   */
+  void Watch(SpeciesTracker &tracker);
+  /**
+   * Evaluate the clauses on the counts of the tracker last passed to Watch.
+   *
+   * @return index of the first clause that holds, or -1
+   */
+  int Check(const SpeciesTracker &tracker) const;
+  /**
+   * @return text of a clause, with names and numbers separated by single
+   *  spaces
+   */
+  const std::string &clause(int index) const { return clauses_[index].text; }
+
+ private:
+  enum class Quantity { SPECIES, TRANSCRIPTS, RIBOSOMES };
+  enum class Op { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+  struct Comparison {
+    Quantity quantity;
+    std::string name;
+    /**
+     * ID of name, set by Watch.
+     */
+    int id = -1;
+    Op op;
+    double value;
+  };
+  struct Clause {
+    std::vector<Comparison> comparisons;
+    std::string text;
+  };
+  std::vector<Clause> clauses_;
+};
+
+#endif  // header guard
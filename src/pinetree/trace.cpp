@@ -0,0 +1,47 @@
+#include <stdexcept>
+
+#include "trace.hpp"
+
+EventTrace::EventTrace(const std::string &path, const double *clock)
+    : file_(path, std::ios::trunc | std::ios::binary), clock_(clock) {
+  if (!file_) {
+    throw std::runtime_error("Could not open trace file '" + path + "'.");
+  }
+  buffer_.reserve(BUFFER_SIZE);
+  buffer_.append("PTTRACE\0", 8);
+  Append<uint32_t>(1);
+}
+
+uint32_t EventTrace::AddPolymer(const std::string &name) {
+  uint32_t id = polymer_count_++;
+  buffer_ += 'P';
+  AppendName(id, name);
+  return id;
+}
+
+void EventTrace::DeclareElement(int type_id, const std::string &name) {
+  if (type_id >= static_cast<int>(declared_.size())) {
+    declared_.resize(type_id + 1, false);
+  }
+  declared_[type_id] = true;
+  buffer_ += 'N';
+  AppendName(type_id, name);
+}
+
+void EventTrace::AppendName(uint32_t id, const std::string &name) {
+  Append<uint32_t>(id);
+  Append<uint32_t>(name.size());
+  buffer_ += name;
+}
+
+void EventTrace::Flush() {
+  file_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void EventTrace::Close() {
+  if (file_.is_open()) {
+    Flush();
+    file_.close();
+  }
+}
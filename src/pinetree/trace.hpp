@@ -0,0 +1,131 @@
+#ifndef SRC_TRACE_HPP  // header guard
+#define SRC_TRACE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Events recorded by EventTrace.
+ */
+enum class TraceEvent : uint8_t {
+  BIND = 0,       // element bound to the polymer
+  MOVE = 1,       // element advanced by one position
+  BLOCKED = 2,    // element collided with the element ahead of it
+  MASKED = 3,     // element collided with the polymer's mask
+  TERMINATE = 4,  // element terminated or ran off the end of the polymer
+  REMOVE = 5      // element removed because its polymer was degraded
+};
+
+/**
+ * Compact binary log of the movements of mobile elements, for studying
+ * stalls and collisions after a simulation instead of adding print
+ * statements to Polymer. Events are buffered in memory and appended to a
+ * file; read them back with pinetree.trace.
+ *
+ * The file starts with the magic bytes "PTTRACE\0" and a uint32 version,
+ * followed by tagged little-endian records:
+ *  - 'P' uint32 polymer ID, uint32 name length, name: declares a polymer
+ *  - 'N' uint32 element type ID, uint32 name length, name: declares an
+ *    element name (before its first event)
+ *  - 'E' double time, uint8 event, uint32 polymer ID, uint32 element type
+ *    ID, int32 position: one TraceEvent at the element's leading position
+ *
+ * Recording hooks are only compiled in when PINETREE_TRACE is defined (see
+ * PINETREE_TRACE_EVENT), so the trace costs nothing in normal builds.
+ */
+class EventTrace {
+ public:
+  typedef std::shared_ptr<EventTrace> Ptr;
+  /**
+   * @param path file to write
+   * @param clock current simulation time, which must outlive the trace
+   */
+  EventTrace(const std::string &path, const double *clock);
+  ~EventTrace() { Close(); }
+  /**
+   * Declare a polymer.
+   *
+   * @param name name of the polymer, e.g. its genome's name for transcripts
+   * @return ID of the polymer in the trace
+   */
+  uint32_t AddPolymer(const std::string &name);
+  /**
+   * Record an event of an element at a position of a polymer.
+   *
+   * @param event what happened
+   * @param polymer ID returned by AddPolymer
+   * @param type_id interned ID of the element's name
+   * @param name element's name
+   * @param position element's leading (stop) position
+   */
+  void Record(TraceEvent event, uint32_t polymer, int type_id,
+              const std::string &name, int position) {
+    if (type_id >= static_cast<int>(declared_.size()) || !declared_[type_id]) {
+      DeclareElement(type_id, name);
+    }
+    buffer_ += 'E';
+    Append<double>(*clock_);
+    Append<uint8_t>(static_cast<uint8_t>(event));
+    Append<uint32_t>(polymer);
+    Append<uint32_t>(type_id);
+    Append<int32_t>(position);
+    if (buffer_.size() >= BUFFER_SIZE) {
+      Flush();
+    }
+  }
+  /**
+   * Write buffered events to the file.
+   */
+  void Flush();
+  /**
+   * Flush and close the file. Further events must not be recorded.
+   */
+  void Close();
+
+ private:
+  /**
+   * Buffered bytes before they are written to the file.
+   */
+  static const std::size_t BUFFER_SIZE = 1 << 20;
+  std::ofstream file_;
+  std::string buffer_;
+  const double *clock_;
+  uint32_t polymer_count_ = 0;
+  /**
+   * Which element type IDs have been declared.
+   */
+  std::vector<bool> declared_;
+  void DeclareElement(int type_id, const std::string &name);
+  template <typename T>
+  void Append(const T &value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer_.append(bytes, sizeof(T));
+  }
+  void AppendName(uint32_t id, const std::string &name);
+};
+
+/**
+ * Record an event to an EventTrace pointer if it is set. Expands to nothing
+ * unless pinetree is built with PINETREE_TRACE defined (CMake option
+ * PINETREE_TRACE), so that normal builds have no tracing overhead.
+ */
+#ifdef PINETREE_TRACE
+#define PINETREE_TRACE_EVENT(trace, event, polymer, element, position)    \
+  do {                                                                     \
+    if (trace) {                                                           \
+      (trace)->Record(TraceEvent::event, polymer, (element).type_id(),     \
+                      (element).name(), position);                         \
+    }                                                                      \
+  } while (0)
+#else
+#define PINETREE_TRACE_EVENT(trace, event, polymer, element, position) \
+  do {                                                                  \
+  } while (0)
+#endif
+
+#endif  // header guard
@@ -0,0 +1,128 @@
+"""Reader and replay tool for event traces written by Model.trace."""
+
+import struct
+import sys
+
+MAGIC = b"PTTRACE\0"
+EVENTS = ("bind", "move", "blocked", "masked", "terminate", "remove")
+
+
+def read_trace(path):
+    """
+    Read an event trace written by Model.trace.
+
+    Args:
+        path (str): path to trace file
+
+    Returns:
+        dict: "polymers" and "elements" map IDs to names, and "events" is a
+        list of (time, event, polymer ID, element ID, position) tuples in
+        the order they happened, with event names from EVENTS.
+    """
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError("'{}' is not a pinetree trace file.".format(path))
+    version, = struct.unpack_from("<I", data, 8)
+    if version != 1:
+        raise ValueError("Unsupported trace file version {}.".format(version))
+    results = {"polymers": {}, "elements": {}, "events": []}
+    pos = 12
+    while pos < len(data):
+        tag = data[pos:pos + 1]
+        pos += 1
+        if tag == b"E":
+            time, event, polymer, element, position = struct.unpack_from(
+                "<dBIIi", data, pos)
+            pos += 21
+            results["events"].append(
+                (time, EVENTS[event], polymer, element, position))
+        elif tag in (b"P", b"N"):
+            index, length = struct.unpack_from("<II", data, pos)
+            pos += 8
+            table = results["polymers" if tag == b"P" else "elements"]
+            table[index] = data[pos:pos + length].decode("utf-8")
+            pos += length
+        else:
+            raise ValueError("Corrupt trace file '{}'.".format(path))
+    return results
+
+
+def replay(path):
+    """
+    Reconstruct the trajectory of every element in an event trace. Elements
+    are told apart by their position, since no two elements on a polymer
+    share a leading position.
+
+    Args:
+        path (str): path to trace file
+
+    Returns:
+        list: one dict per element, in order of binding, with its "polymer"
+        and "element" names, the polymer's trace ID ("polymer_id"), the
+        "times" and "positions" it occupied, the number of failed moves
+        caused by collisions with elements ("blocked") or masks ("masked"),
+        and how it left the polymer ("end": "terminate", "remove", or None
+        if it was still bound when the trace ended).
+    """
+    trace = read_trace(path)
+    tracks = []
+    bound = {}
+    for time, event, polymer, element, position in trace["events"]:
+        if event == "bind":
+            track = {
+                "polymer": trace["polymers"][polymer],
+                "polymer_id": polymer,
+                "element": trace["elements"][element],
+                "times": [time],
+                "positions": [position],
+                "blocked": 0,
+                "masked": 0,
+                "end": None
+            }
+            tracks.append(track)
+            bound[(polymer, position)] = track
+            continue
+        # Elements bound before tracing started have no bind event
+        key = (polymer, position - 1 if event == "move" else position)
+        track = bound.pop(key, None)
+        if track is None:
+            track = {
+                "polymer": trace["polymers"][polymer],
+                "polymer_id": polymer,
+                "element": trace["elements"][element],
+                "times": [],
+                "positions": [],
+                "blocked": 0,
+                "masked": 0,
+                "end": None
+            }
+            tracks.append(track)
+        if event == "move":
+            track["times"].append(time)
+            track["positions"].append(position)
+        elif event in ("blocked", "masked"):
+            track[event] += 1
+        else:
+            track["end"] = event
+            continue
+        bound[(polymer, position)] = track
+    return tracks
+
+
+def main(argv):
+    """Print the events of a trace file as tab separated values."""
+    if len(argv) != 2:
+        sys.stderr.write("usage: python -m pinetree.trace TRACE_FILE\n")
+        return 2
+    trace = read_trace(argv[1])
+    sys.stdout.write("time\tevent\tpolymer\tpolymer_id\telement\tposition\n")
+    for time, event, polymer, element, position in trace["events"]:
+        sys.stdout.write("{:f}\t{}\t{}\t{}\t{}\t{}\n".format(
+            time, event, trace["polymers"][polymer], polymer,
+            trace["elements"][element], position))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
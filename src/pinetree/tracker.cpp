@@ -1,19 +1,51 @@
 #include <algorithm>
 
+#include "checks.hpp"
 #include "tracker.hpp"
 
-SpeciesTracker &SpeciesTracker::Instance() {
-  static SpeciesTracker instance;
-  return instance;
+void SpeciesTracker::Clear() {
+  ids_.clear();
+  sorted_ids_.clear();
+  rows_.clear();
+  sorted_names_ = -1;
+  names_.clear();
+  entries_.clear();
+  transcript_total_ = -1;
+  watched_changed_ = false;
+  changed_ids_.clear();
+  engine_ = nullptr;
+  buckets_.clear();
+  bucket_names_.clear();
 }
 
-void SpeciesTracker::Clear() {
-  species_.clear();
-  promoter_map_.clear();
-  species_map_.clear();
-  transcripts_.clear();
-  ribo_per_transcript_.clear();
-  propensity_signal_.DisconnectAll();
+void SpeciesTracker::Unwatch() {
+  for (auto &entry : entries_) {
+    entry.watched = false;
+  }
+  watched_changed_ = false;
+}
+
+void SpeciesTracker::Truncate(int size) {
+  int old_size = names_.size();
+  for (int id = size; id < old_size; id++) {
+    ids_.erase(names_[id]);
+  }
+  if (size < old_size) {
+    changed_ids_.erase(std::remove_if(changed_ids_.begin(), changed_ids_.end(),
+                                      [size](int id) { return id >= size; }),
+                       changed_ids_.end());
+    names_.resize(size);
+    entries_.resize(size);
+    for (auto &entry : entries_) {
+      if (entry.total >= size) {
+        entry.total = -1;
+      }
+    }
+    if (transcript_total_ >= size) {
+      transcript_total_ = -1;
+    }
+    sorted_names_ = -1;
+  }
 }
 
 void SpeciesTracker::Register(SpeciesReaction::Ptr reaction) {
@@ -31,159 +63,609 @@ void SpeciesTracker::Register(SpeciesReaction::Ptr reaction) {
   }
 }
 
+int SpeciesTracker::SpeciesId(const std::string &species_name) {
+  auto it = ids_.find(species_name);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+  int species_id = names_.size();
+  ids_[species_name] = species_id;
+  names_.push_back(species_name);
+  entries_.emplace_back();
+  return species_id;
+}
+
 void SpeciesTracker::Increment(const std::string &species_name,
                                int copy_number) {
-  if (species_.count(species_name) == 0) {
-    species_[species_name] = copy_number;
-  } else {
-    species_[species_name] += copy_number;
-  }
-  if (species_map_.count(species_name) > 0) {
-    for (const auto &reaction : species_map_[species_name]) {
-      propensity_signal_.Emit(reaction);
-    }
-  }
-  if (species_[species_name] < 0) {
+  Guard guard(guard_);
+  int species_id = SpeciesId(species_name);
+  // Counts given by name may come from the user, so are always checked
+  if (entries_[species_id].count + copy_number < 0) {
     throw std::runtime_error("Species count less than 0." + species_name);
   }
+  Increment(species_id, copy_number);
+}
+
+void SpeciesTracker::Increment(int species_id, int copy_number) {
+  Guard guard(guard_);
+  Entry &entry = entries_[species_id];
+  Use(entry.is_species);
+  entry.count += copy_number;
+  Touch(species_id, entry);
+  for (const auto &reaction : entry.reactions) {
+    UpdatePropensity(reaction);
+  }
+  PINETREE_CHECK(entry.count >= 0,
+                 "Species count less than 0." + names_[species_id]);
 }
 
 void SpeciesTracker::IncrementRibo(const std::string &transcript_name,
                                    int copy_number) {
-  if (ribo_per_transcript_.count(transcript_name) == 0) {
-    ribo_per_transcript_[transcript_name] = copy_number;
-  } else {
-    ribo_per_transcript_[transcript_name] += copy_number;
-  }
-  if (ribo_per_transcript_[transcript_name] < 0) {
+  Guard guard(guard_);
+  int species_id = SpeciesId(transcript_name);
+  Entry &entry = entries_[species_id];
+  Use(entry.has_ribo);
+  entry.ribo += copy_number;
+  Touch(species_id, entry);
+  if (entry.ribo < 0) {
     throw std::runtime_error("Ribosome count less than 0." + transcript_name);
   }
 }
 
 void SpeciesTracker::IncrementTranscript(const std::string &transcript_name,
                                          int copy_number) {
-  if (transcripts_.count(transcript_name) == 0) {
-    transcripts_[transcript_name] = copy_number;
-  } else {
-    transcripts_[transcript_name] += copy_number;
+  Guard guard(guard_);
+  IncrementTranscript(SpeciesId(transcript_name), copy_number);
+}
+
+void SpeciesTracker::IncrementTranscript(int species_id, int copy_number) {
+  Guard guard(guard_);
+  Entry &entry = entries_[species_id];
+  Use(entry.has_transcripts);
+  entry.transcripts += copy_number;
+  Touch(species_id, entry);
+  if (entry.transcripts < 0) {
+    throw std::runtime_error("Transcript count less than 0." +
+                             names_[species_id]);
   }
-  if (transcripts_[transcript_name] < 0) {
-    throw std::runtime_error("Transcript count less than 0." + transcript_name);
+}
+
+void SpeciesTracker::ExposeTranscript(const std::string &gene_name) {
+  Guard guard(guard_);
+  int species_id = SpeciesId(gene_name);
+  IncrementTranscript(species_id, 1);
+  if (record_totals_) {
+    IncrementTranscript(TotalId(species_id), 1);
+  }
+}
+
+int SpeciesTracker::TotalId(int species_id) {
+  if (entries_[species_id].total == -1) {
+    // Adding the name may move entries_
+    int total = SpeciesId(names_[species_id] + "_total");
+    entries_[species_id].total = total;
   }
+  return entries_[species_id].total;
 }
 
 void SpeciesTracker::Add(const std::string &species_name,
                          Reaction::Ptr reaction) {
-  Increment(species_name, 0);
-  if (species_map_.count(species_name) == 0) {
-    species_map_[species_name] = Reaction::VecPtr{reaction};
-  } else {
-    // TODO: Maybe use a better data type here like a set?
-    auto it = std::find(species_map_[species_name].begin(),
-                        species_map_[species_name].end(), reaction);
-    if (it == species_map_[species_name].end()) {
-      species_map_[species_name].push_back(reaction);
-    }
+  Guard guard(guard_);
+  int species_id = SpeciesId(species_name);
+  Increment(species_id, 0);
+  // TODO: Maybe use a better data type here like a set?
+  auto &reactions = entries_[species_id].reactions;
+  auto it = std::find(reactions.begin(), reactions.end(), reaction);
+  if (it == reactions.end()) {
+    reactions.push_back(reaction);
   }
 }
 
 void SpeciesTracker::Add(const std::string &promoter_name,
                          Polymer::Ptr polymer) {
-  if (promoter_map_.count(promoter_name) == 0) {
-    promoter_map_[promoter_name] = Polymer::VecPtr{polymer};
-  } else {
-    promoter_map_[promoter_name].push_back(polymer);
+  Guard guard(guard_);
+  Entry &entry = entries_[SpeciesId(promoter_name)];
+  entry.has_polymers = true;
+  if (entry.slots.count(polymer.get()) == 0) {
+    entry.slots[polymer.get()] = entry.polymers.size();
+    entry.polymers.push_back(polymer);
+    entry.uncovered.PushBack(0.0);
   }
 }
 
 void SpeciesTracker::Remove(const std::string &promoter_name,
-                            Polymer::Ptr polymer) {
-  if (promoter_map_.count(promoter_name) != 0) {
-    auto it = std::find(promoter_map_[promoter_name].begin(),
-                        promoter_map_[promoter_name].end(), polymer);
-    if (it != promoter_map_[promoter_name].end()) {
-      promoter_map_[promoter_name].erase(it);
+                            const Polymer &polymer) {
+  Guard guard(guard_);
+  Entry *entry = PolymerEntry(promoter_name);
+  if (entry == nullptr) {
+    return;
+  }
+  int index = PolymerSlot(*entry, &polymer);
+  if (index == -1) {
+    return;
+  }
+  // Move the last polymer into the vacated slot so nothing needs to be
+  // shifted
+  int last = entry->polymers.size() - 1;
+  entry->slots.erase(&polymer);
+  if (index != last) {
+    entry->polymers[index] = std::move(entry->polymers[last]);
+    entry->slots[entry->polymers[index].get()] = index;
+    entry->uncovered.Update(index, entry->uncovered.value(last));
+  }
+  entry->polymers.pop_back();
+  entry->uncovered.PopBack();
+}
+
+void SpeciesTracker::IncrementUncovered(const std::string &promoter_name,
+                                        const Polymer &polymer,
+                                        int copy_number, int uncovered) {
+  Guard guard(guard_);
+  auto id = ids_.find(promoter_name);
+  if (id == ids_.end()) {
+    if (copy_number != 0) {
+      Increment(promoter_name, copy_number);
     }
+    return;
+  }
+  if (copy_number != 0) {
+    Increment(id->second, copy_number);
+  }
+  Entry &entry = entries_[id->second];
+  int slot = PolymerSlot(entry, &polymer);
+  if (slot != -1) {
+    entry.uncovered.Update(slot, uncovered);
   }
 }
 
+const Polymer::Ptr &SpeciesTracker::ChoosePolymer(int promoter_id,
+                                                  Random &rng) {
+  // Throws if the promoter is not on any polymer
+  FindPolymers(promoter_id);
+  const Entry &entry = entries_[promoter_id];
+  int index = entry.uncovered.Find(rng.random() * entry.uncovered.total());
+  return entry.polymers[index];
+}
+
+int SpeciesTracker::PolymerSlot(const Entry &entry, const Polymer *polymer) {
+  // Most promoters are on a single genome
+  if (entry.polymers.size() == 1) {
+    return entry.polymers[0].get() == polymer ? 0 : -1;
+  }
+  auto slot = entry.slots.find(polymer);
+  return slot == entry.slots.end() ? -1 : slot->second;
+}
+
+SpeciesTracker::Entry *SpeciesTracker::PolymerEntry(
+    const std::string &promoter_name) {
+  auto id = ids_.find(promoter_name);
+  if (id == ids_.end() || !entries_[id->second].has_polymers) {
+    return nullptr;
+  }
+  return &entries_[id->second];
+}
+
 void SpeciesTracker::TerminateTranscription(
     std::shared_ptr<PolymerWrapper> wrapper, const std::string &pol_name,
     const std::string &gene_name) {
+  Guard guard(guard_);
   Increment(pol_name, 1);
-  propensity_signal_.Emit(wrapper);
-  // CountTermination("transcript");
+  if (record_totals_) {
+    if (transcript_total_ == -1) {
+      transcript_total_ = SpeciesId("transcript_total");
+    }
+    Increment(transcript_total_, 1);
+  }
+  UpdatePropensity(wrapper);
 }
 
 void SpeciesTracker::TerminateTranslation(
     std::shared_ptr<PolymerWrapper> wrapper, const std::string &pol_name,
     const std::string &gene_name) {
+  Guard guard(guard_);
   Increment(pol_name, 1);
-  Increment(gene_name, 1);
+  int gene_id = SpeciesId(gene_name);
+  Increment(gene_id, 1);
+  if (record_totals_) {
+    Increment(TotalId(gene_id), 1);
+  }
   IncrementRibo(gene_name, -1);
-  propensity_signal_.Emit(wrapper);
-  // CountTermination(gene_name);
+  UpdatePropensity(wrapper);
 }
 
 const Reaction::VecPtr &SpeciesTracker::FindReactions(
     const std::string &species_name) {
-  if (species_map_.count(species_name) == 0) {
+  auto it = ids_.find(species_name);
+  if (it == ids_.end() || entries_[it->second].reactions.empty()) {
     throw std::runtime_error("Species not found in tracker.");
   }
-  return species_map_[species_name];
+  return entries_[it->second].reactions;
 }
 
 const Polymer::VecPtr &SpeciesTracker::FindPolymers(
     const std::string &promoter_name) {
-  if (promoter_map_.count(promoter_name) == 0) {
+  auto it = ids_.find(promoter_name);
+  if (it == ids_.end()) {
+    throw std::runtime_error("Species not found in tracker.");
+  }
+  return FindPolymers(it->second);
+}
+
+const Polymer::VecPtr &SpeciesTracker::FindPolymers(int promoter_id) {
+  if (promoter_id < 0 || promoter_id >= static_cast<int>(entries_.size()) ||
+      !entries_[promoter_id].has_polymers) {
     throw std::runtime_error("Species not found in tracker.");
   }
-  return promoter_map_[promoter_name];
+  return entries_[promoter_id].polymers;
 }
 
 int SpeciesTracker::species(const std::string &reactant) {
-  if (species_.count(reactant) == 0) {
+  auto it = ids_.find(reactant);
+  if (it == ids_.end()) {
+    throw std::runtime_error("Species not found in tracker.");
+  }
+  return species(it->second);
+}
+
+int SpeciesTracker::species(int species_id) const {
+  if (species_id < 0 || species_id >= static_cast<int>(entries_.size()) ||
+      !entries_[species_id].is_species) {
     throw std::runtime_error("Species not found in tracker.");
   }
-  return species_[reactant];
+  return entries_[species_id].count;
 }
 
 int SpeciesTracker::transcripts(const std::string &transcript_name) {
-  return transcripts_[transcript_name];
+  Entry &entry = entries_[SpeciesId(transcript_name)];
+  Use(entry.has_transcripts);
+  return entry.transcripts;
 }
 
 int SpeciesTracker::ribo_per_transcript(const std::string &transcript_name) {
-  return ribo_per_transcript_[transcript_name];
+  Entry &entry = entries_[SpeciesId(transcript_name)];
+  Use(entry.has_ribo);
+  return entry.ribo;
 }
 
-const std::string SpeciesTracker::GatherCounts(double time_stamp) {
-  std::map<std::string, std::vector<double>> output;
-  for (auto elem : species_) {
-    output[elem.first].push_back(elem.second);
-    output[elem.first].push_back(0);
-    output[elem.first].push_back(0);
-  }
-  for (auto transcript : transcripts_) {
-    if (output[transcript.first].size() == 3) {
-      output[transcript.first][1] = transcript.second;
+std::map<std::string, int> SpeciesTracker::species() const {
+  std::map<std::string, int> counts;
+  for (const auto &id : ids_) {
+    if (entries_[id.second].is_species) {
+      counts[id.first] = entries_[id.second].count;
+    }
+  }
+  return counts;
+}
+
+std::map<std::string, int> SpeciesTracker::transcripts() const {
+  std::map<std::string, int> counts;
+  for (const auto &id : ids_) {
+    if (entries_[id.second].has_transcripts) {
+      counts[id.first] = entries_[id.second].transcripts;
+    }
+  }
+  return counts;
+}
+
+std::map<std::string, int> SpeciesTracker::ribo_per_transcript() const {
+  std::map<std::string, int> counts;
+  for (const auto &id : ids_) {
+    if (entries_[id.second].has_ribo) {
+      counts[id.first] = entries_[id.second].ribo;
+    }
+  }
+  return counts;
+}
+
+/**
+ * Match a name against a shell-style pattern with '*' and '?' wildcards.
+ */
+static bool MatchPattern(const std::string &pattern, const std::string &name) {
+  std::size_t p = 0;
+  std::size_t n = 0;
+  // Position after the last '*' seen, and the name position it matched up to
+  std::size_t star = std::string::npos;
+  std::size_t resume = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      p++;
+      n++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = ++p;
+      resume = n;
+    } else if (star != std::string::npos) {
+      p = star;
+      n = ++resume;
     } else {
-      output[transcript.first].push_back(0);
-      output[transcript.first].push_back(transcript.second);
-      output[transcript.first].push_back(0);
+      return false;
     }
-    if (ribo_per_transcript_.find(transcript.first) !=
-        ribo_per_transcript_.end()) {
-      output[transcript.first][2] =
-          double(ribo_per_transcript_[transcript.first]) /
-          double(output[transcript.first][1]);
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+void SpeciesTracker::output_species(const std::vector<std::string> &patterns) {
+  output_patterns_ = patterns;
+  sorted_names_ = -1;
+}
+
+void SpeciesTracker::SortOutputIds() {
+  // Output patterns are matched when the list is rebuilt after names are
+  // added, not at every output time.
+  if (sorted_names_ == static_cast<int>(names_.size())) {
+    return;
+  }
+  sorted_ids_.clear();
+  for (const auto &id : ids_) {
+    bool selected = output_patterns_.empty();
+    for (const auto &pattern : output_patterns_) {
+      if (MatchPattern(pattern, id.first)) {
+        selected = true;
+        break;
+      }
+    }
+    entries_[id.second].selected = selected;
+    if (selected) {
+      sorted_ids_.push_back(id.second);
+    }
+  }
+  rows_.clear();
+  for (auto &entry : entries_) {
+    entry.row = -1;
+  }
+  for (int species_id : sorted_ids_) {
+    Entry &entry = entries_[species_id];
+    if (entry.is_species || entry.has_transcripts) {
+      entry.row = rows_.size();
+      rows_.push_back(Row(species_id, entry));
+    }
+  }
+  sorted_names_ = names_.size();
+}
+
+SpeciesTracker::Counts SpeciesTracker::Row(int species_id,
+                                           const Entry &entry) {
+  double count = entry.is_species ? entry.count : 0;
+  double transcripts = entry.has_transcripts ? entry.transcripts : 0;
+  double ribo_density = 0;
+  if (entry.has_transcripts && entry.has_ribo) {
+    ribo_density = double(entry.ribo) / transcripts;
+  }
+  return Counts{species_id, count, transcripts, ribo_density};
+}
+
+void SpeciesTracker::GatherCounts(std::vector<Counts> &rows) {
+  // Rows are reported in order of name
+  SortOutputIds();
+  rows.assign(rows_.begin(), rows_.end());
+}
+
+void SpeciesTracker::track_changes(bool enabled) {
+  for (int species_id : changed_ids_) {
+    entries_[species_id].changed = false;
+  }
+  changed_ids_.clear();
+  track_changes_ = enabled;
+}
+
+void SpeciesTracker::GatherChangedCounts(std::vector<Counts> &rows) {
+  SortOutputIds();
+  rows.clear();
+  for (int species_id : changed_ids_) {
+    Entry &entry = entries_[species_id];
+    entry.changed = false;
+    if (entry.row >= 0) {
+      rows.push_back(rows_[entry.row]);
     }
   }
+  changed_ids_.clear();
+}
+
+void SpeciesTracker::time_buckets(const double *clock) {
+  bucket_clock_ = clock;
+  buckets_.clear();
+  if (clock == nullptr) {
+    return;
+  }
+  bucket_start_ = *clock;
+  for (int id = 0; id < static_cast<int>(entries_.size()); id++) {
+    Counts row = Row(id, entries_[id]);
+    Bucket &bucket = BucketOf(id);
+    bucket.last = {{row.protein, row.transcript, row.ribo_density}};
+    bucket.min = bucket.last;
+    bucket.max = bucket.last;
+  }
+}
+
+SpeciesTracker::Bucket &SpeciesTracker::BucketOf(int species_id) {
+  if (species_id >= static_cast<int>(buckets_.size())) {
+    Bucket empty;
+    empty.since = bucket_start_;
+    buckets_.resize(species_id + 1, empty);
+  }
+  return buckets_[species_id];
+}
+
+void SpeciesTracker::Accumulate(int species_id, const Entry &entry) {
+  Bucket &bucket = BucketOf(species_id);
+  double now = *bucket_clock_;
+  Counts row = Row(species_id, entry);
+  std::array<double, 3> values = {
+      {row.protein, row.transcript, row.ribo_density}};
+  for (int i = 0; i < 3; i++) {
+    bucket.integral[i] += bucket.last[i] * (now - bucket.since);
+    bucket.min[i] = std::min(bucket.min[i], values[i]);
+    bucket.max[i] = std::max(bucket.max[i], values[i]);
+  }
+  bucket.last = values;
+  bucket.since = now;
+}
+
+void SpeciesTracker::GatherBuckets(double time, std::vector<Counts> &rows) {
+  SortOutputIds();
+  while (bucket_names_.size() < 3 * names_.size()) {
+    const std::string &name = names_[bucket_names_.size() / 3];
+    bucket_names_.push_back(name);
+    bucket_names_.push_back(name + "_min");
+    bucket_names_.push_back(name + "_max");
+  }
+  double length = time - bucket_start_;
+  rows.clear();
+  for (const auto &row : rows_) {
+    int id = row.species_id;
+    const Bucket &bucket = BucketOf(id);
+    std::array<double, 3> mean = bucket.last, min = bucket.last,
+                          max = bucket.last;
+    if (length > 0) {
+      for (int i = 0; i < 3; i++) {
+        mean[i] =
+            (bucket.integral[i] + bucket.last[i] * (time - bucket.since)) /
+            length;
+      }
+      min = bucket.min;
+      max = bucket.max;
+    }
+    rows.push_back(Counts{3 * id, mean[0], mean[1], mean[2]});
+    rows.push_back(Counts{3 * id + 1, min[0], min[1], min[2]});
+    rows.push_back(Counts{3 * id + 2, max[0], max[1], max[2]});
+  }
+  // Every name, reported or not, starts the next interval at its last value
+  for (auto &bucket : buckets_) {
+    bucket.since = time;
+    bucket.integral = {{0, 0, 0}};
+    bucket.min = bucket.last;
+    bucket.max = bucket.last;
+  }
+  bucket_start_ = time;
+}
+
+const std::string SpeciesTracker::GatherCounts(double time_stamp) {
+  std::vector<Counts> rows;
+  GatherCounts(rows);
   std::string out_string;
-  for (auto row : output) {
-    out_string = out_string + (std::to_string(time_stamp) + "\t" + row.first +
-                               "\t" + std::to_string(row.second[0]) + "\t" +
-                               std::to_string(row.second[1]) + "\t" +
-                               std::to_string(row.second[2]) + "\n");
+  for (const auto &row : rows) {
+    out_string = out_string + (std::to_string(time_stamp) + "\t" +
+                               names_[row.species_id] + "\t" +
+                               std::to_string(row.protein) + "\t" +
+                               std::to_string(row.transcript) + "\t" +
+                               std::to_string(row.ribo_density) + "\n");
   }
   return out_string;
-}
\ No newline at end of file
+}
+
+void SpeciesTracker::SaveNames(CheckpointWriter &writer) const {
+  writer.Write(names_);
+}
+
+void SpeciesTracker::LoadNames(CheckpointReader &reader) {
+  std::vector<std::string> names;
+  reader.Read(names);
+  // Species defined by the model must already have the same IDs
+  CheckpointReader::Expect(names.size() >= names_.size(), "species list");
+  for (int i = 0; i < static_cast<int>(names.size()); i++) {
+    CheckpointReader::Expect(SpeciesId(names[i]) == i,
+                             "species '" + names[i] + "'");
+  }
+}
+
+void SpeciesTracker::Save(
+    CheckpointWriter &writer,
+    const std::function<int(const Polymer::Ptr &)> &polymer_id) const {
+  writer.Write<uint32_t>(entries_.size());
+  for (const auto &entry : entries_) {
+    writer.Write<int32_t>(entry.count);
+    writer.Write<int32_t>(entry.transcripts);
+    writer.Write<int32_t>(entry.ribo);
+    writer.Write(entry.is_species);
+    writer.Write(entry.has_transcripts);
+    writer.Write(entry.has_ribo);
+    writer.Write(entry.has_polymers);
+    writer.Write<uint32_t>(entry.polymers.size());
+    for (const auto &polymer : entry.polymers) {
+      writer.Write<int32_t>(polymer_id(polymer));
+    }
+  }
+  writer.Write(bucket_start_);
+  writer.Write<uint32_t>(buckets_.size());
+  for (const auto &bucket : buckets_) {
+    writer.Write(bucket.since);
+    for (const auto *values :
+         {&bucket.last, &bucket.integral, &bucket.min, &bucket.max}) {
+      for (double value : *values) {
+        writer.Write(value);
+      }
+    }
+  }
+}
+
+void SpeciesTracker::Load(CheckpointReader &reader,
+                          const std::function<Polymer::Ptr(int)> &polymer) {
+  CheckpointReader::Expect(reader.Read<uint32_t>() == entries_.size(),
+                           "species list");
+  for (auto &entry : entries_) {
+    entry.count = reader.Read<int32_t>();
+    entry.transcripts = reader.Read<int32_t>();
+    entry.ribo = reader.Read<int32_t>();
+    reader.Read(entry.is_species);
+    reader.Read(entry.has_transcripts);
+    reader.Read(entry.has_ribo);
+    reader.Read(entry.has_polymers);
+    entry.polymers.resize(reader.Read<uint32_t>());
+    entry.uncovered.Clear();
+    entry.slots.clear();
+    for (auto &item : entry.polymers) {
+      item = polymer(reader.Read<int32_t>());
+      entry.slots[item.get()] = entry.uncovered.size();
+      entry.uncovered.PushBack(0.0);
+    }
+  }
+  // Polymers are restored first, so their uncovered counts are up to date
+  for (int id = 0; id < static_cast<int>(entries_.size()); id++) {
+    Entry &entry = entries_[id];
+    Touch(id, entry);
+    for (int i = 0; i < static_cast<int>(entry.polymers.size()); i++) {
+      entry.uncovered.Update(i, entry.polymers[i]->uncovered(names_[id]));
+    }
+  }
+  // Read after touching every entry, which would have changed the buckets
+  reader.Read(bucket_start_);
+  buckets_.resize(reader.Read<uint32_t>());
+  for (auto &bucket : buckets_) {
+    reader.Read(bucket.since);
+    for (auto *values :
+         {&bucket.last, &bucket.integral, &bucket.min, &bucket.max}) {
+      for (double &value : *values) {
+        reader.Read(value);
+      }
+    }
+  }
+  sorted_names_ = -1;
+}
+
+void SpeciesTracker::Memory(MemoryReport &report) const {
+  std::size_t bytes = MemoryReport::Bytes(ids_) + MemoryReport::Bytes(names_) +
+                      MemoryReport::Bytes(entries_) +
+                      MemoryReport::Bytes(changed_ids_) +
+                      MemoryReport::Bytes(sorted_ids_) +
+                      MemoryReport::Bytes(rows_) +
+                      MemoryReport::Bytes(output_patterns_) +
+                      MemoryReport::Bytes(buckets_) +
+                      MemoryReport::Bytes(bucket_names_);
+  for (const auto &id : ids_) {
+    bytes += MemoryReport::Bytes(id.first);
+  }
+  for (const auto &name : names_) {
+    bytes += MemoryReport::Bytes(name);
+  }
+  for (const auto &name : bucket_names_) {
+    bytes += MemoryReport::Bytes(name);
+  }
+  for (const auto &entry : entries_) {
+    bytes += MemoryReport::Bytes(entry.reactions) +
+             MemoryReport::Bytes(entry.polymers) + entry.uncovered.memory() +
+             MemoryReport::Bytes(entry.slots);
+  }
+  report.Add("tracker", entries_.size(), bytes);
+}
@@ -3,8 +3,11 @@
 #ifndef SRC_TRACKER_HPP  // header guard
 #define SRC_TRACKER_HPP
 
+#include <array>
 #include <memory>
+#include <unordered_map>
 
+#include "guard.hpp"
 #include "model.hpp"
 
 /**
@@ -13,21 +16,37 @@
  * and which reactions involve a given species. These maps are needed to cache
  * propensities and increase the performance of the simulation.
  *
- * Follows a singleton pattern:
- * http://stackoverflow.com/a/1008289/5360633
+ * Species names (including promoters, binding sites, polymerases, and genes)
+ * are interned to dense integer IDs when a model is built, and all counts and
+ * maps are stored in vectors indexed by ID. Reactions look up their species by
+ * ID during the simulation; names are only used for output and the Python API.
+ *
+ * Each Model owns its own tracker and shares it with the reactions and polymers
+ * it registers, so several models can be simulated in one process.
  *
  * TODO: Move propensity cache from Model into this class?
  */
 class SpeciesTracker {
  public:
   /**
-   * Retrieve the only instance of this object.
+   * Construct an empty tracker.
    */
-  static SpeciesTracker &Instance();
+  SpeciesTracker() {}
+  /**
+   * Convenience typedefs.
+   */
+  typedef std::shared_ptr<SpeciesTracker> Ptr;
   /**
    * Clear all data in the tracker.
    */
   void Clear();
+  /**
+   * Forget every species with an ID of at least size, e.g. those first seen
+   * after a state that is about to be restored.
+   *
+   * @param size number of species to keep
+   */
+  void Truncate(int size);
   /**
    * Delete copy constructor and assignment operator.
    */
@@ -37,13 +56,31 @@ class SpeciesTracker {
    * Register a SpeciesReaction with the species tracker.
    */
   void Register(SpeciesReaction::Ptr reaction);
+  /**
+   * Get the ID of a species, assigning the next free ID if this name has not
+   * been seen before. IDs stay valid until Clear() is called.
+   *
+   * @param species_name name of species
+   *
+   * @return integer ID of species
+   */
+  int SpeciesId(const std::string &species_name);
   /**
    * Change a species count by a given value (positive or negative).
    *
    * @param species_name name of species to change count
    * @param copy_number number to add to current copy number count
+   * @throws std::runtime_error if the count would become negative
    */
   void Increment(const std::string &species_name, int copy_number);
+  /**
+   * Change a species count by ID. Only checked builds (see checks.hpp)
+   * check that the count stays non-negative.
+   *
+   * @param species_id ID of species to change count
+   * @param copy_number number to add to current copy number count
+   */
+  void Increment(int species_id, int copy_number);
   /**
    * Update ribosome count for a given transcript.
    *
@@ -58,6 +95,36 @@ class SpeciesTracker {
    * @param copy_number number to add to current copy number count
    */
   void IncrementTranscript(const std::string &transcript_name, int copy_number);
+  void IncrementTranscript(int species_id, int copy_number);
+  /**
+   * Update counts after the ribosome binding site of a gene is exposed on a
+   * transcript for the first time, i.e. a new transcript of the gene is
+   * made.
+   *
+   * @param gene_name name of gene
+   */
+  void ExposeTranscript(const std::string &gene_name);
+  /**
+   * Also count how much of each gene is made over the whole simulation:
+   * the proteins and transcripts of a gene made so far are reported as the
+   * protein and transcript counts of "<gene>_total", and the transcripts
+   * completed by polymerases as the protein count of "transcript_total".
+   * Totals are ordinary names of the tracker, so they are written in every
+   * output format, and are only looked up by name the first time.
+   */
+  void record_totals(bool enabled) { record_totals_ = enabled; }
+  /**
+   * Integrate every count over simulated time as it changes, so that output
+   * can report each count's average over the interval between output time
+   * points, weighted by the time it held each value, together with its
+   * minimum and maximum over the interval (see GatherBuckets). The first
+   * interval starts now.
+   *
+   * @param clock simulation clock, which must outlive recording, or nullptr
+   *  to stop
+   */
+  void time_buckets(const double *clock);
+  bool time_buckets() const { return bucket_clock_ != nullptr; }
   /**
    * Add a species-reaction pair to species-reaction map.
    *
@@ -73,12 +140,37 @@ class SpeciesTracker {
    */
   void Add(const std::string &promoter_name, Polymer::Ptr polymer);
   /**
-   * Remove a promoter-polymer pair from promoter-polymer map.
+   * Remove a promoter-polymer pair from promoter-polymer map. The last polymer
+   * carrying the promoter takes its place, so this takes constant time, and
+   * removing a polymer that is not in the map does nothing.
    *
    * @param promter_name of promoter
-   * @param polymer polymer object that contains the named promoter (pointer)
+   * @param polymer polymer object that contains the named promoter
    */
-  void Remove(const std::string &promoter_name, Polymer::Ptr polymer);
+  void Remove(const std::string &promoter_name, const Polymer &polymer);
+  /**
+   * Change the count of a promoter as copies of it are uncovered or covered
+   * on a polymer, and record how many copies are now uncovered there, which
+   * weights the polymer in ChoosePolymer.
+   *
+   * @param promoter_name name of promoter
+   * @param polymer polymer that contains the named promoter
+   * @param copy_number number to add to the promoter's count
+   * @param uncovered number of uncovered copies on polymer
+   */
+  void IncrementUncovered(const std::string &promoter_name,
+                          const Polymer &polymer, int copy_number,
+                          int uncovered);
+  /**
+   * Randomly choose a polymer to bind at a promoter, weighted by the number
+   * of uncovered copies of the promoter on each polymer, in time logarithmic
+   * in the number of polymers.
+   *
+   * @param promoter_id ID of promoter
+   * @param rng random number generator
+   * @return chosen polymer
+   */
+  const Polymer::Ptr &ChoosePolymer(int promoter_id, Random &rng);
   /**
    * Update propensities and species counts after transcription has
    * terminated.
@@ -109,6 +201,7 @@ class SpeciesTracker {
    * @return vector of pointers to Polymer objects that contain promoter_name
    */
   const Polymer::VecPtr &FindPolymers(const std::string &promoter_name);
+  const Polymer::VecPtr &FindPolymers(int promoter_id);
   /**
    * Get reactions that involve a given species.
    *
@@ -117,48 +210,397 @@ class SpeciesTracker {
    * @return vector of pointers to Reaction objects that involve species_name
    */
   const Reaction::VecPtr &FindReactions(const std::string &species_name);
+  /**
+   * Counts reported for one species (or gene) at an output time point.
+   */
+  struct Counts {
+    int species_id;
+    double protein;
+    double transcript;
+    double ribo_density;
+  };
+  /**
+   * Restrict output to species whose names match one of the given patterns.
+   * A pattern is a species name, or a shell-style wildcard pattern in which
+   * '*' matches any sequence of characters and '?' any single character.
+   * Patterns are matched once per species name, not at every output time.
+   *
+   * @param patterns names or patterns to report, or empty to report all
+   *  species
+   */
+  void output_species(const std::vector<std::string> &patterns);
+  /**
+   * Collect the counts of every reported species in order of name, without
+   * allocating once rows has grown to size. Counts are kept in reporting
+   * order as they change, so this is a copy of one block of rows.
+   *
+   * @param rows vector to fill (cleared first)
+   */
+  void GatherCounts(std::vector<Counts> &rows);
+  /**
+   * Format the counts of every reported species as rows of a TSV file.
+   *
+   * @param time_stamp time to report in first column
+   */
   const std::string GatherCounts(double time_stamp);
+  /**
+   * Start or stop recording which names have counts that change. Either way
+   * the record kept so far is discarded.
+   */
+  void track_changes(bool enabled);
+  /**
+   * Collect the counts of the reported species whose species, transcript
+   * or ribosome counts changed since the last call (or since change
+   * tracking started), in no particular order, and start a new record. The
+   * cost is proportional to the number of names that changed, not to the
+   * number reported.
+   *
+   * @param rows vector to fill (cleared first)
+   */
+  void GatherChangedCounts(std::vector<Counts> &rows);
+  /**
+   * Collect the time average, minimum and maximum of the counts of every
+   * reported species over the interval since the last call (or since
+   * time_buckets was turned on), in order of name, and start a new interval
+   * at a given time. An interval of length 0 reports the current counts.
+   * Rows refer to names in bucket_names(): the average of the species with
+   * ID i is row ID 3i, its minimum "<name>_min" 3i + 1 and its maximum
+   * "<name>_max" 3i + 2, so that IDs stay the same as names are added.
+   *
+   * @param time end of the interval, normally the current time
+   * @param rows vector to fill (cleared first)
+   */
+  void GatherBuckets(double time, std::vector<Counts> &rows);
+  /**
+   * Names of the rows collected by GatherBuckets.
+   */
+  const std::vector<std::string> &bucket_names() const {
+    return bucket_names_;
+  }
   /**
    * Getters and setters
    */
   int species(const std::string &reactant);
+  int species(int species_id) const;
+  const std::string &species_name(int species_id) const {
+    return names_[species_id];
+  }
+  const std::vector<std::string> &names() const { return names_; }
+  /**
+   * Live copy numbers of every name in order of ID, for readers that poll
+   * counts without copying them. The count of ID i is the int at
+   * counts() + i * counts_stride() bytes; names that are not species count
+   * 0. The array moves whenever a name is added.
+   */
+  const int *counts() const {
+    return entries_.empty() ? nullptr : &entries_.front().count;
+  }
+  static constexpr std::size_t counts_stride() { return sizeof(Entry); }
   int transcripts(const std::string &transcript_name);
   int ribo_per_transcript(const std::string &transcript_name);
-  const std::map<std::string, int> &species() { return species_; }
-  const std::map<std::string, int> &transcripts() { return transcripts_; }
-  const std::map<std::string, int> &ribo_per_transcript() {
-    return ribo_per_transcript_;
+  /**
+   * Species, transcript and ribosome counts of a name by ID, which are 0
+   * for names that have not been used as such.
+   */
+  int count(int species_id) const { return entries_[species_id].count; }
+  int transcripts(int species_id) const {
+    return entries_[species_id].transcripts;
+  }
+  int ribo_per_transcript(int species_id) const {
+    return entries_[species_id].ribo;
+  }
+  /**
+   * Is a name used as a species but not as a binding site on polymers, so
+   * that its copies are free molecules?
+   */
+  bool free_species(int species_id) const {
+    return entries_[species_id].is_species &&
+           !entries_[species_id].has_polymers;
+  }
+  /**
+   * Watch the species, transcript and ribosome counts of a name, so that
+   * TakeWatchedChange reports when any of them changes.
+   *
+   * @param species_id ID of name to watch
+   */
+  void Watch(int species_id) {
+    entries_[species_id].watched = true;
+    watched_changed_ = true;
+  }
+  /**
+   * Stop watching every name.
+   */
+  void Unwatch();
+  /**
+   * @return true if a watched count has changed (or a name was watched)
+   *  since the last call to TakeWatchedChange, without clearing it
+   */
+  bool watched_changed() const { return watched_changed_; }
+  /**
+   * @return true if a watched count has changed (or a name was watched)
+   *  since the last call
+   */
+  bool TakeWatchedChange() {
+    bool changed = watched_changed_;
+    watched_changed_ = false;
+    return changed;
   }
+  std::map<std::string, int> species() const;
+  std::map<std::string, int> transcripts() const;
+  std::map<std::string, int> ribo_per_transcript() const;
+  void engine(Gillespie *engine) { engine_ = engine; }
   /**
-   * Signal to fire when propensity needs to be updated.
+   * Save or restore species names in order of their IDs. Names are restored
+   * first, so that every species keeps its ID.
+   */
+  void SaveNames(CheckpointWriter &writer) const;
+  void LoadNames(CheckpointReader &reader);
+  /**
+   * Save or restore counts and the polymers carrying each binding site. The
+   * reactions involving each species come from the model definition and are
+   * not saved.
+   *
+   * @param polymer_id ID of a polymer
+   * @param polymer polymer with a given ID
+   */
+  void Save(CheckpointWriter &writer,
+            const std::function<int(const Polymer::Ptr &)> &polymer_id) const;
+  void Load(CheckpointReader &reader,
+            const std::function<Polymer::Ptr(int)> &polymer);
+  /**
+   * Add the names, counts, maps and output rows of this tracker to a
+   * memory report, with one object per species name.
+   */
+  void Memory(MemoryReport &report) const;
+  /**
+   * Tell the simulation engine that the propensity of a reaction may have
+   * changed. Changes in species counts do this automatically for every
+   * reaction involving the species.
+   *
+   * @param reaction reaction whose propensity is out of date
    */
-  Signal<std::shared_ptr<Reaction>> propensity_signal_;
+  void UpdatePropensity(const Reaction::Ptr &reaction) {
+    Guard guard(guard_);
+    if (engine_ != nullptr) {
+      engine_->MarkDirty(reaction);
+    }
+  }
+
+  /**
+   * Lock every change to counts, promoter maps and propensities with a
+   * mutex while the worker threads of a parallel simulation run, or stop
+   * locking (see Guard).
+   */
+  void guard(std::recursive_mutex *mutex) { guard_ = mutex; }
 
  private:
   /**
-   * Private constructor for singleton
+   * Simulation engine that recomputes propensities, or null if this tracker
+   * is not part of a Model.
    */
-  SpeciesTracker() {}
+  Gillespie *engine_ = nullptr;
+  std::recursive_mutex *guard_ = nullptr;
+  /**
+   * Per-ID record of a species (or gene) name.
+   */
+  struct Entry {
+    /**
+     * Copy number of species.
+     */
+    int count = 0;
+    /**
+     * Transcript (gene) count.
+     */
+    int transcripts = 0;
+    /**
+     * Number of ribosomes on transcripts of this gene.
+     */
+    int ribo = 0;
+    /**
+     * Has this name been used as a species, transcript, or ribosome count?
+     * Only names that have are reported in output.
+     */
+    bool is_species = false;
+    bool has_transcripts = false;
+    bool has_ribo = false;
+    /**
+     * Does this name have a promoter-to-polymer map entry?
+     */
+    bool has_polymers = false;
+    /**
+     * Is this name watched (see Watch)?
+     */
+    bool watched = false;
+    /**
+     * Has a count changed since the last GatherChangedCounts (see
+     * changed_ids_)?
+     */
+    bool changed = false;
+    /**
+     * Does this name match the output patterns? Set by SortOutputIds.
+     */
+    bool selected = false;
+    /**
+     * Position of this name's reported counts in rows_, or -1 if it is not
+     * reported. Set by SortOutputIds.
+     */
+    int row = -1;
+    /**
+     * ID of the name's cumulative counts (see record_totals), or -1 if not
+     * looked up yet.
+     */
+    int total = -1;
+    /**
+     * Reactions that involve this species.
+     */
+    Reaction::VecPtr reactions;
+    /**
+     * Polymers that contain this promoter, the number of uncovered copies of
+     * the promoter on each of them, and the index of each polymer.
+     */
+    Polymer::VecPtr polymers;
+    PropensityTree uncovered;
+    std::unordered_map<const Polymer *, int> slots;
+  };
+  /**
+   * Entry of a promoter, or nullptr if it has no promoter-to-polymer map
+   * entry.
+   */
+  Entry *PolymerEntry(const std::string &promoter_name);
+  /**
+   * Index of a polymer in the entry of a promoter, or -1 if it is not there.
+   */
+  static int PolymerSlot(const Entry &entry, const Polymer *polymer);
+  /**
+   * Note a change to the counts of an entry for watchers and change tracking.
+   */
+  void Touch(int species_id, Entry &entry) {
+    if (bucket_clock_ != nullptr) {
+      Accumulate(species_id, entry);
+    }
+    if (entry.watched) {
+      watched_changed_ = true;
+    }
+    if (track_changes_ && !entry.changed) {
+      entry.changed = true;
+      changed_ids_.push_back(species_id);
+    }
+    if (entry.row >= 0) {
+      rows_[entry.row] = Row(species_id, entry);
+    }
+  }
+  /**
+   * Note that a name is now used as a species, transcript, or ribosome
+   * count, which may add it to the output or change its ribosome density.
+   */
+  void Use(bool &flag) {
+    if (!flag) {
+      flag = true;
+      sorted_names_ = -1;
+    }
+  }
+  /**
+   * ID of the cumulative counts of a name (see record_totals), which is
+   * added the first time.
+   */
+  int TotalId(int species_id);
+  /**
+   * Rebuild sorted_ids_ and rows_ if names were added or first used since
+   * they were last built.
+   */
+  void SortOutputIds();
+  /**
+   * Counts of a name as reported in output.
+   */
+  static Counts Row(int species_id, const Entry &entry);
+  /**
+   * Name-to-ID map, used only when building models and for output.
+   */
+  std::map<std::string, int> ids_;
+  /**
+   * Species names indexed by ID.
+   */
+  std::vector<std::string> names_;
+  /**
+   * Species records indexed by ID.
+   */
+  std::vector<Entry> entries_;
+  /**
+   * Has a watched count changed since the last TakeWatchedChange?
+   */
+  bool watched_changed_ = false;
+  /**
+   * Are changed counts recorded (see track_changes)?
+   */
+  bool track_changes_ = false;
+  /**
+   * Are totals counted (see record_totals), and the ID of the count of
+   * completed transcripts, or -1 if not looked up yet?
+   */
+  bool record_totals_ = false;
+  int transcript_total_ = -1;
+  /**
+   * IDs whose counts changed since the last GatherChangedCounts, each once.
+   */
+  std::vector<int> changed_ids_;
+  /**
+   * IDs in order of name of the species selected for output, rebuilt by
+   * GatherCounts whenever names are added.
+   */
+  std::vector<int> sorted_ids_;
+  /**
+   * Counts of every reported name in order of name, kept up to date as
+   * counts change so that GatherCounts only copies them.
+   */
+  std::vector<Counts> rows_;
+  /**
+   * Number of names when sorted_ids_ was last built, or -1 to rebuild it.
+   */
+  int sorted_names_ = -1;
+  /**
+   * Patterns selecting species for output; empty to report all species.
+   */
+  std::vector<std::string> output_patterns_;
+  /**
+   * Integral of the reported counts of one name over the current output
+   * interval (see time_buckets), for protein, transcript and ribosome
+   * density in that order.
+   */
+  struct Bucket {
+    /**
+     * Time of the last change, up to which integral is brought up to date.
+     */
+    double since = 0;
+    std::array<double, 3> last = {{0, 0, 0}};
+    std::array<double, 3> integral = {{0, 0, 0}};
+    std::array<double, 3> min = {{0, 0, 0}};
+    std::array<double, 3> max = {{0, 0, 0}};
+  };
+  /**
+   * Simulation clock while counts are integrated, or nullptr.
+   */
+  const double *bucket_clock_ = nullptr;
   /**
-   * Species counts.
+   * Start of the current output interval.
    */
-  std::map<std::string, int> species_;
+  double bucket_start_ = 0;
   /**
-   * Transcript (gene) counts.
+   * Buckets indexed by ID, grown as names change for the first time.
+   * Names without a bucket have been 0 since the interval started.
    */
-  std::map<std::string, int> transcripts_;
+  std::vector<Bucket> buckets_;
   /**
-   * Number of ribosomes on each transcript (gene).
+   * Names of the rows of GatherBuckets, three per ID.
    */
-  std::map<std::string, int> ribo_per_transcript_;
+  std::vector<std::string> bucket_names_;
   /**
-   * Promoter-to-polymer map.
+   * Bring the bucket of a name up to date with a change to its counts.
    */
-  std::map<std::string, Polymer::VecPtr> promoter_map_;
+  void Accumulate(int species_id, const Entry &entry);
   /**
-   * Species-to-reaction map.
+   * Bucket of a name, added if it has none.
    */
-  std::map<std::string, Reaction::VecPtr> species_map_;
+  Bucket &BucketOf(int species_id);
 };
 
 #endif  // header guard
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#include "yaml.hpp"
+
+void YamlNode::Fail(const std::string &message) const {
+  throw std::runtime_error("line " + std::to_string(line_) + ": " + message);
+}
+
+bool YamlNode::Has(const std::string &key) const {
+  for (const auto &entry : entries_) {
+    if (entry.first == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const YamlNode &YamlNode::operator[](const std::string &key) const {
+  if (type_ != MAPPING) {
+    Fail("expected a mapping with key '" + key + "'.");
+  }
+  for (const auto &entry : entries_) {
+    if (entry.first == key) {
+      return entry.second;
+    }
+  }
+  Fail("missing key '" + key + "'.");
+  return *this;
+}
+
+const YamlNode &YamlNode::operator[](std::size_t index) const {
+  if (type_ != SEQUENCE) {
+    Fail("expected a sequence.");
+  }
+  if (index >= items_.size()) {
+    Fail("sequence index " + std::to_string(index) + " out of range.");
+  }
+  return items_[index];
+}
+
+std::size_t YamlNode::size() const {
+  return type_ == MAPPING ? entries_.size() : items_.size();
+}
+
+const YamlNode::Entries &YamlNode::entries() const {
+  if (type_ != MAPPING) {
+    Fail("expected a mapping.");
+  }
+  return entries_;
+}
+
+const std::vector<YamlNode> &YamlNode::items() const {
+  if (type_ != SEQUENCE) {
+    Fail("expected a sequence.");
+  }
+  return items_;
+}
+
+const std::string &YamlNode::AsString() const {
+  if (type_ != SCALAR) {
+    Fail("expected a value.");
+  }
+  return scalar_;
+}
+
+double YamlNode::AsDouble() const {
+  const std::string &text = AsString();
+  char *end = nullptr;
+  double value = std::strtod(text.c_str(), &end);
+  if (text.empty() || *end != '\0') {
+    Fail("expected a number, got '" + text + "'.");
+  }
+  return value;
+}
+
+int YamlNode::AsInt() const {
+  // Accept integers written in scientific notation, e.g. 1e6
+  double value = AsDouble();
+  if (value != std::floor(value) ||
+      std::fabs(value) > std::numeric_limits<int>::max()) {
+    Fail("expected an integer, got '" + scalar_ + "'.");
+  }
+  return static_cast<int>(value);
+}
+
+bool YamlNode::AsBool() const {
+  const std::string &text = AsString();
+  if (text == "true" || text == "True" || text == "TRUE" || text == "yes") {
+    return true;
+  }
+  if (text == "false" || text == "False" || text == "FALSE" || text == "no") {
+    return false;
+  }
+  Fail("expected true or false, got '" + text + "'.");
+  return false;
+}
+
+std::vector<double> YamlNode::AsDoubles() const {
+  std::vector<double> values;
+  for (const auto &item : items()) {
+    values.push_back(item.AsDouble());
+  }
+  return values;
+}
+
+std::vector<std::string> YamlNode::AsStrings() const {
+  std::vector<std::string> values;
+  for (const auto &item : items()) {
+    values.push_back(item.AsString());
+  }
+  return values;
+}
+
+/**
+ * Recursive descent parser over the non-blank lines of a document, with
+ * comments removed.
+ */
+class YamlParser {
+ public:
+  explicit YamlParser(std::istream &input);
+  YamlNode Parse();
+
+ private:
+  struct Line {
+    int number;
+    int indent;
+    std::string text;
+  };
+  std::vector<Line> lines_;
+  std::size_t pos_ = 0;
+  void Fail(int line, const std::string &message) const {
+    throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+  }
+  YamlNode ParseBlock(int indent);
+  YamlNode ParseSequence(int indent);
+  YamlNode ParseMapping(int indent);
+  /**
+   * Parse the value on the current line (and the continuation lines of a
+   * flow sequence), advancing past it.
+   */
+  YamlNode ParseInline(std::string text);
+  YamlNode ParseScalar(const std::string &text, int line) const;
+  void CheckIndent(int indent) const;
+  static bool IsSequenceEntry(const std::string &text) {
+    return text == "-" || text.compare(0, 2, "- ") == 0;
+  }
+  /**
+   * Split "key: value" at the first colon outside quotes that is followed
+   * by a space or the end of the line.
+   */
+  static bool SplitKey(const std::string &text, std::string *key,
+                       std::string *value);
+  static std::string Trim(const std::string &text);
+};
+
+YamlParser::YamlParser(std::istream &input) {
+  std::string raw;
+  int number = 0;
+  while (std::getline(input, raw)) {
+    number++;
+    // Strip comments, which start with # at the beginning of the line or
+    // after whitespace, outside of quotes
+    char quote = 0;
+    std::size_t end = raw.size();
+    for (std::size_t i = 0; i < raw.size(); i++) {
+      char c = raw[i];
+      if (quote) {
+        if (c == quote) {
+          quote = 0;
+        }
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      } else if (c == '#' && (i == 0 || raw[i - 1] == ' ' ||
+                              raw[i - 1] == '\t')) {
+        end = i;
+        break;
+      }
+    }
+    raw.resize(end);
+    std::size_t indent = raw.find_first_not_of(' ');
+    if (indent == std::string::npos) {
+      continue;
+    }
+    std::string text = Trim(raw);
+    if (text.empty()) {
+      continue;
+    }
+    if (raw[indent] == '\t') {
+      Fail(number, "tabs are not allowed for indentation.");
+    }
+    if (text == "---" || text == "...") {
+      continue;
+    }
+    lines_.push_back({number, static_cast<int>(indent), text});
+  }
+}
+
+YamlNode YamlParser::Parse() {
+  if (lines_.empty()) {
+    return YamlNode();
+  }
+  YamlNode root = ParseBlock(lines_[0].indent);
+  if (pos_ < lines_.size()) {
+    Fail(lines_[pos_].number, "unexpected indentation.");
+  }
+  return root;
+}
+
+YamlNode YamlParser::ParseBlock(int indent) {
+  const std::string &text = lines_[pos_].text;
+  std::string key, value;
+  if (IsSequenceEntry(text)) {
+    return ParseSequence(indent);
+  } else if (text[0] != '[' && SplitKey(text, &key, &value)) {
+    return ParseMapping(indent);
+  }
+  return ParseInline(text);
+}
+
+YamlNode YamlParser::ParseSequence(int indent) {
+  YamlNode node(YamlNode::SEQUENCE, lines_[pos_].number);
+  while (pos_ < lines_.size() && lines_[pos_].indent == indent &&
+         IsSequenceEntry(lines_[pos_].text)) {
+    Line &line = lines_[pos_];
+    std::string rest = Trim(line.text.substr(1));
+    if (rest.empty()) {
+      pos_++;
+      if (pos_ < lines_.size() && lines_[pos_].indent > indent) {
+        node.items_.push_back(ParseBlock(lines_[pos_].indent));
+      } else {
+        node.items_.emplace_back(YamlNode::NONE, line.number);
+      }
+      continue;
+    }
+    // Parse the rest of the line as if it started a block at its column, so
+    // that the keys of "- key: value" mappings line up with the first key
+    line.indent += line.text.size() - rest.size();
+    line.text = rest;
+    node.items_.push_back(ParseBlock(line.indent));
+  }
+  CheckIndent(indent);
+  return node;
+}
+
+YamlNode YamlParser::ParseMapping(int indent) {
+  YamlNode node(YamlNode::MAPPING, lines_[pos_].number);
+  while (pos_ < lines_.size() && lines_[pos_].indent == indent &&
+         !IsSequenceEntry(lines_[pos_].text)) {
+    const Line &line = lines_[pos_];
+    std::string key, value;
+    if (!SplitKey(line.text, &key, &value)) {
+      Fail(line.number, "expected 'key: value', got '" + line.text + "'.");
+    }
+    key = ParseScalar(key, line.number).scalar_;
+    if (node.Has(key)) {
+      Fail(line.number, "duplicate key '" + key + "'.");
+    }
+    if (!value.empty()) {
+      node.entries_.emplace_back(key, ParseInline(value));
+      continue;
+    }
+    int number = line.number;
+    pos_++;
+    if (pos_ < lines_.size() && lines_[pos_].indent > indent) {
+      node.entries_.emplace_back(key, ParseBlock(lines_[pos_].indent));
+    } else if (pos_ < lines_.size() && lines_[pos_].indent == indent &&
+               IsSequenceEntry(lines_[pos_].text)) {
+      // Sequences may be indented at the level of their key
+      node.entries_.emplace_back(key, ParseSequence(indent));
+    } else {
+      node.entries_.emplace_back(key, YamlNode(YamlNode::NONE, number));
+    }
+  }
+  CheckIndent(indent);
+  return node;
+}
+
+YamlNode YamlParser::ParseInline(std::string text) {
+  int number = lines_[pos_].number;
+  pos_++;
+  if (text[0] == '{') {
+    Fail(number, "flow mappings are not supported.");
+  }
+  if (text[0] != '[') {
+    return ParseScalar(text, number);
+  }
+  // Join the continuation lines of a flow sequence
+  while (text.back() != ']') {
+    if (pos_ >= lines_.size()) {
+      Fail(number, "unterminated flow sequence.");
+    }
+    text += " " + lines_[pos_++].text;
+  }
+  YamlNode node(YamlNode::SEQUENCE, number);
+  std::string body = Trim(text.substr(1, text.size() - 2));
+  if (body.empty()) {
+    return node;
+  }
+  char quote = 0;
+  std::size_t start = 0;
+  for (std::size_t i = 0; i <= body.size(); i++) {
+    char c = i < body.size() ? body[i] : ',';
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+    } else if (c == '[' || c == ']' || c == '{' || c == '}') {
+      Fail(number, "nested flow collections are not supported.");
+    } else if (c == ',') {
+      std::string item = Trim(body.substr(start, i - start));
+      // Allow a trailing comma
+      if (!item.empty() || i < body.size()) {
+        if (item.empty()) {
+          Fail(number, "empty item in flow sequence.");
+        }
+        node.items_.push_back(ParseScalar(item, number));
+      }
+      start = i + 1;
+    }
+  }
+  return node;
+}
+
+YamlNode YamlParser::ParseScalar(const std::string &text, int line) const {
+  YamlNode node(YamlNode::SCALAR, line);
+  if (text == "~" || text == "null" || text == "Null" || text == "NULL") {
+    node.type_ = YamlNode::NONE;
+    return node;
+  }
+  char quote = text[0];
+  if (quote != '\'' && quote != '"') {
+    node.scalar_ = text;
+    return node;
+  }
+  if (text.size() < 2 || text.back() != quote) {
+    Fail(line, "unterminated string " + text + ".");
+  }
+  for (std::size_t i = 1; i + 1 < text.size(); i++) {
+    char c = text[i];
+    if (quote == '\'' && c == '\'' && text[i + 1] == '\'') {
+      i++;
+    } else if (quote == '"' && c == '\\' && i + 2 < text.size()) {
+      c = text[++i];
+      if (c == 'n') {
+        c = '\n';
+      } else if (c == 't') {
+        c = '\t';
+      }
+    }
+    node.scalar_ += c;
+  }
+  return node;
+}
+
+void YamlParser::CheckIndent(int indent) const {
+  if (pos_ < lines_.size() && lines_[pos_].indent > indent) {
+    Fail(lines_[pos_].number, "unexpected indentation.");
+  }
+}
+
+bool YamlParser::SplitKey(const std::string &text, std::string *key,
+                          std::string *value) {
+  char quote = 0;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    char c = text[i];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+    } else if (c == ':' && (i + 1 == text.size() || text[i + 1] == ' ')) {
+      *key = Trim(text.substr(0, i));
+      *value = Trim(text.substr(i + 1));
+      return !key->empty();
+    }
+  }
+  return false;
+}
+
+std::string YamlParser::Trim(const std::string &text) {
+  std::size_t start = text.find_first_not_of(" \t\r");
+  if (start == std::string::npos) {
+    return "";
+  }
+  std::size_t stop = text.find_last_not_of(" \t\r");
+  return text.substr(start, stop - start + 1);
+}
+
+YamlNode ParseYaml(std::istream &input) {
+  return YamlParser(input).Parse();
+}
@@ -0,0 +1,94 @@
+#ifndef SRC_YAML_HPP  // header guard
+#define SRC_YAML_HPP
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A node of a parsed YAML document: a scalar, a sequence of nodes, or a
+ * mapping from keys to nodes. Scalars are kept as strings and converted on
+ * access, so that errors can point at the offending line.
+ */
+class YamlNode {
+ public:
+  enum Type { NONE, SCALAR, SEQUENCE, MAPPING };
+  typedef std::vector<std::pair<std::string, YamlNode>> Entries;
+  YamlNode(Type type = NONE, int line = 0) : type_(type), line_(line) {}
+  Type type() const { return type_; }
+  /**
+   * Line of the document this node started on, for error messages.
+   */
+  int line() const { return line_; }
+  bool IsNone() const { return type_ == NONE; }
+  bool IsScalar() const { return type_ == SCALAR; }
+  bool IsSequence() const { return type_ == SEQUENCE; }
+  bool IsMapping() const { return type_ == MAPPING; }
+  /**
+   * Whether this mapping has a key. False for nodes that are not mappings.
+   */
+  bool Has(const std::string &key) const;
+  /**
+   * Value of a key of this mapping; throws std::runtime_error if the key is
+   * missing or this node is not a mapping.
+   */
+  const YamlNode &operator[](const std::string &key) const;
+  /**
+   * Item of this sequence; throws std::runtime_error if out of range or
+   * this node is not a sequence.
+   */
+  const YamlNode &operator[](std::size_t index) const;
+  /**
+   * Number of items of a sequence or entries of a mapping.
+   */
+  std::size_t size() const;
+  /**
+   * Key-value pairs of this mapping, in document order.
+   */
+  const Entries &entries() const;
+  /**
+   * Items of this sequence, in document order.
+   */
+  const std::vector<YamlNode> &items() const;
+  /**
+   * Conversions of scalars; throw std::runtime_error if this node is not a
+   * scalar of the requested type.
+   */
+  const std::string &AsString() const;
+  double AsDouble() const;
+  int AsInt() const;
+  bool AsBool() const;
+  /**
+   * Sequence of scalars as doubles.
+   */
+  std::vector<double> AsDoubles() const;
+  /**
+   * Sequence of scalars as strings.
+   */
+  std::vector<std::string> AsStrings() const;
+
+ private:
+  friend class YamlParser;
+  Type type_;
+  int line_;
+  std::string scalar_;
+  std::vector<YamlNode> items_;
+  Entries entries_;
+  void Fail(const std::string &message) const;
+};
+
+/**
+ * Parse the subset of YAML used by pinetree model files: block mappings
+ * and sequences (including sequences indented at the level of their key),
+ * plain and quoted scalars, flow sequences of scalars, which may span
+ * lines, and comments. Anchors, tags, multi-line strings, flow mappings and
+ * multiple documents are not supported. Throws std::runtime_error on
+ * malformed input.
+ *
+ * @param input document to parse
+ * @return root node of the document, NONE if it is empty
+ */
+YamlNode ParseYaml(std::istream &input);
+
+#endif  // header guard
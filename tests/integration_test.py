@@ -26,6 +26,1108 @@ class MainTest(unittest.TestCase):
     def test_single_gene(self):
         self.run_test('single_gene')
 
+    def test_simulate_to_arrays(self):
+        import pinetree as pt
+        from tests.models import single_gene
+        simulate = pt.Model.simulate
+        results = {}
+
+        def to_arrays(model, time_limit, time_step, output):
+            results.update(model.simulate_to_arrays(time_limit=time_limit,
+                                                    time_step=time_step))
+        pt.Model.simulate = to_arrays
+        try:
+            single_gene.execute(self.tempdir.name + "/single_gene")
+        finally:
+            pt.Model.simulate = simulate
+        with open('tests/output/single_gene_counts.tsv') as f:
+            expected = [line.split('\t') for line in f.read().splitlines()[1:]]
+        species = results["species"]
+        times = ["%f" % time for time in results["time"]]
+        columns = {name: i for i, name in enumerate(species)}
+        found = set()
+        for time, name, protein, transcript, ribo_density in expected:
+            row = times.index(time)
+            column = columns[name]
+            found.add((row, column))
+            self.assertAlmostEqual(results["protein"][row, column],
+                                   float(protein), places=5)
+            self.assertAlmostEqual(results["transcript"][row, column],
+                                   float(transcript), places=5)
+            self.assertAlmostEqual(results["ribo_density"][row, column],
+                                   float(ribo_density), places=5)
+        # Species that have not appeared yet are reported as zero
+        for row in range(len(times)):
+            for column in range(len(species)):
+                if (row, column) not in found:
+                    self.assertEqual(results["protein"][row, column], 0)
+
+    def test_simulate_ensemble(self):
+        import pinetree as pt
+        from tests.models import single_gene
+        simulate = pt.Model.simulate
+        results = []
+
+        def ensemble(model, time_limit, time_step, output):
+            results.extend(model.simulate_ensemble(
+                n=3, time_limit=time_limit, time_step=time_step, seeds=[34],
+                threads=2))
+            model.simulate_ensemble(
+                n=2, time_limit=time_limit, time_step=time_step, seeds=[34],
+                output=output)
+        pt.Model.simulate = ensemble
+        try:
+            single_gene.execute(self.tempdir.name + "/single_gene")
+        finally:
+            pt.Model.simulate = simulate
+        self.assertEqual(len(results), 3)
+        # Replicate 0 uses stream 0 of the shared seed, like Model.seed(34)
+        with open('tests/output/single_gene_counts.tsv') as f:
+            expected = f.read()
+        with open(self.tempdir.name + "/single_gene_counts.tsv_0.tsv") as f:
+            self.assertEqual(f.read(), expected)
+        with open(self.tempdir.name + "/single_gene_counts.tsv_1.tsv") as f:
+            self.assertNotEqual(f.read(), expected)
+        self.assertNotEqual(list(results[0]["time"]),
+                            list(results[1]["time"]))
+
+    def test_ensemble_placement(self):
+        import pinetree as pt
+        nodes = pt.numa_nodes()
+        self.assertGreater(len(nodes), 0)
+        self.assertTrue(all(len(cpus) > 0 for cpus in nodes))
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_species("a", 100)
+        sim.add_reaction(0.1, ["a"], ["b"])
+        unpinned = sim.simulate_ensemble(n=3, time_limit=20, time_step=1,
+                                         seeds=[34], threads=2)
+        sim.set_placement("spread")
+        pinned = sim.simulate_ensemble(n=3, time_limit=20, time_step=1,
+                                       seeds=[34], threads=2)
+        for first, second in zip(unpinned, pinned):
+            self.assertEqual(first["protein"].tolist(),
+                             second["protein"].tolist())
+        with self.assertRaises(ValueError):
+            sim.set_placement("everywhere")
+
+    def test_population(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=305)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=304, stop=305,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=41, stop=100,
+                         rbs_start=31, rbs_stop=40, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.add_species("a", 64)
+        population = pt.Population(sim, cells=1, seed=34)
+        population.set_division(generation=10)
+        population.set_threads(2)
+        population.simulate(time_limit=40, time_step=10)
+        self.assertEqual(len(population), 16)
+        self.assertEqual(population.divisions, 15)
+        summary = population.summary()
+        self.assertEqual(list(summary["replicates"]), [1, 2, 4, 8, 16])
+        a = summary["species"].index("a")
+        for row in range(5):
+            self.assertAlmostEqual(
+                summary["protein"]["mean"][row, a] *
+                summary["replicates"][row], 64)
+
+    def test_simulate_ensemble_hdf5(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_species("A", 1000)
+        sim.add_reaction(1.0, ["A"], ["B"])
+        path = self.tempdir.name + "/ensemble.h5"
+        try:
+            sim.simulate_ensemble(n=4, time_limit=2, time_step=1, seeds=[7],
+                                  output=path, format="hdf5")
+        except ValueError as error:
+            self.assertIn("PINETREE_HDF5", str(error))
+            self.skipTest("pinetree was built without HDF5 support")
+        sim.simulate_ensemble(n=4, time_limit=2, time_step=1, seeds=[7],
+                              method="batch", output=path, format="hdf5")
+        # One file for the whole ensemble
+        with open(path, "rb") as f:
+            self.assertEqual(f.read(8), b"\x89HDF\r\n\x1a\n")
+
+    def test_simulate_ensemble_stats(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        replicates = sim.simulate_ensemble(n=4, time_limit=30, time_step=1,
+                                           seeds=[34])
+        stats = sim.simulate_ensemble_stats(n=4, time_limit=30, time_step=1,
+                                            seeds=[34], quantiles=[0.5])
+        self.assertEqual(list(stats["time"]), [float(t) for t in range(31)])
+        column = stats["species"].index("proteinX")
+        # Replicates are grouped by the time point each row was recorded for
+        final = []
+        for r in replicates:
+            for row, time in enumerate(r["time"]):
+                if int(time + 0.001) == 20:
+                    final.append(
+                        r["protein"][row, r["species"].index("proteinX")])
+                    break
+        self.assertEqual(stats["replicates"][20], len(final))
+        self.assertAlmostEqual(stats["protein"]["mean"][20, column],
+                               sum(final) / len(final))
+        self.assertEqual(stats["protein"]["max"][20, column], max(final))
+        self.assertEqual(stats["protein"]["min"][20, column], min(final))
+        self.assertTrue(min(final) <= stats["protein"]["quantiles"][0, 20, column]
+                        <= max(final))
+
+    def test_simulate_ensemble_batch(self):
+        import pinetree as pt
+
+        def decay():
+            sim = pt.Model(cell_volume=8e-16)
+            sim.add_species("A", 1000)
+            sim.add_reaction(1.0, ["A"], ["B"])
+            return sim
+        batch = decay().simulate_ensemble(n=10, time_limit=2, time_step=1,
+                                          seeds=[7], method="batch")
+        self.assertEqual(len(batch), 10)
+        # Batches report the state at exactly each time step, and B once a
+        # replicate has produced it
+        self.assertEqual(list(batch[3]["time"]), [0.0, 1.0, 2.0])
+        self.assertEqual(batch[3]["species"], ["A", "B"])
+        self.assertEqual(batch[3]["protein"][0, 0], 1000)
+        self.assertEqual(batch[3]["protein"][0, 1], 0)
+        self.assertEqual(batch[3]["protein"][2, 0] + batch[3]["protein"][2, 1],
+                         1000)
+        again = decay().simulate_ensemble(n=10, time_limit=2, time_step=1,
+                                          seeds=[7], method="batch",
+                                          threads=3)
+        self.assertEqual(again[9]["protein"][2, 0], batch[9]["protein"][2, 0])
+        # Around 1000 / e of A are left at t = 1
+        stats = decay().simulate_ensemble_stats(
+            n=40, time_limit=2, time_step=1, seeds=[7], method="batch")
+        self.assertAlmostEqual(stats["protein"]["mean"][1, 0], 367.9,
+                               delta=10)
+        self.assertEqual(stats["replicates"][2], 40)
+
+        # Polymerases that may bind need the polymer engine
+        sim = decay()
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        plasmid = pt.Genome(name="T7", length=305)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        sim.register_genome(plasmid)
+        with self.assertRaises(ValueError):
+            sim.simulate_ensemble(n=2, time_limit=2, time_step=1,
+                                  method="batch")
+
+    def test_partial_equilibrium(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_species("A", 100)
+        sim.add_species("B", 100)
+        sim.add_reaction(0.1 * 6.0221409e+23 * 8e-16, ["A", "B"], ["C"])
+        sim.add_reaction(10, ["C"], ["A", "B"])
+        sim.add_reaction(0.1, ["C"], ["C", "P"])
+        sim.set_partial_equilibrium(100)
+        sim.seed(3)
+        sim.simulate_to_arrays(time_limit=20, time_step=10)
+        stats = sim.stats()
+        self.assertEqual(stats["fast_pairs"], 1)
+        self.assertGreater(stats["equilibrium_samples"], 0)
+        # Each sample stands in for many binding and unbinding events
+        self.assertGreater(stats["fast_events_skipped"],
+                           10 * stats["events"]["species_reaction"])
+        with self.assertRaises(RuntimeError):
+            sim.set_partial_equilibrium(10)
+
+    def test_mean_field_translation(self):
+        import pinetree as pt
+
+        def build():
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(34)
+            sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=605)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_terminator(name="t1", start=604, stop=605,
+                                   efficiency={"rnapol": 1.0})
+            plasmid.add_gene(name="proteinX", start=26, stop=571,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            plasmid.set_mean_field_translation("proteinX")
+            sim.register_genome(plasmid)
+            return sim
+
+        out = self.tempdir.name
+        whole = build()
+        whole.simulate(time_limit=40, time_step=1, output=out + "/whole.tsv")
+        stats = whole.stats()
+        self.assertGreater(stats["mean_field_ribosomes"], 0)
+        self.assertGreater(stats["mean_field_moves"],
+                           500 * stats["mean_field_ribosomes"])
+        # Ribosomes in transit are restored from a checkpoint
+        first = build()
+        first.simulate(time_limit=20, time_step=1, output=out + "/first.tsv")
+        first.checkpoint(out + "/sim.checkpoint")
+        second = build()
+        second.restore(out + "/sim.checkpoint")
+        second.simulate(time_limit=40, time_step=1,
+                        output=out + "/second.tsv")
+        with open(out + "/whole.tsv") as f:
+            whole_lines = f.readlines()
+        with open(out + "/first.tsv") as f:
+            first_lines = f.readlines()
+        with open(out + "/second.tsv") as f:
+            second_lines = f.readlines()
+        self.assertEqual(first_lines + second_lines[1:], whole_lines)
+        self.assertTrue(any(line.split("\t")[1] == "proteinX"
+                            for line in whole_lines))
+
+    def test_steady_state(self):
+        import pinetree as pt
+        from pinetree.output import read_metadata
+
+        def build():
+            sim = pt.Model(cell_volume=8e-16)
+            sim.add_species("A", 200)
+            sim.add_reaction(1, ["A"], ["B"])
+            sim.add_reaction(1, ["B"], ["A"])
+            sim.set_steady_state(10, tolerance=0.01)
+            sim.seed(5)
+            return sim
+
+        sim = build()
+        results = sim.simulate_to_arrays(time_limit=500, time_step=1)
+        stopped = sim.steady_state_time()
+        self.assertIsNotNone(stopped)
+        self.assertLess(stopped, 500)
+        self.assertEqual(results["metadata"], {"steady_state_time": stopped})
+        self.assertEqual(list(results["time"])[-1], stopped)
+        out_path = self.tempdir.name + "/counts.tsv"
+        build().simulate(time_limit=500, time_step=1, output=out_path)
+        with open(out_path) as f:
+            lines = f.readlines()
+        self.assertEqual(lines[-1], "# steady_state_time={:f}\n".format(
+            stopped))
+        out_path = self.tempdir.name + "/counts.bin"
+        build().simulate(time_limit=500, time_step=1, output=out_path,
+                         format="binary")
+        self.assertEqual(read_metadata(out_path),
+                         {"steady_state_time": stopped})
+        sim = build()
+        sim.set_steady_state(0)
+        sim.simulate_to_arrays(time_limit=50, time_step=1)
+        self.assertIsNone(sim.steady_state_time())
+
+    def test_stop_when(self):
+        import pinetree as pt
+
+        def build():
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(34)
+            sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=605)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_terminator(name="t1", start=604, stop=605,
+                                   efficiency={"rnapol": 1.0})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            sim.register_genome(plasmid)
+            sim.stop_when("proteinX >= 1000000")
+            sim.stop_when("transcripts(proteinX) >= 3 && rnapol < 5")
+            return sim
+
+        sim = build()
+        results = sim.simulate_to_arrays(time_limit=1000, time_step=1)
+        stopped = sim.stop_time()
+        self.assertIsNotNone(stopped)
+        self.assertLess(stopped, 1000)
+        self.assertEqual(sim.stop_condition(),
+                         "transcripts(proteinX) >= 3 and rnapol < 5")
+        self.assertEqual(results["metadata"],
+                         {"stop_time": stopped, "stop_condition": 1})
+        out_path = self.tempdir.name + "/counts.tsv"
+        build().simulate(time_limit=1000, time_step=1, output=out_path)
+        with open(out_path) as f:
+            lines = f.readlines()
+        self.assertEqual(lines[-2:], [
+            "# stop_time={:f}\n".format(stopped),
+            "# stop_condition=1.000000\n"])
+        with self.assertRaises(ValueError):
+            sim.stop_when("transcripts(proteinX >= 3")
+        sim.stop_when("")
+        sim.simulate_to_arrays(time_limit=1000, time_step=1)
+        self.assertIsNone(sim.stop_time())
+        self.assertIsNone(sim.stop_condition())
+
+    def test_scheduled_changes(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_species("A", 0)
+        sim.add_species("X", 1)
+        sim.add_reaction(0.1, ["A"], ["B"], name="decay")
+        sim.add_reaction(1, ["X"], ["X", "Y"])
+        sim.schedule_species(10, "A", 50)
+        sim.schedule_parameter(20, "decay.rate", 2)
+        sim.seed(8)
+        results = sim.simulate_to_arrays_at([9.5, 10, 20, 40])
+        a = results["species"].index("A")
+        b = results["species"].index("B")
+        protein = results["protein"]
+        counts = [[protein[row, a], protein[row, b]] for row in range(4)]
+        self.assertEqual(counts[0], [0, 0])
+        self.assertEqual(sum(counts[1]), 50)
+        self.assertEqual(counts[3], [0, 50])
+        self.assertEqual(sim.parameter("decay.rate"), 2)
+        with self.assertRaises(ValueError):
+            sim.schedule_species(-5, "A", 1)
+        with self.assertRaises(RuntimeError):
+            sim.schedule_species(50, "A", 1)
+
+    def test_common_random_numbers(self):
+        import pinetree as pt
+
+        def made(rate):
+            sim = pt.Model(cell_volume=8e-16)
+            sim.add_species("A", 1)
+            sim.add_species("B", 1)
+            sim.add_reaction(1, ["A"], ["A", "P"])
+            sim.add_reaction(rate, ["B"], ["B", "Q"])
+            sim.set_common_random_numbers()
+            sim.seed(3)
+            results = sim.simulate_to_arrays_at([50],
+                                                method="next_reaction")
+            column = results["species"].index("P")
+            return results["protein"][0, column]
+
+        self.assertEqual(made(1), made(3))
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_species("A", 1)
+        sim.add_reaction(1, ["A"], ["A", "P"])
+        sim.set_common_random_numbers(True)
+        with self.assertRaises(ValueError):
+            sim.simulate_to_arrays(time_limit=10, time_step=1)
+
+    def test_fast_random(self):
+        import pinetree as pt
+
+        def made(seed, fast):
+            sim = pt.Model(cell_volume=8e-16)
+            sim.add_species("A", 1)
+            sim.add_reaction(1, ["A"], ["A", "P"])
+            sim.set_fast_random(fast)
+            sim.seed(seed)
+            results = sim.simulate_to_arrays_at([400])
+            column = results["species"].index("P")
+            return results["protein"][0, column]
+
+        self.assertEqual(made(5, True), made(5, True))
+        self.assertNotEqual(made(5, True), made(5, False))
+        # About one product per unit of time with either generator
+        self.assertGreater(made(6, True), 300)
+        self.assertLess(made(6, True), 500)
+
+    def test_simulate_at(self):
+        import os
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        times = [0] + [10 ** (k / 10) for k in range(17)]
+        results = sim.simulate_to_arrays_at(times)
+        self.assertEqual(list(results["time"]), times)
+        out_path = self.tempdir.name + "/counts.tsv"
+        sim.simulate_at([50, 60], output=out_path)
+        with open(out_path) as f:
+            rows = [line.split() for line in f.readlines()[1:]]
+        self.assertEqual(sorted(set(float(row[0]) for row in rows)),
+                         [50, 60])
+        # Bad times fail before the output file is touched
+        bad_path = self.tempdir.name + "/bad_counts.tsv"
+        with self.assertRaises(ValueError):
+            sim.simulate_at([10], output=bad_path)
+        self.assertFalse(os.path.exists(bad_path))
+
+        # Restrict output to one protein; the open file is appended to
+        sim.set_output_species(["protein*"])
+        sim.simulate_at([70], output=out_path)
+        with open(out_path) as f:
+            rows = [line.split() for line in f.readlines()[1:]]
+        self.assertEqual([row[1] for row in rows if float(row[0]) == 70],
+                         ["proteinX"])
+
+    def test_binary_output(self):
+        import pinetree as pt
+        from pinetree.output import read_counts
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        out_path = self.tempdir.name + "/counts.bin"
+        sim.simulate(time_limit=40, time_step=1, output=out_path,
+                     format="binary")
+        results = read_counts(out_path)
+        with open('tests/output/single_gene_counts.tsv') as f:
+            header = f.readline().split()
+        self.assertEqual(sorted(results), sorted(header))
+        self.assertEqual(len(results["time"]), len(results["species"]))
+        self.assertIn("proteinX", results["species"])
+        self.assertTrue(max(results["protein"]) > 0)
+        with self.assertRaises(ValueError):
+            sim.simulate(time_limit=1, time_step=1, output=out_path,
+                         format="parquet")
+
+    def test_counts_io(self):
+        import pinetree as pt
+        from pinetree.io import Ensemble, open_counts
+        paths = []
+        for seed in (34, 35):
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(seed)
+            sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=305)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            plasmid.add_terminator(name="t1", start=304, stop=305,
+                                   efficiency={"rnapol": 1.0})
+            sim.register_genome(plasmid)
+            paths.append("{}/counts{}.bin".format(self.tempdir.name, seed))
+            sim.simulate(time_limit=41, time_step=1, output=paths[-1],
+                         format="binary_delta")
+
+        counts = open_counts(paths[0])
+        self.assertIn("proteinX", counts.species)
+        self.assertEqual(len(counts.time), 41)
+        window = counts.read(["proteinX"], 9.5, 20.5)
+        self.assertEqual(len(window["time"]), 11)
+        self.assertEqual(window["protein"].shape, (11, 1))
+
+        ensemble = Ensemble(paths)
+        resampled = ensemble.resample([0, 10.5, 40], species=["proteinX"])
+        self.assertEqual(resampled["replicates"], 2)
+        self.assertEqual(resampled["protein"].shape, (2, 3, 1))
+        self.assertEqual(resampled["protein"][0, 1, 0],
+                         window["protein"][1, 0])
+        summary = ensemble.summarize(10)
+        self.assertEqual(list(summary["replicates"]), [2] * 5)
+        column = summary["species"].index("proteinX")
+        self.assertAlmostEqual(
+            summary["protein"]["mean"][4, column],
+            (resampled["protein"][0, 2, 0] + resampled["protein"][1, 2, 0]) /
+            2)
+        with self.assertRaises(RuntimeError):
+            open_counts(self.tempdir.name + "/missing.bin")
+
+    def test_delta_output(self):
+        import os
+        import pinetree as pt
+        from pinetree.output import read_counts
+
+        def run(format, path):
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(34)
+            sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+            for i in range(20):
+                sim.add_species("idle{}".format(i), 10)
+            plasmid = pt.Genome(name="T7", length=605)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_terminator(name="t1", start=604, stop=605,
+                                   efficiency={"rnapol": 1.0})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            sim.register_genome(plasmid)
+            sim.simulate(time_limit=20, time_step=1, output=path,
+                         format=format)
+            sim.simulate(time_limit=40, time_step=1, output=path,
+                         format=format)
+            return read_counts(path)
+
+        dense_path = self.tempdir.name + "/dense.bin"
+        delta_path = self.tempdir.name + "/delta.bin"
+        dense = run("binary", dense_path)
+        # Every time point is restored in full, including across calls
+        self.assertEqual(run("binary_delta", delta_path), dense)
+        self.assertIn("idle3", dense["species"])
+        self.assertLess(os.path.getsize(delta_path) * 3,
+                        os.path.getsize(dense_path))
+
+    def test_checkpoint_restore(self):
+        import pinetree as pt
+
+        def build():
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(34)
+            sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=605)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_terminator(name="t1", start=604, stop=605,
+                                   efficiency={"rnapol": 1.0})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            sim.register_genome(plasmid)
+            return sim
+
+        out = self.tempdir.name
+        build().simulate(time_limit=40, time_step=1,
+                         output=out + "/whole.tsv")
+        first = build()
+        first.simulate(time_limit=20, time_step=1, output=out + "/first.tsv")
+        first.checkpoint(out + "/sim.checkpoint")
+        second = build()
+        second.restore(out + "/sim.checkpoint")
+        second.simulate(time_limit=40, time_step=1,
+                        output=out + "/second.tsv")
+        with open(out + "/whole.tsv") as f:
+            whole = f.readlines()
+        with open(out + "/first.tsv") as f:
+            first_lines = f.readlines()
+        with open(out + "/second.tsv") as f:
+            second_lines = f.readlines()
+        # The resumed run writes the time points after the checkpoint
+        self.assertEqual(first_lines + second_lines[1:], whole)
+        with self.assertRaises(RuntimeError):
+            second.restore(out + "/sim.checkpoint")
+
+        # Occupancy profiles are indexed by position
+        profiled = build()
+        profiled.record_occupancy()
+        profiled.simulate_to_arrays(time_limit=40, time_step=10)
+        occupancy = profiled.occupancy()
+        self.assertEqual(sorted(occupancy), ["T7"])
+        self.assertEqual(len(occupancy["T7"]["rnapol"]), 606)
+        self.assertTrue(0 < sum(occupancy["T7"]["rnapol"]) <= 1)
+
+        # Dwell time histograms have one row of bins per position
+        paused = build()
+        paused.record_dwell_times(min_time=0.01, max_time=10, bins=8)
+        paused.simulate_to_arrays(time_limit=40, time_step=10)
+        dwell = paused.dwell_times()
+        self.assertEqual(len(dwell["edges"]), 9)
+        self.assertEqual(dwell["T7"]["rnapol"].shape, (606, 8))
+        self.assertTrue(sum(map(sum, dwell["T7"]["rnapol"].tolist())) > 0)
+
+        # Writing on a background thread gives the same file
+        async_sim = build()
+        async_sim.set_async_output()
+        async_sim.simulate(time_limit=40, time_step=1,
+                           output=out + "/async.tsv")
+        with open(out + "/async.tsv") as f:
+            self.assertEqual(f.readlines(), whole)
+
+        # Running ahead takes many moves in each event
+        running = build()
+        running.set_run_ahead()
+        running.simulate_to_arrays(time_limit=40, time_step=10)
+        run_stats = running.stats()
+        self.assertTrue(run_stats["runs"] > 0)
+        self.assertTrue(run_stats["events"]["polymer"] +
+                        run_stats["scheduled_events"] < run_stats["moves"])
+
+        # Forks continue from the same state without a checkpoint file
+        forks = first.fork(2, seeds=[34])
+        self.assertEqual(len(forks), 2)
+        for i, fork in enumerate(forks):
+            fork.simulate(time_limit=40, time_step=1,
+                          output=out + "/fork{}.tsv".format(i))
+        with open(out + "/fork0.tsv") as f:
+            fork_lines = f.readlines()
+        self.assertEqual(fork_lines[0], whole[0])
+        self.assertTrue(float(fork_lines[1].split()[0]) >= 20)
+
+        # Simulating in steps appends to the same file
+        chunked = build()
+        chunked.simulate(time_limit=20, time_step=1,
+                         output=out + "/chunked.tsv")
+        self.assertTrue(chunked.time() >= 20)
+        with open(out + "/chunked.tsv") as f:
+            self.assertEqual(f.readlines(), first_lines)
+        chunked.simulate(time_limit=40, time_step=1,
+                         output=out + "/chunked.tsv")
+        with open(out + "/chunked.tsv") as f:
+            self.assertEqual(f.readlines(), whole)
+
+        # A reset model reruns from the start without being rebuilt
+        rerun = build()
+        rerun.simulate(time_limit=40, time_step=1, output=out + "/rerun.tsv")
+        rerun.reset(34)
+        rerun.simulate(time_limit=40, time_step=1, output=out + "/rerun.tsv")
+        with open(out + "/rerun.tsv") as f:
+            self.assertEqual(f.readlines(), whole)
+
+        # Engine counters cover every event of the run
+        stats = first.stats()
+        self.assertEqual(sorted(stats["events"]),
+                         ["bind_polymerase", "bind_rnase", "polymer",
+                          "species_reaction"])
+        self.assertEqual(stats["events"]["polymer"],
+                         stats["moves"] + stats["polymerase_collisions"] +
+                         stats["mask_collisions"])
+        self.assertTrue(stats["transcripts_created"] > 0)
+        self.assertTrue(stats["propensity_updates_per_event"] >= 1)
+        self.assertTrue(stats["wall_time"]["simulate"] >= 0)
+
+    def test_progress_and_cancel(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+
+        # Cancelling from a progress report stops the run early
+        reports = []
+
+        def report(time, events_per_second):
+            reports.append((time, events_per_second))
+            sim.cancel()
+        sim.set_progress(report, interval=0)
+        result = sim.simulate_to_arrays(time_limit=1000, time_step=1)
+        self.assertEqual(len(reports), 1)
+        self.assertTrue(reports[0][1] > 0)
+        self.assertTrue(sim.time() < 1000)
+        self.assertTrue(result["time"][-1] <= sim.time())
+
+        # The cancelled model continues where it stopped
+        sim.set_progress(None)
+        rest = sim.simulate_to_arrays(time_limit=1000, time_step=1)
+        self.assertEqual(round(rest["time"][0]),
+                         round(result["time"][-1]) + 1)
+        self.assertEqual(round(rest["time"][-1]), 999)
+
+        # Exceptions raised by the callback stop the simulation
+        def fail(time, events_per_second):
+            raise ValueError("stop")
+        sim.set_progress(fail, interval=0)
+        with self.assertRaises(ValueError):
+            sim.simulate_to_arrays(time_limit=2000, time_step=1)
+
+    def test_parameters(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=1, speed=30, footprint=10)
+        sim.add_species(name="a", copy_number=10)
+        sim.add_reaction(rate_constant=0.01, reactants=["a"], products=["b"],
+                         name="decay")
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        self.assertEqual(sim.parameter("phi1.rnapol"), 2e8)
+        self.assertEqual(sim.parameter("decay.rate"), 0.01)
+        with self.assertRaises(ValueError):
+            sim.parameter("phi2.rnapol")
+
+        # Sweep the promoter strength over resets of one model
+        created = []
+        for strength in [0, 2e8]:
+            sim.reset(34)
+            sim.set_parameter("phi1.rnapol", strength)
+            sim.simulate_to_arrays(time_limit=20, time_step=5)
+            created.append(sim.stats()["transcripts_created"])
+        self.assertEqual(sim.parameter("phi1.rnapol"), 2e8)
+        self.assertTrue(created[1] > created[0])
+
+    def test_bulk_definitions(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=1000)
+        plasmid.add_promoters(names=["phi1"], starts=[1], stops=[10],
+                              interactions={"rnapol": [2e8]})
+        starts = range(26, 926, 100)
+        plasmid.add_genes(names=["gene%d" % i for i in range(len(starts))],
+                          starts=starts, stops=[s + 80 for s in starts],
+                          rbs_starts=[s - 15 for s in starts],
+                          rbs_stops=starts, rbs_strengths=[1e7] * len(starts))
+        plasmid.add_terminators(names=["t1"], starts=[998], stops=[999],
+                                efficiency={"rnapol": [1.0]})
+        with self.assertRaises(ValueError):
+            plasmid.add_genes(names=["a"], starts=[1, 2], stops=[5],
+                              rbs_starts=[1], rbs_stops=[1],
+                              rbs_strengths=[1e7])
+        sim.register_genome(plasmid)
+        table = sim.simulate_to_arrays(time_limit=40, time_step=10)
+        self.assertIn("gene0", table["species"])
+        self.assertIn("gene8", table["species"])
+
+    def test_species_counts(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_species(name="a", copy_number=100)
+        sim.add_species(name="b", copy_number=0)
+        sim.add_reaction(rate_constant=1.0, reactants=["a"], products=["b"])
+        counts = sim.species_counts()
+        names = sim.species_names()
+        self.assertEqual(counts[names.index("a")], 100)
+        with self.assertRaises(TypeError):
+            counts[names.index("a")] = 1
+
+        # A fresh view after simulating reads the new counts
+        sim.simulate_to_arrays(time_limit=1, time_step=1)
+        names = sim.species_names()
+        counts = sim.species_counts()
+        a, b = counts[names.index("a")], counts[names.index("b")]
+        self.assertTrue(0 < b < 100)
+        self.assertEqual(a + b, 100)
+
+    def test_pickle(self):
+        import pickle
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=305)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        plasmid.add_terminator(name="t1", start=304, stop=305,
+                               efficiency={"rnapol": 1.0})
+        copy = pickle.loads(pickle.dumps(plasmid))
+        self.assertEqual(pickle.dumps(copy), pickle.dumps(plasmid))
+        sim.register_genome(plasmid)
+
+        copy = pickle.loads(pickle.dumps(sim))
+        sim.seed(34)
+        copy.seed(34)
+        original = sim.simulate_to_arrays(time_limit=40, time_step=10)
+        loaded = copy.simulate_to_arrays(time_limit=40, time_step=10)
+        self.assertEqual(loaded["species"], original["species"])
+        self.assertEqual(loaded["protein"].tolist(),
+                         original["protein"].tolist())
+
+    def test_model_cache(self):
+        import os
+        import pinetree as pt
+        builds = []
+
+        def build():
+            builds.append(1)
+            sim = pt.Model(cell_volume=8e-16)
+            sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=305)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            plasmid.add_terminator(name="t1", start=304, stop=305,
+                                   efficiency={"rnapol": 1.0})
+            sim.register_genome(plasmid)
+            return sim
+
+        input_path = os.path.join(self.tempdir.name, "input.txt")
+        with open(input_path, "w") as f:
+            f.write("T7")
+        key = pt.ModelCache.key([input_path], ["4", "10"])
+        self.assertNotEqual(key, pt.ModelCache.key([input_path], ["4", "1"]))
+        cache = pt.ModelCache(os.path.join(self.tempdir.name, "cache"))
+        self.assertIsNone(cache.load(key))
+        first = cache.get(key, build)
+        second = cache.get(key, build)
+        self.assertEqual(len(builds), 1)
+        self.assertTrue(os.path.exists(cache.path(key)))
+        first.seed(34)
+        second.seed(34)
+        original = first.simulate_to_arrays(time_limit=40, time_step=10)
+        cached = second.simulate_to_arrays(time_limit=40, time_step=10)
+        self.assertEqual(cached["protein"].tolist(),
+                         original["protein"].tolist())
+
+    def test_checked_module(self):
+        import pinetree.core as fast
+        import pinetree.core_checked as checked
+        results = []
+        for pt in (fast, checked):
+            sim = pt.Model(cell_volume=8e-16)
+            sim.seed(34)
+            sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                               footprint=10)
+            sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+            plasmid = pt.Genome(name="T7", length=305)
+            plasmid.add_promoter(name="phi1", start=1, stop=10,
+                                 interactions={"rnapol": 2e8})
+            plasmid.add_gene(name="proteinX", start=26, stop=225,
+                             rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+            plasmid.add_terminator(name="t1", start=304, stop=305,
+                                   efficiency={"rnapol": 1.0})
+            sim.register_genome(plasmid)
+            arrays = sim.simulate_to_arrays(time_limit=40, time_step=10)
+            results.append((arrays["species"], arrays["protein"].tolist()))
+        # Checks do not change the simulation
+        self.assertEqual(results[0], results[1])
+
+    def test_event_trace(self):
+        import struct
+        import pinetree as pt
+        from pinetree.trace import replay
+        out_path = self.tempdir.name + "/sim.trace"
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        if pt.trace_enabled:
+            sim.trace(out_path)
+            sim.simulate_to_arrays(time_limit=40, time_step=10)
+            sim.stop_trace()
+            tracks = replay(out_path)
+            self.assertEqual(tracks[0]["polymer"], "T7")
+            self.assertEqual(tracks[0]["element"], "rnapol")
+            self.assertEqual(tracks[0]["positions"][:2], [10, 11])
+            self.assertEqual(tracks[0]["end"], "terminate")
+            return
+        with self.assertRaises(RuntimeError):
+            sim.trace(out_path)
+        # Replay a hand-written trace of one blocked, terminated element
+        with open(out_path, "wb") as f:
+            f.write(b"PTTRACE\0" + struct.pack("<I", 1))
+            f.write(b"P" + struct.pack("<II", 0, 2) + b"T7")
+            f.write(b"N" + struct.pack("<II", 3, 6) + b"rnapol")
+            for time, event, position in [(0.5, 0, 10), (1.0, 1, 11),
+                                          (1.5, 2, 11), (2.0, 1, 12),
+                                          (2.0, 4, 12)]:
+                f.write(b"E" + struct.pack("<dBIIi", time, event, 0, 3,
+                                           position))
+        tracks = replay(out_path)
+        self.assertEqual(len(tracks), 1)
+        self.assertEqual(tracks[0]["positions"], [10, 11, 12])
+        self.assertEqual(tracks[0]["times"], [0.5, 1.0, 2.0])
+        self.assertEqual(tracks[0]["blocked"], 1)
+        self.assertEqual(tracks[0]["end"], "terminate")
+
+    def test_record_totals(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.add_reaction(0.05, ["proteinX"], [])
+        sim.set_record_totals()
+        results = sim.simulate_to_arrays(time_limit=200, time_step=50)
+        species = results["species"]
+        made = results["protein"][-1, species.index("proteinX_total")]
+        left = results["protein"][-1, species.index("proteinX")]
+        # Degraded proteins still count towards the total
+        self.assertGreater(made, left)
+        completed = results["protein"][-1, species.index("transcript_total")]
+        exposed = results["transcript"][-1, species.index("proteinX_total")]
+        self.assertGreater(completed, 0)
+        self.assertGreaterEqual(exposed, completed)
+
+    def test_time_buckets(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.set_time_buckets()
+        results = sim.simulate_to_arrays(time_limit=201, time_step=50)
+        species = results["species"]
+        protein = results["protein"]
+        for row in range(1, len(results["time"])):
+            mean = protein[row, species.index("proteinX")]
+            low = protein[row, species.index("proteinX_min")]
+            high = protein[row, species.index("proteinX_max")]
+            self.assertLessEqual(low, mean)
+            self.assertLessEqual(mean, high)
+        self.assertLess(protein[-1, species.index("proteinX_min")],
+                        protein[-1, species.index("proteinX_max")])
+
+    def test_memory_report(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.set_memory_sampling()
+        results = sim.simulate_to_arrays(time_limit=100, time_step=50)
+        report = sim.memory_report()
+        self.assertEqual(report["genomes"]["objects"], 1)
+        self.assertGreater(report["transcripts"]["objects"], 0)
+        subsystems = [key for key in report
+                      if key not in ("total", "pool_reserved")]
+        self.assertEqual(report["total"],
+                         sum(report[key]["bytes"] for key in subsystems))
+        # Sampled after the last time point written, before the run ended
+        self.assertGreater(results["metadata"]["memory_total"], 0)
+        self.assertLessEqual(results["metadata"]["memory_transcripts"],
+                             report["total"])
+
+    def test_dependency_report(self):
+        import pinetree as pt
+        sim = pt.Model(cell_volume=8e-16)
+        sim.add_polymerase(name="rnapol", copy_number=4, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        for i, start in enumerate([1, 301]):
+            plasmid.add_promoter(name="phi" + str(i), start=start,
+                                 stop=start + 9,
+                                 interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        plasmid.add_gene(name="proteinY", start=326, stop=525,
+                         rbs_start=311, rbs_stop=326, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.add_species("x", 10)
+        sim.add_reaction(1.0, ["x"], ["y"])
+        report = sim.dependency_report(partitions=2)
+        self.assertEqual(report["reactions"], 6)
+        self.assertEqual(sorted(report["hubs"]), ["__ribosome", "rnapol"])
+        self.assertEqual(report["species"]["rnapol"]["fan_out"], 2)
+        self.assertEqual(report["connected_components"], 2)
+        self.assertEqual(report["components"][1]["species"], ["x", "y"])
+        self.assertEqual(report["components"][1]["reactions"], ["x -> y"])
+        self.assertEqual([p["reactions"] for p in report["partitions"]],
+                         [5, 1])
+        self.assertEqual(report["partitions"][1]["shared"], [])
+        # Reports do not change the model, which still simulates
+        sim.seed(34)
+        sim.simulate_to_arrays(time_limit=10, time_step=5)
+
+    def test_polymer_snapshots(self):
+        import pinetree as pt
+        from pinetree.snapshot import read_snapshots
+        out_path = self.tempdir.name + "/sim.snap"
+        sim = pt.Model(cell_volume=8e-16)
+        sim.seed(34)
+        sim.add_polymerase(name="rnapol", copy_number=1, speed=40,
+                           footprint=10)
+        sim.add_ribosome(copy_number=10, speed=30, footprint=10)
+        plasmid = pt.Genome(name="T7", length=605)
+        plasmid.add_promoter(name="phi1", start=1, stop=10,
+                             interactions={"rnapol": 2e8})
+        plasmid.add_terminator(name="t1", start=604, stop=605,
+                               efficiency={"rnapol": 1.0})
+        plasmid.add_gene(name="proteinX", start=26, stop=225,
+                         rbs_start=11, rbs_stop=26, rbs_strength=1e7)
+        sim.register_genome(plasmid)
+        sim.record_snapshots(out_path)
+        results = sim.simulate_to_arrays(time_limit=40, time_step=10)
+        sim.stop_snapshots()
+        snapshots = read_snapshots(out_path)
+        self.assertEqual(snapshots["time"], list(results["time"]))
+        self.assertEqual(snapshots["polymers"][0], ("T7", "genome"))
+        self.assertIn(("T7", "transcript"),
+                      snapshots["polymers"].values())
+        names = {name for name, kind in snapshots["elements"].values()}
+        self.assertEqual(names, {"rnapol", "__ribosome"})
+        for start, stop in zip(snapshots["start"], snapshots["stop"]):
+            self.assertEqual(len(start), len(stop))
+            for first, last in zip(start, stop):
+                self.assertEqual(last - first, 9)
+        with open(out_path, "wb") as f:
+            f.write(b"PTTRACE\0")
+        with self.assertRaises(ValueError):
+            read_snapshots(out_path)
+
     # def test_three_genes(self):
     #     self.run_test('three_genes')
 
@@ -1,10 +1,43 @@
 #include "./lib/catch.hpp"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "annotations.hpp"
+#include "checkpoint.hpp"
 #include "choices.hpp"
+#include "compensated_sum.hpp"
+#include "counts_file.hpp"
+#include "ensemble_stats.hpp"
 #include "feature.hpp"
+#ifdef PINETREE_HDF5
+#include <hdf5.h>
+#include "hdf5_store.hpp"
+#endif
+#include "indexed_priority_queue.hpp"
+#include "memory_pool.hpp"
 #include "model.hpp"
+#include "model_cache.hpp"
+#include "model_file.hpp"
+#include "observer.hpp"
+#include "occupancy.hpp"
+#include "output.hpp"
+#include "placement.hpp"
+#include "population.hpp"
 #include "polymer.hpp"
+#include "propensity_bins.hpp"
+#include "propensity_tree.hpp"
 #include "reaction.hpp"
+#include "site_index.hpp"
+#include "species_batch.hpp"
+#include "trace.hpp"
 #include "tracker.hpp"
+#include "yaml.hpp"
 
 TEST_CASE("Genome construction")
 {
@@ -79,6 +112,23 @@ TEST_CASE("MobileElementManager Insert")
     REQUIRE(manager.GetPol(1)->start() == 51);
 }
 
+TEST_CASE("MobileElementManager weights default to 1")
+{
+    //Without weights, ribosomes move at their own speed at every position
+    MobileElementManager unweighted(nullptr);
+    auto ribosome = std::make_shared<Polymerase>("__ribosome", 10, 30);
+    ribosome->start(91); ribosome->stop(100);
+    unweighted.Insert(ribosome, std::shared_ptr<Polymer>());
+    REQUIRE(unweighted.prop_sum() == 30);
+
+    auto weights = std::make_shared<const std::vector<double>>(100, 0.5);
+    MobileElementManager weighted(weights);
+    weighted.Insert(ribosome, std::shared_ptr<Polymer>());
+    REQUIRE(weighted.prop_sum() == 15);
+    ribosome->stop(101);
+    REQUIRE_THROWS_AS(weighted.UpdatePropensity(0), std::runtime_error);
+}
+
 TEST_CASE("MobileElementManager Delete")
 {
     //The MobileElementManager constructor expects a vector of weights
@@ -121,13 +171,2894 @@ TEST_CASE("Attach a polymerase to a registered genome")
     std::map<std::string, double> efficiency = {{"rnapol", 1.0}};
     plasmid->AddPromoter("phi1", promoter_start, 10, interactions);
     sim->RegisterGenome(plasmid);
+    sim->Initialize();
+    CHECK(plasmid->uncovered("phi1") == 1);
+    CHECK(plasmid->uncovered("unknown") == 0);
 
     //Create a polymerase called 'rnapol' and bind it to the genome
     auto polymerase = std::make_shared<Polymerase>(Polymerase("rnapol", 10, 40));
     plasmid->Bind(polymerase, "phi1");
+    CHECK(plasmid->uncovered("phi1") == 0);
     
     //The genome should now have a single mobile element attached to it that
     //has the same start position as the promoter
     CHECK(plasmid->num_attached() == 1);
     REQUIRE(plasmid->attached_pol_start(0) == promoter_start);
 }
+
+TEST_CASE("Transcripts are built once their first binding site is uncovered")
+{
+    auto sim = std::make_shared<Model>(1.1e-15);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    sim->RegisterGenome(plasmid);
+    int built = 0;
+    plasmid->transcript_signal_.Connect(
+        [&built](Transcript::Ptr transcript) { built++; });
+
+    //The polymerase covers 1-10 after binding, so the RBS is still hidden
+    auto polymerase = std::make_shared<Polymerase>("rnapol", 10, 40);
+    plasmid->Bind(polymerase, "phi1");
+    CHECK(plasmid->nascent_count() == 1);
+    CHECK(built == 0);
+
+    //The RBS at 31-40 is exposed once the polymerase has moved past 40
+    for (int i = 0; i < 30; i++) {
+        plasmid->Move(0);
+    }
+    CHECK(built == 0);
+    plasmid->Move(0);
+    CHECK(built == 1);
+    REQUIRE(plasmid->nascent_count() == 0);
+}
+
+TEST_CASE("Recycled transcripts are reset to the state they were built in")
+{
+    auto sim = std::make_shared<Model>(1.1e-15);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    sim->RegisterGenome(plasmid);
+    auto tracker = std::make_shared<SpeciesTracker>();
+
+    auto transcript = plasmid->BuildTranscript(1, 305);
+    transcript->tracker(tracker);
+    transcript->Initialize();
+    for (int i = 0; i < 40; i++) {
+        transcript->ShiftMask();
+    }
+    CHECK(transcript->uncovered("__proteinX_rbs") == 1);
+
+    //The next transcript with the same layout reuses the recycled one
+    Transcript *recycled = transcript.get();
+    plasmid->RecycleTranscript(std::move(transcript));
+    auto reused = plasmid->BuildTranscript(1, 305);
+    REQUIRE(reused.get() == recycled);
+    reused->Initialize();
+    CHECK(reused->uncovered("__proteinX_rbs") == 0);
+    CHECK(reused->GetMask().start() == 1);
+    for (int i = 0; i < 40; i++) {
+        reused->ShiftMask();
+    }
+    CHECK(reused->uncovered("__proteinX_rbs") == 1);
+    REQUIRE(plasmid->BuildTranscript(1, 305) != reused);
+}
+
+TEST_CASE("Genome copies share transcript layouts and binding reactions")
+{
+    auto build = [](int copies) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 1000, 1000);
+        model->AddRibosome(10, 30, 100);
+        auto plasmid = std::make_shared<Genome>("T7", 305);
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e6}});
+        plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        model->RegisterGenome(plasmid, copies);
+        model->seed(5);
+        return model;
+    };
+    //Each copy adds its promoter to one reaction, so transcription scales
+    //with the copy number rather than its square
+    double bindings[2];
+    for (int copies : {1, 4}) {
+        auto table = build(copies)->SimulateToTableAt({20}, "direct");
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               "proteinX");
+        REQUIRE(found != table.species.end());
+        bindings[copies == 4] =
+            table.transcript[found - table.species.begin()];
+    }
+    REQUIRE(bindings[0] > 40);
+    REQUIRE(bindings[1] > 3 * bindings[0]);
+    REQUIRE(bindings[1] < 5 * bindings[0]);
+    REQUIRE_THROWS_AS(build(0), std::invalid_argument);
+
+    //A copy reuses transcripts recycled by the genome it was copied from
+    auto model = build(1);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    model->RegisterGenome(plasmid);
+    auto copy = plasmid->Copy();
+    model->RegisterGenome(copy);
+    auto transcript = plasmid->BuildTranscript(1, 305);
+    Transcript *recycled = transcript.get();
+    plasmid->RecycleTranscript(std::move(transcript));
+    auto reused = copy->BuildTranscript(1, 305);
+    REQUIRE(reused.get() == recycled);
+    REQUIRE(reused->genome() == copy);
+}
+
+TEST_CASE("Parallel simulation moves genomes in windows")
+{
+    auto build = [](int threads) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 1000, 1000);
+        model->AddRibosome(10, 30, 100);
+        auto plasmid = std::make_shared<Genome>("T7", 305);
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e6}});
+        plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        model->RegisterGenome(plasmid, 8);
+        if (threads > 0) {
+            model->parallel(threads, 0.05);
+        }
+        model->seed(11);
+        return model;
+    };
+    auto proteins = [](const CountsTable &table) {
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               "proteinX");
+        REQUIRE(found != table.species.end());
+        return table.protein[found - table.species.begin()];
+    };
+
+    //Windows are short compared to transcription, so counts stay close to
+    //those of a serial simulation
+    double serial = proteins(build(0)->SimulateToTableAt({10}, "direct"));
+    auto model = build(2);
+    double parallel = proteins(model->SimulateToTableAt({10}, "direct"));
+    REQUIRE(serial > 100);
+    CHECK(parallel > 0.7 * serial);
+    CHECK(parallel < 1.3 * serial);
+    CHECK(model->stats().events[Reaction::POLYMER] > 0);
+    CHECK(model->polymer_stats().moves > 0);
+
+    //One thread moves the genomes in a fixed order
+    double first = proteins(build(1)->SimulateToTableAt({10}, "direct"));
+    REQUIRE(proteins(build(1)->SimulateToTableAt({10}, "direct")) == first);
+
+    REQUIRE_THROWS_AS(build(0)->parallel(-1, 0.1), std::invalid_argument);
+    REQUIRE_THROWS_AS(build(0)->parallel(2, 0), std::invalid_argument);
+    auto ahead = build(2);
+    ahead->run_ahead(true);
+    REQUIRE_THROWS_AS(ahead->SimulateToTableAt({1}, "direct"),
+                      std::runtime_error);
+}
+
+TEST_CASE("Parallel windows pass while every polymerase is bound")
+{
+    //Once the only polymerase is bound, nothing but parked polymers can
+    //move, so the clock runs to the end of each window
+    for (int seed = 1; seed <= 5; seed++) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 1);
+        auto plasmid = std::make_shared<Genome>("T7", 305);
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        model->RegisterGenome(plasmid);
+        model->parallel(2, 0.05);
+        model->seed(seed);
+        auto table = model->SimulateToTableAt({5, 20}, "direct");
+        REQUIRE(table.time == std::vector<double>({5, 20}));
+        CHECK(model->time() == 20);
+        CHECK(model->polymer_stats().moves > 0);
+    }
+}
+
+TEST_CASE("Fast reversible pairs are drawn from their equilibrium")
+{
+    //A + B <-> C relaxes within milliseconds, C -> C + P takes seconds
+    auto build = [](double ratio) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddSpecies("A", 100);
+        model->AddSpecies("B", 100);
+        model->AddReaction(0.1 * 6.0221409e+23 * 8e-16, {"A", "B"}, {"C"});
+        model->AddReaction(10, {"C"}, {"A", "B"});
+        model->AddReaction(0.1, {"C"}, {"C", "P"});
+        model->partial_equilibrium(ratio);
+        return model;
+    };
+    double means[2] = {0, 0};
+    long long events[2] = {0, 0};
+    for (int approximate : {0, 1}) {
+        for (int seed = 1; seed <= 4; seed++) {
+            auto model = build(approximate ? 100 : 0);
+            model->seed(seed);
+            auto table = model->SimulateToTableAt({50}, "direct");
+            auto found = std::find(table.species.begin(), table.species.end(),
+                                   "P");
+            REQUIRE(found != table.species.end());
+            means[approximate] +=
+                table.protein[found - table.species.begin()] / 4;
+            events[approximate] +=
+                model->stats().events[Reaction::SPECIES];
+            auto stats = model->equilibrium_stats();
+            if (approximate) {
+                CHECK(stats.pairs == 1);
+                CHECK(stats.samples > 0);
+                CHECK(stats.skipped_events > 10000);
+            } else {
+                CHECK(stats.pairs == 0);
+            }
+        }
+    }
+    //About 38 of the 100 A are bound at equilibrium
+    CHECK(means[0] > 150);
+    CHECK(means[0] < 230);
+    CHECK(std::abs(means[1] - means[0]) < 0.15 * means[0]);
+    CHECK(events[1] * 50 < events[0]);
+    REQUIRE_THROWS_AS(build(-1), std::invalid_argument);
+}
+
+TEST_CASE("Mean-field translation terminates ribosomes at the exact rate")
+{
+    auto build = [](bool mean_field) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 1000, 1000);
+        model->AddRibosome(10, 30, 100);
+        auto plasmid = std::make_shared<Genome>("T7", 1005);
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e6}});
+        plasmid->AddGene("proteinX", 41, 622, 31, 40, 1e7);
+        plasmid->AddGene("proteinY", 641, 1000, 631, 640, 1e7);
+        plasmid->AddTerminator("t1", 1004, 1005, {{"rnapol", 1.0}});
+        //A slow stretch in the middle of proteinX
+        std::vector<double> weights(1005, 1.0);
+        std::fill(weights.begin() + 300, weights.begin() + 400, 0.5);
+        plasmid->AddWeights(weights);
+        if (mean_field) {
+            plasmid->MeanFieldTranslation("proteinX");
+        }
+        model->RegisterGenome(plasmid);
+        return model;
+    };
+    auto count = [](const CountsTable &table, const std::string &name) {
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               name);
+        REQUIRE(found != table.species.end());
+        return table.protein[found - table.species.begin()];
+    };
+    double proteins[2][2] = {{0, 0}, {0, 0}};
+    long long moves[2] = {0, 0};
+    for (int mean_field : {0, 1}) {
+        for (int seed = 1; seed <= 3; seed++) {
+            auto model = build(mean_field);
+            model->seed(seed);
+            auto table = model->SimulateToTableAt({60}, "direct");
+            proteins[mean_field][0] += count(table, "proteinX") / 3;
+            proteins[mean_field][1] += count(table, "proteinY") / 3;
+            moves[mean_field] += model->polymer_stats().moves;
+            if (mean_field) {
+                CHECK(model->polymer_stats().mean_field_ribosomes > 0);
+                CHECK(model->polymer_stats().mean_field_moves > 0);
+            } else {
+                CHECK(model->polymer_stats().mean_field_ribosomes == 0);
+            }
+        }
+    }
+    //Only proteinX is approximated, and its ribosomes take no moves
+    REQUIRE(proteins[0][0] > 100);
+    CHECK(std::abs(proteins[1][0] - proteins[0][0]) < 0.2 * proteins[0][0]);
+    CHECK(std::abs(proteins[1][1] - proteins[0][1]) < 0.2 * proteins[0][1]);
+    CHECK(moves[1] < 0.85 * moves[0]);
+
+    //Genes to approximate must exist
+    auto model = std::make_shared<Model>(8e-16);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    plasmid->MeanFieldTranslation("proteinZ");
+    REQUIRE_THROWS_AS(model->RegisterGenome(plasmid, 1),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Runs stop once the output counts are stationary")
+{
+    auto build = [](int window) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddSpecies("A", 200);
+        model->AddSpecies("X", 1);
+        model->AddReaction(1, {"A"}, {"B"});
+        model->AddReaction(1, {"B"}, {"A"});
+        //P keeps growing unless it is left out of the output
+        model->AddReaction(5, {"X"}, {"X", "P"});
+        model->steady_state(window, 0.01);
+        model->seed(5);
+        return model;
+    };
+
+    //A and B relax within seconds, but P never settles
+    auto growing = build(10);
+    auto table = growing->SimulateToTable(200, 1, "direct");
+    CHECK(table.time.back() > 199);
+    CHECK(growing->steady_state_time() == -1);
+    CHECK(table.metadata.empty());
+
+    auto relaxing = build(10);
+    relaxing->output_species({"A", "B"});
+    table = relaxing->SimulateToTable(200, 1, "direct");
+    REQUIRE(relaxing->steady_state_time() > 0);
+    CHECK(table.time.back() < 100);
+    CHECK(table.time.back() == relaxing->steady_state_time());
+    CHECK(table.metadata.at("steady_state_time") ==
+          relaxing->steady_state_time());
+    //Detection needs two full windows
+    CHECK(table.time.size() >= 20);
+
+    relaxing = build(10);
+    relaxing->output_species({"A", "B"});
+    std::vector<double> times;
+    for (int time = 0; time <= 200; time++) {
+        times.push_back(time);
+    }
+    table = relaxing->SimulateToTableAt(times, "direct");
+    CHECK(table.time.size() < times.size());
+    CHECK(table.metadata.at("steady_state_time") == table.time.back());
+
+    REQUIRE_THROWS_AS(build(1), std::invalid_argument);
+    REQUIRE_THROWS_AS(build(-1), std::invalid_argument);
+    REQUIRE_THROWS_AS(build(0)->steady_state(5, -1), std::invalid_argument);
+}
+
+TEST_CASE("Runs stop as soon as a stop condition holds")
+{
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddSpecies("X", 1);
+        model->AddSpecies("A", 100);
+        model->AddReaction(5, {"X"}, {"X", "P"});
+        model->AddReaction(0.01, {"A"}, {"B"});
+        model->seed(3);
+        return model;
+    };
+
+    auto model = build();
+    model->stop_when("P >= 50 and A > 0");
+    model->stop_when("B>1000||transcripts(gene) > 2");
+    auto table = model->SimulateToTable(200, 1, "direct");
+    REQUIRE(model->stop_time() > 0);
+    CHECK(model->stop_time() < 30);
+    CHECK(model->stop_condition() == "P >= 50 and A > 0");
+    //The run ends with the event that made the condition hold
+    CHECK(model->tracker()->species("P") == 50);
+    CHECK(table.time.back() <= model->stop_time());
+    CHECK(table.metadata.at("stop_time") == model->stop_time());
+    CHECK(table.metadata.at("stop_condition") == 0);
+
+    model = build();
+    model->stop_when("B >= 3 or P >= 1000000");
+    std::vector<double> times = {0, 100, 200, 300, 400, 500};
+    table = model->SimulateToTableAt(times, "direct");
+    REQUIRE(model->stop_time() > 0);
+    CHECK(model->stop_condition() == "B >= 3");
+    CHECK(model->tracker()->species("B") == 3);
+    CHECK(table.time.size() < times.size());
+    CHECK(table.metadata.at("stop_condition") == 0);
+
+    //A condition that already holds stops the next run before any event
+    model->SimulateToTable(1000, 1, "direct");
+    CHECK(model->stop_time() == Approx(model->time()));
+    CHECK(model->tracker()->species("B") == 3);
+
+    //Without conditions, runs continue to the end
+    model->stop_when("");
+    model->SimulateToTable(1000, 1, "direct");
+    CHECK(model->stop_time() == -1);
+    CHECK(model->time() > 999);
+
+    REQUIRE_THROWS_AS(build()->stop_when("P >="), std::invalid_argument);
+    REQUIRE_THROWS_AS(build()->stop_when("P => 5"), std::invalid_argument);
+    REQUIRE_THROWS_AS(build()->stop_when("P > 5 A < 3"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(build()->stop_when("5 < P"), std::invalid_argument);
+}
+
+TEST_CASE("Scheduled changes happen at exactly their times")
+{
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddSpecies("A", 0);
+        model->AddSpecies("X", 1);
+        model->AddReaction(0.1, {"A"}, {"B"}, "decay");
+        //Keeps the total propensity above 0 while A is absent
+        model->AddReaction(1, {"X"}, {"X", "Y"});
+        //All but stops the decay of A
+        model->ScheduleParameter(20, "decay.rate", 1e-9);
+        model->ScheduleSpecies(10, "A", 100);
+        model->ScheduleSpecies(10, "C", 5);
+        model->ScheduleSpecies(10, "C", -2);
+        model->seed(4);
+        return model;
+    };
+    auto count = [](Model &model, const std::string &name) {
+        return model.tracker()->species(name);
+    };
+
+    auto model = build();
+    model->SimulateToTableAt({9.5}, "direct");
+    CHECK(count(*model, "A") == 0);
+    REQUIRE_THROWS_AS(count(*model, "C"), std::runtime_error);
+    model->SimulateToTableAt({10}, "direct");
+    CHECK(count(*model, "A") == 100);
+    CHECK(count(*model, "C") == 3);
+    model->SimulateToTableAt({20}, "direct");
+    int decayed = count(*model, "B");
+    CHECK(decayed > 0);
+    CHECK(count(*model, "A") + decayed == 100);
+
+    //A restored checkpoint keeps the rate set at 20
+    CheckpointWriter writer;
+    model->Save(writer);
+    auto restored = build();
+    CheckpointReader reader(writer.buffer());
+    restored->Load(reader);
+    for (auto *run : {model.get(), restored.get()}) {
+        run->SimulateToTableAt({100}, "direct");
+        CHECK(count(*run, "B") == decayed);
+        CHECK(run->parameter("decay.rate") == 1e-9);
+    }
+
+    //Reset goes back to the rate before the change
+    model->Reset(4);
+    CHECK(model->parameter("decay.rate") == Approx(0.1));
+    model->SimulateToTableAt({20}, "direct");
+    CHECK(count(*model, "B") == decayed);
+
+    //Every method and the definition replay the same changes
+    auto copy = Model::LoadDefinition(build()->SaveDefinition());
+    copy->seed(4);
+    copy->SimulateToTableAt({20}, "next_reaction");
+    CHECK(count(*copy, "A") + count(*copy, "B") == 100);
+
+    REQUIRE_THROWS_AS(build()->ScheduleSpecies(-1, "A", 1),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(build()->ScheduleParameter(1, "none.rate", 1),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(build()->ScheduleParameter(1, "decay.rate", -1),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(model->ScheduleSpecies(50, "A", 1), std::runtime_error);
+}
+
+TEST_CASE("Common random numbers keep paired runs correlated")
+{
+    //P and Q are made by independent channels, only Q's depends on rate
+    auto build = [](double rate, bool common) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddSpecies("A", 1);
+        model->AddSpecies("B", 1);
+        model->AddReaction(1, {"A"}, {"A", "P"});
+        model->AddReaction(rate, {"B"}, {"B", "Q"});
+        model->common_random_numbers(common);
+        model->seed(12);
+        return model;
+    };
+    auto made = [](Model &model) {
+        return model.tracker()->species("P");
+    };
+
+    auto base = build(1, true);
+    base->SimulateToTable(100, 10, "next_reaction");
+    auto paired = build(2, true);
+    paired->SimulateToTable(100, 10, "next_reaction");
+    CHECK(made(*base) == made(*paired));
+    CHECK(paired->tracker()->species("Q") > base->tracker()->species("Q"));
+
+    base = build(1, false);
+    base->SimulateToTable(100, 10, "next_reaction");
+    paired = build(2, false);
+    paired->SimulateToTable(100, 10, "next_reaction");
+    CHECK(made(*base) != made(*paired));
+
+    //The streams are saved in checkpoints and depend on the seed
+    auto whole = build(1, true);
+    whole->SimulateToTable(100, 10, "next_reaction");
+    auto first = build(1, true);
+    first->SimulateToTable(50, 10, "next_reaction");
+    CheckpointWriter writer;
+    first->Save(writer);
+    auto second = build(1, true);
+    CheckpointReader reader(writer.buffer());
+    second->Load(reader);
+    second->SimulateToTable(100, 10, "next_reaction");
+    CHECK(made(*second) == made(*whole));
+    auto reseeded = build(1, true);
+    reseeded->seed(13);
+    reseeded->SimulateToTable(100, 10, "next_reaction");
+    CHECK(made(*reseeded) != made(*whole));
+
+    REQUIRE_THROWS_AS(build(1, true)->SimulateToTable(10, 1, "direct"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(whole->common_random_numbers(false), std::runtime_error);
+}
+
+TEST_CASE("Species batches simulate replicates in lockstep")
+{
+    //A + B -> C at a rate that consumes every B, and C -> A
+    std::vector<SpeciesBatch::Reaction> reactions = {
+        {1e-3, {0, 1}, {2}}, {0.5, {2}, {0}}};
+    SpeciesBatch batch({100, 50, 0}, {true, true, false}, reactions);
+    std::vector<Random> rngs(3);
+    std::vector<Random *> lanes;
+    for (int lane = 0; lane < 3; lane++) {
+        rngs[lane].seed(9, lane);
+        lanes.push_back(&rngs[lane]);
+    }
+    std::vector<std::vector<double>> counts(3);
+    bool produced = true;
+    auto output = [&](int lane, int time, const double *lane_counts) {
+        REQUIRE(lane < 3);
+        REQUIRE(counts[lane].size() == 3 * time);
+        for (int species = 0; species < 3; species++) {
+            counts[lane].push_back(lane_counts[species * SpeciesBatch::LANES]);
+        }
+        if (time == 0) {
+            produced = produced && !batch.appeared(2, lane);
+        }
+    };
+    long long fired = batch.Run(lanes, {0, 1, 200}, output);
+    CHECK(produced);
+    CHECK(fired > 50);
+    for (int lane = 0; lane < 3; lane++) {
+        REQUIRE(counts[lane].size() == 9);
+        //Reactions conserve A + C, and only consume B
+        for (int time = 0; time < 3; time++) {
+            CHECK(counts[lane][3 * time] + counts[lane][3 * time + 2] == 100);
+        }
+        CHECK(counts[lane][1] == 50);
+        CHECK(counts[lane][4] < 50);
+        CHECK(counts[lane][7] == 0);
+        CHECK(batch.appeared(2, lane));
+    }
+    CHECK(counts[0] != counts[1]);
+
+    //Each lane only depends on its own random numbers
+    std::vector<double> first = counts[1];
+    rngs[0].seed(9, 1);
+    counts.assign(3, std::vector<double>());
+    batch.Run({&rngs[0]}, {0, 1, 200}, output);
+    REQUIRE(counts[0] == first);
+}
+
+TEST_CASE("PropensityTree selection and updates")
+{
+    PropensityTree tree;
+    tree.PushBack(1.0);
+    tree.PushBack(0.0);
+    tree.PushBack(2.0);
+    tree.PushBack(3.0);
+    tree.PushBack(4.0);
+    REQUIRE(tree.size() == 5);
+    REQUIRE(tree.total() == 10.0);
+
+    //Find should match a bisection of the cumulative sums, and never return
+    //an index with zero weight
+    REQUIRE(tree.Find(0.0) == 0);
+    REQUIRE(tree.Find(0.999) == 0);
+    REQUIRE(tree.Find(1.0) == 2);
+    REQUIRE(tree.Find(5.5) == 3);
+    REQUIRE(tree.Find(9.999) == 4);
+
+    tree.Update(1, 5.0);
+    REQUIRE(tree.total() == 15.0);
+    REQUIRE(tree.Find(1.0) == 1);
+
+    //Erase shifts later values down; PopBack drops the last value
+    tree.Erase(0);
+    REQUIRE(tree.size() == 4);
+    REQUIRE(tree.value(0) == 5.0);
+    REQUIRE(tree.total() == 14.0);
+    tree.PopBack();
+    REQUIRE(tree.size() == 3);
+    REQUIRE(tree.total() == 10.0);
+    REQUIRE(tree.Find(9.999) == 2);
+
+    //Insert shifts later values up, growing the tree if needed
+    tree.Insert(0, 1.0);
+    tree.Insert(2, 6.0);
+    REQUIRE(tree.size() == 5);
+    REQUIRE(tree.value(1) == 5.0);
+    REQUIRE(tree.value(2) == 6.0);
+    REQUIRE(tree.total() == 17.0);
+    REQUIRE(tree.Find(6.5) == 2);
+    tree.Insert(5, 2.0);
+    REQUIRE(tree.size() == 6);
+    REQUIRE(tree.total() == 19.0);
+    REQUIRE(tree.Find(18.5) == 5);
+}
+
+TEST_CASE("PropensityBins composition-rejection selection")
+{
+    Random rng;
+    rng.seed(42);
+    PropensityBins bins;
+    bins.PushBack(1.0);
+    bins.PushBack(0.0);
+    bins.PushBack(3.0);
+    bins.PushBack(1e-3);
+    REQUIRE(bins.size() == 4);
+
+    //Values should be selected in proportion to their weights, and zero
+    //weights never selected
+    std::vector<int> counts(4, 0);
+    for (int i = 0; i < 40000; i++) {
+        counts[bins.Choose(rng)]++;
+    }
+    REQUIRE(counts[1] == 0);
+    REQUIRE(double(counts[2]) / counts[0] == Approx(3.0).epsilon(0.1));
+
+    //Moving a value between bins and removing values keeps selection valid
+    bins.Update(0, 0.0);
+    bins.Update(1, 100.0);
+    bins.PopBack();
+    REQUIRE(bins.size() == 3);
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(bins.Choose(rng) != 0);
+    }
+}
+
+TEST_CASE("IndexedPriorityQueue ordering")
+{
+    IndexedPriorityQueue queue;
+    queue.PushBack(5.0);
+    queue.PushBack(2.0);
+    queue.PushBack(8.0);
+    queue.PushBack(1.0);
+    REQUIRE(queue.top() == 3);
+
+    //Keys can move in either direction while indices stay fixed
+    queue.Update(3, 10.0);
+    REQUIRE(queue.top() == 1);
+    queue.Update(2, 0.5);
+    REQUIRE(queue.top() == 2);
+    REQUIRE(queue.key(3) == 10.0);
+
+    //PopBack removes the entry with the largest index
+    queue.PopBack();
+    REQUIRE(queue.size() == 3);
+    queue.Update(2, 20.0);
+    REQUIRE(queue.top() == 1);
+    queue.Update(1, 30.0);
+    REQUIRE(queue.top() == 0);
+}
+
+TEST_CASE("Hybrid tau-leaping conserves species")
+{
+    Model model(8e-16);
+    auto &tracker = *model.tracker();
+    model.AddSpecies("A", 100000);
+    model.AddReaction(1.0, {"A"}, {"B"});
+    model.AddReaction(1.0, {"B"}, {"A"});
+    model.Simulate(5, 5, "hybrid_test.tsv", "hybrid", "tsv");
+
+    //Leaping must never create or destroy molecules
+    REQUIRE(tracker.species("A") + tracker.species("B") == 100000);
+    REQUIRE(tracker.species("B") > 40000);
+    REQUIRE(tracker.species("B") < 60000);
+    std::remove("hybrid_test.tsv");
+}
+
+TEST_CASE("WeightedChoiceIndex skips zero weights")
+{
+    Random rng;
+    std::vector<int> population = {0, 1, 2, 3};
+    std::vector<double> weights = {0.0, 2.0, 0.0, 1.0};
+    for (int i = 0; i < 1000; i++) {
+        int index = rng.WeightedChoiceIndex(population, weights);
+        REQUIRE((index == 1 || index == 3));
+        //Weights may also be computed from each item
+        index = rng.WeightedChoiceIndex(
+            population, [](int item) { return double(item % 2); });
+        REQUIRE((index == 1 || index == 3));
+    }
+}
+
+TEST_CASE("Fast random numbers are reproducible and well distributed")
+{
+    Random rng;
+    rng.seed(11);
+    //The default generator gives the same waiting times as before
+    Random reference;
+    reference.seed(11);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(rng.exponential() == std::log(1.0 / reference.random()));
+    }
+
+    rng.fast(true);
+    rng.seed(11);
+    Random other;
+    other.fast(true);
+    other.seed(11);
+    int n = 200000;
+    double sum = 0;
+    double squares = 0;
+    int tail = 0;
+    int mismatches = 0;
+    int outside = 0;
+    for (int i = 0; i < n; i++) {
+        double x = rng.exponential();
+        mismatches += x != other.exponential();
+        outside += x < 0;
+        sum += x;
+        squares += x * x;
+        if (x > 3) {
+            tail++;
+        }
+        double u = rng.random();
+        mismatches += u != other.random();
+        outside += u < 0 || u >= 1;
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(outside == 0);
+    double mean = sum / n;
+    REQUIRE(mean == Approx(1.0).epsilon(0.01));
+    REQUIRE(squares / n - mean * mean == Approx(1.0).epsilon(0.02));
+    REQUIRE(double(tail) / n == Approx(std::exp(-3.0)).epsilon(0.03));
+
+    //A restored generator continues in the middle of a block
+    for (int i = 0; i < 37; i++) {
+        rng.random();
+    }
+    CheckpointWriter writer;
+    rng.Save(writer);
+    Random restored;
+    CheckpointReader reader(writer.buffer());
+    restored.Load(reader);
+    REQUIRE(restored.fast());
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(restored.random() == rng.random());
+        REQUIRE(restored.exponential() == rng.exponential());
+    }
+}
+
+TEST_CASE("SpeciesTracker interns species names")
+{
+    SpeciesTracker tracker;
+    int a = tracker.SpeciesId("A");
+    int b = tracker.SpeciesId("B");
+    REQUIRE(a != b);
+    REQUIRE(tracker.SpeciesId("A") == a);
+    REQUIRE(tracker.species_name(b) == "B");
+
+    //Interned names are not species until their counts are set
+    REQUIRE_THROWS(tracker.species(a));
+    tracker.Increment("A", 5);
+    tracker.Increment(a, -2);
+    REQUIRE(tracker.species(a) == 3);
+    REQUIRE(tracker.species("A") == 3);
+    REQUIRE(tracker.species().size() == 1);
+    REQUIRE_THROWS(tracker.Increment(a, -4));
+}
+
+TEST_CASE("SpeciesTracker chooses polymers by uncovered promoters")
+{
+    SpeciesTracker tracker;
+    Random rng;
+    rng.seed(3);
+    auto genome1 = std::make_shared<Genome>("one", 100);
+    auto genome2 = std::make_shared<Genome>("two", 100);
+    auto genome3 = std::make_shared<Genome>("three", 100);
+    tracker.Add("phi1", genome1);
+    tracker.Add("phi1", genome2);
+    tracker.Add("phi1", genome3);
+    //Adding a polymer twice does not change its weight
+    tracker.Add("phi1", genome1);
+    REQUIRE(tracker.FindPolymers("phi1").size() == 3);
+    tracker.IncrementUncovered("phi1", *genome1, 0, 1);
+    tracker.IncrementUncovered("phi1", *genome3, 0, 3);
+    int id = tracker.SpeciesId("phi1");
+    int chosen[3] = {0, 0, 0};
+    for (int i = 0; i < 4000; i++) {
+        auto polymer = tracker.ChoosePolymer(id, rng);
+        REQUIRE(polymer != genome2);
+        chosen[polymer == genome1 ? 0 : 2]++;
+    }
+    REQUIRE(chosen[0] > 800);
+    REQUIRE(chosen[0] < 1200);
+
+    //The last polymer takes the place of a removed one
+    tracker.Remove("phi1", *genome1);
+    REQUIRE(tracker.FindPolymers("phi1").size() == 2);
+    REQUIRE(tracker.FindPolymers("phi1")[0] == genome3);
+    REQUIRE(tracker.ChoosePolymer(id, rng) == genome3);
+    tracker.IncrementUncovered("phi1", *genome3, 0, 0);
+    tracker.IncrementUncovered("phi1", *genome2, 0, 2);
+    REQUIRE(tracker.ChoosePolymer(id, rng) == genome2);
+    tracker.Remove("phi1", *genome1);
+    REQUIRE(tracker.FindPolymers("phi1").size() == 2);
+}
+
+TEST_CASE("SpeciesTracker keeps promoter maps consistent under removal")
+{
+    SpeciesTracker tracker;
+    Random rng;
+    rng.seed(5);
+    std::vector<Genome::Ptr> genomes;
+    for (int i = 0; i < 200; i++) {
+        genomes.push_back(
+            std::make_shared<Genome>("g" + std::to_string(i), 100));
+        tracker.Add("rbs", genomes.back());
+        tracker.IncrementUncovered("rbs", *genomes.back(), 0, i % 3);
+    }
+    //Remove polymers in scrambled order, checking every slot each time
+    for (int i = 0; i < 150; i++) {
+        tracker.Remove("rbs", *genomes[(i * 7) % 200]);
+    }
+    const auto &remaining = tracker.FindPolymers("rbs");
+    REQUIRE(remaining.size() == 50);
+    std::set<const Polymer *> expected;
+    for (int i = 150; i < 200; i++) {
+        expected.insert(genomes[(i * 7) % 200].get());
+    }
+    for (const auto &polymer : remaining) {
+        REQUIRE(expected.count(polymer.get()) == 1);
+    }
+    //Moved polymers keep their weights
+    int id = tracker.SpeciesId("rbs");
+    for (int i = 0; i < 500; i++) {
+        auto polymer = tracker.ChoosePolymer(id, rng);
+        REQUIRE(expected.count(polymer.get()) == 1);
+        int index = std::find(genomes.begin(), genomes.end(), polymer) -
+                    genomes.begin();
+        REQUIRE(index % 3 != 0);
+    }
+}
+
+TEST_CASE("Models keep separate species trackers")
+{
+    Model model1(8e-16);
+    Model model2(8e-16);
+    model1.AddSpecies("A", 10);
+    model2.AddSpecies("A", 20);
+    REQUIRE(model1.tracker()->species("A") == 10);
+    REQUIRE(model2.tracker()->species("A") == 20);
+}
+
+TEST_CASE("Copies of a binding site share properties until modified")
+{
+    std::map<std::string, double> interactions = {{"__ribosome", 1e7}};
+    BindingSite site("__X_rbs", 10, 20, interactions);
+    site.gene("X");
+    BindingSite copy = site;
+    REQUIRE(copy.gene() == "X");
+    REQUIRE(copy.CheckInteraction("__ribosome"));
+
+    copy.gene("Y");
+    REQUIRE(copy.gene() == "Y");
+    REQUIRE(site.gene() == "X");
+    REQUIRE(copy.name() == "__X_rbs");
+}
+
+TEST_CASE("SiteIndex overlap and containment queries")
+{
+    std::vector<Interval<int>> intervals = {
+        Interval<int>(50, 60, 3), Interval<int>(1, 10, 1),
+        Interval<int>(5, 40, 2)};
+    SiteIndex<int> index(intervals);
+    REQUIRE(index.size() == 3);
+    REQUIRE(index.max_length() == 35);
+
+    std::vector<int> found;
+    auto collect = [&found](const int &value) { found.push_back(value); };
+    index.ForEachOverlapping(30, 50, collect);
+    REQUIRE(found == std::vector<int>{2, 3});
+
+    found.clear();
+    index.ForEachOverlapping(11, 49, collect);
+    REQUIRE(found == std::vector<int>{2});
+
+    found.clear();
+    index.ForEachContained(1, 40, collect);
+    REQUIRE(found == std::vector<int>{1, 2});
+
+    //Sites ending before the position or failing the predicate are skipped
+    auto any = [](const int &value) { return true; };
+    REQUIRE(index.FindEnding(8, any) == 0);
+    REQUIRE(index.FindEnding(11, any) == 1);
+    REQUIRE(index.start(1) == 5);
+    REQUIRE(index.stop(1) == 40);
+    auto odd = [](const int &value) { return value % 2 == 1; };
+    REQUIRE(index.FindEnding(11, odd) == 2);
+    REQUIRE(index.FindEnding(61, any) == index.size());
+}
+
+TEST_CASE("Interactions can be checked by interned element ID")
+{
+    REQUIRE(InternedName::Id("__ribosome") == InternedName::RIBOSOME);
+    REQUIRE(InternedName::Id("") == InternedName::NONE);
+    int rnapol = InternedName::Id("rnapol");
+    REQUIRE(InternedName::Id("rnapol") == rnapol);
+
+    auto ribosome = Polymerase("__ribosome", 10, 30);
+    auto polymerase = Polymerase("rnapol", 10, 40);
+    REQUIRE(ribosome.kind() == ElementKind::RIBOSOME);
+    REQUIRE(polymerase.kind() == ElementKind::POLYMERASE);
+    REQUIRE(polymerase.type_id() == rnapol);
+
+    ReleaseSite terminator("t1", 10, 20, {{"rnapol", 0.5}});
+    REQUIRE(terminator.CheckInteraction(rnapol, 0));
+    REQUIRE_FALSE(terminator.CheckInteraction(InternedName::RIBOSOME, 0));
+    REQUIRE(terminator.efficiency(rnapol) == 0.5);
+    REQUIRE(terminator.efficiency(InternedName::Id("ecolipol")) == 0.0);
+}
+
+TEST_CASE("MemoryPool reuses freed blocks")
+{
+    auto pool = std::make_shared<MemoryPool>();
+    auto pol = MakePooled<Polymerase>(pool, "rnapol", 10, 40);
+    REQUIRE(pol->name() == "rnapol");
+    REQUIRE(pool->reserved() > 0);
+    Polymerase *address = pol.get();
+    pol.reset();
+    // A freed block of the same size is handed out again
+    auto pol2 = MakePooled<Polymerase>(pool, "rnapol", 10, 40);
+    REQUIRE(pol2.get() == address);
+    // Objects keep their pool alive
+    pool.reset();
+    REQUIRE(pol2->footprint() == 10);
+
+    auto unpooled = MakePooled<Polymerase>(MemoryPool::Ptr(), "rnapol", 10, 40);
+    REQUIRE(unpooled->speed() == 40);
+}
+
+TEST_CASE("Each affected reaction is recomputed once per event")
+{
+    Model model(8e-16);
+    model.AddSpecies("A", 1000);
+    model.AddSpecies("B", 1000);
+    //A + B -> C changes both reactants, and each change affects the
+    //reaction itself as well as C -> A + B
+    model.AddReaction(1e6, {"A", "B"}, {"C"});
+    model.AddReaction(1.0, {"C"}, {"A", "B"});
+    model.Simulate(1, 1, "dirty_test.tsv", "direct", "tsv");
+
+    auto stats = model.stats();
+    REQUIRE(stats.redundant_updates > 0);
+    REQUIRE(model.tracker()->species("A") == model.tracker()->species("B"));
+    std::remove("dirty_test.tsv");
+}
+
+TEST_CASE("Reactions with zero propensity drop out of selection")
+{
+    for (std::string method : {"direct", "direct_linear", "next_reaction"}) {
+        Model model(8e-16);
+        model.AddSpecies("A", 1000);
+        model.AddReaction(10.0, {"A"}, {"B"});
+        model.AddReaction(10.0, {"B"}, {"A"});
+        //C only appears once A has been converted, and D never does
+        model.AddReaction(1e-2, {"A"}, {"C"});
+        model.AddReaction(1e-3, {"C"}, {"A"});
+        model.AddReaction(1.0, {"D"}, {"A"});
+        model.seed(7);
+        model.SimulateToTable(1e-3, 1e-3, method);
+        REQUIRE(model.reaction_count() == 5);
+        REQUIRE(model.active_reactions() == 2);
+        model.SimulateToTable(10, 1, method);
+        REQUIRE(model.tracker()->species("C") > 0);
+        REQUIRE(model.active_reactions() == 4);
+        REQUIRE(model.tracker()->species("A") + model.tracker()->species("B") +
+                    model.tracker()->species("C") ==
+                1000);
+        REQUIRE(model.tracker()->species("B") > 400);
+        REQUIRE(model.tracker()->species("B") < 600);
+    }
+}
+
+TEST_CASE("Events are counted by reaction class")
+{
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 2);
+    model.AddRibosome(10, 30, 5);
+    model.AddSpecies("A", 10);
+    model.AddReaction(1.0, {"A"}, {"B"});
+    auto plasmid = std::shared_ptr<Genome>(
+        new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t0", 250, 251, {{"rnapol", 0.5}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e7);
+    model.RegisterGenome(plasmid);
+    model.seed(5);
+    model.SimulateToTable(200, 10, "direct");
+    const auto &stats = model.stats();
+    const auto &polymers = model.polymer_stats();
+    REQUIRE(stats.events[Reaction::SPECIES] == 10);
+    REQUIRE(stats.events[Reaction::BIND_POLYMERASE] > 0);
+    REQUIRE(stats.events[Reaction::BIND_RNASE] > 0);
+    //Every polymer event is either a move or a blocked move
+    REQUIRE(stats.events[Reaction::POLYMER] ==
+            polymers.moves + polymers.polymerase_collisions +
+                polymers.mask_collisions);
+    REQUIRE(polymers.readthroughs > 0);
+    REQUIRE(polymers.transcripts_created > 0);
+    REQUIRE(polymers.transcripts_destroyed > 0);
+    REQUIRE(polymers.transcripts_destroyed <= polymers.transcripts_created);
+    REQUIRE(model.timings().simulate >= 0);
+}
+
+TEST_CASE("Elements run ahead without changing the simulated distribution")
+{
+    auto build = [](bool run_ahead, int seed) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 2);
+        model->AddRibosome(10, 30, 5);
+        auto plasmid = std::shared_ptr<Genome>(
+            new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t0", 250, 251, {{"rnapol", 0.5}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e7);
+        model->RegisterGenome(plasmid);
+        model->run_ahead(run_ahead);
+        model->seed(seed);
+        return model;
+    };
+    auto protein = [](const CountsTable &table) {
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               "proteinX");
+        return found == table.species.end()
+                   ? 0.0
+                   : table.protein[found - table.species.begin()];
+    };
+    auto transcript = [](const CountsTable &table) {
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               "proteinX");
+        return found == table.species.end()
+                   ? 0.0
+                   : table.transcript[found - table.species.begin()];
+    };
+
+    int replicates = 30;
+    double mean[2] = {0, 0};
+    double transcripts[2] = {0, 0};
+    long long events[2] = {0, 0};
+    for (bool run_ahead : {false, true}) {
+        for (int seed = 0; seed < replicates; seed++) {
+            auto model = build(run_ahead, seed);
+            auto table = model->SimulateToTableAt({100}, "direct");
+            mean[run_ahead] += protein(table) / replicates;
+            transcripts[run_ahead] += transcript(table) / replicates;
+            events[run_ahead] += model->stats().events[Reaction::POLYMER];
+            const auto &polymers = model->polymer_stats();
+            REQUIRE((polymers.runs > 0) == run_ahead);
+            REQUIRE(model->stats().scheduled <= polymers.runs);
+        }
+    }
+    //Protein counts have a standard deviation of about 3
+    REQUIRE(mean[0] > 20);
+    REQUIRE(std::abs(mean[1] - mean[0]) < 2.5);
+    //RNases running out degraded tails leave as many transcripts intact
+    REQUIRE(transcripts[0] > 1);
+    REQUIRE(std::abs(transcripts[1] - transcripts[0]) <
+            0.25 * transcripts[0]);
+    REQUIRE(events[1] * 3 < events[0]);
+}
+
+TEST_CASE("Sparse events still write every output time")
+{
+    //One polymerase running ahead leaves seconds between events
+    auto build = [](int mode, int seed) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 1);
+        model->AddRibosome(10, 30, 1);
+        auto plasmid = std::make_shared<Genome>("T7", 305);
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+        if (mode == 2) {
+            plasmid->MeanFieldTranslation("proteinX");
+        }
+        model->RegisterGenome(plasmid);
+        model->run_ahead(mode == 0);
+        model->skip_blocked(mode == 1);
+        model->seed(seed);
+        return model;
+    };
+    for (int mode = 0; mode < 3; mode++) {
+        for (int seed = 1; seed <= 3; seed++) {
+            auto model = build(mode, seed);
+            auto table = model->SimulateToTable(10, 2, "direct");
+            REQUIRE(table.time ==
+                    std::vector<double>({0, 2, 4, 6, 8, 10}));
+            //Continuing starts at the next time step
+            table = model->SimulateToTable(14, 2, "direct");
+            REQUIRE(table.time == std::vector<double>({12, 14}));
+        }
+    }
+}
+
+TEST_CASE("Ribosomes stepping by codon translate in fewer events")
+{
+    auto build = [](bool codon_steps, int seed) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 2);
+        model->AddRibosome(10, 30, 5);
+        auto plasmid = std::shared_ptr<Genome>(
+            new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e7);
+        model->RegisterGenome(plasmid);
+        model->codon_steps(codon_steps);
+        model->seed(seed);
+        return model;
+    };
+
+    int replicates = 30;
+    double mean[2] = {0, 0};
+    long long events[2] = {0, 0};
+    long long moves[2] = {0, 0};
+    for (bool codon_steps : {false, true}) {
+        for (int seed = 0; seed < replicates; seed++) {
+            auto model = build(codon_steps, seed);
+            auto table = model->SimulateToTableAt({100}, "direct");
+            auto found = std::find(table.species.begin(),
+                                   table.species.end(), "proteinX");
+            REQUIRE(found != table.species.end());
+            mean[codon_steps] +=
+                table.protein[found - table.species.begin()] / replicates;
+            events[codon_steps] += model->stats().events[Reaction::POLYMER];
+            moves[codon_steps] += model->polymer_stats().moves;
+        }
+    }
+    //Ribosomes keep their speed, so translate as much in fewer events;
+    //about half of the moves are polymerase moves, which are unchanged
+    REQUIRE(mean[0] > 20);
+    REQUIRE(std::abs(mean[1] - mean[0]) < 2.5);
+    REQUIRE(std::abs(moves[1] - moves[0]) < moves[0] / 10);
+    REQUIRE(events[1] * 4 < events[0] * 3);
+
+    //Stepping by codon is part of the model definition
+    auto model = build(true, 3);
+    auto clone = model->Clone();
+    clone->seed(3);
+    REQUIRE(clone->SimulateToTableAt({50}, "direct").protein ==
+            model->SimulateToTableAt({50}, "direct").protein);
+}
+
+TEST_CASE("Observers see every event without changing the simulation")
+{
+    struct Counter : public Observer {
+        long long events = 0;
+        long long binds = 0;
+        long long moves = 0;
+        long long blocked = 0;
+        long long terminations = 0;
+        long long degraded = 0;
+        double last = 0;
+        bool ordered = true;
+        void OnEvent(double time, const Reaction &reaction) override {
+            events++;
+            ordered = ordered && time >= last;
+            last = time;
+        }
+        void OnBind(double time, const Polymer &polymer,
+                    const MobileElement &element) override {
+            binds++;
+        }
+        void OnMove(double time, const Polymer &polymer,
+                    const MobileElement &element) override {
+            moves++;
+        }
+        void OnBlocked(double time, const Polymer &polymer,
+                       const MobileElement &element) override {
+            blocked++;
+        }
+        void OnTerminate(double time, const Polymer &polymer,
+                         const MobileElement &element) override {
+            terminations++;
+        }
+        void OnDegrade(double time, const Polymer &polymer) override {
+            degraded++;
+        }
+    };
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 10, 2);
+        model->AddRibosome(10, 100, 50);
+        auto plasmid = std::shared_ptr<Genome>(
+            new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e9);
+        model->RegisterGenome(plasmid);
+        model->seed(5);
+        return model;
+    };
+    auto plain = build();
+    auto plain_table = plain->SimulateToTableAt({60}, "direct");
+    auto model = build();
+    auto counter = std::make_shared<Counter>();
+    model->AddObserver(counter);
+    auto table = model->SimulateToTableAt({60}, "direct");
+    REQUIRE(table.protein == plain_table.protein);
+
+    long long events = 0;
+    for (long long count : model->stats().events) {
+        events += count;
+    }
+    REQUIRE(counter->events == events);
+    REQUIRE(counter->ordered);
+    REQUIRE(counter->moves == model->polymer_stats().moves);
+    REQUIRE(counter->blocked == model->polymer_stats().polymerase_collisions +
+                                    model->polymer_stats().mask_collisions);
+    REQUIRE(counter->binds > 0);
+    REQUIRE(counter->terminations > 0);
+    REQUIRE(counter->terminations <= counter->binds);
+    REQUIRE(counter->degraded > 0);
+
+    //Removed observers hear nothing more
+    model->RemoveObservers();
+    long long seen = counter->events;
+    model->SimulateToTableAt({80}, "direct");
+    REQUIRE(counter->events == seen);
+}
+
+TEST_CASE("Memory reports follow the objects of a model")
+{
+    auto model = std::make_shared<Model>(8e-16);
+    model->AddPolymerase("rnapol", 10, 10, 2);
+    model->AddRibosome(10, 100, 50);
+    auto plasmid = std::shared_ptr<Genome>(
+        new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e9);
+    model->RegisterGenome(plasmid);
+    model->seed(5);
+    model->memory_sampling(true);
+
+    MemoryReport before = model->memory_report();
+    REQUIRE(before.usage().at("genomes").objects == 1);
+    REQUIRE(before.usage().count("transcripts") == 0);
+    REQUIRE(before.total() > 0);
+
+    auto table = model->SimulateToTableAt({10, 20}, "direct");
+    MemoryReport after = model->memory_report();
+    REQUIRE(after.usage().at("genomes").objects == 1);
+    REQUIRE(after.usage().at("transcripts").objects > 0);
+    REQUIRE(after.usage().at("elements").objects > 0);
+    REQUIRE(after.usage().at("tracker").objects > 0);
+    REQUIRE(after.total() > before.total());
+    REQUIRE(after.pool_reserved() > 0);
+
+    // Samples are written after each time point, the last one being the
+    // state at the end of the run
+    REQUIRE(table.metadata.at("memory_total") == after.total());
+    REQUIRE(table.metadata.at("memory_transcripts") ==
+            after.usage().at("transcripts").bytes);
+}
+
+TEST_CASE("Blocked elements wait instead of spending events")
+{
+    //Fast ribosomes queue up behind the mask of a slow polymerase and
+    //behind each other
+    auto build = [](bool skip_blocked, bool run_ahead, int seed) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 10, 2);
+        model->AddRibosome(10, 100, 50);
+        auto plasmid = std::shared_ptr<Genome>(
+            new Genome("T7", 305, 1e-2, 20, 9, 1e-2));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 30, 225, 20, 30, 1e9);
+        model->RegisterGenome(plasmid);
+        model->skip_blocked(skip_blocked);
+        model->run_ahead(run_ahead);
+        model->seed(seed);
+        return model;
+    };
+
+    int replicates = 12;
+    double mean[3] = {0, 0, 0};
+    long long events[3] = {0, 0, 0};
+    long long moves[3] = {0, 0, 0};
+    for (int mode = 0; mode < 3; mode++) {
+        for (int seed = 0; seed < replicates; seed++) {
+            auto model = build(mode > 0, mode == 2, seed);
+            auto table = model->SimulateToTableAt({40}, "direct");
+            auto found = std::find(table.species.begin(),
+                                   table.species.end(), "proteinX");
+            REQUIRE(found != table.species.end());
+            mean[mode] +=
+                table.protein[found - table.species.begin()] / replicates;
+            events[mode] += model->stats().events[Reaction::POLYMER];
+            moves[mode] += model->polymer_stats().moves;
+        }
+    }
+    //The same moves are taken, without the events that were blocked
+    REQUIRE(mean[0] > 20);
+    REQUIRE(std::abs(mean[1] - mean[0]) < mean[0] / 10);
+    REQUIRE(std::abs(mean[2] - mean[0]) < mean[0] / 10);
+    REQUIRE(std::abs(moves[1] - moves[0]) < moves[0] / 10);
+    REQUIRE(events[1] * 4 < events[0] * 3);
+
+    //Waiting is part of the model definition, and can be switched off
+    auto model = build(true, false, 3);
+    auto clone = model->Clone();
+    clone->seed(3);
+    REQUIRE(clone->SimulateToTableAt({50}, "direct").protein ==
+            model->SimulateToTableAt({50}, "direct").protein);
+    model->skip_blocked(false);
+    model->SimulateToTableAt({60}, "direct");
+}
+
+TEST_CASE("CompensatedSum does not drift under many small updates")
+{
+    CompensatedSum sum(1e6);
+    double naive = 1e6;
+    for (int i = 0; i < 1000000; i++) {
+        sum.Add(0.1);
+        naive += 0.1;
+    }
+    for (int i = 0; i < 1000000; i++) {
+        sum.Add(-0.1);
+        naive -= 0.1;
+    }
+    REQUIRE(sum.value() == 1e6);
+    REQUIRE(naive != 1e6);
+}
+
+TEST_CASE("Cloned models and ensembles simulate independently")
+{
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 1);
+    model.AddRibosome(10, 30, 1);
+    auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    model.RegisterGenome(plasmid);
+
+    //A seeded clone reproduces its template exactly
+    auto clone = model.Clone();
+    clone->seed(7);
+    auto cloned = clone->SimulateToTable(20, 1, "direct");
+    REQUIRE(cloned.species.size() > 0);
+    model.seed(7);
+    auto original = model.SimulateToTable(20, 1, "direct");
+    REQUIRE(cloned.time == original.time);
+    REQUIRE(cloned.protein == original.protein);
+    REQUIRE(cloned.transcript == original.transcript);
+
+    //Replicates with the same seed agree, whichever thread runs them
+    std::vector<CountsTable> tables(4);
+    model.SimulateEnsemble(4, {7, 7, 8, 7}, 2, [&](int i, Model &replicate) {
+        tables[i] = replicate.SimulateToTable(20, 1, "direct");
+    });
+    REQUIRE(tables[0].protein == original.protein);
+    REQUIRE(tables[1].protein == original.protein);
+    REQUIRE(tables[3].protein == original.protein);
+    REQUIRE(tables[2].time != original.time);
+
+    //A shared seed gives each replicate its own stream
+    model.SimulateEnsemble(2, {7}, 2, [&](int i, Model &replicate) {
+        tables[i] = replicate.SimulateToTable(20, 1, "direct");
+    });
+    REQUIRE(tables[0].protein == original.protein);
+    REQUIRE(tables[1].time != original.time);
+
+    //A worker resets its instance for each replicate it takes
+    std::vector<const Model *> instances(3);
+    model.SimulateEnsemble(3, {8, 7, 7}, 1, [&](int i, Model &replicate) {
+        instances[i] = &replicate;
+        tables[i] = replicate.SimulateToTable(20, 1, "direct");
+    });
+    REQUIRE(instances[0] == instances[2]);
+    REQUIRE(tables[1].protein == original.protein);
+    REQUIRE(tables[2].protein == original.protein);
+    REQUIRE(tables[2].time == original.time);
+
+    //Instances of one compiled model reproduce the template too
+    auto compiled = model.Compile();
+    auto first = compiled->Instantiate();
+    auto second = compiled->Instantiate();
+    REQUIRE(first->Compile() == compiled);
+    first->seed(7);
+    second->seed(7);
+    REQUIRE(first->SimulateToTable(20, 1, "direct").protein ==
+            original.protein);
+    REQUIRE(second->SimulateToTable(20, 1, "direct").protein ==
+            original.protein);
+
+    //Cloned genomes share the properties of their elements
+    auto copy = plasmid->Clone();
+    const auto &sites = plasmid->GetBindingIntervals();
+    const auto &copied = copy->GetBindingIntervals();
+    REQUIRE(copied.size() == sites.size());
+    REQUIRE(copied[0].value != sites[0].value);
+    REQUIRE(&copied[0].value->name() == &sites[0].value->name());
+    copy->AddPromoter("phi2", 100, 110, {{"rnapol", 2e8}});
+    REQUIRE(copy->GetBindingIntervals().size() == sites.size() + 1);
+    REQUIRE(plasmid->Clone()->GetBindingIntervals().size() == sites.size());
+
+    REQUIRE_THROWS_AS(
+        model.SimulateEnsemble(3, {1, 2}, 1, [](int, Model &) {}),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        model.SimulateEnsemble(2, {}, 2, [](int, Model &) {
+            throw std::runtime_error("replicate failed");
+        }),
+        std::runtime_error);
+}
+
+TEST_CASE("Reset models rerun replicates exactly")
+{
+    auto build = [](int seed) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 2);
+        model->AddRibosome(10, 30, 2);
+        auto plasmid = std::shared_ptr<Genome>(
+            new Genome("T7", 305, 0.0, 20, 10, 1e-1));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+        plasmid->AddRnaseSite(150, 160);
+        model->RegisterGenome(plasmid);
+        model->seed(seed);
+        return model;
+    };
+
+    for (std::string method : {"direct", "next_reaction", "hybrid"}) {
+        auto model = build(3);
+        auto first = model->SimulateToTable(60, 1, method);
+        REQUIRE(model->polymer_stats().transcripts_created > 0);
+
+        //Rerunning with the same seed repeats the trajectory
+        model->Reset(3);
+        REQUIRE(model->polymer_stats().transcripts_created == 0);
+        auto again = model->SimulateToTable(60, 1, method);
+        REQUIRE(again.species == first.species);
+        REQUIRE(again.time == first.time);
+        REQUIRE(again.protein == first.protein);
+        REQUIRE(again.transcript == first.transcript);
+
+        //Another seed matches a freshly built model
+        model->Reset(4);
+        auto other = model->SimulateToTable(60, 1, method);
+        auto fresh = build(4)->SimulateToTable(60, 1, method);
+        REQUIRE(other.species == fresh.species);
+        REQUIRE(other.time == fresh.time);
+        REQUIRE(other.protein == fresh.protein);
+    }
+
+    auto recorded = build(3);
+    recorded->RecordOccupancy();
+    REQUIRE_THROWS_AS(recorded->Reset(3), std::runtime_error);
+}
+
+TEST_CASE("Parameters change rates without rebuilding the model")
+{
+    auto model = std::make_shared<Model>(8e-16);
+    model->AddPolymerase("rnapol", 10, 40, 2);
+    model->AddRibosome(10, 30, 2);
+    model->AddSpecies("a", 100);
+    model->AddReaction(0.1, {"a"}, {"b"}, "decay");
+    auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    model->RegisterGenome(plasmid);
+    model->seed(5);
+    auto final_count = [](const CountsTable &table, const std::string &name) {
+        auto found = std::find(table.species.begin(), table.species.end(),
+                               name);
+        if (found == table.species.end()) {
+            return 0.0;
+        }
+        std::size_t column = found - table.species.begin();
+        return table.protein[(table.time.size() - 1) * table.species.size() +
+                             column];
+    };
+
+    //Parameters report the values the model was built with
+    REQUIRE(model->parameter("phi1.rnapol") == 2e8);
+    REQUIRE(model->parameter("proteinX.rbs") == 1e7);
+    REQUIRE(model->parameter("t1.rnapol") == 1.0);
+    REQUIRE(model->parameter("rnapol.speed") == 40);
+    REQUIRE(model->parameter("ribosome.speed") == 30);
+    REQUIRE(model->parameter("decay.rate") == 0.1);
+    REQUIRE_THROWS_AS(model->parameter("phi2.rnapol"), std::invalid_argument);
+    REQUIRE_THROWS_AS(model->parameter("phi1.ecolipol"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(model->parameter("decay.rate", -1),
+                      std::invalid_argument);
+
+    //A parameter set before simulating takes effect when reactions are built
+    model->parameter("phi1.rnapol", 0);
+    model->parameter("decay.rate", 0.05);
+    auto silent = model->SimulateToTable(30, 1, "direct");
+    REQUIRE(final_count(silent, "proteinX") == 0);
+    REQUIRE(final_count(silent, "a") < 60);
+    REQUIRE(model->polymer_stats().transcripts_created == 0);
+
+    //Reset keeps parameters and later ones update the running model
+    model->Reset(5);
+    model->parameter("phi1.rnapol", 2e8);
+    model->parameter("decay.rate", 1e-9);
+    auto expressed = model->SimulateToTable(30, 1, "direct");
+    REQUIRE(final_count(expressed, "proteinX") > 0);
+    REQUIRE(final_count(expressed, "a") == 100);
+    model->Reset(5);
+    auto again = model->SimulateToTable(30, 1, "direct");
+    REQUIRE(again.time == expressed.time);
+    REQUIRE(again.protein == expressed.protein);
+
+    //Clones are compiled with the values set so far
+    model->parameter("ribosome.speed", 0);
+    model->parameter("t1.rnapol", 0.5);
+    auto clone = model->Clone();
+    REQUIRE(clone->parameter("phi1.rnapol") == 2e8);
+    REQUIRE(clone->parameter("ribosome.speed") == 0);
+    REQUIRE(clone->parameter("t1.rnapol") == 0.5);
+    clone->seed(5);
+    REQUIRE(final_count(clone->SimulateToTable(30, 1, "direct"),
+                        "proteinX") == 0);
+    //Terminators of the clone do not share the changed efficiency
+    model->parameter("t1.rnapol", 0.25);
+    REQUIRE(clone->parameter("t1.rnapol") == 0.5);
+
+    //Speeds need not be whole; ribosomes take about 220 s over the gene
+    model->parameter("t1.rnapol", 1.0);
+    model->parameter("ribosome.speed", 0.9);
+    model->Reset(5);
+    REQUIRE(model->parameter("ribosome.speed") == 0.9);
+    REQUIRE(final_count(model->SimulateToTable(400, 400, "direct"),
+                        "proteinX") > 0);
+}
+
+TEST_CASE("Restored checkpoints continue the simulation exactly")
+{
+    auto build = [](bool run_ahead) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 1);
+        model->AddRibosome(10, 30, 1);
+        auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+        model->RegisterGenome(plasmid);
+        model->run_ahead(run_ahead);
+        model->seed(11);
+        return model;
+    };
+
+    for (bool run_ahead : {false, true})
+    for (std::string method :
+         {"direct", "composition_rejection", "next_reaction", "hybrid"}) {
+        auto whole = build(run_ahead)->SimulateToTable(40, 1, method);
+
+        auto first = build(run_ahead);
+        auto before = first->SimulateToTable(20, 1, method);
+        CheckpointWriter writer;
+        first->Save(writer);
+        auto second = build(run_ahead);
+        CheckpointReader reader(writer.buffer());
+        second->Load(reader);
+        auto resumed = second->SimulateToTable(40, 1, method);
+
+        //The resumed run reports the time points after the checkpoint
+        INFO(method << (run_ahead ? " with run-ahead" : ""));
+        std::size_t offset = before.time.size();
+        REQUIRE(offset + resumed.time.size() == whole.time.size());
+        REQUIRE(std::equal(resumed.time.begin(), resumed.time.end(),
+                           whole.time.begin() + offset));
+        std::size_t width = whole.species.size();
+        for (std::size_t column = 0; column < resumed.species.size();
+             column++) {
+            auto found = std::find(whole.species.begin(), whole.species.end(),
+                                   resumed.species[column]);
+            REQUIRE(found != whole.species.end());
+            std::size_t whole_column = found - whole.species.begin();
+            for (std::size_t row = 0; row < resumed.time.size(); row++) {
+                std::size_t i = row * resumed.species.size() + column;
+                std::size_t j = (row + offset) * width + whole_column;
+                REQUIRE(resumed.protein[i] == whole.protein[j]);
+                REQUIRE(resumed.transcript[i] == whole.transcript[j]);
+                REQUIRE(resumed.ribo_density[i] == whole.ribo_density[j]);
+            }
+        }
+    }
+
+    //Checkpoints only restore into a fresh model with the same definition
+    auto model = build(false);
+    CheckpointWriter writer;
+    model->Save(writer);
+    CheckpointReader reader(writer.buffer());
+    REQUIRE_THROWS_AS(model->Load(reader), std::runtime_error);
+    Model other(8e-16);
+    CheckpointReader other_reader(writer.buffer());
+    REQUIRE_THROWS_AS(other.Load(other_reader), std::runtime_error);
+}
+
+TEST_CASE("Forks continue independently from a shared state")
+{
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 1);
+    model.AddRibosome(10, 30, 1);
+    auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    model.RegisterGenome(plasmid);
+    model.seed(3);
+    model.SimulateToTable(20, 1, "direct");
+
+    auto forks = model.Fork(3, {5, 5, 6});
+    REQUIRE(forks.size() == 3);
+    std::vector<CountsTable> tables;
+    for (auto &fork : forks) {
+        tables.push_back(fork->SimulateToTable(40, 1, "direct"));
+        REQUIRE(tables.back().time.front() >= 20);
+    }
+    REQUIRE(tables[0].time == tables[1].time);
+    REQUIRE(tables[0].protein == tables[1].protein);
+    REQUIRE(tables[0].time != tables[2].time);
+
+    //Reseeding the original the same way reproduces a fork
+    model.seed(5);
+    auto original = model.SimulateToTable(40, 1, "direct");
+    REQUIRE(original.time == tables[0].time);
+    REQUIRE(original.protein == tables[0].protein);
+
+    REQUIRE_THROWS_AS(model.Fork(2, {1, 2, 3}), std::invalid_argument);
+}
+
+TEST_CASE("EnsembleStats summarizes replicates as they are added")
+{
+    RunningStats moments;
+    QuantileSketch median(0.5);
+    QuantileSketch upper(0.9);
+    for (int i = 1000; i >= 1; i--) {
+        moments.Add(i);
+        median.Add(i);
+        upper.Add(i);
+    }
+    REQUIRE(moments.mean == Approx(500.5));
+    REQUIRE(moments.variance() == Approx(83416.67));
+    REQUIRE(moments.min == 1);
+    REQUIRE(moments.max == 1000);
+    REQUIRE(median.value() == Approx(500.5).epsilon(0.01));
+    REQUIRE(upper.value() == Approx(900).epsilon(0.01));
+    //Small samples are exact
+    QuantileSketch small(0.5);
+    small.Add(3);
+    small.Add(1);
+    REQUIRE(small.value() == 2);
+    REQUIRE_THROWS_AS(QuantileSketch(1.5), std::invalid_argument);
+
+    //The second replicate lacks species "b" and reports time 1 late
+    CountsTable first;
+    first.time = {0, 1};
+    first.species = {"a", "b"};
+    first.protein = {1, 2, 3, 4};
+    first.transcript = {0, 0, 1, 1};
+    first.ribo_density = {0, 0, 0, 0};
+    CountsTable second;
+    second.time = {0, 1.5, 2};
+    second.species = {"a"};
+    second.protein = {3, 5, 7};
+    second.transcript = {0, 1, 1};
+    second.ribo_density = {0, 0, 0};
+
+    EnsembleStats stats(1, {0.5});
+    stats.Add(first);
+    stats.Add(second);
+    auto summary = stats.Summary();
+    REQUIRE(summary.time == std::vector<double>({0, 1, 2}));
+    REQUIRE(summary.species == std::vector<std::string>({"a", "b"}));
+    REQUIRE(summary.replicates == std::vector<double>({2, 2, 1}));
+    REQUIRE(summary.protein.mean == std::vector<double>({2, 1, 4, 2, 7, 0}));
+    REQUIRE(summary.protein.variance[0] == 2);
+    REQUIRE(summary.protein.min[1] == 0);
+    REQUIRE(summary.protein.max[1] == 2);
+    REQUIRE(summary.protein.quantiles[2] == 4);
+    REQUIRE(summary.transcript.mean[2] == 1);
+
+    //Statistics gathered separately merge into those of the whole ensemble
+    EnsembleStats both(1);
+    both.Add(first);
+    both.Add(second);
+    EnsembleStats part(1);
+    part.Add(second);
+    CheckpointWriter writer;
+    part.Save(writer);
+    CheckpointReader reader(writer.buffer());
+    EnsembleStats sent(1);
+    sent.Load(reader);
+    EnsembleStats merged(1);
+    merged.Add(first);
+    merged.Merge(sent);
+    auto expected = both.Summary();
+    auto combined = merged.Summary();
+    REQUIRE(combined.time == expected.time);
+    REQUIRE(combined.species == expected.species);
+    REQUIRE(combined.replicates == expected.replicates);
+    REQUIRE(combined.protein.mean == expected.protein.mean);
+    REQUIRE(combined.protein.variance == expected.protein.variance);
+    REQUIRE(combined.protein.min == expected.protein.min);
+    REQUIRE(combined.transcript.max == expected.transcript.max);
+    REQUIRE_THROWS_AS(stats.Merge(sent), std::logic_error);
+    REQUIRE_THROWS_AS(stats.Save(writer), std::logic_error);
+}
+
+TEST_CASE("Counts are recorded at exact output times")
+{
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 1);
+        model->AddRibosome(10, 30, 1);
+        auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+        model->RegisterGenome(plasmid);
+        model->seed(19);
+        return model;
+    };
+    std::vector<double> times;
+    for (int i = 0; i <= 30; i++) {
+        times.push_back(std::pow(10.0, i / 20.0) - 1);
+    }
+
+    for (std::string method : {"direct", "composition_rejection",
+                               "next_reaction", "hybrid"}) {
+        INFO(method);
+        auto table = build()->SimulateToTableAt(times, method);
+        REQUIRE(table.time == times);
+        if (method == "hybrid") {
+            continue;
+        }
+        //Stopping at output times does not change the trajectory
+        auto coarse = build()->SimulateToTableAt({0, times.back()}, method);
+        std::size_t width = table.species.size();
+        REQUIRE(coarse.species == table.species);
+        REQUIRE(std::equal(coarse.protein.end() - width, coarse.protein.end(),
+                           table.protein.end() - width));
+        REQUIRE(std::equal(coarse.transcript.end() - width,
+                           coarse.transcript.end(),
+                           table.transcript.end() - width));
+    }
+
+    //Nor does it when elements run ahead, whose scheduled run ends
+    //discard events drawn past them
+    auto ahead = [&build](const std::vector<double> &at) {
+        auto model = build();
+        model->run_ahead(true);
+        return model->SimulateToTableAt(at, "direct");
+    };
+    auto stopped = ahead(times);
+    auto coarse = ahead({0, times.back()});
+    std::size_t width = stopped.species.size();
+    REQUIRE(coarse.species == stopped.species);
+    REQUIRE(std::equal(coarse.protein.end() - width, coarse.protein.end(),
+                       stopped.protein.end() - width));
+
+    auto model = build();
+    REQUIRE_THROWS_AS(model->SimulateToTableAt({2, 1}, "direct"),
+                      std::invalid_argument);
+    model->SimulateToTableAt({5}, "direct");
+    REQUIRE_THROWS_AS(model->SimulateToTableAt({4}, "direct"),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Output can be restricted to selected species")
+{
+    auto tracker = std::make_shared<SpeciesTracker>();
+    tracker->Increment("proteinX", 1);
+    tracker->Increment("proteinY", 2);
+    tracker->Increment("__promoter", 1);
+    tracker->Increment("rnapol", 3);
+    std::vector<SpeciesTracker::Counts> rows;
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 4);
+
+    tracker->output_species({"protein?", "rna*"});
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 3);
+    REQUIRE(tracker->species_name(rows[0].species_id) == "proteinX");
+    REQUIRE(tracker->species_name(rows[2].species_id) == "rnapol");
+
+    //Species added later are matched too
+    tracker->output_species({"*Z", "proteinX"});
+    tracker->Increment("proteinZ", 1);
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 2);
+    REQUIRE(rows[1].protein == 1);
+
+    tracker->output_species({});
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 5);
+}
+
+TEST_CASE("Output rows follow counts between samples")
+{
+    auto tracker = std::make_shared<SpeciesTracker>();
+    tracker->Increment("A", 1);
+    tracker->IncrementTranscript("geneB", 2);
+    std::vector<SpeciesTracker::Counts> rows;
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 2);
+    REQUIRE(rows[1].ribo_density == 0);
+
+    //Rows already reported are updated in place
+    tracker->Increment("A", 4);
+    tracker->IncrementTranscript("geneB", 2);
+    tracker->GatherCounts(rows);
+    REQUIRE(rows[0].protein == 5);
+    REQUIRE(rows[1].transcript == 4);
+
+    //Names used in a new way show up in the next sample
+    tracker->IncrementRibo("geneB", 2);
+    tracker->IncrementRibo("geneC", 1);
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 2);
+    REQUIRE(rows[1].ribo_density == 0.5);
+    tracker->IncrementTranscript("geneC", 1);
+    tracker->Increment("geneB", 3);
+    tracker->GatherCounts(rows);
+    REQUIRE(rows.size() == 3);
+    REQUIRE(rows[1].protein == 3);
+    REQUIRE(rows[2].ribo_density == 1);
+}
+
+TEST_CASE("Delta output records only changed counts")
+{
+    auto tracker = std::make_shared<SpeciesTracker>();
+    for (int i = 0; i < 50; i++) {
+        tracker->Increment("species" + std::to_string(i), 1);
+    }
+    tracker->output_species({"species1*"});
+    tracker->track_changes(true);
+    tracker->Increment("species10", 1);
+    tracker->Increment("species10", -1);
+    tracker->Increment("species2", 1);
+    tracker->IncrementTranscript("species11", 1);
+    std::vector<SpeciesTracker::Counts> rows;
+    tracker->GatherChangedCounts(rows);
+    //Unselected species are left out and each name is reported once
+    REQUIRE(rows.size() == 2);
+    tracker->GatherChangedCounts(rows);
+    REQUIRE(rows.empty());
+    tracker->track_changes(false);
+    tracker->output_species({});
+
+    //Gathering changes gives the same file as comparing full rows
+    std::string sync_path = "delta_test_sync.bin";
+    std::string async_path = "delta_test_async.bin";
+    std::string dense_path = "delta_test_dense.bin";
+    {
+        auto sync = CountsWriter::Create("binary_delta", sync_path);
+        auto async = CountsWriter::Create("binary_delta", async_path, true);
+        auto dense = CountsWriter::Create("binary", dense_path);
+        for (int i = 0; i < 100; i++) {
+            if (i == 50) {
+                tracker->Increment("speciesNew", 4);
+            }
+            tracker->Increment("species0", 1);
+            sync->Write(i, *tracker);
+            async->Write(i, *tracker);
+            dense->Write(i, *tracker);
+        }
+        sync->Close();
+        async->Close();
+        dense->Close();
+    }
+    auto read = [](const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    };
+    std::string sync_bytes = read(sync_path);
+    REQUIRE(sync_bytes.substr(0, 8) == "PTCOUNTS");
+    REQUIRE(sync_bytes[8] == 3);
+    REQUIRE(read(async_path) == sync_bytes);
+    REQUIRE(sync_bytes.size() * 10 < read(dense_path).size());
+    std::remove(sync_path.c_str());
+    std::remove(async_path.c_str());
+    std::remove(dense_path.c_str());
+}
+
+TEST_CASE("HDF5 stores hold every replicate in one file")
+{
+    std::string path = "hdf5_store_test.h5";
+#ifdef PINETREE_HDF5
+    REQUIRE_THROWS_AS(Hdf5Store::Create(path, 0), std::invalid_argument);
+    {
+        auto store = Hdf5Store::Create(path, 3, 4);
+        store->WriteAttribute("phi1.rnapol", 2e8);
+        //Replicates append concurrently and share species columns
+        std::vector<std::thread> threads;
+        for (int replicate = 0; replicate < 2; replicate++) {
+            auto writer = std::shared_ptr<CountsWriter>(
+                store->Writer(replicate).release());
+            threads.emplace_back([writer, replicate]() {
+                SpeciesTracker tracker;
+                tracker.Increment(replicate ? "b" : "a", 1);
+                for (int i = 0; i < 10 + replicate; i++) {
+                    if (i == 5) {
+                        tracker.Increment(replicate ? "a" : "b", 7);
+                    }
+                    tracker.Increment("a", 1);
+                    writer->Write(i, tracker);
+                }
+                writer->WriteMetadata("seed", 10 + replicate);
+                writer->Close();
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        store->Close();
+        REQUIRE_THROWS_AS(store->WriteAttribute("late", 1), std::runtime_error);
+    }
+    hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    REQUIRE(file >= 0);
+    hid_t protein = H5Dopen2(file, "protein", H5P_DEFAULT);
+    hid_t space = H5Dget_space(protein);
+    hsize_t dims[3];
+    REQUIRE(H5Sget_simple_extent_dims(space, dims, nullptr) == 3);
+    REQUIRE(dims[0] == 3);
+    REQUIRE(dims[1] == 11);
+    REQUIRE(dims[2] == 2);
+    std::vector<double> values(dims[0] * dims[1] * dims[2]);
+    H5Dread(protein, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            values.data());
+    //Column 0 is "a" and column 1 is "b" in every replicate
+    REQUIRE(values[(0 * 11 + 9) * 2 + 0] == 11);
+    REQUIRE(values[(0 * 11 + 9) * 2 + 1] == 7);
+    REQUIRE(values[(1 * 11 + 10) * 2 + 0] == 18);
+    REQUIRE(values[(1 * 11 + 10) * 2 + 1] == 1);
+    REQUIRE(values[(2 * 11 + 0) * 2 + 0] == 0);
+    H5Sclose(space);
+    H5Dclose(protein);
+    std::vector<int64_t> time_points(3);
+    hid_t dataset = H5Dopen2(file, "time_points", H5P_DEFAULT);
+    H5Dread(dataset, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            time_points.data());
+    H5Dclose(dataset);
+    REQUIRE(time_points == std::vector<int64_t>{10, 11, 0});
+    std::vector<double> seeds(3);
+    dataset = H5Dopen2(file, "metadata/seed", H5P_DEFAULT);
+    H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            seeds.data());
+    H5Dclose(dataset);
+    REQUIRE(seeds[1] == 11);
+    REQUIRE(std::isnan(seeds[2]));
+    REQUIRE(H5Aexists(file, "phi1.rnapol") > 0);
+    REQUIRE(H5Lexists(file, "species", H5P_DEFAULT) > 0);
+    H5Fclose(file);
+    std::remove(path.c_str());
+
+    //Single runs write a store with one replicate
+    auto writer = CountsWriter::Create("hdf5", path);
+    SpeciesTracker tracker;
+    tracker.Increment("a", 1);
+    writer->Write(0, tracker);
+    writer->Close();
+    file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    REQUIRE(file >= 0);
+    H5Fclose(file);
+    std::remove(path.c_str());
+#else
+    REQUIRE_THROWS_AS(CountsWriter::Create("hdf5", path),
+                      std::invalid_argument);
+#endif
+}
+
+TEST_CASE("Asynchronous output matches synchronous output")
+{
+    auto tracker = std::make_shared<SpeciesTracker>();
+    tracker->Increment("proteinX", 1);
+    std::string sync_path = "async_test_sync.tsv";
+    std::string async_path = "async_test_async.tsv";
+    {
+        auto sync = CountsWriter::Create("tsv", sync_path);
+        //A small buffer makes the simulation side wait for free slots
+        AsyncCountsWriter async(CountsWriter::Create("tsv", async_path), 2);
+        for (int i = 0; i < 100; i++) {
+            if (i == 50) {
+                tracker->Increment("proteinY", 4);
+            }
+            tracker->Increment("proteinX", 1);
+            sync->Write(i, *tracker);
+            async.Write(i, *tracker);
+        }
+        sync->Close();
+        async.Close();
+    }
+    std::ifstream sync_file(sync_path);
+    std::ifstream async_file(async_path);
+    std::string sync_text((std::istreambuf_iterator<char>(sync_file)),
+                          std::istreambuf_iterator<char>());
+    std::string async_text((std::istreambuf_iterator<char>(async_file)),
+                           std::istreambuf_iterator<char>());
+    REQUIRE(sync_text.size() > 0);
+    REQUIRE(sync_text.find("proteinY") != std::string::npos);
+    REQUIRE(async_text == sync_text);
+    std::remove(sync_path.c_str());
+    std::remove(async_path.c_str());
+}
+
+TEST_CASE("Occupancy is integrated over time at each position")
+{
+    double clock = 0;
+    OccupancyProfiles profiles(&clock);
+    auto pol = Polymerase("rnapol", 10, 40);
+    auto &profile = profiles.profile("T7", "rnapol", 6);
+    profiles.Enter(profile, 3, pol);
+    clock = 2;
+    profiles.Leave(profile, 3, pol);
+    profiles.Enter(profile, 4, pol);
+    clock = 4;
+    auto averages = profiles.averages();
+    REQUIRE(averages["T7"]["rnapol"] ==
+            std::vector<double>({0, 0, 0, 0.5, 0.5, 0}));
+
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 1);
+    model.AddRibosome(10, 30, 1);
+    auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    model.RegisterGenome(plasmid);
+    model.seed(5);
+    model.RecordOccupancy();
+    model.SimulateToTable(60, 10, "direct");
+    auto occupancy = model.occupancy();
+    const auto &rnapol = occupancy["T7"]["rnapol"];
+    const auto &ribosome = occupancy["T7"]["__ribosome"];
+    REQUIRE(rnapol.size() == 306);
+    //A single polymerase is bound at most all of the time
+    double bound = std::accumulate(rnapol.begin(), rnapol.end(), 0.0);
+    REQUIRE(bound > 0);
+    REQUIRE(bound <= 1.0 + 1e-9);
+    //Ribosomes only occupy transcribed genes
+    REQUIRE(std::accumulate(ribosome.begin(), ribosome.end(), 0.0) > 0);
+    REQUIRE(ribosome[5] == 0);
+}
+
+TEST_CASE("Event traces are written as fixed size records")
+{
+    double clock = 1.5;
+    std::string path = "event_trace_test.bin";
+    auto pol = Polymerase("rnapol", 10, 40);
+    {
+        EventTrace trace(path, &clock);
+        REQUIRE(trace.AddPolymer("T7") == 0);
+        REQUIRE(trace.AddPolymer("T7") == 1);
+        trace.Record(TraceEvent::BIND, 1, pol.type_id(), pol.name(), 10);
+        clock = 2.0;
+        trace.Record(TraceEvent::MOVE, 1, pol.type_id(), pol.name(), 11);
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    //Header, two polymers, one element name and two events
+    REQUIRE(bytes.size() == 12 + 2 * 11 + 15 + 2 * 22);
+    REQUIRE(bytes.substr(0, 7) == "PTTRACE");
+    //The element is declared before its first event
+    REQUIRE(bytes[34] == 'N');
+    REQUIRE(bytes[49] == 'E');
+    double time;
+    std::memcpy(&time, bytes.data() + 72, sizeof(time));
+    REQUIRE(time == 2.0);
+    file.close();
+    std::remove(path.c_str());
+    REQUIRE_THROWS_AS(EventTrace("missing/trace.bin", &clock),
+                      std::runtime_error);
+}
+
+TEST_CASE("Polymer snapshots record element positions at output times")
+{
+    std::string path = "polymer_snapshots_test.bin";
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 1);
+        model->AddRibosome(10, 30, 1);
+        auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+        plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+        plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+        model->RegisterGenome(plasmid);
+        model->seed(5);
+        return model;
+    };
+    auto model = build();
+    model->RecordSnapshots(path);
+    auto table = model->SimulateToTable(60, 10, "direct");
+    model->StopSnapshots();
+    //Snapshots do not change the simulation
+    REQUIRE(build()->SimulateToTable(60, 10, "direct").protein ==
+            table.protein);
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    REQUIRE(bytes.substr(0, 8) == std::string("PTSNAPS\0", 8));
+    auto word = [&](std::size_t pos) {
+        uint32_t value;
+        std::memcpy(&value, bytes.data() + pos, sizeof(value));
+        return value;
+    };
+    std::map<uint32_t, std::string> polymers;
+    std::map<uint32_t, std::string> elements;
+    std::vector<double> times;
+    int transcripts = 0;
+    int ribosomes = 0;
+    std::size_t pos = 12;
+    while (pos < bytes.size()) {
+        char tag = bytes[pos++];
+        if (tag == 'P' || tag == 'N') {
+            uint32_t id = word(pos);
+            uint8_t kind = bytes[pos + 4];
+            uint32_t length = word(pos + 5);
+            std::string name = bytes.substr(pos + 9, length);
+            pos += 9 + length;
+            if (tag == 'P') {
+                REQUIRE(name == "T7");
+                transcripts += kind;
+                polymers[id] = name;
+            } else {
+                elements[id] = name;
+            }
+            continue;
+        }
+        REQUIRE(tag == 'T');
+        double time;
+        std::memcpy(&time, bytes.data() + pos, sizeof(time));
+        times.push_back(time);
+        uint32_t count = word(pos + 8);
+        pos += 12;
+        for (uint32_t i = 0; i < count; i++, pos += 16) {
+            //Polymers and element names are declared before they are used
+            REQUIRE(polymers.count(word(pos)) == 1);
+            REQUIRE(elements.count(word(pos + 4)) == 1);
+            int start = static_cast<int32_t>(word(pos + 8));
+            int stop = static_cast<int32_t>(word(pos + 12));
+            REQUIRE(start >= 1);
+            REQUIRE(stop <= 305);
+            REQUIRE(stop - start == 9);
+            ribosomes += elements[word(pos + 4)] == "__ribosome";
+        }
+    }
+    REQUIRE(pos == bytes.size());
+    //One snapshot per output row
+    REQUIRE(times == table.time);
+    REQUIRE(transcripts > 0);
+    REQUIRE(ribosomes > 0);
+    file.close();
+    std::remove(path.c_str());
+    REQUIRE_THROWS_AS(model->RecordSnapshots("missing/snapshots.bin"),
+                      std::runtime_error);
+}
+
+TEST_CASE("Dwell times are counted in logarithmic bins")
+{
+    double clock = 0;
+    OccupancyProfiles profiles(&clock);
+    REQUIRE_THROWS_AS(profiles.RecordDwellTimes(1, 1, 4),
+                      std::invalid_argument);
+    profiles.RecordDwellTimes(1, 100, 4);
+    REQUIRE(profiles.dwell_edges().size() == 5);
+    REQUIRE(profiles.dwell_edges()[2] == Approx(10));
+    auto pol = Polymerase("rnapol", 10, 40);
+    //Elements bound before recording started are not counted
+    auto &profile = profiles.profile("T7", "rnapol", 6);
+    profiles.Leave(profile, 2, pol);
+    profiles.Enter(profile, 3, pol);
+    clock = 2;
+    profiles.Leave(profile, 3, pol);
+    profiles.Enter(profile, 4, pol);
+    clock = 1000;
+    profiles.Leave(profile, 4, pol);
+    auto dwell = profiles.dwell_times()["T7"]["rnapol"];
+    REQUIRE(dwell.size() == 24);
+    REQUIRE(std::accumulate(dwell.begin(), dwell.end(), 0.0) == 2);
+    REQUIRE(dwell[3 * 4 + 1] == 1);
+    REQUIRE(dwell[4 * 4 + 3] == 1);
+
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 1);
+    model.AddRibosome(10, 30, 1);
+    auto plasmid = std::shared_ptr<Genome>(new Genome("T7", 305));
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    model.RegisterGenome(plasmid);
+    model.seed(5);
+    model.RecordDwellTimes(0.001, 10, 8);
+    model.SimulateToTable(60, 10, "direct");
+    auto ribosome = model.dwell_times()["T7"]["__ribosome"];
+    REQUIRE(ribosome.size() == 306 * 8);
+    REQUIRE(std::accumulate(ribosome.begin(), ribosome.end(), 0.0) > 0);
+}
+
+TEST_CASE("YAML model files are parsed")
+{
+    std::istringstream document(
+        "# comment\n"
+        "simulation:\n"
+        "    seed: 34   # trailing comment\n"
+        "    name: 'a # b'\n"
+        "    debug: False\n"
+        "polymerases:\n"
+        "- name: rnapol\n"
+        "  footprint: 1e1\n"
+        "- name: ecoli\n"
+        "reactants:\n"
+        "    - speciesX\n"
+        "    -\n"
+        "weights:\n"
+        "    [1.0,\n"
+        "    2.5]\n"
+        "empty:\n");
+    auto root = ParseYaml(document);
+    REQUIRE(root.IsMapping());
+    REQUIRE(root.size() == 5);
+    REQUIRE(root["simulation"]["seed"].AsInt() == 34);
+    REQUIRE(root["simulation"]["name"].AsString() == "a # b");
+    REQUIRE_FALSE(root["simulation"]["debug"].AsBool());
+    //Sequences may be indented at the level of their key
+    REQUIRE(root["polymerases"].size() == 2);
+    REQUIRE(root["polymerases"][0]["footprint"].AsInt() == 10);
+    REQUIRE(root["polymerases"][1]["name"].AsString() == "ecoli");
+    REQUIRE(root["reactants"][1].IsNone());
+    REQUIRE(root["weights"].AsDoubles() == std::vector<double>{1.0, 2.5});
+    REQUIRE(root["empty"].IsNone());
+    REQUIRE_THROWS_AS(root["missing"], std::runtime_error);
+    REQUIRE_THROWS_AS(root["simulation"]["name"].AsDouble(),
+                      std::runtime_error);
+
+    std::istringstream bad_indent("a:\n    b: 1\n  c: 2\n");
+    REQUIRE_THROWS_WITH(ParseYaml(bad_indent),
+                        "line 3: unexpected indentation.");
+    std::istringstream unterminated("a: [1,\n    2\n");
+    REQUIRE_THROWS_AS(ParseYaml(unterminated), std::runtime_error);
+}
+
+TEST_CASE("Model files build the same model as the API")
+{
+    std::istringstream document(
+        "simulation:\n"
+        "    seed: 34\n"
+        "    runtime: 40\n"
+        "    time_step: 5\n"
+        "    cell_volume: 8e-16\n"
+        "genome:\n"
+        "    name: T7\n"
+        "    copy_number: 2\n"
+        "polymerases:\n"
+        "- name: rnapol\n"
+        "  copy_number: 10\n"
+        "  speed: 40\n"
+        "  footprint: 10\n"
+        "ribosomes:\n"
+        "- name: ribosome\n"
+        "  copy_number: 100\n"
+        "  speed: 30\n"
+        "  footprint: 10\n"
+        "  binding_constant: 1e7\n"
+        "elements:\n"
+        "- type: promoter\n"
+        "  name: phi1\n"
+        "  start: 1\n"
+        "  stop: 10\n"
+        "  interactions:\n"
+        "      rnapol:\n"
+        "          binding_constant: 2e8\n"
+        "- type: transcript\n"
+        "  name: proteinX\n"
+        "  start: 26\n"
+        "  stop: 225\n"
+        "  rbs: -15\n"
+        "- type: terminator\n"
+        "  name: t1\n"
+        "  start: 304\n"
+        "  stop: 305\n"
+        "  interactions:\n"
+        "    rnapol:\n"
+        "        efficiency: 1.0\n");
+    auto file = ModelFile::Parse(document);
+    REQUIRE(file.runtime() == 40);
+    REQUIRE(file.time_step() == 5);
+    auto loaded = file.model()->SimulateToTable(40, 5, "direct");
+
+    Model model(8e-16);
+    model.seed(34);
+    model.AddPolymerase("rnapol", 10, 40, 10);
+    model.AddRibosome(10, 30, 100);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddGene("proteinX", 26, 225, 11, 26, 1e7);
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    model.RegisterGenome(plasmid);
+    model.RegisterGenome(plasmid->Clone());
+    auto built = model.SimulateToTable(40, 5, "direct");
+    REQUIRE(loaded.species == built.species);
+    REQUIRE(loaded.protein == built.protein);
+    REQUIRE(loaded.transcript == built.transcript);
+
+    //Errors name the document and line
+    std::istringstream bad_element(
+        "simulation:\n"
+        "    runtime: 1\n"
+        "    cell_volume: 8e-16\n"
+        "genome:\n"
+        "    name: T7\n"
+        "elements:\n"
+        "- type: operator\n"
+        "  name: o1\n"
+        "  start: 1\n"
+        "  stop: 10\n");
+    REQUIRE_THROWS_WITH(ModelFile::Parse(bad_element, "bad.yml"),
+                        "bad.yml: line 7: unknown element type 'operator'.");
+}
+
+TEST_CASE("Bulk definitions build the same genome as individual ones")
+{
+    auto simulate = [](bool bulk) {
+        Model model(8e-16);
+        model.seed(12);
+        model.AddPolymerase("rnapol", 10, 40, 10);
+        model.AddRibosome(10, 30, 100);
+        auto plasmid = std::make_shared<Genome>("T7", 400, 0.0, 20, 10, 1e-2);
+        if (bulk) {
+            plasmid->AddPromoters({"p1", "p2"}, {1, 150}, {10, 159},
+                                  {{"rnapol", {2e8, 1e8}}});
+            plasmid->AddGenes({"proteinX", "proteinY"}, {26, 180},
+                              {125, 280}, {11, 165}, {26, 180}, {1e7, 5e6});
+            plasmid->AddTerminators({"t1", "t2"}, {140, 398}, {141, 399},
+                                    {{"rnapol", {0.5, 1.0}}});
+            plasmid->AddRnaseSites({12, 166}, {21, 175});
+        } else {
+            plasmid->AddPromoter("p1", 1, 10, {{"rnapol", 2e8}});
+            plasmid->AddPromoter("p2", 150, 159, {{"rnapol", 1e8}});
+            plasmid->AddGene("proteinX", 26, 125, 11, 26, 1e7);
+            plasmid->AddGene("proteinY", 180, 280, 165, 180, 5e6);
+            plasmid->AddTerminator("t1", 140, 141, {{"rnapol", 0.5}});
+            plasmid->AddTerminator("t2", 398, 399, {{"rnapol", 1.0}});
+            plasmid->AddRnaseSite(12, 21);
+            plasmid->AddRnaseSite(166, 175);
+        }
+        model.RegisterGenome(plasmid);
+        return model.SimulateToTable(100, 10, "direct");
+    };
+    auto bulk = simulate(true);
+    auto single = simulate(false);
+    REQUIRE(bulk.species == single.species);
+    REQUIRE(bulk.protein == single.protein);
+    REQUIRE(bulk.transcript == single.transcript);
+
+    //Columns of different lengths are rejected
+    Genome genome("T7", 400);
+    REQUIRE_THROWS_AS(genome.AddGenes({"a", "b"}, {1, 50}, {40}, {1, 50},
+                                      {5, 55}, {1e7, 1e7}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(genome.AddPromoters({"p1"}, {1}, {10},
+                                          {{"rnapol", {1e7, 1e7}}}),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Serialized model definitions build the same model")
+{
+    Model model(8e-16);
+    model.AddPolymerase("rnapol", 10, 40, 10);
+    model.AddRibosome(10, 30, 100);
+    model.AddSpecies("a", 50);
+    model.AddReaction(0.01, {"a"}, {"b"}, "decay");
+    auto plasmid = std::make_shared<Genome>("T7", 400, 0.0, 20, 10, 1e-2);
+    plasmid->AddMask(100, {"rnapol"});
+    plasmid->AddPromoter("p1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddPromoters({"p2"}, {150}, {159}, {{"rnapol", {1e8}}});
+    plasmid->AddGene("proteinX", 26, 125, 11, 26, 1e7);
+    plasmid->AddGenes({"proteinY"}, {180}, {280}, {165}, {180}, {5e6});
+    plasmid->AddTerminator("t1", 140, 141, {{"rnapol", 0.5}});
+    plasmid->AddTerminators({"t2"}, {398}, {399}, {{"rnapol", {1.0}}});
+    plasmid->AddRnaseSite(12, 21);
+    plasmid->AddRnaseSites({166}, {175});
+    plasmid->AddWeights(std::vector<double>(400, 1.0));
+    model.RegisterGenome(plasmid, 2);
+    auto transcript = std::make_shared<Transcript>("rna", 200);
+    transcript->AddGene("proteinZ", 26, 125, 11, 26, 1e7);
+    model.RegisterTranscript(transcript);
+    model.parameter("decay.rate", 0.02);
+
+    std::string definition = model.SaveDefinition();
+    auto loaded = Model::LoadDefinition(definition);
+    REQUIRE(loaded->SaveDefinition() == definition);
+    REQUIRE(loaded->parameter("decay.rate") == 0.02);
+
+    model.seed(12);
+    loaded->seed(12);
+    auto original = model.SimulateToTable(100, 10, "direct");
+    auto copy = loaded->SimulateToTable(100, 10, "direct");
+    REQUIRE(copy.species == original.species);
+    REQUIRE(copy.protein == original.protein);
+    REQUIRE(copy.transcript == original.transcript);
+
+    //Simulating does not change the definition
+    REQUIRE(model.SaveDefinition() == definition);
+    REQUIRE_THROWS_WITH(Model::LoadDefinition("nonsense"),
+                        "Checkpoint is truncated.");
+}
+
+TEST_CASE("Annotated genomes are read from GenBank and GFF3 files")
+{
+    std::string genbank_path = "annotations_test.gb";
+    {
+        std::ofstream out(genbank_path);
+        out << "LOCUS       TEST                      60 bp    DNA     linear\n"
+               "DEFINITION  Test genome.\n"
+               "FEATURES             Location/Qualifiers\n"
+               "     regulatory      5\n"
+               "                     /regulatory_class=\"promoter\"\n"
+               "                     /note=\"T7 promoter\n"
+               "                     phi1\"\n"
+               "     gene            21..50\n"
+               "                     /gene=\"geneA\"\n"
+               "     CDS             21..50\n"
+               "                     /gene=\"geneA\"\n"
+               "                     /codon_start=1\n"
+               "                     /translation=\"MAAAAAAA\n"
+               "                     AA\"\n"
+               "     gene            complement(52..57)\n"
+               "                     /gene=\"geneB\"\n"
+               "     regulatory      55..60\n"
+               "                     /regulatory_class=\"terminator\"\n"
+               "ORIGIN\n"
+               "        1 aaaaaaaaaa aaaaaaaaaa gctgcagcag cagcagcagc\n"
+               "       41 agcagcagca aaaaaaaaaa\n"
+               "//\n";
+    }
+    auto genbank = AnnotationFile::Load(genbank_path);
+    std::remove(genbank_path.c_str());
+    REQUIRE(genbank.name == "TEST");
+    REQUIRE(genbank.length == 60);
+    REQUIRE(genbank.sequence.size() == 60);
+    REQUIRE(genbank.sequence.substr(20, 6) == "GCTGCA");
+    REQUIRE(genbank.features.size() == 5);
+    REQUIRE(genbank.features[0].start == 5);
+    REQUIRE(genbank.features[0].stop == 5);
+    //Quoted values are joined across lines, translations without spaces
+    REQUIRE(genbank.features[0].qualifier("note") == "T7 promoter phi1");
+    REQUIRE(genbank.features[2].qualifier("translation") == "MAAAAAAAAA");
+    REQUIRE(genbank.features[3].complement);
+    REQUIRE(genbank.features[3].start == 52);
+
+    AnnotationRules rules;
+    AnnotationRule promoter;
+    promoter.action = AnnotationRule::PROMOTER;
+    promoter.type = "regulatory";
+    promoter.match = {{"regulatory_class", {"promoter"}}};
+    promoter.name = "phi1";
+    promoter.min_length = 10;
+    promoter.interactions = {{"rnapol", 2e8}};
+    AnnotationRule gene;
+    gene.action = AnnotationRule::GENE;
+    gene.type = "gene";
+    gene.rbs_offset = -10;
+    AnnotationRule terminator;
+    terminator.action = AnnotationRule::TERMINATOR;
+    terminator.type = "regulatory";
+    terminator.interactions = {{"rnapol", 1.0}};
+    rules.rules = {promoter, gene, terminator};
+    rules.codon_weights = {{"GCT", 2.0}};
+    auto weights = rules.CodonWeights(genbank);
+    REQUIRE(weights.size() == 60);
+    //The first codon is twice as fast as the other nine, normalized to a
+    //mean of 1 over the coding sequence
+    REQUIRE(weights[0] == 1.0);
+    REQUIRE(weights[20] == Approx(2.0 / 1.1));
+    REQUIRE(weights[23] == Approx(1.0 / 1.1));
+    REQUIRE(weights[50] == 1.0);
+
+    auto genome = std::make_shared<Genome>("TEST", genbank.length);
+    //The reverse strand gene is skipped
+    REQUIRE(rules.Apply(genbank, *genome) == 3);
+    REQUIRE(genome->bindings().count("phi1") == 1);
+    REQUIRE(genome->bindings().count("geneA") == 0);
+
+    std::string gff_path = "annotations_test.gff";
+    {
+        std::ofstream out(gff_path);
+        out << "##gff-version 3\n"
+               "##sequence-region TEST 1 60\n"
+               "TEST\t.\tgene\t21\t50\t.\t+\t.\tID=geneA;Note=a%3Bb,c\n"
+               "TEST\t.\tCDS\t21\t50\t.\t-\t0\tParent=geneA\n"
+               "##FASTA\n"
+               ">TEST\n"
+               "ACGT\n"
+               "acgt\n";
+    }
+    auto gff = AnnotationFile::Load(gff_path);
+    std::remove(gff_path.c_str());
+    REQUIRE(gff.name == "TEST");
+    REQUIRE(gff.length == 60);
+    REQUIRE(gff.sequence == "ACGTACGT");
+    REQUIRE(gff.features.size() == 2);
+    REQUIRE(gff.features[0].HasQualifier("Note", {"a;b"}));
+    REQUIRE(gff.features[0].HasQualifier("Note", {"c"}));
+    REQUIRE(gff.features[1].complement);
+    REQUIRE_THROWS_AS(AnnotationFile::Load("missing.gb"), std::runtime_error);
+}
+
+TEST_CASE("Model caches reuse models built from the same inputs")
+{
+    std::string input_path = "model_cache_input.txt";
+    {
+        std::ofstream out(input_path);
+        out << "first";
+    }
+    std::string key = ModelCache::Key({input_path}, {"1.5"});
+    REQUIRE(key.size() == 16);
+    REQUIRE(ModelCache::Key({input_path}, {"1.5"}) == key);
+    REQUIRE(ModelCache::Key({input_path}, {"1.6"}) != key);
+    REQUIRE(ModelCache::Key({input_path}, {"1", ".5"}) != key);
+    {
+        std::ofstream out(input_path);
+        out << "second";
+    }
+    REQUIRE(ModelCache::Key({input_path}, {"1.5"}) != key);
+    std::remove(input_path.c_str());
+    REQUIRE_THROWS_AS(ModelCache::Key({input_path}, {}), std::runtime_error);
+
+    int builds = 0;
+    auto build = [&builds]() {
+        builds++;
+        auto model = std::make_shared<Model>(8e-16);
+        model->AddPolymerase("rnapol", 10, 40, 10);
+        model->AddSpecies("a", 50);
+        auto plasmid = std::make_shared<Genome>("T7", 200, 0.0, 20, 10, 1e-2);
+        plasmid->AddPromoter("p1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddGene("proteinX", 26, 125, 11, 26, 1e7);
+        plasmid->AddTerminator("t1", 198, 199, {{"rnapol", 1.0}});
+        model->RegisterGenome(plasmid);
+        return model;
+    };
+    ModelCache cache(".");
+    std::remove(cache.path(key).c_str());
+    REQUIRE(cache.Load(key) == nullptr);
+    auto built = cache.Get(key, build);
+    auto cached = cache.Get(key, build);
+    REQUIRE(builds == 1);
+    REQUIRE(cached->SaveDefinition() == build()->SaveDefinition());
+
+    built->seed(3);
+    cached->seed(3);
+    auto original = built->SimulateToTable(50, 5, "direct");
+    auto copy = cached->SimulateToTable(50, 5, "direct");
+    REQUIRE(copy.protein == original.protein);
+    REQUIRE(copy.transcript == original.transcript);
+
+    //Entries of another version or under another key are rebuilt
+    {
+        CheckpointWriter writer;
+        writer.Write(std::string("pinetree model cache"));
+        writer.Write<uint32_t>(0);
+        std::ofstream out(cache.path(key), std::ios::binary);
+        out << writer.buffer() << build()->SaveDefinition();
+    }
+    REQUIRE(cache.Load(key) == nullptr);
+    std::rename(cache.path(key).c_str(), cache.path("other").c_str());
+    cache.Store(key, *build());
+    std::rename(cache.path(key).c_str(), cache.path("other").c_str());
+    REQUIRE(cache.Load("other") == nullptr);
+    std::remove(cache.path("other").c_str());
+}
+
+TEST_CASE("Counts files are read by species and time window")
+{
+    auto build = []() {
+        auto model = std::make_shared<Model>(8e-16);
+        model->seed(21);
+        model->AddPolymerase("rnapol", 10, 40, 10);
+        model->AddRibosome(10, 30, 100);
+        model->AddSpecies("a", 50);
+        model->AddReaction(0.01, {"a"}, {"b"}, "decay");
+        auto plasmid = std::make_shared<Genome>("T7", 300, 0.0, 20, 10, 1e-2);
+        plasmid->AddPromoter("p1", 1, 10, {{"rnapol", 2e8}});
+        plasmid->AddGene("proteinX", 26, 125, 11, 26, 1e7);
+        plasmid->AddGene("proteinY", 160, 280, 146, 160, 5e6);
+        plasmid->AddTerminator("t1", 298, 299, {{"rnapol", 1.0}});
+        model->RegisterGenome(plasmid);
+        return model;
+    };
+    CountsTable expected = build()->SimulateToTable(60, 2, "direct");
+    build()->Simulate(60, 2, "counts_file_test.bin", "direct", "binary");
+    build()->Simulate(60, 2, "counts_file_test_delta.bin", "direct",
+                      "binary_delta");
+    std::vector<std::string> paths = {"counts_file_test.bin",
+                                      "counts_file_test_delta.bin"};
+    int width = expected.species.size();
+    int rows = expected.time.size();
+    int a = std::find(expected.species.begin(), expected.species.end(), "a") -
+            expected.species.begin();
+    int y = std::find(expected.species.begin(), expected.species.end(),
+                      "proteinY") -
+            expected.species.begin();
+    REQUIRE(y < width);
+    for (const auto &path : paths) {
+        CountsFile file(path);
+        REQUIRE(file.species() == expected.species);
+        auto table = file.Read({});
+        REQUIRE(table.time == file.time());
+        REQUIRE(table.protein == expected.protein);
+        REQUIRE(table.transcript == expected.transcript);
+        REQUIRE(table.ribo_density == expected.ribo_density);
+
+        //A window of some species, with a species not in the file
+        auto window = file.Read({"proteinY", "missing", "a"}, 9.5, 20.5);
+        REQUIRE(window.time.size() == 6);
+        for (int row = 0; row < 6; row++) {
+            int source = 5 + row;
+            REQUIRE(window.time[row] == Approx(expected.time[source]));
+            CHECK(window.protein[3 * row] ==
+                  expected.protein[source * width + y]);
+            CHECK(window.protein[3 * row + 1] == 0);
+            CHECK(window.protein[3 * row + 2] ==
+                  expected.protein[source * width + a]);
+        }
+
+        //Resampled counts hold between time points
+        auto resampled = file.Resample({"a"}, {-1, 3, 4, 200});
+        CHECK(resampled.protein[0] == 0);
+        CHECK(resampled.protein[1] == expected.protein[width + a]);
+        CHECK(resampled.protein[2] == expected.protein[2 * width + a]);
+        CHECK(resampled.protein[3] ==
+              expected.protein[(rows - 1) * width + a]);
+        REQUIRE_THROWS_AS(file.Resample({}, {2, 1}), std::invalid_argument);
+    }
+    auto ensemble = ResampleCounts(paths, {}, {0, 30, 60});
+    REQUIRE(ensemble.replicates == 2);
+    REQUIRE(ensemble.species == expected.species);
+    REQUIRE(ensemble.protein.size() == 2 * 3 * width);
+    REQUIRE(std::equal(ensemble.protein.begin(),
+                       ensemble.protein.begin() + 3 * width,
+                       ensemble.protein.begin() + 3 * width));
+    std::remove(paths[0].c_str());
+    std::remove(paths[1].c_str());
+    REQUIRE_THROWS_AS(CountsFile(paths[0]), std::runtime_error);
+}
+
+TEST_CASE("Time buckets report interval statistics")
+{
+    auto build = [](bool buckets) {
+        auto model = std::make_shared<Model>(8e-16);
+        model->seed(5);
+        model->AddSpecies("a", 200);
+        model->AddReaction(0.05, {"a"}, {"b"}, "decay");
+        model->time_buckets(buckets);
+        return model;
+    };
+    CountsTable points = build(false)->SimulateToTable(40, 10, "direct");
+    auto model = build(true);
+    CountsTable buckets = model->SimulateToTable(40, 10, "direct");
+    REQUIRE(buckets.species.size() == 3 * points.species.size());
+    REQUIRE(buckets.time.size() == points.time.size());
+    auto column = [](const CountsTable &table, const std::string &name) {
+        return std::find(table.species.begin(), table.species.end(), name) -
+               table.species.begin();
+    };
+    int width = buckets.species.size();
+    int a = column(points, "a");
+    int mean = column(buckets, "a");
+    int min = column(buckets, "a_min");
+    int max = column(buckets, "a_max");
+    REQUIRE(max < width);
+    //The first time point reports the initial counts
+    CHECK(buckets.protein[mean] == 200);
+    CHECK(buckets.protein[min] == 200);
+    CHECK(buckets.protein[max] == 200);
+    //Decay only lowers the count, so it spans its values at either end
+    for (int row = 1; row < static_cast<int>(buckets.time.size()); row++) {
+        int points_width = points.species.size();
+        double start = points.protein[(row - 1) * points_width + a];
+        double end = points.protein[row * points_width + a];
+        CHECK(buckets.protein[row * width + max] == start);
+        CHECK(buckets.protein[row * width + min] == end);
+        CHECK(buckets.protein[row * width + mean] < start);
+        CHECK(buckets.protein[row * width + mean] > end);
+    }
+    //Restored runs continue the interval they were checkpointed in
+    auto first = build(true);
+    first->SimulateToTable(25, 10, "direct");
+    first->Checkpoint("time_buckets.ckpt");
+    auto second = build(true);
+    second->Restore("time_buckets.ckpt");
+    std::remove("time_buckets.ckpt");
+    CountsTable rest = second->SimulateToTable(40, 10, "direct");
+    REQUIRE(rest.species == buckets.species);
+    REQUIRE(std::vector<double>(rest.protein.end() - width,
+                                rest.protein.end()) ==
+            std::vector<double>(buckets.protein.end() - width,
+                                buckets.protein.end()));
+
+    auto open = [](int) {
+        return CountsWriter::Ptr(new TableCountsWriter(1));
+    };
+    auto close = [](int, CountsWriter &) {};
+    REQUIRE_THROWS_AS(model->SimulateBatch(2, {}, 1, {10.0}, open, close),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Dependency reports split models at their hub species")
+{
+    auto model = std::make_shared<Model>(8e-16);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddPromoter("phi2", 101, 110, {{"rnapol", 2e8}});
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    plasmid->AddGene("proteinY", 141, 200, 131, 140, 1e7);
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    model->RegisterGenome(plasmid);
+    model->AddPolymerase("rnapol", 10, 40, 5);
+    model->AddRibosome(10, 30, 10);
+    model->AddSpecies("a", 10);
+    model->AddReaction(1.0, {"proteinX"}, {"z"});
+    model->AddReaction(1.0, {"a"}, {"b"});
+    model->AddReaction(1.0, {"b"}, {"a"});
+
+    DependencyReport report = model->dependency_report(2);
+    //Two bindings for each hub, and the genome releasing both
+    CHECK(report.reactions == 8);
+    CHECK(report.hubs.size() == 2);
+    CHECK(report.species.at("rnapol").hub);
+    CHECK(report.species.at("rnapol").fan_out == 2);
+    CHECK(report.species.at("rnapol").degree == 3);
+    CHECK(report.species.at("__ribosome").hub);
+    CHECK_FALSE(report.species.at("phi1").hub);
+    //The tracker recomputes reactions for their products as well
+    CHECK(report.species.at("a").fan_out == 2);
+    CHECK(report.species.at("a").writers == 2);
+    //The genome and its products are one component, a and b another
+    CHECK(report.connected_components == 2);
+    REQUIRE(report.components.size() == 2);
+    CHECK(report.components[0].reactions.size() == 6);
+    CHECK(std::count(report.components[0].species.begin(),
+                     report.components[0].species.end(), "z") == 1);
+    CHECK(report.components[1].species ==
+          std::vector<std::string>{"a", "b"});
+    CHECK(report.components[1].reactions ==
+          std::vector<std::string>{"a -> b", "b -> a"});
+    REQUIRE(report.partitions.size() == 2);
+    CHECK(report.partitions[0].components == std::vector<int>{0});
+    CHECK(report.partitions[0].reactions == 6);
+    CHECK(report.partitions[0].shared ==
+          std::vector<std::string>{"__ribosome", "rnapol"});
+    CHECK(report.partitions[1].reactions == 2);
+    CHECK(report.partitions[1].shared.empty());
+
+    //One partition holds everything
+    DependencyReport single = model->dependency_report(1);
+    CHECK(single.partitions[0].reactions == 8);
+    REQUIRE_THROWS_AS(model->dependency_report(0), std::invalid_argument);
+    REQUIRE_THROWS_AS(model->dependency_report(1, 0),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Placed ensemble workers give the same replicates")
+{
+    REQUIRE(ParsePlacement("none") == Placement::NONE);
+    REQUIRE(ParsePlacement("compact") == Placement::COMPACT);
+    REQUIRE(ParsePlacement("spread") == Placement::SPREAD);
+    REQUIRE_THROWS_AS(ParsePlacement("scatter"), std::invalid_argument);
+
+    //Both policies use every CPU once before reusing any
+    auto nodes = NumaNodes();
+    REQUIRE(nodes.size() > 0);
+    std::vector<int> all;
+    for (const auto &node : nodes) {
+        REQUIRE(node.size() > 0);
+        all.insert(all.end(), node.begin(), node.end());
+    }
+    std::sort(all.begin(), all.end());
+    int count = all.size();
+    CHECK(PlacementCpus(Placement::NONE, 4).empty());
+    for (auto policy : {Placement::COMPACT, Placement::SPREAD}) {
+        auto cpus = PlacementCpus(policy, count + 1);
+        REQUIRE(cpus.size() == count + 1);
+        CHECK(cpus.back() == cpus.front());
+        cpus.pop_back();
+        std::sort(cpus.begin(), cpus.end());
+        CHECK(cpus == all);
+    }
+    CHECK(PlacementCpus(Placement::COMPACT, 1).front() == nodes[0][0]);
+    if (nodes.size() > 1) {
+        CHECK(PlacementCpus(Placement::SPREAD, 2)[1] == nodes[1][0]);
+    }
+
+    Model model(8e-16);
+    model.AddSpecies("a", 100);
+    model.AddReaction(0.1, {"a"}, {"b"});
+    auto run = [&model](const std::string &policy) {
+        model.placement(policy);
+        std::vector<CountsTable> tables(4);
+        model.SimulateEnsemble(4, {3}, 2, [&](int i, Model &replicate) {
+            tables[i] = replicate.SimulateToTable(20, 1, "direct");
+        });
+        return tables;
+    };
+    auto unpinned = run("none");
+    for (std::string policy : {"compact", "spread"}) {
+        auto pinned = run(policy);
+        for (int i = 0; i < 4; i++) {
+            CHECK(pinned[i].protein == unpinned[i].protein);
+        }
+    }
+    REQUIRE_THROWS_AS(model.placement("all"), std::invalid_argument);
+}
+
+TEST_CASE("Populations divide cells and summarize them online")
+{
+    Model model(8e-16);
+    auto plasmid = std::make_shared<Genome>("T7", 305);
+    plasmid->AddPromoter("phi1", 1, 10, {{"rnapol", 2e8}});
+    plasmid->AddGene("proteinX", 41, 100, 31, 40, 1e7);
+    plasmid->AddTerminator("t1", 304, 305, {{"rnapol", 1.0}});
+    model.RegisterGenome(plasmid);
+    model.AddPolymerase("rnapol", 10, 40, 4);
+    model.AddRibosome(10, 30, 10);
+    model.AddSpecies("a", 100);
+
+    auto grow = [&model](int threads, bool partition) {
+        auto population = std::make_shared<Population>(model, 2, 11);
+        population->division(10, partition);
+        population->threads(threads);
+        population->Simulate(30, 5, "direct");
+        return population;
+    };
+    auto population = grow(1, true);
+    //Both cells divide every 10 s, at output times 10, 20 and 30 too
+    CHECK(population->size() == 16);
+    CHECK(population->divisions() == 14);
+    CHECK(population->time() == 30);
+    EnsembleSummary summary = population->Summary();
+    REQUIRE(summary.time.size() == 7);
+    CHECK(summary.replicates ==
+          std::vector<double>{2, 2, 4, 4, 8, 8, 16});
+    //Partitioning conserves the free molecules of the population
+    int a = std::find(summary.species.begin(), summary.species.end(), "a") -
+            summary.species.begin();
+    int width = summary.species.size();
+    REQUIRE(a < width);
+    for (std::size_t row = 0; row < summary.time.size(); row++) {
+        CHECK(summary.protein.mean[row * width + a] * summary.replicates[row] ==
+              Approx(200));
+    }
+    CHECK(summary.protein.min[6 * width + a] <
+          summary.protein.max[6 * width + a]);
+    //Results do not depend on the number of threads
+    EnsembleSummary threaded = grow(4, true)->Summary();
+    CHECK(threaded.species == summary.species);
+    CHECK(threaded.protein.mean == summary.protein.mean);
+    CHECK(threaded.transcript.variance == summary.transcript.variance);
+    //Copied daughters keep every molecule
+    EnsembleSummary copied = grow(2, false)->Summary();
+    int copied_a = std::find(copied.species.begin(), copied.species.end(),
+                             "a") - copied.species.begin();
+    CHECK(copied.protein.min[6 * copied.species.size() + copied_a] == 100);
+
+    //A chemostat keeps the population bounded, and runs continue
+    Population chemostat(model, 2, 11);
+    chemostat.division(10);
+    chemostat.max_cells(5);
+    chemostat.Simulate(20, 5, "direct");
+    chemostat.Simulate(40, 5, "direct");
+    CHECK(chemostat.size() == 5);
+    CHECK(chemostat.Summary().replicates.back() == 5);
+    CHECK(chemostat.Summary().time.size() == 9);
+    REQUIRE_THROWS_AS(chemostat.Simulate(50, 2, "direct"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(Population(model, 0, 1), std::invalid_argument);
+}